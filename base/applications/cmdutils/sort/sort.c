@@ -9,9 +9,73 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <windef.h>
+#include <winbase.h>
 
-#define MAXRECORDS 65536 /* maximum number of records that can be sorted */
-#define MAXLEN 4095 /* maximum record length */
+/*
+ * The records are read into a memory budget and sorted there. When the
+ * budget is full, the sorted records are written to a temporary file as
+ * a run and the budget is reused. At the end the runs and the records
+ * still in memory are merged with a heap. A big budget is sorted in
+ * segments on several threads, which the merge then joins.
+ */
+
+#define DEFAULT_RECORD_MAX  4096    /* default maximum record length */
+#define MAX_RECORD_MAX      65535
+#define MIN_MEMORY          (160 * 1024)
+#define MAX_MERGE           32      /* runs merged at once */
+#define MAX_THREADS         8
+#define MIN_SEGMENT         16384   /* records worth a thread */
+#define IO_BUFFER           (256 * 1024)
+
+typedef struct _RECORD
+{
+    const char *Text;
+    ULONG Length;
+} RECORD, *PRECORD;
+
+typedef struct _READER
+{
+    HANDLE File;
+    PCHAR Buffer;
+    ULONG Size;
+    ULONG Start;
+    ULONG End;
+    BOOL Eof;
+} READER, *PREADER;
+
+typedef struct _WRITER
+{
+    HANDLE File;
+    PCHAR Buffer;
+    ULONG Size;
+    ULONG Used;
+} WRITER, *PWRITER;
+
+/* Records in memory: the text grows up from the start of the block and
+ * the records grow down from its end, until they meet */
+typedef struct _ARENA
+{
+    PCHAR Base;
+    SIZE_T Size;
+    SIZE_T Used;
+    ULONG Count;
+} ARENA, *PARENA;
+
+typedef struct _SEGMENT
+{
+    PRECORD Records;
+    ULONG Count;
+} SEGMENT, *PSEGMENT;
+
+/* A sorted input of the merge, a segment in memory or a run on disk */
+typedef struct _SOURCE
+{
+    RECORD Current;
+    PRECORD Next;
+    PRECORD End;
+    PREADER Run;
+} SOURCE, *PSOURCE;
 
 /* Reverse flag */
 int rev;
@@ -20,46 +84,40 @@ int rev;
 int help;
 
 /* Sort column */
-int sortcol;
+ULONG sortcol;
 
 /* Error counter */
 int err = 0;
 
-int cmpr(const void *a, const void *b)
-{
-    char *A, *B;
+/* Maximum record length */
+ULONG recmax = DEFAULT_RECORD_MAX;
 
-    A = *(char **) a;
-    B = *(char **) b;
+/* Temporary directory */
+char tempdir[MAX_PATH];
 
-    if (sortcol > 0)
-    {
-        if (strlen(A) > sortcol)
-        {
-            A += sortcol;
-        }
-        else
-        {
-            A = "";
-        }
-        if (strlen(B) > sortcol)
-        {
-            B += sortcol;
-        }
-        else
-        {
-            B = "";
-        }
-    }
+int cmpr(const void *a, const void *b)
+{
+    const RECORD *A = a, *B = b;
+    const char *KeyA = "", *KeyB = "";
+    ULONG LengthA = 0, LengthB = 0;
+    int Result;
 
-    if (!rev)
+    if (A->Length > sortcol)
     {
-        return strcmp(A, B);
+        KeyA = A->Text + sortcol;
+        LengthA = A->Length - sortcol;
     }
-    else
+    if (B->Length > sortcol)
     {
-        return strcmp(B, A);
+        KeyB = B->Text + sortcol;
+        LengthB = B->Length - sortcol;
     }
+
+    Result = memcmp(KeyA, KeyB, min(LengthA, LengthB));
+    if (!Result)
+        Result = (LengthA > LengthB) - (LengthA < LengthB);
+
+    return rev ? -Result : Result;
 }
 
 void usage(void)
@@ -73,24 +131,437 @@ void usage(void)
         fputs("Invalid parameter\n", stderr);
     }
 
+    fputs("    SORT [options] [[drive:][path]file] [/O [drive:][path]file]\n", stderr);
     fputs("    SORT [options] < [drive:1][path1]file1 > [drive2:][path2]file2\n",
           stderr);
 
     fputs("    Command | SORT [options] > [drive:][path]file\n", stderr);
     fputs("    Options:\n", stderr);
-    fputs("    /R   Reverse order\n", stderr);
-    fputs("    /+n  Start sorting with column n\n", stderr);
-    fputs("    /?   Help\n", stderr);
+    fputs("    /R          Reverse order\n", stderr);
+    fputs("    /+n         Start sorting with column n\n", stderr);
+    fputs("    /M kb       Memory to use before sorting through temporary files\n", stderr);
+    fputs("    /REC chars  Maximum record length, 4096 by default and at most 65535\n", stderr);
+    fputs("    /T path     Directory for the temporary files\n", stderr);
+    fputs("    /O file     Write the output to file instead of the console\n", stderr);
+    fputs("    /?          Help\n", stderr);
+}
+
+static
+void
+Fail(const char *Message, int Code)
+{
+    fprintf(stderr, "SORT: %s\n", Message);
+
+    /* The temporary files are deleted when they are closed */
+    exit(Code);
+}
+
+static
+PVOID
+AllocOrFail(SIZE_T Size)
+{
+    PVOID Memory = malloc(Size);
+    if (!Memory)
+        Fail("Insufficient memory", 3);
+    return Memory;
+}
+
+static
+VOID
+ReaderInit(PREADER Reader, HANDLE File)
+{
+    /* Room for a whole record and its line end, twice for fewer moves */
+    Reader->Size = max(IO_BUFFER / 4, 2 * (recmax + 2));
+    Reader->Buffer = AllocOrFail(Reader->Size);
+    Reader->File = File;
+    Reader->Start = Reader->End = 0;
+    Reader->Eof = FALSE;
+}
+
+/* Returns the next record, which stays valid until the next call */
+static
+BOOL
+ReadRecord(PREADER Reader, PRECORD Record)
+{
+    PCHAR Line, LineEnd;
+    ULONG Scanned = 0;
+    DWORD Read;
+
+    for (;;)
+    {
+        Line = Reader->Buffer + Reader->Start;
+        LineEnd = memchr(Line + Scanned, '\n', Reader->End - Reader->Start - Scanned);
+        if (LineEnd || (Reader->Eof && Reader->Start < Reader->End))
+        {
+            if (!LineEnd)
+                LineEnd = Reader->Buffer + Reader->End;
+            Reader->Start = (ULONG)(LineEnd - Reader->Buffer) + 1;
+            Reader->Start = min(Reader->Start, Reader->End);
+
+            if (LineEnd > Line && LineEnd[-1] == '\r')
+                LineEnd--;
+            if ((ULONG)(LineEnd - Line) > recmax)
+                Fail("Record exceeds the maximum length", 4);
+
+            Record->Text = Line;
+            Record->Length = (ULONG)(LineEnd - Line);
+            return TRUE;
+        }
+
+        if (Reader->Eof)
+            return FALSE;
+
+        Scanned = Reader->End - Reader->Start;
+        if (Scanned > recmax + 1)
+            Fail("Record exceeds the maximum length", 4);
+
+        /* Keep the start of the record and fill up the rest */
+        memmove(Reader->Buffer, Line, Scanned);
+        Reader->Start = 0;
+        Reader->End = Scanned;
+
+        if (!ReadFile(Reader->File, Reader->Buffer + Reader->End,
+                      Reader->Size - Reader->End, &Read, NULL))
+        {
+            if (GetLastError() != ERROR_BROKEN_PIPE)
+                Fail("Cannot read the input", 5);
+            Read = 0;
+        }
+
+        if (!Read)
+            Reader->Eof = TRUE;
+        Reader->End += Read;
+    }
+}
+
+static
+VOID
+WriterInit(PWRITER Writer, HANDLE File)
+{
+    Writer->Size = IO_BUFFER;
+    Writer->Buffer = AllocOrFail(Writer->Size);
+    Writer->File = File;
+    Writer->Used = 0;
+}
+
+static
+VOID
+WriterFlush(PWRITER Writer)
+{
+    DWORD Written;
+
+    if (Writer->Used &&
+        (!WriteFile(Writer->File, Writer->Buffer, Writer->Used, &Written, NULL) ||
+         Written != Writer->Used))
+    {
+        Fail("Cannot write the output", 5);
+    }
+    Writer->Used = 0;
+}
+
+static
+VOID
+WriteData(PWRITER Writer, const void *Data, ULONG Length)
+{
+    if (Writer->Used + Length > Writer->Size)
+        WriterFlush(Writer);
+
+    memcpy(Writer->Buffer + Writer->Used, Data, Length);
+    Writer->Used += Length;
+}
+
+static
+VOID
+WriterFree(PWRITER Writer)
+{
+    WriterFlush(Writer);
+    free(Writer->Buffer);
+}
+
+static
+BOOL
+ArenaAdd(PARENA Arena, const RECORD *Record)
+{
+    PRECORD Records = (PRECORD)(Arena->Base + Arena->Size) - Arena->Count;
+    PCHAR Text;
+
+    if (Arena->Used + Record->Length + sizeof(RECORD) > Arena->Size - Arena->Count * sizeof(RECORD))
+        return FALSE;
+
+    Text = Arena->Base + Arena->Used;
+    memcpy(Text, Record->Text, Record->Length);
+    Arena->Used += Record->Length;
+
+    Records[-1].Text = Text;
+    Records[-1].Length = Record->Length;
+    Arena->Count++;
+    return TRUE;
+}
+
+static
+PRECORD
+ArenaRecords(PARENA Arena)
+{
+    return (PRECORD)(Arena->Base + Arena->Size) - Arena->Count;
+}
+
+static
+DWORD
+WINAPI
+SortSegment(PVOID Context)
+{
+    PSEGMENT Segment = Context;
+
+    qsort(Segment->Records, Segment->Count, sizeof(RECORD), cmpr);
+    return 0;
+}
+
+/* Sorts the records in memory, in as many segments as there are threads
+ * worth starting, and returns the number of segments */
+static
+ULONG
+SortArena(PARENA Arena, PSEGMENT Segments)
+{
+    HANDLE Threads[MAX_THREADS];
+    SYSTEM_INFO SystemInfo;
+    PRECORD Records = ArenaRecords(Arena);
+    ULONG Count, Started = 0, Index, First = 0;
+
+    GetSystemInfo(&SystemInfo);
+    Count = min(SystemInfo.dwNumberOfProcessors, MAX_THREADS);
+    Count = min(Count, Arena->Count / MIN_SEGMENT);
+    Count = max(Count, 1);
+
+    for (Index = 0; Index < Count; Index++)
+    {
+        Segments[Index].Records = Records + First;
+        Segments[Index].Count = (Arena->Count - First) / (Count - Index);
+        First += Segments[Index].Count;
+    }
+
+    /* This thread takes the first segment itself */
+    for (Index = 1; Index < Count; Index++)
+    {
+        Threads[Started] = CreateThread(NULL, 0, SortSegment, &Segments[Index], 0, NULL);
+        if (Threads[Started])
+            Started++;
+        else
+            SortSegment(&Segments[Index]);
+    }
+
+    SortSegment(&Segments[0]);
+
+    if (Started)
+        WaitForMultipleObjects(Started, Threads, TRUE, INFINITE);
+    for (Index = 0; Index < Started; Index++)
+        CloseHandle(Threads[Index]);
+
+    return Count;
+}
+
+static
+BOOL
+SourceNext(PSOURCE Source)
+{
+    if (Source->Run)
+        return ReadRecord(Source->Run, &Source->Current);
+
+    if (Source->Next == Source->End)
+        return FALSE;
+    Source->Current = *Source->Next++;
+    return TRUE;
+}
+
+/* Orders the heap by the current records, then by source for equal ones */
+static
+BOOL
+SourceLess(PSOURCE Sources, ULONG A, ULONG B)
+{
+    int Result = cmpr(&Sources[A].Current, &Sources[B].Current);
+    return Result < 0 || (Result == 0 && A < B);
+}
+
+static
+VOID
+SiftDown(PSOURCE Sources, PULONG Heap, ULONG Count, ULONG Index)
+{
+    ULONG Child, Top = Heap[Index];
+
+    for (;;)
+    {
+        Child = Index * 2 + 1;
+        if (Child >= Count)
+            break;
+        if (Child + 1 < Count && SourceLess(Sources, Heap[Child + 1], Heap[Child]))
+            Child++;
+        if (!SourceLess(Sources, Heap[Child], Top))
+            break;
+        Heap[Index] = Heap[Child];
+        Index = Child;
+    }
+    Heap[Index] = Top;
+}
+
+/* k-way merge of sorted sources into one output */
+static
+VOID
+Merge(PSOURCE Sources, ULONG SourceCount, PWRITER Writer, const char *LineEnd)
+{
+    ULONG Heap[MAX_MERGE + MAX_THREADS];
+    ULONG Count = 0, Index, LineEndLength = (ULONG)strlen(LineEnd);
+    PSOURCE Top;
+
+    for (Index = 0; Index < SourceCount; Index++)
+    {
+        if (SourceNext(&Sources[Index]))
+            Heap[Count++] = Index;
+    }
+
+    for (Index = Count / 2; Index-- > 0;)
+        SiftDown(Sources, Heap, Count, Index);
+
+    while (Count)
+    {
+        Top = &Sources[Heap[0]];
+        WriteData(Writer, Top->Current.Text, Top->Current.Length);
+        WriteData(Writer, LineEnd, LineEndLength);
+
+        if (!SourceNext(Top))
+            Heap[0] = Heap[--Count];
+        if (Count)
+            SiftDown(Sources, Heap, Count, 0);
+    }
+}
+
+static
+HANDLE
+CreateRunFile(VOID)
+{
+    char Path[MAX_PATH];
+    HANDLE File;
+
+    if (!GetTempFileNameA(tempdir, "srt", 0, Path))
+        Fail("Cannot create a temporary file", 5);
+
+    File = CreateFileA(Path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    if (File == INVALID_HANDLE_VALUE)
+    {
+        DeleteFileA(Path);
+        Fail("Cannot create a temporary file", 5);
+    }
+    return File;
+}
+
+/* Merges sources into a new run and rewinds it for reading */
+static
+PREADER
+WriteRun(PSOURCE Sources, ULONG SourceCount)
+{
+    PREADER Run = AllocOrFail(sizeof(READER));
+    WRITER Writer;
+
+    WriterInit(&Writer, CreateRunFile());
+    Merge(Sources, SourceCount, &Writer, "\n");
+    WriterFree(&Writer);
+
+    if (SetFilePointer(Writer.File, 0, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+        GetLastError() != NO_ERROR)
+    {
+        Fail("Cannot read a temporary file", 5);
+    }
+
+    ReaderInit(Run, Writer.File);
+    return Run;
+}
+
+static
+VOID
+FreeRun(PREADER Run)
+{
+    CloseHandle(Run->File);
+    free(Run->Buffer);
+    free(Run);
+}
+
+static
+VOID
+AddRun(PREADER **Runs, PULONG RunCount, PULONG RunSize, PREADER Run)
+{
+    PREADER *NewRuns;
+
+    if (*RunCount == *RunSize)
+    {
+        *RunSize = max(*RunSize * 2, MAX_MERGE);
+        NewRuns = realloc(*Runs, *RunSize * sizeof(PREADER));
+        if (!NewRuns)
+            Fail("Insufficient memory", 3);
+        *Runs = NewRuns;
+    }
+
+    (*Runs)[(*RunCount)++] = Run;
+}
+
+static
+ULONG
+SegmentSources(PSEGMENT Segments, ULONG SegmentCount, PSOURCE Sources)
+{
+    ULONG Index;
+
+    for (Index = 0; Index < SegmentCount; Index++)
+    {
+        ZeroMemory(&Sources[Index], sizeof(SOURCE));
+        Sources[Index].Next = Segments[Index].Records;
+        Sources[Index].End = Segments[Index].Records + Segments[Index].Count;
+    }
+    return SegmentCount;
+}
+
+static
+ULONG
+RunSources(PREADER *Runs, ULONG RunCount, PSOURCE Sources)
+{
+    ULONG Index;
+
+    for (Index = 0; Index < RunCount; Index++)
+    {
+        ZeroMemory(&Sources[Index], sizeof(SOURCE));
+        Sources[Index].Run = Runs[Index];
+    }
+    return RunCount;
+}
+
+static
+SIZE_T
+DefaultMemory(VOID)
+{
+    MEMORYSTATUSEX Status;
+    ULONG64 Memory = 64 * 1024 * 1024;
+
+    Status.dwLength = sizeof(Status);
+    if (GlobalMemoryStatusEx(&Status))
+        Memory = Status.ullAvailPhys / 2;
+
+    /* Leave most of a 32-bit address space alone */
+    return (SIZE_T)min(max(Memory, MIN_MEMORY), (ULONG64)MAXLONG / 2);
 }
 
 int main(int argc, char **argv)
 {
-    char temp[MAXLEN + 1];
-    char **list;
+    SEGMENT Segments[MAX_THREADS];
+    SOURCE Sources[MAX_MERGE + MAX_THREADS];
+    PREADER *Runs = NULL;
+    ULONG RunCount = 0, RunSize = 0, SegmentCount, Count;
+    const char *InputPath = NULL, *OutputPath = NULL;
+    SIZE_T Memory = 0;
+    HANDLE Input, Output;
+    READER Reader;
+    WRITER Writer;
+    RECORD Record;
+    ARENA Arena;
 
     /* Option character pointer */
     char *cp;
-    int i, nr;
 
     sortcol = 0;
     rev = 0;
@@ -98,6 +569,49 @@ int main(int argc, char **argv)
     {
         if (*(cp = *++argv) == '/')
         {
+            if (!_stricmp(cp, "/M") || !_stricmp(cp, "/MEMORY"))
+            {
+                if (!--argc)
+                {
+                    err++;
+                    break;
+                }
+                Memory = (SIZE_T)strtoul(*++argv, NULL, 10) * 1024;
+                continue;
+            }
+            if (!_stricmp(cp, "/REC") || !_stricmp(cp, "/RECORD_MAXIMUM"))
+            {
+                if (!--argc)
+                {
+                    err++;
+                    break;
+                }
+                recmax = strtoul(*++argv, NULL, 10);
+                if (recmax == 0 || recmax > MAX_RECORD_MAX)
+                    err++;
+                continue;
+            }
+            if (!_stricmp(cp, "/T") || !_stricmp(cp, "/TEMPORARY"))
+            {
+                if (!--argc || strlen(argv[1]) >= MAX_PATH - 14)
+                {
+                    err++;
+                    break;
+                }
+                strcpy(tempdir, *++argv);
+                continue;
+            }
+            if (!_stricmp(cp, "/O") || !_stricmp(cp, "/OUTPUT"))
+            {
+                if (!--argc)
+                {
+                    err++;
+                    break;
+                }
+                OutputPath = *++argv;
+                continue;
+            }
+
             switch (cp[1])
             {
                 case 'R':
@@ -123,6 +637,14 @@ int main(int argc, char **argv)
                     err++;
             }
         }
+        else if (!InputPath)
+        {
+            InputPath = cp;
+        }
+        else
+        {
+            err++;
+        }
     }
 
     if (err || help)
@@ -131,71 +653,102 @@ int main(int argc, char **argv)
         exit(1);
     }
 
-    list = (char **) malloc(MAXRECORDS * sizeof(char *));
-    if (list == NULL)
+    if (!tempdir[0] && !GetTempPathA(sizeof(tempdir), tempdir))
+        strcpy(tempdir, ".");
+
+    if (InputPath)
     {
-        fputs("SORT: Insufficient memory\n", stderr);
-        exit(3);
+        Input = CreateFileA(InputPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (Input == INVALID_HANDLE_VALUE)
+            Fail("Cannot open the input file", 2);
     }
-
-    for (nr = 0; nr < MAXRECORDS; nr++)
+    else
     {
-        if (fgets(temp, MAXLEN, stdin) == NULL)
-        {
-            break;
-        }
+        Input = GetStdHandle(STD_INPUT_HANDLE);
+    }
 
-        if(strlen(temp))
-        {
-            temp[strlen(temp) - 1] = '\0';
-        }
+    /* The budget must hold at least a few of the longest records */
+    if (!Memory)
+        Memory = DefaultMemory();
+    Memory = max(Memory, MIN_MEMORY);
+    Memory = max(Memory, 4 * (recmax + sizeof(RECORD)));
 
-        list[nr] = (char *) malloc(strlen(temp) + 1);
-        if (list[nr] == NULL)
-        {
-            fputs("SORT: Insufficient memory\n", stderr);
+    ZeroMemory(&Arena, sizeof(Arena));
+    while (!(Arena.Base = malloc(Memory)))
+    {
+        if (Memory / 2 < MIN_MEMORY || Memory / 2 < 4 * (recmax + sizeof(RECORD)))
+            Fail("Insufficient memory", 3);
+        Memory /= 2;
+    }
+    Arena.Size = Memory & ~(SIZE_T)(sizeof(PVOID) - 1);
 
-            /* Cleanup memory */
-            for (i = 0; i < nr; i++)
-            {
-                free(list[i]);
-            }
-            free(list);
-            exit(3);
-        }
+    ReaderInit(&Reader, Input);
+    while (ReadRecord(&Reader, &Record))
+    {
+        if (ArenaAdd(&Arena, &Record))
+            continue;
 
-        strcpy(list[nr], temp);
+        /* The budget is full, write it out as a sorted run */
+        SegmentCount = SortArena(&Arena, Segments);
+        AddRun(&Runs, &RunCount, &RunSize,
+               WriteRun(Sources, SegmentSources(Segments, SegmentCount, Sources)));
+        Arena.Used = Arena.Count = 0;
+
+        ArenaAdd(&Arena, &Record);
     }
 
-    if (nr == MAXRECORDS)
+    if (InputPath)
+        CloseHandle(Input);
+    free(Reader.Buffer);
+
+    SegmentCount = SortArena(&Arena, Segments);
+
+    /* Too many runs to merge at once are merged into fewer first */
+    if (RunCount > MAX_MERGE)
     {
-        fputs("SORT: number of records exceeds maximum\n", stderr);
+        AddRun(&Runs, &RunCount, &RunSize,
+               WriteRun(Sources, SegmentSources(Segments, SegmentCount, Sources)));
+        SegmentCount = 0;
 
-        /* Cleanup memory */
-        for (i = 0; i < nr; i++)
+        while (RunCount > MAX_MERGE)
         {
-            free(list[i]);
+            Count = RunSources(Runs, MAX_MERGE, Sources);
+            AddRun(&Runs, &RunCount, &RunSize, WriteRun(Sources, Count));
+            for (Count = 0; Count < MAX_MERGE; Count++)
+                FreeRun(Runs[Count]);
+            RunCount -= MAX_MERGE;
+            memmove(Runs, Runs + MAX_MERGE, RunCount * sizeof(PREADER));
         }
-        free(list);
-
-        /* Bail out */
-        exit(4);
     }
 
-    qsort((void *)list, nr, sizeof(char *), cmpr);
-
-    for (i = 0; i < nr; i++)
+    if (OutputPath)
     {
-        fputs(list[i], stdout);
-        fputs("\n", stdout);
+        Output = CreateFileA(OutputPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL, NULL);
+        if (Output == INVALID_HANDLE_VALUE)
+            Fail("Cannot create the output file", 2);
     }
-
-    /* Cleanup memory */
-    for (i = 0; i < nr; i++)
+    else
     {
-        free(list[i]);
+        Output = GetStdHandle(STD_OUTPUT_HANDLE);
     }
-    free(list);
+
+    Count = RunSources(Runs, RunCount, Sources);
+    Count += SegmentSources(Segments, SegmentCount, Sources + Count);
+
+    WriterInit(&Writer, Output);
+    Merge(Sources, Count, &Writer, "\r\n");
+    WriterFree(&Writer);
+
+    if (OutputPath)
+        CloseHandle(Output);
+
+    /* Cleanup memory */
+    for (Count = 0; Count < RunCount; Count++)
+        FreeRun(Runs[Count]);
+    free(Runs);
+    free(Arena.Base);
     return 0;
 }
 /* EOF */
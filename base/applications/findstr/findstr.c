@@ -25,271 +25,476 @@
  * that contain the string.  Multiple files are clearly separated.
  */
 
-#include <stdio.h>
-#include <stdlib.h>
-//#include <string.h>
-//#include <ctype.h>
-#include <windef.h>
-#include <winbase.h>
-#include <winuser.h>
-//#include <io.h>
-#include <dos.h>
-
-#include "resource.h"
-
-/* Symbol definition */
-#define MAX_STR 1024
-
-
-/* This function prints out all lines containing a substring.  There are some
- * conditions that may be passed to the function.
- *
- * RETURN: If the string was found at least once, returns 1.
- * If the string was not found at all, returns 0.
- */
-int
-find_str (char *sz, FILE *p, int invert_search,
-          int count_lines, int number_output, int ignore_case, int at_start, int literal_search,
-		  int at_end, int reg_express, int exact_match, int sub_dirs, int only_fname)
+#include "findstr.h"
+
+/* Files a search may run ahead of the output, per thread */
+#define JOBS_PER_THREAD 4
+#define MAX_THREADS     16
+
+typedef struct _FILE_LIST
+{
+    char **Paths;
+    ULONG Count;
+    ULONG Size;
+} FILE_LIST, *PFILE_LIST;
+
+/* One file of a threaded search, kept until its output is due */
+typedef struct _JOB
+{
+    const char *Path;
+    OUTPUT Output;
+    BOOL Opened;
+    BOOL Found;
+    volatile LONG Done;
+} JOB, *PJOB;
+
+typedef struct _POOL
+{
+    PSEARCH Search;
+    PJOB Jobs;
+    ULONG JobCount;
+    volatile LONG NextJob;
+    HANDLE Slots;
+    HANDLE JobDone;
+} POOL, *PPOOL;
+
+static
+VOID
+PrintMessage(UINT Id, const char *Path)
+{
+    char Message[4096];
+
+    LoadStringA(GetModuleHandle(NULL), Id, Message, sizeof(Message));
+    CharToOemA(Message, Message);
+    fprintf(stderr, Message, Path);
+}
+
+/* Show usage */
+static
+VOID
+Usage(VOID)
+{
+    char Usage[4096];
+
+    LoadStringA(GetModuleHandle(NULL), IDS_USAGE, Usage, sizeof(Usage));
+    CharToOemA(Usage, Usage);
+    fputs(Usage, stdout);
+}
+
+static
+BOOL
+AddFile(PFILE_LIST List, const char *Path)
+{
+    char **NewPaths;
+    ULONG NewSize;
+
+    if (List->Count == List->Size)
+    {
+        NewSize = max(List->Size * 2, 64);
+        NewPaths = realloc(List->Paths, NewSize * sizeof(char *));
+        if (!NewPaths)
+            return FALSE;
+        List->Paths = NewPaths;
+        List->Size = NewSize;
+    }
+
+    List->Paths[List->Count] = _strdup(Path);
+    if (!List->Paths[List->Count])
+        return FALSE;
+    List->Count++;
+    return TRUE;
+}
+
+static
+VOID
+FreeFiles(PFILE_LIST List)
+{
+    ULONG i;
+
+    for (i = 0; i < List->Count; i++)
+        free(List->Paths[i]);
+    free(List->Paths);
+}
+
+/* Adds the files matching the mask in a directory, and in all the
+ * directories below it for /S. Dir is empty or ends with a separator. */
+static
+ULONG
+FindFiles(PFILE_LIST List, const char *Dir, const char *Mask, BOOL SubDirs)
 {
-  int i, length;
-  long line_number = 0, total_lines = 0;
-  char *c, temp_str[MAX_STR], this_line[MAX_STR];
+    WIN32_FIND_DATAA FindData;
+    char Path[MAX_PATH];
+    HANDLE Find;
+    ULONG Found = 0;
 
-  /* Convert to upper if needed */
-  if (ignore_case)
+    if (_snprintf(Path, sizeof(Path), "%s%s", Dir, Mask) < 0)
+        return 0;
+    Path[MAX_PATH - 1] = '\0';
+
+    Find = FindFirstFileA(Path, &FindData);
+    if (Find != INVALID_HANDLE_VALUE)
     {
-      length = strlen (sz);
-      for (i = 0; i < length; i++)
-	sz[i] = toupper (sz[i]);
+        do
+        {
+            if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                continue;
+            if (_snprintf(Path, sizeof(Path), "%s%s", Dir, FindData.cFileName) < 0)
+                continue;
+            Path[MAX_PATH - 1] = '\0';
+            if (AddFile(List, Path))
+                Found++;
+        }
+        while (FindNextFileA(Find, &FindData));
+        FindClose(Find);
     }
 
-  /* Scan the file until EOF */
-  while (fgets (temp_str, MAX_STR, p) != NULL)
+    if (!SubDirs)
+        return Found;
+
+    if (_snprintf(Path, sizeof(Path), "%s*", Dir) < 0)
+        return Found;
+    Path[MAX_PATH - 1] = '\0';
+
+    Find = FindFirstFileA(Path, &FindData);
+    if (Find == INVALID_HANDLE_VALUE)
+        return Found;
+
+    do
     {
-      /* Remove the trailing newline */
-      length = strlen (temp_str);
-      if (temp_str[length-1] == '\n')
-	{
-	  temp_str[length-1] = '\0';
-	}
-
-      /* Increment number of lines */
-      line_number++;
-      strcpy (this_line, temp_str);
-
-      /* Convert to upper if needed */
-      if (ignore_case)
-	{
-	  for (i = 0; i < length; i++)
-	    {
-	      temp_str[i] = toupper (temp_str[i]);
-	    }
-	}
-
-      /* Locate the substring */
-
-      /* strstr() returns a pointer to the first occurrence in the
-       string of the substring */
-      c = strstr (temp_str, sz);
-
-      if ( ((invert_search) ? (c == NULL) : (c != NULL)) )
-	{
-	  if (!count_lines)
-	    {
-	      if (number_output)
-		printf ("%ld:", line_number);
-
-	      /* Print the line of text */
-	      puts (this_line);
-	    }
-
-	  total_lines++;
-	} /* long if */
-    } /* while fgets */
-
-  if (count_lines)
+        if (!(FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ||
+            (FindData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) ||
+            !strcmp(FindData.cFileName, ".") || !strcmp(FindData.cFileName, ".."))
+        {
+            continue;
+        }
+        if (_snprintf(Path, sizeof(Path), "%s%s\\", Dir, FindData.cFileName) < 0)
+            continue;
+        Path[MAX_PATH - 1] = '\0';
+        Found += FindFiles(List, Path, Mask, TRUE);
+    }
+    while (FindNextFileA(Find, &FindData));
+    FindClose(Find);
+
+    return Found;
+}
+
+/* Splits a file argument into its directory and its mask */
+static
+ULONG
+AddFiles(PFILE_LIST List, const char *Spec, BOOL SubDirs)
+{
+    char Dir[MAX_PATH];
+    const char *Mask;
+    SIZE_T Length;
+
+    for (Mask = Spec + strlen(Spec); Mask > Spec; Mask--)
     {
-      /* Just show num. lines that contain the string */
-      printf ("%ld\n", total_lines);
+        if (Mask[-1] == '\\' || Mask[-1] == '/' || Mask[-1] == ':')
+            break;
     }
 
+    Length = Mask - Spec;
+    if (Length >= sizeof(Dir))
+        return 0;
+    memcpy(Dir, Spec, Length);
+    Dir[Length] = '\0';
 
- /* RETURN: If the string was found at least once, returns 1.
-  * If the string was not found at all, returns 0.
-  */
-  return (total_lines > 0 ? 1 : 0);
+    return FindFiles(List, Dir, *Mask ? Mask : "*", SubDirs);
 }
 
-/* Show usage */
-void
-usage (void)
+static
+VOID
+PrintTotals(PSEARCH Search, const char *Path, PLINE_STATE State, POUTPUT Output)
+{
+    if (Search->Options.FileNames)
+    {
+        if (State->Matches && Path)
+            OutputPrintf(Output, "%s\n", Path);
+    }
+    else if (Search->Options.Count)
+    {
+        OutputPrintf(Output, "%I64u\n", State->Matches);
+    }
+}
+
+/* Searches one file into an output, returns FALSE if it cannot be opened */
+static
+BOOL
+SearchOneFile(PSEARCH Search, const char *Path, POUTPUT Output, PBOOL Found)
 {
-	TCHAR lpUsage[4096];
+    LINE_STATE State = { 0, 0 };
+    HANDLE File;
+
+    File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                       NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (File == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    if (!Search->Options.FileNames)
+        OutputPrintf(Output, "---------------- %s\n", Path);
+
+    SearchFile(Search, File, &State, Output);
+    CloseHandle(File);
 
-	LoadString( GetModuleHandle(NULL), IDS_USAGE, (LPTSTR)lpUsage, 4096);
-	CharToOem(lpUsage, lpUsage);
-	printf( lpUsage );
+    PrintTotals(Search, Path, &State, Output);
+    *Found = (State.Matches != 0);
+    return TRUE;
 }
 
+static
+DWORD
+WINAPI
+SearchWorker(PVOID Context)
+{
+    PPOOL Pool = Context;
+    SEARCH Search;
+    PJOB Job;
+    LONG Index;
+
+    /* The patterns remember where they were found, every thread needs its own */
+    Search = *Pool->Search;
+    Search.Patterns = malloc(Search.PatternCount * sizeof(PATTERN));
+    if (Search.Patterns)
+        memcpy(Search.Patterns, Pool->Search->Patterns, Search.PatternCount * sizeof(PATTERN));
+
+    for (;;)
+    {
+        WaitForSingleObject(Pool->Slots, INFINITE);
+
+        Index = InterlockedIncrement(&Pool->NextJob) - 1;
+        if ((ULONG)Index >= Pool->JobCount)
+        {
+            ReleaseSemaphore(Pool->Slots, 1, NULL);
+            break;
+        }
+
+        Job = &Pool->Jobs[Index];
+        if (Search.Patterns)
+            Job->Opened = SearchOneFile(&Search, Job->Path, &Job->Output, &Job->Found);
+
+        InterlockedExchange(&Job->Done, TRUE);
+        SetEvent(Pool->JobDone);
+    }
+
+    free(Search.Patterns);
+    return 0;
+}
+
+/* Searches the files on a pool of threads and prints them in order */
+static
+BOOL
+SearchFilesThreaded(PSEARCH Search, PFILE_LIST List, ULONG ThreadCount, PBOOL Found)
+{
+    HANDLE Threads[MAX_THREADS];
+    ULONG i, Started = 0;
+    POOL Pool;
+
+    ZeroMemory(&Pool, sizeof(Pool));
+    Pool.Search = Search;
+    Pool.JobCount = List->Count;
+    Pool.Jobs = calloc(List->Count, sizeof(JOB));
+    Pool.Slots = CreateSemaphoreA(NULL, ThreadCount * JOBS_PER_THREAD,
+                                  ThreadCount * JOBS_PER_THREAD, NULL);
+    Pool.JobDone = CreateEventA(NULL, FALSE, FALSE, NULL);
+
+    if (Pool.Jobs && Pool.Slots && Pool.JobDone)
+    {
+        for (i = 0; i < List->Count; i++)
+            Pool.Jobs[i].Path = List->Paths[i];
+
+        for (i = 0; i < ThreadCount; i++)
+        {
+            Threads[Started] = CreateThread(NULL, 0, SearchWorker, &Pool, 0, NULL);
+            if (Threads[Started])
+                Started++;
+        }
+    }
+
+    if (!Started)
+    {
+        if (Pool.JobDone)
+            CloseHandle(Pool.JobDone);
+        if (Pool.Slots)
+            CloseHandle(Pool.Slots);
+        free(Pool.Jobs);
+        return FALSE;
+    }
+
+    for (i = 0; i < List->Count; i++)
+    {
+        while (!Pool.Jobs[i].Done)
+            WaitForSingleObject(Pool.JobDone, INFINITE);
+
+        if (Pool.Jobs[i].Opened)
+        {
+            fwrite(Pool.Jobs[i].Output.Data, 1, Pool.Jobs[i].Output.Length, stdout);
+            *Found |= Pool.Jobs[i].Found;
+        }
+        else
+        {
+            fflush(stdout);
+            PrintMessage(IDS_CANNOT_OPEN, Pool.Jobs[i].Path);
+        }
+
+        OutputFree(&Pool.Jobs[i].Output);
+        ReleaseSemaphore(Pool.Slots, 1, NULL);
+    }
+
+    WaitForMultipleObjects(Started, Threads, TRUE, INFINITE);
+    for (i = 0; i < Started; i++)
+        CloseHandle(Threads[i]);
+    CloseHandle(Pool.JobDone);
+    CloseHandle(Pool.Slots);
+    free(Pool.Jobs);
+    return TRUE;
+}
+
+static
+VOID
+SearchFiles(PSEARCH Search, PFILE_LIST List, PBOOL Found)
+{
+    OUTPUT Output = { NULL, 0, 0, stdout };
+    SYSTEM_INFO SystemInfo;
+    ULONG ThreadCount, i;
+    BOOL FileFound;
+
+    GetSystemInfo(&SystemInfo);
+    ThreadCount = min(SystemInfo.dwNumberOfProcessors, MAX_THREADS);
+    ThreadCount = min(ThreadCount, List->Count);
+
+    if (ThreadCount > 1 && SearchFilesThreaded(Search, List, ThreadCount, Found))
+        return;
+
+    for (i = 0; i < List->Count; i++)
+    {
+        if (SearchOneFile(Search, List->Paths[i], &Output, &FileFound))
+        {
+            *Found |= FileFound;
+        }
+        else
+        {
+            OutputFlush(&Output);
+            fflush(stdout);
+            PrintMessage(IDS_CANNOT_OPEN, List->Paths[i]);
+        }
+    }
+    OutputFree(&Output);
+}
 
 /* Main program */
 int
-main (int argc, char **argv)
+main(int argc, char **argv)
 {
-  char *opt, *needle = NULL;
-  int ret = 0;
-  TCHAR lpMessage[4096];
-
-  int invert_search = 0;		/* flag to invert the search */
-  int count_lines = 0;			/* flag to whether/not count lines */
-  int number_output = 0;		/* flag to print line numbers */
-  int ignore_case = 0;			/* flag to be case insensitive */
-  int at_start = 0;				/* flag to Match if at the beginning of a line. */
-  int at_end = 0;	        	/* flag to Match if at the beginning of a line. */
-  int reg_express = 0;		   /* flag to use/not use regular expressions */
-  int exact_match = 0;			/* flag to be exact match */
-  int sub_dirs= 0;				/* this and all subdirectories */
-  int only_fname= 0;			/* print only the name of the file*/
-  int literal_search=0;
-
-  FILE *pfile;				/* file pointer */
-  int hfind;				/* search handle */
-  struct _finddata_t finddata;		/* _findfirst, filenext block */
-
-  /* Scan the command line */
-  while ((--argc) && (needle == NULL))
+    OUTPUT Output = { NULL, 0, 0, stdout };
+    LINE_STATE State = { 0, 0 };
+    FILE_LIST Files = { NULL, 0, 0 };
+    PFINDSTR_OPTIONS Options;
+    SEARCH Search;
+    const char **Strings;
+    ULONG StringCount = 0, MaxStrings = 1;
+    BOOL HaveString = FALSE, Found = FALSE;
+    char *Arg, *Word;
+    int i;
+
+    ZeroMemory(&Search, sizeof(Search));
+    Options = &Search.Options;
+
+    for (i = 1; i < argc; i++)
+        MaxStrings += (ULONG)strlen(argv[i]) / 2 + 1;
+    Strings = malloc(MaxStrings * sizeof(char *));
+    if (!Strings)
+        return 2;
+
+    /* Scan the command line, the options come before the search string */
+    for (i = 1; i < argc; i++)
     {
-      if (*(opt = *++argv) == '/')
+        Arg = argv[i];
+
+        if (Arg[0] == '/' && !HaveString)
         {
-          switch (opt[1])
-	    {
-	      case 'b':
-	      case 'B':		/* Matches pattern if at the beginning of a line */
-	        at_start = 1;
-	        break;
-
-	      //case 'c':
-	      //case 'C':		/* Literal? */
-	      //  literal_search = 1;
-	      //  break;
-
-	      case 'e':
-	      case 'E':		/* matches pattern if at end of line */
-	        at_end = 1;
-	        break;
-
-	      case 'i':
-	      case 'I':		/* Ignore */
-	        ignore_case = 1;
-	        break;
-
-	      case 'm':
-	      case 'M':		/* only filename */
-	        only_fname = 1;
-	        break;
-
-	      case 'n':
-	      case 'N':		/* Number */
-	        number_output = 1;
-	        break;
-
-	      case 'r':
-	      case 'R':		/* search strings as regular expressions */
-	        reg_express = 1;
-	        break;
-
-	      case 's':
-	      case 'S':		/* search files in child directory too*/
-	        sub_dirs = 1;
-	        break;
-
-	      case 'v':
-	      case 'V':		/* Not with */
-	        invert_search = 1;
-	        break;
-
-	      case 'x':
-	      case 'X':		/* exact match */
-	        exact_match = 1;
-	        break;
-
-	      default:
-	        usage ();
-	        exit (2);		/* syntax error .. return error 2 */
-	        break;
-	    }
+            /* /C:string is searched for as a whole, spaces included */
+            if ((Arg[1] == 'c' || Arg[1] == 'C') && Arg[2] == ':')
+            {
+                Strings[StringCount++] = Arg + 3;
+                continue;
+            }
+
+            for (Arg++; *Arg; Arg++)
+            {
+                switch (*Arg)
+                {
+                    case 'b': case 'B': Options->AtStart = TRUE; break;
+                    case 'c': case 'C': Options->Count = TRUE; break;
+                    case 'e': case 'E': Options->AtEnd = TRUE; break;
+                    case 'i': case 'I': Options->IgnoreCase = TRUE; break;
+                    case 'l': case 'L': Options->Regex = FALSE; break;
+                    case 'm': case 'M': Options->FileNames = TRUE; break;
+                    case 'n': case 'N': Options->Number = TRUE; break;
+                    case 'r': case 'R': Options->Regex = TRUE; break;
+                    case 's': case 'S': Options->SubDirs = TRUE; break;
+                    case 'v': case 'V': Options->Invert = TRUE; break;
+                    case 'x': case 'X': Options->Exact = TRUE; break;
+                    default:
+                        Usage();
+                        return 2;   /* syntax error .. return error 2 */
+                }
+            }
+            continue;
         }
-      else
+
+        /* Without /C: the first argument holds the space separated strings */
+        if (!HaveString && !StringCount)
         {
-          /* Get the string */
-	  if (needle == NULL)
-	    {
-              /* Assign the string to find */
-              needle = *argv;
-	    }
-	}
+            HaveString = TRUE;
+            for (Word = strtok(Arg, " "); Word; Word = strtok(NULL, " "))
+                Strings[StringCount++] = Word;
+            continue;
+        }
+
+        break;
     }
 
-  /* Check for search string */
-  if (needle == NULL)
+    /* Check for search string */
+    if (!StringCount)
     {
-      /* No string? */
-      usage ();
-      exit (1);
+        free(Strings);
+        Usage();
+        return 1;
     }
 
-  /* Scan the files for the string */
-  if (argc == 0)
+    /* Or a bad regular expression */
+    if (!SearchInitialize(&Search, Strings, StringCount))
     {
-      ret = find_str (needle, stdin, invert_search, count_lines,
-                      number_output, ignore_case, at_start, literal_search, at_end, reg_express, exact_match,
-					  sub_dirs, only_fname);
+        SearchCleanup(&Search);
+        free(Strings);
+        Usage();
+        return 2;
     }
 
-  while (--argc >= 0)
+    if (i == argc)
     {
-      hfind = _findfirst (*++argv, &finddata);
-      if (hfind < 0)
-	{
-	  /* We were not able to find a file. Display a message and
-	     set the exit status. */
-	  LoadString( GetModuleHandle(NULL), IDS_NO_SUCH_FILE, (LPTSTR)lpMessage, 4096);
-	  CharToOem(lpMessage, lpMessage);
-	  fprintf (stderr, lpMessage, *argv);//
-	}
-      else
+        /* Scan the standard input for the string */
+        SearchHandle(&Search, GetStdHandle(STD_INPUT_HANDLE), &State, &Output);
+        PrintTotals(&Search, NULL, &State, &Output);
+        Found = (State.Matches != 0);
+        OutputFree(&Output);
+    }
+    else
+    {
+        for (; i < argc; i++)
         {
-          /* repeat find next file to match the filemask */
-	  do
-            {
-              /* We have found a file, so try to open it */
-	      if ((pfile = fopen (finddata.name, "r")) != NULL)
-	        {
-	          printf ("---------------- %s\n", finddata.name);
-	          ret = find_str (needle, pfile, invert_search, count_lines,
-                      number_output, ignore_case, at_start, literal_search, at_end, reg_express, exact_match,
-					  sub_dirs, only_fname);
-	          fclose (pfile);
-	        }
- 	      else
-	        {
-	          LoadString(GetModuleHandle(NULL), IDS_CANNOT_OPEN, (LPTSTR)lpMessage, 4096);
-	          CharToOem(lpMessage, lpMessage);
-	          fprintf (stderr, lpMessage,
-		           finddata.name);
-                }
-	    }
-          while (_findnext(hfind, &finddata) > 0);
+            /* We were not able to find a file. Display a message. */
+            if (!AddFiles(&Files, argv[i], Options->SubDirs))
+                PrintMessage(IDS_NO_SUCH_FILE, argv[i]);
         }
-      _findclose(hfind);
-    } /* for each argv */
-
- /* RETURN: If the string was found at least once, returns 0.
-  * If the string was not found at all, returns 1.
-  * (Note that find_str.c returns the exact opposite values.)
-  */
-  exit ( (ret ? 0 : 1) );
-}
+        SearchFiles(&Search, &Files, &Found);
+        FreeFiles(&Files);
+    }
 
+    SearchCleanup(&Search);
+    free(Strings);
 
+    /* RETURN: If the string was found at least once, returns 0.
+     * If the string was not found at all, returns 1. */
+    return Found ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+/*
+ * PROJECT:     ReactOS Findstr Command
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Shared definitions of the search engine
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windef.h>
+#include <winbase.h>
+#include <winuser.h>
+
+#include "resource.h"
+
+typedef struct _FINDSTR_OPTIONS
+{
+    BOOL Invert;        /* /V */
+    BOOL Count;         /* /C */
+    BOOL Number;        /* /N */
+    BOOL IgnoreCase;    /* /I */
+    BOOL AtStart;       /* /B */
+    BOOL AtEnd;         /* /E */
+    BOOL Regex;         /* /R */
+    BOOL Exact;         /* /X */
+    BOOL SubDirs;       /* /S */
+    BOOL FileNames;     /* /M */
+} FINDSTR_OPTIONS, *PFINDSTR_OPTIONS;
+
+/* regex.c */
+typedef struct _REGEX REGEX, *PREGEX;
+
+PREGEX RegexCompile(const char *Pattern, const UCHAR *Fold, BOOL AtStart, BOOL AtEnd);
+BOOL RegexMatch(PREGEX Regex, const UCHAR *Line, SIZE_T Length);
+VOID RegexFree(PREGEX Regex);
+
+/* One of the space separated search strings */
+typedef struct _PATTERN
+{
+    PUCHAR Text;        /* Folded when ignoring case */
+    SIZE_T Length;
+    SIZE_T Skip[256];   /* Boyer-Moore-Horspool shifts, by input byte */
+    PREGEX Regex;
+
+    /* Where the pattern next occurs in the buffer being searched */
+    const UCHAR *Next;
+} PATTERN, *PPATTERN;
+
+typedef struct _SEARCH
+{
+    FINDSTR_OPTIONS Options;
+    ULONG PatternCount;
+    PPATTERN Patterns;
+    UCHAR Fold[256];
+} SEARCH, *PSEARCH;
+
+/* Collects the output of one file. A buffer with a stream is flushed to
+ * it, the worker threads keep theirs until the file's turn comes. */
+typedef struct _OUTPUT
+{
+    PCHAR Data;
+    SIZE_T Length;
+    SIZE_T Size;
+    FILE *Stream;
+} OUTPUT, *POUTPUT;
+
+/* Running totals of one input */
+typedef struct _LINE_STATE
+{
+    ULONG64 LineNumber;
+    ULONG64 Matches;
+} LINE_STATE, *PLINE_STATE;
+
+/* search.c */
+BOOL SearchInitialize(PSEARCH Search, const char **Strings, ULONG StringCount);
+VOID SearchCleanup(PSEARCH Search);
+VOID SearchBuffer(PSEARCH Search, const UCHAR *Buffer, SIZE_T Length,
+                  PLINE_STATE State, POUTPUT Output);
+BOOL SearchHandle(PSEARCH Search, HANDLE File, PLINE_STATE State, POUTPUT Output);
+BOOL SearchFile(PSEARCH Search, HANDLE File, PLINE_STATE State, POUTPUT Output);
+
+BOOL OutputWrite(POUTPUT Output, const void *Data, SIZE_T Length);
+BOOL OutputPrintf(POUTPUT Output, const char *Format, ...);
+VOID OutputFlush(POUTPUT Output);
+VOID OutputFree(POUTPUT Output);
@@ -0,0 +1,326 @@
+/*
+ * PROJECT:     ReactOS Findstr Command
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Regular expressions of findstr /R
+ */
+
+#include "findstr.h"
+
+/*
+ * The expressions are compiled to a list of nodes: byte sets that consume
+ * one character, optionally repeated, and assertions that consume nothing.
+ * Matching runs all the possible positions in the list at once, so a line
+ * is never looked at twice and there is no backtracking.
+ */
+
+#define REGEX_MAX_NODES 256
+
+enum
+{
+    NODE_SET,
+    NODE_LINE_START,    /* ^ */
+    NODE_LINE_END,      /* $ */
+    NODE_WORD_START,    /* \< */
+    NODE_WORD_END       /* \> */
+};
+
+typedef struct _REGEX_NODE
+{
+    UCHAR Type;
+    BOOLEAN Star;
+    UCHAR Set[32];
+} REGEX_NODE, *PREGEX_NODE;
+
+struct _REGEX
+{
+    ULONG Count;
+    BOOLEAN Anchored;
+    UCHAR Word[32];
+    REGEX_NODE Nodes[REGEX_MAX_NODES];
+};
+
+/*
+ * The states active at one position, the node count being the accepting
+ * state. A state is in the list if its Index entry points back at it, so
+ * the list is emptied by resetting Count and never needs to be cleared.
+ */
+typedef struct _STATE_LIST
+{
+    ULONG Count;
+    USHORT States[REGEX_MAX_NODES + 1];
+    USHORT Index[REGEX_MAX_NODES + 1];
+} STATE_LIST, *PSTATE_LIST;
+
+#define LIST_HAS(List, State) \
+    ((List)->Index[State] < (List)->Count && (List)->States[(List)->Index[State]] == (State))
+
+#define SET_HAS(Set, Byte) ((Set)[(Byte) >> 3] & (1 << ((Byte) & 7)))
+#define SET_ADD(Set, Byte) ((Set)[(Byte) >> 3] |= (1 << ((Byte) & 7)))
+
+static
+VOID
+AddByte(PREGEX_NODE Node, UCHAR Byte, const UCHAR *Fold)
+{
+    ULONG i;
+
+    SET_ADD(Node->Set, Byte);
+    for (i = 0; i < 256; i++)
+    {
+        if (Fold[i] == Fold[Byte])
+            SET_ADD(Node->Set, i);
+    }
+}
+
+/* Parses a [class] after its opening bracket, returns past the closing one */
+static
+const char *
+ParseClass(PREGEX_NODE Node, const char *Pattern, const UCHAR *Fold)
+{
+    const UCHAR *Pos = (const UCHAR *)Pattern;
+    BOOLEAN Negate = FALSE;
+    ULONG Byte, Last, i;
+
+    if (*Pos == '^')
+    {
+        Negate = TRUE;
+        Pos++;
+    }
+
+    while (*Pos != ']')
+    {
+        if (!*Pos)
+            return NULL;
+
+        Byte = *Pos++;
+        if (Pos[0] == '-' && Pos[1] && Pos[1] != ']')
+        {
+            Last = Pos[1];
+            Pos += 2;
+            if (Last < Byte)
+                return NULL;
+            for (; Byte <= Last; Byte++)
+                AddByte(Node, (UCHAR)Byte, Fold);
+        }
+        else
+        {
+            AddByte(Node, (UCHAR)Byte, Fold);
+        }
+    }
+
+    if (Negate)
+    {
+        for (i = 0; i < sizeof(Node->Set); i++)
+            Node->Set[i] = ~Node->Set[i];
+    }
+    return (const char *)Pos + 1;
+}
+
+PREGEX
+RegexCompile(const char *Pattern, const UCHAR *Fold, BOOL AtStart, BOOL AtEnd)
+{
+    const char *Pos = Pattern;
+    PREGEX_NODE Node;
+    PREGEX Regex;
+    ULONG i;
+
+    Regex = calloc(1, sizeof(*Regex));
+    if (!Regex)
+        return NULL;
+
+    for (i = 0; i < 256; i++)
+    {
+        if (i == '_' || IsCharAlphaNumericA((CHAR)i))
+            SET_ADD(Regex->Word, i);
+    }
+
+    if (AtStart && *Pos != '^')
+        Regex->Nodes[Regex->Count++].Type = NODE_LINE_START;
+
+    while (*Pos)
+    {
+        /* Leave room for the $ of /E */
+        if (Regex->Count >= REGEX_MAX_NODES - 1)
+            goto Fail;
+
+        Node = &Regex->Nodes[Regex->Count];
+
+        switch (*Pos)
+        {
+            case '^':
+                if (Pos != Pattern)
+                    goto Literal;
+                Node->Type = NODE_LINE_START;
+                Pos++;
+                break;
+
+            case '$':
+                if (Pos[1])
+                    goto Literal;
+                Node->Type = NODE_LINE_END;
+                Pos++;
+                break;
+
+            case '*':
+                /* A star repeats what comes before it, if anything */
+                if (!Regex->Count || Node[-1].Type != NODE_SET || Node[-1].Star)
+                    goto Literal;
+                Node[-1].Star = TRUE;
+                Pos++;
+                continue;
+
+            case '.':
+                Node->Type = NODE_SET;
+                RtlFillMemory(Node->Set, sizeof(Node->Set), 0xFF);
+                Pos++;
+                break;
+
+            case '[':
+                Node->Type = NODE_SET;
+                Pos = ParseClass(Node, Pos + 1, Fold);
+                if (!Pos)
+                    goto Fail;
+                break;
+
+            case '\\':
+                if (Pos[1] == '<' || Pos[1] == '>')
+                {
+                    Node->Type = (Pos[1] == '<') ? NODE_WORD_START : NODE_WORD_END;
+                    Pos += 2;
+                    break;
+                }
+                if (Pos[1])
+                    Pos++;
+                /* Fall through */
+
+            default:
+Literal:
+                Node->Type = NODE_SET;
+                AddByte(Node, (UCHAR)*Pos, Fold);
+                Pos++;
+                break;
+        }
+
+        Regex->Count++;
+    }
+
+    if (AtEnd && (!Regex->Count || Regex->Nodes[Regex->Count - 1].Type != NODE_LINE_END))
+        Regex->Nodes[Regex->Count++].Type = NODE_LINE_END;
+
+    Regex->Anchored = (Regex->Count && Regex->Nodes[0].Type == NODE_LINE_START);
+    return Regex;
+
+Fail:
+    free(Regex);
+    return NULL;
+}
+
+VOID
+RegexFree(PREGEX Regex)
+{
+    free(Regex);
+}
+
+static
+BOOL
+IsWordAt(PREGEX Regex, const UCHAR *Line, SIZE_T Length, SIZE_T Pos)
+{
+    return Pos < Length && SET_HAS(Regex->Word, Line[Pos]);
+}
+
+/* Adds a state and everything it leads to without consuming a character */
+static
+VOID
+AddState(PREGEX Regex, PSTATE_LIST List, ULONG Index,
+         const UCHAR *Line, SIZE_T Length, SIZE_T Pos)
+{
+    PREGEX_NODE Node;
+    BOOL Pass;
+
+    for (;;)
+    {
+        if (LIST_HAS(List, Index))
+            return;
+        List->Index[Index] = (USHORT)List->Count;
+        List->States[List->Count++] = (USHORT)Index;
+
+        if (Index == Regex->Count)
+            return;
+
+        Node = &Regex->Nodes[Index];
+        switch (Node->Type)
+        {
+            case NODE_SET:
+                /* A repeated set may also be skipped */
+                if (!Node->Star)
+                    return;
+                Pass = TRUE;
+                break;
+            case NODE_LINE_START:
+                Pass = (Pos == 0);
+                break;
+            case NODE_LINE_END:
+                Pass = (Pos == Length);
+                break;
+            case NODE_WORD_START:
+                Pass = (Pos == 0 || !IsWordAt(Regex, Line, Length, Pos - 1)) &&
+                       IsWordAt(Regex, Line, Length, Pos);
+                break;
+            default:
+                Pass = (Pos != 0 && IsWordAt(Regex, Line, Length, Pos - 1)) &&
+                       !IsWordAt(Regex, Line, Length, Pos);
+                break;
+        }
+
+        if (!Pass)
+            return;
+        Index++;
+    }
+}
+
+BOOL
+RegexMatch(PREGEX Regex, const UCHAR *Line, SIZE_T Length)
+{
+    STATE_LIST Lists[2];
+    PSTATE_LIST Current = &Lists[0], Next = &Lists[1], Swap;
+    PREGEX_NODE Node;
+    SIZE_T Pos;
+    ULONG i;
+    UCHAR Byte;
+
+    Current->Count = 0;
+    AddState(Regex, Current, 0, Line, Length, 0);
+
+    for (Pos = 0; ; Pos++)
+    {
+        if (LIST_HAS(Current, Regex->Count))
+            return TRUE;
+        if (Pos == Length)
+            return FALSE;
+
+        Byte = Line[Pos];
+        Next->Count = 0;
+
+        for (i = 0; i < Current->Count; i++)
+        {
+            Node = &Regex->Nodes[Current->States[i]];
+            if (Current->States[i] == Regex->Count ||
+                Node->Type != NODE_SET || !SET_HAS(Node->Set, Byte))
+            {
+                continue;
+            }
+
+            AddState(Regex, Next, Current->States[i] + (Node->Star ? 0 : 1),
+                     Line, Length, Pos + 1);
+        }
+
+        /* Unanchored expressions may also start at the next character */
+        if (!Regex->Anchored)
+            AddState(Regex, Next, 0, Line, Length, Pos + 1);
+        else if (!Next->Count)
+            return FALSE;
+
+        Swap = Current;
+        Current = Next;
+        Next = Swap;
+    }
+}
@@ -0,0 +1,539 @@
+/*
+ * PROJECT:     ReactOS Findstr Command
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Searching buffers, mapped files and streams
+ */
+
+#include "findstr.h"
+
+#include <stdarg.h>
+
+/* Files are mapped this much at a time, streams are read in these chunks */
+#define VIEW_SIZE       (64 * 1024 * 1024)
+#define STREAM_CHUNK    (1024 * 1024)
+
+/* A buffer with a stream is written out once it holds this much */
+#define OUTPUT_FLUSH    (64 * 1024)
+
+BOOL
+OutputWrite(POUTPUT Output, const void *Data, SIZE_T Length)
+{
+    PCHAR NewData;
+    SIZE_T NewSize;
+
+    if (Output->Length + Length > Output->Size)
+    {
+        NewSize = max(Output->Size * 2, Output->Length + Length);
+        NewSize = max(NewSize, 4096);
+        NewData = realloc(Output->Data, NewSize);
+        if (!NewData)
+            return FALSE;
+        Output->Data = NewData;
+        Output->Size = NewSize;
+    }
+
+    memcpy(Output->Data + Output->Length, Data, Length);
+    Output->Length += Length;
+
+    if (Output->Stream && Output->Length >= OUTPUT_FLUSH)
+        OutputFlush(Output);
+    return TRUE;
+}
+
+BOOL
+OutputPrintf(POUTPUT Output, const char *Format, ...)
+{
+    char Buffer[2 * MAX_PATH + 64];
+    va_list Args;
+    int Length;
+
+    va_start(Args, Format);
+    Length = _vsnprintf(Buffer, sizeof(Buffer) - 1, Format, Args);
+    va_end(Args);
+
+    if (Length < 0)
+        Length = sizeof(Buffer) - 1;
+    return OutputWrite(Output, Buffer, Length);
+}
+
+VOID
+OutputFlush(POUTPUT Output)
+{
+    if (Output->Stream && Output->Length)
+    {
+        fwrite(Output->Data, 1, Output->Length, Output->Stream);
+        Output->Length = 0;
+    }
+}
+
+VOID
+OutputFree(POUTPUT Output)
+{
+    OutputFlush(Output);
+    free(Output->Data);
+    Output->Data = NULL;
+    Output->Length = Output->Size = 0;
+}
+
+static
+BOOL
+AddPattern(PSEARCH Search, const char *Text, SIZE_T Length)
+{
+    PPATTERN Pattern = &Search->Patterns[Search->PatternCount];
+    SIZE_T FoldedSkip[256];
+    SIZE_T i, Last;
+
+    if (!Length)
+        return TRUE;
+
+    ZeroMemory(Pattern, sizeof(*Pattern));
+    Pattern->Text = malloc(Length + 1);
+    if (!Pattern->Text)
+        return FALSE;
+
+    Pattern->Length = Length;
+    Pattern->Text[Length] = '\0';
+
+    if (Search->Options.Regex)
+    {
+        /* The compiled sets do the folding */
+        memcpy(Pattern->Text, Text, Length);
+        Pattern->Regex = RegexCompile((const char *)Pattern->Text, Search->Fold,
+                                      Search->Options.AtStart || Search->Options.Exact,
+                                      Search->Options.AtEnd || Search->Options.Exact);
+        if (!Pattern->Regex)
+        {
+            free(Pattern->Text);
+            return FALSE;
+        }
+    }
+    else
+    {
+        for (i = 0; i < Length; i++)
+            Pattern->Text[i] = Search->Fold[(UCHAR)Text[i]];
+
+        /* Every byte that folds to a pattern byte shifts the same */
+        Last = Length - 1;
+        for (i = 0; i < 256; i++)
+            FoldedSkip[i] = Length;
+        for (i = 0; i < Last; i++)
+            FoldedSkip[Pattern->Text[i]] = Last - i;
+        for (i = 0; i < 256; i++)
+            Pattern->Skip[i] = FoldedSkip[Search->Fold[i]];
+    }
+
+    Search->PatternCount++;
+    return TRUE;
+}
+
+BOOL
+SearchInitialize(PSEARCH Search, const char **Strings, ULONG StringCount)
+{
+    char Upper[256];
+    ULONG i;
+
+    for (i = 0; i < 256; i++)
+        Search->Fold[i] = (UCHAR)i;
+    if (Search->Options.IgnoreCase)
+    {
+        for (i = 1; i < 256; i++)
+            Upper[i - 1] = (char)i;
+        CharUpperBuffA(Upper, 255);
+        for (i = 1; i < 256; i++)
+        {
+            if (i != '\n' && i != '\r')
+                Search->Fold[i] = (UCHAR)Upper[i - 1];
+        }
+    }
+
+    Search->PatternCount = 0;
+    Search->Patterns = calloc(StringCount, sizeof(PATTERN));
+    if (!Search->Patterns)
+        return FALSE;
+
+    for (i = 0; i < StringCount; i++)
+    {
+        if (!AddPattern(Search, Strings[i], strlen(Strings[i])))
+            return FALSE;
+    }
+
+    return Search->PatternCount != 0;
+}
+
+VOID
+SearchCleanup(PSEARCH Search)
+{
+    ULONG i;
+
+    for (i = 0; i < Search->PatternCount; i++)
+    {
+        if (Search->Patterns[i].Regex)
+            RegexFree(Search->Patterns[i].Regex);
+        free(Search->Patterns[i].Text);
+    }
+    free(Search->Patterns);
+    Search->Patterns = NULL;
+    Search->PatternCount = 0;
+}
+
+/* Boyer-Moore-Horspool, comparing folded bytes when ignoring case */
+static
+const UCHAR *
+FindLiteral(PSEARCH Search, PPATTERN Pattern, const UCHAR *From, const UCHAR *End)
+{
+    const UCHAR *Text = Pattern->Text;
+    const UCHAR *Fold = Search->Fold;
+    SIZE_T Last = Pattern->Length - 1;
+    SIZE_T i;
+    UCHAR Byte;
+
+    if (!Search->Options.IgnoreCase)
+    {
+        if (!Last)
+            return memchr(From, Text[0], End - From);
+
+        while ((SIZE_T)(End - From) > Last)
+        {
+            Byte = From[Last];
+            if (Byte == Text[Last] && !memcmp(From, Text, Last))
+                return From;
+            From += Pattern->Skip[Byte];
+        }
+        return NULL;
+    }
+
+    while ((SIZE_T)(End - From) > Last)
+    {
+        Byte = From[Last];
+        if (Fold[Byte] == Text[Last])
+        {
+            for (i = 0; i < Last && Fold[From[i]] == Text[i]; i++);
+            if (i == Last)
+                return From;
+        }
+        From += Pattern->Skip[Byte];
+    }
+    return NULL;
+}
+
+static
+const UCHAR *
+FindLineEnd(const UCHAR *Pos, const UCHAR *End)
+{
+    const UCHAR *LineEnd = memchr(Pos, '\n', End - Pos);
+    return LineEnd ? LineEnd : End;
+}
+
+/* The end of the text of a line, without the carriage return */
+static
+const UCHAR *
+TrimLine(const UCHAR *Line, const UCHAR *LineEnd)
+{
+    if (LineEnd > Line && LineEnd[-1] == '\r')
+        LineEnd--;
+    return LineEnd;
+}
+
+/*
+ * Returns the start of the first line at or after Pos that matches, or End.
+ * Literal patterns search the whole buffer and remember their next
+ * occurrence, so every pattern goes over the data only once. Pos is always
+ * the start of a line.
+ */
+static
+const UCHAR *
+FindMatchingLine(PSEARCH Search, const UCHAR *Pos, const UCHAR *End)
+{
+    PFINDSTR_OPTIONS Options = &Search->Options;
+    const UCHAR *Best = End, *Line, *LineEnd, *Match;
+    PPATTERN Pattern;
+    ULONG i;
+
+    if (Options->Regex)
+    {
+        for (Line = Pos; Line < End; Line = LineEnd + 1)
+        {
+            LineEnd = FindLineEnd(Line, End);
+            for (i = 0; i < Search->PatternCount; i++)
+            {
+                if (RegexMatch(Search->Patterns[i].Regex, Line, TrimLine(Line, LineEnd) - Line))
+                    return Line;
+            }
+            if (LineEnd == End)
+                break;
+        }
+        return End;
+    }
+
+    for (i = 0; i < Search->PatternCount; i++)
+    {
+        Pattern = &Search->Patterns[i];
+
+        for (;;)
+        {
+            if (!Pattern->Next || Pattern->Next < Pos)
+            {
+                Pattern->Next = FindLiteral(Search, Pattern, Pos, End);
+                if (!Pattern->Next)
+                    Pattern->Next = End;
+            }
+            Match = Pattern->Next;
+            if (Match >= Best)
+                break;
+
+            for (Line = Match; Line > Pos && Line[-1] != '\n'; Line--);
+
+            if (!Options->AtStart && !Options->AtEnd && !Options->Exact)
+            {
+                Best = Line;
+                break;
+            }
+
+            if ((Options->AtStart || Options->Exact) && Match != Line)
+            {
+                /* Not at the start, look further */
+            }
+            else if ((Options->AtEnd || Options->Exact) &&
+                     Match + Pattern->Length != TrimLine(Line, FindLineEnd(Match, End)))
+            {
+                /* Not at the end, look further */
+            }
+            else
+            {
+                Best = Line;
+                break;
+            }
+
+            Pattern->Next = FindLiteral(Search, Pattern, Match + 1, End);
+            if (!Pattern->Next)
+                Pattern->Next = End;
+        }
+    }
+
+    return Best;
+}
+
+static
+VOID
+EmitLine(PSEARCH Search, const UCHAR *Line, const UCHAR *LineEnd,
+         PLINE_STATE State, POUTPUT Output)
+{
+    State->Matches++;
+    if (Search->Options.Count || Search->Options.FileNames)
+        return;
+
+    if (Search->Options.Number)
+        OutputPrintf(Output, "%I64u:", State->LineNumber);
+    OutputWrite(Output, Line, TrimLine(Line, LineEnd) - Line);
+    OutputWrite(Output, "\n", 1);
+}
+
+/* Counts the lines of a range that only holds whole lines */
+static
+ULONG64
+CountLines(const UCHAR *Pos, const UCHAR *End)
+{
+    ULONG64 Lines = 0;
+
+    while ((Pos = memchr(Pos, '\n', End - Pos)) != NULL)
+    {
+        Lines++;
+        Pos++;
+    }
+    return Lines;
+}
+
+/*
+ * Searches a buffer of whole lines, only the last line of the input may
+ * lack its line feed.
+ */
+VOID
+SearchBuffer(PSEARCH Search, const UCHAR *Buffer, SIZE_T Length,
+             PLINE_STATE State, POUTPUT Output)
+{
+    PFINDSTR_OPTIONS Options = &Search->Options;
+    const UCHAR *Pos = Buffer, *End = Buffer + Length;
+    const UCHAR *Match, *Line, *LineEnd;
+    ULONG i;
+
+    for (i = 0; i < Search->PatternCount; i++)
+        Search->Patterns[i].Next = NULL;
+
+    while (Pos < End)
+    {
+        if (Options->FileNames && State->Matches)
+            return;
+
+        Match = FindMatchingLine(Search, Pos, End);
+
+        /* Everything in between does not match */
+        if (Options->Invert)
+        {
+            for (Line = Pos; Line < Match; Line = LineEnd + 1)
+            {
+                LineEnd = FindLineEnd(Line, Match);
+                State->LineNumber++;
+                EmitLine(Search, Line, LineEnd, State, Output);
+                if (LineEnd == Match)
+                    break;
+            }
+        }
+        else if (Options->Number)
+        {
+            State->LineNumber += CountLines(Pos, Match);
+            if (Match == End && End[-1] != '\n')
+                State->LineNumber++;
+        }
+
+        if (Match == End)
+            break;
+
+        LineEnd = FindLineEnd(Match, End);
+        State->LineNumber++;
+        if (!Options->Invert)
+            EmitLine(Search, Match, LineEnd, State, Output);
+        Pos = LineEnd + 1;
+    }
+}
+
+/* Streams a file or a pipe through a buffer that keeps whole lines */
+BOOL
+SearchHandle(PSEARCH Search, HANDLE File, PLINE_STATE State, POUTPUT Output)
+{
+    PUCHAR Buffer, NewBuffer;
+    SIZE_T Size = STREAM_CHUNK, Used = 0, Scan, Keep;
+    DWORD Read;
+
+    Buffer = malloc(Size);
+    if (!Buffer)
+        return FALSE;
+
+    for (;;)
+    {
+        if (Search->Options.FileNames && State->Matches)
+            break;
+
+        /* A line longer than the buffer grows it */
+        if (Used == Size)
+        {
+            NewBuffer = realloc(Buffer, Size * 2);
+            if (!NewBuffer)
+                break;
+            Buffer = NewBuffer;
+            Size *= 2;
+        }
+
+        if (!ReadFile(File, Buffer + Used, (DWORD)min(Size - Used, MAXDWORD), &Read, NULL))
+        {
+            if (GetLastError() != ERROR_BROKEN_PIPE)
+            {
+                free(Buffer);
+                return FALSE;
+            }
+            Read = 0;
+        }
+
+        if (!Read)
+        {
+            if (Used)
+                SearchBuffer(Search, Buffer, Used, State, Output);
+            break;
+        }
+
+        /* What was kept before holds no line feed */
+        Scan = Used + Read;
+        while (Scan > Used && Buffer[Scan - 1] != '\n')
+            Scan--;
+        Used += Read;
+        if (Scan == Used - Read)
+            continue;
+
+        SearchBuffer(Search, Buffer, Scan, State, Output);
+        Keep = Used - Scan;
+        memmove(Buffer, Buffer + Scan, Keep);
+        Used = Keep;
+    }
+
+    free(Buffer);
+    return TRUE;
+}
+
+/* Maps the file a view at a time, each view ending at a line end.
+ * Returns how far it got. */
+static
+ULONG64
+SearchMapping(PSEARCH Search, HANDLE Mapping, ULONG64 FileSize,
+              PLINE_STATE State, POUTPUT Output)
+{
+    SYSTEM_INFO SystemInfo;
+    ULONG64 Offset = 0, Base;
+    SIZE_T ViewSize = VIEW_SIZE, ViewLength, Delta, Length;
+    const UCHAR *View, *Data;
+
+    GetSystemInfo(&SystemInfo);
+
+    while (Offset < FileSize)
+    {
+        if (Search->Options.FileNames && State->Matches)
+            break;
+
+        Base = Offset & ~((ULONG64)SystemInfo.dwAllocationGranularity - 1);
+        Delta = (SIZE_T)(Offset - Base);
+        ViewLength = (SIZE_T)min(FileSize - Base, (ULONG64)Delta + ViewSize);
+
+        View = MapViewOfFile(Mapping, FILE_MAP_READ, (DWORD)(Base >> 32), (DWORD)Base, ViewLength);
+        if (!View)
+            break;
+
+        Data = View + Delta;
+        Length = ViewLength - Delta;
+        if (Base + ViewLength < FileSize)
+        {
+            while (Length && Data[Length - 1] != '\n')
+                Length--;
+            if (!Length)
+            {
+                /* No line ends in this view, try a bigger one */
+                UnmapViewOfFile(View);
+                ViewSize *= 2;
+                continue;
+            }
+        }
+
+        SearchBuffer(Search, Data, Length, State, Output);
+        UnmapViewOfFile(View);
+        Offset += Length;
+    }
+
+    return Offset;
+}
+
+/* Searches an opened file, mapping it when it can be mapped */
+BOOL
+SearchFile(PSEARCH Search, HANDLE File, PLINE_STATE State, POUTPUT Output)
+{
+    LARGE_INTEGER FileSize, Done;
+    HANDLE Mapping;
+
+    Done.QuadPart = 0;
+    if (GetFileSizeEx(File, &FileSize) && FileSize.QuadPart > 0)
+    {
+        Mapping = CreateFileMappingA(File, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (Mapping)
+        {
+            Done.QuadPart = SearchMapping(Search, Mapping, FileSize.QuadPart, State, Output);
+            CloseHandle(Mapping);
+        }
+        if (Done.QuadPart == FileSize.QuadPart ||
+            (Search->Options.FileNames && State->Matches))
+        {
+            return TRUE;
+        }
+    }
+
+    /* Devices and files that cannot be mapped are read instead, the
+     * rest of a file whose views ran out of address space too */
+    if (Done.QuadPart && !SetFilePointerEx(File, Done, NULL, FILE_BEGIN))
+        return FALSE;
+    return SearchHandle(Search, File, State, Output);
+}
@@ -14,21 +14,154 @@
 static RESOLVER_CACHE DnsCache;
 static BOOL DnsCacheInitialized = FALSE;
 
-#define DnsCacheLock()          do { EnterCriticalSection(&DnsCache.Lock); } while (0)
-#define DnsCacheUnlock()        do { LeaveCriticalSection(&DnsCache.Lock); } while (0)
+#define DnsCacheLock()          do { AcquireSRWLockExclusive(&DnsCache.Lock); } while (0)
+#define DnsCacheUnlock()        do { ReleaseSRWLockExclusive(&DnsCache.Lock); } while (0)
+#define DnsCacheLockShared()    do { AcquireSRWLockShared(&DnsCache.Lock); } while (0)
+#define DnsCacheUnlockShared()  do { ReleaseSRWLockShared(&DnsCache.Lock); } while (0)
+
+/* Entries from the hosts file never expire and are never evicted */
+#define DNS_CACHE_NO_EXPIRY     ((ULONG)-1)
+
+/* Seconds since boot, the TTLs must not follow changes of the system time */
+static
+DWORD
+DnsIntCacheGetTime(VOID)
+{
+    return (DWORD)(GetTickCount64() / 1000);
+}
+
+/* Case insensitive FNV-1a of the name, entries of all types of a name share a bucket */
+static
+ULONG
+DnsIntCacheHashName(
+    _In_ LPCWSTR Name)
+{
+    ULONG Hash = 2166136261U;
+
+    while (*Name)
+    {
+        Hash ^= towlower(*Name++);
+        Hash *= 16777619U;
+    }
+
+    return Hash;
+}
+
+static
+BOOL
+DnsIntCacheIsExpired(
+    _In_ PRESOLVER_CACHE_ENTRY CacheEntry,
+    _In_ DWORD dwNow)
+{
+    return (CacheEntry->HeapIndex != DNS_CACHE_NO_EXPIRY) &&
+           ((LONG)(CacheEntry->dwExpireTime - dwNow) <= 0);
+}
+
+/* The expiry heap keeps the entry that expires first at index 0 */
+static
+VOID
+DnsIntCacheHeapSet(
+    _In_ ULONG Index,
+    _In_ PRESOLVER_CACHE_ENTRY CacheEntry)
+{
+    DnsCache.ExpiryHeap[Index] = CacheEntry;
+    CacheEntry->HeapIndex = Index;
+}
+
+static
+VOID
+DnsIntCacheHeapSiftUp(
+    _In_ ULONG Index)
+{
+    PRESOLVER_CACHE_ENTRY CacheEntry = DnsCache.ExpiryHeap[Index];
+    ULONG Parent;
+
+    while (Index > 0)
+    {
+        Parent = (Index - 1) / 2;
+        if ((LONG)(DnsCache.ExpiryHeap[Parent]->dwExpireTime - CacheEntry->dwExpireTime) <= 0)
+            break;
+
+        DnsIntCacheHeapSet(Index, DnsCache.ExpiryHeap[Parent]);
+        Index = Parent;
+    }
+
+    DnsIntCacheHeapSet(Index, CacheEntry);
+}
+
+static
+VOID
+DnsIntCacheHeapSiftDown(
+    _In_ ULONG Index)
+{
+    PRESOLVER_CACHE_ENTRY CacheEntry = DnsCache.ExpiryHeap[Index];
+    ULONG Child;
+
+    for (;;)
+    {
+        Child = Index * 2 + 1;
+        if (Child >= DnsCache.ExpiryHeapSize)
+            break;
+
+        if ((Child + 1 < DnsCache.ExpiryHeapSize) &&
+            ((LONG)(DnsCache.ExpiryHeap[Child + 1]->dwExpireTime -
+                    DnsCache.ExpiryHeap[Child]->dwExpireTime) < 0))
+        {
+            Child++;
+        }
+
+        if ((LONG)(CacheEntry->dwExpireTime - DnsCache.ExpiryHeap[Child]->dwExpireTime) <= 0)
+            break;
+
+        DnsIntCacheHeapSet(Index, DnsCache.ExpiryHeap[Child]);
+        Index = Child;
+    }
+
+    DnsIntCacheHeapSet(Index, CacheEntry);
+}
+
+static
+VOID
+DnsIntCacheHeapRemove(
+    _In_ PRESOLVER_CACHE_ENTRY CacheEntry)
+{
+    ULONG Index = CacheEntry->HeapIndex;
+    PRESOLVER_CACHE_ENTRY LastEntry;
+
+    ASSERT(Index < DnsCache.ExpiryHeapSize);
+    ASSERT(DnsCache.ExpiryHeap[Index] == CacheEntry);
+
+    /* Move the last entry into the hole and restore the heap order */
+    LastEntry = DnsCache.ExpiryHeap[--DnsCache.ExpiryHeapSize];
+    if (LastEntry != CacheEntry)
+    {
+        DnsIntCacheHeapSet(Index, LastEntry);
+        DnsIntCacheHeapSiftUp(Index);
+        DnsIntCacheHeapSiftDown(LastEntry->HeapIndex);
+    }
+
+    CacheEntry->HeapIndex = DNS_CACHE_NO_EXPIRY;
+}
 
 VOID
 DnsIntCacheInitialize(VOID)
 {
+    ULONG i;
+
     DPRINT("DnsIntCacheInitialize()\n");
 
     /* Check if we're initialized */
     if (DnsCacheInitialized)
         return;
 
-    /* Initialize the cache lock and namespace list */
-    InitializeCriticalSection((LPCRITICAL_SECTION)&DnsCache.Lock);
+    /* Initialize the cache lock, the record list and the hash table */
+    InitializeSRWLock(&DnsCache.Lock);
     InitializeListHead(&DnsCache.RecordList);
+    for (i = 0; i < DNS_CACHE_HASH_BUCKETS; i++)
+        InitializeListHead(&DnsCache.HashTable[i]);
+    DnsCache.ExpiryHeapSize = 0;
+    DnsCache.EntryCount = 0;
+    DnsCache.NegativeEntryCount = 0;
     DnsCacheInitialized = TRUE;
 }
 
@@ -46,7 +179,6 @@ DnsIntCacheFree(VOID)
 
     DnsIntCacheFlush(CACHE_FLUSH_ALL);
 
-    DeleteCriticalSection(&DnsCache.Lock);
     DnsCacheInitialized = FALSE;
 }
 
@@ -55,16 +187,72 @@ DnsIntCacheRemoveEntryItem(PRESOLVER_CACHE_ENTRY CacheEntry)
 {
     DPRINT("DnsIntCacheRemoveEntryItem(%p)\n", CacheEntry);
 
-    /* Remove the entry from the list */
+    /* Remove the entry from the lists and the expiry heap */
     RemoveEntryList(&CacheEntry->CacheLink);
+    RemoveEntryList(&CacheEntry->HashLink);
+    if (CacheEntry->HeapIndex != DNS_CACHE_NO_EXPIRY)
+        DnsIntCacheHeapRemove(CacheEntry);
+
+    if (!CacheEntry->bHostsFileEntry)
+    {
+        DnsCache.EntryCount--;
+        if (CacheEntry->Status != ERROR_SUCCESS)
+            DnsCache.NegativeEntryCount--;
+    }
 
     /* Free record */
-    DnsRecordListFree(CacheEntry->Record, DnsFreeRecordList);
+    if (CacheEntry->Record)
+        DnsRecordListFree(CacheEntry->Record, DnsFreeRecordList);
 
     /* Delete us */
     HeapFree(GetProcessHeap(), 0, CacheEntry);
 }
 
+/* Drops the entries whose TTL ran out, the cache must be locked exclusively */
+static
+VOID
+DnsIntCacheExpireEntries(
+    _In_ DWORD dwNow)
+{
+    while (DnsCache.ExpiryHeapSize != 0 &&
+           DnsIntCacheIsExpired(DnsCache.ExpiryHeap[0], dwNow))
+    {
+        DnsIntCacheRemoveEntryItem(DnsCache.ExpiryHeap[0]);
+        InterlockedIncrement(&DnsCache.Expired);
+    }
+}
+
+/*
+ * Makes room for one more entry, the cache must be locked exclusively.
+ * The record list works as a clock: lookups only mark the entries they
+ * hit, so that they can do with the shared lock, and the marked entries
+ * at the tail get a second chance at the head instead of being evicted.
+ */
+static
+VOID
+DnsIntCacheEvictEntries(VOID)
+{
+    PLIST_ENTRY Entry;
+    PRESOLVER_CACHE_ENTRY CacheEntry;
+
+    while (DnsCache.EntryCount >= DNS_CACHE_MAX_ENTRIES)
+    {
+        Entry = DnsCache.RecordList.Blink;
+        CacheEntry = CONTAINING_RECORD(Entry, RESOLVER_CACHE_ENTRY, CacheLink);
+
+        if (CacheEntry->bHostsFileEntry ||
+            InterlockedExchange(&CacheEntry->bReferenced, FALSE))
+        {
+            RemoveEntryList(Entry);
+            InsertHeadList(&DnsCache.RecordList, Entry);
+            continue;
+        }
+
+        DnsIntCacheRemoveEntryItem(CacheEntry);
+        InterlockedIncrement(&DnsCache.Evicted);
+    }
+}
+
 DNS_STATUS
 DnsIntCacheFlush(
     _In_ ULONG ulFlags)
@@ -107,29 +295,34 @@ DnsIntFlushCacheEntry(
     _In_ LPCWSTR pszName,
     _In_ WORD wType)
 {
-    PLIST_ENTRY Entry, NextEntry;
+    PLIST_ENTRY Bucket, Entry, NextEntry;
     PRESOLVER_CACHE_ENTRY CacheEntry;
+    ULONG Hash;
 
     DPRINT("DnsIntFlushCacheEntry(%S %x)\n", pszName, wType);
 
+    Hash = DnsIntCacheHashName(pszName);
+    Bucket = &DnsCache.HashTable[Hash % DNS_CACHE_HASH_BUCKETS];
+
     /* Lock the cache */
     DnsCacheLock();
 
-    /* Loop every entry */
-    Entry = DnsCache.RecordList.Flink;
-    while (Entry != &DnsCache.RecordList)
+    /* Loop every entry of the bucket */
+    Entry = Bucket->Flink;
+    while (Entry != Bucket)
     {
         NextEntry = Entry->Flink;
 
         /* Get this entry */
-        CacheEntry = CONTAINING_RECORD(Entry, RESOLVER_CACHE_ENTRY, CacheLink);
+        CacheEntry = CONTAINING_RECORD(Entry, RESOLVER_CACHE_ENTRY, HashLink);
 
         /* Remove it from the list */
-        if ((_wcsicmp(CacheEntry->Record->pName, pszName) == 0) &&
-            (CacheEntry->bHostsFileEntry == FALSE))
+        if ((CacheEntry->Hash == Hash) &&
+            (CacheEntry->bHostsFileEntry == FALSE) &&
+            (_wcsicmp(CacheEntry->szName, pszName) == 0))
         {
             if ((wType == DNS_TYPE_ANY) ||
-                (CacheEntry->Record->wType == wType))
+                (CacheEntry->wType == wType))
             {
                 DnsIntCacheRemoveEntryItem(CacheEntry);
             }
@@ -146,6 +339,11 @@ DnsIntFlushCacheEntry(
 }
 
 
+/*
+ * Looks up the name and type, DNS_TYPE_ANY takes any type. Returns
+ * ERROR_SUCCESS with a copy of the records, the cached negative answer,
+ * or ERROR_NOT_FOUND if the cache does not know the name.
+ */
 DNS_STATUS
 DnsIntCacheGetEntryByName(
     LPCWSTR Name,
@@ -153,9 +351,12 @@ DnsIntCacheGetEntryByName(
     DWORD dwFlags,
     PDNS_RECORDW *Record)
 {
-    DNS_STATUS Status = DNS_INFO_NO_RECORDS;
+    DNS_STATUS Status = ERROR_NOT_FOUND;
     PRESOLVER_CACHE_ENTRY CacheEntry;
-    PLIST_ENTRY NextEntry;
+    PLIST_ENTRY Bucket, NextEntry;
+    PDNS_RECORDW CopyRecord;
+    DWORD dwNow;
+    ULONG Hash;
 
     DPRINT("DnsIntCacheGetEntryByName(%S %hu 0x%lx %p)\n",
            Name, wType, dwFlags, Record);
@@ -163,22 +364,51 @@ DnsIntCacheGetEntryByName(
     /* Assume failure */
     *Record = NULL;
 
-    /* Lock the cache */
-    DnsCacheLock();
+    dwNow = DnsIntCacheGetTime();
+    Hash = DnsIntCacheHashName(Name);
+    Bucket = &DnsCache.HashTable[Hash % DNS_CACHE_HASH_BUCKETS];
 
-    /* Match the Id with all the entries in the List */
-    NextEntry = DnsCache.RecordList.Flink;
-    while (NextEntry != &DnsCache.RecordList)
+    /* Lock the cache for reading */
+    DnsCacheLockShared();
+
+    /* Match the name and type with the entries of the bucket */
+    NextEntry = Bucket->Flink;
+    while (NextEntry != Bucket)
     {
         /* Get the Current Entry */
-        CacheEntry = CONTAINING_RECORD(NextEntry, RESOLVER_CACHE_ENTRY, CacheLink);
+        CacheEntry = CONTAINING_RECORD(NextEntry, RESOLVER_CACHE_ENTRY, HashLink);
 
-        /* Check if this is the Catalog Entry ID we want */
-        if (_wcsicmp(CacheEntry->Record->pName, Name) == 0)
+        /* Check if this is the entry we want, expired ones are left to the next writer */
+        if ((CacheEntry->Hash == Hash) &&
+            ((wType == DNS_TYPE_ANY) || (CacheEntry->wType == wType)) &&
+            !DnsIntCacheIsExpired(CacheEntry, dwNow) &&
+            (_wcsicmp(CacheEntry->szName, Name) == 0))
         {
-            /* Copy the entry and return it */
-            *Record = DnsRecordSetCopyEx(CacheEntry->Record, DnsCharSetUnicode, DnsCharSetUnicode);
-            Status = ERROR_SUCCESS;
+            InterlockedExchange(&CacheEntry->bReferenced, TRUE);
+            Status = CacheEntry->Status;
+
+            if (Status == ERROR_SUCCESS)
+            {
+                /* Copy the entry and return it with the TTL that is left */
+                *Record = DnsRecordSetCopyEx(CacheEntry->Record, DnsCharSetUnicode, DnsCharSetUnicode);
+                if (*Record == NULL)
+                {
+                    Status = ERROR_OUTOFMEMORY;
+                    break;
+                }
+
+                if (CacheEntry->HeapIndex != DNS_CACHE_NO_EXPIRY)
+                {
+                    for (CopyRecord = *Record; CopyRecord; CopyRecord = CopyRecord->pNext)
+                        CopyRecord->dwTtl = CacheEntry->dwExpireTime - dwNow;
+                }
+            }
+            else
+            {
+                InterlockedIncrement(&DnsCache.NegativeHits);
+            }
+
+            InterlockedIncrement(&DnsCache.Hits);
             break;
         }
 
@@ -186,7 +416,10 @@ DnsIntCacheGetEntryByName(
     }
 
     /* Release the cache */
-    DnsCacheUnlock();
+    DnsCacheUnlockShared();
+
+    if (Status == ERROR_NOT_FOUND)
+        InterlockedIncrement(&DnsCache.Misses);
 
     return Status;
 }
@@ -196,22 +429,27 @@ DnsIntCacheRemoveEntryByName(LPCWSTR Name)
 {
     BOOL Ret = FALSE;
     PRESOLVER_CACHE_ENTRY CacheEntry;
-    PLIST_ENTRY NextEntry;
+    PLIST_ENTRY Bucket, NextEntry;
+    ULONG Hash;
 
     DPRINT("DnsIntCacheRemoveEntryByName(%S)\n", Name);
 
+    Hash = DnsIntCacheHashName(Name);
+    Bucket = &DnsCache.HashTable[Hash % DNS_CACHE_HASH_BUCKETS];
+
     /* Lock the cache */
     DnsCacheLock();
 
-    /* Match the Id with all the entries in the List */
-    NextEntry = DnsCache.RecordList.Flink;
-    while (NextEntry != &DnsCache.RecordList)
+    /* Match the name with the entries of the bucket */
+    NextEntry = Bucket->Flink;
+    while (NextEntry != Bucket)
     {
         /* Get the Current Entry */
-        CacheEntry = CONTAINING_RECORD(NextEntry, RESOLVER_CACHE_ENTRY, CacheLink);
+        CacheEntry = CONTAINING_RECORD(NextEntry, RESOLVER_CACHE_ENTRY, HashLink);
 
-        /* Check if this is the Catalog Entry ID we want */
-        if (_wcsicmp(CacheEntry->Record->pName, Name) == 0)
+        /* Check if this is the entry we want */
+        if ((CacheEntry->Hash == Hash) &&
+            (_wcsicmp(CacheEntry->szName, Name) == 0))
         {
             /* Remove the entry */
             DnsIntCacheRemoveEntryItem(CacheEntry);
@@ -229,37 +467,132 @@ DnsIntCacheRemoveEntryByName(LPCWSTR Name)
     return Ret;
 }
 
+static
 VOID
-DnsIntCacheAddEntry(
-    _In_ PDNS_RECORDW Record,
+DnsIntCacheInsertEntry(
+    _In_ LPCWSTR Name,
+    _In_ WORD wType,
+    _In_opt_ PDNS_RECORDW Record,
+    _In_ DNS_STATUS Status,
+    _In_ DWORD dwTtl,
     _In_ BOOL bHostsFileEntry)
 {
-    PRESOLVER_CACHE_ENTRY Entry;
+    PRESOLVER_CACHE_ENTRY Entry, CacheEntry;
+    PLIST_ENTRY Bucket, NextEntry;
+    SIZE_T NameLength;
+    DWORD dwNow;
+    ULONG Hash;
+
+    /* Records with a TTL of zero must not be cached */
+    if (!bHostsFileEntry && dwTtl == 0)
+        return;
 
-    DPRINT("DnsIntCacheAddEntry(%p %u)\n",
-           Record, bHostsFileEntry);
+    NameLength = wcslen(Name);
+    Entry = (PRESOLVER_CACHE_ENTRY)HeapAlloc(GetProcessHeap(), 0,
+                                             FIELD_OFFSET(RESOLVER_CACHE_ENTRY, szName[NameLength + 1]));
+    if (!Entry)
+        return;
 
-    DPRINT("Name: %S\n", Record->pName);
-    DPRINT("TTL: %lu\n", Record->dwTtl);
+    if (Record)
+    {
+        Entry->Record = DnsRecordSetCopyEx(Record, DnsCharSetUnicode, DnsCharSetUnicode);
+        if (!Entry->Record)
+        {
+            HeapFree(GetProcessHeap(), 0, Entry);
+            return;
+        }
+    }
+    else
+    {
+        Entry->Record = NULL;
+    }
+
+    dwNow = DnsIntCacheGetTime();
+    Hash = DnsIntCacheHashName(Name);
+    Bucket = &DnsCache.HashTable[Hash % DNS_CACHE_HASH_BUCKETS];
+
+    CopyMemory(Entry->szName, Name, (NameLength + 1) * sizeof(WCHAR));
+    Entry->Hash = Hash;
+    Entry->wType = wType;
+    Entry->Status = Status;
+    Entry->bHostsFileEntry = bHostsFileEntry;
+    Entry->bReferenced = FALSE;
+    Entry->HeapIndex = DNS_CACHE_NO_EXPIRY;
+    Entry->dwExpireTime = dwNow + min(dwTtl, DNS_MAX_CACHE_TTL);
 
     /* Lock the cache */
     DnsCacheLock();
 
-    /* Match the Id with all the entries in the List */
-    Entry = (PRESOLVER_CACHE_ENTRY)HeapAlloc(GetProcessHeap(), 0, sizeof(*Entry));
-    if (!Entry)
-        return;
+    if (!bHostsFileEntry)
+    {
+        /* Replace the answer that was cached for the same name and type */
+        NextEntry = Bucket->Flink;
+        while (NextEntry != Bucket)
+        {
+            CacheEntry = CONTAINING_RECORD(NextEntry, RESOLVER_CACHE_ENTRY, HashLink);
+            NextEntry = NextEntry->Flink;
 
-    Entry->bHostsFileEntry = bHostsFileEntry;
-    Entry->Record = DnsRecordSetCopyEx(Record, DnsCharSetUnicode, DnsCharSetUnicode);
+            if ((CacheEntry->Hash == Hash) &&
+                (CacheEntry->wType == wType) &&
+                (CacheEntry->bHostsFileEntry == FALSE) &&
+                (_wcsicmp(CacheEntry->szName, Name) == 0))
+            {
+                DnsIntCacheRemoveEntryItem(CacheEntry);
+            }
+        }
 
-    /* Insert it to our List */
-    InsertTailList(&DnsCache.RecordList, &Entry->CacheLink);
+        /* Make room, expired entries go first */
+        DnsIntCacheExpireEntries(dwNow);
+        DnsIntCacheEvictEntries();
+
+        DnsIntCacheHeapSet(DnsCache.ExpiryHeapSize++, Entry);
+        DnsIntCacheHeapSiftUp(Entry->HeapIndex);
+
+        DnsCache.EntryCount++;
+        if (Status != ERROR_SUCCESS)
+            DnsCache.NegativeEntryCount++;
+    }
+
+    /* Insert it to our lists */
+    InsertHeadList(&DnsCache.RecordList, &Entry->CacheLink);
+    InsertTailList(Bucket, &Entry->HashLink);
 
     /* Release the cache */
     DnsCacheUnlock();
 }
 
+VOID
+DnsIntCacheAddEntry(
+    _In_ LPCWSTR Name,
+    _In_ WORD wType,
+    _In_ PDNS_RECORDW Record,
+    _In_ BOOL bHostsFileEntry)
+{
+    DPRINT("DnsIntCacheAddEntry(%S %hu %p %u)\n",
+           Name, wType, Record, bHostsFileEntry);
+
+    DPRINT("Name: %S\n", Record->pName);
+    DPRINT("TTL: %lu\n", Record->dwTtl);
+
+    DnsIntCacheInsertEntry(Name, wType, Record, ERROR_SUCCESS, Record->dwTtl, bHostsFileEntry);
+}
+
+/*
+ * Caches a name error or an empty answer (RFC 2308). The SOA record of the
+ * answer does not make it here, so the entry gets a fixed TTL.
+ */
+VOID
+DnsIntCacheAddNegativeEntry(
+    _In_ LPCWSTR Name,
+    _In_ WORD wType,
+    _In_ DNS_STATUS Status)
+{
+    DPRINT("DnsIntCacheAddNegativeEntry(%S %hu %lu)\n",
+           Name, wType, Status);
+
+    DnsIntCacheInsertEntry(Name, wType, NULL, Status, DNS_NEGATIVE_CACHE_TTL, FALSE);
+}
+
 DNS_STATUS
 DnsIntCacheGetEntries(
     _Out_ DNS_CACHE_ENTRY **ppCacheEntries)
@@ -267,9 +600,13 @@ DnsIntCacheGetEntries(
     PRESOLVER_CACHE_ENTRY CacheEntry;
     PLIST_ENTRY NextEntry;
     PDNS_CACHE_ENTRY pLastEntry = NULL, pNewEntry;
+    DNS_STATUS Status = ERROR_SUCCESS;
+    DWORD dwNow;
 
-    /* Lock the cache */
-    DnsCacheLock();
+    dwNow = DnsIntCacheGetTime();
+
+    /* Lock the cache for reading */
+    DnsCacheLockShared();
 
     *ppCacheEntries = NULL;
 
@@ -278,27 +615,30 @@ DnsIntCacheGetEntries(
     {
         /* Get the Current Entry */
         CacheEntry = CONTAINING_RECORD(NextEntry, RESOLVER_CACHE_ENTRY, CacheLink);
+        NextEntry = NextEntry->Flink;
 
-        DPRINT("1 %S %lu\n", CacheEntry->Record->pName, CacheEntry->Record->wType);
-        if (CacheEntry->Record->pNext)
-        {
-            DPRINT("2 %S %lu\n", CacheEntry->Record->pNext->pName, CacheEntry->Record->pNext->wType);
-        }
+        if (DnsIntCacheIsExpired(CacheEntry, dwNow))
+            continue;
+
+        DPRINT("1 %S %lu %lu\n", CacheEntry->szName, CacheEntry->wType, CacheEntry->Status);
 
         pNewEntry = midl_user_allocate(sizeof(DNS_CACHE_ENTRY));
         if (pNewEntry == NULL)
         {
-            return ERROR_OUTOFMEMORY;
+            Status = ERROR_OUTOFMEMORY;
+            break;
         }
 
-        pNewEntry->pszName = midl_user_allocate((wcslen(CacheEntry->Record->pName) + 1) * sizeof(WCHAR));
+        pNewEntry->pszName = midl_user_allocate((wcslen(CacheEntry->szName) + 1) * sizeof(WCHAR));
         if (pNewEntry->pszName == NULL)
         {
-            return ERROR_OUTOFMEMORY;
+            midl_user_free(pNewEntry);
+            Status = ERROR_OUTOFMEMORY;
+            break;
         }
 
-        wcscpy(pNewEntry->pszName, CacheEntry->Record->pName);
-        pNewEntry->wType1 = CacheEntry->Record->wType;
+        wcscpy(pNewEntry->pszName, CacheEntry->szName);
+        pNewEntry->wType1 = CacheEntry->wType;
         pNewEntry->wType2 = 0;
         pNewEntry->wFlags = 0;
 
@@ -307,12 +647,32 @@ DnsIntCacheGetEntries(
         else
             pLastEntry->pNext = pNewEntry;
         pLastEntry = pNewEntry;
-
-        NextEntry = NextEntry->Flink;
     }
 
     /* Release the cache */
-    DnsCacheUnlock();
+    DnsCacheUnlockShared();
+
+    return Status;
+}
+
+DNS_STATUS
+DnsIntCacheGetStats(
+    _Out_ PDNS_CACHE_STATS pCacheStats)
+{
+    /* Lock the cache for reading */
+    DnsCacheLockShared();
+
+    pCacheStats->dwEntries = DnsCache.EntryCount;
+    pCacheStats->dwNegativeEntries = DnsCache.NegativeEntryCount;
+    pCacheStats->dwMaxEntries = DNS_CACHE_MAX_ENTRIES;
+    pCacheStats->dwHits = DnsCache.Hits;
+    pCacheStats->dwNegativeHits = DnsCache.NegativeHits;
+    pCacheStats->dwMisses = DnsCache.Misses;
+    pCacheStats->dwExpired = DnsCache.Expired;
+    pCacheStats->dwEvicted = DnsCache.Evicted;
+
+    /* Release the cache */
+    DnsCacheUnlockShared();
 
     return ERROR_SUCCESS;
 }
@@ -3,6 +3,7 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include <wchar.h>
 
 #define WIN32_NO_STATUS
 #define _INC_WINDOWS
@@ -24,17 +25,40 @@
 
 #include <strsafe.h>
 
+#define DNS_CACHE_HASH_BUCKETS  1024
+#define DNS_CACHE_MAX_ENTRIES   4096
+#define DNS_MAX_CACHE_TTL       86400
+#define DNS_NEGATIVE_CACHE_TTL  300
+
 typedef struct _RESOLVER_CACHE_ENTRY
 {
-    LIST_ENTRY CacheLink;
+    LIST_ENTRY CacheLink;       /* Record list, the least recently added at the tail */
+    LIST_ENTRY HashLink;        /* Hash bucket of the name */
+    ULONG Hash;
+    ULONG HeapIndex;            /* Index in the expiry heap */
+    DWORD dwExpireTime;
+    LONG bReferenced;           /* Hit since the last eviction pass */
     BOOL bHostsFileEntry;
-    PDNS_RECORDW Record;
+    WORD wType;
+    DNS_STATUS Status;          /* ERROR_SUCCESS or the cached negative answer */
+    PDNS_RECORDW Record;        /* NULL for negative answers */
+    WCHAR szName[ANYSIZE_ARRAY];
 } RESOLVER_CACHE_ENTRY, *PRESOLVER_CACHE_ENTRY;
 
 typedef struct _RESOLVER_CACHE
 {
     LIST_ENTRY RecordList;
-    CRITICAL_SECTION Lock;
+    LIST_ENTRY HashTable[DNS_CACHE_HASH_BUCKETS];
+    PRESOLVER_CACHE_ENTRY ExpiryHeap[DNS_CACHE_MAX_ENTRIES];
+    ULONG ExpiryHeapSize;
+    ULONG EntryCount;           /* Entries not from the hosts file */
+    ULONG NegativeEntryCount;
+    LONG Hits;
+    LONG NegativeHits;
+    LONG Misses;
+    LONG Expired;
+    LONG Evicted;
+    SRWLOCK Lock;
 } RESOLVER_CACHE, *PRESOLVER_CACHE;
 
 
@@ -66,9 +90,17 @@ DnsIntCacheGetEntryByName(
 
 VOID
 DnsIntCacheAddEntry(
+    _In_ LPCWSTR Name,
+    _In_ WORD wType,
     _In_ PDNS_RECORDW Record,
     _In_ BOOL bHostsFileEntry);
 
+VOID
+DnsIntCacheAddNegativeEntry(
+    _In_ LPCWSTR Name,
+    _In_ WORD wType,
+    _In_ DNS_STATUS Status);
+
 BOOL
 DnsIntCacheRemoveEntryByName(
     _In_ LPCWSTR Name);
@@ -77,6 +109,10 @@ DNS_STATUS
 DnsIntCacheGetEntries(
     _Out_ DNS_CACHE_ENTRY **ppCacheEntries);
 
+DNS_STATUS
+DnsIntCacheGetStats(
+    _Out_ PDNS_CACHE_STATS pCacheStats);
+
 
 /* hostsfile.c */
 
@@ -56,6 +56,23 @@ CRrReadCache(
 }
 
 
+/* Function: 0x02 */
+DWORD
+__stdcall
+CRrGetHashTableStats(
+    _In_ DNSRSLVR_HANDLE pwszServerName,
+    _Out_ DNS_CACHE_STATS *pCacheStats)
+{
+    DPRINT("CRrGetHashTableStats(%S %p)\n",
+           pwszServerName, pCacheStats);
+
+    if (pCacheStats == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    return DnsIntCacheGetStats(pCacheStats);
+}
+
+
 /* Function: 0x04 */
 DWORD
 __stdcall
@@ -125,6 +142,8 @@ R_ResolverQuery(
                                            wType,
                                            dwFlags,
                                            ppResultRecords);
+        if (Status == ERROR_NOT_FOUND)
+            Status = DNS_INFO_NO_RECORDS;
     }
     else
     {
@@ -133,7 +152,7 @@ R_ResolverQuery(
                                            wType,
                                            dwFlags,
                                            ppResultRecords);
-        if (Status == DNS_INFO_NO_RECORDS)
+        if (Status == ERROR_NOT_FOUND)
         {
             DPRINT("DNS query!\n");
             Status = Query_Main(pszName,
@@ -143,7 +162,13 @@ R_ResolverQuery(
             if (Status == ERROR_SUCCESS)
             {
                 DPRINT("DNS query successful!\n");
-                DnsIntCacheAddEntry(*ppResultRecords, FALSE);
+                DnsIntCacheAddEntry(pszName, wType, *ppResultRecords, FALSE);
+            }
+            else if (Status == DNS_ERROR_RCODE_NAME_ERROR ||
+                     Status == DNS_INFO_NO_RECORDS)
+            {
+                DPRINT("DNS query negative answer %lu\n", Status);
+                DnsIntCacheAddNegativeEntry(pszName, wType, Status);
             }
         }
     }
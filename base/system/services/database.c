@@ -35,8 +35,37 @@ static DWORD ServiceTag = 0;
 
 /* The critical section synchronizes service control requests */
 static CRITICAL_SECTION ControlServiceCriticalSection;
+
+/*
+ * Guards the image list, the image run counts and the start state of the
+ * services that auto-start starts concurrently. No other lock is taken
+ * while it is held, so it can be entered with or without the others.
+ */
+static CRITICAL_SECTION ServiceImageCriticalSection;
 static DWORD PipeTimeout = 30000; /* 30 Seconds */
 
+/* Maximum number of services the auto-start code starts concurrently */
+static DWORD AutoStartParallelism = 4;
+
+typedef struct _AUTO_START_ENTRY
+{
+    PSERVICE Service;
+    LPWSTR lpDependencies;      /* DependOnService and '+'-prefixed DependOnGroup names */
+    LPWSTR lpImagePath;         /* NULL for drivers */
+    BOOL bTagged;
+    BOOL bStarted;
+    DWORD dwPendingCount;       /* Dependencies in the batch that did not finish yet */
+    DWORD dwStartTime;
+    DWORD dwError;
+} AUTO_START_ENTRY, *PAUTO_START_ENTRY;
+
+typedef struct _AUTO_START_BATCH
+{
+    DWORD dwCount;
+    DWORD dwMaxCount;
+    PAUTO_START_ENTRY Entries;
+} AUTO_START_BATCH, *PAUTO_START_BATCH;
+
 
 /* FUNCTIONS *****************************************************************/
 
@@ -149,6 +178,35 @@ ScmCreateNewControlPipe(
 }
 
 
+/*
+ * Image paths are compared with their environment variables expanded,
+ * whatever the type of the registry value, so that services of one image
+ * match however their paths are written.
+ */
+static LPWSTR
+ScmExpandImagePath(LPCWSTR lpImagePath)
+{
+    LPWSTR lpExpanded;
+    DWORD dwSize;
+
+    dwSize = ExpandEnvironmentStringsW(lpImagePath, NULL, 0);
+    if (dwSize == 0)
+        return NULL;
+
+    lpExpanded = HeapAlloc(GetProcessHeap(), 0, dwSize * sizeof(WCHAR));
+    if (lpExpanded == NULL)
+        return NULL;
+
+    if (ExpandEnvironmentStringsW(lpImagePath, lpExpanded, dwSize) != dwSize)
+    {
+        HeapFree(GetProcessHeap(), 0, lpExpanded);
+        return NULL;
+    }
+
+    return lpExpanded;
+}
+
+
 static PSERVICE_IMAGE
 ScmGetServiceImageByImagePath(LPWSTR lpImagePath)
 {
@@ -163,7 +221,9 @@ ScmGetServiceImageByImagePath(LPWSTR lpImagePath)
         CurrentImage = CONTAINING_RECORD(ImageEntry,
                                          SERVICE_IMAGE,
                                          ImageListEntry);
-        if (_wcsicmp(CurrentImage->pszImagePath, lpImagePath) == 0)
+        /* An image without references is about to be removed */
+        if ((CurrentImage->dwImageRunCount != 0) &&
+            (_wcsicmp(CurrentImage->pszImagePath, lpImagePath) == 0))
         {
             DPRINT("Found image: '%S'\n", CurrentImage->pszImagePath);
             return CurrentImage;
@@ -454,12 +514,42 @@ done:
 }
 
 
+static VOID
+ScmFreeServiceImage(PSERVICE_IMAGE pServiceImage)
+{
+    /* Close the process handle */
+    if (pServiceImage->hProcess != INVALID_HANDLE_VALUE)
+        CloseHandle(pServiceImage->hProcess);
+
+    /* Close the control pipe */
+    if (pServiceImage->hControlPipe != INVALID_HANDLE_VALUE)
+        CloseHandle(pServiceImage->hControlPipe);
+
+    /* Unload the user profile */
+    if (pServiceImage->hProfile != NULL)
+    {
+        ScmEnableBackupRestorePrivileges(pServiceImage->hToken, TRUE);
+        UnloadUserProfile(pServiceImage->hToken, pServiceImage->hProfile);
+        ScmEnableBackupRestorePrivileges(pServiceImage->hToken, FALSE);
+    }
+
+    /* Close the logon token */
+    if (pServiceImage->hToken != NULL)
+        CloseHandle(pServiceImage->hToken);
+
+    /* Release the service image */
+    HeapFree(GetProcessHeap(), 0, pServiceImage);
+}
+
+
 static DWORD
 ScmCreateOrReferenceServiceImage(PSERVICE pService)
 {
+    PSERVICE_IMAGE pExistingImage;
     RTL_QUERY_REGISTRY_TABLE QueryTable[3];
     UNICODE_STRING ImagePath;
     UNICODE_STRING ObjectName;
+    LPWSTR lpImagePath = NULL;
     PSERVICE_IMAGE pServiceImage = NULL;
     NTSTATUS Status;
     DWORD dwError = ERROR_SUCCESS;
@@ -497,11 +587,38 @@ ScmCreateOrReferenceServiceImage(PSERVICE pService)
     DPRINT("ImagePath: '%wZ'\n", &ImagePath);
     DPRINT("ObjectName: '%wZ'\n", &ObjectName);
 
-    pServiceImage = ScmGetServiceImageByImagePath(ImagePath.Buffer);
+    lpImagePath = ScmExpandImagePath(ImagePath.Buffer);
+    if (lpImagePath == NULL)
+    {
+        dwError = ERROR_NOT_ENOUGH_MEMORY;
+        goto done;
+    }
+
+    /*
+     * Auto-start may start services of different images concurrently,
+     * so the image list is only accessed inside the image critical section.
+     */
+    EnterCriticalSection(&ServiceImageCriticalSection);
+    pServiceImage = ScmGetServiceImageByImagePath(lpImagePath);
+    if (pServiceImage != NULL)
+    {
+        /* Fail if services in an image use different accounts */
+        if (!ScmIsSameServiceAccount(pServiceImage->pszAccountName, ObjectName.Buffer))
+        {
+            LeaveCriticalSection(&ServiceImageCriticalSection);
+            dwError = ERROR_DIFFERENT_SERVICE_ACCOUNT;
+            goto done;
+        }
+
+        /* Increment the run counter */
+        pServiceImage->dwImageRunCount++;
+    }
+    LeaveCriticalSection(&ServiceImageCriticalSection);
+
     if (pServiceImage == NULL)
     {
         dwRecordSize = sizeof(SERVICE_IMAGE) +
-                       ImagePath.Length + sizeof(WCHAR) +
+                       (wcslen(lpImagePath) + 1) * sizeof(WCHAR) +
                        ((ObjectName.Length != 0) ? (ObjectName.Length + sizeof(WCHAR)) : 0);
 
         /* Create a new service image */
@@ -523,7 +640,7 @@ ScmCreateOrReferenceServiceImage(PSERVICE pService)
         /* Set the image path */
         pServiceImage->pszImagePath = pString;
         wcscpy(pServiceImage->pszImagePath,
-               ImagePath.Buffer);
+               lpImagePath);
 
         /* Set the account name */
         if (ObjectName.Length > 0)
@@ -582,23 +699,37 @@ ScmCreateOrReferenceServiceImage(PSERVICE pService)
         /* FIXME: Add more initialization code here */
 
 
-        /* Append service record */
-        InsertTailList(&ImageListHead,
-                       &pServiceImage->ImageListEntry);
-    }
-    else
-    {
-//        if ((lpService->Status.dwServiceType & SERVICE_WIN32_SHARE_PROCESS) == 0)
+        /*
+         * Another service of the same image may have created it while
+         * the lock was released. Use that one and drop the new one.
+         */
+        EnterCriticalSection(&ServiceImageCriticalSection);
+        pExistingImage = ScmGetServiceImageByImagePath(lpImagePath);
+        if (pExistingImage != NULL)
+        {
+            /* Fail if services in an image use different accounts */
+            if (!ScmIsSameServiceAccount(pExistingImage->pszAccountName, ObjectName.Buffer))
+            {
+                LeaveCriticalSection(&ServiceImageCriticalSection);
+                ScmFreeServiceImage(pServiceImage);
+                dwError = ERROR_DIFFERENT_SERVICE_ACCOUNT;
+                goto done;
+            }
 
-        /* Fail if services in an image use different accounts */
-        if (!ScmIsSameServiceAccount(pServiceImage->pszAccountName, ObjectName.Buffer))
+            /* Increment the run counter */
+            pExistingImage->dwImageRunCount++;
+            LeaveCriticalSection(&ServiceImageCriticalSection);
+
+            ScmFreeServiceImage(pServiceImage);
+            pServiceImage = pExistingImage;
+        }
+        else
         {
-            dwError = ERROR_DIFFERENT_SERVICE_ACCOUNT;
-            goto done;
+            /* Append service record */
+            InsertTailList(&ImageListHead,
+                           &pServiceImage->ImageListEntry);
+            LeaveCriticalSection(&ServiceImageCriticalSection);
         }
-
-        /* Increment the run counter */
-        pServiceImage->dwImageRunCount++;
     }
 
     DPRINT("pServiceImage->pszImagePath: %S\n", pServiceImage->pszImagePath);
@@ -609,6 +740,9 @@ ScmCreateOrReferenceServiceImage(PSERVICE pService)
     pService->lpImage = pServiceImage;
 
 done:
+    if (lpImagePath != NULL)
+        HeapFree(GetProcessHeap(), 0, lpImagePath);
+
     RtlFreeUnicodeString(&ObjectName);
     RtlFreeUnicodeString(&ImagePath);
 
@@ -626,30 +760,28 @@ ScmRemoveServiceImage(PSERVICE_IMAGE pServiceImage)
     /* FIXME: Terminate the process */
 
     /* Remove the service image from the list */
+    EnterCriticalSection(&ServiceImageCriticalSection);
     RemoveEntryList(&pServiceImage->ImageListEntry);
+    LeaveCriticalSection(&ServiceImageCriticalSection);
 
-    /* Close the process handle */
-    if (pServiceImage->hProcess != INVALID_HANDLE_VALUE)
-        CloseHandle(pServiceImage->hProcess);
+    ScmFreeServiceImage(pServiceImage);
+}
 
-    /* Close the control pipe */
-    if (pServiceImage->hControlPipe != INVALID_HANDLE_VALUE)
-        CloseHandle(pServiceImage->hControlPipe);
 
-    /* Unload the user profile */
-    if (pServiceImage->hProfile != NULL)
-    {
-        ScmEnableBackupRestorePrivileges(pServiceImage->hToken, TRUE);
-        UnloadUserProfile(pServiceImage->hToken, pServiceImage->hProfile);
-        ScmEnableBackupRestorePrivileges(pServiceImage->hToken, FALSE);
-    }
+/*
+ * Drops a reference of a service on its image. Returns TRUE for the last
+ * one, the caller then removes the image with ScmRemoveServiceImage.
+ */
+BOOL
+ScmDereferenceServiceImage(PSERVICE_IMAGE pServiceImage)
+{
+    BOOL bLastReference;
 
-    /* Close the logon token */
-    if (pServiceImage->hToken != NULL)
-        CloseHandle(pServiceImage->hToken);
+    EnterCriticalSection(&ServiceImageCriticalSection);
+    bLastReference = (--pServiceImage->dwImageRunCount == 0);
+    LeaveCriticalSection(&ServiceImageCriticalSection);
 
-    /* Release the service image */
-    HeapFree(GetProcessHeap(), 0, pServiceImage);
+    return bLastReference;
 }
 
 
@@ -825,9 +957,7 @@ ScmDeleteServiceRecord(PSERVICE lpService)
     /* Dereference the service image */
     if (lpService->lpImage)
     {
-        lpService->lpImage->dwImageRunCount--;
-
-        if (lpService->lpImage->dwImageRunCount == 0)
+        if (ScmDereferenceServiceImage(lpService->lpImage))
         {
             ScmRemoveServiceImage(lpService->lpImage);
             lpService->lpImage = NULL;
@@ -1084,6 +1214,40 @@ ScmGetNoInteractiveServicesValue(VOID)
 }
 
 
+static
+VOID
+ScmGetAutoStartParallelismValue(VOID)
+{
+    HKEY hKey;
+    DWORD dwKeySize;
+    DWORD dwValue;
+    LONG lError;
+
+    lError = RegOpenKeyExW(HKEY_LOCAL_MACHINE,
+                           L"SYSTEM\\CurrentControlSet\\Control",
+                           0,
+                           KEY_READ,
+                           &hKey);
+    if (lError == ERROR_SUCCESS)
+    {
+        dwKeySize = sizeof(dwValue);
+        lError = RegQueryValueExW(hKey,
+                                  L"ServicesStartParallelism",
+                                  0,
+                                  NULL,
+                                  (LPBYTE)&dwValue,
+                                  &dwKeySize);
+        if (lError == ERROR_SUCCESS)
+        {
+            /* 1 starts the services one after the other */
+            AutoStartParallelism = max(1, min(dwValue, MAXIMUM_WAIT_OBJECTS));
+        }
+
+        RegCloseKey(hKey);
+    }
+}
+
+
 DWORD
 ScmCreateServiceDatabase(VOID)
 {
@@ -1100,6 +1264,9 @@ ScmCreateServiceDatabase(VOID)
     /* Retrieve the NoInteractiveServies value */
     ScmGetNoInteractiveServicesValue();
 
+    /* Retrieve the ServicesStartParallelism value */
+    ScmGetAutoStartParallelismValue();
+
     /* Create the service group list */
     dwError = ScmCreateGroupList();
     if (dwError != ERROR_SUCCESS)
@@ -1111,6 +1278,7 @@ ScmCreateServiceDatabase(VOID)
 
     /* Initialize the database lock */
     RtlInitializeResource(&DatabaseLock);
+    InitializeCriticalSection(&ServiceImageCriticalSection);
 
     dwError = RegOpenKeyExW(HKEY_LOCAL_MACHINE,
                             L"System\\CurrentControlSet\\Services",
@@ -1177,6 +1345,7 @@ ScmShutdownServiceDatabase(VOID)
     DPRINT("ScmShutdownServiceDatabase() called\n");
 
     ScmDeleteMarkedServices();
+    DeleteCriticalSection(&ServiceImageCriticalSection);
     RtlDeleteResource(&DatabaseLock);
 
     DPRINT("ScmShutdownServiceDatabase() done\n");
@@ -1878,12 +2047,17 @@ ScmStartUserModeService(PSERVICE Service,
     STARTUPINFOW StartupInfo;
     LPVOID lpEnvironment;
     BOOL Result;
+    BOOL bImageRunning;
     DWORD dwError = ERROR_SUCCESS;
 
     DPRINT("ScmStartUserModeService(%p)\n", Service);
 
+    EnterCriticalSection(&ServiceImageCriticalSection);
+    bImageRunning = (Service->lpImage->dwImageRunCount > 1);
+    LeaveCriticalSection(&ServiceImageCriticalSection);
+
     /* If the image is already running ... */
-    if (Service->lpImage->dwImageRunCount > 1)
+    if (bImageRunning)
     {
         /* ... just send a start command */
         return ScmSendStartCommand(Service, argc, argv);
@@ -2028,11 +2202,14 @@ ScmLoadService(PSERVICE Service,
     DPRINT("ScmLoadService() called\n");
     DPRINT("Start Service %p (%S)\n", Service, Service->lpServiceName);
 
+    EnterCriticalSection(&ServiceImageCriticalSection);
     if (Service->Status.dwCurrentState != SERVICE_STOPPED)
     {
+        LeaveCriticalSection(&ServiceImageCriticalSection);
         DPRINT("Service %S is already running\n", Service->lpServiceName);
         return ERROR_SERVICE_ALREADY_RUNNING;
     }
+    LeaveCriticalSection(&ServiceImageCriticalSection);
 
     DPRINT("Service->Type: %lu\n", Service->Status.dwServiceType);
 
@@ -2050,13 +2227,14 @@ ScmLoadService(PSERVICE Service,
             dwError = ScmStartUserModeService(Service, argc, argv);
             if (dwError == ERROR_SUCCESS)
             {
+                EnterCriticalSection(&ServiceImageCriticalSection);
                 Service->Status.dwCurrentState = SERVICE_START_PENDING;
                 Service->Status.dwControlsAccepted = 0;
+                LeaveCriticalSection(&ServiceImageCriticalSection);
             }
             else
             {
-                Service->lpImage->dwImageRunCount--;
-                if (Service->lpImage->dwImageRunCount == 0)
+                if (ScmDereferenceServiceImage(Service->lpImage))
                 {
                     ScmRemoveServiceImage(Service->lpImage);
                     Service->lpImage = NULL;
@@ -2071,7 +2249,9 @@ ScmLoadService(PSERVICE Service,
     {
         if (Group != NULL)
         {
+            EnterCriticalSection(&ServiceImageCriticalSection);
             Group->ServicesRunning = TRUE;
+            LeaveCriticalSection(&ServiceImageCriticalSection);
         }
 
         /* Log a successful service start */
@@ -2167,6 +2347,255 @@ done:
 }
 
 
+static DWORD
+WINAPI
+ScmAutoStartThread(LPVOID lpParameter)
+{
+    PAUTO_START_ENTRY Entry = (PAUTO_START_ENTRY)lpParameter;
+
+    Entry->dwError = ScmLoadService(Entry->Service, 0, NULL);
+
+    return 0;
+}
+
+
+static VOID
+ScmAddAutoStartService(PAUTO_START_BATCH Batch,
+                       PSERVICE Service,
+                       BOOL bTagged)
+{
+    PAUTO_START_ENTRY Entry;
+    HKEY hServiceKey;
+    LPWSTR lpImagePath;
+    DWORD dwLength;
+
+    Service->ServiceVisited = TRUE;
+
+    /* Start the service right away if the batch could not be allocated */
+    if (Batch->dwCount >= Batch->dwMaxCount)
+    {
+        ScmLoadService(Service, 0, NULL);
+        return;
+    }
+
+    Entry = &Batch->Entries[Batch->dwCount++];
+    ZeroMemory(Entry, sizeof(AUTO_START_ENTRY));
+    Entry->Service = Service;
+    Entry->bTagged = bTagged;
+
+    if (ScmOpenServiceKey(Service->lpServiceName,
+                          KEY_READ,
+                          &hServiceKey) == ERROR_SUCCESS)
+    {
+        ScmReadDependencies(hServiceKey,
+                            &Entry->lpDependencies,
+                            &dwLength);
+
+        /* Services sharing an image must not be started concurrently */
+        if ((Service->Status.dwServiceType & SERVICE_DRIVER) == 0)
+        {
+            if (ScmReadString(hServiceKey,
+                              L"ImagePath",
+                              &lpImagePath) == ERROR_SUCCESS)
+            {
+                Entry->lpImagePath = ScmExpandImagePath(lpImagePath);
+                HeapFree(GetProcessHeap(), 0, lpImagePath);
+            }
+        }
+
+        RegCloseKey(hServiceKey);
+    }
+}
+
+
+/* Returns TRUE if Entry must not be started before Other has been started */
+static BOOL
+ScmIsAutoStartDependency(PAUTO_START_ENTRY Entry,
+                         PAUTO_START_ENTRY Other)
+{
+    PSERVICE_GROUP Group = Other->Service->lpGroup;
+    LPWSTR lpName;
+
+    if (Entry == Other)
+        return FALSE;
+
+    /* Keep the tag order, and the list order for services of an image */
+    if (Other < Entry)
+    {
+        if (Other->bTagged)
+            return TRUE;
+
+        if ((Entry->lpImagePath != NULL) &&
+            (Other->lpImagePath != NULL) &&
+            (_wcsicmp(Entry->lpImagePath, Other->lpImagePath) == 0))
+            return TRUE;
+    }
+
+    if (Entry->lpDependencies == NULL)
+        return FALSE;
+
+    for (lpName = Entry->lpDependencies; *lpName != 0; lpName += wcslen(lpName) + 1)
+    {
+        if (*lpName == SC_GROUP_IDENTIFIERW)
+        {
+            if ((Group != NULL) &&
+                (_wcsicmp(lpName + 1, Group->lpGroupName) == 0))
+                return TRUE;
+        }
+        else if (_wcsicmp(lpName, Other->Service->lpServiceName) == 0)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+
+static VOID
+ScmFinishAutoStartEntry(PAUTO_START_BATCH Batch,
+                        PAUTO_START_ENTRY Entry,
+                        DWORD dwBatchStartTime)
+{
+    DWORD i;
+
+    /* Log when each service started and how long it took, to show the critical path */
+    DPRINT("Auto-start '%S' at +%lu ms took %lu ms (Error %lu)\n",
+           Entry->Service->lpServiceName,
+           Entry->dwStartTime - dwBatchStartTime,
+           GetTickCount() - Entry->dwStartTime,
+           Entry->dwError);
+
+    /* Release the services that were waiting for this one */
+    for (i = 0; i < Batch->dwCount; i++)
+    {
+        if (!Batch->Entries[i].bStarted &&
+            ScmIsAutoStartDependency(&Batch->Entries[i], Entry))
+        {
+            Batch->Entries[i].dwPendingCount--;
+        }
+    }
+}
+
+
+/*
+ * Start the services of a batch, running up to AutoStartParallelism
+ * ScmLoadService calls at a time. A service is started once all its
+ * dependencies inside the batch have been started.
+ */
+static VOID
+ScmRunAutoStartBatch(PAUTO_START_BATCH Batch)
+{
+    HANDLE WaitHandles[MAXIMUM_WAIT_OBJECTS];
+    PAUTO_START_ENTRY WaitEntries[MAXIMUM_WAIT_OBJECTS];
+    PAUTO_START_ENTRY Entry;
+    HANDLE hThread;
+    DWORD dwBatchStartTime;
+    DWORD dwRunning = 0;
+    DWORD dwFinished = 0;
+    DWORD dwWait;
+    DWORD i, j;
+    BOOL bLaunched;
+
+    dwBatchStartTime = GetTickCount();
+
+    /* Count the dependencies of each service inside the batch */
+    for (i = 0; i < Batch->dwCount; i++)
+    {
+        Entry = &Batch->Entries[i];
+        Entry->dwPendingCount = 0;
+        for (j = 0; j < Batch->dwCount; j++)
+        {
+            if (ScmIsAutoStartDependency(Entry, &Batch->Entries[j]))
+                Entry->dwPendingCount++;
+        }
+    }
+
+    while (dwFinished < Batch->dwCount)
+    {
+        /* Start the services that are ready, in list order */
+        bLaunched = FALSE;
+        for (i = 0; i < Batch->dwCount && dwRunning < AutoStartParallelism; i++)
+        {
+            Entry = &Batch->Entries[i];
+            if (Entry->bStarted || Entry->dwPendingCount != 0)
+                continue;
+
+            Entry->bStarted = TRUE;
+            Entry->dwStartTime = GetTickCount();
+            bLaunched = TRUE;
+
+            hThread = CreateThread(NULL, 0, ScmAutoStartThread, Entry, 0, NULL);
+            if (hThread == NULL)
+            {
+                DPRINT1("CreateThread() failed (Error %lu)\n", GetLastError());
+
+                /* Start the service on this thread instead */
+                ScmAutoStartThread(Entry);
+                ScmFinishAutoStartEntry(Batch, Entry, dwBatchStartTime);
+                dwFinished++;
+                continue;
+            }
+
+            WaitHandles[dwRunning] = hThread;
+            WaitEntries[dwRunning] = Entry;
+            dwRunning++;
+        }
+
+        if (dwRunning == 0)
+        {
+            if (!bLaunched)
+            {
+                /* Only a dependency cycle gets us here, break it in list order */
+                for (i = 0; i < Batch->dwCount; i++)
+                {
+                    Entry = &Batch->Entries[i];
+                    if (!Entry->bStarted)
+                    {
+                        DPRINT1("Dependency cycle, starting '%S' anyway\n",
+                                Entry->Service->lpServiceName);
+                        Entry->dwPendingCount = 0;
+                        break;
+                    }
+                }
+            }
+
+            continue;
+        }
+
+        dwWait = WaitForMultipleObjects(dwRunning, WaitHandles, FALSE, INFINITE);
+        if (dwWait >= WAIT_OBJECT_0 + dwRunning)
+        {
+            DPRINT1("WaitForMultipleObjects() failed (Error %lu)\n", GetLastError());
+            WaitForSingleObject(WaitHandles[0], INFINITE);
+            dwWait = WAIT_OBJECT_0;
+        }
+
+        i = dwWait - WAIT_OBJECT_0;
+        CloseHandle(WaitHandles[i]);
+        ScmFinishAutoStartEntry(Batch, WaitEntries[i], dwBatchStartTime);
+        dwFinished++;
+
+        /* Move the last running thread into the free slot */
+        dwRunning--;
+        WaitHandles[i] = WaitHandles[dwRunning];
+        WaitEntries[i] = WaitEntries[dwRunning];
+    }
+
+    /* Empty the batch for the next group */
+    for (i = 0; i < Batch->dwCount; i++)
+    {
+        Entry = &Batch->Entries[i];
+        if (Entry->lpDependencies != NULL)
+            HeapFree(GetProcessHeap(), 0, Entry->lpDependencies);
+        if (Entry->lpImagePath != NULL)
+            HeapFree(GetProcessHeap(), 0, Entry->lpImagePath);
+    }
+
+    Batch->dwCount = 0;
+}
+
+
 VOID
 ScmAutoStartServices(VOID)
 {
@@ -2180,6 +2609,8 @@ ScmAutoStartServices(VOID)
     HKEY hKey;
     DWORD dwKeySize;
     ULONG i;
+    AUTO_START_BATCH Batch;
+    DWORD dwStartTime;
 
     /*
      * This function MUST be called ONLY at initialization time.
@@ -2212,11 +2643,16 @@ ScmAutoStartServices(VOID)
     /* Acquire the service control critical section, to synchronize starts */
     EnterCriticalSection(&ControlServiceCriticalSection);
 
+    dwStartTime = GetTickCount();
+    Batch.dwCount = 0;
+    Batch.dwMaxCount = 0;
+
     /* Clear 'ServiceVisited' flag (or set if not to start in Safe Mode) */
     ServiceEntry = ServiceListHead.Flink;
     while (ServiceEntry != &ServiceListHead)
     {
         CurrentService = CONTAINING_RECORD(ServiceEntry, SERVICE, ServiceListEntry);
+        Batch.dwMaxCount++;
 
         /* Build the safe boot path */
         StringCchCopyW(szSafeBootServicePath, ARRAYSIZE(szSafeBootServicePath),
@@ -2281,6 +2717,13 @@ ScmAutoStartServices(VOID)
         ServiceEntry = ServiceEntry->Flink;
     }
 
+    /* Allocate a batch that can hold every service */
+    Batch.Entries = HeapAlloc(GetProcessHeap(),
+                              0,
+                              Batch.dwMaxCount * sizeof(AUTO_START_ENTRY));
+    if (Batch.Entries == NULL)
+        Batch.dwMaxCount = 0;
+
     /* Start all services which are members of an existing group */
     GroupEntry = GroupListHead.Flink;
     while (GroupEntry != &GroupListHead)
@@ -2302,8 +2745,7 @@ ScmAutoStartServices(VOID)
                     (CurrentService->ServiceVisited == FALSE) &&
                     (CurrentService->dwTag == CurrentGroup->TagArray[i]))
                 {
-                    CurrentService->ServiceVisited = TRUE;
-                    ScmLoadService(CurrentService, 0, NULL);
+                    ScmAddAutoStartService(&Batch, CurrentService, TRUE);
                 }
 
                 ServiceEntry = ServiceEntry->Flink;
@@ -2320,13 +2762,15 @@ ScmAutoStartServices(VOID)
                 (CurrentService->dwStartType == SERVICE_AUTO_START) &&
                 (CurrentService->ServiceVisited == FALSE))
             {
-                CurrentService->ServiceVisited = TRUE;
-                ScmLoadService(CurrentService, 0, NULL);
+                ScmAddAutoStartService(&Batch, CurrentService, FALSE);
             }
 
             ServiceEntry = ServiceEntry->Flink;
         }
 
+        /* The next group starts once this one has been started */
+        ScmRunAutoStartBatch(&Batch);
+
         GroupEntry = GroupEntry->Flink;
     }
 
@@ -2340,13 +2784,14 @@ ScmAutoStartServices(VOID)
             (CurrentService->dwStartType == SERVICE_AUTO_START) &&
             (CurrentService->ServiceVisited == FALSE))
         {
-            CurrentService->ServiceVisited = TRUE;
-            ScmLoadService(CurrentService, 0, NULL);
+            ScmAddAutoStartService(&Batch, CurrentService, FALSE);
         }
 
         ServiceEntry = ServiceEntry->Flink;
     }
 
+    ScmRunAutoStartBatch(&Batch);
+
     /* Start all services which are not a member of any group */
     ServiceEntry = ServiceListHead.Flink;
     while (ServiceEntry != &ServiceListHead)
@@ -2357,13 +2802,14 @@ ScmAutoStartServices(VOID)
             (CurrentService->dwStartType == SERVICE_AUTO_START) &&
             (CurrentService->ServiceVisited == FALSE))
         {
-            CurrentService->ServiceVisited = TRUE;
-            ScmLoadService(CurrentService, 0, NULL);
+            ScmAddAutoStartService(&Batch, CurrentService, FALSE);
         }
 
         ServiceEntry = ServiceEntry->Flink;
     }
 
+    ScmRunAutoStartBatch(&Batch);
+
     /* Clear 'ServiceVisited' flag again */
     ServiceEntry = ServiceListHead.Flink;
     while (ServiceEntry != &ServiceListHead)
@@ -2373,6 +2819,11 @@ ScmAutoStartServices(VOID)
         ServiceEntry = ServiceEntry->Flink;
     }
 
+    if (Batch.Entries != NULL)
+        HeapFree(GetProcessHeap(), 0, Batch.Entries);
+
+    DPRINT("Auto-start done in %lu ms\n", GetTickCount() - dwStartTime);
+
     /* Release the critical section */
     LeaveCriticalSection(&ControlServiceCriticalSection);
 }
@@ -1758,11 +1758,8 @@ RSetServiceStatus(
     if ((lpServiceStatus->dwServiceType & SERVICE_WIN32) &&
         (lpServiceStatus->dwCurrentState == SERVICE_STOPPED))
     {
-        /* Decrement the image run counter */
-        lpService->lpImage->dwImageRunCount--;
-
-        /* If we just stopped the last running service... */
-        if (lpService->lpImage->dwImageRunCount == 0)
+        /* Decrement the image run counter. If we just stopped the last running service... */
+        if (ScmDereferenceServiceImage(lpService->lpImage))
         {
             /* Stop the dispatcher thread */
             ScmControlService(lpService->lpImage->hControlPipe,
@@ -187,6 +187,7 @@ DWORD ScmStartService(PSERVICE Service,
                       LPWSTR *argv);
 
 VOID ScmRemoveServiceImage(PSERVICE_IMAGE pServiceImage);
+BOOL ScmDereferenceServiceImage(PSERVICE_IMAGE pServiceImage);
 PSERVICE ScmGetServiceEntryByName(LPCWSTR lpServiceName);
 PSERVICE ScmGetServiceEntryByDisplayName(LPCWSTR lpDisplayName);
 PSERVICE ScmGetServiceEntryByResumeCount(DWORD dwResumeCount);
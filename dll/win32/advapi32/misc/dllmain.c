@@ -9,6 +9,7 @@
  */
 
 #include <advapi32.h>
+#include <cryptcpu.h>
 
 extern BOOL RegInitialize(VOID);
 extern BOOL RegCleanup(VOID);
@@ -27,6 +28,7 @@ DllMain(
         case DLL_PROCESS_ATTACH:
             DisableThreadLibraryCalls(hinstDll);
             RegInitialize();
+            CryptInitCpuFeatures();
             break;
 
         case DLL_PROCESS_DETACH:
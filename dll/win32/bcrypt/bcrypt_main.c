@@ -31,7 +31,10 @@
 #include <wine/unicode.h>
 #include <wine/library.h>
 
-#ifdef SONAME_LIBMBEDTLS
+#ifdef __REACTOS__
+#include <cryptcpu.h>
+#include <hmac.h>
+#elif defined(SONAME_LIBMBEDTLS)
 #include <mbedtls/md.h>
 #include <mbedtls/md5.h>
 #include <mbedtls/sha1.h>
@@ -663,6 +666,75 @@ static NTSTATUS hmac_finish( struct hash *hash, UCHAR *output, ULONG size )
     pgnutls_hmac_deinit( hash->u.hmac_handle, output );
     return STATUS_SUCCESS;
 }
+#elif defined(__REACTOS__)
+struct hash
+{
+    struct object hdr;
+    BOOL hmac;
+    enum alg_id   alg_id;
+    union
+    {
+        HASH_CTX hash_ctx;
+        HMAC_CTX hmac_ctx;
+    } u;
+};
+
+static int get_cryptlib_alg( enum alg_id id )
+{
+    switch (id)
+    {
+    case ALG_ID_MD5:    return HASH_ALG_MD5;
+    case ALG_ID_SHA1:   return HASH_ALG_SHA1;
+    case ALG_ID_SHA256: return HASH_ALG_SHA256;
+    case ALG_ID_SHA384: return HASH_ALG_SHA384;
+    case ALG_ID_SHA512: return HASH_ALG_SHA512;
+    default:            return -1;
+    }
+}
+
+static NTSTATUS hash_init( struct hash *hash )
+{
+    if (!HASH_Init( &hash->u.hash_ctx, get_cryptlib_alg( hash->alg_id ) ))
+    {
+        ERR( "unhandled id %u\n", hash->alg_id );
+        return STATUS_NOT_IMPLEMENTED;
+    }
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS hmac_init( struct hash *hash, UCHAR *key, ULONG key_size )
+{
+    if (!HMAC_Init( &hash->u.hmac_ctx, get_cryptlib_alg( hash->alg_id ), key, key_size ))
+    {
+        ERR( "unhandled id %u\n", hash->alg_id );
+        return STATUS_NOT_IMPLEMENTED;
+    }
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS hash_update( struct hash *hash, UCHAR *input, ULONG size )
+{
+    HASH_Update( &hash->u.hash_ctx, input, size );
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS hmac_update( struct hash *hash, UCHAR *input, ULONG size )
+{
+    HMAC_Update( &hash->u.hmac_ctx, input, size );
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS hash_finish( struct hash *hash, UCHAR *output, ULONG size )
+{
+    HASH_Final( output, &hash->u.hash_ctx );
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS hmac_finish( struct hash *hash, UCHAR *output, ULONG size )
+{
+    HMAC_Final( output, &hash->u.hmac_ctx );
+    return STATUS_SUCCESS;
+}
 #elif defined(SONAME_LIBMBEDTLS)
 struct hash
 {
@@ -1136,6 +1208,9 @@ BOOL WINAPI DllMain( HINSTANCE hinst, DWORD reason, LPVOID reserved )
         gnutls_initialize();
 #elif defined(SONAME_LIBMBEDTLS) && !defined(HAVE_COMMONCRYPTO_COMMONDIGEST_H) && !defined(__REACTOS__)
         mbedtls_initialize();
+#endif
+#ifdef __REACTOS__
+        CryptInitCpuFeatures();
 #endif
         break;
 
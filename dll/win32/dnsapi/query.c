@@ -671,6 +671,8 @@ Query_Main(LPCWSTR Name,
     PCHAR HostWithDomainName;
     PCHAR AnsiName;
     size_t NameLen = 0;
+    DNS_STATUS Status;
+    DWORD Now;
 
     if (Name == NULL)
         return ERROR_INVALID_PARAMETER;
@@ -750,6 +752,8 @@ Query_Main(LPCWSTR Name,
             (*QueryResultSet)->Flags.S.Section = DnsSectionAnswer;
             (*QueryResultSet)->Flags.S.CharSet = DnsCharSetUnicode;
             (*QueryResultSet)->Data.A.IpAddress = Address;
+            /* The addresses of this host can change at any time */
+            (*QueryResultSet)->dwTtl = 0;
 
             (*QueryResultSet)->pName = (LPSTR)DnsCToW(HostWithDomainName);
 
@@ -843,6 +847,9 @@ Query_Main(LPCWSTR Name,
                 (*QueryResultSet)->Flags.S.Section = DnsSectionAnswer;
                 (*QueryResultSet)->Flags.S.CharSet = DnsCharSetUnicode;
                 (*QueryResultSet)->Data.A.IpAddress = answer->rrs.addr->addr.inet.sin_addr.s_addr;
+                /* adns gives the expiry time in seconds since 1970 */
+                Now = GetCurrentTimeInSeconds();
+                (*QueryResultSet)->dwTtl = (DWORD)answer->expires > Now ? (DWORD)answer->expires - Now : 0;
 
                 adns_finish(astate);
 
@@ -853,13 +860,21 @@ Query_Main(LPCWSTR Name,
 
             if (NULL == answer || adns_s_prohibitedcname != answer->status || NULL == answer->cname)
             {
+                /* Tell the name errors and the empty answers apart, the resolver caches them */
+                if (answer && answer->status == adns_s_nxdomain)
+                    Status = DNS_ERROR_RCODE_NAME_ERROR;
+                else if (answer && answer->status == adns_s_nodata)
+                    Status = DNS_INFO_NO_RECORDS;
+                else
+                    Status = ERROR_FILE_NOT_FOUND;
+
                 adns_finish(astate);
 
                 if (CurrentName != AnsiName)
                     RtlFreeHeap(RtlGetProcessHeap(), 0, CurrentName);
 
                 RtlFreeHeap(RtlGetProcessHeap(), 0, AnsiName);
-                return ERROR_FILE_NOT_FOUND;
+                return Status;
             }
 
             if (CurrentName != AnsiName)
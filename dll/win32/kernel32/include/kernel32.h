@@ -66,6 +66,7 @@ typedef struct _CODEPAGE_ENTRY
     HANDLE SectionHandle;
     PBYTE SectionMapping;
     CPTABLEINFO CodePageTable;
+    BOOLEAN AsciiCompatible;
 } CODEPAGE_ENTRY, *PCODEPAGE_ENTRY;
 
 typedef struct tagLOADPARMS32
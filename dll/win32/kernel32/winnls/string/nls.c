@@ -15,6 +15,7 @@
 /* INCLUDES *******************************************************************/
 
 #include <k32.h>
+#include <nlsascii.h>
 
 #define NDEBUG
 #include <debug.h>
@@ -197,6 +198,7 @@ NlsInit(VOID)
     RtlInitCodePageTable((PUSHORT)AnsiCodePage.SectionMapping,
                          &AnsiCodePage.CodePageTable);
     AnsiCodePage.CodePage = AnsiCodePage.CodePageTable.CodePage;
+    AnsiCodePage.AsciiCompatible = NlsIsAsciiCodePage(&AnsiCodePage.CodePageTable);
 
     InsertTailList(&CodePageListHead, &AnsiCodePage.Entry);
 
@@ -207,6 +209,7 @@ NlsInit(VOID)
     RtlInitCodePageTable((PUSHORT)OemCodePage.SectionMapping,
                          &OemCodePage.CodePageTable);
     OemCodePage.CodePage = OemCodePage.CodePageTable.CodePage;
+    OemCodePage.AsciiCompatible = NlsIsAsciiCodePage(&OemCodePage.CodePageTable);
     InsertTailList(&CodePageListHead, &OemCodePage.Entry);
 
     return TRUE;
@@ -467,6 +470,7 @@ IntGetCodePageEntry(UINT CodePage)
     CodePageEntry->SectionMapping = SectionMapping;
 
     RtlInitCodePageTable((PUSHORT)SectionMapping, &CodePageEntry->CodePageTable);
+    CodePageEntry->AsciiCompatible = NlsIsAsciiCodePage(&CodePageEntry->CodePageTable);
 
     /* Insert the new entry to list and unlock. Uff. */
     InsertTailList(&CodePageListHead, &CodePageEntry->Entry);
@@ -497,6 +501,7 @@ IntMultiByteToWideCharUTF8(DWORD Flags,
     UCHAR Char, TrailLength;
     WCHAR WideChar;
     LONG Count;
+    ULONG Run;
     BOOL CharIsValid, StringIsValid = TRUE;
     const WCHAR InvalidChar = 0xFFFD;
 
@@ -516,6 +521,10 @@ IntMultiByteToWideCharUTF8(DWORD Flags,
             Char = *MultiByteString++;
             if (Char < 0x80)
             {
+                /* Count the rest of the ASCII run at once */
+                Run = NlsAsciiSpanA(MultiByteString, MbsEnd - MultiByteString);
+                MultiByteString += Run;
+                WideCharCount += Run;
                 TrailLength = 0;
                 continue;
             }
@@ -578,6 +587,13 @@ IntMultiByteToWideCharUTF8(DWORD Flags,
         if (Char < 0x80)
         {
             *WideCharString++ = Char;
+
+            /* Take the rest of the ASCII run at once */
+            Run = NlsWidenAscii(WideCharString, MultiByteString,
+                                min(WideCharCount - Count - 1, MbsEnd - MultiByteString));
+            WideCharString += Run;
+            MultiByteString += Run;
+            Count += Run;
             TrailLength = 0;
             continue;
         }
@@ -672,6 +688,8 @@ IntMultiByteToWideCharCP(UINT CodePage,
     LPCSTR TempString;
     INT TempLength;
     USHORT WideChar;
+    BOOLEAN AsciiRuns;
+    ULONG Run;
 
     /* Get code page table. */
     CodePageEntry = IntGetCodePageEntry(CodePage);
@@ -688,10 +706,12 @@ IntMultiByteToWideCharCP(UINT CodePage,
     {
         /* Use glyph table */
         MultiByteTable = CodePageTable->MultiByteTable + 256 + 1;
+        AsciiRuns = FALSE;
     }
     else
     {
         MultiByteTable = CodePageTable->MultiByteTable;
+        AsciiRuns = CodePageEntry->AsciiCompatible;
     }
 
     /* Different handling for DBCS code pages. */
@@ -755,6 +775,15 @@ IntMultiByteToWideCharCP(UINT CodePage,
             {
                 Char = *MultiByteString++;
 
+                if (AsciiRuns && Char < 0x80)
+                {
+                    /* Count the rest of the ASCII run at once */
+                    Run = NlsAsciiSpanA(MultiByteString, MbsEnd - MultiByteString);
+                    MultiByteString += Run;
+                    WideCharCount += Run;
+                    continue;
+                }
+
                 DBCSOffset = CodePageTable->DBCSOffsets[Char];
 
                 if (!DBCSOffset)
@@ -771,6 +800,19 @@ IntMultiByteToWideCharCP(UINT CodePage,
         {
             Char = *MultiByteString++;
 
+            if (AsciiRuns && Char < 0x80)
+            {
+                *WideCharString++ = Char;
+
+                /* Take the rest of the ASCII run at once */
+                Run = NlsWidenAscii(WideCharString, MultiByteString,
+                                    min(WideCharCount - Count - 1, MbsEnd - MultiByteString));
+                WideCharString += Run;
+                MultiByteString += Run;
+                Count += Run;
+                continue;
+            }
+
             DBCSOffset = CodePageTable->DBCSOffsets[Char];
 
             if (!DBCSOffset)
@@ -828,6 +870,16 @@ IntMultiByteToWideCharCP(UINT CodePage,
             TempLength > 0;
             MultiByteString++, TempLength--)
         {
+            if (AsciiRuns && (UCHAR)*MultiByteString < 0x80)
+            {
+                Run = NlsWidenAscii(WideCharString, MultiByteString, TempLength);
+                WideCharString += Run;
+                MultiByteString += Run;
+                TempLength -= Run;
+                if (!TempLength)
+                    break;
+            }
+
             *WideCharString++ = MultiByteTable[(UCHAR)*MultiByteString];
         }
 
@@ -981,6 +1033,7 @@ IntWideCharToMultiByteUTF8(UINT CodePage,
 {
     INT TempLength;
     DWORD Char;
+    ULONG Run;
 
     if (Flags)
     {
@@ -995,14 +1048,22 @@ IntWideCharToMultiByteUTF8(UINT CodePage,
             WideCharCount--, WideCharString++)
         {
             TempLength++;
-            if (*WideCharString >= 0x80)
+            if (*WideCharString < 0x80)
+            {
+                /* Count the rest of the ASCII run at once */
+                Run = NlsAsciiSpanW(WideCharString + 1, WideCharCount - 1);
+                WideCharString += Run;
+                WideCharCount -= Run;
+                TempLength += Run;
+            }
+            else
             {
                 TempLength++;
                 if (*WideCharString >= 0x800)
                 {
                     TempLength++;
                     if (*WideCharString >= 0xd800 && *WideCharString < 0xdc00 &&
-                        WideCharCount >= 1 &&
+                        WideCharCount > 1 &&
                         WideCharString[1] >= 0xdc00 && WideCharString[1] <= 0xe000)
                     {
                         WideCharCount--;
@@ -1027,6 +1088,13 @@ IntWideCharToMultiByteUTF8(UINT CodePage,
             }
             TempLength--;
             *MultiByteString++ = (CHAR)Char;
+
+            /* Take the rest of the ASCII run at once */
+            Run = NlsNarrowAscii(MultiByteString, WideCharString + 1, min(TempLength, WideCharCount - 1));
+            MultiByteString += Run;
+            WideCharString += Run;
+            WideCharCount -= Run;
+            TempLength -= Run;
             continue;
         }
 
@@ -1046,7 +1114,7 @@ IntWideCharToMultiByteUTF8(UINT CodePage,
 
         /* surrogate pair 0x10000-0x10ffff: 4 bytes */
         if (Char >= 0xd800 && Char < 0xdc00 &&
-            WideCharCount >= 1 &&
+            WideCharCount > 1 &&
             WideCharString[1] >= 0xdc00 && WideCharString[1] < 0xe000)
         {
             WideCharCount--;
@@ -1168,6 +1236,7 @@ IntWideCharToMultiByteCP(UINT CodePage,
     PCODEPAGE_ENTRY CodePageEntry;
     PCPTABLEINFO CodePageTable;
     INT TempLength;
+    ULONG Run;
 
     /* Get code page table. */
     CodePageEntry = IntGetCodePageEntry(CodePage);
@@ -1296,7 +1365,20 @@ IntWideCharToMultiByteCP(UINT CodePage,
              WideCharCount && TempLength;
              TempLength--, WideCharString++, WideCharCount--)
         {
-            USHORT uChar = ((PUSHORT) CodePageTable->WideCharTable)[*WideCharString];
+            USHORT uChar;
+
+            if (CodePageEntry->AsciiCompatible && *WideCharString < 0x80)
+            {
+                Run = NlsNarrowAscii(MultiByteString, WideCharString, min(TempLength, WideCharCount));
+                MultiByteString += Run;
+                WideCharString += Run;
+                WideCharCount -= Run;
+                TempLength -= Run;
+                if (!WideCharCount || !TempLength)
+                    break;
+            }
+
+            uChar = ((PUSHORT) CodePageTable->WideCharTable)[*WideCharString];
 
             /* Is this a double-byte character? */
             if (uChar & 0xff00)
@@ -1415,8 +1497,18 @@ IntWideCharToMultiByteCP(UINT CodePage,
         }
 
         /* Convert the WideCharString to the MultiByteString */
-        for (TempLength = WideCharCount; --TempLength >= 0; WideCharString++, MultiByteString++)
+        for (TempLength = WideCharCount; TempLength > 0; TempLength--, WideCharString++, MultiByteString++)
         {
+            if (CodePageEntry->AsciiCompatible && *WideCharString < 0x80)
+            {
+                Run = NlsNarrowAscii(MultiByteString, WideCharString, TempLength);
+                MultiByteString += Run;
+                WideCharString += Run;
+                TempLength -= Run;
+                if (!TempLength)
+                    break;
+            }
+
             *MultiByteString = ((PCHAR)CodePageTable->WideCharTable)[*WideCharString];
         }
 
@@ -2532,6 +2532,19 @@ WSPIoctl(IN  SOCKET Handle,
             }
 
             break;
+        case SIO_AFD_SET_NOTIFY:
+            if (cbInBuffer < sizeof(AFD_NOTIFY_INFO) || IS_INTRESOURCE(lpvInBuffer))
+            {
+                Errno = WSAEFAULT;
+                break;
+            }
+            NeedsCompletion = FALSE;
+            Errno = SockSetNotify(Socket,
+                                  ((PAFD_NOTIFY_INFO)lpvInBuffer)->Events,
+                                  ((PAFD_NOTIFY_INFO)lpvInBuffer)->Context);
+            if (Errno == NO_ERROR)
+                Ret = NO_ERROR;
+            break;
         case SIO_ADDRESS_LIST_QUERY:
             if (IS_INTRESOURCE(lpvOutBuffer) || cbOutBuffer == 0)
             {
@@ -12,6 +12,48 @@
 
 #include <msafd.h>
 
+static
+ULONG
+SockNetworkEventsToAfdEvents(
+    IN long lNetworkEvents)
+{
+    ULONG Events = 0;
+
+    if (lNetworkEvents & FD_READ) {
+        Events |= AFD_EVENT_RECEIVE;
+    }
+
+    if (lNetworkEvents & FD_WRITE) {
+        Events |= AFD_EVENT_SEND;
+    }
+
+    if (lNetworkEvents & FD_OOB) {
+        Events |= AFD_EVENT_OOB_RECEIVE;
+    }
+
+    if (lNetworkEvents & FD_ACCEPT) {
+        Events |= AFD_EVENT_ACCEPT;
+    }
+
+    if (lNetworkEvents & FD_CONNECT) {
+        Events |= AFD_EVENT_CONNECT | AFD_EVENT_CONNECT_FAIL;
+    }
+
+    if (lNetworkEvents & FD_CLOSE) {
+        Events |= AFD_EVENT_DISCONNECT | AFD_EVENT_ABORT | AFD_EVENT_CLOSE;
+    }
+
+    if (lNetworkEvents & FD_QOS) {
+        Events |= AFD_EVENT_QOS;
+    }
+
+    if (lNetworkEvents & FD_GROUP_QOS) {
+        Events |= AFD_EVENT_GROUP_QOS;
+    }
+
+    return Events;
+}
+
 int
 WSPAPI
 WSPEventSelect(
@@ -57,40 +99,9 @@ WSPEventSelect(
 
     /* Set Structure Info */
     EventSelectInfo.EventObject = hEventObject;
-    EventSelectInfo.Events = 0;
 
     /* Set Events to wait for */
-    if (lNetworkEvents & FD_READ) {
-        EventSelectInfo.Events |= AFD_EVENT_RECEIVE;
-    }
-
-    if (lNetworkEvents & FD_WRITE) {
-        EventSelectInfo.Events |= AFD_EVENT_SEND;
-    }
-
-    if (lNetworkEvents & FD_OOB) {
-        EventSelectInfo.Events |= AFD_EVENT_OOB_RECEIVE;
-    }
-
-    if (lNetworkEvents & FD_ACCEPT) {
-        EventSelectInfo.Events |= AFD_EVENT_ACCEPT;
-    }
-
-    if (lNetworkEvents & FD_CONNECT) {
-        EventSelectInfo.Events |= AFD_EVENT_CONNECT | AFD_EVENT_CONNECT_FAIL;
-    }
-
-    if (lNetworkEvents & FD_CLOSE) {
-        EventSelectInfo.Events |= AFD_EVENT_DISCONNECT | AFD_EVENT_ABORT | AFD_EVENT_CLOSE;
-    }
-
-    if (lNetworkEvents & FD_QOS) {
-        EventSelectInfo.Events |= AFD_EVENT_QOS;
-    }
-
-    if (lNetworkEvents & FD_GROUP_QOS) {
-        EventSelectInfo.Events |= AFD_EVENT_GROUP_QOS;
-    }
+    EventSelectInfo.Events = SockNetworkEventsToAfdEvents(lNetworkEvents);
 
     /* Send IOCTL */
     Status = NtDeviceIoControlFile((HANDLE)Handle,
@@ -127,6 +138,56 @@ WSPEventSelect(
     return 0;
 }
 
+INT
+SockSetNotify(
+    IN PSOCKET_INFORMATION Socket,
+    IN long lNetworkEvents,
+    IN PVOID Context)
+{
+    IO_STATUS_BLOCK   IOSB;
+    AFD_NOTIFY_INFO   NotifyInfo;
+    NTSTATUS          Status;
+    HANDLE            SockEvent;
+
+    TRACE("SockSetNotify (%p) %lx %p\n", Socket, lNetworkEvents, Context);
+
+    Status = NtCreateEvent(&SockEvent, EVENT_ALL_ACCESS,
+                           NULL, SynchronizationEvent, FALSE);
+
+    if (!NT_SUCCESS(Status)) return WSAENOBUFS;
+
+    NotifyInfo.Events = SockNetworkEventsToAfdEvents(lNetworkEvents);
+    NotifyInfo.Context = Context;
+
+    /* Send IOCTL */
+    Status = NtDeviceIoControlFile((HANDLE)Socket->Handle,
+                                   SockEvent,
+                                   NULL,
+                                   NULL,
+                                   &IOSB,
+                                   IOCTL_AFD_SET_NOTIFY,
+                                   &NotifyInfo,
+                                   sizeof(NotifyInfo),
+                                   NULL,
+                                   0);
+
+    /* Wait for return */
+    if (Status == STATUS_PENDING) {
+        WaitForSingleObject(SockEvent, INFINITE);
+        Status = IOSB.Status;
+    }
+
+    NtClose (SockEvent);
+
+    if (Status != STATUS_SUCCESS)
+    {
+        ERR("Got status 0x%08x.\n", Status);
+        return TranslateNtStatusError(Status);
+    }
+
+    return NO_ERROR;
+}
+
 
 INT
 WSPAPI
@@ -539,6 +539,12 @@ SockReenableAsyncSelectEvent (
     IN ULONG Event
     );
 
+INT
+SockSetNotify(
+    IN PSOCKET_INFORMATION Socket,
+    IN long lNetworkEvents,
+    IN PVOID Context);
+
 typedef VOID (*PASYNC_COMPLETION_ROUTINE)(PVOID Context, PIO_STATUS_BLOCK IoStatusBlock);
 
 FORCEINLINE
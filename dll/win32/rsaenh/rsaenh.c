@@ -44,6 +44,9 @@
 #include <rpcproxy.h>
 #include <aclapi.h>
 #include <strsafe.h>
+#ifdef __REACTOS__
+#include <cryptcpu.h>
+#endif
 
 WINE_DEFAULT_DEBUG_CHANNEL(crypt);
 
@@ -372,6 +375,9 @@ BOOL WINAPI DllMain(HINSTANCE hInstance, DWORD fdwReason, PVOID reserved)
             instance = hInstance;
             DisableThreadLibraryCalls(hInstance);
             init_handle_table(&handle_table);
+#ifdef __REACTOS__
+            CryptInitCpuFeatures();
+#endif
             break;
 
         case DLL_PROCESS_DETACH:
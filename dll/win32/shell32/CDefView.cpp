@@ -66,6 +66,7 @@ typedef struct
 
 #define SHV_CHANGE_NOTIFY   (WM_USER + 0x1111)
 #define SHV_UPDATESTATUSBAR (WM_USER + 0x1112)
+#define SHV_UPDATEICONS     (WM_USER + 0x1113)
 
 // For the context menu of the def view, the id of the items are based on 1 because we need
 // to call TrackPopupMenu and let it use the 0 value as an indication that the menu was canceled
@@ -183,6 +184,208 @@ static UINT CalculateCharWidth(HWND hwnd)
     return ret;
 }
 
+struct ICON_TASK_ITEM
+{
+    LPARAM lParam;          // The list view item, as it was when queued
+    PITEMID_CHILD pidl;
+    INT iIcon;
+};
+
+// Gets the icons of the items of a file system folder on a thread of its own,
+// so that opening a folder does not wait for them to be extracted. The view
+// queues the items it needs an icon for and drains the finished ones when it
+// gets SHV_UPDATEICONS. The view and the thread each hold a reference.
+class CIconTask
+{
+    LONG m_cRefs;
+    CRITICAL_SECTION m_Lock;
+    HANDLE m_hEvent;
+    HWND m_hwndView;
+    PIDLIST_ABSOLUTE m_pidlFolder;
+    HDPA m_hQueue;
+    HDPA m_hDone;
+    BOOL m_bPosted;
+    BOOL m_bStop;
+
+    CIconTask() :
+        m_cRefs(1), m_hEvent(NULL), m_hwndView(NULL), m_pidlFolder(NULL),
+        m_hQueue(NULL), m_hDone(NULL), m_bPosted(FALSE), m_bStop(FALSE)
+    {
+        InitializeCriticalSection(&m_Lock);
+    }
+
+    ~CIconTask()
+    {
+        FreeItems(m_hQueue);
+        FreeItems(m_hDone);
+        ILFree(m_pidlFolder);
+        if (m_hEvent)
+            CloseHandle(m_hEvent);
+        DeleteCriticalSection(&m_Lock);
+    }
+
+    static DWORD WINAPI _ThreadProc(LPVOID lpParameter);
+
+public:
+    static CIconTask *Create(HWND hwndView, PCIDLIST_ABSOLUTE pidlFolder);
+    static void FreeItems(HDPA hItems);
+
+    void Release()
+    {
+        if (!InterlockedDecrement(&m_cRefs))
+            delete this;
+    }
+
+    BOOL Queue(LPARAM lParam, PCUITEMID_CHILD pidl);
+    HDPA TakeDone();
+    void Stop();
+};
+
+CIconTask *CIconTask::Create(HWND hwndView, PCIDLIST_ABSOLUTE pidlFolder)
+{
+    CIconTask *pTask = new CIconTask();
+    if (!pTask)
+        return NULL;
+
+    pTask->m_hwndView = hwndView;
+    pTask->m_pidlFolder = ILClone(pidlFolder);
+    pTask->m_hEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+    pTask->m_hQueue = DPA_Create(64);
+    if (!pTask->m_pidlFolder || !pTask->m_hEvent || !pTask->m_hQueue)
+    {
+        pTask->Release();
+        return NULL;
+    }
+
+    pTask->m_cRefs++;
+    if (!SHCreateThread(_ThreadProc, pTask, CTF_COINIT, NULL))
+    {
+        pTask->m_cRefs--;
+        pTask->Release();
+        return NULL;
+    }
+    return pTask;
+}
+
+void CIconTask::FreeItems(HDPA hItems)
+{
+    if (!hItems)
+        return;
+
+    for (INT i = 0; i < DPA_GetPtrCount(hItems); i++)
+    {
+        ICON_TASK_ITEM *pItem = (ICON_TASK_ITEM *)DPA_FastGetPtr(hItems, i);
+        ILFree(pItem->pidl);
+        SHFree(pItem);
+    }
+    DPA_Destroy(hItems);
+}
+
+BOOL CIconTask::Queue(LPARAM lParam, PCUITEMID_CHILD pidl)
+{
+    ICON_TASK_ITEM *pItem = (ICON_TASK_ITEM *)SHAlloc(sizeof(*pItem));
+    if (!pItem)
+        return FALSE;
+
+    pItem->lParam = lParam;
+    pItem->pidl = ILClone(pidl);
+    pItem->iIcon = -1;
+    if (!pItem->pidl)
+    {
+        SHFree(pItem);
+        return FALSE;
+    }
+
+    EnterCriticalSection(&m_Lock);
+    BOOL bQueued = (DPA_AppendPtr(m_hQueue, pItem) != -1);
+    LeaveCriticalSection(&m_Lock);
+
+    if (!bQueued)
+    {
+        ILFree(pItem->pidl);
+        SHFree(pItem);
+        return FALSE;
+    }
+
+    SetEvent(m_hEvent);
+    return TRUE;
+}
+
+// Hands the finished items to the view, which frees them with FreeItems
+HDPA CIconTask::TakeDone()
+{
+    EnterCriticalSection(&m_Lock);
+    HDPA hDone = m_hDone;
+    m_hDone = NULL;
+    m_bPosted = FALSE;
+    LeaveCriticalSection(&m_Lock);
+    return hDone;
+}
+
+void CIconTask::Stop()
+{
+    EnterCriticalSection(&m_Lock);
+    m_bStop = TRUE;
+    m_hwndView = NULL;
+    LeaveCriticalSection(&m_Lock);
+    SetEvent(m_hEvent);
+}
+
+DWORD WINAPI CIconTask::_ThreadProc(LPVOID lpParameter)
+{
+    CIconTask *pThis = static_cast<CIconTask *>(lpParameter);
+    CComPtr<IShellFolder> psf;
+
+    // Shell folders are used from the thread that bound them
+    if (SUCCEEDED(SHBindToObject(NULL, pThis->m_pidlFolder, IID_PPV_ARG(IShellFolder, &psf))))
+    {
+        for (;;)
+        {
+            ICON_TASK_ITEM *pItem = NULL;
+            HWND hwndPost = NULL;
+
+            EnterCriticalSection(&pThis->m_Lock);
+            if (!pThis->m_bStop && DPA_GetPtrCount(pThis->m_hQueue))
+                pItem = (ICON_TASK_ITEM *)DPA_DeletePtr(pThis->m_hQueue, 0);
+            BOOL bStop = pThis->m_bStop;
+            LeaveCriticalSection(&pThis->m_Lock);
+
+            if (bStop)
+                break;
+            if (!pItem)
+            {
+                WaitForSingleObject(pThis->m_hEvent, INFINITE);
+                continue;
+            }
+
+            pItem->iIcon = SHMapPIDLToSystemImageListIndex(psf, pItem->pidl, NULL);
+
+            EnterCriticalSection(&pThis->m_Lock);
+            if (!pThis->m_hDone)
+                pThis->m_hDone = DPA_Create(64);
+            if (!pThis->m_hDone || DPA_AppendPtr(pThis->m_hDone, pItem) == -1)
+            {
+                ILFree(pItem->pidl);
+                SHFree(pItem);
+            }
+            else if (!pThis->m_bPosted)
+            {
+                pThis->m_bPosted = TRUE;
+                hwndPost = pThis->m_hwndView;
+            }
+            LeaveCriticalSection(&pThis->m_Lock);
+
+            // The view may be gone by now, then the message is dropped
+            if (hwndPost)
+                ::PostMessageW(hwndPost, SHV_UPDATEICONS, 0, 0);
+        }
+    }
+
+    psf.Release();
+    pThis->Release();
+    return 0;
+}
+
 class CDefView :
     public CWindowImpl<CDefView, CWindow, CControlWinTraits>,
     public CComObjectRootEx<CComMultiThreadModelNoCS>,
@@ -244,6 +447,7 @@ private:
     SFVM_CUSTOMVIEWINFO_DATA  m_viewinfo_data;
 
     HICON                     m_hMyComputerIcon;
+    CIconTask                *m_pIconTask;          // Extracts the icons, if not NULL
 
     HRESULT _MergeToolbar();
     BOOL _Sort(int Col = -1);
@@ -428,6 +632,7 @@ public:
     LRESULT OnNotify(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
     LRESULT OnChangeNotify(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
     LRESULT OnUpdateStatusbar(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
+    LRESULT OnUpdateIcons(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
     LRESULT OnCustomItem(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
     LRESULT OnSettingChange(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
     LRESULT OnInitMenuPopup(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
@@ -476,6 +681,7 @@ public:
     MESSAGE_HANDLER(WM_COMMAND, OnCommand)
     MESSAGE_HANDLER(SHV_CHANGE_NOTIFY, OnChangeNotify)
     MESSAGE_HANDLER(SHV_UPDATESTATUSBAR, OnUpdateStatusbar)
+    MESSAGE_HANDLER(SHV_UPDATEICONS, OnUpdateIcons)
     MESSAGE_HANDLER(WM_CONTEXTMENU, OnContextMenu)
     MESSAGE_HANDLER(WM_DRAWITEM, OnCustomItem)
     MESSAGE_HANDLER(WM_MEASUREITEM, OnCustomItem)
@@ -537,7 +743,8 @@ CDefView::CDefView() :
     m_isEditing(FALSE),
     m_isParentFolderSpecial(FALSE),
     m_ScheduledStatusbarUpdate(false),
-    m_Destroyed(FALSE)
+    m_Destroyed(FALSE),
+    m_pIconTask(NULL)
 {
     ZeroMemory(&m_FolderSettings, sizeof(m_FolderSettings));
     ZeroMemory(&m_sortInfo, sizeof(m_sortInfo));
@@ -732,6 +939,36 @@ LRESULT CDefView::OnUpdateStatusbar(UINT uMsg, WPARAM wParam, LPARAM lParam, BOO
     return 0;
 }
 
+LRESULT CDefView::OnUpdateIcons(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
+{
+    if (!m_pIconTask || !m_ListView)
+        return 0;
+
+    HDPA hDone = m_pIconTask->TakeDone();
+    if (!hDone)
+        return 0;
+
+    for (INT i = 0; i < DPA_GetPtrCount(hDone); i++)
+    {
+        ICON_TASK_ITEM *pItem = (ICON_TASK_ITEM *)DPA_FastGetPtr(hDone, i);
+
+        // The item may have been removed or refreshed meanwhile
+        LVFINDINFOW lvfi = { LVFI_PARAM };
+        lvfi.lParam = pItem->lParam;
+        int iItem = m_ListView.FindItem(-1, &lvfi);
+        if (iItem == -1 || !ILIsEqual(pItem->pidl, _PidlByItem(iItem)))
+            continue;
+
+        LVITEMW lvItem = { LVIF_IMAGE };
+        lvItem.iItem = iItem;
+        lvItem.iImage = pItem->iIcon;
+        m_ListView.SetItem(&lvItem);
+    }
+
+    CIconTask::FreeItems(hDone);
+    return 0;
+}
+
 
 // ##### helperfunctions for initializing the view #####
 
@@ -1519,6 +1756,12 @@ LRESULT CDefView::OnDestroy(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHand
         RevokeDragDrop(m_hWnd);
         SHChangeNotifyDeregister(m_hNotify);
         m_hNotify = NULL;
+        if (m_pIconTask)
+        {
+            m_pIconTask->Stop();
+            m_pIconTask->Release();
+            m_pIconTask = NULL;
+        }
         SHFree(m_pidlParent);
         m_pidlParent = NULL;
     }
@@ -1631,6 +1874,11 @@ LRESULT CDefView::OnCreate(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandl
         ppf2->GetCurFolder(&m_pidlParent);
     }
 
+    // Other folders may extract their icons on the thread they live in only
+    WCHAR szPath[MAX_PATH];
+    if (m_pidlParent && SHGetPathFromIDListW(m_pidlParent, szPath))
+        m_pIconTask = CIconTask::Create(m_hWnd, m_pidlParent);
+
     if (CreateList())
     {
         if (InitList())
@@ -2568,7 +2816,19 @@ LRESULT CDefView::OnNotify(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandl
             }
             if(lpdi->item.mask & LVIF_IMAGE)    /* image requested */
             {
-                lpdi->item.iImage = SHMapPIDLToSystemImageListIndex(m_pSFParent, pidl, 0);
+                // Show the generic icon until the task has the real one
+                if (m_pIconTask && m_pIconTask->Queue(lpdi->item.lParam, pidl))
+                {
+                    if (_ILIsFolder(pidl))
+                        lpdi->item.iImage = SIC_GetIconIndex(swShell32Name, -IDI_SHELL_FOLDER, 0);
+                    else
+                        lpdi->item.iImage = 0;
+                    lpdi->item.mask |= LVIF_DI_SETITEM;
+                }
+                else
+                {
+                    lpdi->item.iImage = SHMapPIDLToSystemImageListIndex(m_pSFParent, pidl, 0);
+                }
             }
             if(lpdi->item.mask & LVIF_STATE)
             {
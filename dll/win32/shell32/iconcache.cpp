@@ -314,11 +314,707 @@ fail:
     return NULL;
 }
 
+/********************** THE ICON CACHE FILE ***************************/
+
+/*
+ * The icons that had to be extracted from their files are kept in
+ * %LOCALAPPDATA%\IconCache.db, which every process maps read-only. An
+ * icon is looked up there by the full path of its file, its index and
+ * whether it has the shortcut overlay, and used if the file was not
+ * written to since. New icons are collected and written out in batches
+ * together with the ones already there, to a new file that then takes the
+ * place of the old one.
+ */
+
+#define SIC_FILE_MAGIC       0x31434953  /* "SIC1" */
+#define SIC_FILE_VERSION     1
+#define SIC_FILE_MAX_ENTRIES 4096
+#define SIC_FILE_SAVE_BATCH  256
+
+/* The sizes SIC_LoadIcon extracts at */
+#define SIC_SMALL_SIZE       16
+#define SIC_LARGE_SIZE       32
+
+typedef struct
+{
+    DWORD dwMagic;
+    DWORD dwVersion;
+    DWORD cxSmall;
+    DWORD cxLarge;
+    DWORD dwEntries;
+    DWORD cbFile;
+} SIC_FILE_HEADER;
+
+/* Follows the header, sorted by hash, index and flags. The offsets are
+ * from the start of the file. */
+typedef struct
+{
+    DWORD dwHash;           /* of the upper cased full path */
+    INT iSourceIndex;
+    DWORD dwFlags;          /* GIL_FORSHORTCUT */
+    FILETIME ftLastWrite;   /* of the icon file when it was extracted */
+    DWORD dwPath;
+    DWORD dwSmall;
+    DWORD dwLarge;
+} SIC_FILE_ENTRY;
+
+/* An extracted icon waiting to be written to the file */
+typedef struct
+{
+    SIC_FILE_ENTRY Entry;
+    LPWSTR sPath;
+    PBYTE pSmall;
+    PBYTE pLarge;
+} SIC_FILE_PENDING;
+
+/* The mapped file and the pending icons are guarded by SHELL32_SicFileCS,
+ * sic_file_saving lets only one thread write the file at a time */
+static WCHAR sic_file_name[MAX_PATH];
+static const BYTE *sic_file_view;
+static DWORD sic_file_size;
+static HDPA sic_file_pending;
+static LONG sic_file_saving;
+
+namespace
+{
+extern CRITICAL_SECTION SHELL32_SicFileCS;
+CRITICAL_SECTION_DEBUG file_critsect_debug =
+{
+    0, 0, &SHELL32_SicFileCS,
+    { &file_critsect_debug.ProcessLocksList, &file_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": SHELL32_SicFileCS") }
+};
+CRITICAL_SECTION SHELL32_SicFileCS = { &file_critsect_debug, -1, 0, 0, 0, 0 };
+}
+
+/* An icon is stored as a bottom-up 32bpp DIB followed by its 1bpp mask */
+static DWORD SIC_IconDataSize(INT cx)
+{
+    return cx * cx * 4 + ((cx + 31) / 32) * 4 * cx;
+}
+
+static VOID SIC_InitBitmapInfo(BITMAPINFO *pbmi, INT cx, WORD wBitCount)
+{
+    ZeroMemory(pbmi, sizeof(BITMAPINFOHEADER) + 2 * sizeof(RGBQUAD));
+    pbmi->bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    pbmi->bmiHeader.biWidth = cx;
+    pbmi->bmiHeader.biHeight = cx;
+    pbmi->bmiHeader.biPlanes = 1;
+    pbmi->bmiHeader.biBitCount = wBitCount;
+    pbmi->bmiHeader.biCompression = BI_RGB;
+    if (wBitCount == 1)
+    {
+        pbmi->bmiColors[1].rgbRed = 0xFF;
+        pbmi->bmiColors[1].rgbGreen = 0xFF;
+        pbmi->bmiColors[1].rgbBlue = 0xFF;
+    }
+}
+
+static DWORD SIC_HashPath(LPCWSTR sPath)
+{
+    DWORD dwHash = 2166136261U;
+
+    for (; *sPath; sPath++)
+    {
+        dwHash ^= towupper(*sPath);
+        dwHash *= 16777619U;
+    }
+    return dwHash;
+}
+
+static INT SIC_CompareFileEntries(const SIC_FILE_ENTRY *e1, const SIC_FILE_ENTRY *e2)
+{
+    if (e1->dwHash != e2->dwHash)
+        return (e1->dwHash < e2->dwHash) ? -1 : 1;
+    if (e1->iSourceIndex != e2->iSourceIndex)
+        return (e1->iSourceIndex < e2->iSourceIndex) ? -1 : 1;
+    if (e1->dwFlags != e2->dwFlags)
+        return (e1->dwFlags < e2->dwFlags) ? -1 : 1;
+    return 0;
+}
+
+static BOOL SIC_GetLastWrite(LPCWSTR sPath, FILETIME *pft)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+
+    if (!GetFileAttributesExW(sPath, GetFileExInfoStandard, &data))
+        return FALSE;
+    *pft = data.ftLastWriteTime;
+    return TRUE;
+}
+
+/*****************************************************************************
+ * SIC_MapCacheFile            [internal]
+ *
+ * NOTES
+ *  maps the icon cache file, unless it was written for other icon sizes
+ *  or by another version
+ */
+static const BYTE *SIC_MapCacheFile(DWORD *pcbView)
+{
+    const SIC_FILE_HEADER *pHeader;
+    LARGE_INTEGER size;
+    HANDLE hFile, hMapping;
+    const BYTE *pView;
+
+    /* The file may be replaced while it is mapped */
+    hFile = CreateFileW(sic_file_name, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    if (!GetFileSizeEx(hFile, &size) || size.QuadPart < (LONGLONG)sizeof(SIC_FILE_HEADER) ||
+        size.QuadPart > MAXLONG)
+    {
+        CloseHandle(hFile);
+        return NULL;
+    }
+
+    hMapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hFile);
+    if (!hMapping)
+        return NULL;
+
+    pView = (const BYTE *)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(hMapping);
+    if (!pView)
+        return NULL;
+
+    pHeader = (const SIC_FILE_HEADER *)pView;
+    if (pHeader->dwMagic != SIC_FILE_MAGIC ||
+        pHeader->dwVersion != SIC_FILE_VERSION ||
+        pHeader->cxSmall != SIC_SMALL_SIZE ||
+        pHeader->cxLarge != SIC_LARGE_SIZE ||
+        pHeader->cbFile != size.LowPart ||
+        pHeader->dwEntries > SIC_FILE_MAX_ENTRIES ||
+        sizeof(*pHeader) + pHeader->dwEntries * sizeof(SIC_FILE_ENTRY) > size.LowPart)
+    {
+        WARN("Ignoring the icon cache file %s\n", debugstr_w(sic_file_name));
+        UnmapViewOfFile(pView);
+        return NULL;
+    }
+
+    TRACE("%lu icons in %s\n", pHeader->dwEntries, debugstr_w(sic_file_name));
+    *pcbView = size.LowPart;
+    return pView;
+}
+
+static const SIC_FILE_ENTRY *SIC_FileEntries(const BYTE *pView, DWORD *pdwCount)
+{
+    const SIC_FILE_HEADER *pHeader = (const SIC_FILE_HEADER *)pView;
+
+    if (!pHeader)
+    {
+        *pdwCount = 0;
+        return NULL;
+    }
+    *pdwCount = pHeader->dwEntries;
+    return (const SIC_FILE_ENTRY *)(pHeader + 1);
+}
+
+/* Checks the offsets of an entry, the file may have been damaged */
+static BOOL SIC_IsEntryValid(const BYTE *pView, DWORD cbView, const SIC_FILE_ENTRY *pEntry)
+{
+    const WCHAR *pPath, *pEnd;
+
+    if (pEntry->dwSmall > cbView - SIC_IconDataSize(SIC_SMALL_SIZE) ||
+        pEntry->dwLarge > cbView - SIC_IconDataSize(SIC_LARGE_SIZE) ||
+        pEntry->dwPath >= cbView || (pEntry->dwPath & 1))
+    {
+        return FALSE;
+    }
+
+    pPath = (const WCHAR *)(pView + pEntry->dwPath);
+    pEnd = (const WCHAR *)(pView + (cbView & ~1));
+    while (pPath < pEnd && *pPath)
+        pPath++;
+    return pPath < pEnd;
+}
+
+static HICON SIC_CreateIconFromData(const BYTE *pData, INT cx)
+{
+    BYTE buffer[sizeof(BITMAPINFOHEADER) + 2 * sizeof(RGBQUAD)];
+    BITMAPINFO *pbmi = (BITMAPINFO *)buffer;
+    ICONINFO info = { TRUE, 0, 0, NULL, NULL };
+    HICON hIcon = NULL;
+    PVOID pBits;
+    HDC hdc;
+
+    hdc = CreateCompatibleDC(NULL);
+    if (!hdc)
+        return NULL;
+
+    SIC_InitBitmapInfo(pbmi, cx, 32);
+    info.hbmColor = CreateDIBSection(hdc, pbmi, DIB_RGB_COLORS, &pBits, NULL, 0);
+    info.hbmMask = CreateBitmap(cx, cx, 1, 1, NULL);
+    if (info.hbmColor && info.hbmMask)
+    {
+        memcpy(pBits, pData, cx * cx * 4);
+        SIC_InitBitmapInfo(pbmi, cx, 1);
+        if (SetDIBits(hdc, info.hbmMask, 0, cx, pData + cx * cx * 4, pbmi, DIB_RGB_COLORS))
+            hIcon = CreateIconIndirect(&info);
+    }
+
+    if (info.hbmColor) DeleteObject(info.hbmColor);
+    if (info.hbmMask) DeleteObject(info.hbmMask);
+    DeleteDC(hdc);
+    return hIcon;
+}
+
+static PBYTE SIC_GetIconData(HICON hIcon, INT cx)
+{
+    BYTE buffer[sizeof(BITMAPINFOHEADER) + 2 * sizeof(RGBQUAD)];
+    BITMAPINFO *pbmi = (BITMAPINFO *)buffer;
+    ICONINFO info;
+    BITMAP bm;
+    PBYTE pData = NULL;
+    BOOL bSuccess = FALSE;
+    HDC hdc = NULL;
+
+    if (!GetIconInfo(hIcon, &info))
+        return NULL;
+
+    /* Only color icons of the expected size are kept */
+    if (info.hbmColor && GetObjectW(info.hbmColor, sizeof(bm), &bm) &&
+        bm.bmWidth == cx && bm.bmHeight == cx)
+    {
+        pData = (PBYTE)HeapAlloc(GetProcessHeap(), 0, SIC_IconDataSize(cx));
+        hdc = CreateCompatibleDC(NULL);
+    }
+
+    if (pData && hdc)
+    {
+        SIC_InitBitmapInfo(pbmi, cx, 32);
+        if (GetDIBits(hdc, info.hbmColor, 0, cx, pData, pbmi, DIB_RGB_COLORS) == cx)
+        {
+            SIC_InitBitmapInfo(pbmi, cx, 1);
+            bSuccess = (GetDIBits(hdc, info.hbmMask, 0, cx, pData + cx * cx * 4,
+                                  pbmi, DIB_RGB_COLORS) == cx);
+        }
+    }
+
+    if (!bSuccess)
+    {
+        HeapFree(GetProcessHeap(), 0, pData);
+        pData = NULL;
+    }
+
+    if (hdc) DeleteDC(hdc);
+    if (info.hbmColor) DeleteObject(info.hbmColor);
+    if (info.hbmMask) DeleteObject(info.hbmMask);
+    return pData;
+}
+
+/*****************************************************************************
+ * SIC_LoadCachedIcon            [internal]
+ *
+ * NOTES
+ *  gets the small and big icons from the icon cache file, if the file
+ *  holding them did not change since they were stored
+ */
+static BOOL SIC_LoadCachedIcon(LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags,
+                               HICON *phSmall, HICON *phLarge)
+{
+    const SIC_FILE_ENTRY *pEntries, *pEntry = NULL;
+    SIC_FILE_ENTRY key;
+    WCHAR path[MAX_PATH];
+    FILETIME ftLastWrite;
+    DWORD dwCount, dwLow, dwHigh, dwMid;
+    BOOL ret = FALSE;
+
+    /* Read without the lock, a miss only costs an extraction */
+    if (!sic_file_view)
+        return FALSE;
+
+    GetFullPathNameW(sSourceFile, MAX_PATH, path, NULL);
+    key.dwHash = SIC_HashPath(path);
+    key.iSourceIndex = dwSourceIndex;
+    key.dwFlags = dwFlags & GIL_FORSHORTCUT;
+
+    /* Ask the file system before taking the lock */
+    if (!SIC_GetLastWrite(path, &ftLastWrite))
+        return FALSE;
+
+    EnterCriticalSection(&SHELL32_SicFileCS);
+
+    pEntries = SIC_FileEntries(sic_file_view, &dwCount);
+
+    /* Find the first entry with this key */
+    dwLow = 0;
+    dwHigh = dwCount;
+    while (dwLow < dwHigh)
+    {
+        dwMid = (dwLow + dwHigh) / 2;
+        if (SIC_CompareFileEntries(&pEntries[dwMid], &key) < 0)
+            dwLow = dwMid + 1;
+        else
+            dwHigh = dwMid;
+    }
+
+    /* Files written before the duplicates were dropped may still hold a
+     * stale copy next to the fresh one */
+    for (; dwLow < dwCount && !SIC_CompareFileEntries(&pEntries[dwLow], &key); dwLow++)
+    {
+        if (!CompareFileTime(&ftLastWrite, &pEntries[dwLow].ftLastWrite) &&
+            SIC_IsEntryValid(sic_file_view, sic_file_size, &pEntries[dwLow]) &&
+            !wcsicmp((LPCWSTR)(sic_file_view + pEntries[dwLow].dwPath), path))
+        {
+            pEntry = &pEntries[dwLow];
+            break;
+        }
+    }
+
+    if (pEntry)
+    {
+        *phSmall = SIC_CreateIconFromData(sic_file_view + pEntry->dwSmall, SIC_SMALL_SIZE);
+        *phLarge = SIC_CreateIconFromData(sic_file_view + pEntry->dwLarge, SIC_LARGE_SIZE);
+        ret = (*phSmall && *phLarge);
+        if (!ret)
+        {
+            if (*phSmall) DestroyIcon(*phSmall);
+            if (*phLarge) DestroyIcon(*phLarge);
+        }
+    }
+
+    LeaveCriticalSection(&SHELL32_SicFileCS);
+    return ret;
+}
+
+static VOID SIC_FreePending(SIC_FILE_PENDING *pPending)
+{
+    HeapFree(GetProcessHeap(), 0, pPending->sPath);
+    HeapFree(GetProcessHeap(), 0, pPending->pSmall);
+    HeapFree(GetProcessHeap(), 0, pPending->pLarge);
+    HeapFree(GetProcessHeap(), 0, pPending);
+}
+
+static INT CALLBACK SIC_FreePendingCallback(LPVOID ptr, LPVOID lparam)
+{
+    SIC_FreePending((SIC_FILE_PENDING *)ptr);
+    return TRUE;
+}
+
+/* An entry on its way to a new file, with its data in the view or pending */
+typedef struct
+{
+    const SIC_FILE_ENTRY *pEntry;
+    LPCWSTR sPath;
+    const BYTE *pSmall;
+    const BYTE *pLarge;
+    DWORD dwOrder;          /* which one of the same icon is kept */
+} SIC_FILE_SOURCE;
+
+static int __cdecl SIC_SortFileSources(const void *p1, const void *p2)
+{
+    const SIC_FILE_SOURCE *s1 = (const SIC_FILE_SOURCE *)p1, *s2 = (const SIC_FILE_SOURCE *)p2;
+    INT ret;
+
+    ret = SIC_CompareFileEntries(s1->pEntry, s2->pEntry);
+    if (!ret)
+        ret = wcsicmp(s1->sPath, s2->sPath);
+    if (!ret)
+        ret = (s1->dwOrder < s2->dwOrder) ? -1 : (s1->dwOrder > s2->dwOrder);
+    return ret;
+}
+
+static BOOL SIC_WriteData(HANDLE hFile, const void *pData, DWORD cbData)
+{
+    DWORD cbWritten;
+    return WriteFile(hFile, pData, cbData, &cbWritten, NULL) && cbWritten == cbData;
+}
+
+/*****************************************************************************
+ * SIC_WriteCacheFile            [internal]
+ *
+ * NOTES
+ *  writes the pending icons and the ones of the mapped file to a new icon
+ *  cache file, and puts it in place of the old one. The pending icons come
+ *  first, what does not fit is dropped. Of the same icon of the same file,
+ *  only the one stored last is kept.
+ */
+static BOOL SIC_WriteCacheFile(HDPA hPending, const BYTE *pView, DWORD cbView)
+{
+    const SIC_FILE_ENTRY *pMapped;
+    SIC_FILE_SOURCE *pSources;
+    SIC_FILE_ENTRY *pTable = NULL;
+    SIC_FILE_PENDING *pPending;
+    SIC_FILE_HEADER header;
+    WCHAR sDir[MAX_PATH], sTemp[MAX_PATH];
+    DWORD dwMapped, dwSources = 0, dwCount = 0, dwOffset, i;
+    INT iPending = DPA_GetPtrCount(hPending);
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    BOOL bSuccess = FALSE;
+
+    pMapped = SIC_FileEntries(pView, &dwMapped);
+    pSources = (SIC_FILE_SOURCE *)HeapAlloc(GetProcessHeap(), 0,
+                                            (iPending + dwMapped) * sizeof(*pSources));
+    if (!pSources)
+        return FALSE;
+
+    /* The newest pending icon wins, then the older ones, then the file */
+    for (i = 0; i < (DWORD)iPending && dwSources < SIC_FILE_MAX_ENTRIES; i++)
+    {
+        pPending = (SIC_FILE_PENDING *)DPA_FastGetPtr(hPending, i);
+        pSources[dwSources].pEntry = &pPending->Entry;
+        pSources[dwSources].sPath = pPending->sPath;
+        pSources[dwSources].pSmall = pPending->pSmall;
+        pSources[dwSources].pLarge = pPending->pLarge;
+        pSources[dwSources].dwOrder = iPending - 1 - i;
+        dwSources++;
+    }
+    for (i = 0; i < dwMapped && dwSources < SIC_FILE_MAX_ENTRIES; i++)
+    {
+        if (!SIC_IsEntryValid(pView, cbView, &pMapped[i]))
+            continue;
+        pSources[dwSources].pEntry = &pMapped[i];
+        pSources[dwSources].sPath = (LPCWSTR)(pView + pMapped[i].dwPath);
+        pSources[dwSources].pSmall = pView + pMapped[i].dwSmall;
+        pSources[dwSources].pLarge = pView + pMapped[i].dwLarge;
+        pSources[dwSources].dwOrder = iPending + i;
+        dwSources++;
+    }
+
+    qsort(pSources, dwSources, sizeof(*pSources), SIC_SortFileSources);
+
+    /* Keep the first of each run of the same icon */
+    for (i = 0; i < dwSources; i++)
+    {
+        if (dwCount &&
+            !SIC_CompareFileEntries(pSources[dwCount - 1].pEntry, pSources[i].pEntry) &&
+            !wcsicmp(pSources[dwCount - 1].sPath, pSources[i].sPath))
+        {
+            continue;
+        }
+        pSources[dwCount++] = pSources[i];
+    }
+
+    pTable = (SIC_FILE_ENTRY *)HeapAlloc(GetProcessHeap(), 0, dwCount * sizeof(*pTable));
+    StringCchCopyW(sDir, _countof(sDir), sic_file_name);
+    PathRemoveFileSpecW(sDir);
+    if (!pTable || !GetTempFileNameW(sDir, L"sic", 0, sTemp))
+        goto leave;
+
+    hFile = CreateFileW(sTemp, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        DeleteFileW(sTemp);
+        goto leave;
+    }
+
+    /* The paths and icons follow the table, in its order */
+    dwOffset = sizeof(header) + dwCount * sizeof(*pTable);
+    for (i = 0; i < dwCount; i++)
+    {
+        pTable[i] = *pSources[i].pEntry;
+        pTable[i].dwPath = dwOffset;
+        pTable[i].dwSmall = dwOffset + (DWORD)(wcslen(pSources[i].sPath) + 1) * sizeof(WCHAR);
+        pTable[i].dwLarge = pTable[i].dwSmall + SIC_IconDataSize(SIC_SMALL_SIZE);
+        dwOffset = pTable[i].dwLarge + SIC_IconDataSize(SIC_LARGE_SIZE);
+    }
+
+    header.dwMagic = SIC_FILE_MAGIC;
+    header.dwVersion = SIC_FILE_VERSION;
+    header.cxSmall = SIC_SMALL_SIZE;
+    header.cxLarge = SIC_LARGE_SIZE;
+    header.dwEntries = dwCount;
+    header.cbFile = dwOffset;
+
+    bSuccess = SIC_WriteData(hFile, &header, sizeof(header)) &&
+               SIC_WriteData(hFile, pTable, dwCount * sizeof(*pTable));
+
+    for (i = 0; bSuccess && i < dwCount; i++)
+    {
+        bSuccess = SIC_WriteData(hFile, pSources[i].sPath, pTable[i].dwSmall - pTable[i].dwPath) &&
+                   SIC_WriteData(hFile, pSources[i].pSmall, SIC_IconDataSize(SIC_SMALL_SIZE)) &&
+                   SIC_WriteData(hFile, pSources[i].pLarge, SIC_IconDataSize(SIC_LARGE_SIZE));
+    }
+
+    CloseHandle(hFile);
+
+    /* Those who mapped the old file keep it until they map the new one */
+    if (bSuccess)
+        bSuccess = MoveFileExW(sTemp, sic_file_name, MOVEFILE_REPLACE_EXISTING);
+    if (!bSuccess)
+        DeleteFileW(sTemp);
+
+    TRACE("wrote %lu icons to %s: %d\n", dwCount, debugstr_w(sic_file_name), bSuccess);
+
+leave:
+    HeapFree(GetProcessHeap(), 0, pTable);
+    HeapFree(GetProcessHeap(), 0, pSources);
+    return bSuccess;
+}
+
+/*****************************************************************************
+ * SIC_SaveCacheFile            [internal]
+ *
+ * NOTES
+ *  writes out the pending icons and maps the new file. The caller owns
+ *  sic_file_saving, so the old view stays valid while it is copied.
+ */
+static VOID SIC_SaveCacheFile(void)
+{
+    const BYTE *pView, *pNewView;
+    DWORD cbView, cbNewView = 0;
+    HDPA hPending;
+
+    EnterCriticalSection(&SHELL32_SicFileCS);
+    hPending = sic_file_pending;
+    sic_file_pending = NULL;
+    pView = sic_file_view;
+    cbView = sic_file_size;
+    LeaveCriticalSection(&SHELL32_SicFileCS);
+
+    if (!hPending)
+        return;
+
+    /* The lookups go on meanwhile */
+    pNewView = NULL;
+    if (SIC_WriteCacheFile(hPending, pView, cbView))
+        pNewView = SIC_MapCacheFile(&cbNewView);
+
+    if (pNewView)
+    {
+        EnterCriticalSection(&SHELL32_SicFileCS);
+        sic_file_view = pNewView;
+        sic_file_size = cbNewView;
+        LeaveCriticalSection(&SHELL32_SicFileCS);
+        if (pView)
+            UnmapViewOfFile(pView);
+    }
+
+    DPA_DestroyCallback(hPending, SIC_FreePendingCallback, NULL);
+}
+
+/* Holds a reference on shell32, so that it is not unloaded under the save */
+static DWORD WINAPI SIC_SaveCacheFileProc(LPVOID lpParameter)
+{
+    SIC_SaveCacheFile();
+    InterlockedExchange(&sic_file_saving, FALSE);
+    FreeLibraryAndExitThread((HMODULE)lpParameter, 0);
+    return 0;
+}
+
+static VOID SIC_QueueSaveCacheFile(void)
+{
+    HMODULE hModule;
+    HANDLE hThread;
+
+    if (InterlockedExchange(&sic_file_saving, TRUE))
+        return;
+
+    if (GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+                           (LPCWSTR)SIC_SaveCacheFileProc, &hModule))
+    {
+        hThread = CreateThread(NULL, 0, SIC_SaveCacheFileProc, hModule, 0, NULL);
+        if (hThread)
+        {
+            CloseHandle(hThread);
+            return;
+        }
+        FreeLibrary(hModule);
+    }
+
+    InterlockedExchange(&sic_file_saving, FALSE);
+}
+
+/*****************************************************************************
+ * SIC_StoreCachedIcon            [internal]
+ *
+ * NOTES
+ *  queues an extracted icon for the icon cache file, which is written in
+ *  the background once enough of them came together
+ */
+static VOID SIC_StoreCachedIcon(LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags,
+                                HICON hSmall, HICON hLarge)
+{
+    SIC_FILE_PENDING *pPending;
+    WCHAR path[MAX_PATH];
+    BOOL bSave = FALSE;
+
+    if (!sic_file_name[0])
+        return;
+
+    pPending = (SIC_FILE_PENDING *)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*pPending));
+    if (!pPending)
+        return;
+
+    GetFullPathNameW(sSourceFile, MAX_PATH, path, NULL);
+    pPending->Entry.dwHash = SIC_HashPath(path);
+    pPending->Entry.iSourceIndex = dwSourceIndex;
+    pPending->Entry.dwFlags = dwFlags & GIL_FORSHORTCUT;
+    pPending->sPath = (LPWSTR)HeapAlloc(GetProcessHeap(), 0, (wcslen(path) + 1) * sizeof(WCHAR));
+    pPending->pSmall = SIC_GetIconData(hSmall, SIC_SMALL_SIZE);
+    pPending->pLarge = SIC_GetIconData(hLarge, SIC_LARGE_SIZE);
+
+    if (!pPending->sPath || !pPending->pSmall || !pPending->pLarge ||
+        !SIC_GetLastWrite(path, &pPending->Entry.ftLastWrite))
+    {
+        SIC_FreePending(pPending);
+        return;
+    }
+    wcscpy(pPending->sPath, path);
+
+    EnterCriticalSection(&SHELL32_SicFileCS);
+    if (!sic_file_pending)
+        sic_file_pending = DPA_Create(SIC_FILE_SAVE_BATCH);
+    if (!sic_file_pending || DPA_AppendPtr(sic_file_pending, pPending) == -1)
+        SIC_FreePending(pPending);
+    else
+        bSave = (DPA_GetPtrCount(sic_file_pending) >= SIC_FILE_SAVE_BATCH);
+    LeaveCriticalSection(&SHELL32_SicFileCS);
+
+    if (bSave)
+        SIC_QueueSaveCacheFile();
+}
+
+/*****************************************************************************
+ * SIC_OpenCacheFile            [internal]
+ */
+static VOID SIC_OpenCacheFile(void)
+{
+    if (FAILED(SHGetFolderPathW(NULL, CSIDL_LOCAL_APPDATA | CSIDL_FLAG_CREATE, NULL,
+                                SHGFP_TYPE_CURRENT, sic_file_name)) ||
+        !PathAppendW(sic_file_name, L"IconCache.db"))
+    {
+        sic_file_name[0] = UNICODE_NULL;
+        return;
+    }
+
+    sic_file_view = SIC_MapCacheFile(&sic_file_size);
+}
+
+/*****************************************************************************
+ * SIC_CloseCacheFile            [internal]
+ *
+ * NOTES
+ *  drops what is pending. This is called from DllMain, where no file may
+ *  be written under the loader lock. A save holds a reference on shell32,
+ *  so one can only be running here when the process exits.
+ */
+static VOID SIC_CloseCacheFile(void)
+{
+    if (!InterlockedExchange(&sic_file_saving, TRUE))
+    {
+        EnterCriticalSection(&SHELL32_SicFileCS);
+        if (sic_file_pending)
+            DPA_DestroyCallback(sic_file_pending, SIC_FreePendingCallback, NULL);
+        sic_file_pending = NULL;
+        if (sic_file_view)
+            UnmapViewOfFile(sic_file_view);
+        sic_file_view = NULL;
+        sic_file_size = 0;
+        LeaveCriticalSection(&SHELL32_SicFileCS);
+    }
+}
+
 /*****************************************************************************
  * SIC_IconAppend            [internal]
  *
  * NOTES
- *  appends an icon pair to the end of the cache
+ *  appends an icon pair to the end of the cache. If another thread added
+ *  the icon meanwhile, its index is returned instead.
  */
 static INT SIC_IconAppend (LPCWSTR sSourceFile, INT dwSourceIndex, HICON hSmallIcon, HICON hBigIcon, DWORD dwFlags)
 {
@@ -338,6 +1034,16 @@ static INT SIC_IconAppend (LPCWSTR sSourceFile, INT dwSourceIndex, HICON hSmallI
 
     EnterCriticalSection(&SHELL32_SicCS);
 
+    indexDPA = DPA_Search (sic_hdpa, lpsice, 0, SIC_CompareEntries, 0, DPAS_SORTED);
+    if (indexDPA != -1)
+    {
+        ret = ((LPSIC_ENTRY)DPA_GetPtr(sic_hdpa, indexDPA))->dwListIndex;
+        LeaveCriticalSection(&SHELL32_SicCS);
+        HeapFree(GetProcessHeap(), 0, lpsice->sSourceFile);
+        SHFree(lpsice);
+        return ret;
+    }
+
     indexDPA = DPA_Search (sic_hdpa, lpsice, 0, SIC_CompareEntries, 0, DPAS_SORTED|DPAS_INSERTAFTER);
     indexDPA = DPA_InsertPtr(sic_hdpa, indexDPA, lpsice);
     if ( -1 == indexDPA )
@@ -382,7 +1088,8 @@ leave:
  * SIC_LoadIcon                [internal]
  *
  * NOTES
- *  gets small/big icon by number from a file
+ *  gets small/big icon by number from the icon cache file or else from
+ *  the file itself
  */
 static INT SIC_LoadIcon (LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags)
 {
@@ -390,6 +1097,15 @@ static INT SIC_LoadIcon (LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags)
     HICON hiconSmall=0;
     UINT ret;
 
+    if (SIC_LoadCachedIcon(sSourceFile, dwSourceIndex, dwFlags, &hiconSmall, &hiconLarge))
+    {
+        TRACE("-- found in %s\n", debugstr_w(sic_file_name));
+        ret = SIC_IconAppend (sSourceFile, dwSourceIndex, hiconSmall, hiconLarge, dwFlags);
+        DestroyIcon(hiconLarge);
+        DestroyIcon(hiconSmall);
+        return ret;
+    }
+
     PrivateExtractIconsW(sSourceFile, dwSourceIndex, 32, 32, &hiconLarge, NULL, 1, LR_COPYFROMRESOURCE);
     PrivateExtractIconsW(sSourceFile, dwSourceIndex, 16, 16, &hiconSmall, NULL, 1, LR_COPYFROMRESOURCE);
 
@@ -422,6 +1138,8 @@ static INT SIC_LoadIcon (LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags)
     }
 
     ret = SIC_IconAppend (sSourceFile, dwSourceIndex, hiconSmall, hiconLarge, dwFlags);
+    if (ret != INVALID_INDEX)
+        SIC_StoreCachedIcon(sSourceFile, dwSourceIndex, dwFlags, hiconSmall, hiconLarge);
     DestroyIcon(hiconLarge);
     DestroyIcon(hiconSmall);
     return ret;
@@ -463,14 +1181,15 @@ INT SIC_GetIconIndex (LPCWSTR sSourceFile, INT dwSourceIndex, DWORD dwFlags )
 
     if ( INVALID_INDEX == index )
     {
-          ret = SIC_LoadIcon (sSourceFile, dwSourceIndex, dwFlags);
-    }
-    else
-    {
-      TRACE("-- found\n");
-      ret = ((LPSIC_ENTRY)DPA_GetPtr(sic_hdpa, index))->dwListIndex;
+      LeaveCriticalSection(&SHELL32_SicCS);
+
+      /* Extracting may take long, other threads should not wait on it */
+      return SIC_LoadIcon (sSourceFile, dwSourceIndex, dwFlags);
     }
 
+    TRACE("-- found\n");
+    ret = ((LPSIC_ENTRY)DPA_GetPtr(sic_hdpa, index))->dwListIndex;
+
     LeaveCriticalSection(&SHELL32_SicCS);
     return ret;
 }
@@ -590,6 +1309,8 @@ BOOL SIC_Initialize(void)
         goto end;
     }
 
+    SIC_OpenCacheFile();
+
     /* Everything went fine */
     result = TRUE;
 
@@ -630,6 +1351,8 @@ void SIC_Destroy(void)
 {
     TRACE("\n");
 
+    SIC_CloseCacheFile();
+
     EnterCriticalSection(&SHELL32_SicCS);
 
     if (sic_hdpa) DPA_DestroyCallback(sic_hdpa, sic_free, NULL );
@@ -53,6 +53,10 @@ DriverEntry(
     DriverObject->MajorFunction[IRP_MJ_DEVICE_CONTROL] = KsecDdDispatch;
 
     /* Initialize */
+#ifdef _M_AMD64
+    /* Only x64 may use the SSE registers without saving the FPU state */
+    CryptInitCpuFeatures();
+#endif
     KsecInitializeEncryptionSupport();
 
     return STATUS_SUCCESS;
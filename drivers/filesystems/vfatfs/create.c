@@ -160,6 +160,15 @@ FindFile(
         }
     }
 
+    /* Large directories are looked up through their name index */
+    if (WildCard == FALSE && First && DirContext->DirIndex == 0 &&
+        vfatNameIndexAvailable(DeviceExt, Parent))
+    {
+        Status = vfatNameIndexLookup(DeviceExt, Parent, FileToFindU, DirContext);
+        ExFreePoolWithTag(PathNameBuffer, TAG_NAME);
+        return Status;
+    }
+
     /* FsRtlIsNameInExpression need the searched string to be upcase,
     * even if IgnoreCase is specified */
     Status = RtlUpcaseUnicodeString(&FileToFindUpcase, FileToFindU, TRUE);
@@ -262,7 +262,7 @@ vfatFindDirSpace(
     OUT PULONG start)
 {
     LARGE_INTEGER FileOffset;
-    ULONG i, count, size, nbFree = 0;
+    ULONG i, count, size, nbFree = 0, FirstFree = MAXULONG;
     PDIR_ENTRY pFatEntry = NULL;
     PVOID Context = NULL;
     NTSTATUS Status;
@@ -283,7 +283,14 @@ vfatFindDirSpace(
 
     count = pDirFcb->RFCB.FileSize.u.LowPart / SizeDirEntry;
     size = DeviceExt->FatInfo.BytesPerCluster / SizeDirEntry;
-    for (i = 0; i < count; i++, pFatEntry = (PDIR_ENTRY)((ULONG_PTR)pFatEntry + SizeDirEntry))
+    i = 0;
+    if (pDirFcb->NameIndex != NULL)
+    {
+        /* Nothing below the hint is free, start from its cluster */
+        i = ROUND_DOWN(min(pDirFcb->NameIndex->FreeHint, count), size);
+        FileOffset.u.LowPart = i * SizeDirEntry;
+    }
+    for (; i < count; i++, pFatEntry = (PDIR_ENTRY)((ULONG_PTR)pFatEntry + SizeDirEntry))
     {
         if (Context == NULL || (i % size) == 0)
         {
@@ -309,6 +316,10 @@ vfatFindDirSpace(
         }
         if (ENTRY_DELETED(IsFatX, pFatEntry))
         {
+            if (FirstFree == MAXULONG)
+            {
+                FirstFree = i;
+            }
             nbFree++;
         }
         else
@@ -392,6 +403,12 @@ vfatFindDirSpace(
             CcUnpinData(Context);
         }
     }
+    if (pDirFcb->NameIndex != NULL)
+    {
+        /* Nothing below here is free. The slots we're about to use are
+           only skipped once the entry is written, see vfatNameIndexAddEntry */
+        pDirFcb->NameIndex->FreeHint = (FirstFree < *start) ? FirstFree : *start;
+    }
     DPRINT("nbSlots %u nbFree %u, entry number %u\n", nbSlots, nbFree, *start);
     return TRUE;
 }
@@ -761,6 +778,8 @@ FATAddEntry(
     CcSetDirtyPinnedData(Context, NULL);
     CcUnpinData(Context);
 
+    vfatNameIndexAddEntry(DeviceExt, ParentFcb, DirContext.StartIndex);
+
     if (MoveContext != NULL)
     {
         /* We're modifying an existing FCB - likely rename/move */
@@ -975,6 +994,7 @@ FATDelEntry(
 
     DPRINT("delEntry PathName \'%wZ\'\n", &pFcb->PathNameU);
     DPRINT("delete entry: %u to %u\n", pFcb->startIndex, pFcb->dirIndex);
+    vfatNameIndexRemoveEntry(pFcb->parentFcb, pFcb);
     Offset.u.HighPart = 0;
     for (i = pFcb->startIndex; i <= pFcb->dirIndex; i++)
     {
@@ -276,6 +276,7 @@ vfatDestroyFCB(
 #endif
 
     FsRtlUninitializeFileLock(&pFCB->FileLock);
+    vfatDestroyNameIndex(pFCB);
 
     if (!vfatFCBIsRoot(pFCB) &&
         !BooleanFlagOn(pFCB->Flags, FCB_IS_FAT) && !BooleanFlagOn(pFCB->Flags, FCB_IS_VOLUME))
@@ -823,6 +824,25 @@ vfatDirFindFile(
     DirContext.ShortNameU.MaximumLength = sizeof(ShortNameBuffer);
     DirContext.DeviceExt = pDeviceExt;
 
+    /* Large directories are looked up through their name index */
+    if (vfatNameIndexAvailable(pDeviceExt, pDirectoryFCB))
+    {
+        status = vfatNameIndexLookup(pDeviceExt, pDirectoryFCB, FileToFindU, &DirContext);
+        if (status == STATUS_NO_MORE_ENTRIES)
+        {
+            return STATUS_OBJECT_NAME_NOT_FOUND;
+        }
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        return vfatMakeFCBFromDirEntry(pDeviceExt,
+                                       pDirectoryFCB,
+                                       &DirContext,
+                                       pFoundFCB);
+    }
+
     while (TRUE)
     {
         status = VfatGetNextDirEntry(pDeviceExt,
@@ -112,6 +112,8 @@ DriverEntry(
                                     NULL, NULL, 0, sizeof(VFAT_IRP_CONTEXT), TAG_IRP, 0);
     ExInitializePagedLookasideList(&VfatGlobalData->CloseContextLookasideList,
                                    NULL, NULL, 0, sizeof(VFAT_CLOSE_CONTEXT), TAG_CLOSE, 0);
+    ExInitializePagedLookasideList(&VfatGlobalData->NameIndexLookasideList,
+                                   NULL, NULL, 0, sizeof(VFAT_NAME_INDEX_ENTRY), TAG_NAMEINDEX, 0);
 
     ExInitializeResourceLite(&VfatGlobalData->VolumeListLock);
     InitializeListHead(&VfatGlobalData->VolumeListHead);
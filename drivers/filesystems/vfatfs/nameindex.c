@@ -0,0 +1,465 @@
+/*
+ * PROJECT:     VFAT Filesystem
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Name index for lookups in large directories
+ */
+
+/*  -------------------------------------------------------  INCLUDES  */
+
+#include "vfat.h"
+
+#define NDEBUG
+#include <debug.h>
+
+/*  --------------------------------------------------------  DEFINES  */
+
+/* Smaller directories are still scanned, 1024 entries */
+#define NAME_INDEX_MIN_DIR_SIZE     (32 * 1024)
+#define NAME_INDEX_MIN_BUCKETS      256
+
+/*
+ * The index maps the hash of the upcased long and short names of every
+ * entry to the directory index where the entry starts. It only has to
+ * be complete: a hash match is always checked against the entry on the
+ * disk, so entries that have been deleted behind our back do no harm.
+ * The index is only used while holding the DirResource exclusively,
+ * which is also held by everything that adds or deletes entries.
+ */
+
+/*  -------------------------------------------------------  FUNCTIONS  */
+
+static
+ULONG
+vfatNameIndexHash(
+    PUNICODE_STRING NameU)
+{
+    ULONG Hash = 2166136261u;
+    USHORT i;
+
+    for (i = 0; i < NameU->Length / sizeof(WCHAR); i++)
+    {
+        Hash = (Hash ^ RtlUpcaseUnicodeChar(NameU->Buffer[i])) * 16777619u;
+    }
+
+    return Hash;
+}
+
+static
+VOID
+vfatNameIndexGrow(
+    PVFAT_NAME_INDEX Index)
+{
+    PVFAT_NAME_INDEX_ENTRY *Buckets;
+    PVFAT_NAME_INDEX_ENTRY Entry;
+    ULONG BucketCount, i;
+
+    BucketCount = Index->BucketCount * 2;
+    Buckets = ExAllocatePoolWithTag(PagedPool, BucketCount * sizeof(PVFAT_NAME_INDEX_ENTRY), TAG_NAMEINDEX);
+    if (Buckets == NULL)
+    {
+        /* Longer chains are fine */
+        return;
+    }
+    RtlZeroMemory(Buckets, BucketCount * sizeof(PVFAT_NAME_INDEX_ENTRY));
+
+    for (i = 0; i < Index->BucketCount; i++)
+    {
+        while (Index->Buckets[i] != NULL)
+        {
+            Entry = Index->Buckets[i];
+            Index->Buckets[i] = Entry->Next;
+            Entry->Next = Buckets[Entry->Hash & (BucketCount - 1)];
+            Buckets[Entry->Hash & (BucketCount - 1)] = Entry;
+        }
+    }
+
+    ExFreePoolWithTag(Index->Buckets, TAG_NAMEINDEX);
+    Index->Buckets = Buckets;
+    Index->BucketCount = BucketCount;
+}
+
+static
+BOOLEAN
+vfatNameIndexInsert(
+    PVFAT_NAME_INDEX Index,
+    ULONG Hash,
+    ULONG StartIndex)
+{
+    PVFAT_NAME_INDEX_ENTRY Entry;
+
+    Entry = ExAllocateFromPagedLookasideList(&VfatGlobalData->NameIndexLookasideList);
+    if (Entry == NULL)
+    {
+        return FALSE;
+    }
+
+    Entry->Hash = Hash;
+    Entry->StartIndex = StartIndex;
+    Entry->Next = Index->Buckets[Hash & (Index->BucketCount - 1)];
+    Index->Buckets[Hash & (Index->BucketCount - 1)] = Entry;
+
+    Index->EntryCount++;
+    if (Index->EntryCount > 2 * Index->BucketCount)
+    {
+        vfatNameIndexGrow(Index);
+    }
+
+    return TRUE;
+}
+
+static
+VOID
+vfatNameIndexRemove(
+    PVFAT_NAME_INDEX Index,
+    ULONG Hash,
+    ULONG StartIndex)
+{
+    PVFAT_NAME_INDEX_ENTRY *Link, Entry;
+
+    Link = &Index->Buckets[Hash & (Index->BucketCount - 1)];
+    while ((Entry = *Link) != NULL)
+    {
+        if (Entry->Hash == Hash && Entry->StartIndex == StartIndex)
+        {
+            *Link = Entry->Next;
+            ExFreeToPagedLookasideList(&VfatGlobalData->NameIndexLookasideList, Entry);
+            Index->EntryCount--;
+            return;
+        }
+        Link = &Entry->Next;
+    }
+}
+
+static
+BOOLEAN
+vfatNameIndexInsertNames(
+    PVFAT_NAME_INDEX Index,
+    PVFAT_DIRENTRY_CONTEXT DirContext)
+{
+    ULONG LongHash, ShortHash;
+
+    if (ENTRY_VOLUME(FALSE, &DirContext->DirEntry) ||
+        DirContext->LongNameU.Length == 0 ||
+        DirContext->ShortNameU.Length == 0)
+    {
+        /* Lookups skip these entries */
+        return TRUE;
+    }
+
+    LongHash = vfatNameIndexHash(&DirContext->LongNameU);
+    ShortHash = vfatNameIndexHash(&DirContext->ShortNameU);
+
+    if (!vfatNameIndexInsert(Index, LongHash, DirContext->StartIndex))
+    {
+        return FALSE;
+    }
+    if (ShortHash != LongHash &&
+        !vfatNameIndexInsert(Index, ShortHash, DirContext->StartIndex))
+    {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+VOID
+vfatDestroyNameIndex(
+    PVFATFCB DirFcb)
+{
+    PVFAT_NAME_INDEX Index = DirFcb->NameIndex;
+    PVFAT_NAME_INDEX_ENTRY Entry;
+    ULONG i;
+
+    if (Index == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < Index->BucketCount; i++)
+    {
+        while (Index->Buckets[i] != NULL)
+        {
+            Entry = Index->Buckets[i];
+            Index->Buckets[i] = Entry->Next;
+            ExFreeToPagedLookasideList(&VfatGlobalData->NameIndexLookasideList, Entry);
+        }
+    }
+
+    ExFreePoolWithTag(Index->Buckets, TAG_NAMEINDEX);
+    ExFreePoolWithTag(Index, TAG_NAMEINDEX);
+    DirFcb->NameIndex = NULL;
+}
+
+static
+NTSTATUS
+vfatBuildNameIndex(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb)
+{
+    NTSTATUS Status;
+    PVFAT_NAME_INDEX Index;
+    PVOID Context = NULL;
+    PVOID Page = NULL;
+    BOOLEAN First = TRUE;
+    VFAT_DIRENTRY_CONTEXT DirContext;
+    WCHAR LongNameBuffer[260];
+    WCHAR ShortNameBuffer[13];
+    ULONG BucketCount, NextIndex = 0;
+
+    Index = ExAllocatePoolWithTag(PagedPool, sizeof(VFAT_NAME_INDEX), TAG_NAMEINDEX);
+    if (Index == NULL)
+    {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    /* Size the table for a directory without long names */
+    BucketCount = NAME_INDEX_MIN_BUCKETS;
+    while (BucketCount < DirFcb->RFCB.FileSize.u.LowPart / sizeof(FAT_DIR_ENTRY))
+    {
+        BucketCount *= 2;
+    }
+
+    Index->BucketCount = BucketCount;
+    Index->EntryCount = 0;
+    Index->FreeHint = MAXULONG;
+    Index->Buckets = ExAllocatePoolWithTag(PagedPool, BucketCount * sizeof(PVFAT_NAME_INDEX_ENTRY), TAG_NAMEINDEX);
+    if (Index->Buckets == NULL)
+    {
+        ExFreePoolWithTag(Index, TAG_NAMEINDEX);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+    RtlZeroMemory(Index->Buckets, BucketCount * sizeof(PVFAT_NAME_INDEX_ENTRY));
+    DirFcb->NameIndex = Index;
+
+    DirContext.DirIndex = 0;
+    DirContext.LongNameU.Buffer = LongNameBuffer;
+    DirContext.LongNameU.Length = 0;
+    DirContext.LongNameU.MaximumLength = sizeof(LongNameBuffer);
+    DirContext.ShortNameU.Buffer = ShortNameBuffer;
+    DirContext.ShortNameU.Length = 0;
+    DirContext.ShortNameU.MaximumLength = sizeof(ShortNameBuffer);
+    DirContext.DeviceExt = DeviceExt;
+
+    while (TRUE)
+    {
+        Status = VfatGetNextDirEntry(DeviceExt, &Context, &Page, DirFcb, &DirContext, First);
+        First = FALSE;
+        if (Status == STATUS_NO_MORE_ENTRIES)
+        {
+            Status = STATUS_SUCCESS;
+            break;
+        }
+        if (!NT_SUCCESS(Status))
+        {
+            break;
+        }
+
+        /* Only deleted entries are skipped before the start of an entry */
+        if (Index->FreeHint == MAXULONG && DirContext.StartIndex > NextIndex)
+        {
+            Index->FreeHint = NextIndex;
+        }
+
+        if (!vfatNameIndexInsertNames(Index, &DirContext))
+        {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            break;
+        }
+
+        DirContext.DirIndex++;
+        NextIndex = DirContext.DirIndex;
+    }
+
+    if (Context != NULL)
+    {
+        CcUnpinData(Context);
+    }
+
+    if (!NT_SUCCESS(Status))
+    {
+        vfatDestroyNameIndex(DirFcb);
+        return Status;
+    }
+
+    if (Index->FreeHint == MAXULONG)
+    {
+        Index->FreeHint = NextIndex;
+    }
+
+    DPRINT("Built the name index of %wZ: %lu names, %lu buckets\n",
+           &DirFcb->PathNameU, Index->EntryCount, Index->BucketCount);
+    return STATUS_SUCCESS;
+}
+
+/*
+ * FUNCTION: Returns whether lookups in a directory can use its name
+ * index, building the index if the directory is large enough.
+ */
+BOOLEAN
+vfatNameIndexAvailable(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb)
+{
+    if (!ExIsResourceAcquiredExclusiveLite(&DeviceExt->DirResource))
+    {
+        return FALSE;
+    }
+
+    if (DirFcb->NameIndex != NULL)
+    {
+        return TRUE;
+    }
+
+    /* FATX directories are small and have their own entry layout */
+    if (vfatVolumeIsFatX(DeviceExt) ||
+        DirFcb->RFCB.FileSize.u.LowPart < NAME_INDEX_MIN_DIR_SIZE)
+    {
+        return FALSE;
+    }
+
+    return NT_SUCCESS(vfatBuildNameIndex(DeviceExt, DirFcb));
+}
+
+/*
+ * FUNCTION: Looks up a name in the name index of a directory. On success,
+ * DirContext describes the first entry whose long or short name matches,
+ * otherwise STATUS_NO_MORE_ENTRIES is returned.
+ */
+NTSTATUS
+vfatNameIndexLookup(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb,
+    PUNICODE_STRING FileToFindU,
+    PVFAT_DIRENTRY_CONTEXT DirContext)
+{
+    PVFAT_NAME_INDEX Index = DirFcb->NameIndex;
+    PVFAT_NAME_INDEX_ENTRY Entry;
+    NTSTATUS Status;
+    PVOID Context;
+    PVOID Page;
+    ULONG Hash, Candidate, After = 0;
+
+    ASSERT(Index != NULL);
+    ASSERT(ExIsResourceAcquiredExclusiveLite(&DeviceExt->DirResource));
+
+    Hash = vfatNameIndexHash(FileToFindU);
+    while (TRUE)
+    {
+        /* Check the candidates in directory order, like a scan would */
+        Candidate = MAXULONG;
+        for (Entry = Index->Buckets[Hash & (Index->BucketCount - 1)]; Entry != NULL; Entry = Entry->Next)
+        {
+            if (Entry->Hash == Hash && Entry->StartIndex >= After && Entry->StartIndex < Candidate)
+            {
+                Candidate = Entry->StartIndex;
+            }
+        }
+        if (Candidate == MAXULONG)
+        {
+            return STATUS_NO_MORE_ENTRIES;
+        }
+
+        Context = NULL;
+        DirContext->DirIndex = Candidate;
+        Status = VfatGetNextDirEntry(DeviceExt, &Context, &Page, DirFcb, DirContext, TRUE);
+        if (Context != NULL)
+        {
+            CcUnpinData(Context);
+        }
+        if (!NT_SUCCESS(Status) && Status != STATUS_NO_MORE_ENTRIES)
+        {
+            return Status;
+        }
+
+        if (NT_SUCCESS(Status) &&
+            !ENTRY_VOLUME(FALSE, &DirContext->DirEntry) &&
+            DirContext->LongNameU.Length != 0 &&
+            DirContext->ShortNameU.Length != 0 &&
+            (RtlEqualUnicodeString(FileToFindU, &DirContext->LongNameU, TRUE) ||
+             RtlEqualUnicodeString(FileToFindU, &DirContext->ShortNameU, TRUE)))
+        {
+            DPRINT("Name index hit for %wZ at %u\n", FileToFindU, DirContext->StartIndex);
+            return STATUS_SUCCESS;
+        }
+
+        After = Candidate + 1;
+    }
+}
+
+/*
+ * FUNCTION: Adds the entry just written at StartIndex to the name index
+ * of its directory. The names are read back from the disk so that they
+ * hash exactly like the ones a scan would find. The free slot hint moves
+ * past the entry only now that its slots are in use.
+ */
+VOID
+vfatNameIndexAddEntry(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb,
+    ULONG StartIndex)
+{
+    NTSTATUS Status;
+    PVOID Context = NULL;
+    PVOID Page;
+    VFAT_DIRENTRY_CONTEXT DirContext;
+    WCHAR LongNameBuffer[260];
+    WCHAR ShortNameBuffer[13];
+
+    if (DirFcb->NameIndex == NULL)
+    {
+        return;
+    }
+
+    DirContext.DirIndex = StartIndex;
+    DirContext.LongNameU.Buffer = LongNameBuffer;
+    DirContext.LongNameU.Length = 0;
+    DirContext.LongNameU.MaximumLength = sizeof(LongNameBuffer);
+    DirContext.ShortNameU.Buffer = ShortNameBuffer;
+    DirContext.ShortNameU.Length = 0;
+    DirContext.ShortNameU.MaximumLength = sizeof(ShortNameBuffer);
+    DirContext.DeviceExt = DeviceExt;
+
+    Status = VfatGetNextDirEntry(DeviceExt, &Context, &Page, DirFcb, &DirContext, TRUE);
+    if (Context != NULL)
+    {
+        CcUnpinData(Context);
+    }
+
+    /* A missing name would make lookups fail, drop the index instead */
+    if (!NT_SUCCESS(Status) ||
+        !vfatNameIndexInsertNames(DirFcb->NameIndex, &DirContext))
+    {
+        DPRINT1("Failed to index the entry at %u of %wZ\n", StartIndex, &DirFcb->PathNameU);
+        vfatDestroyNameIndex(DirFcb);
+        return;
+    }
+
+    if (DirFcb->NameIndex->FreeHint == StartIndex)
+    {
+        DirFcb->NameIndex->FreeHint = DirContext.DirIndex + 1;
+    }
+}
+
+/*
+ * FUNCTION: Removes a deleted entry from the name index of its directory
+ */
+VOID
+vfatNameIndexRemoveEntry(
+    PVFATFCB DirFcb,
+    PVFATFCB Fcb)
+{
+    PVFAT_NAME_INDEX Index = DirFcb->NameIndex;
+
+    if (Index == NULL)
+    {
+        return;
+    }
+
+    vfatNameIndexRemove(Index, vfatNameIndexHash(&Fcb->LongNameU), Fcb->startIndex);
+    vfatNameIndexRemove(Index, vfatNameIndexHash(&Fcb->ShortNameU), Fcb->startIndex);
+
+    if (Fcb->startIndex < Index->FreeHint)
+    {
+        Index->FreeHint = Fcb->startIndex;
+    }
+}
@@ -418,6 +418,7 @@ typedef struct
     NPAGED_LOOKASIDE_LIST CcbLookasideList;
     NPAGED_LOOKASIDE_LIST IrpContextLookasideList;
     PAGED_LOOKASIDE_LIST CloseContextLookasideList;
+    PAGED_LOOKASIDE_LIST NameIndexLookasideList;
     FAST_IO_DISPATCH FastIoDispatch;
     CACHE_MANAGER_CALLBACKS CacheMgrCallbacks;
     FAST_MUTEX CloseMutex;
@@ -444,6 +445,25 @@ extern PVFAT_GLOBAL_DATA VfatGlobalData;
 
 #define NODE_TYPE_FCB ((CSHORT)0x0502)
 
+typedef struct _VFAT_NAME_INDEX_ENTRY
+{
+    struct _VFAT_NAME_INDEX_ENTRY *Next;
+    /* Hash of the upcased long or short name */
+    ULONG Hash;
+    /* Directory index where the entry starts */
+    ULONG StartIndex;
+} VFAT_NAME_INDEX_ENTRY, *PVFAT_NAME_INDEX_ENTRY;
+
+typedef struct _VFAT_NAME_INDEX
+{
+    /* Number of buckets, always a power of two */
+    ULONG BucketCount;
+    ULONG EntryCount;
+    /* No directory entry below this index is free */
+    ULONG FreeHint;
+    PVFAT_NAME_INDEX_ENTRY *Buckets;
+} VFAT_NAME_INDEX, *PVFAT_NAME_INDEX;
+
 typedef struct _VFATFCB
 {
     /* FCB header required by ROS/NT */
@@ -529,6 +549,9 @@ typedef struct _VFATFCB
     ULONG LastOffset;
 
     struct _VFAT_CLOSE_CONTEXT * CloseContext;
+
+    /* Name index of a large directory, built on the first lookup */
+    PVFAT_NAME_INDEX NameIndex;
 } VFATFCB, *PVFATFCB;
 
 #define CCB_DELETE_ON_CLOSE     0x0001
@@ -553,6 +576,7 @@ typedef struct _VFATCCB
 #define TAG_NAME 'ntaF'
 #define TAG_SEARCH 'LtaF'
 #define TAG_DIRENT 'DtaF'
+#define TAG_NAMEINDEX 'HtaF'
 
 #define ENTRIES_PER_SECTOR (BLOCKSIZE / sizeof(FATDirEntry))
 
@@ -1181,6 +1205,35 @@ VfatHandleDeferredWrite(
     IN PVOID IrpContext,
     IN PVOID Unused);
 
+/* nameindex.c */
+
+BOOLEAN
+vfatNameIndexAvailable(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb);
+
+NTSTATUS
+vfatNameIndexLookup(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb,
+    PUNICODE_STRING FileToFindU,
+    PVFAT_DIRENTRY_CONTEXT DirContext);
+
+VOID
+vfatNameIndexAddEntry(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB DirFcb,
+    ULONG StartIndex);
+
+VOID
+vfatNameIndexRemoveEntry(
+    PVFATFCB DirFcb,
+    PVFATFCB Fcb);
+
+VOID
+vfatDestroyNameIndex(
+    PVFATFCB DirFcb);
+
 /* pnp.c */
 
 NTSTATUS
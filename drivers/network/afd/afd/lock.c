@@ -306,10 +306,14 @@ VOID UnlockBuffers( PAFD_WSABUF Buf, UINT Count, BOOL Address ) {
 }
 
 /* Produce a kernel-land handle array with handles replaced by object
- * pointers.  This will allow the system to do proper alerting */
-PAFD_HANDLE LockHandles( PAFD_HANDLE HandleArray, UINT HandleCount ) {
+ * pointers.  This will allow the system to do proper alerting.  Every
+ * handle must be an AFD socket, because the poll links itself into the
+ * FCB of each one */
+PAFD_HANDLE LockHandles( PDEVICE_OBJECT DeviceObject,
+                         PAFD_HANDLE HandleArray, UINT HandleCount ) {
     UINT i;
     NTSTATUS Status = STATUS_SUCCESS;
+    PFILE_OBJECT FileObject;
 
     PAFD_HANDLE FileObjects = ExAllocatePoolWithTag(NonPagedPool,
                                                     HandleCount * sizeof(AFD_HANDLE),
@@ -324,10 +328,19 @@ PAFD_HANDLE LockHandles( PAFD_HANDLE HandleArray, UINT HandleCount ) {
                 Status = ObReferenceObjectByHandle
                     ( (PVOID)HandleArray[i].Handle,
                       FILE_ALL_ACCESS,
-                      NULL,
+                      *IoFileObjectType,
                        KernelMode,
                        (PVOID*)&FileObjects[i].Handle,
                        NULL );
+
+                if( NT_SUCCESS(Status) ) {
+                    FileObject = (PFILE_OBJECT)FileObjects[i].Handle;
+                    if( FileObject->DeviceObject != DeviceObject ||
+                        !FileObject->FsContext ) {
+                        ObDereferenceObject( FileObject );
+                        Status = STATUS_INVALID_HANDLE;
+                    }
+                }
         }
 
         if( !NT_SUCCESS(Status) )
@@ -68,6 +68,8 @@ VOID SignalSocket(
     {
         KeCancelTimer( &Poll->Timer );
         RemoveEntryList( &Poll->ListEntry );
+        for( i = 0; i < Poll->EntryCount; i++ )
+            RemoveEntryList( &Poll->Entries[i].ListEntry );
         ExFreePoolWithTag(Poll, TAG_AFD_ACTIVE_POLL);
     }
 
@@ -122,40 +124,78 @@ static VOID NTAPI SelectTimeout( PKDPC Dpc,
     AFD_DbgPrint(MID_TRACE,("Timeout\n"));
 }
 
+/* Queues a packet for the registered events the socket has signalled */
+static VOID QueueNotification( PAFD_FCB FCB ) {
+    PIO_COMPLETION_CONTEXT CompletionContext = FCB->FileObject->CompletionContext;
+    DWORD Events = FCB->NotifyEvents & FCB->PollState;
+    ULONG NetworkEvents = 0;
+    NTSTATUS Status;
+
+    if( !CompletionContext ) return;
+
+    if( Events & AFD_EVENT_RECEIVE )
+        NetworkEvents |= FD_READ;
+    if( Events & AFD_EVENT_SEND )
+        NetworkEvents |= FD_WRITE;
+    if( Events & AFD_EVENT_OOB_RECEIVE )
+        NetworkEvents |= FD_OOB;
+    if( Events & AFD_EVENT_ACCEPT )
+        NetworkEvents |= FD_ACCEPT;
+    if( Events & (AFD_EVENT_CONNECT | AFD_EVENT_CONNECT_FAIL) )
+        NetworkEvents |= FD_CONNECT;
+    if( Events & (AFD_EVENT_DISCONNECT | AFD_EVENT_ABORT | AFD_EVENT_CLOSE) )
+        NetworkEvents |= FD_CLOSE;
+    if( Events & AFD_EVENT_QOS )
+        NetworkEvents |= FD_QOS;
+    if( Events & AFD_EVENT_GROUP_QOS )
+        NetworkEvents |= FD_GROUP_QOS;
+
+    Status = IoSetIoCompletion( CompletionContext->Port,
+                                CompletionContext->Key,
+                                FCB->NotifyContext,
+                                STATUS_SUCCESS,
+                                NetworkEvents,
+                                FALSE );
+    if( !NT_SUCCESS(Status) )
+        AFD_DbgPrint(MIN_TRACE,("Failed to queue notification (0x%x)\n", Status));
+}
+
 VOID KillSelectsForFCB( PAFD_DEVICE_EXTENSION DeviceExt,
                         PFILE_OBJECT FileObject,
                         BOOLEAN OnlyExclusive ) {
     KIRQL OldIrql;
     PLIST_ENTRY ListEntry;
+    PAFD_POLL_ENTRY Entry;
     PAFD_ACTIVE_POLL Poll;
-    PIRP Irp;
     PAFD_POLL_INFO PollReq;
-    PAFD_HANDLE HandleArray;
-    UINT i;
+    PAFD_FCB FCB = FileObject->FsContext;
 
     AFD_DbgPrint(MID_TRACE,("Killing selects that refer to %p\n", FileObject));
 
     KeAcquireSpinLock( &DeviceExt->Lock, &OldIrql );
 
-    ListEntry = DeviceExt->Polls.Flink;
-    while ( ListEntry != &DeviceExt->Polls ) {
-        Poll = CONTAINING_RECORD(ListEntry, AFD_ACTIVE_POLL, ListEntry);
-        ListEntry = ListEntry->Flink;
-        Irp = Poll->Irp;
-        PollReq = Irp->AssociatedIrp.SystemBuffer;
-        HandleArray = AFD_HANDLES(PollReq);
+    ListEntry = FCB->PollWaiters.Flink;
+    while ( ListEntry != &FCB->PollWaiters ) {
+        Entry = CONTAINING_RECORD(ListEntry, AFD_POLL_ENTRY, ListEntry);
+        Poll = Entry->Poll;
 
-        for( i = 0; i < PollReq->HandleCount; i++ ) {
-            AFD_DbgPrint(MAX_TRACE,("Req: %u, This %p\n",
-                                    HandleArray[i].Handle, FileObject));
-            if( (PVOID)HandleArray[i].Handle == FileObject &&
-                (!OnlyExclusive || (OnlyExclusive && Poll->Exclusive)) ) {
-                ZeroEvents( PollReq->Handles, PollReq->HandleCount );
-                SignalSocket( Poll, NULL, PollReq, STATUS_CANCELLED );
-            }
+        if( OnlyExclusive && !Poll->Exclusive ) {
+            ListEntry = ListEntry->Flink;
+            continue;
         }
+
+        PollReq = Poll->Irp->AssociatedIrp.SystemBuffer;
+        ZeroEvents( PollReq->Handles, PollReq->HandleCount );
+        SignalSocket( Poll, NULL, PollReq, STATUS_CANCELLED );
+
+        /* That unlinked every entry of the poll, start over */
+        ListEntry = FCB->PollWaiters.Flink;
     }
 
+    /* The socket is going away, stop queueing notifications for it */
+    if( !OnlyExclusive )
+        FCB->NotifyEvents = 0;
+
     KeReleaseSpinLock( &DeviceExt->Lock, OldIrql );
 
     AFD_DbgPrint(MID_TRACE,("Done\n"));
@@ -180,7 +220,8 @@ AfdSelect( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                             (INT)(PollReq->Timeout.QuadPart)));
 
     SET_AFD_HANDLES(PollReq,
-                    LockHandles( PollReq->Handles, PollReq->HandleCount ));
+                    LockHandles( DeviceObject,
+                                 PollReq->Handles, PollReq->HandleCount ));
 
     if( !AFD_HANDLES(PollReq) ) {
         Irp->IoStatus.Status = STATUS_NO_MEMORY;
@@ -228,14 +269,35 @@ AfdSelect( PDEVICE_OBJECT DeviceObject, PIRP Irp,
 
        PAFD_ACTIVE_POLL Poll = NULL;
 
-       Poll = ExAllocatePoolWithTag(NonPagedPool,
-                                    sizeof(AFD_ACTIVE_POLL),
-                                    TAG_AFD_ACTIVE_POLL);
+       if (PollReq->HandleCount <
+           (MAXULONG - sizeof(AFD_ACTIVE_POLL)) / sizeof(AFD_POLL_ENTRY))
+       {
+          Poll = ExAllocatePoolWithTag(NonPagedPool,
+                                       FIELD_OFFSET(AFD_ACTIVE_POLL, Entries) +
+                                       PollReq->HandleCount * sizeof(AFD_POLL_ENTRY),
+                                       TAG_AFD_ACTIVE_POLL);
+       }
 
        if (Poll){
           Poll->Irp = Irp;
           Poll->DeviceExt = DeviceExt;
           Poll->Exclusive = Exclusive;
+          Poll->EntryCount = PollReq->HandleCount;
+
+          /* Wait on each socket so that only its own events look at us */
+          for( i = 0; i < PollReq->HandleCount; i++ ) {
+              Poll->Entries[i].Poll = Poll;
+              Poll->Entries[i].Index = i;
+
+              if( !AFD_HANDLES(PollReq)[i].Handle ) {
+                  InitializeListHead( &Poll->Entries[i].ListEntry );
+                  continue;
+              }
+
+              FileObject = (PFILE_OBJECT)AFD_HANDLES(PollReq)[i].Handle;
+              FCB = FileObject->FsContext;
+              InsertTailList( &FCB->PollWaiters, &Poll->Entries[i].ListEntry );
+          }
 
           KeInitializeTimerEx( &Poll->Timer, NotificationTimer );
 
@@ -249,8 +311,9 @@ AfdSelect( PDEVICE_OBJECT DeviceObject, PIRP Irp,
           IoMarkIrpPending( Irp );
           (void)IoSetCancelRoutine(Irp, AfdCancelHandler);
        } else {
-          AFD_DbgPrint(MAX_TRACE, ("FIXME: do something with the IRP!\n"));
           Status = STATUS_NO_MEMORY;
+          ZeroEvents( PollReq->Handles, PollReq->HandleCount );
+          SignalSocket( NULL, Irp, PollReq, Status );
        }
     }
 
@@ -378,6 +441,47 @@ AfdEnumEvents( PDEVICE_OBJECT DeviceObject, PIRP Irp,
     return UnlockAndMaybeComplete( FCB, STATUS_SUCCESS, Irp, 0 );
 }
 
+NTSTATUS NTAPI
+AfdSetNotify( PDEVICE_OBJECT DeviceObject, PIRP Irp,
+              PIO_STACK_LOCATION IrpSp ) {
+    PFILE_OBJECT FileObject = IrpSp->FileObject;
+    PAFD_NOTIFY_INFO NotifyInfo =
+        (PAFD_NOTIFY_INFO)LockRequest( Irp, IrpSp, FALSE, NULL );
+    PAFD_FCB FCB = FileObject->FsContext;
+    KIRQL OldIrql;
+
+    UNREFERENCED_PARAMETER(DeviceObject);
+
+    if( !SocketAcquireStateLock( FCB ) ) {
+        return LostSocket( Irp );
+    }
+
+    if ( !NotifyInfo ) {
+         return UnlockAndMaybeComplete( FCB, STATUS_NO_MEMORY, Irp, 0 );
+    }
+    AFD_DbgPrint(MID_TRACE,("Called (Events %x Context %p)\n",
+                            NotifyInfo->Events,
+                            NotifyInfo->Context));
+
+    /* The packets go to the completion port the socket is associated with */
+    if( NotifyInfo->Events && !FileObject->CompletionContext ) {
+        return UnlockAndMaybeComplete( FCB, STATUS_INVALID_PARAMETER, Irp, 0 );
+    }
+
+    KeAcquireSpinLock( &FCB->DeviceExt->Lock, &OldIrql );
+
+    FCB->NotifyEvents = NotifyInfo->Events;
+    FCB->NotifyContext = NotifyInfo->Context;
+
+    /* Report what is already pending, after that only new signals are */
+    if( FCB->NotifyEvents & FCB->PollState )
+        QueueNotification( FCB );
+
+    KeReleaseSpinLock( &FCB->DeviceExt->Lock, OldIrql );
+
+    return UnlockAndMaybeComplete( FCB, STATUS_SUCCESS, Irp, 0 );
+}
+
 /* * * NOTE ALWAYS CALLED AT DISPATCH_LEVEL * * */
 static BOOLEAN UpdatePollWithFCB( PAFD_ACTIVE_POLL Poll, PFILE_OBJECT FileObject ) {
     UINT i;
@@ -406,10 +510,12 @@ static BOOLEAN UpdatePollWithFCB( PAFD_ACTIVE_POLL Poll, PFILE_OBJECT FileObject
 
 VOID PollReeval( PAFD_DEVICE_EXTENSION DeviceExt, PFILE_OBJECT FileObject ) {
     PAFD_ACTIVE_POLL Poll = NULL;
+    PAFD_POLL_ENTRY Entry;
     PLIST_ENTRY ThePollEnt = NULL;
     PAFD_FCB FCB;
     KIRQL OldIrql;
     PAFD_POLL_INFO PollReq;
+    BOOLEAN Matched;
 
     AFD_DbgPrint(MID_TRACE,("Called: DeviceExt %p FileObject %p\n",
                             DeviceExt, FileObject));
@@ -424,22 +530,37 @@ VOID PollReeval( PAFD_DEVICE_EXTENSION DeviceExt, PFILE_OBJECT FileObject ) {
         return;
     }
 
-    /* Now signal normal select irps */
-    ThePollEnt = DeviceExt->Polls.Flink;
+    /* Now signal the select irps waiting on this socket */
+    ThePollEnt = FCB->PollWaiters.Flink;
 
-    while( ThePollEnt != &DeviceExt->Polls ) {
-        Poll = CONTAINING_RECORD( ThePollEnt, AFD_ACTIVE_POLL, ListEntry );
+    while( ThePollEnt != &FCB->PollWaiters ) {
+        Poll = CONTAINING_RECORD( ThePollEnt, AFD_POLL_ENTRY, ListEntry )->Poll;
         PollReq = Poll->Irp->AssociatedIrp.SystemBuffer;
         AFD_DbgPrint(MID_TRACE,("Checking poll %p\n", Poll));
 
-        if( UpdatePollWithFCB( Poll, FileObject ) ) {
+        /*
+         * A poll that lists this socket more than once linked all of its
+         * entries here in one go, so they are adjacent. Look at them
+         * together, signalling unlinks them all.
+         */
+        Matched = FALSE;
+        do {
+            Entry = CONTAINING_RECORD( ThePollEnt, AFD_POLL_ENTRY, ListEntry );
+            if( PollReq->Handles[Entry->Index].Events & FCB->PollState )
+                Matched = TRUE;
             ThePollEnt = ThePollEnt->Flink;
+        } while( ThePollEnt != &FCB->PollWaiters &&
+                 CONTAINING_RECORD( ThePollEnt, AFD_POLL_ENTRY, ListEntry )->Poll == Poll );
+
+        if( Matched && UpdatePollWithFCB( Poll, FileObject ) ) {
             AFD_DbgPrint(MID_TRACE,("Signalling socket\n"));
             SignalSocket( Poll, NULL, PollReq, STATUS_SUCCESS );
-        } else
-            ThePollEnt = ThePollEnt->Flink;
+        }
     }
 
+    if( FCB->NotifyEvents & FCB->PollState )
+        QueueNotification( FCB );
+
     KeReleaseSpinLock( &DeviceExt->Lock, OldIrql );
 
     if((FCB->EventSelect) &&
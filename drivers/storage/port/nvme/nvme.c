@@ -0,0 +1,962 @@
+/*
+ * PROJECT:     ReactOS NVMe Miniport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Controller setup, I/O queue and interrupt handling
+ */
+
+#include "nvme.h"
+
+#define NDEBUG
+#include <debug.h>
+
+typedef struct _NVME_PCI_ID
+{
+    PCSTR VendorId;
+    PCSTR DeviceId;
+} NVME_PCI_ID;
+
+/*
+ * scsiport only finds PCI adapters by their vendor and device, not by
+ * class, so the controllers we know to work are listed here. Keep the
+ * list in sync with the nvme entries of txtsetup.sif.
+ */
+static const NVME_PCI_ID NvmePciIds[] =
+{
+    { "1b36", "0010" }, /* QEMU */
+    { "80ee", "4e56" }, /* VirtualBox */
+    { "8086", "0953" }, /* Intel 750 / DC P3x00 */
+    { "144d", "a804" }, /* Samsung 960 */
+    { "144d", "a808" }  /* Samsung 970 */
+};
+
+static
+ULONG
+NvmeReadRegister(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ ULONG Offset)
+{
+    return ScsiPortReadRegisterUlong((PULONG)(DevExt->Registers + Offset));
+}
+
+static
+VOID
+NvmeWriteRegister(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ ULONG Offset,
+    _In_ ULONG Value)
+{
+    ScsiPortWriteRegisterUlong((PULONG)(DevExt->Registers + Offset), Value);
+}
+
+/* 64-bit registers may be accessed as two dwords, the low one first */
+static
+ULONGLONG
+NvmeReadRegister64(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ ULONG Offset)
+{
+    ULONG Low, High;
+
+    Low = NvmeReadRegister(DevExt, Offset);
+    High = NvmeReadRegister(DevExt, Offset + sizeof(ULONG));
+
+    return ((ULONGLONG)High << 32) | Low;
+}
+
+static
+VOID
+NvmeWriteRegister64(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ ULONG Offset,
+    _In_ ULONGLONG Value)
+{
+    NvmeWriteRegister(DevExt, Offset, (ULONG)Value);
+    NvmeWriteRegister(DevExt, Offset + sizeof(ULONG), (ULONG)(Value >> 32));
+}
+
+static
+ULONG
+NvmeParseArgument(
+    _In_opt_ PCHAR String,
+    _In_ PCSTR Keyword)
+{
+    SIZE_T Length;
+    ULONG Value = 0;
+
+    if (!String)
+        return 0;
+
+    Length = strlen(Keyword);
+
+    for (; *String; String++)
+    {
+        if (_strnicmp(String, Keyword, Length) || String[Length] != '=')
+            continue;
+
+        for (String += Length + 1; *String >= '0' && *String <= '9'; String++)
+            Value = Value * 10 + (*String - '0');
+
+        break;
+    }
+
+    return Value;
+}
+
+static
+PVOID
+NvmeCarveMemory(
+    _Inout_ PUCHAR *Memory,
+    _Inout_ PULONGLONG PhysicalAddress,
+    _In_ ULONG Size,
+    _Out_ PULONGLONG BlockPhysicalAddress)
+{
+    PVOID Block = *Memory;
+
+    *BlockPhysicalAddress = *PhysicalAddress;
+
+    /* Queues and PRP lists all want to start on a page */
+    Size = ROUND_TO_PAGES(Size);
+    *Memory += Size;
+    *PhysicalAddress += Size;
+
+    return Block;
+}
+
+static
+VOID
+NvmeInitializeQueuePair(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ ULONG QueueId,
+    _Out_ PNVME_SUBMISSION_QUEUE Sq,
+    _Out_ PNVME_COMPLETION_QUEUE Cq)
+{
+    Sq->Doorbell = (PULONG)(DevExt->Registers + NVME_REG_DOORBELL +
+                            (2 * QueueId) * DevExt->DoorbellStride);
+    Sq->Tail = 0;
+
+    Cq->Doorbell = (PULONG)(DevExt->Registers + NVME_REG_DOORBELL +
+                            (2 * QueueId + 1) * DevExt->DoorbellStride);
+    Cq->Head = 0;
+    Cq->Phase = NVME_CQE_PHASE;
+
+    /* Entries left over from before a reset must not look new */
+    RtlZeroMemory(Cq->Completions, Cq->Entries * sizeof(*Cq->Completions));
+}
+
+static
+VOID
+NvmeAdvanceCompletionQueue(
+    _Inout_ PNVME_COMPLETION_QUEUE Cq)
+{
+    /* The controller flips the phase tag it writes on every wrap */
+    if (++Cq->Head == Cq->Entries)
+    {
+        Cq->Head = 0;
+        Cq->Phase ^= NVME_CQE_PHASE;
+    }
+}
+
+static
+BOOLEAN
+NvmeWaitReady(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ BOOLEAN Ready)
+{
+    ULONG Status;
+    ULONG i;
+
+    for (i = 0; i < DevExt->ReadyTimeout; i++)
+    {
+        Status = NvmeReadRegister(DevExt, NVME_REG_CSTS);
+
+        if (Status == MAXULONG)
+            break;
+
+        if (Ready && (Status & NVME_CSTS_FATAL))
+            break;
+
+        if (!!(Status & NVME_CSTS_READY) == Ready)
+            return TRUE;
+
+        ScsiPortStallExecution(1000);
+    }
+
+    DPRINT1("Controller did not become %sready\n", Ready ? "" : "not ");
+    return FALSE;
+}
+
+/*
+ * Admin commands are only issued while the adapter is being set up or
+ * reset, with the interrupt masked, so they are polled for.
+ */
+static
+BOOLEAN
+NvmeAdminCommand(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PNVME_COMMAND Command)
+{
+    PNVME_SUBMISSION_QUEUE Sq = &DevExt->AdminSq;
+    PNVME_COMPLETION_QUEUE Cq = &DevExt->AdminCq;
+    PNVME_COMPLETION Completion;
+    USHORT Status;
+    ULONG i;
+
+    Command->CommandId = Sq->Tail;
+    RtlCopyMemory(&Sq->Commands[Sq->Tail], Command, sizeof(*Command));
+
+    if (++Sq->Tail == Sq->Entries)
+        Sq->Tail = 0;
+    ScsiPortWriteRegisterUlong(Sq->Doorbell, Sq->Tail);
+
+    for (i = 0; i < DevExt->ReadyTimeout * 100; i++)
+    {
+        Completion = &Cq->Completions[Cq->Head];
+
+        if ((Completion->Status & NVME_CQE_PHASE) == Cq->Phase)
+        {
+            Status = Completion->Status;
+
+            NvmeAdvanceCompletionQueue(Cq);
+            ScsiPortWriteRegisterUlong(Cq->Doorbell, Cq->Head);
+
+            if (NVME_CQE_SCT(Status) != NVME_SCT_GENERIC ||
+                NVME_CQE_SC(Status) != NVME_SC_SUCCESS)
+            {
+                DPRINT1("Admin command %02x failed with %04x\n",
+                        Command->Opcode,
+                        Status);
+                return FALSE;
+            }
+
+            return TRUE;
+        }
+
+        ScsiPortStallExecution(10);
+    }
+
+    DPRINT1("Admin command %02x timed out\n", Command->Opcode);
+    return FALSE;
+}
+
+static
+BOOLEAN
+NvmeEnableController(
+    _In_ PNVME_DEVICE_EXTENSION DevExt)
+{
+    ULONG Configuration;
+
+    /* Whatever the firmware left running goes away with the reset */
+    Configuration = NvmeReadRegister(DevExt, NVME_REG_CC);
+    if (Configuration & NVME_CC_ENABLE)
+        NvmeWriteRegister(DevExt, NVME_REG_CC, Configuration & ~NVME_CC_ENABLE);
+
+    if (!NvmeWaitReady(DevExt, FALSE))
+        return FALSE;
+
+    /* Keep the line quiet until HwInitialize */
+    NvmeWriteRegister(DevExt, NVME_REG_INTMS, 1);
+
+    NvmeInitializeQueuePair(DevExt, 0, &DevExt->AdminSq, &DevExt->AdminCq);
+
+    NvmeWriteRegister(DevExt,
+                      NVME_REG_AQA,
+                      ((ULONG)(DevExt->AdminCq.Entries - 1) << 16) |
+                      (DevExt->AdminSq.Entries - 1));
+    NvmeWriteRegister64(DevExt, NVME_REG_ASQ, DevExt->AdminSq.PhysicalAddress);
+    NvmeWriteRegister64(DevExt, NVME_REG_ACQ, DevExt->AdminCq.PhysicalAddress);
+
+    /* NVM command set, 4K memory pages, round robin arbitration */
+    NvmeWriteRegister(DevExt,
+                      NVME_REG_CC,
+                      NVME_CC_ENABLE |
+                      NVME_CC_IOSQES(NVME_SQ_ENTRY_SHIFT) |
+                      NVME_CC_IOCQES(NVME_CQ_ENTRY_SHIFT));
+
+    return NvmeWaitReady(DevExt, TRUE);
+}
+
+static
+BOOLEAN
+NvmeIdentifyController(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _Out_ PULONG NamespaceCount)
+{
+    PNVME_IDENTIFY_CONTROLLER Controller = DevExt->Identify;
+    NVME_COMMAND Command;
+    UCHAR Mdts;
+
+    RtlZeroMemory(&Command, sizeof(Command));
+    Command.Opcode = NVME_ADMIN_IDENTIFY;
+    Command.Prp1 = DevExt->IdentifyPhysicalAddress;
+    Command.Cdw10 = NVME_IDENTIFY_CONTROLLER;
+
+    if (!NvmeAdminCommand(DevExt, &Command))
+        return FALSE;
+
+    RtlCopyMemory(DevExt->SerialNumber, Controller->SerialNumber, sizeof(DevExt->SerialNumber));
+    RtlCopyMemory(DevExt->ModelNumber, Controller->ModelNumber, sizeof(DevExt->ModelNumber));
+    RtlCopyMemory(DevExt->FirmwareRevision,
+                  Controller->FirmwareRevision,
+                  sizeof(DevExt->FirmwareRevision));
+
+    DevExt->OptionalNvmCommands = Controller->OptionalNvmCommands;
+    DevExt->VolatileWriteCache = Controller->VolatileWriteCache;
+    *NamespaceCount = Controller->NumberOfNamespaces;
+
+    /* MDTS counts in minimum memory pages, zero means no limit */
+    DevExt->MaxTransferLength = NVME_MAX_TRANSFER_LENGTH;
+    Mdts = Controller->MaximumDataTransferSize;
+    if (Mdts != 0 && Mdts < RTL_BITS_OF(ULONG) - PAGE_SHIFT &&
+        (PAGE_SIZE << Mdts) < DevExt->MaxTransferLength)
+    {
+        DevExt->MaxTransferLength = PAGE_SIZE << Mdts;
+    }
+
+    DPRINT1("NVMe: %.40s, firmware %.8s, %lu namespaces, max transfer %lu\n",
+            DevExt->ModelNumber,
+            DevExt->FirmwareRevision,
+            *NamespaceCount,
+            DevExt->MaxTransferLength);
+
+    return TRUE;
+}
+
+static
+BOOLEAN
+NvmeCreateIoQueues(
+    _In_ PNVME_DEVICE_EXTENSION DevExt)
+{
+    NVME_COMMAND Command;
+    ULONG QueueSize;
+
+    /* One submission and one completion queue, both counts are zero based */
+    RtlZeroMemory(&Command, sizeof(Command));
+    Command.Opcode = NVME_ADMIN_SET_FEATURES;
+    Command.Cdw10 = NVME_FEATURE_NUMBER_OF_QUEUES;
+    Command.Cdw11 = 0;
+
+    if (!NvmeAdminCommand(DevExt, &Command))
+        return FALSE;
+
+    NvmeInitializeQueuePair(DevExt, 1, &DevExt->IoSq, &DevExt->IoCq);
+
+    QueueSize = (ULONG)(DevExt->IoCq.Entries - 1) << 16;
+
+    RtlZeroMemory(&Command, sizeof(Command));
+    Command.Opcode = NVME_ADMIN_CREATE_CQ;
+    Command.Prp1 = DevExt->IoCq.PhysicalAddress;
+    Command.Cdw10 = QueueSize | 1;
+    Command.Cdw11 = NVME_CQ_IRQ_ENABLED | NVME_QUEUE_PHYS_CONTIG;
+
+    if (!NvmeAdminCommand(DevExt, &Command))
+        return FALSE;
+
+    QueueSize = (ULONG)(DevExt->IoSq.Entries - 1) << 16;
+
+    RtlZeroMemory(&Command, sizeof(Command));
+    Command.Opcode = NVME_ADMIN_CREATE_SQ;
+    Command.Prp1 = DevExt->IoSq.PhysicalAddress;
+    Command.Cdw10 = QueueSize | 1;
+    Command.Cdw11 = (1 << 16) | NVME_QUEUE_PHYS_CONTIG;
+
+    return NvmeAdminCommand(DevExt, &Command);
+}
+
+static
+VOID
+NvmeIdentifyNamespaces(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ ULONG NamespaceCount)
+{
+    PNVME_IDENTIFY_NAMESPACE Identify = DevExt->Identify;
+    PNVME_NAMESPACE Namespace;
+    NVME_COMMAND Command;
+    ULONG Format, Shift;
+    ULONG i;
+
+    for (i = 0; i < min(NamespaceCount, NVME_MAX_NAMESPACES); i++)
+    {
+        Namespace = &DevExt->Namespaces[i];
+        Namespace->Active = FALSE;
+
+        RtlZeroMemory(&Command, sizeof(Command));
+        Command.Opcode = NVME_ADMIN_IDENTIFY;
+        Command.NamespaceId = i + 1;
+        Command.Prp1 = DevExt->IdentifyPhysicalAddress;
+        Command.Cdw10 = NVME_IDENTIFY_NAMESPACE;
+
+        if (!NvmeAdminCommand(DevExt, &Command) || Identify->Size == 0)
+            continue;
+
+        Format = Identify->LbaFormat[NVME_LBAF_INDEX(Identify->FormattedLbaSize)];
+        Shift = NVME_LBAF_LBADS(Format);
+
+        /* Protection information and metadata would need a buffer of their own */
+        if (NVME_LBAF_MS(Format) != 0 || Shift < 9 || Shift > PAGE_SHIFT)
+        {
+            DPRINT1("Namespace %lu has an unsupported format %08lx\n", i + 1, Format);
+            continue;
+        }
+
+        Namespace->Active = TRUE;
+        Namespace->Thin = !!(Identify->Features & NVME_NS_FEATURE_THIN);
+        Namespace->BlockShift = Shift;
+        Namespace->BlockSize = 1 << Shift;
+        Namespace->LastLba = Identify->Size - 1;
+
+        DPRINT1("Namespace %lu: %I64u blocks of %lu bytes\n",
+                i + 1,
+                Identify->Size,
+                Namespace->BlockSize);
+    }
+}
+
+static
+VOID
+NvmeSetCoalescing(
+    _In_ PNVME_DEVICE_EXTENSION DevExt)
+{
+    NVME_COMMAND Command;
+
+    if (DevExt->CoalesceThreshold == 0)
+        return;
+
+    /*
+     * Aggregate up to the threshold, but never hold a completion back
+     * for more than 100us, so a lone request is not stalled for long.
+     */
+    RtlZeroMemory(&Command, sizeof(Command));
+    Command.Opcode = NVME_ADMIN_SET_FEATURES;
+    Command.Cdw10 = NVME_FEATURE_INTERRUPT_COALESCING;
+    Command.Cdw11 = (1 << 8) | (DevExt->CoalesceThreshold - 1);
+
+    if (!NvmeAdminCommand(DevExt, &Command))
+        DevExt->CoalesceThreshold = 0;
+}
+
+static
+VOID
+NvmeInitializeCommandIds(
+    _In_ PNVME_DEVICE_EXTENSION DevExt)
+{
+    ULONG i;
+
+    /* A full submission queue is one entry short of its size */
+    DevExt->FreeCommandCount = DevExt->IoSq.Entries - 1;
+    for (i = 0; i < DevExt->FreeCommandCount; i++)
+        DevExt->FreeCommandIds[i] = (USHORT)i;
+}
+
+static
+ULONG
+NTAPI
+NvmeFindAdapter(
+    _In_ PVOID HwDeviceExtension,
+    _In_ PVOID HwContext,
+    _In_ PVOID BusInformation,
+    _In_ PCHAR ArgumentString,
+    _Inout_ PPORT_CONFIGURATION_INFORMATION ConfigInfo,
+    _Out_ PBOOLEAN Again)
+{
+    PNVME_DEVICE_EXTENSION DevExt = HwDeviceExtension;
+    PACCESS_RANGE AccessRange = NULL;
+    ULONGLONG Capabilities, PhysicalAddress;
+    ULONG Entries, MemorySize, Length, NamespaceCount, Coalesce;
+    PUCHAR Memory;
+    ULONG i;
+
+    UNREFERENCED_PARAMETER(HwContext);
+    UNREFERENCED_PARAMETER(BusInformation);
+
+    *Again = FALSE;
+
+    for (i = 0; i < ConfigInfo->NumberOfAccessRanges; i++)
+    {
+        AccessRange = &(*ConfigInfo->AccessRanges)[i];
+
+        if (AccessRange->RangeInMemory && AccessRange->RangeLength > NVME_REG_DOORBELL)
+            break;
+
+        AccessRange = NULL;
+    }
+
+    if (!AccessRange)
+    {
+        DPRINT1("No register BAR\n");
+        return SP_RETURN_NOT_FOUND;
+    }
+
+    DevExt->Registers = ScsiPortGetDeviceBase(DevExt,
+                                              ConfigInfo->AdapterInterfaceType,
+                                              ConfigInfo->SystemIoBusNumber,
+                                              AccessRange->RangeStart,
+                                              AccessRange->RangeLength,
+                                              FALSE);
+    if (!DevExt->Registers)
+    {
+        DPRINT1("Cannot map the registers\n");
+        return SP_RETURN_ERROR;
+    }
+
+    Capabilities = NvmeReadRegister64(DevExt, NVME_REG_CAP);
+
+    if (!NVME_CAP_CSS_NVM(Capabilities) || NVME_CAP_MPSMIN(Capabilities) != 0)
+    {
+        DPRINT1("Unsupported controller, CAP %I64x\n", Capabilities);
+        return SP_RETURN_NOT_FOUND;
+    }
+
+    DevExt->DoorbellStride = sizeof(ULONG) << NVME_CAP_DSTRD(Capabilities);
+    DevExt->ReadyTimeout = max(NVME_CAP_TO(Capabilities), 1) * 500;
+
+    /* MQES is zero based */
+    Entries = NVME_CAP_MQES(Capabilities) + 1;
+    DevExt->AdminSq.Entries = (USHORT)min(Entries, NVME_ADMIN_QUEUE_ENTRIES);
+    DevExt->AdminCq.Entries = DevExt->AdminSq.Entries;
+    DevExt->IoSq.Entries = (USHORT)min(Entries, NVME_IO_QUEUE_ENTRIES);
+    DevExt->IoCq.Entries = DevExt->IoSq.Entries;
+
+    Coalesce = NvmeParseArgument(ArgumentString, "Coalesce");
+    DevExt->CoalesceThreshold = (UCHAR)min(Coalesce, MAXUCHAR);
+
+    ConfigInfo->NumberOfBuses = 1;
+    ConfigInfo->MaximumNumberOfTargets = 2;
+    ConfigInfo->MaximumNumberOfLogicalUnits = NVME_MAX_NAMESPACES;
+    ConfigInfo->InitiatorBusId[0] = 1;
+    ConfigInfo->MaximumTransferLength = NVME_MAX_TRANSFER_LENGTH;
+    ConfigInfo->NumberOfPhysicalBreaks = NVME_MAX_TRANSFER_LENGTH / PAGE_SIZE;
+    ConfigInfo->AlignmentMask = sizeof(ULONG) - 1;
+    ConfigInfo->ScatterGather = TRUE;
+    ConfigInfo->Master = TRUE;
+    ConfigInfo->NeedPhysicalAddresses = TRUE;
+    ConfigInfo->MapBuffers = TRUE;
+    ConfigInfo->Dma32BitAddresses = TRUE;
+    ConfigInfo->TaggedQueuing = TRUE;
+    ConfigInfo->MultipleRequestPerLu = TRUE;
+    ConfigInfo->AutoRequestSense = TRUE;
+    ConfigInfo->InterruptMode = LevelSensitive;
+
+    MemorySize = ROUND_TO_PAGES(DevExt->AdminSq.Entries * sizeof(NVME_COMMAND)) +
+                 ROUND_TO_PAGES(DevExt->AdminCq.Entries * sizeof(NVME_COMPLETION)) +
+                 ROUND_TO_PAGES(DevExt->IoSq.Entries * sizeof(NVME_COMMAND)) +
+                 ROUND_TO_PAGES(DevExt->IoCq.Entries * sizeof(NVME_COMPLETION)) +
+                 PAGE_SIZE +
+                 ROUND_TO_PAGES(DevExt->IoSq.Entries * NVME_PRP_LIST_SIZE);
+
+    /* Being a multiple of pages, it ends the common buffer on a page */
+    Memory = ScsiPortGetUncachedExtension(DevExt, ConfigInfo, MemorySize);
+    if (!Memory)
+    {
+        DPRINT1("Cannot allocate %lu bytes for the queues\n", MemorySize);
+        return SP_RETURN_ERROR;
+    }
+
+    PhysicalAddress = ScsiPortGetPhysicalAddress(DevExt, NULL, Memory, &Length).QuadPart;
+    if (PhysicalAddress & (PAGE_SIZE - 1))
+    {
+        DPRINT1("Queue memory at %I64x is not page aligned\n", PhysicalAddress);
+        return SP_RETURN_ERROR;
+    }
+
+    DevExt->AdminSq.Commands = NvmeCarveMemory(&Memory,
+                                               &PhysicalAddress,
+                                               DevExt->AdminSq.Entries * sizeof(NVME_COMMAND),
+                                               &DevExt->AdminSq.PhysicalAddress);
+    DevExt->AdminCq.Completions = NvmeCarveMemory(&Memory,
+                                                  &PhysicalAddress,
+                                                  DevExt->AdminCq.Entries * sizeof(NVME_COMPLETION),
+                                                  &DevExt->AdminCq.PhysicalAddress);
+    DevExt->IoSq.Commands = NvmeCarveMemory(&Memory,
+                                            &PhysicalAddress,
+                                            DevExt->IoSq.Entries * sizeof(NVME_COMMAND),
+                                            &DevExt->IoSq.PhysicalAddress);
+    DevExt->IoCq.Completions = NvmeCarveMemory(&Memory,
+                                               &PhysicalAddress,
+                                               DevExt->IoCq.Entries * sizeof(NVME_COMPLETION),
+                                               &DevExt->IoCq.PhysicalAddress);
+    DevExt->Identify = NvmeCarveMemory(&Memory,
+                                       &PhysicalAddress,
+                                       PAGE_SIZE,
+                                       &DevExt->IdentifyPhysicalAddress);
+    DevExt->PrpLists = NvmeCarveMemory(&Memory,
+                                       &PhysicalAddress,
+                                       DevExt->IoSq.Entries * NVME_PRP_LIST_SIZE,
+                                       &DevExt->PrpListsPhysicalAddress);
+
+    if (!NvmeEnableController(DevExt) ||
+        !NvmeIdentifyController(DevExt, &NamespaceCount) ||
+        !NvmeCreateIoQueues(DevExt))
+    {
+        goto Failed;
+    }
+
+    NvmeIdentifyNamespaces(DevExt, NamespaceCount);
+    NvmeSetCoalescing(DevExt);
+
+    ConfigInfo->MaximumTransferLength = DevExt->MaxTransferLength;
+    ConfigInfo->NumberOfPhysicalBreaks = DevExt->MaxTransferLength / PAGE_SIZE;
+    ConfigInfo->CachesData = !!(DevExt->VolatileWriteCache & NVME_VWC_PRESENT);
+
+    NvmeInitializeCommandIds(DevExt);
+
+    return SP_RETURN_FOUND;
+
+Failed:
+    NvmeWriteRegister(DevExt, NVME_REG_CC, 0);
+    return SP_RETURN_ERROR;
+}
+
+static
+BOOLEAN
+NTAPI
+NvmeInitialize(
+    _In_ PVOID HwDeviceExtension)
+{
+    PNVME_DEVICE_EXTENSION DevExt = HwDeviceExtension;
+
+    NvmeWriteRegister(DevExt, NVME_REG_INTMC, 1);
+
+    return TRUE;
+}
+
+BOOLEAN
+NTAPI
+NvmeAllocateCommandId(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _Out_ PUSHORT CommandId)
+{
+    if (DevExt->FreeCommandCount == 0)
+        return FALSE;
+
+    *CommandId = DevExt->FreeCommandIds[--DevExt->FreeCommandCount];
+    DevExt->Requests[*CommandId] = Srb;
+
+    return TRUE;
+}
+
+VOID
+NTAPI
+NvmeFreeCommandId(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ USHORT CommandId)
+{
+    DevExt->Requests[CommandId] = NULL;
+    DevExt->FreeCommandIds[DevExt->FreeCommandCount++] = CommandId;
+}
+
+VOID
+NTAPI
+NvmeSubmitIo(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PNVME_COMMAND Command)
+{
+    PNVME_SUBMISSION_QUEUE Sq = &DevExt->IoSq;
+
+    RtlCopyMemory(&Sq->Commands[Sq->Tail], Command, sizeof(*Command));
+
+    if (++Sq->Tail == Sq->Entries)
+        Sq->Tail = 0;
+
+    ScsiPortWriteRegisterUlong(Sq->Doorbell, Sq->Tail);
+}
+
+/*
+ * Ask for the next request only while a command slot is free,
+ * otherwise the interrupt handler does it once one comes back.
+ */
+static
+VOID
+NvmeRequestNext(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ UCHAR Lun)
+{
+    if (DevExt->FreeCommandCount != 0)
+        ScsiPortNotification(NextLuRequest, DevExt, 0, 0, Lun);
+    else
+        DevExt->WaitingLuns |= 1 << Lun;
+}
+
+static
+VOID
+NvmeRequestWaiting(
+    _In_ PNVME_DEVICE_EXTENSION DevExt)
+{
+    UCHAR Lun;
+
+    for (Lun = 0; DevExt->WaitingLuns != 0; Lun++)
+    {
+        if (DevExt->WaitingLuns & (1 << Lun))
+        {
+            DevExt->WaitingLuns &= ~(1 << Lun);
+            ScsiPortNotification(NextLuRequest, DevExt, 0, 0, Lun);
+        }
+    }
+}
+
+static
+VOID
+NvmeCompleteRequest(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _In_ USHORT Status)
+{
+    UCHAR StatusCodeType = NVME_CQE_SCT(Status);
+    UCHAR StatusCode = NVME_CQE_SC(Status);
+
+    if (StatusCodeType == NVME_SCT_GENERIC && StatusCode == NVME_SC_SUCCESS)
+    {
+        Srb->SrbStatus = SRB_STATUS_SUCCESS;
+        Srb->ScsiStatus = SCSISTAT_GOOD;
+    }
+    else if (StatusCodeType == NVME_SCT_GENERIC && StatusCode == NVME_SC_LBA_RANGE)
+    {
+        NvmeSetSense(Srb,
+                     SRB_STATUS_ERROR,
+                     SCSI_SENSE_ILLEGAL_REQUEST,
+                     SCSI_ADSENSE_ILLEGAL_BLOCK);
+    }
+    else if (StatusCodeType == NVME_SCT_GENERIC &&
+             (StatusCode == NVME_SC_INVALID_OPCODE || StatusCode == NVME_SC_INVALID_FIELD))
+    {
+        NvmeSetSense(Srb,
+                     SRB_STATUS_ERROR,
+                     SCSI_SENSE_ILLEGAL_REQUEST,
+                     SCSI_ADSENSE_ILLEGAL_COMMAND);
+    }
+    else
+    {
+        DPRINT1("Request %p failed with %04x\n", Srb, Status);
+        NvmeSetSense(Srb,
+                     SRB_STATUS_ERROR,
+                     StatusCodeType == NVME_SCT_MEDIA ? SCSI_SENSE_MEDIUM_ERROR
+                                                      : SCSI_SENSE_HARDWARE_ERROR,
+                     SCSI_ADSENSE_NO_SENSE);
+    }
+
+    ScsiPortNotification(RequestComplete, DevExt, Srb);
+}
+
+static
+BOOLEAN
+NTAPI
+NvmeInterrupt(
+    _In_ PVOID HwDeviceExtension)
+{
+    PNVME_DEVICE_EXTENSION DevExt = HwDeviceExtension;
+    PNVME_COMPLETION_QUEUE Cq = &DevExt->IoCq;
+    PNVME_COMPLETION Completion;
+    PSCSI_REQUEST_BLOCK Srb;
+    USHORT CommandId, Status;
+
+    /* The line may be shared, nothing new at the head means it was not us */
+    Completion = &Cq->Completions[Cq->Head];
+    if ((Completion->Status & NVME_CQE_PHASE) != Cq->Phase)
+        return FALSE;
+
+    /*
+     * Take everything the controller has posted and hand the entries
+     * back with a single doorbell write, which also drops the line.
+     */
+    do
+    {
+        CommandId = Completion->CommandId;
+        Status = Completion->Status;
+
+        NvmeAdvanceCompletionQueue(Cq);
+
+        if (CommandId < RTL_NUMBER_OF(DevExt->Requests) && DevExt->Requests[CommandId])
+        {
+            Srb = DevExt->Requests[CommandId];
+            NvmeFreeCommandId(DevExt, CommandId);
+            NvmeCompleteRequest(DevExt, Srb, Status);
+        }
+        else
+        {
+            DPRINT1("Completion for unknown command %u\n", CommandId);
+        }
+
+        Completion = &Cq->Completions[Cq->Head];
+    } while ((Completion->Status & NVME_CQE_PHASE) == Cq->Phase);
+
+    ScsiPortWriteRegisterUlong(Cq->Doorbell, Cq->Head);
+
+    NvmeRequestWaiting(DevExt);
+
+    return TRUE;
+}
+
+/*
+ * Disabling the controller drops every command it holds, so the requests
+ * they belong to are completed with a bus reset status for the class
+ * driver to send again, and the queues are set up from scratch.
+ */
+static
+BOOLEAN
+NvmeResetController(
+    _In_ PNVME_DEVICE_EXTENSION DevExt)
+{
+    PSCSI_REQUEST_BLOCK Srb;
+    ULONG i;
+
+    DPRINT1("Resetting the controller\n");
+
+    for (i = 0; i < RTL_NUMBER_OF(DevExt->Requests); i++)
+    {
+        Srb = DevExt->Requests[i];
+        if (!Srb)
+            continue;
+
+        DevExt->Requests[i] = NULL;
+        Srb->SrbStatus = SRB_STATUS_BUS_RESET;
+        ScsiPortNotification(RequestComplete, DevExt, Srb);
+    }
+
+    NvmeInitializeCommandIds(DevExt);
+
+    if (!NvmeEnableController(DevExt) || !NvmeCreateIoQueues(DevExt))
+    {
+        DPRINT1("Controller did not come back from the reset\n");
+        NvmeWriteRegister(DevExt, NVME_REG_CC, 0);
+        return FALSE;
+    }
+
+    NvmeSetCoalescing(DevExt);
+    NvmeWriteRegister(DevExt, NVME_REG_INTMC, 1);
+
+    NvmeRequestWaiting(DevExt);
+
+    return TRUE;
+}
+
+static
+BOOLEAN
+NTAPI
+NvmeStartIo(
+    _In_ PVOID HwDeviceExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PNVME_DEVICE_EXTENSION DevExt = HwDeviceExtension;
+    UCHAR Lun = Srb->Lun;
+    BOOLEAN Pending = FALSE;
+
+    if (Srb->PathId != 0 || Srb->TargetId != 0 ||
+        Lun >= NVME_MAX_NAMESPACES || !DevExt->Namespaces[Lun].Active)
+    {
+        Srb->SrbStatus = SRB_STATUS_SELECTION_TIMEOUT;
+        ScsiPortNotification(RequestComplete, DevExt, Srb);
+        ScsiPortNotification(NextRequest, DevExt);
+        return TRUE;
+    }
+
+    switch (Srb->Function)
+    {
+        case SRB_FUNCTION_EXECUTE_SCSI:
+            Pending = NvmeExecuteScsi(DevExt, Srb);
+            break;
+
+        case SRB_FUNCTION_FLUSH:
+        case SRB_FUNCTION_SHUTDOWN:
+            Pending = NvmeFlush(DevExt, Srb);
+            break;
+
+        case SRB_FUNCTION_RESET_BUS:
+        case SRB_FUNCTION_RESET_DEVICE:
+        case SRB_FUNCTION_RESET_LOGICAL_UNIT:
+            Srb->SrbStatus = NvmeResetController(DevExt) ? SRB_STATUS_SUCCESS
+                                                         : SRB_STATUS_ERROR;
+            break;
+
+        case SRB_FUNCTION_ABORT_COMMAND:
+            Srb->SrbStatus = SRB_STATUS_ABORT_FAILED;
+            break;
+
+        default:
+            Srb->SrbStatus = SRB_STATUS_INVALID_REQUEST;
+            break;
+    }
+
+    if (!Pending)
+        ScsiPortNotification(RequestComplete, DevExt, Srb);
+
+    NvmeRequestNext(DevExt, Lun);
+
+    return TRUE;
+}
+
+static
+BOOLEAN
+NTAPI
+NvmeResetBus(
+    _In_ PVOID HwDeviceExtension,
+    _In_ ULONG PathId)
+{
+    PNVME_DEVICE_EXTENSION DevExt = HwDeviceExtension;
+    BOOLEAN Result;
+
+    UNREFERENCED_PARAMETER(PathId);
+
+    /* There is no bus, so reset the controller behind it */
+    Result = NvmeResetController(DevExt);
+    ScsiPortNotification(NextRequest, DevExt);
+
+    return Result;
+}
+
+static
+ULONG
+NvmeInitializeForDevice(
+    _In_ PVOID DriverObject,
+    _In_ PVOID Argument2,
+    _In_ const NVME_PCI_ID *PciId)
+{
+    HW_INITIALIZATION_DATA HwInitializationData;
+
+    RtlZeroMemory(&HwInitializationData, sizeof(HwInitializationData));
+
+    HwInitializationData.HwInitializationDataSize = sizeof(HW_INITIALIZATION_DATA);
+    HwInitializationData.AdapterInterfaceType = PCIBus;
+
+    HwInitializationData.HwInitialize = NvmeInitialize;
+    HwInitializationData.HwStartIo = NvmeStartIo;
+    HwInitializationData.HwInterrupt = NvmeInterrupt;
+    HwInitializationData.HwFindAdapter = NvmeFindAdapter;
+    HwInitializationData.HwResetBus = NvmeResetBus;
+
+    HwInitializationData.DeviceExtensionSize = sizeof(NVME_DEVICE_EXTENSION);
+    HwInitializationData.NumberOfAccessRanges = PCI_TYPE0_ADDRESSES;
+
+    HwInitializationData.NeedPhysicalAddresses = TRUE;
+    HwInitializationData.MapBuffers = TRUE;
+    HwInitializationData.AutoRequestSense = TRUE;
+    HwInitializationData.TaggedQueuing = TRUE;
+    HwInitializationData.MultipleRequestPerLu = TRUE;
+
+    HwInitializationData.VendorId = (PVOID)PciId->VendorId;
+    HwInitializationData.VendorIdLength = 4;
+    HwInitializationData.DeviceId = (PVOID)PciId->DeviceId;
+    HwInitializationData.DeviceIdLength = 4;
+
+    return ScsiPortInitialize(DriverObject, Argument2, &HwInitializationData, NULL);
+}
+
+ULONG
+NTAPI
+DriverEntry(
+    _In_ PVOID DriverObject,
+    _In_ PVOID Argument2)
+{
+    ULONG Status, Result = STATUS_NO_SUCH_DEVICE;
+    ULONG i;
+
+    DPRINT("DriverEntry(%p %p)\n", DriverObject, Argument2);
+
+    for (i = 0; i < RTL_NUMBER_OF(NvmePciIds); i++)
+    {
+        Status = NvmeInitializeForDevice(DriverObject, Argument2, &NvmePciIds[i]);
+        if (NT_SUCCESS(Status))
+            Result = Status;
+    }
+
+    return Result;
+}
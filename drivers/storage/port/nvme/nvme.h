@@ -0,0 +1,294 @@
+/*
+ * PROJECT:     ReactOS NVMe Miniport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     NVMe declarations
+ */
+
+#ifndef _NVME_PCH_
+#define _NVME_PCH_
+
+#include <ntddk.h>
+#include <srb.h>
+#include <scsi.h>
+
+/* Controller registers */
+#define NVME_REG_CAP                0x00
+#define NVME_REG_VS                 0x08
+#define NVME_REG_INTMS              0x0C
+#define NVME_REG_INTMC              0x10
+#define NVME_REG_CC                 0x14
+#define NVME_REG_CSTS               0x1C
+#define NVME_REG_AQA                0x24
+#define NVME_REG_ASQ                0x28
+#define NVME_REG_ACQ                0x30
+#define NVME_REG_DOORBELL           0x1000
+
+#define NVME_CAP_MQES(Cap)          ((ULONG)((Cap) & 0xFFFF))
+#define NVME_CAP_TO(Cap)            ((ULONG)(((Cap) >> 24) & 0xFF))
+#define NVME_CAP_DSTRD(Cap)         ((ULONG)(((Cap) >> 32) & 0xF))
+#define NVME_CAP_CSS_NVM(Cap)       ((BOOLEAN)(((Cap) >> 37) & 1))
+#define NVME_CAP_MPSMIN(Cap)        ((ULONG)(((Cap) >> 48) & 0xF))
+
+#define NVME_CC_ENABLE              0x00000001
+#define NVME_CC_IOSQES(Shift)       ((ULONG)(Shift) << 16)
+#define NVME_CC_IOCQES(Shift)       ((ULONG)(Shift) << 20)
+
+#define NVME_CSTS_READY             0x00000001
+#define NVME_CSTS_FATAL             0x00000002
+
+/* Admin commands */
+#define NVME_ADMIN_CREATE_SQ        0x01
+#define NVME_ADMIN_CREATE_CQ        0x05
+#define NVME_ADMIN_IDENTIFY         0x06
+#define NVME_ADMIN_SET_FEATURES     0x09
+
+#define NVME_IDENTIFY_NAMESPACE     0
+#define NVME_IDENTIFY_CONTROLLER    1
+
+#define NVME_FEATURE_NUMBER_OF_QUEUES       0x07
+#define NVME_FEATURE_INTERRUPT_COALESCING   0x08
+
+#define NVME_QUEUE_PHYS_CONTIG      0x0001
+#define NVME_CQ_IRQ_ENABLED         0x0002
+
+/* NVM commands */
+#define NVME_CMD_FLUSH              0x00
+#define NVME_CMD_WRITE              0x01
+#define NVME_CMD_READ               0x02
+#define NVME_CMD_WRITE_ZEROES       0x08
+#define NVME_CMD_DSM                0x09
+
+#define NVME_RW_FUA                 0x40000000
+#define NVME_WRITE_ZEROES_DEALLOCATE 0x02000000
+#define NVME_DSM_DEALLOCATE         0x00000004
+
+/* Optional NVM command support reported by the controller */
+#define NVME_ONCS_DSM               0x0004
+#define NVME_ONCS_WRITE_ZEROES      0x0008
+
+#define NVME_VWC_PRESENT            0x01
+
+/* Completion status, the phase tag is bit 0 */
+#define NVME_CQE_PHASE              0x0001
+#define NVME_CQE_SC(Status)         (((Status) >> 1) & 0xFF)
+#define NVME_CQE_SCT(Status)        (((Status) >> 9) & 0x7)
+
+#define NVME_SCT_GENERIC            0
+#define NVME_SCT_MEDIA              2
+
+#define NVME_SC_SUCCESS             0x00
+#define NVME_SC_INVALID_OPCODE      0x01
+#define NVME_SC_INVALID_FIELD       0x02
+#define NVME_SC_LBA_RANGE           0x80
+
+typedef struct _NVME_COMMAND
+{
+    UCHAR Opcode;
+    UCHAR Flags;
+    USHORT CommandId;
+    ULONG NamespaceId;
+    ULONG Reserved[2];
+    ULONGLONG Metadata;
+    ULONGLONG Prp1;
+    ULONGLONG Prp2;
+    ULONG Cdw10;
+    ULONG Cdw11;
+    ULONG Cdw12;
+    ULONG Cdw13;
+    ULONG Cdw14;
+    ULONG Cdw15;
+} NVME_COMMAND, *PNVME_COMMAND;
+
+C_ASSERT(sizeof(NVME_COMMAND) == 64);
+
+typedef struct _NVME_COMPLETION
+{
+    ULONG Result;
+    ULONG Reserved;
+    USHORT SqHead;
+    USHORT SqId;
+    USHORT CommandId;
+    USHORT Status;
+} NVME_COMPLETION, *PNVME_COMPLETION;
+
+C_ASSERT(sizeof(NVME_COMPLETION) == 16);
+
+/* log2 of the entry sizes, as CC wants them */
+#define NVME_SQ_ENTRY_SHIFT         6
+#define NVME_CQ_ENTRY_SHIFT         4
+
+typedef struct _NVME_DSM_RANGE
+{
+    ULONG Attributes;
+    ULONG Length;
+    ULONGLONG StartingLba;
+} NVME_DSM_RANGE, *PNVME_DSM_RANGE;
+
+#include <pshpack1.h>
+typedef struct _NVME_IDENTIFY_CONTROLLER
+{
+    USHORT VendorId;
+    USHORT SubsystemVendorId;
+    UCHAR SerialNumber[20];
+    UCHAR ModelNumber[40];
+    UCHAR FirmwareRevision[8];
+    UCHAR RecommendedArbitrationBurst;
+    UCHAR Ieee[3];
+    UCHAR Cmic;
+    UCHAR MaximumDataTransferSize;
+    UCHAR Reserved0[438];
+    ULONG NumberOfNamespaces;
+    USHORT OptionalNvmCommands;
+    USHORT FusedOperations;
+    UCHAR FormatNvmAttributes;
+    UCHAR VolatileWriteCache;
+    UCHAR Reserved1[3570];
+} NVME_IDENTIFY_CONTROLLER, *PNVME_IDENTIFY_CONTROLLER;
+
+typedef struct _NVME_IDENTIFY_NAMESPACE
+{
+    ULONGLONG Size;
+    ULONGLONG Capacity;
+    ULONGLONG Utilization;
+    UCHAR Features;
+    UCHAR NumberOfLbaFormats;
+    UCHAR FormattedLbaSize;
+    UCHAR Reserved0[101];
+    ULONG LbaFormat[16];
+    UCHAR Reserved1[3904];
+} NVME_IDENTIFY_NAMESPACE, *PNVME_IDENTIFY_NAMESPACE;
+#include <poppack.h>
+
+C_ASSERT(FIELD_OFFSET(NVME_IDENTIFY_CONTROLLER, MaximumDataTransferSize) == 77);
+C_ASSERT(FIELD_OFFSET(NVME_IDENTIFY_CONTROLLER, NumberOfNamespaces) == 516);
+C_ASSERT(FIELD_OFFSET(NVME_IDENTIFY_CONTROLLER, VolatileWriteCache) == 525);
+C_ASSERT(sizeof(NVME_IDENTIFY_CONTROLLER) == 4096);
+C_ASSERT(FIELD_OFFSET(NVME_IDENTIFY_NAMESPACE, LbaFormat) == 128);
+C_ASSERT(sizeof(NVME_IDENTIFY_NAMESPACE) == 4096);
+
+#define NVME_NS_FEATURE_THIN        0x01
+#define NVME_LBAF_INDEX(Flbas)      ((Flbas) & 0x0F)
+#define NVME_LBAF_MS(Format)        ((Format) & 0xFFFF)
+#define NVME_LBAF_LBADS(Format)     (((Format) >> 16) & 0xFF)
+
+#define NVME_ADMIN_QUEUE_ENTRIES    32
+#define NVME_IO_QUEUE_ENTRIES       128
+
+/*
+ * Every command slot owns a PRP list that never crosses a page, which
+ * bounds a transfer to 32 pages whatever the alignment of the buffer.
+ * DSM commands reuse the same slot for their range list.
+ */
+#define NVME_PRP_LIST_ENTRIES       32
+#define NVME_PRP_LIST_SIZE          (NVME_PRP_LIST_ENTRIES * sizeof(ULONGLONG))
+#define NVME_MAX_TRANSFER_LENGTH    (NVME_PRP_LIST_ENTRIES * PAGE_SIZE)
+#define NVME_MAX_DSM_RANGES         (NVME_PRP_LIST_SIZE / sizeof(NVME_DSM_RANGE))
+
+/* Namespaces 1 to 8 show up as logical units 0 to 7 */
+#define NVME_MAX_NAMESPACES         8
+
+typedef struct _NVME_SUBMISSION_QUEUE
+{
+    PNVME_COMMAND Commands;
+    ULONGLONG PhysicalAddress;
+    PULONG Doorbell;
+    USHORT Entries;
+    USHORT Tail;
+} NVME_SUBMISSION_QUEUE, *PNVME_SUBMISSION_QUEUE;
+
+typedef struct _NVME_COMPLETION_QUEUE
+{
+    PNVME_COMPLETION Completions;
+    ULONGLONG PhysicalAddress;
+    PULONG Doorbell;
+    USHORT Entries;
+    USHORT Head;
+    USHORT Phase;
+} NVME_COMPLETION_QUEUE, *PNVME_COMPLETION_QUEUE;
+
+typedef struct _NVME_NAMESPACE
+{
+    BOOLEAN Active;
+    BOOLEAN Thin;
+    ULONG BlockSize;
+    ULONG BlockShift;
+    ULONGLONG LastLba;
+} NVME_NAMESPACE, *PNVME_NAMESPACE;
+
+typedef struct _NVME_DEVICE_EXTENSION
+{
+    PUCHAR Registers;
+    ULONG DoorbellStride;
+    ULONG ReadyTimeout;
+
+    NVME_SUBMISSION_QUEUE AdminSq;
+    NVME_COMPLETION_QUEUE AdminCq;
+    NVME_SUBMISSION_QUEUE IoSq;
+    NVME_COMPLETION_QUEUE IoCq;
+
+    PVOID Identify;
+    ULONGLONG IdentifyPhysicalAddress;
+    PULONGLONG PrpLists;
+    ULONGLONG PrpListsPhysicalAddress;
+
+    /* Command identifiers double as indexes into these */
+    PSCSI_REQUEST_BLOCK Requests[NVME_IO_QUEUE_ENTRIES];
+    USHORT FreeCommandIds[NVME_IO_QUEUE_ENTRIES];
+    ULONG FreeCommandCount;
+
+    /* Logical units told to hold off until a command slot frees up */
+    ULONG WaitingLuns;
+
+    ULONG MaxTransferLength;
+    USHORT OptionalNvmCommands;
+    UCHAR VolatileWriteCache;
+    UCHAR CoalesceThreshold;
+    UCHAR SerialNumber[20];
+    UCHAR ModelNumber[40];
+    UCHAR FirmwareRevision[8];
+
+    NVME_NAMESPACE Namespaces[NVME_MAX_NAMESPACES];
+} NVME_DEVICE_EXTENSION, *PNVME_DEVICE_EXTENSION;
+
+/* nvme.c */
+BOOLEAN
+NTAPI
+NvmeAllocateCommandId(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _Out_ PUSHORT CommandId);
+
+VOID
+NTAPI
+NvmeFreeCommandId(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ USHORT CommandId);
+
+VOID
+NTAPI
+NvmeSubmitIo(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PNVME_COMMAND Command);
+
+/* scsi.c */
+VOID
+NTAPI
+NvmeSetSense(
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _In_ UCHAR SrbStatus,
+    _In_ UCHAR SenseKey,
+    _In_ UCHAR AdditionalSenseCode);
+
+BOOLEAN
+NTAPI
+NvmeExecuteScsi(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb);
+
+BOOLEAN
+NTAPI
+NvmeFlush(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb);
+
+#endif /* _NVME_PCH_ */
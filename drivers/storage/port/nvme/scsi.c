@@ -0,0 +1,741 @@
+/*
+ * PROJECT:     ReactOS NVMe Miniport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Translation of SCSI commands into NVM commands
+ */
+
+#include "nvme.h"
+
+#define NDEBUG
+#include <debug.h>
+
+#define NVME_CDB_FUA                0x08
+#define NVME_WRITE_SAME_UNMAP       0x08
+
+/* Write Zeroes carries a 16-bit zero based block count */
+#define NVME_MAX_WRITE_ZEROES_BLOCKS    0x10000
+
+VOID
+NTAPI
+NvmeSetSense(
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _In_ UCHAR SrbStatus,
+    _In_ UCHAR SenseKey,
+    _In_ UCHAR AdditionalSenseCode)
+{
+    PSENSE_DATA SenseData = Srb->SenseInfoBuffer;
+
+    Srb->SrbStatus = SrbStatus;
+    Srb->ScsiStatus = SCSISTAT_CHECK_CONDITION;
+
+    if (!SenseData ||
+        (Srb->SrbFlags & SRB_FLAGS_DISABLE_AUTOSENSE) ||
+        Srb->SenseInfoBufferLength < RTL_SIZEOF_THROUGH_FIELD(SENSE_DATA, AdditionalSenseCodeQualifier))
+    {
+        return;
+    }
+
+    RtlZeroMemory(SenseData, min(Srb->SenseInfoBufferLength, sizeof(SENSE_DATA)));
+
+    SenseData->ErrorCode = SCSI_SENSE_ERRORCODE_FIXED_CURRENT;
+    SenseData->SenseKey = SenseKey;
+    SenseData->AdditionalSenseLength = sizeof(SENSE_DATA) -
+                                       RTL_SIZEOF_THROUGH_FIELD(SENSE_DATA, AdditionalSenseLength);
+    SenseData->AdditionalSenseCode = AdditionalSenseCode;
+
+    Srb->SrbStatus |= SRB_STATUS_AUTOSENSE_VALID;
+}
+
+static
+VOID
+NvmeSetInvalidCdb(
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    NvmeSetSense(Srb,
+                 SRB_STATUS_ERROR,
+                 SCSI_SENSE_ILLEGAL_REQUEST,
+                 SCSI_ADSENSE_INVALID_CDB);
+}
+
+static
+VOID
+NvmeSetIllegalCommand(
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    NvmeSetSense(Srb,
+                 SRB_STATUS_ERROR,
+                 SCSI_SENSE_ILLEGAL_REQUEST,
+                 SCSI_ADSENSE_ILLEGAL_COMMAND);
+}
+
+static
+VOID
+NvmeReturnData(
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _In_reads_bytes_(Length) PVOID Data,
+    _In_ ULONG Length)
+{
+    Length = min(Length, Srb->DataTransferLength);
+
+    RtlCopyMemory(Srb->DataBuffer, Data, Length);
+
+    Srb->DataTransferLength = Length;
+    Srb->SrbStatus = SRB_STATUS_SUCCESS;
+}
+
+static
+BOOLEAN
+NvmeIsBlockRangeValid(
+    _In_ PNVME_NAMESPACE Namespace,
+    _In_ ULONGLONG Lba,
+    _In_ ULONGLONG Blocks)
+{
+    return (Lba <= Namespace->LastLba) && (Blocks <= Namespace->LastLba - Lba + 1);
+}
+
+static
+BOOLEAN
+NvmeQueueCommand(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _In_ PNVME_COMMAND Command)
+{
+    Command->NamespaceId = Srb->Lun + 1;
+
+    NvmeSubmitIo(DevExt, Command);
+
+    Srb->SrbStatus = SRB_STATUS_PENDING;
+    return TRUE;
+}
+
+/*
+ * The first entry may start anywhere in a page, every following one
+ * covers a whole page. Two entries fit in the command itself, beyond
+ * that the second pointer refers to the list of the command slot.
+ */
+static
+BOOLEAN
+NvmeBuildPrps(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _In_ ULONG TransferLength,
+    _Inout_ PNVME_COMMAND Command)
+{
+    PULONGLONG PrpList = &DevExt->PrpLists[Command->CommandId * NVME_PRP_LIST_ENTRIES];
+    PUCHAR DataBuffer = Srb->DataBuffer;
+    ULONGLONG Address;
+    ULONG Remaining = TransferLength;
+    ULONG Count = 0;
+    ULONG Length, Chunk;
+
+    while (Remaining != 0)
+    {
+        Address = ScsiPortGetPhysicalAddress(DevExt, Srb, DataBuffer, &Length).QuadPart;
+        if (Length == 0)
+            return FALSE;
+
+        Length = min(Length, Remaining);
+        DataBuffer += Length;
+        Remaining -= Length;
+
+        while (Length != 0)
+        {
+            Chunk = min(PAGE_SIZE - (ULONG)(Address & (PAGE_SIZE - 1)), Length);
+
+            if (Count == 0)
+            {
+                Command->Prp1 = Address;
+            }
+            else
+            {
+                if (Count > NVME_PRP_LIST_ENTRIES)
+                    return FALSE;
+
+                PrpList[Count - 1] = Address;
+            }
+
+            Count++;
+            Address += Chunk;
+            Length -= Chunk;
+        }
+    }
+
+    if (Count == 2)
+    {
+        Command->Prp2 = PrpList[0];
+    }
+    else if (Count > 2)
+    {
+        Command->Prp2 = DevExt->PrpListsPhysicalAddress +
+                        Command->CommandId * NVME_PRP_LIST_SIZE;
+    }
+
+    return TRUE;
+}
+
+static
+BOOLEAN
+NvmeReadWrite(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _In_ ULONGLONG Lba,
+    _In_ ULONG Blocks,
+    _In_ BOOLEAN IsWrite,
+    _In_ BOOLEAN ForceUnitAccess)
+{
+    PNVME_NAMESPACE Namespace = &DevExt->Namespaces[Srb->Lun];
+    NVME_COMMAND Command;
+    ULONG TransferLength;
+
+    if (!NvmeIsBlockRangeValid(Namespace, Lba, Blocks))
+    {
+        NvmeSetSense(Srb,
+                     SRB_STATUS_ERROR,
+                     SCSI_SENSE_ILLEGAL_REQUEST,
+                     SCSI_ADSENSE_ILLEGAL_BLOCK);
+        return FALSE;
+    }
+
+    if (Blocks == 0)
+    {
+        Srb->DataTransferLength = 0;
+        Srb->SrbStatus = SRB_STATUS_SUCCESS;
+        return FALSE;
+    }
+
+    /* The controller moves exactly that many blocks, never more than fits */
+    if (Blocks > (DevExt->MaxTransferLength >> Namespace->BlockShift) ||
+        Srb->DataTransferLength < (Blocks << Namespace->BlockShift))
+    {
+        NvmeSetInvalidCdb(Srb);
+        return FALSE;
+    }
+
+    TransferLength = Blocks << Namespace->BlockShift;
+
+    RtlZeroMemory(&Command, sizeof(Command));
+
+    if (!NvmeAllocateCommandId(DevExt, Srb, &Command.CommandId))
+    {
+        Srb->SrbStatus = SRB_STATUS_BUSY;
+        return FALSE;
+    }
+
+    if (!NvmeBuildPrps(DevExt, Srb, TransferLength, &Command))
+    {
+        DPRINT1("Cannot describe %lu bytes at %p\n", TransferLength, Srb->DataBuffer);
+        NvmeFreeCommandId(DevExt, Command.CommandId);
+        Srb->SrbStatus = SRB_STATUS_INVALID_REQUEST;
+        return FALSE;
+    }
+
+    Command.Opcode = IsWrite ? NVME_CMD_WRITE : NVME_CMD_READ;
+    Command.Cdw10 = (ULONG)Lba;
+    Command.Cdw11 = (ULONG)(Lba >> 32);
+    Command.Cdw12 = Blocks - 1;
+
+    if (ForceUnitAccess)
+        Command.Cdw12 |= NVME_RW_FUA;
+
+    Srb->DataTransferLength = TransferLength;
+
+    return NvmeQueueCommand(DevExt, Srb, &Command);
+}
+
+static
+BOOLEAN
+NvmeUnmap(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PNVME_NAMESPACE Namespace = &DevExt->Namespaces[Srb->Lun];
+    PUNMAP_LIST_HEADER ListHeader = Srb->DataBuffer;
+    PUNMAP_BLOCK_DESCRIPTOR Descriptor;
+    PNVME_DSM_RANGE Ranges;
+    NVME_COMMAND Command;
+    ULONGLONG Lba;
+    ULONG Blocks, DescriptorCount, RangeCount = 0, i;
+    USHORT DescriptorLength;
+
+    if (!(DevExt->OptionalNvmCommands & NVME_ONCS_DSM))
+    {
+        NvmeSetIllegalCommand(Srb);
+        return FALSE;
+    }
+
+    if (Srb->DataTransferLength < sizeof(UNMAP_LIST_HEADER))
+    {
+        Srb->SrbStatus = SRB_STATUS_SUCCESS;
+        return FALSE;
+    }
+
+    REVERSE_BYTES_SHORT(&DescriptorLength, ListHeader->BlockDescrDataLength);
+    DescriptorCount = min(DescriptorLength,
+                          Srb->DataTransferLength - sizeof(UNMAP_LIST_HEADER)) /
+                      sizeof(UNMAP_BLOCK_DESCRIPTOR);
+
+    RtlZeroMemory(&Command, sizeof(Command));
+
+    if (!NvmeAllocateCommandId(DevExt, Srb, &Command.CommandId))
+    {
+        Srb->SrbStatus = SRB_STATUS_BUSY;
+        return FALSE;
+    }
+
+    /* The range list goes where the PRP list of the slot would be */
+    Ranges = (PNVME_DSM_RANGE)&DevExt->PrpLists[Command.CommandId * NVME_PRP_LIST_ENTRIES];
+
+    for (i = 0; i < DescriptorCount; i++)
+    {
+        Descriptor = &ListHeader->Descriptors[i];
+
+        REVERSE_BYTES_QUAD(&Lba, Descriptor->StartingLba);
+        REVERSE_BYTES(&Blocks, Descriptor->LbaCount);
+
+        if (Blocks == 0)
+            continue;
+
+        if (RangeCount == NVME_MAX_DSM_RANGES ||
+            !NvmeIsBlockRangeValid(Namespace, Lba, Blocks))
+        {
+            NvmeFreeCommandId(DevExt, Command.CommandId);
+            NvmeSetSense(Srb,
+                         SRB_STATUS_ERROR,
+                         SCSI_SENSE_ILLEGAL_REQUEST,
+                         SCSI_ADSENSE_INVALID_FIELD_PARAMETER_LIST);
+            return FALSE;
+        }
+
+        Ranges[RangeCount].Attributes = 0;
+        Ranges[RangeCount].Length = Blocks;
+        Ranges[RangeCount].StartingLba = Lba;
+        RangeCount++;
+    }
+
+    if (RangeCount == 0)
+    {
+        NvmeFreeCommandId(DevExt, Command.CommandId);
+        Srb->SrbStatus = SRB_STATUS_SUCCESS;
+        return FALSE;
+    }
+
+    Command.Opcode = NVME_CMD_DSM;
+    Command.Prp1 = DevExt->PrpListsPhysicalAddress +
+                   Command.CommandId * NVME_PRP_LIST_SIZE;
+    Command.Cdw10 = RangeCount - 1;
+    Command.Cdw11 = NVME_DSM_DEALLOCATE;
+
+    return NvmeQueueCommand(DevExt, Srb, &Command);
+}
+
+static
+BOOLEAN
+NvmeWriteSame(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PNVME_NAMESPACE Namespace = &DevExt->Namespaces[Srb->Lun];
+    PUCHAR Cdb = Srb->Cdb;
+    NVME_COMMAND Command;
+    ULONGLONG Lba, Blocks;
+    ULONG Lba32, Blocks32;
+    USHORT Blocks16;
+    PULONG Pattern;
+    ULONG i;
+
+    /* Only a block of zeroes can be written this way */
+    if (!(DevExt->OptionalNvmCommands & NVME_ONCS_WRITE_ZEROES))
+    {
+        NvmeSetIllegalCommand(Srb);
+        return FALSE;
+    }
+
+    if (Cdb[0] == SCSIOP_WRITE_SAME16)
+    {
+        REVERSE_BYTES_QUAD(&Lba, &Cdb[2]);
+        REVERSE_BYTES(&Blocks32, &Cdb[10]);
+        Blocks = Blocks32;
+    }
+    else
+    {
+        REVERSE_BYTES(&Lba32, &Cdb[2]);
+        REVERSE_BYTES_SHORT(&Blocks16, &Cdb[7]);
+        Lba = Lba32;
+        Blocks = Blocks16;
+    }
+
+    /* Zero blocks means up to the end of the medium */
+    if (Blocks == 0 && Lba <= Namespace->LastLba)
+        Blocks = Namespace->LastLba - Lba + 1;
+
+    if (!NvmeIsBlockRangeValid(Namespace, Lba, Blocks))
+    {
+        NvmeSetSense(Srb,
+                     SRB_STATUS_ERROR,
+                     SCSI_SENSE_ILLEGAL_REQUEST,
+                     SCSI_ADSENSE_ILLEGAL_BLOCK);
+        return FALSE;
+    }
+
+    if (Srb->DataTransferLength < Namespace->BlockSize ||
+        Blocks > NVME_MAX_WRITE_ZEROES_BLOCKS)
+    {
+        NvmeSetInvalidCdb(Srb);
+        return FALSE;
+    }
+
+    Pattern = Srb->DataBuffer;
+    for (i = 0; i < Namespace->BlockSize / sizeof(ULONG); i++)
+    {
+        if (Pattern[i] != 0)
+        {
+            NvmeSetInvalidCdb(Srb);
+            return FALSE;
+        }
+    }
+
+    RtlZeroMemory(&Command, sizeof(Command));
+
+    if (!NvmeAllocateCommandId(DevExt, Srb, &Command.CommandId))
+    {
+        Srb->SrbStatus = SRB_STATUS_BUSY;
+        return FALSE;
+    }
+
+    Command.Opcode = NVME_CMD_WRITE_ZEROES;
+    Command.Cdw10 = (ULONG)Lba;
+    Command.Cdw11 = (ULONG)(Lba >> 32);
+    Command.Cdw12 = (ULONG)Blocks - 1;
+
+    if (Cdb[1] & NVME_WRITE_SAME_UNMAP)
+        Command.Cdw12 |= NVME_WRITE_ZEROES_DEALLOCATE;
+
+    return NvmeQueueCommand(DevExt, Srb, &Command);
+}
+
+BOOLEAN
+NTAPI
+NvmeFlush(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    NVME_COMMAND Command;
+
+    /* Without a volatile cache every write is already stable */
+    if (!(DevExt->VolatileWriteCache & NVME_VWC_PRESENT))
+    {
+        Srb->SrbStatus = SRB_STATUS_SUCCESS;
+        return FALSE;
+    }
+
+    RtlZeroMemory(&Command, sizeof(Command));
+
+    if (!NvmeAllocateCommandId(DevExt, Srb, &Command.CommandId))
+    {
+        Srb->SrbStatus = SRB_STATUS_BUSY;
+        return FALSE;
+    }
+
+    Command.Opcode = NVME_CMD_FLUSH;
+
+    return NvmeQueueCommand(DevExt, Srb, &Command);
+}
+
+static
+VOID
+NvmeInquiry(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PNVME_NAMESPACE Namespace = &DevExt->Namespaces[Srb->Lun];
+    PCDB Cdb = (PCDB)Srb->Cdb;
+    UCHAR Buffer[sizeof(VPD_BLOCK_LIMITS_PAGE)];
+    PINQUIRYDATA InquiryData;
+    PVPD_SUPPORTED_PAGES_PAGE SupportedPages;
+    PVPD_SERIAL_NUMBER_PAGE SerialNumber;
+    PVPD_BLOCK_LIMITS_PAGE BlockLimits;
+    PVPD_LOGICAL_BLOCK_PROVISIONING_PAGE Provisioning;
+    BOOLEAN CanDeallocate, CanWriteZeroes;
+    ULONG Value;
+
+    C_ASSERT(sizeof(Buffer) >= INQUIRYDATABUFFERSIZE);
+    C_ASSERT(sizeof(Buffer) >= sizeof(VPD_SERIAL_NUMBER_PAGE) +
+                               RTL_FIELD_SIZE(NVME_DEVICE_EXTENSION, SerialNumber));
+
+    RtlZeroMemory(Buffer, sizeof(Buffer));
+
+    CanDeallocate = !!(DevExt->OptionalNvmCommands & NVME_ONCS_DSM);
+    CanWriteZeroes = !!(DevExt->OptionalNvmCommands & NVME_ONCS_WRITE_ZEROES);
+
+    if (!Cdb->CDB6INQUIRY3.EnableVitalProductData)
+    {
+        if (Cdb->CDB6INQUIRY3.PageCode != 0)
+        {
+            NvmeSetInvalidCdb(Srb);
+            return;
+        }
+
+        InquiryData = (PINQUIRYDATA)Buffer;
+        InquiryData->DeviceType = DIRECT_ACCESS_DEVICE;
+        InquiryData->Versions = 5;
+        InquiryData->ResponseDataFormat = 2;
+        InquiryData->AdditionalLength = INQUIRYDATABUFFERSIZE - 5;
+        InquiryData->CommandQueue = 1;
+        RtlCopyMemory(InquiryData->VendorId, "NVMe    ", 8);
+        RtlCopyMemory(InquiryData->ProductId, DevExt->ModelNumber, 16);
+        RtlCopyMemory(InquiryData->ProductRevisionLevel, DevExt->FirmwareRevision, 4);
+
+        NvmeReturnData(Srb, Buffer, INQUIRYDATABUFFERSIZE);
+        return;
+    }
+
+    switch (Cdb->CDB6INQUIRY3.PageCode)
+    {
+        case VPD_SUPPORTED_PAGES:
+            SupportedPages = (PVPD_SUPPORTED_PAGES_PAGE)Buffer;
+            SupportedPages->DeviceType = DIRECT_ACCESS_DEVICE;
+            SupportedPages->PageCode = VPD_SUPPORTED_PAGES;
+            SupportedPages->PageLength = 4;
+            SupportedPages->SupportedPageList[0] = VPD_SUPPORTED_PAGES;
+            SupportedPages->SupportedPageList[1] = VPD_SERIAL_NUMBER;
+            SupportedPages->SupportedPageList[2] = VPD_BLOCK_LIMITS;
+            SupportedPages->SupportedPageList[3] = VPD_LOGICAL_BLOCK_PROVISIONING;
+
+            NvmeReturnData(Srb, Buffer, sizeof(*SupportedPages) + 4);
+            break;
+
+        case VPD_SERIAL_NUMBER:
+            SerialNumber = (PVPD_SERIAL_NUMBER_PAGE)Buffer;
+            SerialNumber->DeviceType = DIRECT_ACCESS_DEVICE;
+            SerialNumber->PageCode = VPD_SERIAL_NUMBER;
+            SerialNumber->PageLength = sizeof(DevExt->SerialNumber);
+            RtlCopyMemory(SerialNumber->SerialNumber,
+                          DevExt->SerialNumber,
+                          sizeof(DevExt->SerialNumber));
+
+            NvmeReturnData(Srb,
+                           Buffer,
+                           sizeof(*SerialNumber) + sizeof(DevExt->SerialNumber));
+            break;
+
+        case VPD_BLOCK_LIMITS:
+            BlockLimits = (PVPD_BLOCK_LIMITS_PAGE)Buffer;
+            BlockLimits->DeviceType = DIRECT_ACCESS_DEVICE;
+            BlockLimits->PageCode = VPD_BLOCK_LIMITS;
+            BlockLimits->PageLength[1] = sizeof(*BlockLimits) - 4;
+
+            Value = DevExt->MaxTransferLength >> Namespace->BlockShift;
+            REVERSE_BYTES(BlockLimits->MaximumTransferLength, &Value);
+
+            if (CanDeallocate)
+            {
+                Value = MAXULONG;
+                REVERSE_BYTES(BlockLimits->MaximumUnmapLBACount, &Value);
+
+                Value = NVME_MAX_DSM_RANGES;
+                REVERSE_BYTES(BlockLimits->MaximumUnmapBlockDescriptorCount, &Value);
+            }
+
+            NvmeReturnData(Srb, Buffer, sizeof(*BlockLimits));
+            break;
+
+        case VPD_LOGICAL_BLOCK_PROVISIONING:
+            Provisioning = (PVPD_LOGICAL_BLOCK_PROVISIONING_PAGE)Buffer;
+            Provisioning->DeviceType = DIRECT_ACCESS_DEVICE;
+            Provisioning->PageCode = VPD_LOGICAL_BLOCK_PROVISIONING;
+            Provisioning->PageLength[1] = sizeof(*Provisioning) - 4;
+            Provisioning->LBPU = CanDeallocate;
+            Provisioning->LBPWS = CanWriteZeroes;
+            Provisioning->LBPWS10 = CanWriteZeroes;
+            Provisioning->ProvisioningType = Namespace->Thin ? PROVISIONING_TYPE_THIN
+                                                             : PROVISIONING_TYPE_RESOURCE;
+
+            NvmeReturnData(Srb, Buffer, sizeof(*Provisioning));
+            break;
+
+        default:
+            NvmeSetInvalidCdb(Srb);
+            break;
+    }
+}
+
+static
+VOID
+NvmeReadCapacity(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PNVME_NAMESPACE Namespace = &DevExt->Namespaces[Srb->Lun];
+    READ_CAPACITY_DATA CapacityData;
+    ULONG LastLba;
+
+    LastLba = (ULONG)min(Namespace->LastLba, MAXULONG);
+
+    REVERSE_BYTES(&CapacityData.LogicalBlockAddress, &LastLba);
+    REVERSE_BYTES(&CapacityData.BytesPerBlock, &Namespace->BlockSize);
+
+    NvmeReturnData(Srb, &CapacityData, sizeof(CapacityData));
+}
+
+static
+VOID
+NvmeReadCapacity16(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PNVME_NAMESPACE Namespace = &DevExt->Namespaces[Srb->Lun];
+    READ_CAPACITY16_DATA CapacityData;
+
+    RtlZeroMemory(&CapacityData, sizeof(CapacityData));
+
+    REVERSE_BYTES_QUAD(&CapacityData.LogicalBlockAddress, &Namespace->LastLba);
+    REVERSE_BYTES(&CapacityData.BytesPerBlock, &Namespace->BlockSize);
+
+    CapacityData.LBPME = !!(DevExt->OptionalNvmCommands & NVME_ONCS_DSM);
+
+    NvmeReturnData(Srb, &CapacityData, sizeof(CapacityData));
+}
+
+static
+VOID
+NvmeModeSense(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PCDB Cdb = (PCDB)Srb->Cdb;
+    UCHAR Buffer[sizeof(MODE_PARAMETER_HEADER10) + sizeof(MODE_CACHING_PAGE)];
+    PMODE_CACHING_PAGE CachingPage;
+    ULONG HeaderLength, Length;
+    UCHAR PageCode;
+    BOOLEAN IsModeSense10;
+
+    IsModeSense10 = (Srb->Cdb[0] == SCSIOP_MODE_SENSE10);
+    PageCode = IsModeSense10 ? Cdb->MODE_SENSE10.PageCode : Cdb->MODE_SENSE.PageCode;
+
+    if (PageCode != MODE_PAGE_CACHING && PageCode != MODE_SENSE_RETURN_ALL)
+    {
+        NvmeSetInvalidCdb(Srb);
+        return;
+    }
+
+    RtlZeroMemory(Buffer, sizeof(Buffer));
+
+    HeaderLength = IsModeSense10 ? sizeof(MODE_PARAMETER_HEADER10)
+                                 : sizeof(MODE_PARAMETER_HEADER);
+
+    CachingPage = (PMODE_CACHING_PAGE)&Buffer[HeaderLength];
+    CachingPage->PageCode = MODE_PAGE_CACHING;
+    CachingPage->PageLength = sizeof(MODE_CACHING_PAGE) -
+                              RTL_SIZEOF_THROUGH_FIELD(MODE_CACHING_PAGE, PageLength);
+    CachingPage->WriteCacheEnable = !!(DevExt->VolatileWriteCache & NVME_VWC_PRESENT);
+
+    Length = HeaderLength + sizeof(MODE_CACHING_PAGE);
+
+    if (IsModeSense10)
+    {
+        PMODE_PARAMETER_HEADER10 Header = (PMODE_PARAMETER_HEADER10)Buffer;
+
+        Header->ModeDataLength[1] = (UCHAR)(Length - RTL_SIZEOF_THROUGH_FIELD(MODE_PARAMETER_HEADER10,
+                                                                             ModeDataLength));
+    }
+    else
+    {
+        PMODE_PARAMETER_HEADER Header = (PMODE_PARAMETER_HEADER)Buffer;
+
+        Header->ModeDataLength = (UCHAR)(Length - RTL_SIZEOF_THROUGH_FIELD(MODE_PARAMETER_HEADER,
+                                                                          ModeDataLength));
+    }
+
+    NvmeReturnData(Srb, Buffer, Length);
+}
+
+BOOLEAN
+NTAPI
+NvmeExecuteScsi(
+    _In_ PNVME_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PCDB Cdb = (PCDB)Srb->Cdb;
+    ULONGLONG Lba;
+    ULONG Lba32, Blocks;
+
+    switch (Srb->Cdb[0])
+    {
+        case SCSIOP_READ:
+        case SCSIOP_WRITE:
+            Lba32 = ((ULONG)Cdb->CDB10.LogicalBlockByte0 << 24) |
+                    ((ULONG)Cdb->CDB10.LogicalBlockByte1 << 16) |
+                    ((ULONG)Cdb->CDB10.LogicalBlockByte2 << 8) |
+                    Cdb->CDB10.LogicalBlockByte3;
+            Blocks = ((ULONG)Cdb->CDB10.TransferBlocksMsb << 8) |
+                     Cdb->CDB10.TransferBlocksLsb;
+
+            return NvmeReadWrite(DevExt,
+                                 Srb,
+                                 Lba32,
+                                 Blocks,
+                                 Srb->Cdb[0] == SCSIOP_WRITE,
+                                 !!(Srb->Cdb[1] & NVME_CDB_FUA));
+
+        case SCSIOP_READ16:
+        case SCSIOP_WRITE16:
+            REVERSE_BYTES_QUAD(&Lba, Cdb->CDB16.LogicalBlock);
+            REVERSE_BYTES(&Blocks, Cdb->CDB16.TransferLength);
+
+            return NvmeReadWrite(DevExt,
+                                 Srb,
+                                 Lba,
+                                 Blocks,
+                                 Srb->Cdb[0] == SCSIOP_WRITE16,
+                                 !!(Srb->Cdb[1] & NVME_CDB_FUA));
+
+        case SCSIOP_SYNCHRONIZE_CACHE:
+        case SCSIOP_SYNCHRONIZE_CACHE16:
+            return NvmeFlush(DevExt, Srb);
+
+        case SCSIOP_UNMAP:
+            return NvmeUnmap(DevExt, Srb);
+
+        case SCSIOP_WRITE_SAME:
+        case SCSIOP_WRITE_SAME16:
+            return NvmeWriteSame(DevExt, Srb);
+
+        case SCSIOP_INQUIRY:
+            NvmeInquiry(DevExt, Srb);
+            break;
+
+        case SCSIOP_READ_CAPACITY:
+            NvmeReadCapacity(DevExt, Srb);
+            break;
+
+        case SCSIOP_SERVICE_ACTION_IN16:
+            if ((Srb->Cdb[1] & 0x1F) == SERVICE_ACTION_READ_CAPACITY16)
+                NvmeReadCapacity16(DevExt, Srb);
+            else
+                NvmeSetInvalidCdb(Srb);
+            break;
+
+        case SCSIOP_MODE_SENSE:
+        case SCSIOP_MODE_SENSE10:
+            NvmeModeSense(DevExt, Srb);
+            break;
+
+        case SCSIOP_TEST_UNIT_READY:
+        case SCSIOP_START_STOP_UNIT:
+        case SCSIOP_MEDIUM_REMOVAL:
+        case SCSIOP_VERIFY:
+        case SCSIOP_VERIFY16:
+        case SCSIOP_RESERVE_UNIT:
+        case SCSIOP_RELEASE_UNIT:
+            Srb->DataTransferLength = 0;
+            Srb->SrbStatus = SRB_STATUS_SUCCESS;
+            break;
+
+        default:
+            DPRINT("Unsupported SCSI command %02x\n", Srb->Cdb[0]);
+            NvmeSetIllegalCommand(Srb);
+            break;
+    }
+
+    return FALSE;
+}
@@ -0,0 +1,719 @@
+/*
+ * PROJECT:     ReactOS VirtIO Block Miniport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Translation of SCSI commands into virtio-blk requests
+ */
+
+#include "viostor.h"
+
+#define NDEBUG
+#include <debug.h>
+
+#define VIOSTOR_WRITE_SAME_UNMAP    0x08
+
+VOID
+NTAPI
+ViostorSetSense(
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _In_ UCHAR SrbStatus,
+    _In_ UCHAR SenseKey,
+    _In_ UCHAR AdditionalSenseCode)
+{
+    PSENSE_DATA SenseData = Srb->SenseInfoBuffer;
+
+    Srb->SrbStatus = SrbStatus;
+    Srb->ScsiStatus = SCSISTAT_CHECK_CONDITION;
+
+    if (!SenseData ||
+        (Srb->SrbFlags & SRB_FLAGS_DISABLE_AUTOSENSE) ||
+        Srb->SenseInfoBufferLength < RTL_SIZEOF_THROUGH_FIELD(SENSE_DATA, AdditionalSenseCodeQualifier))
+    {
+        return;
+    }
+
+    RtlZeroMemory(SenseData, min(Srb->SenseInfoBufferLength, sizeof(SENSE_DATA)));
+
+    SenseData->ErrorCode = SCSI_SENSE_ERRORCODE_FIXED_CURRENT;
+    SenseData->SenseKey = SenseKey;
+    SenseData->AdditionalSenseLength = sizeof(SENSE_DATA) -
+                                       RTL_SIZEOF_THROUGH_FIELD(SENSE_DATA, AdditionalSenseLength);
+    SenseData->AdditionalSenseCode = AdditionalSenseCode;
+
+    Srb->SrbStatus |= SRB_STATUS_AUTOSENSE_VALID;
+}
+
+static
+VOID
+ViostorSetInvalidCdb(
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    ViostorSetSense(Srb,
+                    SRB_STATUS_ERROR,
+                    SCSI_SENSE_ILLEGAL_REQUEST,
+                    SCSI_ADSENSE_INVALID_CDB);
+}
+
+static
+VOID
+ViostorSetWriteProtected(
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    ViostorSetSense(Srb,
+                    SRB_STATUS_ERROR,
+                    SCSI_SENSE_DATA_PROTECT,
+                    SCSI_ADSENSE_WRITE_PROTECT);
+}
+
+static
+VOID
+ViostorReturnData(
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _In_reads_bytes_(Length) PVOID Data,
+    _In_ ULONG Length)
+{
+    Length = min(Length, Srb->DataTransferLength);
+
+    RtlCopyMemory(Srb->DataBuffer, Data, Length);
+
+    Srb->DataTransferLength = Length;
+    Srb->SrbStatus = SRB_STATUS_SUCCESS;
+}
+
+static
+BOOLEAN
+ViostorIsBlockRangeValid(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ ULONGLONG Lba,
+    _In_ ULONGLONG Blocks)
+{
+    return (Lba <= DevExt->LastLba) && (Blocks <= DevExt->LastLba - Lba + 1);
+}
+
+static
+BOOLEAN
+ViostorQueueRequest(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _In_ ULONG Type,
+    _In_ ULONGLONG Sector,
+    _In_ ULONG DataCount,
+    _In_ BOOLEAN DataOut)
+{
+    PVIOSTOR_SRB_EXTENSION SrbExt = Srb->SrbExtension;
+    ULONG Length;
+
+    SrbExt->Header.Type = Type;
+    SrbExt->Header.IoPriority = 0;
+    SrbExt->Header.Sector = Sector;
+    SrbExt->Status = VIRTIO_BLK_S_IOERR;
+
+    /* The data elements were put in between by the caller */
+    SrbExt->Sg[0].physAddr = ScsiPortGetPhysicalAddress(DevExt, NULL, &SrbExt->Header, &Length);
+    SrbExt->Sg[0].length = sizeof(SrbExt->Header);
+    SrbExt->Sg[DataCount + 1].physAddr = ScsiPortGetPhysicalAddress(DevExt, NULL, &SrbExt->Status, &Length);
+    SrbExt->Sg[DataCount + 1].length = sizeof(SrbExt->Status);
+
+    if (!ViostorSubmitRequest(DevExt,
+                              Srb,
+                              DataOut ? DataCount + 1 : 1,
+                              DataOut ? 1 : DataCount + 1))
+    {
+        Srb->SrbStatus = SRB_STATUS_BUSY;
+        return FALSE;
+    }
+
+    Srb->SrbStatus = SRB_STATUS_PENDING;
+    return TRUE;
+}
+
+static
+ULONG
+ViostorBuildDataSg(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PVIOSTOR_SRB_EXTENSION SrbExt = Srb->SrbExtension;
+    PUCHAR DataBuffer = Srb->DataBuffer;
+    ULONG Remaining = Srb->DataTransferLength;
+    ULONG Count = 0;
+    ULONG Length;
+
+    while (Remaining != 0)
+    {
+        if (Count == DevExt->MaxDataSg)
+            return 0;
+
+        SrbExt->Sg[Count + 1].physAddr = ScsiPortGetPhysicalAddress(DevExt,
+                                                                    Srb,
+                                                                    DataBuffer,
+                                                                    &Length);
+        if (Length == 0)
+            return 0;
+
+        Length = min(Length, Remaining);
+        SrbExt->Sg[Count + 1].length = Length;
+
+        DataBuffer += Length;
+        Remaining -= Length;
+        Count++;
+    }
+
+    return Count;
+}
+
+static
+BOOLEAN
+ViostorReadWrite(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _In_ ULONGLONG Lba,
+    _In_ ULONG Blocks,
+    _In_ BOOLEAN IsWrite)
+{
+    ULONG DataCount;
+
+    if (IsWrite && virtio_is_feature_enabled(DevExt->Features, VIRTIO_BLK_F_RO))
+    {
+        ViostorSetWriteProtected(Srb);
+        return FALSE;
+    }
+
+    if (!ViostorIsBlockRangeValid(DevExt, Lba, Blocks))
+    {
+        ViostorSetSense(Srb,
+                        SRB_STATUS_ERROR,
+                        SCSI_SENSE_ILLEGAL_REQUEST,
+                        SCSI_ADSENSE_ILLEGAL_BLOCK);
+        return FALSE;
+    }
+
+    if (Blocks == 0 || Srb->DataTransferLength == 0)
+    {
+        Srb->SrbStatus = SRB_STATUS_SUCCESS;
+        return FALSE;
+    }
+
+    DataCount = ViostorBuildDataSg(DevExt, Srb);
+    if (DataCount == 0)
+    {
+        DPRINT1("Cannot describe %lu bytes at %p\n",
+                Srb->DataTransferLength,
+                Srb->DataBuffer);
+        Srb->SrbStatus = SRB_STATUS_INVALID_REQUEST;
+        return FALSE;
+    }
+
+    return ViostorQueueRequest(DevExt,
+                               Srb,
+                               IsWrite ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN,
+                               Lba * DevExt->SectorsPerBlock,
+                               DataCount,
+                               IsWrite);
+}
+
+static
+BOOLEAN
+ViostorQueueRanges(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _In_ ULONG Type,
+    _In_ ULONG RangeCount)
+{
+    PVIOSTOR_SRB_EXTENSION SrbExt = Srb->SrbExtension;
+    ULONG Length;
+
+    SrbExt->Sg[1].physAddr = ScsiPortGetPhysicalAddress(DevExt, NULL, SrbExt->Ranges, &Length);
+    SrbExt->Sg[1].length = RangeCount * sizeof(SrbExt->Ranges[0]);
+
+    return ViostorQueueRequest(DevExt, Srb, Type, 0, 1, TRUE);
+}
+
+static
+BOOLEAN
+ViostorUnmap(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PVIOSTOR_SRB_EXTENSION SrbExt = Srb->SrbExtension;
+    PUNMAP_LIST_HEADER ListHeader = Srb->DataBuffer;
+    PUNMAP_BLOCK_DESCRIPTOR Descriptor;
+    ULONGLONG Lba, Sectors;
+    ULONG Blocks, DescriptorCount, MaxRanges, RangeCount = 0, i;
+    USHORT DescriptorLength;
+
+    if (!virtio_is_feature_enabled(DevExt->Features, VIRTIO_BLK_F_DISCARD))
+    {
+        ViostorSetSense(Srb,
+                        SRB_STATUS_ERROR,
+                        SCSI_SENSE_ILLEGAL_REQUEST,
+                        SCSI_ADSENSE_ILLEGAL_COMMAND);
+        return FALSE;
+    }
+
+    if (virtio_is_feature_enabled(DevExt->Features, VIRTIO_BLK_F_RO))
+    {
+        ViostorSetWriteProtected(Srb);
+        return FALSE;
+    }
+
+    if (Srb->DataTransferLength < sizeof(UNMAP_LIST_HEADER))
+    {
+        Srb->SrbStatus = SRB_STATUS_SUCCESS;
+        return FALSE;
+    }
+
+    REVERSE_BYTES_SHORT(&DescriptorLength, ListHeader->BlockDescrDataLength);
+    DescriptorCount = min(DescriptorLength,
+                          Srb->DataTransferLength - sizeof(UNMAP_LIST_HEADER)) /
+                      sizeof(UNMAP_BLOCK_DESCRIPTOR);
+
+    MaxRanges = min(max(DevExt->Config.MaxDiscardSeg, 1), VIOSTOR_MAX_DISCARD_SEG);
+
+    for (i = 0; i < DescriptorCount; i++)
+    {
+        Descriptor = &ListHeader->Descriptors[i];
+
+        REVERSE_BYTES_QUAD(&Lba, Descriptor->StartingLba);
+        REVERSE_BYTES(&Blocks, Descriptor->LbaCount);
+
+        if (Blocks == 0)
+            continue;
+
+        Sectors = (ULONGLONG)Blocks * DevExt->SectorsPerBlock;
+
+        if (RangeCount == MaxRanges ||
+            !ViostorIsBlockRangeValid(DevExt, Lba, Blocks) ||
+            (DevExt->Config.MaxDiscardSectors != 0 && Sectors > DevExt->Config.MaxDiscardSectors) ||
+            Sectors > MAXULONG)
+        {
+            ViostorSetSense(Srb,
+                            SRB_STATUS_ERROR,
+                            SCSI_SENSE_ILLEGAL_REQUEST,
+                            SCSI_ADSENSE_INVALID_FIELD_PARAMETER_LIST);
+            return FALSE;
+        }
+
+        SrbExt->Ranges[RangeCount].Sector = Lba * DevExt->SectorsPerBlock;
+        SrbExt->Ranges[RangeCount].NumSectors = (ULONG)Sectors;
+        SrbExt->Ranges[RangeCount].Flags = 0;
+        RangeCount++;
+    }
+
+    if (RangeCount == 0)
+    {
+        Srb->SrbStatus = SRB_STATUS_SUCCESS;
+        return FALSE;
+    }
+
+    return ViostorQueueRanges(DevExt, Srb, VIRTIO_BLK_T_DISCARD, RangeCount);
+}
+
+static
+BOOLEAN
+ViostorWriteSame(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PVIOSTOR_SRB_EXTENSION SrbExt = Srb->SrbExtension;
+    PUCHAR Cdb = Srb->Cdb;
+    ULONGLONG Lba, Blocks, Sectors;
+    ULONG Lba32, Blocks32;
+    USHORT Blocks16;
+    PULONG Pattern;
+    ULONG i;
+
+    /* Only a block of zeroes can be written this way */
+    if (!virtio_is_feature_enabled(DevExt->Features, VIRTIO_BLK_F_WRITE_ZEROES))
+    {
+        ViostorSetSense(Srb,
+                        SRB_STATUS_ERROR,
+                        SCSI_SENSE_ILLEGAL_REQUEST,
+                        SCSI_ADSENSE_ILLEGAL_COMMAND);
+        return FALSE;
+    }
+
+    if (virtio_is_feature_enabled(DevExt->Features, VIRTIO_BLK_F_RO))
+    {
+        ViostorSetWriteProtected(Srb);
+        return FALSE;
+    }
+
+    if (Cdb[0] == SCSIOP_WRITE_SAME16)
+    {
+        REVERSE_BYTES_QUAD(&Lba, &Cdb[2]);
+        REVERSE_BYTES(&Blocks32, &Cdb[10]);
+        Blocks = Blocks32;
+    }
+    else
+    {
+        REVERSE_BYTES(&Lba32, &Cdb[2]);
+        REVERSE_BYTES_SHORT(&Blocks16, &Cdb[7]);
+        Lba = Lba32;
+        Blocks = Blocks16;
+    }
+
+    /* Zero blocks means up to the end of the medium */
+    if (Blocks == 0 && Lba <= DevExt->LastLba)
+        Blocks = DevExt->LastLba - Lba + 1;
+
+    if (!ViostorIsBlockRangeValid(DevExt, Lba, Blocks))
+    {
+        ViostorSetSense(Srb,
+                        SRB_STATUS_ERROR,
+                        SCSI_SENSE_ILLEGAL_REQUEST,
+                        SCSI_ADSENSE_ILLEGAL_BLOCK);
+        return FALSE;
+    }
+
+    Sectors = Blocks * DevExt->SectorsPerBlock;
+
+    if (Srb->DataTransferLength < DevExt->BlockSize ||
+        Sectors > MAXULONG ||
+        (DevExt->Config.MaxWriteZeroesSectors != 0 &&
+         Sectors > DevExt->Config.MaxWriteZeroesSectors))
+    {
+        ViostorSetInvalidCdb(Srb);
+        return FALSE;
+    }
+
+    Pattern = Srb->DataBuffer;
+    for (i = 0; i < DevExt->BlockSize / sizeof(ULONG); i++)
+    {
+        if (Pattern[i] != 0)
+        {
+            ViostorSetInvalidCdb(Srb);
+            return FALSE;
+        }
+    }
+
+    SrbExt->Ranges[0].Sector = Lba * DevExt->SectorsPerBlock;
+    SrbExt->Ranges[0].NumSectors = (ULONG)Sectors;
+    SrbExt->Ranges[0].Flags = 0;
+
+    if (Cdb[1] & VIOSTOR_WRITE_SAME_UNMAP)
+        SrbExt->Ranges[0].Flags = VIRTIO_BLK_WRITE_ZEROES_FLAG_UNMAP;
+
+    return ViostorQueueRanges(DevExt, Srb, VIRTIO_BLK_T_WRITE_ZEROES, 1);
+}
+
+BOOLEAN
+NTAPI
+ViostorFlush(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    /* Without the feature every write is already stable */
+    if (!virtio_is_feature_enabled(DevExt->Features, VIRTIO_BLK_F_FLUSH))
+    {
+        Srb->SrbStatus = SRB_STATUS_SUCCESS;
+        return FALSE;
+    }
+
+    return ViostorQueueRequest(DevExt, Srb, VIRTIO_BLK_T_FLUSH, 0, 0, FALSE);
+}
+
+static
+VOID
+ViostorInquiry(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PCDB Cdb = (PCDB)Srb->Cdb;
+    UCHAR Buffer[sizeof(VPD_BLOCK_LIMITS_PAGE)];
+    PINQUIRYDATA InquiryData;
+    PVPD_SUPPORTED_PAGES_PAGE SupportedPages;
+    PVPD_BLOCK_LIMITS_PAGE BlockLimits;
+    PVPD_LOGICAL_BLOCK_PROVISIONING_PAGE Provisioning;
+    BOOLEAN CanDiscard, CanWriteZeroes;
+    ULONG Value;
+
+    C_ASSERT(sizeof(Buffer) >= INQUIRYDATABUFFERSIZE);
+
+    RtlZeroMemory(Buffer, sizeof(Buffer));
+
+    CanDiscard = virtio_is_feature_enabled(DevExt->Features, VIRTIO_BLK_F_DISCARD);
+    CanWriteZeroes = virtio_is_feature_enabled(DevExt->Features, VIRTIO_BLK_F_WRITE_ZEROES);
+
+    if (!Cdb->CDB6INQUIRY3.EnableVitalProductData)
+    {
+        if (Cdb->CDB6INQUIRY3.PageCode != 0)
+        {
+            ViostorSetInvalidCdb(Srb);
+            return;
+        }
+
+        InquiryData = (PINQUIRYDATA)Buffer;
+        InquiryData->DeviceType = DIRECT_ACCESS_DEVICE;
+        InquiryData->Versions = 5;
+        InquiryData->ResponseDataFormat = 2;
+        InquiryData->AdditionalLength = INQUIRYDATABUFFERSIZE - 5;
+        InquiryData->CommandQueue = 1;
+        RtlCopyMemory(InquiryData->VendorId, "VirtIO  ", 8);
+        RtlCopyMemory(InquiryData->ProductId, "Block Device    ", 16);
+        RtlCopyMemory(InquiryData->ProductRevisionLevel, "0001", 4);
+
+        ViostorReturnData(Srb, Buffer, INQUIRYDATABUFFERSIZE);
+        return;
+    }
+
+    switch (Cdb->CDB6INQUIRY3.PageCode)
+    {
+        case VPD_SUPPORTED_PAGES:
+            SupportedPages = (PVPD_SUPPORTED_PAGES_PAGE)Buffer;
+            SupportedPages->DeviceType = DIRECT_ACCESS_DEVICE;
+            SupportedPages->PageCode = VPD_SUPPORTED_PAGES;
+            SupportedPages->PageLength = 3;
+            SupportedPages->SupportedPageList[0] = VPD_SUPPORTED_PAGES;
+            SupportedPages->SupportedPageList[1] = VPD_BLOCK_LIMITS;
+            SupportedPages->SupportedPageList[2] = VPD_LOGICAL_BLOCK_PROVISIONING;
+
+            ViostorReturnData(Srb, Buffer, sizeof(*SupportedPages) + 3);
+            break;
+
+        case VPD_BLOCK_LIMITS:
+            BlockLimits = (PVPD_BLOCK_LIMITS_PAGE)Buffer;
+            BlockLimits->DeviceType = DIRECT_ACCESS_DEVICE;
+            BlockLimits->PageCode = VPD_BLOCK_LIMITS;
+            BlockLimits->PageLength[1] = sizeof(*BlockLimits) - 4;
+
+            Value = (DevExt->MaxDataSg - 1) * PAGE_SIZE / DevExt->BlockSize;
+            REVERSE_BYTES(BlockLimits->MaximumTransferLength, &Value);
+
+            if (virtio_is_feature_enabled(DevExt->Features, VIRTIO_BLK_F_TOPOLOGY))
+            {
+                BlockLimits->OptimalTransferLengthGranularity[0] = (UCHAR)(DevExt->Config.MinIoSize >> 8);
+                BlockLimits->OptimalTransferLengthGranularity[1] = (UCHAR)DevExt->Config.MinIoSize;
+                REVERSE_BYTES(BlockLimits->OptimalTransferLength, &DevExt->Config.OptIoSize);
+            }
+
+            if (CanDiscard)
+            {
+                Value = DevExt->Config.MaxDiscardSectors / DevExt->SectorsPerBlock;
+                if (Value == 0)
+                    Value = MAXULONG / DevExt->SectorsPerBlock;
+                REVERSE_BYTES(BlockLimits->MaximumUnmapLBACount, &Value);
+
+                Value = min(max(DevExt->Config.MaxDiscardSeg, 1), VIOSTOR_MAX_DISCARD_SEG);
+                REVERSE_BYTES(BlockLimits->MaximumUnmapBlockDescriptorCount, &Value);
+
+                Value = DevExt->Config.DiscardSectorAlignment / DevExt->SectorsPerBlock;
+                REVERSE_BYTES(BlockLimits->OptimalUnmapGranularity, &Value);
+            }
+
+            ViostorReturnData(Srb, Buffer, sizeof(*BlockLimits));
+            break;
+
+        case VPD_LOGICAL_BLOCK_PROVISIONING:
+            Provisioning = (PVPD_LOGICAL_BLOCK_PROVISIONING_PAGE)Buffer;
+            Provisioning->DeviceType = DIRECT_ACCESS_DEVICE;
+            Provisioning->PageCode = VPD_LOGICAL_BLOCK_PROVISIONING;
+            Provisioning->PageLength[1] = sizeof(*Provisioning) - 4;
+            Provisioning->LBPU = CanDiscard;
+            Provisioning->LBPWS = CanWriteZeroes;
+            Provisioning->LBPWS10 = CanWriteZeroes;
+            Provisioning->ProvisioningType = CanDiscard ? PROVISIONING_TYPE_THIN
+                                                        : PROVISIONING_TYPE_UNKNOWN;
+
+            ViostorReturnData(Srb, Buffer, sizeof(*Provisioning));
+            break;
+
+        default:
+            ViostorSetInvalidCdb(Srb);
+            break;
+    }
+}
+
+static
+VOID
+ViostorReadCapacity(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    READ_CAPACITY_DATA CapacityData;
+    ULONG LastLba;
+
+    LastLba = (ULONG)min(DevExt->LastLba, MAXULONG);
+
+    REVERSE_BYTES(&CapacityData.LogicalBlockAddress, &LastLba);
+    REVERSE_BYTES(&CapacityData.BytesPerBlock, &DevExt->BlockSize);
+
+    ViostorReturnData(Srb, &CapacityData, sizeof(CapacityData));
+}
+
+static
+VOID
+ViostorReadCapacity16(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    READ_CAPACITY16_DATA CapacityData;
+    USHORT AlignmentOffset;
+
+    RtlZeroMemory(&CapacityData, sizeof(CapacityData));
+
+    REVERSE_BYTES_QUAD(&CapacityData.LogicalBlockAddress, &DevExt->LastLba);
+    REVERSE_BYTES(&CapacityData.BytesPerBlock, &DevExt->BlockSize);
+
+    if (virtio_is_feature_enabled(DevExt->Features, VIRTIO_BLK_F_TOPOLOGY))
+    {
+        AlignmentOffset = DevExt->Config.AlignmentOffset;
+        CapacityData.LogicalPerPhysicalExponent = DevExt->Config.PhysicalBlockExp;
+        CapacityData.LowestAlignedBlock_MSB = (UCHAR)(AlignmentOffset >> 8);
+        CapacityData.LowestAlignedBlock_LSB = (UCHAR)AlignmentOffset;
+    }
+
+    CapacityData.LBPME = virtio_is_feature_enabled(DevExt->Features, VIRTIO_BLK_F_DISCARD);
+
+    ViostorReturnData(Srb, &CapacityData, sizeof(CapacityData));
+}
+
+static
+VOID
+ViostorModeSense(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PCDB Cdb = (PCDB)Srb->Cdb;
+    UCHAR Buffer[sizeof(MODE_PARAMETER_HEADER10) + sizeof(MODE_CACHING_PAGE)];
+    PMODE_CACHING_PAGE CachingPage;
+    ULONG HeaderLength, Length;
+    UCHAR PageCode, DeviceSpecific;
+    BOOLEAN IsModeSense10;
+
+    IsModeSense10 = (Srb->Cdb[0] == SCSIOP_MODE_SENSE10);
+    PageCode = IsModeSense10 ? Cdb->MODE_SENSE10.PageCode : Cdb->MODE_SENSE.PageCode;
+
+    if (PageCode != MODE_PAGE_CACHING && PageCode != MODE_SENSE_RETURN_ALL)
+    {
+        ViostorSetInvalidCdb(Srb);
+        return;
+    }
+
+    RtlZeroMemory(Buffer, sizeof(Buffer));
+
+    HeaderLength = IsModeSense10 ? sizeof(MODE_PARAMETER_HEADER10)
+                                 : sizeof(MODE_PARAMETER_HEADER);
+
+    CachingPage = (PMODE_CACHING_PAGE)&Buffer[HeaderLength];
+    CachingPage->PageCode = MODE_PAGE_CACHING;
+    CachingPage->PageLength = sizeof(MODE_CACHING_PAGE) -
+                              RTL_SIZEOF_THROUGH_FIELD(MODE_CACHING_PAGE, PageLength);
+    CachingPage->WriteCacheEnable = (DevExt->Config.WriteBack != 0);
+
+    Length = HeaderLength + sizeof(MODE_CACHING_PAGE);
+
+    DeviceSpecific = 0;
+    if (virtio_is_feature_enabled(DevExt->Features, VIRTIO_BLK_F_RO))
+        DeviceSpecific = MODE_DSP_WRITE_PROTECT;
+
+    if (IsModeSense10)
+    {
+        PMODE_PARAMETER_HEADER10 Header = (PMODE_PARAMETER_HEADER10)Buffer;
+
+        Header->ModeDataLength[1] = (UCHAR)(Length - RTL_SIZEOF_THROUGH_FIELD(MODE_PARAMETER_HEADER10,
+                                                                             ModeDataLength));
+        Header->DeviceSpecificParameter = DeviceSpecific;
+    }
+    else
+    {
+        PMODE_PARAMETER_HEADER Header = (PMODE_PARAMETER_HEADER)Buffer;
+
+        Header->ModeDataLength = (UCHAR)(Length - RTL_SIZEOF_THROUGH_FIELD(MODE_PARAMETER_HEADER,
+                                                                          ModeDataLength));
+        Header->DeviceSpecificParameter = DeviceSpecific;
+    }
+
+    ViostorReturnData(Srb, Buffer, Length);
+}
+
+BOOLEAN
+NTAPI
+ViostorExecuteScsi(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PCDB Cdb = (PCDB)Srb->Cdb;
+    ULONGLONG Lba;
+    ULONG Lba32, Blocks;
+
+    switch (Srb->Cdb[0])
+    {
+        case SCSIOP_READ:
+        case SCSIOP_WRITE:
+            Lba32 = ((ULONG)Cdb->CDB10.LogicalBlockByte0 << 24) |
+                    ((ULONG)Cdb->CDB10.LogicalBlockByte1 << 16) |
+                    ((ULONG)Cdb->CDB10.LogicalBlockByte2 << 8) |
+                    Cdb->CDB10.LogicalBlockByte3;
+            Blocks = ((ULONG)Cdb->CDB10.TransferBlocksMsb << 8) |
+                     Cdb->CDB10.TransferBlocksLsb;
+
+            return ViostorReadWrite(DevExt,
+                                    Srb,
+                                    Lba32,
+                                    Blocks,
+                                    Srb->Cdb[0] == SCSIOP_WRITE);
+
+        case SCSIOP_READ16:
+        case SCSIOP_WRITE16:
+            REVERSE_BYTES_QUAD(&Lba, Cdb->CDB16.LogicalBlock);
+            REVERSE_BYTES(&Blocks, Cdb->CDB16.TransferLength);
+
+            return ViostorReadWrite(DevExt,
+                                    Srb,
+                                    Lba,
+                                    Blocks,
+                                    Srb->Cdb[0] == SCSIOP_WRITE16);
+
+        case SCSIOP_SYNCHRONIZE_CACHE:
+        case SCSIOP_SYNCHRONIZE_CACHE16:
+            return ViostorFlush(DevExt, Srb);
+
+        case SCSIOP_UNMAP:
+            return ViostorUnmap(DevExt, Srb);
+
+        case SCSIOP_WRITE_SAME:
+        case SCSIOP_WRITE_SAME16:
+            return ViostorWriteSame(DevExt, Srb);
+
+        case SCSIOP_INQUIRY:
+            ViostorInquiry(DevExt, Srb);
+            break;
+
+        case SCSIOP_READ_CAPACITY:
+            ViostorReadCapacity(DevExt, Srb);
+            break;
+
+        case SCSIOP_SERVICE_ACTION_IN16:
+            if ((Srb->Cdb[1] & 0x1F) == SERVICE_ACTION_READ_CAPACITY16)
+                ViostorReadCapacity16(DevExt, Srb);
+            else
+                ViostorSetInvalidCdb(Srb);
+            break;
+
+        case SCSIOP_MODE_SENSE:
+        case SCSIOP_MODE_SENSE10:
+            ViostorModeSense(DevExt, Srb);
+            break;
+
+        case SCSIOP_TEST_UNIT_READY:
+        case SCSIOP_START_STOP_UNIT:
+        case SCSIOP_MEDIUM_REMOVAL:
+        case SCSIOP_VERIFY:
+        case SCSIOP_VERIFY16:
+        case SCSIOP_RESERVE_UNIT:
+        case SCSIOP_RELEASE_UNIT:
+            Srb->DataTransferLength = 0;
+            Srb->SrbStatus = SRB_STATUS_SUCCESS;
+            break;
+
+        default:
+            DPRINT("Unsupported SCSI command %02x\n", Srb->Cdb[0]);
+            ViostorSetSense(Srb,
+                            SRB_STATUS_ERROR,
+                            SCSI_SENSE_ILLEGAL_REQUEST,
+                            SCSI_ADSENSE_ILLEGAL_COMMAND);
+            break;
+    }
+
+    return FALSE;
+}
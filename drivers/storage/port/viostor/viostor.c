@@ -0,0 +1,841 @@
+/*
+ * PROJECT:     ReactOS VirtIO Block Miniport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Device setup, request queue and interrupt handling
+ */
+
+#include "viostor.h"
+#include "kdebugprint.h"
+
+#define NDEBUG
+#include <debug.h>
+
+/* The lower 64K are never mapped, so a register address below that is a port */
+#define VIOSTOR_PORT_MASK 0xFFFF
+
+int virtioDebugLevel = 0;
+int bDebugPrint = 0;
+tDebugPrintFunc VirtioDebugPrintProc = (tDebugPrintFunc)DbgPrint;
+
+static const UCHAR ViostorFeatures[] =
+{
+    VIRTIO_F_VERSION_1,
+    VIRTIO_RING_F_INDIRECT_DESC,
+    VIRTIO_RING_F_EVENT_IDX,
+    VIRTIO_BLK_F_SEG_MAX,
+    VIRTIO_BLK_F_RO,
+    VIRTIO_BLK_F_BLK_SIZE,
+    VIRTIO_BLK_F_FLUSH,
+    VIRTIO_BLK_F_TOPOLOGY,
+    VIRTIO_BLK_F_CONFIG_WCE,
+    VIRTIO_BLK_F_DISCARD,
+    VIRTIO_BLK_F_WRITE_ZEROES
+};
+
+static
+u8
+ViostorReadByte(
+    _In_ ULONG_PTR Register)
+{
+    if (Register & ~VIOSTOR_PORT_MASK)
+        return ScsiPortReadRegisterUchar((PUCHAR)Register);
+
+    return ScsiPortReadPortUchar((PUCHAR)Register);
+}
+
+static
+u16
+ViostorReadWord(
+    _In_ ULONG_PTR Register)
+{
+    if (Register & ~VIOSTOR_PORT_MASK)
+        return ScsiPortReadRegisterUshort((PUSHORT)Register);
+
+    return ScsiPortReadPortUshort((PUSHORT)Register);
+}
+
+static
+u32
+ViostorReadDword(
+    _In_ ULONG_PTR Register)
+{
+    if (Register & ~VIOSTOR_PORT_MASK)
+        return ScsiPortReadRegisterUlong((PULONG)Register);
+
+    return ScsiPortReadPortUlong((PULONG)Register);
+}
+
+static
+void
+ViostorWriteByte(
+    _In_ ULONG_PTR Register,
+    _In_ u8 Value)
+{
+    if (Register & ~VIOSTOR_PORT_MASK)
+        ScsiPortWriteRegisterUchar((PUCHAR)Register, Value);
+    else
+        ScsiPortWritePortUchar((PUCHAR)Register, Value);
+}
+
+static
+void
+ViostorWriteWord(
+    _In_ ULONG_PTR Register,
+    _In_ u16 Value)
+{
+    if (Register & ~VIOSTOR_PORT_MASK)
+        ScsiPortWriteRegisterUshort((PUSHORT)Register, Value);
+    else
+        ScsiPortWritePortUshort((PUSHORT)Register, Value);
+}
+
+static
+void
+ViostorWriteDword(
+    _In_ ULONG_PTR Register,
+    _In_ u32 Value)
+{
+    if (Register & ~VIOSTOR_PORT_MASK)
+        ScsiPortWriteRegisterUlong((PULONG)Register, Value);
+    else
+        ScsiPortWritePortUlong((PULONG)Register, Value);
+}
+
+/*
+ * scsiport hands out a single uncached extension per adapter, so the ring
+ * and the bookkeeping the library asks for are carved out of it in order.
+ * Nothing is returned before the device is reset, hence no free.
+ */
+static
+void *
+ViostorAllocQueueMemory(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ ULONG Size,
+    _In_ ULONG Alignment)
+{
+    ULONG Offset;
+
+    Offset = ALIGN_UP_BY(DevExt->QueueMemoryUsed, Alignment);
+
+    if (Offset + Size > DevExt->QueueMemorySize)
+    {
+        DPRINT1("Out of queue memory, %lu + %lu > %lu\n",
+                Offset,
+                Size,
+                DevExt->QueueMemorySize);
+        return NULL;
+    }
+
+    DevExt->QueueMemoryUsed = Offset + Size;
+
+    return DevExt->QueueMemory + Offset;
+}
+
+static
+void *
+ViostorAllocContiguousPages(
+    _In_ void *Context,
+    _In_ size_t Size)
+{
+    return ViostorAllocQueueMemory(Context, (ULONG)Size, PAGE_SIZE);
+}
+
+static
+void
+ViostorFreeContiguousPages(
+    _In_ void *Context,
+    _In_ void *Va)
+{
+    UNREFERENCED_PARAMETER(Context);
+    UNREFERENCED_PARAMETER(Va);
+}
+
+static
+ULONGLONG
+ViostorGetPhysicalAddress(
+    _In_ void *Context,
+    _In_ void *Va)
+{
+    ULONG Length;
+
+    return ScsiPortGetPhysicalAddress(Context, NULL, Va, &Length).QuadPart;
+}
+
+static
+void *
+ViostorAllocNonPagedBlock(
+    _In_ void *Context,
+    _In_ size_t Size)
+{
+    return ViostorAllocQueueMemory(Context, (ULONG)Size, SMP_CACHE_BYTES);
+}
+
+static
+void
+ViostorFreeNonPagedBlock(
+    _In_ void *Context,
+    _In_ void *Va)
+{
+    UNREFERENCED_PARAMETER(Context);
+    UNREFERENCED_PARAMETER(Va);
+}
+
+static
+int
+ViostorReadPciConfigByte(
+    _In_ void *Context,
+    _In_ int Where,
+    _Out_ u8 *Value)
+{
+    PVIOSTOR_DEVICE_EXTENSION DevExt = Context;
+
+    if (Where < 0 || Where + sizeof(*Value) > sizeof(DevExt->PciConfig))
+        return -1;
+
+    *Value = DevExt->PciConfig[Where];
+    return 0;
+}
+
+static
+int
+ViostorReadPciConfigWord(
+    _In_ void *Context,
+    _In_ int Where,
+    _Out_ u16 *Value)
+{
+    PVIOSTOR_DEVICE_EXTENSION DevExt = Context;
+
+    if (Where < 0 || Where + sizeof(*Value) > sizeof(DevExt->PciConfig))
+        return -1;
+
+    RtlCopyMemory(Value, &DevExt->PciConfig[Where], sizeof(*Value));
+    return 0;
+}
+
+static
+int
+ViostorReadPciConfigDword(
+    _In_ void *Context,
+    _In_ int Where,
+    _Out_ u32 *Value)
+{
+    PVIOSTOR_DEVICE_EXTENSION DevExt = Context;
+
+    if (Where < 0 || Where + sizeof(*Value) > sizeof(DevExt->PciConfig))
+        return -1;
+
+    RtlCopyMemory(Value, &DevExt->PciConfig[Where], sizeof(*Value));
+    return 0;
+}
+
+static
+size_t
+ViostorGetResourceLength(
+    _In_ void *Context,
+    _In_ int Bar)
+{
+    PVIOSTOR_DEVICE_EXTENSION DevExt = Context;
+
+    if (Bar < 0 || Bar >= VIOSTOR_MAX_BARS)
+        return 0;
+
+    return DevExt->Bars[Bar].Length;
+}
+
+static
+void *
+ViostorMapAddressRange(
+    _In_ void *Context,
+    _In_ int Bar,
+    _In_ size_t Offset,
+    _In_ size_t MaxLength)
+{
+    PVIOSTOR_DEVICE_EXTENSION DevExt = Context;
+    PVIOSTOR_BAR DeviceBar;
+
+    if (Bar < 0 || Bar >= VIOSTOR_MAX_BARS)
+        return NULL;
+
+    DeviceBar = &DevExt->Bars[Bar];
+
+    if (!DeviceBar->BaseVA || Offset + MaxLength > DeviceBar->Length)
+        return NULL;
+
+    return (PUCHAR)DeviceBar->BaseVA + Offset;
+}
+
+static
+u16
+ViostorGetMsixVector(
+    _In_ void *Context,
+    _In_ int Queue)
+{
+    UNREFERENCED_PARAMETER(Context);
+    UNREFERENCED_PARAMETER(Queue);
+
+    /* scsiport only connects the line interrupt */
+    return VIRTIO_MSI_NO_VECTOR;
+}
+
+static
+void
+ViostorSleep(
+    _In_ void *Context,
+    _In_ unsigned int Milliseconds)
+{
+    UNREFERENCED_PARAMETER(Context);
+
+    ScsiPortStallExecution(Milliseconds * 1000);
+}
+
+static const VirtIOSystemOps ViostorSystemOps =
+{
+    ViostorReadByte,
+    ViostorReadWord,
+    ViostorReadDword,
+    ViostorWriteByte,
+    ViostorWriteWord,
+    ViostorWriteDword,
+    ViostorAllocContiguousPages,
+    ViostorFreeContiguousPages,
+    ViostorGetPhysicalAddress,
+    ViostorAllocNonPagedBlock,
+    ViostorFreeNonPagedBlock,
+    ViostorReadPciConfigByte,
+    ViostorReadPciConfigWord,
+    ViostorReadPciConfigDword,
+    ViostorGetResourceLength,
+    ViostorMapAddressRange,
+    ViostorGetMsixVector,
+    ViostorSleep
+};
+
+#define VIOSTOR_READ_CONFIG(DevExt, Field) \
+    virtio_get_config(&(DevExt)->VDevice, \
+                      FIELD_OFFSET(VIRTIO_BLK_CONFIG, Field), \
+                      &(DevExt)->Config.Field, \
+                      RTL_FIELD_SIZE(VIRTIO_BLK_CONFIG, Field))
+
+static
+VOID
+ViostorReadConfig(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt)
+{
+    ULONGLONG Features = DevExt->Features;
+
+    /* Only read what the negotiated features say is there */
+    RtlZeroMemory(&DevExt->Config, sizeof(DevExt->Config));
+    VIOSTOR_READ_CONFIG(DevExt, Capacity);
+
+    if (virtio_is_feature_enabled(Features, VIRTIO_BLK_F_SEG_MAX))
+        VIOSTOR_READ_CONFIG(DevExt, SegMax);
+
+    if (virtio_is_feature_enabled(Features, VIRTIO_BLK_F_BLK_SIZE))
+        VIOSTOR_READ_CONFIG(DevExt, BlockSize);
+
+    if (virtio_is_feature_enabled(Features, VIRTIO_BLK_F_TOPOLOGY))
+    {
+        VIOSTOR_READ_CONFIG(DevExt, PhysicalBlockExp);
+        VIOSTOR_READ_CONFIG(DevExt, AlignmentOffset);
+        VIOSTOR_READ_CONFIG(DevExt, MinIoSize);
+        VIOSTOR_READ_CONFIG(DevExt, OptIoSize);
+    }
+
+    if (virtio_is_feature_enabled(Features, VIRTIO_BLK_F_CONFIG_WCE))
+        VIOSTOR_READ_CONFIG(DevExt, WriteBack);
+    else
+        DevExt->Config.WriteBack = virtio_is_feature_enabled(Features, VIRTIO_BLK_F_FLUSH);
+
+    if (virtio_is_feature_enabled(Features, VIRTIO_BLK_F_DISCARD))
+    {
+        VIOSTOR_READ_CONFIG(DevExt, MaxDiscardSectors);
+        VIOSTOR_READ_CONFIG(DevExt, MaxDiscardSeg);
+        VIOSTOR_READ_CONFIG(DevExt, DiscardSectorAlignment);
+    }
+
+    if (virtio_is_feature_enabled(Features, VIRTIO_BLK_F_WRITE_ZEROES))
+    {
+        VIOSTOR_READ_CONFIG(DevExt, MaxWriteZeroesSectors);
+        VIOSTOR_READ_CONFIG(DevExt, MaxWriteZeroesSeg);
+        VIOSTOR_READ_CONFIG(DevExt, WriteZeroesMayUnmap);
+    }
+
+    DevExt->BlockSize = VIRTIO_BLK_SECTOR_SIZE;
+    if (DevExt->Config.BlockSize >= VIRTIO_BLK_SECTOR_SIZE &&
+        (DevExt->Config.BlockSize & (DevExt->Config.BlockSize - 1)) == 0)
+    {
+        DevExt->BlockSize = DevExt->Config.BlockSize;
+    }
+
+    DevExt->SectorsPerBlock = DevExt->BlockSize >> VIRTIO_BLK_SECTOR_SHIFT;
+    DevExt->LastLba = DevExt->Config.Capacity / DevExt->SectorsPerBlock;
+    if (DevExt->LastLba != 0)
+        DevExt->LastLba--;
+
+    DPRINT1("VIOSTOR: %I64u sectors, block %lu, features %I64x\n",
+            DevExt->Config.Capacity,
+            DevExt->BlockSize,
+            Features);
+}
+
+static
+ULONG
+NTAPI
+ViostorFindAdapter(
+    _In_ PVOID HwDeviceExtension,
+    _In_ PVOID HwContext,
+    _In_ PVOID BusInformation,
+    _In_ PCHAR ArgumentString,
+    _Inout_ PPORT_CONFIGURATION_INFORMATION ConfigInfo,
+    _Out_ PBOOLEAN Again)
+{
+    PVIOSTOR_DEVICE_EXTENSION DevExt = HwDeviceExtension;
+    PACCESS_RANGE AccessRange;
+    PVIOSTOR_BAR Bar;
+    ULONGLONG HostFeatures;
+    USHORT NumEntries;
+    ULONG RingSize, HeapSize;
+    NTSTATUS Status;
+    ULONG i;
+    int BarIndex;
+
+    UNREFERENCED_PARAMETER(HwContext);
+    UNREFERENCED_PARAMETER(BusInformation);
+    UNREFERENCED_PARAMETER(ArgumentString);
+
+    *Again = FALSE;
+
+    if (ScsiPortGetBusData(DevExt,
+                           PCIConfiguration,
+                           ConfigInfo->SystemIoBusNumber,
+                           ConfigInfo->SlotNumber,
+                           DevExt->PciConfig,
+                           sizeof(DevExt->PciConfig)) != sizeof(DevExt->PciConfig))
+    {
+        DPRINT1("Cannot read the PCI configuration space\n");
+        return SP_RETURN_NOT_FOUND;
+    }
+
+    for (i = 0; i < ConfigInfo->NumberOfAccessRanges; i++)
+    {
+        AccessRange = &(*ConfigInfo->AccessRanges)[i];
+
+        if (AccessRange->RangeLength == 0)
+            continue;
+
+        BarIndex = virtio_get_bar_index((PPCI_COMMON_HEADER)DevExt->PciConfig,
+                                        AccessRange->RangeStart);
+        if (BarIndex < 0 || BarIndex >= VIOSTOR_MAX_BARS)
+            continue;
+
+        Bar = &DevExt->Bars[BarIndex];
+        Bar->BasePA = AccessRange->RangeStart;
+        Bar->Length = AccessRange->RangeLength;
+        Bar->InIoSpace = !AccessRange->RangeInMemory;
+        Bar->BaseVA = ScsiPortGetDeviceBase(DevExt,
+                                            ConfigInfo->AdapterInterfaceType,
+                                            ConfigInfo->SystemIoBusNumber,
+                                            AccessRange->RangeStart,
+                                            AccessRange->RangeLength,
+                                            Bar->InIoSpace);
+        if (!Bar->BaseVA)
+        {
+            DPRINT1("Cannot map BAR %d\n", BarIndex);
+            return SP_RETURN_ERROR;
+        }
+    }
+
+    Status = virtio_device_initialize(&DevExt->VDevice, &ViostorSystemOps, DevExt, FALSE);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("virtio_device_initialize() failed with %lx\n", Status);
+        return SP_RETURN_NOT_FOUND;
+    }
+
+    HostFeatures = virtio_get_features(&DevExt->VDevice);
+
+    DevExt->Features = 0;
+    for (i = 0; i < RTL_NUMBER_OF(ViostorFeatures); i++)
+    {
+        if (virtio_is_feature_enabled(HostFeatures, ViostorFeatures[i]))
+            virtio_feature_enable(DevExt->Features, ViostorFeatures[i]);
+    }
+
+    Status = virtio_set_features(&DevExt->VDevice, DevExt->Features);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("virtio_set_features() failed with %lx\n", Status);
+        goto Failed;
+    }
+
+    ViostorReadConfig(DevExt);
+
+    Status = virtio_query_queue_allocation(&DevExt->VDevice,
+                                           0,
+                                           &NumEntries,
+                                           &RingSize,
+                                           &HeapSize);
+    if (!NT_SUCCESS(Status) || NumEntries < 3)
+    {
+        DPRINT1("No usable request queue, status %lx\n", Status);
+        goto Failed;
+    }
+
+    DevExt->QueueSize = NumEntries;
+    DevExt->FreeDescriptors = NumEntries;
+
+    /* With indirect descriptors every request takes a single ring slot */
+    DevExt->MaxDataSg = VIOSTOR_MAX_DATA_SG;
+    if (DevExt->Config.SegMax != 0 && DevExt->Config.SegMax < DevExt->MaxDataSg)
+        DevExt->MaxDataSg = DevExt->Config.SegMax;
+    if (!virtio_is_feature_enabled(DevExt->Features, VIRTIO_RING_F_INDIRECT_DESC) &&
+        NumEntries - 2 < DevExt->MaxDataSg)
+    {
+        DevExt->MaxDataSg = NumEntries - 2;
+    }
+
+    ConfigInfo->NumberOfBuses = 1;
+    ConfigInfo->MaximumNumberOfTargets = 2;
+    ConfigInfo->MaximumNumberOfLogicalUnits = 1;
+    ConfigInfo->InitiatorBusId[0] = 1;
+    ConfigInfo->MaximumTransferLength = (DevExt->MaxDataSg - 1) * PAGE_SIZE;
+    ConfigInfo->NumberOfPhysicalBreaks = DevExt->MaxDataSg - 1;
+    ConfigInfo->ScatterGather = TRUE;
+    ConfigInfo->Master = TRUE;
+    ConfigInfo->NeedPhysicalAddresses = TRUE;
+    ConfigInfo->MapBuffers = TRUE;
+    ConfigInfo->Dma32BitAddresses = TRUE;
+    ConfigInfo->TaggedQueuing = TRUE;
+    ConfigInfo->MultipleRequestPerLu = TRUE;
+    ConfigInfo->AutoRequestSense = TRUE;
+    ConfigInfo->CachesData = (DevExt->Config.WriteBack != 0);
+    ConfigInfo->InterruptMode = LevelSensitive;
+    ConfigInfo->SrbExtensionSize = sizeof(VIOSTOR_SRB_EXTENSION);
+
+    DevExt->QueueMemorySize = ROUND_TO_PAGES(RingSize) + ROUND_TO_PAGES(HeapSize);
+    DevExt->QueueMemoryUsed = 0;
+    DevExt->QueueMemory = ScsiPortGetUncachedExtension(DevExt,
+                                                       ConfigInfo,
+                                                       DevExt->QueueMemorySize);
+    if (!DevExt->QueueMemory)
+    {
+        DPRINT1("Cannot allocate %lu bytes for the request queue\n", DevExt->QueueMemorySize);
+        goto Failed;
+    }
+
+    Status = virtio_find_queues(&DevExt->VDevice, 1, &DevExt->RequestQueue);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("virtio_find_queues() failed with %lx\n", Status);
+        goto Failed;
+    }
+
+    return SP_RETURN_FOUND;
+
+Failed:
+    virtio_add_status(&DevExt->VDevice, VIRTIO_CONFIG_S_FAILED);
+    virtio_device_shutdown(&DevExt->VDevice);
+    return SP_RETURN_ERROR;
+}
+
+static
+BOOLEAN
+NTAPI
+ViostorInitialize(
+    _In_ PVOID HwDeviceExtension)
+{
+    PVIOSTOR_DEVICE_EXTENSION DevExt = HwDeviceExtension;
+
+    virtio_device_ready(&DevExt->VDevice);
+
+    return TRUE;
+}
+
+static
+BOOLEAN
+ViostorHasRoom(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt)
+{
+    if (virtio_is_feature_enabled(DevExt->Features, VIRTIO_RING_F_INDIRECT_DESC))
+        return DevExt->FreeDescriptors >= 1;
+
+    return DevExt->FreeDescriptors >= DevExt->MaxDataSg + 2;
+}
+
+/*
+ * Ask for the next request only while the ring can take the largest one,
+ * otherwise the interrupt handler does it once descriptors come back.
+ */
+static
+VOID
+ViostorRequestNext(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt)
+{
+    if (ViostorHasRoom(DevExt))
+    {
+        DevExt->NextRequestPending = FALSE;
+        ScsiPortNotification(NextLuRequest, DevExt, 0, 0, 0);
+    }
+    else
+    {
+        DevExt->NextRequestPending = TRUE;
+    }
+}
+
+BOOLEAN
+NTAPI
+ViostorSubmitRequest(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _In_ ULONG OutCount,
+    _In_ ULONG InCount)
+{
+    PVIOSTOR_SRB_EXTENSION SrbExt = Srb->SrbExtension;
+    struct virtqueue *Queue = DevExt->RequestQueue;
+    PVOID IndirectVa = NULL;
+    ULONGLONG IndirectPa = 0;
+    ULONG Length;
+    int Result;
+
+    if (virtio_is_feature_enabled(DevExt->Features, VIRTIO_RING_F_INDIRECT_DESC) &&
+        (OutCount + InCount) > 1)
+    {
+        IndirectVa = SrbExt->IndirectTable;
+        IndirectPa = ScsiPortGetPhysicalAddress(DevExt, NULL, IndirectVa, &Length).QuadPart;
+        SrbExt->DescriptorCount = 1;
+    }
+    else
+    {
+        SrbExt->DescriptorCount = OutCount + InCount;
+    }
+
+    if (SrbExt->DescriptorCount > DevExt->FreeDescriptors)
+        return FALSE;
+
+    Result = virtqueue_add_buf(Queue,
+                               SrbExt->Sg,
+                               OutCount,
+                               InCount,
+                               Srb,
+                               IndirectVa,
+                               IndirectPa);
+    if (Result < 0)
+    {
+        DPRINT1("virtqueue_add_buf() failed with %d\n", Result);
+        return FALSE;
+    }
+
+    DevExt->FreeDescriptors -= SrbExt->DescriptorCount;
+
+    /* The device tells through the event index whether it is still polling */
+    if (virtqueue_kick_prepare(Queue))
+        virtqueue_notify(Queue);
+
+    return TRUE;
+}
+
+static
+VOID
+ViostorCompleteRequest(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PVIOSTOR_SRB_EXTENSION SrbExt = Srb->SrbExtension;
+
+    switch (SrbExt->Status)
+    {
+        case VIRTIO_BLK_S_OK:
+            Srb->SrbStatus = SRB_STATUS_SUCCESS;
+            Srb->ScsiStatus = SCSISTAT_GOOD;
+            break;
+
+        case VIRTIO_BLK_S_UNSUPP:
+            ViostorSetSense(Srb,
+                            SRB_STATUS_ERROR,
+                            SCSI_SENSE_ILLEGAL_REQUEST,
+                            SCSI_ADSENSE_ILLEGAL_COMMAND);
+            break;
+
+        default:
+            DPRINT1("Request %p of type %lu failed with %u\n",
+                    Srb,
+                    SrbExt->Header.Type,
+                    SrbExt->Status);
+            ViostorSetSense(Srb,
+                            SRB_STATUS_ERROR,
+                            SCSI_SENSE_MEDIUM_ERROR,
+                            SCSI_ADSENSE_NO_SENSE);
+            break;
+    }
+
+    ScsiPortNotification(RequestComplete, DevExt, Srb);
+}
+
+static
+BOOLEAN
+NTAPI
+ViostorInterrupt(
+    _In_ PVOID HwDeviceExtension)
+{
+    PVIOSTOR_DEVICE_EXTENSION DevExt = HwDeviceExtension;
+    struct virtqueue *Queue = DevExt->RequestQueue;
+    PSCSI_REQUEST_BLOCK Srb;
+    PVIOSTOR_SRB_EXTENSION SrbExt;
+    unsigned int Length;
+
+    /* Reading the ISR status deasserts the line, zero means it was not us */
+    if (virtio_read_isr_status(&DevExt->VDevice) == 0)
+        return FALSE;
+
+    /*
+     * Keep the device from interrupting while the used ring is drained,
+     * then publish how far we got and look again for anything that
+     * slipped in before the event index was updated.
+     */
+    do
+    {
+        virtqueue_disable_cb(Queue);
+
+        while ((Srb = virtqueue_get_buf(Queue, &Length)) != NULL)
+        {
+            SrbExt = Srb->SrbExtension;
+            DevExt->FreeDescriptors += SrbExt->DescriptorCount;
+
+            ViostorCompleteRequest(DevExt, Srb);
+        }
+    } while (!virtqueue_enable_cb(Queue));
+
+    if (DevExt->NextRequestPending)
+        ViostorRequestNext(DevExt);
+
+    return TRUE;
+}
+
+static
+BOOLEAN
+NTAPI
+ViostorStartIo(
+    _In_ PVOID HwDeviceExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PVIOSTOR_DEVICE_EXTENSION DevExt = HwDeviceExtension;
+    BOOLEAN Pending = FALSE;
+
+    if (Srb->PathId != 0 || Srb->TargetId != 0 || Srb->Lun != 0)
+    {
+        Srb->SrbStatus = SRB_STATUS_SELECTION_TIMEOUT;
+        goto Complete;
+    }
+
+    switch (Srb->Function)
+    {
+        case SRB_FUNCTION_EXECUTE_SCSI:
+            Pending = ViostorExecuteScsi(DevExt, Srb);
+            break;
+
+        case SRB_FUNCTION_FLUSH:
+        case SRB_FUNCTION_SHUTDOWN:
+            Pending = ViostorFlush(DevExt, Srb);
+            break;
+
+        case SRB_FUNCTION_RESET_BUS:
+        case SRB_FUNCTION_RESET_DEVICE:
+        case SRB_FUNCTION_RESET_LOGICAL_UNIT:
+            /* Requests the device already owns complete on their own */
+            Srb->SrbStatus = SRB_STATUS_SUCCESS;
+            break;
+
+        case SRB_FUNCTION_ABORT_COMMAND:
+            Srb->SrbStatus = SRB_STATUS_ABORT_FAILED;
+            break;
+
+        default:
+            Srb->SrbStatus = SRB_STATUS_INVALID_REQUEST;
+            break;
+    }
+
+Complete:
+    if (!Pending)
+        ScsiPortNotification(RequestComplete, DevExt, Srb);
+
+    ViostorRequestNext(DevExt);
+
+    return TRUE;
+}
+
+static
+BOOLEAN
+NTAPI
+ViostorResetBus(
+    _In_ PVOID HwDeviceExtension,
+    _In_ ULONG PathId)
+{
+    UNREFERENCED_PARAMETER(HwDeviceExtension);
+    UNREFERENCED_PARAMETER(PathId);
+
+    /*
+     * The device has no bus to reset and keeps every request it was given,
+     * so there is nothing to complete here; they come back through the
+     * used ring as usual.
+     */
+    return TRUE;
+}
+
+static
+ULONG
+ViostorInitializeForDevice(
+    _In_ PVOID DriverObject,
+    _In_ PVOID Argument2,
+    _In_ PCHAR DeviceId)
+{
+    HW_INITIALIZATION_DATA HwInitializationData;
+    UCHAR VendorId[4] = { '1', 'a', 'f', '4' };
+
+    RtlZeroMemory(&HwInitializationData, sizeof(HwInitializationData));
+
+    HwInitializationData.HwInitializationDataSize = sizeof(HW_INITIALIZATION_DATA);
+    HwInitializationData.AdapterInterfaceType = PCIBus;
+
+    HwInitializationData.HwInitialize = ViostorInitialize;
+    HwInitializationData.HwStartIo = ViostorStartIo;
+    HwInitializationData.HwInterrupt = ViostorInterrupt;
+    HwInitializationData.HwFindAdapter = ViostorFindAdapter;
+    HwInitializationData.HwResetBus = ViostorResetBus;
+
+    HwInitializationData.DeviceExtensionSize = sizeof(VIOSTOR_DEVICE_EXTENSION);
+    HwInitializationData.SrbExtensionSize = sizeof(VIOSTOR_SRB_EXTENSION);
+    HwInitializationData.NumberOfAccessRanges = VIOSTOR_MAX_BARS;
+
+    HwInitializationData.NeedPhysicalAddresses = TRUE;
+    HwInitializationData.MapBuffers = TRUE;
+    HwInitializationData.AutoRequestSense = TRUE;
+    HwInitializationData.TaggedQueuing = TRUE;
+    HwInitializationData.MultipleRequestPerLu = TRUE;
+
+    HwInitializationData.VendorId = VendorId;
+    HwInitializationData.VendorIdLength = sizeof(VendorId);
+    HwInitializationData.DeviceId = DeviceId;
+    HwInitializationData.DeviceIdLength = 4;
+
+    return ScsiPortInitialize(DriverObject, Argument2, &HwInitializationData, NULL);
+}
+
+ULONG
+NTAPI
+DriverEntry(
+    _In_ PVOID DriverObject,
+    _In_ PVOID Argument2)
+{
+    ULONG TransitionalStatus, ModernStatus;
+
+    DPRINT("DriverEntry(%p %p)\n", DriverObject, Argument2);
+
+    /* The transitional device and the VERSION_1 only one */
+    TransitionalStatus = ViostorInitializeForDevice(DriverObject, Argument2, "1001");
+    ModernStatus = ViostorInitializeForDevice(DriverObject, Argument2, "1042");
+
+    if (NT_SUCCESS(TransitionalStatus))
+        return TransitionalStatus;
+
+    return ModernStatus;
+}
@@ -0,0 +1,189 @@
+/*
+ * PROJECT:     ReactOS VirtIO Block Miniport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     VIOSTOR declarations
+ */
+
+#ifndef _VIOSTOR_PCH_
+#define _VIOSTOR_PCH_
+
+#include <ntddk.h>
+#include <srb.h>
+#include <scsi.h>
+
+#include "osdep.h"
+#include "virtio_pci.h"
+#include "VirtIO.h"
+
+/* Feature bits of the block device */
+#define VIRTIO_BLK_F_SIZE_MAX       1
+#define VIRTIO_BLK_F_SEG_MAX        2
+#define VIRTIO_BLK_F_GEOMETRY       4
+#define VIRTIO_BLK_F_RO             5
+#define VIRTIO_BLK_F_BLK_SIZE       6
+#define VIRTIO_BLK_F_FLUSH          9
+#define VIRTIO_BLK_F_TOPOLOGY       10
+#define VIRTIO_BLK_F_CONFIG_WCE     11
+#define VIRTIO_BLK_F_MQ             12
+#define VIRTIO_BLK_F_DISCARD        13
+#define VIRTIO_BLK_F_WRITE_ZEROES   14
+
+/* Request types */
+#define VIRTIO_BLK_T_IN             0
+#define VIRTIO_BLK_T_OUT            1
+#define VIRTIO_BLK_T_FLUSH          4
+#define VIRTIO_BLK_T_GET_ID         8
+#define VIRTIO_BLK_T_DISCARD        11
+#define VIRTIO_BLK_T_WRITE_ZEROES   13
+
+/* Request status, written by the device into the last byte of the chain */
+#define VIRTIO_BLK_S_OK             0
+#define VIRTIO_BLK_S_IOERR          1
+#define VIRTIO_BLK_S_UNSUPP         2
+
+#define VIRTIO_BLK_WRITE_ZEROES_FLAG_UNMAP  0x00000001
+
+/* Sector size the device counts in, whatever its logical block size */
+#define VIRTIO_BLK_SECTOR_SIZE      512
+#define VIRTIO_BLK_SECTOR_SHIFT     9
+
+#include <pshpack1.h>
+typedef struct _VIRTIO_BLK_CONFIG
+{
+    ULONGLONG Capacity;
+    ULONG SizeMax;
+    ULONG SegMax;
+    USHORT Cylinders;
+    UCHAR Heads;
+    UCHAR Sectors;
+    ULONG BlockSize;
+    UCHAR PhysicalBlockExp;
+    UCHAR AlignmentOffset;
+    USHORT MinIoSize;
+    ULONG OptIoSize;
+    UCHAR WriteBack;
+    UCHAR Unused0;
+    USHORT NumQueues;
+    ULONG MaxDiscardSectors;
+    ULONG MaxDiscardSeg;
+    ULONG DiscardSectorAlignment;
+    ULONG MaxWriteZeroesSectors;
+    ULONG MaxWriteZeroesSeg;
+    UCHAR WriteZeroesMayUnmap;
+    UCHAR Unused1[3];
+} VIRTIO_BLK_CONFIG, *PVIRTIO_BLK_CONFIG;
+#include <poppack.h>
+
+C_ASSERT(sizeof(VIRTIO_BLK_CONFIG) == 60);
+
+typedef struct _VIRTIO_BLK_OUTHDR
+{
+    ULONG Type;
+    ULONG IoPriority;
+    ULONGLONG Sector;
+} VIRTIO_BLK_OUTHDR, *PVIRTIO_BLK_OUTHDR;
+
+typedef struct _VIRTIO_BLK_DISCARD_WRITE_ZEROES
+{
+    ULONGLONG Sector;
+    ULONG NumSectors;
+    ULONG Flags;
+} VIRTIO_BLK_DISCARD_WRITE_ZEROES, *PVIRTIO_BLK_DISCARD_WRITE_ZEROES;
+
+/* Layout of a ring descriptor, which the library keeps to itself */
+typedef struct _VIOSTOR_VRING_DESC
+{
+    ULONGLONG Address;
+    ULONG Length;
+    USHORT Flags;
+    USHORT Next;
+} VIOSTOR_VRING_DESC, *PVIOSTOR_VRING_DESC;
+
+/* Data elements per request, the header and the status take two more */
+#define VIOSTOR_MAX_DATA_SG         128
+#define VIOSTOR_MAX_SG              (VIOSTOR_MAX_DATA_SG + 2)
+
+/* Ranges a single UNMAP command can carry down to the device */
+#define VIOSTOR_MAX_DISCARD_SEG     16
+
+#define VIOSTOR_MAX_BARS            PCI_TYPE0_ADDRESSES
+
+/*
+ * Everything the device reads or writes besides the data buffer itself
+ * lives here. SRB extensions are carved out of the common buffer, so
+ * the indirect table is physically contiguous as the device requires.
+ */
+typedef struct _VIOSTOR_SRB_EXTENSION
+{
+    VIOSTOR_VRING_DESC IndirectTable[VIOSTOR_MAX_SG];
+    struct VirtIOBufferDescriptor Sg[VIOSTOR_MAX_SG];
+    VIRTIO_BLK_DISCARD_WRITE_ZEROES Ranges[VIOSTOR_MAX_DISCARD_SEG];
+    VIRTIO_BLK_OUTHDR Header;
+    ULONG DescriptorCount;
+    UCHAR Status;
+} VIOSTOR_SRB_EXTENSION, *PVIOSTOR_SRB_EXTENSION;
+
+typedef struct _VIOSTOR_BAR
+{
+    PHYSICAL_ADDRESS BasePA;
+    ULONG Length;
+    PVOID BaseVA;
+    BOOLEAN InIoSpace;
+} VIOSTOR_BAR, *PVIOSTOR_BAR;
+
+typedef struct _VIOSTOR_DEVICE_EXTENSION
+{
+    VirtIODevice VDevice;
+    struct virtqueue *RequestQueue;
+    VIOSTOR_BAR Bars[VIOSTOR_MAX_BARS];
+    UCHAR PciConfig[256];
+
+    /* Bump allocator over the uncached extension for the ring memory */
+    PUCHAR QueueMemory;
+    ULONG QueueMemorySize;
+    ULONG QueueMemoryUsed;
+
+    ULONGLONG Features;
+    VIRTIO_BLK_CONFIG Config;
+    ULONG BlockSize;
+    ULONG SectorsPerBlock;
+    ULONGLONG LastLba;
+    ULONG MaxDataSg;
+
+    /* Descriptors available in the request queue */
+    ULONG QueueSize;
+    ULONG FreeDescriptors;
+    BOOLEAN NextRequestPending;
+} VIOSTOR_DEVICE_EXTENSION, *PVIOSTOR_DEVICE_EXTENSION;
+
+/* viostor.c */
+BOOLEAN
+NTAPI
+ViostorSubmitRequest(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _In_ ULONG OutCount,
+    _In_ ULONG InCount);
+
+/* scsi.c */
+VOID
+NTAPI
+ViostorSetSense(
+    _In_ PSCSI_REQUEST_BLOCK Srb,
+    _In_ UCHAR SrbStatus,
+    _In_ UCHAR SenseKey,
+    _In_ UCHAR AdditionalSenseCode);
+
+BOOLEAN
+NTAPI
+ViostorExecuteScsi(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb);
+
+BOOLEAN
+NTAPI
+ViostorFlush(
+    _In_ PVIOSTOR_DEVICE_EXTENSION DevExt,
+    _In_ PSCSI_REQUEST_BLOCK Srb);
+
+#endif /* _VIOSTOR_PCH_ */
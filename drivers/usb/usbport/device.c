@@ -1175,7 +1175,8 @@ USBPORT_CreateDevice(IN OUT PUSB_DEVICE_HANDLE *pUsbdDeviceHandle,
             if (MaxPacketSize == 8 ||
                 MaxPacketSize == 16 ||
                 MaxPacketSize == 32 ||
-                MaxPacketSize == 64)
+                MaxPacketSize == 64 ||
+                MaxPacketSize == 9) // SuperSpeed, 2^9 bytes
             {
                 USBPORT_AddDeviceHandle(FdoDevice, DeviceHandle);
 
@@ -1362,7 +1363,11 @@ USBPORT_InitializeDevice(IN PUSBPORT_DEVICE_HANDLE DeviceHandle,
     DeviceHandle->DeviceAddress = DeviceAddress;
     Endpoint = DeviceHandle->PipeHandle.Endpoint;
 
-    Endpoint->EndpointProperties.TotalMaxPacketSize = DeviceHandle->DeviceDescriptor.bMaxPacketSize0;
+    if (DeviceHandle->DeviceDescriptor.bMaxPacketSize0 == 9)
+        Endpoint->EndpointProperties.TotalMaxPacketSize = 512;
+    else
+        Endpoint->EndpointProperties.TotalMaxPacketSize = DeviceHandle->DeviceDescriptor.bMaxPacketSize0;
+
     Endpoint->EndpointProperties.DeviceAddress = DeviceAddress;
 
     Status = USBPORT_ReopenPipe(FdoDevice, Endpoint);
@@ -1398,7 +1403,8 @@ USBPORT_InitializeDevice(IN PUSBPORT_DEVICE_HANDLE DeviceHandle,
         ASSERT((MaxPacketSize == 8) ||
                (MaxPacketSize == 16) ||
                (MaxPacketSize == 32) ||
-               (MaxPacketSize == 64));
+               (MaxPacketSize == 64) ||
+               (MaxPacketSize == 9));
 
         if (DeviceHandle->DeviceSpeed == UsbHighSpeed &&
             DeviceHandle->DeviceDescriptor.bDeviceClass == USB_DEVICE_CLASS_HUB)
@@ -0,0 +1,44 @@
+/*
+ * PROJECT:     ReactOS USB xHCI Miniport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     USBXHCI debugging functions
+ */
+
+#include "usbxhci.h"
+
+//#define NDEBUG
+#include <debug.h>
+
+VOID
+NTAPI
+XHCI_DumpTrb(IN PXHCI_TRB Trb)
+{
+    DPRINT(": Trb                - %p\n", Trb);
+    DPRINT(": Trb->Parameter[0]  - %lx\n", Trb->Parameter[0]);
+    DPRINT(": Trb->Parameter[1]  - %lx\n", Trb->Parameter[1]);
+    DPRINT(": Trb->Status        - %lx\n", Trb->Status);
+    DPRINT(": Trb->Control       - %lx, Type - %lu\n",
+           Trb->Control,
+           XHCI_TRB_GET_TYPE(Trb->Control));
+}
+
+VOID
+NTAPI
+XHCI_DumpRing(IN PXHCI_RING Ring)
+{
+    ULONG ix;
+
+    DPRINT(": Ring->FirstTrb   - %p\n", Ring->FirstTrb);
+    DPRINT(": Ring->FirstTrbPA - %lx\n", Ring->FirstTrbPA);
+    DPRINT(": Ring->TrbCount   - %lx\n", Ring->TrbCount);
+    DPRINT(": Ring->Enqueue    - %lx\n", Ring->Enqueue);
+    DPRINT(": Ring->CycleState - %lx\n", Ring->CycleState);
+
+    for (ix = 0; ix < Ring->TrbCount; ix++)
+    {
+        if (Ring->FirstTrb[ix].Control == 0)
+            continue;
+
+        XHCI_DumpTrb(&Ring->FirstTrb[ix]);
+    }
+}
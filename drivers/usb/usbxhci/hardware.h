@@ -0,0 +1,429 @@
+/*
+ * PROJECT:     ReactOS USB xHCI Miniport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     USBXHCI hardware declarations
+ */
+
+#define XHCI_MAX_PORTS  32 // Root hub ports handled by this driver
+
+/* Capability registers */
+typedef union _XHCI_HC_STRUCTURAL_PARAMS_1 {
+  struct {
+    ULONG MaxDeviceSlots : 8;
+    ULONG MaxInterrupters : 11;
+    ULONG Reserved1      : 5;
+    ULONG MaxPorts       : 8;
+  };
+  ULONG AsULONG;
+} XHCI_HC_STRUCTURAL_PARAMS_1;
+
+C_ASSERT(sizeof(XHCI_HC_STRUCTURAL_PARAMS_1) == sizeof(ULONG));
+
+typedef union _XHCI_HC_STRUCTURAL_PARAMS_2 {
+  struct {
+    ULONG IsochSchedulingThreshold : 4;
+    ULONG EventRingSegmentTableMax : 4;
+    ULONG Reserved1                : 13;
+    ULONG MaxScratchpadBuffersHi   : 5;
+    ULONG ScratchpadRestore        : 1;
+    ULONG MaxScratchpadBuffersLo   : 5;
+  };
+  ULONG AsULONG;
+} XHCI_HC_STRUCTURAL_PARAMS_2;
+
+C_ASSERT(sizeof(XHCI_HC_STRUCTURAL_PARAMS_2) == sizeof(ULONG));
+
+typedef union _XHCI_HC_CAPABILITY_PARAMS_1 {
+  struct {
+    ULONG Addressing64bitCapability  : 1;
+    ULONG BandwidthNegotiation       : 1;
+    ULONG ContextSize                : 1;
+    ULONG PortPowerControl           : 1;
+    ULONG PortIndicators             : 1;
+    ULONG LightHCResetCapability     : 1;
+    ULONG LatencyToleranceMessaging  : 1;
+    ULONG NoSecondarySidSupport      : 1;
+    ULONG ParseAllEventData          : 1;
+    ULONG StoppedShortPacket         : 1;
+    ULONG StoppedEDTLA               : 1;
+    ULONG ContiguousFrameId          : 1;
+    ULONG MaxPrimaryStreamArraySize  : 4;
+    ULONG ExtendedCapabilitiesPointer : 16;
+  };
+  ULONG AsULONG;
+} XHCI_HC_CAPABILITY_PARAMS_1;
+
+C_ASSERT(sizeof(XHCI_HC_CAPABILITY_PARAMS_1) == sizeof(ULONG));
+
+typedef struct _XHCI_HC_CAPABILITY_REGISTERS {
+  UCHAR RegistersLength;
+  UCHAR Reserved;
+  USHORT InterfaceVersion;
+  XHCI_HC_STRUCTURAL_PARAMS_1 StructParameters1;
+  XHCI_HC_STRUCTURAL_PARAMS_2 StructParameters2;
+  ULONG StructParameters3;
+  XHCI_HC_CAPABILITY_PARAMS_1 CapParameters1;
+  ULONG DoorbellOffset;
+  ULONG RuntimeRegistersOffset;
+  ULONG CapParameters2;
+} XHCI_HC_CAPABILITY_REGISTERS, *PXHCI_HC_CAPABILITY_REGISTERS;
+
+C_ASSERT(sizeof(XHCI_HC_CAPABILITY_REGISTERS) == 0x20);
+
+/* Extended capabilities */
+#define XHCI_XCAP_ID_LEGACY_SUPPORT      1
+#define XHCI_XCAP_ID_SUPPORTED_PROTOCOL  2
+
+typedef union _XHCI_EXTENDED_CAPABILITY {
+  struct {
+    ULONG CapabilityID          : 8;
+    ULONG NextCapabilityPointer : 8;
+    ULONG CapabilitySpecific    : 16;
+  };
+  ULONG AsULONG;
+} XHCI_EXTENDED_CAPABILITY;
+
+C_ASSERT(sizeof(XHCI_EXTENDED_CAPABILITY) == sizeof(ULONG));
+
+typedef union _XHCI_LEGACY_SUPPORT_CAPABILITY {
+  struct {
+    ULONG CapabilityID          : 8;
+    ULONG NextCapabilityPointer : 8;
+    ULONG BiosOwnedSemaphore    : 1;
+    ULONG Reserved1             : 7;
+    ULONG OsOwnedSemaphore      : 1;
+    ULONG Reserved2             : 7;
+  };
+  ULONG AsULONG;
+} XHCI_LEGACY_SUPPORT_CAPABILITY;
+
+C_ASSERT(sizeof(XHCI_LEGACY_SUPPORT_CAPABILITY) == sizeof(ULONG));
+
+/* USBLEGCTLSTS: SMI enables are the low bits, status bits are RW1C */
+#define XHCI_LEGACY_SMI_ENABLE_MASK  0x0000E011
+#define XHCI_LEGACY_SMI_STATUS_MASK  0xE0000000
+
+typedef union _XHCI_SUPPORTED_PROTOCOL_PORTS {
+  struct {
+    ULONG CompatiblePortOffset : 8;
+    ULONG CompatiblePortCount  : 8;
+    ULONG ProtocolDefined      : 12;
+    ULONG SpeedIdCount         : 4;
+  };
+  ULONG AsULONG;
+} XHCI_SUPPORTED_PROTOCOL_PORTS;
+
+C_ASSERT(sizeof(XHCI_SUPPORTED_PROTOCOL_PORTS) == sizeof(ULONG));
+
+/* Operational registers */
+typedef union _XHCI_USB_COMMAND {
+  struct {
+    ULONG Run                    : 1;
+    ULONG Reset                  : 1;
+    ULONG InterrupterEnable      : 1;
+    ULONG HostSystemErrorEnable  : 1;
+    ULONG Reserved1              : 3;
+    ULONG LightHCReset           : 1;
+    ULONG ControllerSaveState    : 1;
+    ULONG ControllerRestoreState : 1;
+    ULONG EnableWrapEvent        : 1;
+    ULONG EnableU3MFINDEXStop    : 1;
+    ULONG Reserved2              : 1;
+    ULONG CEMEnable              : 1;
+    ULONG Reserved3              : 18;
+  };
+  ULONG AsULONG;
+} XHCI_USB_COMMAND;
+
+C_ASSERT(sizeof(XHCI_USB_COMMAND) == sizeof(ULONG));
+
+typedef union _XHCI_USB_STATUS {
+  struct {
+    ULONG HCHalted             : 1;
+    ULONG Reserved1            : 1;
+    ULONG HostSystemError      : 1;
+    ULONG EventInterrupt       : 1;
+    ULONG PortChangeDetect     : 1;
+    ULONG Reserved2            : 3;
+    ULONG SaveStateStatus      : 1;
+    ULONG RestoreStateStatus   : 1;
+    ULONG SaveRestoreError     : 1;
+    ULONG ControllerNotReady   : 1;
+    ULONG HostControllerError  : 1;
+    ULONG Reserved3            : 19;
+  };
+  ULONG AsULONG;
+} XHCI_USB_STATUS;
+
+C_ASSERT(sizeof(XHCI_USB_STATUS) == sizeof(ULONG));
+
+#define XHCI_USB_STATUS_RW1C_MASK  0x0000041C // HSE, EINT, PCD, SRE
+
+#define XHCI_CRCR_RING_CYCLE_STATE  0x00000001
+#define XHCI_CRCR_COMMAND_ABORT     0x00000004
+#define XHCI_CRCR_RING_RUNNING      0x00000008
+
+/* Port Link State values */
+#define XHCI_PLS_U0         0
+#define XHCI_PLS_U3         3
+#define XHCI_PLS_RESUME     15
+
+/* Port Speed ID values (default protocol speed IDs) */
+#define XHCI_SPEED_FULL        1
+#define XHCI_SPEED_LOW         2
+#define XHCI_SPEED_HIGH        3
+#define XHCI_SPEED_SUPER       4
+
+typedef union _XHCI_PORT_STATUS_CONTROL {
+  struct {
+    ULONG CurrentConnectStatus    : 1;
+    ULONG PortEnabledDisabled     : 1;
+    ULONG Reserved1               : 1;
+    ULONG OverCurrentActive       : 1;
+    ULONG PortReset               : 1;
+    ULONG PortLinkState           : 4;
+    ULONG PortPower               : 1;
+    ULONG PortSpeed               : 4;
+    ULONG PortIndicatorControl    : 2;
+    ULONG LinkStateWriteStrobe    : 1;
+    ULONG ConnectStatusChange     : 1;
+    ULONG PortEnableDisableChange : 1;
+    ULONG WarmPortResetChange     : 1;
+    ULONG OverCurrentChange       : 1;
+    ULONG PortResetChange         : 1;
+    ULONG PortLinkStateChange     : 1;
+    ULONG PortConfigErrorChange   : 1;
+    ULONG ColdAttachStatus        : 1;
+    ULONG WakeOnConnectEnable     : 1;
+    ULONG WakeOnDisconnectEnable  : 1;
+    ULONG WakeOnOverCurrentEnable : 1;
+    ULONG Reserved2               : 2;
+    ULONG DeviceRemovable         : 1;
+    ULONG WarmPortReset           : 1;
+  };
+  ULONG AsULONG;
+} XHCI_PORT_STATUS_CONTROL;
+
+C_ASSERT(sizeof(XHCI_PORT_STATUS_CONTROL) == sizeof(ULONG));
+
+/* PORTSC bits which keep their value when written back. Writing one
+   to PED disables the port and the change bits are RW1C */
+#define XHCI_PORTSC_PRESERVE_MASK  0x0E00C200
+
+typedef struct _XHCI_PORT_REGISTERS {
+  XHCI_PORT_STATUS_CONTROL PortStatusControl;
+  ULONG PortPowerManagement;
+  ULONG PortLinkInfo;
+  ULONG PortHardwareLPMControl;
+} XHCI_PORT_REGISTERS, *PXHCI_PORT_REGISTERS;
+
+typedef struct _XHCI_HW_REGISTERS {
+  XHCI_USB_COMMAND UsbCommand;
+  XHCI_USB_STATUS UsbStatus;
+  ULONG PageSize;
+  ULONG Reserved1[2];
+  ULONG DeviceNotificationControl;
+  ULONG CommandRingControl[2];
+  ULONG Reserved2[4];
+  ULONG DeviceContextBaseArray[2];
+  ULONG Configure;
+  ULONG Reserved3[241];
+  XHCI_PORT_REGISTERS PortRegisters[XHCI_MAX_PORTS];
+} XHCI_HW_REGISTERS, *PXHCI_HW_REGISTERS;
+
+C_ASSERT(FIELD_OFFSET(XHCI_HW_REGISTERS, CommandRingControl) == 0x18);
+C_ASSERT(FIELD_OFFSET(XHCI_HW_REGISTERS, DeviceContextBaseArray) == 0x30);
+C_ASSERT(FIELD_OFFSET(XHCI_HW_REGISTERS, PortRegisters) == 0x400);
+
+/* Runtime registers */
+#define XHCI_IMAN_INTERRUPT_PENDING  0x00000001
+#define XHCI_IMAN_INTERRUPT_ENABLE   0x00000002
+
+#define XHCI_ERDP_EVENT_HANDLER_BUSY 0x00000008
+
+typedef struct _XHCI_INTERRUPTER_REGISTERS {
+  ULONG InterrupterManagement;
+  ULONG InterrupterModeration;
+  ULONG EventRingSegmentTableSize;
+  ULONG Reserved;
+  ULONG EventRingSegmentTableBase[2];
+  ULONG EventRingDequeuePointer[2];
+} XHCI_INTERRUPTER_REGISTERS, *PXHCI_INTERRUPTER_REGISTERS;
+
+C_ASSERT(sizeof(XHCI_INTERRUPTER_REGISTERS) == 0x20);
+
+typedef struct _XHCI_RUNTIME_REGISTERS {
+  ULONG MicroframeIndex;
+  ULONG Reserved[7];
+  XHCI_INTERRUPTER_REGISTERS Interrupter[1];
+} XHCI_RUNTIME_REGISTERS, *PXHCI_RUNTIME_REGISTERS;
+
+#define XHCI_MFINDEX_FRAME_MASK  0x7FF // MFINDEX counts 2048 frames of 8 microframes
+
+/* Transfer Request Block */
+typedef struct _XHCI_TRB {
+  ULONG Parameter[2];
+  ULONG Status;
+  ULONG Control;
+} XHCI_TRB, *PXHCI_TRB;
+
+C_ASSERT(sizeof(XHCI_TRB) == 16);
+
+/* TRB Control field */
+#define XHCI_TRB_CYCLE                 0x00000001
+#define XHCI_TRB_TOGGLE_CYCLE          0x00000002 // Link TRB
+#define XHCI_TRB_EVENT_DATA            0x00000004 // Transfer Event TRB
+#define XHCI_TRB_INTERRUPT_SHORT       0x00000004
+#define XHCI_TRB_CHAIN                 0x00000010
+#define XHCI_TRB_INTERRUPT_ON_COMPLETE 0x00000020
+#define XHCI_TRB_IMMEDIATE_DATA        0x00000040
+#define XHCI_TRB_BLOCK_SET_ADDRESS     0x00000200 // Address Device Command TRB
+#define XHCI_TRB_DIRECTION_IN          0x00010000 // Data and Status Stage TRBs
+
+#define XHCI_TRB_TYPE_SHIFT            10
+#define XHCI_TRB_TYPE_MASK             0x0000FC00
+#define XHCI_TRB_TYPE(Type)            ((Type) << XHCI_TRB_TYPE_SHIFT)
+#define XHCI_TRB_GET_TYPE(Control)     (((Control) & XHCI_TRB_TYPE_MASK) >> XHCI_TRB_TYPE_SHIFT)
+
+#define XHCI_TRB_TRANSFER_TYPE_NO_DATA 0x00000000 // Setup Stage TRB
+#define XHCI_TRB_TRANSFER_TYPE_OUT     0x00020000
+#define XHCI_TRB_TRANSFER_TYPE_IN      0x00030000
+
+#define XHCI_TRB_ENDPOINT_ID(Dci)      ((Dci) << 16)
+#define XHCI_TRB_SLOT_ID(SlotId)       ((SlotId) << 24)
+#define XHCI_TRB_GET_ENDPOINT_ID(Ctrl) (((Ctrl) >> 16) & 0x1F)
+#define XHCI_TRB_GET_SLOT_ID(Ctrl)     (((Ctrl) >> 24) & 0xFF)
+
+/* TRB Status field */
+#define XHCI_TRB_TRANSFER_LENGTH_MASK  0x0001FFFF
+#define XHCI_TRB_TD_SIZE(Packets)      ((Packets) << 17)
+#define XHCI_TRB_MAX_TD_SIZE           31
+#define XHCI_TRB_EVENT_LENGTH_MASK     0x00FFFFFF
+#define XHCI_TRB_COMPLETION_CODE(Sts)  ((Sts) >> 24)
+
+/* TRB types */
+#define XHCI_TRB_TYPE_NORMAL               1
+#define XHCI_TRB_TYPE_SETUP_STAGE          2
+#define XHCI_TRB_TYPE_DATA_STAGE           3
+#define XHCI_TRB_TYPE_STATUS_STAGE         4
+#define XHCI_TRB_TYPE_LINK                 6
+#define XHCI_TRB_TYPE_EVENT_DATA           7
+#define XHCI_TRB_TYPE_NO_OP                8
+#define XHCI_TRB_TYPE_ENABLE_SLOT          9
+#define XHCI_TRB_TYPE_DISABLE_SLOT         10
+#define XHCI_TRB_TYPE_ADDRESS_DEVICE       11
+#define XHCI_TRB_TYPE_CONFIGURE_ENDPOINT   12
+#define XHCI_TRB_TYPE_EVALUATE_CONTEXT     13
+#define XHCI_TRB_TYPE_RESET_ENDPOINT       14
+#define XHCI_TRB_TYPE_STOP_ENDPOINT        15
+#define XHCI_TRB_TYPE_SET_TR_DEQUEUE       16
+#define XHCI_TRB_TYPE_TRANSFER_EVENT       32
+#define XHCI_TRB_TYPE_COMMAND_COMPLETION   33
+#define XHCI_TRB_TYPE_PORT_STATUS_CHANGE   34
+#define XHCI_TRB_TYPE_HOST_CONTROLLER      37
+
+/* TRB completion codes */
+#define XHCI_COMPLETION_SUCCESS              1
+#define XHCI_COMPLETION_DATA_BUFFER_ERROR    2
+#define XHCI_COMPLETION_BABBLE_DETECTED      3
+#define XHCI_COMPLETION_TRANSACTION_ERROR    4
+#define XHCI_COMPLETION_TRB_ERROR            5
+#define XHCI_COMPLETION_STALL_ERROR          6
+#define XHCI_COMPLETION_SLOT_NOT_ENABLED     11
+#define XHCI_COMPLETION_SHORT_PACKET         13
+#define XHCI_COMPLETION_CONTEXT_STATE_ERROR  19
+#define XHCI_COMPLETION_EVENT_RING_FULL      21
+#define XHCI_COMPLETION_COMMAND_RING_STOPPED 24
+#define XHCI_COMPLETION_COMMAND_ABORTED      25
+#define XHCI_COMPLETION_STOPPED              26
+#define XHCI_COMPLETION_STOPPED_LENGTH       27
+#define XHCI_COMPLETION_STOPPED_SHORT        28
+#define XHCI_COMPLETION_TIMEOUT              0xFF // Software only
+
+/* Event Ring Segment Table entry */
+typedef struct _XHCI_EVENT_RING_SEGMENT {
+  ULONG RingSegmentBase[2];
+  ULONG RingSegmentSize;
+  ULONG Reserved;
+} XHCI_EVENT_RING_SEGMENT, *PXHCI_EVENT_RING_SEGMENT;
+
+C_ASSERT(sizeof(XHCI_EVENT_RING_SEGMENT) == 16);
+
+/* Contexts. With HCCPARAMS1.CSZ set each context takes 64 bytes */
+typedef struct _XHCI_INPUT_CONTROL_CONTEXT {
+  ULONG DropContextFlags;
+  ULONG AddContextFlags;
+  ULONG Reserved[6];
+} XHCI_INPUT_CONTROL_CONTEXT, *PXHCI_INPUT_CONTROL_CONTEXT;
+
+C_ASSERT(sizeof(XHCI_INPUT_CONTROL_CONTEXT) == 32);
+
+typedef struct _XHCI_SLOT_CONTEXT {
+  struct {
+    ULONG RouteString       : 20;
+    ULONG Speed             : 4;
+    ULONG Reserved1         : 1;
+    ULONG MultiTT           : 1;
+    ULONG Hub               : 1;
+    ULONG ContextEntries    : 5;
+  };
+  struct {
+    ULONG MaxExitLatency    : 16;
+    ULONG RootHubPortNumber : 8;
+    ULONG NumberOfPorts     : 8;
+  };
+  struct {
+    ULONG TTHubSlotId       : 8;
+    ULONG TTPortNumber      : 8;
+    ULONG TTThinkTime       : 2;
+    ULONG Reserved2         : 4;
+    ULONG InterrupterTarget : 10;
+  };
+  struct {
+    ULONG DeviceAddress     : 8;
+    ULONG Reserved3         : 19;
+    ULONG SlotState         : 5;
+  };
+  ULONG Reserved4[4];
+} XHCI_SLOT_CONTEXT, *PXHCI_SLOT_CONTEXT;
+
+C_ASSERT(sizeof(XHCI_SLOT_CONTEXT) == 32);
+
+#define XHCI_ENDPOINT_TYPE_ISOCH_OUT      1
+#define XHCI_ENDPOINT_TYPE_BULK_OUT       2
+#define XHCI_ENDPOINT_TYPE_INTERRUPT_OUT  3
+#define XHCI_ENDPOINT_TYPE_CONTROL        4
+#define XHCI_ENDPOINT_TYPE_ISOCH_IN       5
+#define XHCI_ENDPOINT_TYPE_BULK_IN        6
+#define XHCI_ENDPOINT_TYPE_INTERRUPT_IN   7
+
+#define XHCI_DEQUEUE_CYCLE_STATE  0x00000001
+
+typedef struct _XHCI_ENDPOINT_CONTEXT {
+  struct {
+    ULONG EndpointState       : 3;
+    ULONG Reserved1           : 5;
+    ULONG Mult                : 2;
+    ULONG MaxPrimaryStreams   : 5;
+    ULONG LinearStreamArray   : 1;
+    ULONG Interval            : 8;
+    ULONG MaxESITPayloadHi    : 8;
+  };
+  struct {
+    ULONG Reserved2           : 1;
+    ULONG ErrorCount          : 2;
+    ULONG EndpointType        : 3;
+    ULONG Reserved3           : 1;
+    ULONG HostInitiateDisable : 1;
+    ULONG MaxBurstSize        : 8;
+    ULONG MaxPacketSize       : 16;
+  };
+  ULONG DequeuePointer[2];
+  struct {
+    ULONG AverageTRBLength    : 16;
+    ULONG MaxESITPayloadLo    : 16;
+  };
+  ULONG Reserved4[3];
+} XHCI_ENDPOINT_CONTEXT, *PXHCI_ENDPOINT_CONTEXT;
+
+C_ASSERT(sizeof(XHCI_ENDPOINT_CONTEXT) == 32);
@@ -0,0 +1,434 @@
+/*
+ * PROJECT:     ReactOS USB xHCI Miniport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     USBXHCI root hub functions
+ */
+
+#include "usbxhci.h"
+
+#define NDEBUG
+#include <debug.h>
+
+#define NDEBUG_XHCI_ROOT_HUB
+#include "dbg_xhci.h"
+
+static
+PULONG
+XHCI_GetPortStatusReg(IN PXHCI_EXTENSION XhciExtension,
+                      IN USHORT Port)
+{
+    ASSERT(Port != 0 && Port <= XhciExtension->NumberOfPorts);
+    return &XhciExtension->OperationalRegs->PortRegisters[Port - 1].PortStatusControl.AsULONG;
+}
+
+/* Writing back a PORTSC value must not clear the RW1C change bits or
+   disable the port by accident, so only carry over the preserved bits */
+static
+VOID
+XHCI_WritePortStatus(IN PULONG PortStatusReg,
+                     IN ULONG Bits)
+{
+    ULONG PortSC;
+
+    PortSC = READ_REGISTER_ULONG(PortStatusReg) & XHCI_PORTSC_PRESERVE_MASK;
+    WRITE_REGISTER_ULONG(PortStatusReg, PortSC | Bits);
+}
+
+MPSTATUS
+NTAPI
+XHCI_RH_ChirpRootPort(IN PVOID xhciExtension,
+                      IN USHORT Port)
+{
+    /* There are no companion controllers to hand ports over to */
+    DPRINT_RH("XHCI_RH_ChirpRootPort: Port - %x\n", Port);
+    return MP_STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+XHCI_RH_GetRootHubData(IN PVOID xhciExtension,
+                       IN PVOID rootHubData)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PUSBPORT_ROOT_HUB_DATA RootHubData;
+    USBPORT_HUB_20_CHARACTERISTICS HubCharacteristics;
+
+    DPRINT_RH("XHCI_RH_GetRootHubData: XhciExtension - %p, rootHubData - %p\n",
+              XhciExtension,
+              rootHubData);
+
+    RootHubData = rootHubData;
+
+    RootHubData->NumberOfPorts = XhciExtension->NumberOfPorts;
+
+    HubCharacteristics.AsUSHORT = 0;
+
+    /* Logical Power Switching Mode */
+    if (XhciExtension->PortPowerControl)
+    {
+        /* Individual port power switching */
+        HubCharacteristics.PowerControlMode = 1;
+    }
+    else
+    {
+        /* Ganged power switching (all ports' power at once) */
+        HubCharacteristics.PowerControlMode = 0;
+    }
+
+    HubCharacteristics.NoPowerSwitching = 0;
+    HubCharacteristics.PartOfCompoundDevice = 0;
+    HubCharacteristics.OverCurrentProtectionMode = 0;
+
+    RootHubData->HubCharacteristics.Usb20HubCharacteristics = HubCharacteristics;
+
+    RootHubData->PowerOnToPowerGood = 10; // Time (in 2 ms intervals), 20 ms per xHCI 4.19.4
+    RootHubData->HubControlCurrent = 0;
+}
+
+MPSTATUS
+NTAPI
+XHCI_RH_GetStatus(IN PVOID xhciExtension,
+                  IN PUSHORT Status)
+{
+    DPRINT_RH("XHCI_RH_GetStatus: ... \n");
+    *Status = USB_GETSTATUS_SELF_POWERED;
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_RH_GetPortStatus(IN PVOID xhciExtension,
+                      IN USHORT Port,
+                      IN PUSB_PORT_STATUS_AND_CHANGE PortStatus)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+    USB_PORT_STATUS_AND_CHANGE status;
+    ULONG PortMaskBits;
+
+    PortSC.AsULONG = READ_REGISTER_ULONG(XHCI_GetPortStatusReg(XhciExtension, Port));
+
+    if (PortSC.CurrentConnectStatus)
+    {
+        DPRINT_RH("XHCI_RH_GetPortStatus: Port - %x, PortSC.AsULONG - %X\n",
+                  Port,
+                  PortSC.AsULONG);
+    }
+
+    status.AsUlong32 = 0;
+
+    status.PortStatus.Usb20PortStatus.CurrentConnectStatus = PortSC.CurrentConnectStatus;
+    status.PortStatus.Usb20PortStatus.PortEnabledDisabled = PortSC.PortEnabledDisabled;
+    status.PortStatus.Usb20PortStatus.Suspend = (PortSC.PortLinkState == XHCI_PLS_U3);
+    status.PortStatus.Usb20PortStatus.OverCurrent = PortSC.OverCurrentActive;
+    status.PortStatus.Usb20PortStatus.Reset = PortSC.PortReset;
+    status.PortStatus.Usb20PortStatus.PortPower = PortSC.PortPower;
+
+    /* USBPORT knows nothing above high speed. SuperSpeed devices are
+       reported as high-speed ones, the endpoint contexts use the real speed */
+    if (PortSC.CurrentConnectStatus)
+    {
+        if (PortSC.PortSpeed == XHCI_SPEED_LOW)
+            status.PortStatus.Usb20PortStatus.LowSpeedDeviceAttached = 1;
+        else if (PortSC.PortSpeed >= XHCI_SPEED_HIGH)
+            status.PortStatus.Usb20PortStatus.HighSpeedDeviceAttached = 1;
+    }
+
+    status.PortChange.Usb20PortChange.ConnectStatusChange = PortSC.ConnectStatusChange;
+    status.PortChange.Usb20PortChange.PortEnableDisableChange = PortSC.PortEnableDisableChange;
+    status.PortChange.Usb20PortChange.OverCurrentIndicatorChange = PortSC.OverCurrentChange;
+    status.PortChange.Usb20PortChange.ResetChange = PortSC.PortResetChange |
+                                                    PortSC.WarmPortResetChange;
+
+    PortMaskBits = 1 << (Port - 1);
+
+    if (XhciExtension->SuspendPortBits & PortMaskBits)
+        status.PortChange.Usb20PortChange.SuspendChange = 1;
+
+    *PortStatus = status;
+
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_RH_GetHubStatus(IN PVOID xhciExtension,
+                     IN PUSB_HUB_STATUS_AND_CHANGE HubStatus)
+{
+    DPRINT_RH("XHCI_RH_GetHubStatus: ... \n");
+    HubStatus->AsUlong32 = 0;
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_RH_SetFeaturePortReset(IN PVOID xhciExtension,
+                            IN USHORT Port)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+
+    DPRINT("XHCI_RH_SetFeaturePortReset: Port - %x\n", Port);
+
+    /* The next default endpoint opened at address 0 belongs to this port */
+    XhciExtension->ResetPortBits |= 1 << (Port - 1);
+
+    PortSC.AsULONG = 0;
+    PortSC.PortReset = 1;
+    XHCI_WritePortStatus(XHCI_GetPortStatusReg(XhciExtension, Port), PortSC.AsULONG);
+
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_RH_SetFeaturePortPower(IN PVOID xhciExtension,
+                            IN USHORT Port)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+
+    DPRINT_RH("XHCI_RH_SetFeaturePortPower: Port - %x\n", Port);
+
+    PortSC.AsULONG = 0;
+    PortSC.PortPower = 1;
+    XHCI_WritePortStatus(XHCI_GetPortStatusReg(XhciExtension, Port), PortSC.AsULONG);
+
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_RH_SetFeaturePortEnable(IN PVOID xhciExtension,
+                             IN USHORT Port)
+{
+    /* Ports are enabled by a successful reset only */
+    DPRINT_RH("XHCI_RH_SetFeaturePortEnable: Not supported\n");
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_RH_SetFeaturePortSuspend(IN PVOID xhciExtension,
+                              IN USHORT Port)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+
+    DPRINT("XHCI_RH_SetFeaturePortSuspend: Port - %x\n", Port);
+
+    PortSC.AsULONG = 0;
+    PortSC.PortLinkState = XHCI_PLS_U3;
+    PortSC.LinkStateWriteStrobe = 1;
+    XHCI_WritePortStatus(XHCI_GetPortStatusReg(XhciExtension, Port), PortSC.AsULONG);
+
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_RH_ClearFeaturePortEnable(IN PVOID xhciExtension,
+                               IN USHORT Port)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+
+    DPRINT("XHCI_RH_ClearFeaturePortEnable: Port - %x\n", Port);
+
+    /* PED is RW1C, writing 1 disables the port */
+    PortSC.AsULONG = 0;
+    PortSC.PortEnabledDisabled = 1;
+    XHCI_WritePortStatus(XHCI_GetPortStatusReg(XhciExtension, Port), PortSC.AsULONG);
+
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_RH_ClearFeaturePortPower(IN PVOID xhciExtension,
+                              IN USHORT Port)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PULONG PortStatusReg;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+
+    DPRINT("XHCI_RH_ClearFeaturePortPower: Port - %x\n", Port);
+
+    PortStatusReg = XHCI_GetPortStatusReg(XhciExtension, Port);
+    PortSC.AsULONG = READ_REGISTER_ULONG(PortStatusReg) & XHCI_PORTSC_PRESERVE_MASK;
+
+    /* PP is one of the preserved bits */
+    PortSC.PortPower = 0;
+    WRITE_REGISTER_ULONG(PortStatusReg, PortSC.AsULONG);
+
+    return MP_STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+XHCI_RH_PortResumeComplete(IN PVOID xhciExtension,
+                           IN PVOID Context)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+    PUSHORT Port = Context;
+
+    DPRINT("XHCI_RH_PortResumeComplete: *Port - %x\n", *Port);
+
+    PortSC.AsULONG = 0;
+    PortSC.PortLinkState = XHCI_PLS_U0;
+    PortSC.LinkStateWriteStrobe = 1;
+    XHCI_WritePortStatus(XHCI_GetPortStatusReg(XhciExtension, *Port), PortSC.AsULONG);
+
+    XhciExtension->SuspendPortBits |= 1 << (*Port - 1);
+}
+
+MPSTATUS
+NTAPI
+XHCI_RH_ClearFeaturePortSuspend(IN PVOID xhciExtension,
+                                IN USHORT Port)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+
+    DPRINT("XHCI_RH_ClearFeaturePortSuspend: Port - %x\n", Port);
+
+    PortSC.AsULONG = 0;
+    PortSC.LinkStateWriteStrobe = 1;
+
+    if (XhciExtension->Usb3PortBits & (1 << (Port - 1)))
+    {
+        /* USB3 ports drive the resume signaling themselves */
+        PortSC.PortLinkState = XHCI_PLS_U0;
+        XHCI_WritePortStatus(XHCI_GetPortStatusReg(XhciExtension, Port), PortSC.AsULONG);
+
+        XhciExtension->SuspendPortBits |= 1 << (Port - 1);
+        return MP_STATUS_SUCCESS;
+    }
+
+    /* USB2 ports signal resume until software moves them to U0 (xHCI 4.15.2.3) */
+    PortSC.PortLinkState = XHCI_PLS_RESUME;
+    XHCI_WritePortStatus(XHCI_GetPortStatusReg(XhciExtension, Port), PortSC.AsULONG);
+
+    RegPacket.UsbPortRequestAsyncCallback(XhciExtension,
+                                          20, // TimerValue
+                                          &Port,
+                                          sizeof(Port),
+                                          XHCI_RH_PortResumeComplete);
+
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_RH_ClearFeaturePortEnableChange(IN PVOID xhciExtension,
+                                     IN USHORT Port)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+
+    DPRINT_RH("XHCI_RH_ClearFeaturePortEnableChange: Port - %p\n", Port);
+
+    PortSC.AsULONG = 0;
+    PortSC.PortEnableDisableChange = 1;
+    XHCI_WritePortStatus(XHCI_GetPortStatusReg(XhciExtension, Port), PortSC.AsULONG);
+
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_RH_ClearFeaturePortConnectChange(IN PVOID xhciExtension,
+                                      IN USHORT Port)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+
+    DPRINT_RH("XHCI_RH_ClearFeaturePortConnectChange: Port - %x\n", Port);
+
+    PortSC.AsULONG = 0;
+    PortSC.ConnectStatusChange = 1;
+    PortSC.PortConfigErrorChange = 1;
+    XHCI_WritePortStatus(XHCI_GetPortStatusReg(XhciExtension, Port), PortSC.AsULONG);
+
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_RH_ClearFeaturePortResetChange(IN PVOID xhciExtension,
+                                    IN USHORT Port)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+
+    DPRINT("XHCI_RH_ClearFeaturePortResetChange: Port - %x\n", Port);
+
+    PortSC.AsULONG = 0;
+    PortSC.PortResetChange = 1;
+    PortSC.WarmPortResetChange = 1;
+    PortSC.PortLinkStateChange = 1;
+    XHCI_WritePortStatus(XHCI_GetPortStatusReg(XhciExtension, Port), PortSC.AsULONG);
+
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_RH_ClearFeaturePortSuspendChange(IN PVOID xhciExtension,
+                                      IN USHORT Port)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+
+    DPRINT("XHCI_RH_ClearFeaturePortSuspendChange: Port - %x\n", Port);
+
+    XhciExtension->SuspendPortBits &= ~(1 << (Port - 1));
+
+    PortSC.AsULONG = 0;
+    PortSC.PortLinkStateChange = 1;
+    XHCI_WritePortStatus(XHCI_GetPortStatusReg(XhciExtension, Port), PortSC.AsULONG);
+
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_RH_ClearFeaturePortOvercurrentChange(IN PVOID xhciExtension,
+                                          IN USHORT Port)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+
+    DPRINT("XHCI_RH_ClearFeaturePortOvercurrentChange: Port - %x\n", Port);
+
+    PortSC.AsULONG = 0;
+    PortSC.OverCurrentChange = 1;
+    XHCI_WritePortStatus(XHCI_GetPortStatusReg(XhciExtension, Port), PortSC.AsULONG);
+
+    return MP_STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+XHCI_RH_DisableIrq(IN PVOID xhciExtension)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+
+    DPRINT_RH("XHCI_RH_DisableIrq: ... \n");
+
+    /* Port Status Change events keep arriving on the event ring,
+       they just do not invalidate the root hub any more */
+    XhciExtension->Flags |= XHCI_FLAGS_ROOT_HUB_IRQ_OFF;
+}
+
+VOID
+NTAPI
+XHCI_RH_EnableIrq(IN PVOID xhciExtension)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+
+    DPRINT_RH("XHCI_RH_EnableIrq: ... \n");
+
+    XhciExtension->Flags &= ~XHCI_FLAGS_ROOT_HUB_IRQ_OFF;
+}
@@ -0,0 +1,2793 @@
+/*
+ * PROJECT:     ReactOS USB xHCI Miniport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     USBXHCI main driver functions
+ */
+
+#include "usbxhci.h"
+
+#define NDEBUG
+#include <debug.h>
+
+#define NDEBUG_XHCI_TRACE
+#include "dbg_xhci.h"
+
+USBPORT_REGISTRATION_PACKET RegPacket;
+
+static
+VOID
+XHCI_FlushCommand(IN PXHCI_EXTENSION XhciExtension,
+                  IN ULONG TimeoutUs);
+
+/* Rings ******************************************************************/
+
+static
+ULONG
+XHCI_TrbPA(IN PXHCI_RING Ring,
+           IN ULONG Index)
+{
+    return Ring->FirstTrbPA + Index * sizeof(XHCI_TRB);
+}
+
+static
+BOOLEAN
+XHCI_IsLinkTrb(IN PXHCI_RING Ring,
+               IN ULONG Index)
+{
+    return ((Index + 1) % XHCI_SEGMENT_TRBS) == 0 ||
+           Index == Ring->TrbCount - 1;
+}
+
+static
+VOID
+XHCI_InitializeRing(IN PXHCI_RING Ring,
+                    IN PXHCI_TRB FirstTrb,
+                    IN ULONG FirstTrbPA,
+                    IN ULONG TrbCount)
+{
+    PXHCI_TRB Trb;
+    ULONG ix;
+
+    DPRINT_XHCI("XHCI_InitializeRing: FirstTrb - %p, FirstTrbPA - %lx, TrbCount - %lx\n",
+                FirstTrb,
+                FirstTrbPA,
+                TrbCount);
+
+    RtlZeroMemory(FirstTrb, TrbCount * sizeof(XHCI_TRB));
+
+    Ring->FirstTrb = FirstTrb;
+    Ring->FirstTrbPA = FirstTrbPA;
+    Ring->TrbCount = TrbCount;
+    Ring->Enqueue = 0;
+    Ring->CycleState = XHCI_TRB_CYCLE;
+
+    /* Each page is a segment of its own, chained by Link TRBs.
+       The last Link TRB returns to the start and toggles the cycle */
+    for (ix = 0; ix < TrbCount; ix++)
+    {
+        if (!XHCI_IsLinkTrb(Ring, ix))
+            continue;
+
+        Trb = &FirstTrb[ix];
+
+        if (ix == TrbCount - 1)
+        {
+            Trb->Parameter[0] = FirstTrbPA;
+            Trb->Control = XHCI_TRB_TYPE(XHCI_TRB_TYPE_LINK) | XHCI_TRB_TOGGLE_CYCLE;
+        }
+        else
+        {
+            Trb->Parameter[0] = XHCI_TrbPA(Ring, ix + 1);
+            Trb->Control = XHCI_TRB_TYPE(XHCI_TRB_TYPE_LINK);
+        }
+    }
+}
+
+/* Copies a TRB to the enqueue position. The first TRB of a TD is written
+   with the cycle bit still owned by software, the caller flips it once
+   the whole TD is on the ring */
+static
+VOID
+XHCI_QueueTrb(IN PXHCI_RING Ring,
+              IN PXHCI_TRB Trb,
+              IN BOOLEAN IsFirst)
+{
+    PXHCI_TRB RingTrb;
+    PXHCI_TRB LinkTrb;
+    ULONG Cycle;
+
+    RingTrb = &Ring->FirstTrb[Ring->Enqueue];
+
+    Cycle = Ring->CycleState;
+
+    if (IsFirst)
+        Cycle ^= XHCI_TRB_CYCLE;
+
+    RingTrb->Parameter[0] = Trb->Parameter[0];
+    RingTrb->Parameter[1] = Trb->Parameter[1];
+    RingTrb->Status = Trb->Status;
+    KeMemoryBarrier();
+    RingTrb->Control = (Trb->Control & ~XHCI_TRB_CYCLE) | Cycle;
+
+    Ring->Enqueue++;
+
+    if (!XHCI_IsLinkTrb(Ring, Ring->Enqueue))
+        return;
+
+    /* Hand the Link TRB over, a TD that goes on chains through it */
+    LinkTrb = &Ring->FirstTrb[Ring->Enqueue];
+    LinkTrb->Control = (LinkTrb->Control & ~(XHCI_TRB_CYCLE | XHCI_TRB_CHAIN)) |
+                       (Trb->Control & XHCI_TRB_CHAIN) |
+                       Ring->CycleState;
+
+    if (LinkTrb->Control & XHCI_TRB_TOGGLE_CYCLE)
+    {
+        Ring->Enqueue = 0;
+        Ring->CycleState ^= XHCI_TRB_CYCLE;
+    }
+    else
+    {
+        Ring->Enqueue++;
+    }
+}
+
+static
+VOID
+XHCI_RingDoorbell(IN PXHCI_EXTENSION XhciExtension,
+                  IN ULONG SlotId,
+                  IN ULONG Target)
+{
+    KeMemoryBarrier();
+    WRITE_REGISTER_ULONG(&XhciExtension->DoorbellArray[SlotId], Target);
+}
+
+/* Contexts ***************************************************************/
+
+static
+PVOID
+XHCI_GetInputContext(IN PXHCI_EXTENSION XhciExtension,
+                     IN ULONG Index)
+{
+    /* Index 0 is the Input Control Context, 1 the Slot Context,
+       and Dci + 1 the Endpoint Context */
+    return XhciExtension->HcResourcesVA->InputContext +
+           Index * XhciExtension->ContextSize;
+}
+
+static
+PXHCI_INPUT_CONTROL_CONTEXT
+XHCI_PrepareInputContext(IN PXHCI_EXTENSION XhciExtension)
+{
+    /* A pending Address Device still reads the input context */
+    XHCI_FlushCommand(XhciExtension, XHCI_ADDRESS_TIMEOUT_US);
+
+    RtlZeroMemory(XhciExtension->HcResourcesVA->InputContext,
+                  (XHCI_MAX_ENDPOINTS + 1) * XhciExtension->ContextSize);
+
+    return XHCI_GetInputContext(XhciExtension, 0);
+}
+
+static
+ULONG
+XHCI_GetInputContextPA(IN PXHCI_EXTENSION XhciExtension)
+{
+    return XhciExtension->HcResourcesPA +
+           FIELD_OFFSET(XHCI_HC_RESOURCES, InputContext);
+}
+
+static
+PVOID
+XHCI_GetDeviceContext(IN PXHCI_EXTENSION XhciExtension,
+                      IN ULONG SlotId,
+                      IN ULONG Dci)
+{
+    return XhciExtension->HcResourcesVA->DeviceContext[SlotId - 1] +
+           Dci * XhciExtension->ContextSize;
+}
+
+static
+ULONG
+XHCI_GetMaxPacketSize(IN PXHCI_EXTENSION XhciExtension,
+                      IN PXHCI_ENDPOINT XhciEndpoint)
+{
+    PUSBPORT_ENDPOINT_PROPERTIES EndpointProperties;
+    ULONG Speed;
+
+    EndpointProperties = &XhciEndpoint->EndpointProperties;
+    Speed = XhciExtension->Slots[XhciEndpoint->SlotId].Speed;
+
+    if (XhciEndpoint->Dci != 1)
+        return max(EndpointProperties->MaxPacketSize, 1);
+
+    if (Speed == XHCI_SPEED_SUPER)
+        return 512;
+
+    if (Speed == XHCI_SPEED_LOW)
+        return 8;
+
+    /* bMaxPacketSize0 is not known before the first descriptor is read,
+       64 bytes work for any 8 byte request */
+    if (EndpointProperties->DeviceAddress == 0 ||
+        EndpointProperties->TotalMaxPacketSize < 8)
+    {
+        return 64;
+    }
+
+    return EndpointProperties->TotalMaxPacketSize;
+}
+
+static
+VOID
+XHCI_FillEndpointContext(IN PXHCI_EXTENSION XhciExtension,
+                         IN PXHCI_ENDPOINT XhciEndpoint,
+                         IN PXHCI_ENDPOINT_CONTEXT EndpointContext)
+{
+    PUSBPORT_ENDPOINT_PROPERTIES EndpointProperties;
+    PXHCI_RING Ring;
+    BOOLEAN IsIn;
+    ULONG Interval;
+
+    EndpointProperties = &XhciEndpoint->EndpointProperties;
+    Ring = &XhciEndpoint->TransferRing;
+    IsIn = USB_ENDPOINT_DIRECTION_IN(EndpointProperties->EndpointAddress) != 0;
+
+    switch (EndpointProperties->TransferType)
+    {
+        case USBPORT_TRANSFER_TYPE_CONTROL:
+            EndpointContext->EndpointType = XHCI_ENDPOINT_TYPE_CONTROL;
+            EndpointContext->AverageTRBLength = 8;
+            break;
+
+        case USBPORT_TRANSFER_TYPE_BULK:
+            EndpointContext->EndpointType = IsIn ? XHCI_ENDPOINT_TYPE_BULK_IN :
+                                                   XHCI_ENDPOINT_TYPE_BULK_OUT;
+            EndpointContext->AverageTRBLength = 3072;
+            break;
+
+        case USBPORT_TRANSFER_TYPE_INTERRUPT:
+            EndpointContext->EndpointType = IsIn ? XHCI_ENDPOINT_TYPE_INTERRUPT_IN :
+                                                   XHCI_ENDPOINT_TYPE_INTERRUPT_OUT;
+            EndpointContext->AverageTRBLength = EndpointProperties->TotalMaxPacketSize;
+            EndpointContext->MaxESITPayloadLo = EndpointProperties->TotalMaxPacketSize;
+
+            /* Period is in frames, Interval is 2^Interval microframes */
+            for (Interval = 3; Interval < 8; Interval++)
+            {
+                if ((1 << (Interval - 3)) >= EndpointProperties->Period)
+                    break;
+            }
+
+            EndpointContext->Interval = Interval;
+
+            if (EndpointProperties->TransactionPerMicroframe > 1)
+                EndpointContext->MaxBurstSize = EndpointProperties->TransactionPerMicroframe - 1;
+
+            break;
+    }
+
+    EndpointContext->ErrorCount = 3;
+    EndpointContext->MaxPacketSize = XHCI_GetMaxPacketSize(XhciExtension, XhciEndpoint);
+    EndpointContext->DequeuePointer[0] = XHCI_TrbPA(Ring, Ring->Enqueue) | Ring->CycleState;
+    EndpointContext->DequeuePointer[1] = 0;
+}
+
+/* Events *****************************************************************/
+
+static
+ULONG
+XHCI_GetTransferredLength(IN PXHCI_RING Ring,
+                          IN PXHCI_TRANSFER XhciTransfer,
+                          IN ULONG TrbPA,
+                          IN ULONG Residual)
+{
+    PXHCI_TRB Trb;
+    ULONG Index;
+    ULONG Type;
+    ULONG TrbLength;
+    ULONG Length = 0;
+    ULONG ix;
+
+    Index = XhciTransfer->FirstTrb;
+
+    for (ix = 0; ix < XhciTransfer->TrbCount; ix++)
+    {
+        Trb = &Ring->FirstTrb[Index];
+        Type = XHCI_TRB_GET_TYPE(Trb->Control);
+        TrbLength = 0;
+
+        if (Type == XHCI_TRB_TYPE_NORMAL || Type == XHCI_TRB_TYPE_DATA_STAGE)
+            TrbLength = Trb->Status & XHCI_TRB_TRANSFER_LENGTH_MASK;
+
+        if (XHCI_TrbPA(Ring, Index) == TrbPA)
+        {
+            Length += TrbLength - min(Residual, TrbLength);
+            break;
+        }
+
+        Length += TrbLength;
+        Index = (Index + 1) % Ring->TrbCount;
+    }
+
+    return Length;
+}
+
+static
+VOID
+XHCI_ProcessTransferEvent(IN PXHCI_EXTENSION XhciExtension,
+                          IN PXHCI_TRB Event)
+{
+    PXHCI_ENDPOINT XhciEndpoint;
+    PXHCI_TRANSFER XhciTransfer = NULL;
+    PXHCI_TRANSFER Transfer;
+    PLIST_ENTRY Entry;
+    ULONG_PTR EventData;
+    ULONG SlotId;
+    ULONG Dci;
+    ULONG CompletionCode;
+    ULONG Length;
+
+    SlotId = XHCI_TRB_GET_SLOT_ID(Event->Control);
+    Dci = XHCI_TRB_GET_ENDPOINT_ID(Event->Control);
+    CompletionCode = XHCI_TRB_COMPLETION_CODE(Event->Status);
+    Length = Event->Status & XHCI_TRB_EVENT_LENGTH_MASK;
+
+    if (SlotId == 0 || SlotId > XhciExtension->MaxSlots || Dci == 0)
+        return;
+
+    XhciEndpoint = XhciExtension->Slots[SlotId].Endpoints[Dci];
+
+    if (!XhciEndpoint)
+        return;
+
+    /* Stop Endpoint reports where it stopped, the TD is still pending */
+    if (CompletionCode == XHCI_COMPLETION_STOPPED ||
+        CompletionCode == XHCI_COMPLETION_STOPPED_LENGTH ||
+        CompletionCode == XHCI_COMPLETION_STOPPED_SHORT)
+    {
+        return;
+    }
+
+    if (Event->Control & XHCI_TRB_EVENT_DATA)
+    {
+        /* Completion of a whole bulk or interrupt TD */
+        EventData = (ULONG_PTR)(((ULONGLONG)Event->Parameter[1] << 32) |
+                                Event->Parameter[0]);
+
+        for (Entry = XhciEndpoint->TransferList.Flink;
+             Entry != &XhciEndpoint->TransferList;
+             Entry = Entry->Flink)
+        {
+            Transfer = CONTAINING_RECORD(Entry, XHCI_TRANSFER, TransferLink);
+
+            if ((ULONG_PTR)Transfer == EventData)
+            {
+                XhciTransfer = Transfer;
+                break;
+            }
+        }
+
+        if (!XhciTransfer)
+            return;
+
+        XhciTransfer->TransferLen = Length;
+
+        if (CompletionCode == XHCI_COMPLETION_SHORT_PACKET)
+            CompletionCode = XHCI_COMPLETION_SUCCESS;
+    }
+    else
+    {
+        for (Entry = XhciEndpoint->TransferList.Flink;
+             Entry != &XhciEndpoint->TransferList;
+             Entry = Entry->Flink)
+        {
+            Transfer = CONTAINING_RECORD(Entry, XHCI_TRANSFER, TransferLink);
+
+            /* SET_ADDRESS has no TRBs, it completes with its command */
+            if (!Transfer->IsDone && Transfer->TrbCount)
+            {
+                XhciTransfer = Transfer;
+                break;
+            }
+        }
+
+        if (!XhciTransfer)
+            return;
+
+        if (CompletionCode == XHCI_COMPLETION_SHORT_PACKET)
+        {
+            /* Short Data Stage, the Status Stage follows */
+            XhciTransfer->TransferLen = XHCI_GetTransferredLength(&XhciEndpoint->TransferRing,
+                                                                  XhciTransfer,
+                                                                  Event->Parameter[0],
+                                                                  Length);
+            XhciTransfer->IsShort = TRUE;
+            return;
+        }
+
+        if (!XhciTransfer->IsShort)
+        {
+            if (CompletionCode == XHCI_COMPLETION_SUCCESS)
+            {
+                XhciTransfer->TransferLen = XhciTransfer->TransferParameters->TransferBufferLength;
+            }
+            else
+            {
+                XhciTransfer->TransferLen = XHCI_GetTransferredLength(&XhciEndpoint->TransferRing,
+                                                                      XhciTransfer,
+                                                                      Event->Parameter[0],
+                                                                      Length);
+            }
+        }
+    }
+
+    XhciTransfer->CompletionCode = CompletionCode;
+    XhciTransfer->IsDone = TRUE;
+
+    XhciExtension->IsTransferEvent = TRUE;
+}
+
+/* Must be called with EventLock held */
+static
+VOID
+XHCI_CompleteCommand(IN PXHCI_EXTENSION XhciExtension,
+                     IN ULONG CompletionCode,
+                     IN ULONG SlotId)
+{
+    PXHCI_TRANSFER XhciTransfer = XhciExtension->AddressTransfer;
+
+    XhciExtension->CommandCompletionCode = CompletionCode;
+    XhciExtension->CommandSlotId = SlotId;
+    XhciExtension->IsCommandDone = TRUE;
+
+    /* SET_ADDRESS is done with its Address Device command */
+    if (XhciTransfer && !XhciTransfer->IsDone)
+    {
+        XhciTransfer->CompletionCode = CompletionCode;
+        XhciTransfer->IsDone = TRUE;
+        XhciExtension->IsTransferEvent = TRUE;
+    }
+}
+
+/* Must be called with EventLock held */
+static
+VOID
+XHCI_ProcessEvents(IN PXHCI_EXTENSION XhciExtension)
+{
+    PXHCI_INTERRUPTER Interrupter;
+    PXHCI_TRB Event;
+    ULONG CompletionCode;
+
+    Interrupter = &XhciExtension->Interrupter;
+
+    while (TRUE)
+    {
+        Event = &Interrupter->EventRing[Interrupter->Dequeue];
+
+        if ((Event->Control & XHCI_TRB_CYCLE) != Interrupter->CycleState)
+            break;
+
+        KeMemoryBarrier();
+
+        switch (XHCI_TRB_GET_TYPE(Event->Control))
+        {
+            case XHCI_TRB_TYPE_TRANSFER_EVENT:
+                XHCI_ProcessTransferEvent(XhciExtension, Event);
+                break;
+
+            case XHCI_TRB_TYPE_COMMAND_COMPLETION:
+                CompletionCode = XHCI_TRB_COMPLETION_CODE(Event->Status);
+
+                if (Event->Parameter[0] == XhciExtension->CommandTrbPA &&
+                    CompletionCode != XHCI_COMPLETION_COMMAND_RING_STOPPED)
+                {
+                    XHCI_CompleteCommand(XhciExtension,
+                                         CompletionCode,
+                                         XHCI_TRB_GET_SLOT_ID(Event->Control));
+                }
+                break;
+
+            case XHCI_TRB_TYPE_PORT_STATUS_CHANGE:
+                XhciExtension->IsPortEvent = TRUE;
+                break;
+
+            case XHCI_TRB_TYPE_HOST_CONTROLLER:
+                DPRINT1("XHCI_ProcessEvents: Host Controller Event, CompletionCode - %x\n",
+                        XHCI_TRB_COMPLETION_CODE(Event->Status));
+                break;
+
+            default:
+                DPRINT_XHCI("XHCI_ProcessEvents: Unknown event\n");
+                XHCI_DumpTrb(Event);
+                break;
+        }
+
+        Interrupter->Dequeue++;
+
+        if (Interrupter->Dequeue == XHCI_EVENT_RING_TRBS)
+        {
+            Interrupter->Dequeue = 0;
+            Interrupter->CycleState ^= XHCI_TRB_CYCLE;
+        }
+    }
+
+    /* Writing EHB back lets the interrupter assert again */
+    WRITE_REGISTER_ULONG(&Interrupter->Registers->EventRingDequeuePointer[0],
+                         (Interrupter->EventRingPA + Interrupter->Dequeue * sizeof(XHCI_TRB)) |
+                         XHCI_ERDP_EVENT_HANDLER_BUSY);
+    WRITE_REGISTER_ULONG(&Interrupter->Registers->EventRingDequeuePointer[1], 0);
+}
+
+/* Commands ***************************************************************/
+
+/* Commands run one at a time under the MiniportSpinLock. The completion
+   is picked up by polling the event ring, so commands work the same
+   from any callback no matter whether interrupts are enabled. The
+   callbacks run at DISPATCH_LEVEL, so the wait is kept short: commands
+   complete within microseconds. Only Address Device with SET_ADDRESS
+   takes longer, it is not waited for but completes its transfer from
+   the event ring, and the next command waits for it first */
+static
+VOID
+XHCI_QueueCommand(IN PXHCI_EXTENSION XhciExtension,
+                  IN PXHCI_TRB Command)
+{
+    PXHCI_RING Ring = &XhciExtension->CommandRing;
+
+    XhciExtension->IsCommandDone = FALSE;
+    XhciExtension->CommandSlotId = 0;
+    XhciExtension->CommandTrbPA = XHCI_TrbPA(Ring, Ring->Enqueue);
+
+    XHCI_QueueTrb(Ring, Command, FALSE);
+    XHCI_RingDoorbell(XhciExtension, 0, 0);
+}
+
+static
+BOOLEAN
+XHCI_PollCommand(IN PXHCI_EXTENSION XhciExtension,
+                 IN ULONG TimeoutUs)
+{
+    KIRQL OldIrql;
+    ULONG ix;
+
+    for (ix = 0; ; ix += 10)
+    {
+        KeAcquireSpinLock(&XhciExtension->EventLock, &OldIrql);
+        XHCI_ProcessEvents(XhciExtension);
+        KeReleaseSpinLock(&XhciExtension->EventLock, OldIrql);
+
+        if (XhciExtension->IsCommandDone)
+            return TRUE;
+
+        if (ix >= TimeoutUs)
+            return FALSE;
+
+        KeStallExecutionProcessor(10);
+    }
+}
+
+/* Aborting stops the ring after the command completes, either as Command
+   Aborted or with its own result if it got that far. A late success is
+   taken as is, so the slot state stays what the controller has */
+static
+VOID
+XHCI_AbortCommand(IN PXHCI_EXTENSION XhciExtension)
+{
+    PXHCI_HW_REGISTERS OperationalRegs = XhciExtension->OperationalRegs;
+    KIRQL OldIrql;
+    ULONG ix;
+
+    DPRINT1("XHCI_AbortCommand: Command timeout, CommandTrbPA - %lx\n",
+            XhciExtension->CommandTrbPA);
+
+    /* The ring resumes with the next command */
+    WRITE_REGISTER_ULONG(&OperationalRegs->CommandRingControl[0],
+                         XHCI_CRCR_COMMAND_ABORT);
+    WRITE_REGISTER_ULONG(&OperationalRegs->CommandRingControl[1], 0);
+
+    for (ix = 0; ix < XHCI_ABORT_TIMEOUT_US; ix += 10)
+    {
+        if (!(READ_REGISTER_ULONG(&OperationalRegs->CommandRingControl[0]) &
+              XHCI_CRCR_RING_RUNNING))
+        {
+            break;
+        }
+
+        KeStallExecutionProcessor(10);
+    }
+
+    if (XHCI_PollCommand(XhciExtension, 0))
+        return;
+
+    DPRINT1("XHCI_AbortCommand: No completion for the command\n");
+
+    /* Any completion that still comes is not for the next command */
+    KeAcquireSpinLock(&XhciExtension->EventLock, &OldIrql);
+    XhciExtension->CommandTrbPA = 0;
+    XHCI_CompleteCommand(XhciExtension, XHCI_COMPLETION_TIMEOUT, 0);
+    KeReleaseSpinLock(&XhciExtension->EventLock, OldIrql);
+}
+
+static
+ULONG
+XHCI_WaitCommand(IN PXHCI_EXTENSION XhciExtension,
+                 IN ULONG TimeoutUs)
+{
+    if (!XHCI_PollCommand(XhciExtension, TimeoutUs))
+        XHCI_AbortCommand(XhciExtension);
+
+    return XhciExtension->CommandCompletionCode;
+}
+
+/* Waits for a pending Address Device, whose SET_ADDRESS completes then */
+static
+VOID
+XHCI_FlushCommand(IN PXHCI_EXTENSION XhciExtension,
+                  IN ULONG TimeoutUs)
+{
+    PXHCI_TRANSFER XhciTransfer = XhciExtension->AddressTransfer;
+
+    if (!XhciTransfer || XhciExtension->IsCommandDone)
+        return;
+
+    XHCI_WaitCommand(XhciExtension, TimeoutUs);
+
+    RegPacket.UsbPortInvalidateEndpoint(XhciExtension, XhciTransfer->XhciEndpoint);
+}
+
+static
+ULONG
+XHCI_SendCommand(IN PXHCI_EXTENSION XhciExtension,
+                 IN PXHCI_TRB Command)
+{
+    XHCI_FlushCommand(XhciExtension, XHCI_ADDRESS_TIMEOUT_US);
+
+    XHCI_QueueCommand(XhciExtension, Command);
+
+    return XHCI_WaitCommand(XhciExtension, XHCI_COMMAND_TIMEOUT_US);
+}
+
+static
+ULONG
+XHCI_SendEndpointCommand(IN PXHCI_EXTENSION XhciExtension,
+                         IN PXHCI_ENDPOINT XhciEndpoint,
+                         IN ULONG Type,
+                         IN ULONG Parameter)
+{
+    XHCI_TRB Command;
+
+    Command.Parameter[0] = Parameter;
+    Command.Parameter[1] = 0;
+    Command.Status = 0;
+    Command.Control = XHCI_TRB_TYPE(Type) |
+                      XHCI_TRB_ENDPOINT_ID(XhciEndpoint->Dci) |
+                      XHCI_TRB_SLOT_ID(XhciEndpoint->SlotId);
+
+    return XHCI_SendCommand(XhciExtension, &Command);
+}
+
+static
+VOID
+XHCI_SetDequeuePointer(IN PXHCI_EXTENSION XhciExtension,
+                       IN PXHCI_ENDPOINT XhciEndpoint,
+                       IN ULONG Index,
+                       IN ULONG Cycle)
+{
+    ULONG CompletionCode;
+
+    CompletionCode = XHCI_SendEndpointCommand(XhciExtension,
+                                              XhciEndpoint,
+                                              XHCI_TRB_TYPE_SET_TR_DEQUEUE,
+                                              XHCI_TrbPA(&XhciEndpoint->TransferRing, Index) |
+                                              Cycle);
+
+    if (CompletionCode != XHCI_COMPLETION_SUCCESS)
+    {
+        DPRINT1("XHCI_SetDequeuePointer: CompletionCode - %x\n", CompletionCode);
+    }
+}
+
+static
+VOID
+XHCI_SetSlotEndpoint(IN PXHCI_EXTENSION XhciExtension,
+                     IN ULONG SlotId,
+                     IN ULONG Dci,
+                     IN PXHCI_ENDPOINT XhciEndpoint)
+{
+    KIRQL OldIrql;
+
+    KeAcquireSpinLock(&XhciExtension->EventLock, &OldIrql);
+    XhciExtension->Slots[SlotId].Endpoints[Dci] = XhciEndpoint;
+    KeReleaseSpinLock(&XhciExtension->EventLock, OldIrql);
+}
+
+static
+ULONG
+XHCI_EnableSlot(IN PXHCI_EXTENSION XhciExtension)
+{
+    PXHCI_HC_RESOURCES HcResourcesVA = XhciExtension->HcResourcesVA;
+    XHCI_TRB Command;
+    ULONG CompletionCode;
+    ULONG SlotId;
+
+    RtlZeroMemory(&Command, sizeof(Command));
+    Command.Control = XHCI_TRB_TYPE(XHCI_TRB_TYPE_ENABLE_SLOT);
+
+    CompletionCode = XHCI_SendCommand(XhciExtension, &Command);
+    SlotId = XhciExtension->CommandSlotId;
+
+    if (CompletionCode != XHCI_COMPLETION_SUCCESS ||
+        SlotId == 0 ||
+        SlotId > XhciExtension->MaxSlots)
+    {
+        DPRINT1("XHCI_EnableSlot: CompletionCode - %x, SlotId - %x\n",
+                CompletionCode,
+                SlotId);
+        return 0;
+    }
+
+    RtlZeroMemory(HcResourcesVA->DeviceContext[SlotId - 1], XHCI_CONTEXT_AREA_SIZE);
+
+    HcResourcesVA->DeviceContextBaseArray[2 * SlotId] =
+        XhciExtension->HcResourcesPA +
+        FIELD_OFFSET(XHCI_HC_RESOURCES, DeviceContext) +
+        (SlotId - 1) * XHCI_CONTEXT_AREA_SIZE;
+    HcResourcesVA->DeviceContextBaseArray[2 * SlotId + 1] = 0;
+
+    RtlZeroMemory(&XhciExtension->Slots[SlotId], sizeof(XHCI_SLOT));
+    XhciExtension->Slots[SlotId].Flags = XHCI_SLOT_FLAG_ENABLED;
+
+    return SlotId;
+}
+
+static
+VOID
+XHCI_DisableSlot(IN PXHCI_EXTENSION XhciExtension,
+                 IN ULONG SlotId)
+{
+    PXHCI_SLOT Slot = &XhciExtension->Slots[SlotId];
+    PXHCI_ENDPOINT XhciEndpoint;
+    PXHCI_TRANSFER XhciTransfer;
+    PLIST_ENTRY Entry;
+    XHCI_TRB Command;
+    BOOLEAN IsOrphaned = FALSE;
+    KIRQL OldIrql;
+    ULONG Dci;
+
+    DPRINT("XHCI_DisableSlot: SlotId - %x\n", SlotId);
+
+    RtlZeroMemory(&Command, sizeof(Command));
+    Command.Control = XHCI_TRB_TYPE(XHCI_TRB_TYPE_DISABLE_SLOT) |
+                      XHCI_TRB_SLOT_ID(SlotId);
+
+    XHCI_SendCommand(XhciExtension, &Command);
+
+    XhciExtension->HcResourcesVA->DeviceContextBaseArray[2 * SlotId] = 0;
+    XhciExtension->HcResourcesVA->DeviceContextBaseArray[2 * SlotId + 1] = 0;
+
+    /* Endpoints still open on a replaced device fail what they have queued */
+    KeAcquireSpinLock(&XhciExtension->EventLock, &OldIrql);
+
+    for (Dci = 1; Dci < XHCI_MAX_ENDPOINTS; Dci++)
+    {
+        XhciEndpoint = Slot->Endpoints[Dci];
+
+        if (!XhciEndpoint)
+            continue;
+
+        XhciEndpoint->SlotId = 0;
+
+        for (Entry = XhciEndpoint->TransferList.Flink;
+             Entry != &XhciEndpoint->TransferList;
+             Entry = Entry->Flink)
+        {
+            XhciTransfer = CONTAINING_RECORD(Entry, XHCI_TRANSFER, TransferLink);
+
+            if (!XhciTransfer->IsDone)
+            {
+                XhciTransfer->CompletionCode = XHCI_COMPLETION_SLOT_NOT_ENABLED;
+                XhciTransfer->IsDone = TRUE;
+                IsOrphaned = TRUE;
+            }
+        }
+    }
+
+    RtlZeroMemory(Slot, sizeof(XHCI_SLOT));
+
+    KeReleaseSpinLock(&XhciExtension->EventLock, OldIrql);
+
+    if (IsOrphaned)
+        RegPacket.UsbPortInvalidateEndpoint(XhciExtension, NULL);
+}
+
+/* Without a transfer Address Device only sets up the slot, the device
+   stays at address 0. With the SET_ADDRESS transfer it sends that and is
+   not waited for, the transfer completes with the command */
+static
+ULONG
+XHCI_AddressDevice(IN PXHCI_EXTENSION XhciExtension,
+                   IN PXHCI_ENDPOINT XhciEndpoint,
+                   IN PXHCI_TRANSFER XhciTransfer)
+{
+    PXHCI_SLOT Slot = &XhciExtension->Slots[XhciEndpoint->SlotId];
+    PXHCI_INPUT_CONTROL_CONTEXT InputControl;
+    PXHCI_SLOT_CONTEXT SlotContext;
+    XHCI_TRB Command;
+
+    InputControl = XHCI_PrepareInputContext(XhciExtension);
+    InputControl->AddContextFlags = (1 << 0) | (1 << 1);
+
+    SlotContext = XHCI_GetInputContext(XhciExtension, 1);
+    SlotContext->RouteString = 0;
+    SlotContext->Speed = Slot->Speed;
+    SlotContext->ContextEntries = 1;
+    SlotContext->RootHubPortNumber = Slot->RootPort;
+
+    XHCI_FillEndpointContext(XhciExtension,
+                             XhciEndpoint,
+                             XHCI_GetInputContext(XhciExtension, 2));
+
+    RtlZeroMemory(&Command, sizeof(Command));
+    Command.Parameter[0] = XHCI_GetInputContextPA(XhciExtension);
+    Command.Control = XHCI_TRB_TYPE(XHCI_TRB_TYPE_ADDRESS_DEVICE) |
+                      XHCI_TRB_SLOT_ID(XhciEndpoint->SlotId);
+
+    if (!XhciTransfer)
+    {
+        Command.Control |= XHCI_TRB_BLOCK_SET_ADDRESS;
+        return XHCI_SendCommand(XhciExtension, &Command);
+    }
+
+    XhciExtension->AddressTransfer = XhciTransfer;
+    XhciExtension->AddressTime = KeQueryInterruptTime();
+
+    XHCI_QueueCommand(XhciExtension, &Command);
+
+    return XHCI_COMPLETION_SUCCESS;
+}
+
+/* SET_ADDRESS is not sent by software, Address Device does it */
+static
+VOID
+XHCI_SetAddress(IN PXHCI_EXTENSION XhciExtension,
+                IN PXHCI_ENDPOINT XhciEndpoint,
+                IN PXHCI_TRANSFER XhciTransfer)
+{
+    PXHCI_RING Ring = &XhciEndpoint->TransferRing;
+
+    DPRINT("XHCI_SetAddress: SlotId - %x, DeviceAddress - %x\n",
+           XhciEndpoint->SlotId,
+           XhciTransfer->TransferParameters->SetupPacket.wValue.LowByte);
+
+    XhciTransfer->FirstTrb = Ring->Enqueue;
+    XhciTransfer->FirstCycle = Ring->CycleState;
+    XhciTransfer->NextTrb = Ring->Enqueue;
+    XhciTransfer->NextCycle = Ring->CycleState;
+
+    XHCI_InsertTransfer(XhciExtension, XhciEndpoint, XhciTransfer);
+
+    XHCI_AddressDevice(XhciExtension, XhciEndpoint, XhciTransfer);
+}
+
+/* Called when the SET_ADDRESS transfer leaves the endpoint */
+static
+VOID
+XHCI_FinishSetAddress(IN PXHCI_EXTENSION XhciExtension,
+                      IN PXHCI_TRANSFER XhciTransfer)
+{
+    PXHCI_ENDPOINT XhciEndpoint = XhciTransfer->XhciEndpoint;
+    PXHCI_SLOT Slot;
+    UCHAR DeviceAddress;
+    ULONG SlotId;
+
+    XhciExtension->AddressTransfer = NULL;
+
+    if (XhciTransfer->CompletionCode != XHCI_COMPLETION_SUCCESS)
+    {
+        DPRINT1("XHCI_FinishSetAddress: CompletionCode - %x\n",
+                XhciTransfer->CompletionCode);
+        return;
+    }
+
+    /* The slot is gone if the device was unplugged meanwhile */
+    if (!XhciEndpoint->SlotId)
+        return;
+
+    Slot = &XhciExtension->Slots[XhciEndpoint->SlotId];
+    DeviceAddress = XhciTransfer->TransferParameters->SetupPacket.wValue.LowByte;
+
+    /* The address now belongs to this slot only */
+    for (SlotId = 1; SlotId <= XhciExtension->MaxSlots; SlotId++)
+    {
+        if (XhciExtension->Slots[SlotId].DeviceAddress == DeviceAddress)
+            XhciExtension->Slots[SlotId].Flags &= ~XHCI_SLOT_FLAG_ADDRESSED;
+    }
+
+    Slot->DeviceAddress = DeviceAddress;
+    Slot->Flags |= XHCI_SLOT_FLAG_ADDRESSED;
+
+    XhciExtension->ResetPortBits &= ~(1 << (Slot->RootPort - 1));
+}
+
+static
+ULONG
+XHCI_FindSlot(IN PXHCI_EXTENSION XhciExtension,
+              IN USHORT DeviceAddress)
+{
+    PXHCI_SLOT Slot;
+    ULONG SlotId;
+
+    for (SlotId = 1; SlotId <= XhciExtension->MaxSlots; SlotId++)
+    {
+        Slot = &XhciExtension->Slots[SlotId];
+
+        if ((Slot->Flags & XHCI_SLOT_FLAG_ADDRESSED) &&
+            Slot->DeviceAddress == DeviceAddress)
+        {
+            return SlotId;
+        }
+    }
+
+    return 0;
+}
+
+static
+ULONG
+XHCI_ConfigureEndpoint(IN PXHCI_EXTENSION XhciExtension,
+                       IN PXHCI_ENDPOINT XhciEndpoint,
+                       IN BOOLEAN IsAdd)
+{
+    PXHCI_SLOT Slot = &XhciExtension->Slots[XhciEndpoint->SlotId];
+    PXHCI_INPUT_CONTROL_CONTEXT InputControl;
+    PXHCI_SLOT_CONTEXT SlotContext;
+    XHCI_TRB Command;
+    ULONG CompletionCode;
+    ULONG ContextEntries = 1;
+    ULONG Dci;
+
+    InputControl = XHCI_PrepareInputContext(XhciExtension);
+    InputControl->AddContextFlags = 1 << 0;
+
+    if (IsAdd)
+        InputControl->AddContextFlags |= 1 << XhciEndpoint->Dci;
+
+    if (!IsAdd || Slot->Endpoints[XhciEndpoint->Dci])
+        InputControl->DropContextFlags = 1 << XhciEndpoint->Dci;
+
+    for (Dci = 2; Dci < XHCI_MAX_ENDPOINTS; Dci++)
+    {
+        if (Dci == XhciEndpoint->Dci ? IsAdd : Slot->Endpoints[Dci] != NULL)
+            ContextEntries = Dci;
+    }
+
+    SlotContext = XHCI_GetInputContext(XhciExtension, 1);
+    RtlCopyMemory(SlotContext,
+                  XHCI_GetDeviceContext(XhciExtension, XhciEndpoint->SlotId, 0),
+                  sizeof(XHCI_SLOT_CONTEXT));
+    SlotContext->ContextEntries = ContextEntries;
+
+    if (IsAdd)
+    {
+        XHCI_FillEndpointContext(XhciExtension,
+                                 XhciEndpoint,
+                                 XHCI_GetInputContext(XhciExtension, XhciEndpoint->Dci + 1));
+    }
+
+    RtlZeroMemory(&Command, sizeof(Command));
+    Command.Parameter[0] = XHCI_GetInputContextPA(XhciExtension);
+    Command.Control = XHCI_TRB_TYPE(XHCI_TRB_TYPE_CONFIGURE_ENDPOINT) |
+                      XHCI_TRB_SLOT_ID(XhciEndpoint->SlotId);
+
+    CompletionCode = XHCI_SendCommand(XhciExtension, &Command);
+
+    if (IsAdd && CompletionCode == XHCI_COMPLETION_SUCCESS)
+    {
+        XHCI_SetSlotEndpoint(XhciExtension,
+                             XhciEndpoint->SlotId,
+                             XhciEndpoint->Dci,
+                             XhciEndpoint);
+    }
+    else if (!IsAdd)
+    {
+        XHCI_SetSlotEndpoint(XhciExtension,
+                             XhciEndpoint->SlotId,
+                             XhciEndpoint->Dci,
+                             NULL);
+    }
+
+    return CompletionCode;
+}
+
+/* Endpoints **************************************************************/
+
+static
+MPSTATUS
+XHCI_OpenDefaultEndpoint(IN PXHCI_EXTENSION XhciExtension,
+                         IN PXHCI_ENDPOINT XhciEndpoint)
+{
+    PUSBPORT_ENDPOINT_PROPERTIES EndpointProperties;
+    PXHCI_INPUT_CONTROL_CONTEXT InputControl;
+    PXHCI_RING Ring = &XhciEndpoint->TransferRing;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+    XHCI_TRB Command;
+    ULONG CompletionCode;
+    ULONG SlotId;
+    USHORT Port;
+
+    EndpointProperties = &XhciEndpoint->EndpointProperties;
+
+    if (EndpointProperties->DeviceAddress != 0)
+    {
+        /* Reopened after SET_ADDRESS or for a new bMaxPacketSize0 */
+        SlotId = XHCI_FindSlot(XhciExtension, EndpointProperties->DeviceAddress);
+
+        if (!SlotId || XhciExtension->Slots[SlotId].Endpoints[1])
+        {
+            DPRINT1("XHCI_OpenDefaultEndpoint: No slot for DeviceAddress - %x\n",
+                    EndpointProperties->DeviceAddress);
+            return MP_STATUS_ERROR;
+        }
+
+        XhciEndpoint->SlotId = SlotId;
+        XHCI_SetSlotEndpoint(XhciExtension, SlotId, 1, XhciEndpoint);
+
+        XHCI_SetDequeuePointer(XhciExtension,
+                               XhciEndpoint,
+                               Ring->Enqueue,
+                               Ring->CycleState);
+
+        InputControl = XHCI_PrepareInputContext(XhciExtension);
+        InputControl->AddContextFlags = 1 << 1;
+
+        XHCI_FillEndpointContext(XhciExtension,
+                                 XhciEndpoint,
+                                 XHCI_GetInputContext(XhciExtension, 2));
+
+        RtlZeroMemory(&Command, sizeof(Command));
+        Command.Parameter[0] = XHCI_GetInputContextPA(XhciExtension);
+        Command.Control = XHCI_TRB_TYPE(XHCI_TRB_TYPE_EVALUATE_CONTEXT) |
+                          XHCI_TRB_SLOT_ID(SlotId);
+
+        CompletionCode = XHCI_SendCommand(XhciExtension, &Command);
+
+        if (CompletionCode != XHCI_COMPLETION_SUCCESS)
+        {
+            DPRINT1("XHCI_OpenDefaultEndpoint: Evaluate Context CompletionCode - %x\n",
+                    CompletionCode);
+            XHCI_SetSlotEndpoint(XhciExtension, SlotId, 1, NULL);
+            XhciEndpoint->SlotId = 0;
+            return MP_STATUS_ERROR;
+        }
+
+        return MP_STATUS_SUCCESS;
+    }
+
+    /* A new device, it is on the root port that was reset last. The port
+       number of a device behind a hub is a port of that hub, so the root
+       port check also keeps out devices that would need a route string */
+    Port = EndpointProperties->PortNumber;
+
+    if (Port == 0 ||
+        Port > XhciExtension->NumberOfPorts ||
+        !(XhciExtension->ResetPortBits & (1 << (Port - 1))))
+    {
+        DPRINT1("XHCI_OpenDefaultEndpoint: Only root port devices are supported, Port - %x\n",
+                Port);
+        return MP_STATUS_NOT_SUPPORTED;
+    }
+
+    PortSC.AsULONG = READ_REGISTER_ULONG(&XhciExtension->OperationalRegs->PortRegisters[Port - 1].PortStatusControl.AsULONG);
+
+    if (!PortSC.CurrentConnectStatus || !PortSC.PortEnabledDisabled)
+    {
+        DPRINT1("XHCI_OpenDefaultEndpoint: Port - %x not enabled, PortSC - %lx\n",
+                Port,
+                PortSC.AsULONG);
+        return MP_STATUS_ERROR;
+    }
+
+    /* Drop the slot of a device that was on this port before */
+    for (SlotId = 1; SlotId <= XhciExtension->MaxSlots; SlotId++)
+    {
+        if ((XhciExtension->Slots[SlotId].Flags & XHCI_SLOT_FLAG_ENABLED) &&
+            XhciExtension->Slots[SlotId].RootPort == Port)
+        {
+            XHCI_DisableSlot(XhciExtension, SlotId);
+        }
+    }
+
+    SlotId = XHCI_EnableSlot(XhciExtension);
+
+    if (!SlotId)
+        return MP_STATUS_NO_RESOURCES;
+
+    XhciExtension->Slots[SlotId].RootPort = (UCHAR)Port;
+    XhciExtension->Slots[SlotId].Speed = (UCHAR)PortSC.PortSpeed;
+
+    XhciEndpoint->SlotId = SlotId;
+    XHCI_SetSlotEndpoint(XhciExtension, SlotId, 1, XhciEndpoint);
+
+    /* Set up the default control endpoint, SET_ADDRESS is sent later */
+    CompletionCode = XHCI_AddressDevice(XhciExtension, XhciEndpoint, NULL);
+
+    if (CompletionCode != XHCI_COMPLETION_SUCCESS)
+    {
+        DPRINT1("XHCI_OpenDefaultEndpoint: Address Device CompletionCode - %x\n",
+                CompletionCode);
+        XHCI_DisableSlot(XhciExtension, SlotId);
+        return MP_STATUS_ERROR;
+    }
+
+    return MP_STATUS_SUCCESS;
+}
+
+static
+MPSTATUS
+XHCI_AddEndpointToSlot(IN PXHCI_EXTENSION XhciExtension,
+                       IN PXHCI_ENDPOINT XhciEndpoint)
+{
+    PUSBPORT_ENDPOINT_PROPERTIES EndpointProperties;
+    ULONG SlotId;
+
+    if (XhciEndpoint->Dci == 1)
+        return XHCI_OpenDefaultEndpoint(XhciExtension, XhciEndpoint);
+
+    EndpointProperties = &XhciEndpoint->EndpointProperties;
+    SlotId = XHCI_FindSlot(XhciExtension, EndpointProperties->DeviceAddress);
+
+    if (!SlotId)
+    {
+        DPRINT1("XHCI_AddEndpointToSlot: No slot for DeviceAddress - %x\n",
+                EndpointProperties->DeviceAddress);
+        return MP_STATUS_ERROR;
+    }
+
+    XhciEndpoint->SlotId = SlotId;
+
+    if (XHCI_ConfigureEndpoint(XhciExtension, XhciEndpoint, TRUE) != XHCI_COMPLETION_SUCCESS)
+    {
+        DPRINT1("XHCI_AddEndpointToSlot: Configure Endpoint failed\n");
+        XhciEndpoint->SlotId = 0;
+        return MP_STATUS_ERROR;
+    }
+
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_OpenEndpoint(IN PVOID xhciExtension,
+                  IN PUSBPORT_ENDPOINT_PROPERTIES EndpointProperties,
+                  IN PVOID xhciEndpoint)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_ENDPOINT XhciEndpoint = xhciEndpoint;
+    ULONG EndpointNumber;
+    ULONG TrbCount;
+
+    DPRINT("XHCI_OpenEndpoint: DeviceAddress - %x, EndpointAddress - %x, TransferType - %x\n",
+           EndpointProperties->DeviceAddress,
+           EndpointProperties->EndpointAddress,
+           EndpointProperties->TransferType);
+
+    RtlCopyMemory(&XhciEndpoint->EndpointProperties,
+                  EndpointProperties,
+                  sizeof(XhciEndpoint->EndpointProperties));
+
+    InitializeListHead(&XhciEndpoint->TransferList);
+    XhciEndpoint->SlotId = 0;
+
+    EndpointNumber = EndpointProperties->EndpointAddress & USB_ENDPOINT_ADDRESS_MASK;
+
+    switch (EndpointProperties->TransferType)
+    {
+        case USBPORT_TRANSFER_TYPE_CONTROL:
+            XhciEndpoint->EndpointStatus = USBPORT_ENDPOINT_CONTROL;
+            XhciEndpoint->Dci = EndpointNumber * 2 + 1;
+            TrbCount = XHCI_CONTROL_RING_TRBS;
+            break;
+
+        case USBPORT_TRANSFER_TYPE_BULK:
+            XhciEndpoint->Dci = EndpointNumber * 2 +
+                                (USB_ENDPOINT_DIRECTION_IN(EndpointProperties->EndpointAddress) ? 1 : 0);
+            TrbCount = XHCI_BULK_RING_TRBS;
+            break;
+
+        case USBPORT_TRANSFER_TYPE_INTERRUPT:
+            XhciEndpoint->Dci = EndpointNumber * 2 +
+                                (USB_ENDPOINT_DIRECTION_IN(EndpointProperties->EndpointAddress) ? 1 : 0);
+            TrbCount = XHCI_INTERRUPT_RING_TRBS;
+            break;
+
+        default:
+            DPRINT1("XHCI_OpenEndpoint: Isochronous transfers are not supported\n");
+            return MP_STATUS_NOT_SUPPORTED;
+    }
+
+    XHCI_InitializeRing(&XhciEndpoint->TransferRing,
+                        (PXHCI_TRB)EndpointProperties->BufferVA,
+                        EndpointProperties->BufferPA,
+                        TrbCount);
+
+    return XHCI_AddEndpointToSlot(XhciExtension, XhciEndpoint);
+}
+
+VOID
+NTAPI
+XHCI_QueryEndpointRequirements(IN PVOID xhciExtension,
+                               IN PUSBPORT_ENDPOINT_PROPERTIES EndpointProperties,
+                               IN PUSBPORT_ENDPOINT_REQUIREMENTS EndpointRequirements)
+{
+    ULONG TransferType;
+
+    DPRINT("XHCI_QueryEndpointRequirements: ... \n");
+
+    TransferType = EndpointProperties->TransferType;
+
+    switch (TransferType)
+    {
+        case USBPORT_TRANSFER_TYPE_CONTROL:
+            EndpointRequirements->HeaderBufferSize = XHCI_CONTROL_RING_TRBS * sizeof(XHCI_TRB);
+            EndpointRequirements->MaxTransferSize = XHCI_MAX_CONTROL_TRANSFER_SIZE;
+            break;
+
+        case USBPORT_TRANSFER_TYPE_BULK:
+            EndpointRequirements->HeaderBufferSize = XHCI_BULK_RING_TRBS * sizeof(XHCI_TRB);
+            EndpointRequirements->MaxTransferSize = XHCI_MAX_BULK_TRANSFER_SIZE;
+            break;
+
+        case USBPORT_TRANSFER_TYPE_INTERRUPT:
+            EndpointRequirements->HeaderBufferSize = XHCI_INTERRUPT_RING_TRBS * sizeof(XHCI_TRB);
+            EndpointRequirements->MaxTransferSize = XHCI_MAX_INTERRUPT_TRANSFER_SIZE;
+            break;
+
+        default:
+            DPRINT1("XHCI_QueryEndpointRequirements: Unsupported TransferType - %x\n",
+                    TransferType);
+            EndpointRequirements->HeaderBufferSize = 0;
+            EndpointRequirements->MaxTransferSize = 0;
+            break;
+    }
+}
+
+VOID
+NTAPI
+XHCI_CloseEndpoint(IN PVOID xhciExtension,
+                   IN PVOID xhciEndpoint,
+                   IN BOOLEAN IsDoDisablePeriodic)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_ENDPOINT XhciEndpoint = xhciEndpoint;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+    PXHCI_SLOT Slot;
+    ULONG SlotId;
+
+    DPRINT("XHCI_CloseEndpoint: XhciEndpoint - %p, SlotId - %x, Dci - %x\n",
+           XhciEndpoint,
+           XhciEndpoint->SlotId,
+           XhciEndpoint->Dci);
+
+    SlotId = XhciEndpoint->SlotId;
+
+    if (!SlotId)
+        return;
+
+    Slot = &XhciExtension->Slots[SlotId];
+
+    if (Slot->Endpoints[XhciEndpoint->Dci] != XhciEndpoint)
+        return;
+
+    if (XhciEndpoint->Dci != 1)
+    {
+        XHCI_ConfigureEndpoint(XhciExtension, XhciEndpoint, FALSE);
+        XhciEndpoint->SlotId = 0;
+        return;
+    }
+
+    /* The default endpoint can not be dropped, only stopped */
+    XHCI_SendEndpointCommand(XhciExtension,
+                             XhciEndpoint,
+                             XHCI_TRB_TYPE_STOP_ENDPOINT,
+                             0);
+
+    XHCI_SetSlotEndpoint(XhciExtension, SlotId, 1, NULL);
+    XhciEndpoint->SlotId = 0;
+
+    /* Keep the slot while the device is there, the endpoint is reopened
+       with its new address or packet size */
+    PortSC.AsULONG = READ_REGISTER_ULONG(&XhciExtension->OperationalRegs->PortRegisters[Slot->RootPort - 1].PortStatusControl.AsULONG);
+
+    if (!PortSC.CurrentConnectStatus)
+        XHCI_DisableSlot(XhciExtension, SlotId);
+}
+
+MPSTATUS
+NTAPI
+XHCI_ReopenEndpoint(IN PVOID xhciExtension,
+                    IN PUSBPORT_ENDPOINT_PROPERTIES EndpointProperties,
+                    IN PVOID xhciEndpoint)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_ENDPOINT XhciEndpoint = xhciEndpoint;
+
+    DPRINT("XHCI_ReopenEndpoint: DeviceAddress - %x, EndpointAddress - %x\n",
+           EndpointProperties->DeviceAddress,
+           EndpointProperties->EndpointAddress);
+
+    /* The device was reset and may have a new address and slot. Take the
+       endpoint off the old slot, the transfer ring is kept and the new
+       endpoint context starts at its current enqueue pointer */
+    XHCI_CloseEndpoint(XhciExtension, XhciEndpoint, FALSE);
+
+    RtlCopyMemory(&XhciEndpoint->EndpointProperties,
+                  EndpointProperties,
+                  sizeof(XhciEndpoint->EndpointProperties));
+
+    return XHCI_AddEndpointToSlot(XhciExtension, XhciEndpoint);
+}
+
+/* Controller *************************************************************/
+
+static
+VOID
+XHCI_TakeControlHC(IN PXHCI_EXTENSION XhciExtension)
+{
+    PUCHAR CapabilityBase = (PUCHAR)XhciExtension->CapabilityRegisters;
+    XHCI_HC_CAPABILITY_PARAMS_1 CapParameters;
+    XHCI_EXTENDED_CAPABILITY Capability;
+    XHCI_LEGACY_SUPPORT_CAPABILITY LegacySupport;
+    XHCI_SUPPORTED_PROTOCOL_PORTS ProtocolPorts;
+    PULONG CapabilityReg;
+    ULONG Offset;
+    ULONG ControlStatus;
+    ULONG Port;
+    ULONG ix;
+
+    CapParameters.AsULONG = READ_REGISTER_ULONG(&XhciExtension->CapabilityRegisters->CapParameters1.AsULONG);
+    Offset = CapParameters.ExtendedCapabilitiesPointer << 2;
+
+    while (Offset)
+    {
+        CapabilityReg = (PULONG)(CapabilityBase + Offset);
+        Capability.AsULONG = READ_REGISTER_ULONG(CapabilityReg);
+
+        if (Capability.CapabilityID == XHCI_XCAP_ID_LEGACY_SUPPORT)
+        {
+            LegacySupport.AsULONG = Capability.AsULONG;
+
+            if (LegacySupport.BiosOwnedSemaphore)
+            {
+                LegacySupport.OsOwnedSemaphore = 1;
+                WRITE_REGISTER_ULONG(CapabilityReg, LegacySupport.AsULONG);
+
+                for (ix = 0; ix < 100; ix++)
+                {
+                    LegacySupport.AsULONG = READ_REGISTER_ULONG(CapabilityReg);
+
+                    if (!LegacySupport.BiosOwnedSemaphore)
+                        break;
+
+                    RegPacket.UsbPortWait(XhciExtension, 10);
+                }
+
+                if (LegacySupport.BiosOwnedSemaphore)
+                {
+                    DPRINT1("XHCI_TakeControlHC: BIOS did not release the controller\n");
+                    LegacySupport.BiosOwnedSemaphore = 0;
+                    WRITE_REGISTER_ULONG(CapabilityReg, LegacySupport.AsULONG);
+                }
+            }
+
+            /* No more SMIs, clear the pending ones */
+            ControlStatus = READ_REGISTER_ULONG(CapabilityReg + 1);
+            ControlStatus &= ~XHCI_LEGACY_SMI_ENABLE_MASK;
+            ControlStatus |= XHCI_LEGACY_SMI_STATUS_MASK;
+            WRITE_REGISTER_ULONG(CapabilityReg + 1, ControlStatus);
+        }
+        else if (Capability.CapabilityID == XHCI_XCAP_ID_SUPPORTED_PROTOCOL)
+        {
+            ProtocolPorts.AsULONG = READ_REGISTER_ULONG(CapabilityReg + 2);
+
+            /* Major revision is the top byte of the first dword */
+            if ((Capability.AsULONG >> 24) == 3)
+            {
+                for (ix = 0; ix < ProtocolPorts.CompatiblePortCount; ix++)
+                {
+                    Port = ProtocolPorts.CompatiblePortOffset + ix;
+
+                    if (Port && Port <= XHCI_MAX_PORTS)
+                        XhciExtension->Usb3PortBits |= 1 << (Port - 1);
+                }
+            }
+        }
+
+        if (!Capability.NextCapabilityPointer)
+            break;
+
+        Offset += Capability.NextCapabilityPointer << 2;
+    }
+}
+
+static
+MPSTATUS
+XHCI_InitializeHardware(IN PXHCI_EXTENSION XhciExtension)
+{
+    PXHCI_HW_REGISTERS OperationalRegs = XhciExtension->OperationalRegs;
+    XHCI_USB_COMMAND Command;
+    XHCI_USB_STATUS Status;
+    ULONG ix;
+
+    DPRINT("XHCI_InitializeHardware: ... \n");
+
+    Command.AsULONG = READ_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG);
+    Command.Run = 0;
+    WRITE_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG, Command.AsULONG);
+
+    for (ix = 0; ix < 20; ix++)
+    {
+        Status.AsULONG = READ_REGISTER_ULONG(&OperationalRegs->UsbStatus.AsULONG);
+
+        if (Status.HCHalted)
+            break;
+
+        RegPacket.UsbPortWait(XhciExtension, 1);
+    }
+
+    if (!Status.HCHalted)
+    {
+        DPRINT1("XHCI_InitializeHardware: Controller did not halt\n");
+        return MP_STATUS_HW_ERROR;
+    }
+
+    Command.AsULONG = READ_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG);
+    Command.Reset = 1;
+    WRITE_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG, Command.AsULONG);
+
+    for (ix = 0; ix < 100; ix++)
+    {
+        RegPacket.UsbPortWait(XhciExtension, 10);
+
+        Command.AsULONG = READ_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG);
+        Status.AsULONG = READ_REGISTER_ULONG(&OperationalRegs->UsbStatus.AsULONG);
+
+        if (!Command.Reset && !Status.ControllerNotReady)
+            return MP_STATUS_SUCCESS;
+    }
+
+    DPRINT1("XHCI_InitializeHardware: Reset failed\n");
+    return MP_STATUS_HW_ERROR;
+}
+
+static
+MPSTATUS
+XHCI_InitializeSchedule(IN PXHCI_EXTENSION XhciExtension,
+                        IN ULONG_PTR StartVA,
+                        IN ULONG StartPA)
+{
+    PXHCI_HW_REGISTERS OperationalRegs = XhciExtension->OperationalRegs;
+    PXHCI_INTERRUPTER Interrupter = &XhciExtension->Interrupter;
+    PXHCI_HC_RESOURCES HcResourcesVA;
+    XHCI_HC_STRUCTURAL_PARAMS_2 StructParameters;
+    PHYSICAL_ADDRESS Lowest;
+    PHYSICAL_ADDRESS Highest;
+    PHYSICAL_ADDRESS Boundary;
+    ULONG Configure;
+    ULONG ix;
+
+    DPRINT("XHCI_InitializeSchedule: StartVA - %p, StartPA - %lx\n", StartVA, StartPA);
+
+    HcResourcesVA = (PXHCI_HC_RESOURCES)StartVA;
+    RtlZeroMemory(HcResourcesVA, sizeof(XHCI_HC_RESOURCES));
+
+    XhciExtension->HcResourcesVA = HcResourcesVA;
+    XhciExtension->HcResourcesPA = StartPA;
+
+    RtlZeroMemory(XhciExtension->Slots, sizeof(XhciExtension->Slots));
+
+    /* Scratchpad buffers, the array itself sits on the first page */
+    StructParameters.AsULONG = READ_REGISTER_ULONG(&XhciExtension->CapabilityRegisters->StructParameters2.AsULONG);
+    XhciExtension->ScratchpadCount = (StructParameters.MaxScratchpadBuffersHi << 5) |
+                                     StructParameters.MaxScratchpadBuffersLo;
+
+    if (XhciExtension->ScratchpadCount)
+    {
+        Lowest.QuadPart = 0;
+        Highest.QuadPart = 0xFFFFFFFF;
+        Boundary.QuadPart = 0;
+
+        XhciExtension->ScratchpadArray = MmAllocateContiguousMemorySpecifyCache((XhciExtension->ScratchpadCount + 1) * PAGE_SIZE,
+                                                                                Lowest,
+                                                                                Highest,
+                                                                                Boundary,
+                                                                                MmNonCached);
+
+        if (!XhciExtension->ScratchpadArray)
+        {
+            DPRINT1("XHCI_InitializeSchedule: No memory for %lu scratchpad buffers\n",
+                    XhciExtension->ScratchpadCount);
+            return MP_STATUS_NO_RESOURCES;
+        }
+
+        RtlZeroMemory(XhciExtension->ScratchpadArray,
+                      (XhciExtension->ScratchpadCount + 1) * PAGE_SIZE);
+
+        for (ix = 0; ix < XhciExtension->ScratchpadCount; ix++)
+        {
+            XhciExtension->ScratchpadArray[2 * ix] =
+                MmGetPhysicalAddress((PUCHAR)XhciExtension->ScratchpadArray + (ix + 1) * PAGE_SIZE).LowPart;
+        }
+
+        HcResourcesVA->DeviceContextBaseArray[0] =
+            MmGetPhysicalAddress(XhciExtension->ScratchpadArray).LowPart;
+    }
+
+    Configure = READ_REGISTER_ULONG(&OperationalRegs->Configure);
+    Configure = (Configure & ~0xFF) | XhciExtension->MaxSlots;
+    WRITE_REGISTER_ULONG(&OperationalRegs->Configure, Configure);
+
+    WRITE_REGISTER_ULONG(&OperationalRegs->DeviceContextBaseArray[0],
+                         StartPA + FIELD_OFFSET(XHCI_HC_RESOURCES, DeviceContextBaseArray));
+    WRITE_REGISTER_ULONG(&OperationalRegs->DeviceContextBaseArray[1], 0);
+
+    /* Command Ring */
+    XHCI_InitializeRing(&XhciExtension->CommandRing,
+                        HcResourcesVA->CommandRing,
+                        StartPA + FIELD_OFFSET(XHCI_HC_RESOURCES, CommandRing),
+                        XHCI_COMMAND_RING_TRBS);
+
+    WRITE_REGISTER_ULONG(&OperationalRegs->CommandRingControl[0],
+                         XhciExtension->CommandRing.FirstTrbPA | XHCI_CRCR_RING_CYCLE_STATE);
+    WRITE_REGISTER_ULONG(&OperationalRegs->CommandRingControl[1], 0);
+
+    XhciExtension->IsCommandDone = TRUE;
+    XhciExtension->AddressTransfer = NULL;
+
+    /* Event Ring of the primary interrupter, one segment */
+    Interrupter->Registers = &XhciExtension->RuntimeRegs->Interrupter[0];
+    Interrupter->EventRing = HcResourcesVA->EventRing;
+    Interrupter->EventRingPA = StartPA + FIELD_OFFSET(XHCI_HC_RESOURCES, EventRing);
+    Interrupter->Dequeue = 0;
+    Interrupter->CycleState = XHCI_TRB_CYCLE;
+
+    HcResourcesVA->EventRingSegmentTable[0].RingSegmentBase[0] = Interrupter->EventRingPA;
+    HcResourcesVA->EventRingSegmentTable[0].RingSegmentBase[1] = 0;
+    HcResourcesVA->EventRingSegmentTable[0].RingSegmentSize = XHCI_EVENT_RING_TRBS;
+
+    WRITE_REGISTER_ULONG(&Interrupter->Registers->EventRingSegmentTableSize, 1);
+    WRITE_REGISTER_ULONG(&Interrupter->Registers->EventRingDequeuePointer[0],
+                         Interrupter->EventRingPA);
+    WRITE_REGISTER_ULONG(&Interrupter->Registers->EventRingDequeuePointer[1], 0);
+    WRITE_REGISTER_ULONG(&Interrupter->Registers->EventRingSegmentTableBase[0],
+                         StartPA + FIELD_OFFSET(XHCI_HC_RESOURCES, EventRingSegmentTable));
+    WRITE_REGISTER_ULONG(&Interrupter->Registers->EventRingSegmentTableBase[1], 0);
+
+    /* Coalesce completions into fewer interrupts */
+    WRITE_REGISTER_ULONG(&Interrupter->Registers->InterrupterModeration,
+                         XHCI_INTERRUPT_MODERATION);
+    WRITE_REGISTER_ULONG(&Interrupter->Registers->InterrupterManagement,
+                         XHCI_IMAN_INTERRUPT_ENABLE | XHCI_IMAN_INTERRUPT_PENDING);
+
+    return MP_STATUS_SUCCESS;
+}
+
+static
+VOID
+XHCI_FreeScratchpad(IN PXHCI_EXTENSION XhciExtension)
+{
+    if (!XhciExtension->ScratchpadArray)
+        return;
+
+    MmFreeContiguousMemorySpecifyCache(XhciExtension->ScratchpadArray,
+                                       (XhciExtension->ScratchpadCount + 1) * PAGE_SIZE,
+                                       MmNonCached);
+
+    XhciExtension->ScratchpadArray = NULL;
+}
+
+static
+BOOLEAN
+XHCI_WaitForHalted(IN PXHCI_EXTENSION XhciExtension,
+                   IN BOOLEAN IsHalted)
+{
+    XHCI_USB_STATUS Status;
+    ULONG ix;
+
+    for (ix = 0; ix < 200; ix++)
+    {
+        Status.AsULONG = READ_REGISTER_ULONG(&XhciExtension->OperationalRegs->UsbStatus.AsULONG);
+
+        if (Status.AsULONG == -1)
+            return FALSE;
+
+        if (Status.HCHalted == IsHalted)
+            return TRUE;
+
+        KeStallExecutionProcessor(100);
+    }
+
+    return FALSE;
+}
+
+MPSTATUS
+NTAPI
+XHCI_StartController(IN PVOID xhciExtension,
+                     IN PUSBPORT_RESOURCES Resources)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_HC_CAPABILITY_REGISTERS CapabilityRegisters;
+    PXHCI_HW_REGISTERS OperationalRegs;
+    XHCI_HC_STRUCTURAL_PARAMS_1 StructParameters;
+    XHCI_HC_CAPABILITY_PARAMS_1 CapParameters;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+    XHCI_USB_COMMAND Command;
+    MPSTATUS MPStatus;
+    UCHAR CapabilityRegLength;
+    ULONG Port;
+
+    DPRINT("XHCI_StartController: ... \n");
+
+    if ((Resources->ResourcesTypes & (USBPORT_RESOURCES_MEMORY | USBPORT_RESOURCES_INTERRUPT)) !=
+                                     (USBPORT_RESOURCES_MEMORY | USBPORT_RESOURCES_INTERRUPT))
+    {
+        DPRINT1("XHCI_StartController: Resources->ResourcesTypes - %x\n",
+                Resources->ResourcesTypes);
+
+        return MP_STATUS_ERROR;
+    }
+
+    KeInitializeSpinLock(&XhciExtension->EventLock);
+
+    CapabilityRegisters = (PXHCI_HC_CAPABILITY_REGISTERS)Resources->ResourceBase;
+    XhciExtension->CapabilityRegisters = CapabilityRegisters;
+
+    CapabilityRegLength = READ_REGISTER_UCHAR(&CapabilityRegisters->RegistersLength);
+
+    OperationalRegs = (PXHCI_HW_REGISTERS)((ULONG_PTR)CapabilityRegisters +
+                                                      CapabilityRegLength);
+    XhciExtension->OperationalRegs = OperationalRegs;
+
+    XhciExtension->RuntimeRegs = (PXHCI_RUNTIME_REGISTERS)((ULONG_PTR)CapabilityRegisters +
+                                 (READ_REGISTER_ULONG(&CapabilityRegisters->RuntimeRegistersOffset) & ~0x1F));
+
+    XhciExtension->DoorbellArray = (PULONG)((ULONG_PTR)CapabilityRegisters +
+                                   (READ_REGISTER_ULONG(&CapabilityRegisters->DoorbellOffset) & ~0x3));
+
+    StructParameters.AsULONG = READ_REGISTER_ULONG(&CapabilityRegisters->StructParameters1.AsULONG);
+    CapParameters.AsULONG = READ_REGISTER_ULONG(&CapabilityRegisters->CapParameters1.AsULONG);
+
+    XhciExtension->MaxSlots = min(StructParameters.MaxDeviceSlots, XHCI_MAX_SLOTS);
+    XhciExtension->NumberOfPorts = (USHORT)min(StructParameters.MaxPorts, XHCI_MAX_PORTS);
+    XhciExtension->ContextSize = CapParameters.ContextSize ? 64 : 32;
+    XhciExtension->PortPowerControl = (BOOLEAN)CapParameters.PortPowerControl;
+
+    DPRINT("XHCI_StartController: OperationalRegs - %p, MaxSlots - %lu, NumberOfPorts - %u, ContextSize - %lu\n",
+           OperationalRegs,
+           XhciExtension->MaxSlots,
+           XhciExtension->NumberOfPorts,
+           XhciExtension->ContextSize);
+
+    XhciExtension->Usb3PortBits = 0;
+    XhciExtension->ResetPortBits = 0;
+    XhciExtension->SuspendPortBits = 0;
+
+    XHCI_TakeControlHC(XhciExtension);
+
+    MPStatus = XHCI_InitializeHardware(XhciExtension);
+
+    if (MPStatus)
+    {
+        DPRINT1("XHCI_StartController: Unsuccessful InitializeHardware()\n");
+        return MPStatus;
+    }
+
+    MPStatus = XHCI_InitializeSchedule(XhciExtension,
+                                       Resources->StartVA,
+                                       Resources->StartPA);
+
+    if (MPStatus)
+    {
+        DPRINT1("XHCI_StartController: Unsuccessful InitializeSchedule()\n");
+        return MPStatus;
+    }
+
+    Command.AsULONG = READ_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG);
+    Command.Run = 1;
+    Command.HostSystemErrorEnable = 1;
+    WRITE_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG, Command.AsULONG);
+
+    if (!XHCI_WaitForHalted(XhciExtension, FALSE))
+    {
+        DPRINT1("XHCI_StartController: Controller did not start\n");
+        XHCI_FreeScratchpad(XhciExtension);
+        return MP_STATUS_HW_ERROR;
+    }
+
+    if (XhciExtension->PortPowerControl)
+    {
+        for (Port = 0; Port < XhciExtension->NumberOfPorts; Port++)
+        {
+            PortSC.AsULONG = READ_REGISTER_ULONG(&OperationalRegs->PortRegisters[Port].PortStatusControl.AsULONG);
+            PortSC.AsULONG &= XHCI_PORTSC_PRESERVE_MASK;
+            PortSC.PortPower = 1;
+            WRITE_REGISTER_ULONG(&OperationalRegs->PortRegisters[Port].PortStatusControl.AsULONG,
+                                 PortSC.AsULONG);
+        }
+
+        RegPacket.UsbPortWait(XhciExtension, 20);
+    }
+
+    XhciExtension->IsStarted = TRUE;
+
+    return MP_STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+XHCI_StopController(IN PVOID xhciExtension,
+                    IN BOOLEAN DisableInterrupts)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_HW_REGISTERS OperationalRegs = XhciExtension->OperationalRegs;
+    XHCI_USB_COMMAND Command;
+
+    DPRINT("XHCI_StopController: DisableInterrupts - %x\n", DisableInterrupts);
+
+    Command.AsULONG = READ_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG);
+    Command.Run = 0;
+
+    if (DisableInterrupts)
+        Command.InterrupterEnable = 0;
+
+    WRITE_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG, Command.AsULONG);
+
+    if (!XHCI_WaitForHalted(XhciExtension, TRUE))
+        DPRINT1("XHCI_StopController: Controller did not halt\n");
+
+    XHCI_FreeScratchpad(XhciExtension);
+    XhciExtension->IsStarted = FALSE;
+}
+
+VOID
+NTAPI
+XHCI_SuspendController(IN PVOID xhciExtension)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_HW_REGISTERS OperationalRegs = XhciExtension->OperationalRegs;
+    XHCI_USB_COMMAND Command;
+
+    DPRINT("XHCI_SuspendController: ... \n");
+
+    Command.AsULONG = READ_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG);
+    Command.Run = 0;
+    WRITE_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG, Command.AsULONG);
+
+    if (!XHCI_WaitForHalted(XhciExtension, TRUE))
+        DPRINT1("XHCI_SuspendController: Controller did not halt\n");
+
+    XhciExtension->Flags |= XHCI_FLAGS_CONTROLLER_SUSPEND;
+}
+
+MPSTATUS
+NTAPI
+XHCI_ResumeController(IN PVOID xhciExtension)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_HW_REGISTERS OperationalRegs = XhciExtension->OperationalRegs;
+    XHCI_USB_COMMAND Command;
+
+    DPRINT("XHCI_ResumeController: ... \n");
+
+    Command.AsULONG = READ_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG);
+
+    if (Command.AsULONG == -1)
+        return MP_STATUS_HW_ERROR;
+
+    Command.Run = 1;
+    WRITE_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG, Command.AsULONG);
+
+    if (!XHCI_WaitForHalted(XhciExtension, FALSE))
+    {
+        DPRINT1("XHCI_ResumeController: Controller did not start\n");
+        return MP_STATUS_HW_ERROR;
+    }
+
+    XhciExtension->Flags &= ~XHCI_FLAGS_CONTROLLER_SUSPEND;
+
+    return MP_STATUS_SUCCESS;
+}
+
+BOOLEAN
+NTAPI
+XHCI_InterruptService(IN PVOID xhciExtension)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_HW_REGISTERS OperationalRegs = XhciExtension->OperationalRegs;
+    PXHCI_INTERRUPTER_REGISTERS InterrupterRegs;
+    XHCI_USB_STATUS Status;
+    ULONG Management;
+
+    Status.AsULONG = READ_REGISTER_ULONG(&OperationalRegs->UsbStatus.AsULONG);
+
+    if (Status.AsULONG == -1)
+        return FALSE;
+
+    if (!Status.EventInterrupt && !Status.HostSystemError)
+        return FALSE;
+
+    WRITE_REGISTER_ULONG(&OperationalRegs->UsbStatus.AsULONG,
+                         Status.AsULONG & XHCI_USB_STATUS_RW1C_MASK);
+
+    /* The interrupter stays quiet until the DPC writes ERDP with EHB */
+    InterrupterRegs = XhciExtension->Interrupter.Registers;
+    Management = READ_REGISTER_ULONG(&InterrupterRegs->InterrupterManagement);
+    WRITE_REGISTER_ULONG(&InterrupterRegs->InterrupterManagement,
+                         Management | XHCI_IMAN_INTERRUPT_PENDING);
+
+    if (Status.HostSystemError)
+        DPRINT1("XHCI_InterruptService: Host System Error, Status - %lx\n", Status.AsULONG);
+
+    return TRUE;
+}
+
+VOID
+NTAPI
+XHCI_InterruptDpc(IN PVOID xhciExtension,
+                  IN BOOLEAN EnableInterrupts)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    BOOLEAN IsTransferEvent;
+    BOOLEAN IsPortEvent;
+
+    DPRINT_XHCI("XHCI_InterruptDpc: [%p] EnableInterrupts - %x\n",
+                XhciExtension, EnableInterrupts);
+
+    KeAcquireSpinLockAtDpcLevel(&XhciExtension->EventLock);
+
+    XHCI_ProcessEvents(XhciExtension);
+
+    IsTransferEvent = XhciExtension->IsTransferEvent;
+    IsPortEvent = XhciExtension->IsPortEvent;
+    XhciExtension->IsTransferEvent = FALSE;
+    XhciExtension->IsPortEvent = FALSE;
+
+    KeReleaseSpinLockFromDpcLevel(&XhciExtension->EventLock);
+
+    if (IsTransferEvent)
+        RegPacket.UsbPortInvalidateEndpoint(XhciExtension, NULL);
+
+    if (IsPortEvent && !(XhciExtension->Flags & XHCI_FLAGS_ROOT_HUB_IRQ_OFF))
+        RegPacket.UsbPortInvalidateRootHub(XhciExtension);
+}
+
+/* Transfers **************************************************************/
+
+/* Queues the data buffer as one TRB per physically contiguous run,
+   split only where a TRB would cross a 64K boundary */
+static
+VOID
+XHCI_QueueSgList(IN PXHCI_RING Ring,
+                 IN PUSBPORT_SCATTER_GATHER_LIST SgList,
+                 IN ULONG TransferLength,
+                 IN ULONG MaxPacketSize,
+                 IN ULONG FirstControl,
+                 IN ULONG NextControl,
+                 IN BOOLEAN IsChainLast,
+                 IN OUT PBOOLEAN IsFirst)
+{
+    XHCI_TRB Trb;
+    ULONGLONG Address;
+    ULONG Control = FirstControl;
+    ULONG Remain = TransferLength;
+    ULONG Length;
+    ULONG Chunk;
+    ULONG Packets;
+    ULONG ix = 0;
+
+    if (TransferLength == 0)
+    {
+        RtlZeroMemory(&Trb, sizeof(Trb));
+        Trb.Control = FirstControl | (IsChainLast ? XHCI_TRB_CHAIN : 0);
+        XHCI_QueueTrb(Ring, &Trb, *IsFirst);
+        *IsFirst = FALSE;
+        return;
+    }
+
+    while (ix < SgList->SgElementCount && Remain)
+    {
+        Address = SgList->SgElement[ix].SgPhysicalAddress.QuadPart;
+        Length = SgList->SgElement[ix].SgTransferLength;
+
+        for (ix++; ix < SgList->SgElementCount; ix++)
+        {
+            if ((ULONGLONG)SgList->SgElement[ix].SgPhysicalAddress.QuadPart != Address + Length)
+                break;
+
+            Length += SgList->SgElement[ix].SgTransferLength;
+        }
+
+        while (Length && Remain)
+        {
+            Chunk = XHCI_TRB_MAX_BUFFER - (ULONG)(Address & (XHCI_TRB_MAX_BUFFER - 1));
+            Chunk = min(Chunk, Length);
+            Chunk = min(Chunk, Remain);
+
+            Length -= Chunk;
+            Remain -= Chunk;
+
+            Packets = (Remain + MaxPacketSize - 1) / MaxPacketSize;
+
+            Trb.Parameter[0] = (ULONG)Address;
+            Trb.Parameter[1] = (ULONG)(Address >> 32);
+            Trb.Status = Chunk | XHCI_TRB_TD_SIZE(min(Packets, XHCI_TRB_MAX_TD_SIZE));
+            Trb.Control = Control;
+
+            if (Remain || IsChainLast)
+                Trb.Control |= XHCI_TRB_CHAIN;
+
+            XHCI_QueueTrb(Ring, &Trb, *IsFirst);
+
+            *IsFirst = FALSE;
+            Control = NextControl;
+            Address += Chunk;
+        }
+    }
+}
+
+static
+VOID
+XHCI_ControlTransfer(IN PXHCI_ENDPOINT XhciEndpoint,
+                     IN PUSBPORT_TRANSFER_PARAMETERS TransferParameters,
+                     IN PUSBPORT_SCATTER_GATHER_LIST SgList,
+                     IN ULONG MaxPacketSize)
+{
+    PXHCI_RING Ring = &XhciEndpoint->TransferRing;
+    XHCI_TRB Trb;
+    ULONG Length;
+    BOOLEAN IsIn;
+    BOOLEAN IsFirst = TRUE;
+
+    Length = TransferParameters->TransferBufferLength;
+    IsIn = (TransferParameters->TransferFlags & USBD_TRANSFER_DIRECTION_IN) != 0;
+
+    /* Setup Stage, the packet is immediate data */
+    RtlCopyMemory(Trb.Parameter, &TransferParameters->SetupPacket, sizeof(Trb.Parameter));
+    Trb.Status = sizeof(USB_DEFAULT_PIPE_SETUP_PACKET);
+    Trb.Control = XHCI_TRB_TYPE(XHCI_TRB_TYPE_SETUP_STAGE) | XHCI_TRB_IMMEDIATE_DATA;
+
+    if (Length)
+        Trb.Control |= IsIn ? XHCI_TRB_TRANSFER_TYPE_IN : XHCI_TRB_TRANSFER_TYPE_OUT;
+    else
+        Trb.Control |= XHCI_TRB_TRANSFER_TYPE_NO_DATA;
+
+    XHCI_QueueTrb(Ring, &Trb, IsFirst);
+    IsFirst = FALSE;
+
+    /* Data Stage */
+    if (Length)
+    {
+        XHCI_QueueSgList(Ring,
+                         SgList,
+                         Length,
+                         MaxPacketSize,
+                         XHCI_TRB_TYPE(XHCI_TRB_TYPE_DATA_STAGE) |
+                         XHCI_TRB_INTERRUPT_SHORT |
+                         (IsIn ? XHCI_TRB_DIRECTION_IN : 0),
+                         XHCI_TRB_TYPE(XHCI_TRB_TYPE_NORMAL) |
+                         XHCI_TRB_INTERRUPT_SHORT,
+                         FALSE,
+                         &IsFirst);
+    }
+
+    /* Status Stage goes the other way, or IN without data */
+    RtlZeroMemory(&Trb, sizeof(Trb));
+    Trb.Control = XHCI_TRB_TYPE(XHCI_TRB_TYPE_STATUS_STAGE) |
+                  XHCI_TRB_INTERRUPT_ON_COMPLETE;
+
+    if (Length == 0 || !IsIn)
+        Trb.Control |= XHCI_TRB_DIRECTION_IN;
+
+    XHCI_QueueTrb(Ring, &Trb, IsFirst);
+}
+
+static
+VOID
+XHCI_BulkTransfer(IN PXHCI_ENDPOINT XhciEndpoint,
+                  IN PUSBPORT_TRANSFER_PARAMETERS TransferParameters,
+                  IN PXHCI_TRANSFER XhciTransfer,
+                  IN PUSBPORT_SCATTER_GATHER_LIST SgList,
+                  IN ULONG MaxPacketSize)
+{
+    PXHCI_RING Ring = &XhciEndpoint->TransferRing;
+    XHCI_TRB Trb;
+    ULONGLONG EventData;
+    BOOLEAN IsFirst = TRUE;
+
+    XHCI_QueueSgList(Ring,
+                     SgList,
+                     TransferParameters->TransferBufferLength,
+                     MaxPacketSize,
+                     XHCI_TRB_TYPE(XHCI_TRB_TYPE_NORMAL),
+                     XHCI_TRB_TYPE(XHCI_TRB_TYPE_NORMAL),
+                     TRUE,
+                     &IsFirst);
+
+    /* One completion per TD. The Event Data TRB reports the transfer
+       and the byte count of the whole TD, short packets included */
+    EventData = (ULONG_PTR)XhciTransfer;
+
+    Trb.Parameter[0] = (ULONG)EventData;
+    Trb.Parameter[1] = (ULONG)(EventData >> 32);
+    Trb.Status = 0;
+    Trb.Control = XHCI_TRB_TYPE(XHCI_TRB_TYPE_EVENT_DATA) |
+                  XHCI_TRB_INTERRUPT_ON_COMPLETE;
+
+    XHCI_QueueTrb(Ring, &Trb, IsFirst);
+}
+
+static
+ULONG
+XHCI_GetFreeTrbs(IN PXHCI_ENDPOINT XhciEndpoint)
+{
+    PXHCI_RING Ring = &XhciEndpoint->TransferRing;
+    PXHCI_TRANSFER HeadTransfer;
+    ULONG Used;
+
+    if (IsListEmpty(&XhciEndpoint->TransferList))
+        return Ring->TrbCount - 1;
+
+    HeadTransfer = CONTAINING_RECORD(XhciEndpoint->TransferList.Flink,
+                                     XHCI_TRANSFER,
+                                     TransferLink);
+
+    Used = (Ring->Enqueue + Ring->TrbCount - HeadTransfer->FirstTrb) % Ring->TrbCount;
+
+    return Ring->TrbCount - 1 - Used;
+}
+
+static
+VOID
+XHCI_InsertTransfer(IN PXHCI_EXTENSION XhciExtension,
+                    IN PXHCI_ENDPOINT XhciEndpoint,
+                    IN PXHCI_TRANSFER XhciTransfer)
+{
+    KeAcquireSpinLockAtDpcLevel(&XhciExtension->EventLock);
+    InsertTailList(&XhciEndpoint->TransferList, &XhciTransfer->TransferLink);
+    KeReleaseSpinLockFromDpcLevel(&XhciExtension->EventLock);
+}
+
+/* Completes a transfer that never goes to the controller */
+static
+VOID
+XHCI_CompleteTransferNow(IN PXHCI_EXTENSION XhciExtension,
+                         IN PXHCI_ENDPOINT XhciEndpoint,
+                         IN PXHCI_TRANSFER XhciTransfer,
+                         IN ULONG CompletionCode)
+{
+    PXHCI_RING Ring = &XhciEndpoint->TransferRing;
+
+    XhciTransfer->FirstTrb = Ring->Enqueue;
+    XhciTransfer->FirstCycle = Ring->CycleState;
+    XhciTransfer->NextTrb = Ring->Enqueue;
+    XhciTransfer->NextCycle = Ring->CycleState;
+    XhciTransfer->TrbCount = 0;
+    XhciTransfer->TransferLen = 0;
+    XhciTransfer->CompletionCode = CompletionCode;
+    XhciTransfer->IsDone = TRUE;
+
+    XHCI_InsertTransfer(XhciExtension, XhciEndpoint, XhciTransfer);
+
+    RegPacket.UsbPortInvalidateEndpoint(XhciExtension, XhciEndpoint);
+}
+
+MPSTATUS
+NTAPI
+XHCI_SubmitTransfer(IN PVOID xhciExtension,
+                    IN PVOID xhciEndpoint,
+                    IN PUSBPORT_TRANSFER_PARAMETERS TransferParameters,
+                    IN PVOID xhciTransfer,
+                    IN PUSBPORT_SCATTER_GATHER_LIST SgList)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_ENDPOINT XhciEndpoint = xhciEndpoint;
+    PXHCI_TRANSFER XhciTransfer = xhciTransfer;
+    PXHCI_RING Ring = &XhciEndpoint->TransferRing;
+    PUSB_DEFAULT_PIPE_SETUP_PACKET SetupPacket;
+    ULONG MaxPacketSize;
+    ULONG NeedTrbs;
+
+    DPRINT_XHCI("XHCI_SubmitTransfer: XhciEndpoint - %p, TransferBufferLength - %x\n",
+                XhciEndpoint,
+                TransferParameters->TransferBufferLength);
+
+    RtlZeroMemory(XhciTransfer, sizeof(XHCI_TRANSFER));
+
+    XhciTransfer->TransferParameters = TransferParameters;
+    XhciTransfer->XhciEndpoint = XhciEndpoint;
+
+    if (!XhciEndpoint->SlotId)
+    {
+        XHCI_CompleteTransferNow(XhciExtension,
+                                 XhciEndpoint,
+                                 XhciTransfer,
+                                 XHCI_COMPLETION_SLOT_NOT_ENABLED);
+        return MP_STATUS_SUCCESS;
+    }
+
+    if (XhciEndpoint->Dci == 1)
+    {
+        SetupPacket = &TransferParameters->SetupPacket;
+
+        if (SetupPacket->bmRequestType.B == 0 &&
+            SetupPacket->bRequest == USB_REQUEST_SET_ADDRESS)
+        {
+            /* One at a time, USBPORT submits it again later */
+            if (XhciExtension->AddressTransfer)
+                return MP_STATUS_FAILURE;
+
+            XHCI_SetAddress(XhciExtension, XhciEndpoint, XhciTransfer);
+            return MP_STATUS_SUCCESS;
+        }
+    }
+
+    /* Worst case: a TRB per element and per 64K boundary, the stage
+       or Event Data TRBs, and the Link TRBs crossed on the way */
+    NeedTrbs = SgList->SgElementCount +
+               (TransferParameters->TransferBufferLength / XHCI_TRB_MAX_BUFFER) + 3;
+    NeedTrbs += NeedTrbs / (XHCI_SEGMENT_TRBS - 1) + 1;
+
+    if (XHCI_GetFreeTrbs(XhciEndpoint) < NeedTrbs)
+    {
+        DPRINT_XHCI("XHCI_SubmitTransfer: Ring is full\n");
+        return MP_STATUS_FAILURE;
+    }
+
+    MaxPacketSize = XHCI_GetMaxPacketSize(XhciExtension, XhciEndpoint);
+
+    XhciTransfer->FirstTrb = Ring->Enqueue;
+    XhciTransfer->FirstCycle = Ring->CycleState;
+
+    if (XhciEndpoint->EndpointProperties.TransferType == USBPORT_TRANSFER_TYPE_CONTROL)
+    {
+        XHCI_ControlTransfer(XhciEndpoint,
+                             TransferParameters,
+                             SgList,
+                             MaxPacketSize);
+    }
+    else
+    {
+        XHCI_BulkTransfer(XhciEndpoint,
+                          TransferParameters,
+                          XhciTransfer,
+                          SgList,
+                          MaxPacketSize);
+    }
+
+    XhciTransfer->NextTrb = Ring->Enqueue;
+    XhciTransfer->NextCycle = Ring->CycleState;
+    XhciTransfer->TrbCount = (Ring->Enqueue + Ring->TrbCount - XhciTransfer->FirstTrb) %
+                             Ring->TrbCount;
+
+    XHCI_InsertTransfer(XhciExtension, XhciEndpoint, XhciTransfer);
+
+    /* Give the whole TD to the controller at once */
+    KeMemoryBarrier();
+    Ring->FirstTrb[XhciTransfer->FirstTrb].Control ^= XHCI_TRB_CYCLE;
+
+    XHCI_RingDoorbell(XhciExtension, XhciEndpoint->SlotId, XhciEndpoint->Dci);
+
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_SubmitIsoTransfer(IN PVOID xhciExtension,
+                       IN PVOID xhciEndpoint,
+                       IN PUSBPORT_TRANSFER_PARAMETERS TransferParameters,
+                       IN PVOID xhciTransfer,
+                       IN PVOID isoParameters)
+{
+    DPRINT1("XHCI_SubmitIsoTransfer: UNIMPLEMENTED. FIXME\n");
+    return MP_STATUS_NOT_SUPPORTED;
+}
+
+/* Restarts a halted endpoint at the first TD that is still pending */
+static
+VOID
+XHCI_ResetEndpoint(IN PXHCI_EXTENSION XhciExtension,
+                   IN PXHCI_ENDPOINT XhciEndpoint)
+{
+    PXHCI_RING Ring = &XhciEndpoint->TransferRing;
+    PXHCI_TRANSFER XhciTransfer;
+    PLIST_ENTRY Entry;
+    ULONG Index;
+    ULONG Cycle;
+    BOOLEAN IsPending = FALSE;
+    KIRQL OldIrql;
+
+    DPRINT("XHCI_ResetEndpoint: XhciEndpoint - %p\n", XhciEndpoint);
+
+    if (!XhciEndpoint->SlotId)
+        return;
+
+    XHCI_SendEndpointCommand(XhciExtension,
+                             XhciEndpoint,
+                             XHCI_TRB_TYPE_RESET_ENDPOINT,
+                             0);
+
+    Index = Ring->Enqueue;
+    Cycle = Ring->CycleState;
+
+    KeAcquireSpinLock(&XhciExtension->EventLock, &OldIrql);
+
+    for (Entry = XhciEndpoint->TransferList.Flink;
+         Entry != &XhciEndpoint->TransferList;
+         Entry = Entry->Flink)
+    {
+        XhciTransfer = CONTAINING_RECORD(Entry, XHCI_TRANSFER, TransferLink);
+
+        if (!XhciTransfer->IsDone)
+        {
+            Index = XhciTransfer->FirstTrb;
+            Cycle = XhciTransfer->FirstCycle;
+            IsPending = TRUE;
+            break;
+        }
+    }
+
+    KeReleaseSpinLock(&XhciExtension->EventLock, OldIrql);
+
+    XHCI_SetDequeuePointer(XhciExtension, XhciEndpoint, Index, Cycle);
+
+    if (IsPending)
+        XHCI_RingDoorbell(XhciExtension, XhciEndpoint->SlotId, XhciEndpoint->Dci);
+}
+
+VOID
+NTAPI
+XHCI_AbortTransfer(IN PVOID xhciExtension,
+                   IN PVOID xhciEndpoint,
+                   IN PVOID xhciTransfer,
+                   IN PULONG CompletedLength)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_ENDPOINT XhciEndpoint = xhciEndpoint;
+    PXHCI_TRANSFER XhciTransfer = xhciTransfer;
+    PXHCI_RING Ring = &XhciEndpoint->TransferRing;
+    PXHCI_TRB Trb;
+    BOOLEAN IsHead;
+    ULONG Index;
+    ULONG ix;
+
+    DPRINT("XHCI_AbortTransfer: XhciTransfer - %p\n", XhciTransfer);
+
+    if (XhciTransfer == XhciExtension->AddressTransfer)
+    {
+        XHCI_FlushCommand(XhciExtension, XHCI_ADDRESS_TIMEOUT_US);
+        XHCI_FinishSetAddress(XhciExtension, XhciTransfer);
+    }
+
+    KeAcquireSpinLockAtDpcLevel(&XhciExtension->EventLock);
+    IsHead = (XhciEndpoint->TransferList.Flink == &XhciTransfer->TransferLink);
+    RemoveEntryList(&XhciTransfer->TransferLink);
+    KeReleaseSpinLockFromDpcLevel(&XhciExtension->EventLock);
+
+    *CompletedLength = XhciTransfer->IsDone ? XhciTransfer->TransferLen : 0;
+
+    if (XhciTransfer->IsDone || XhciTransfer->TrbCount == 0)
+        return;
+
+    /* The endpoint is stopped. Turn the TD into No Ops, in case the
+       controller already fetched it, and move past it if it was next */
+    Index = XhciTransfer->FirstTrb;
+
+    for (ix = 0; ix < XhciTransfer->TrbCount; ix++)
+    {
+        Trb = &Ring->FirstTrb[Index];
+
+        if (XHCI_TRB_GET_TYPE(Trb->Control) != XHCI_TRB_TYPE_LINK)
+        {
+            Trb->Control = (Trb->Control & (XHCI_TRB_CYCLE | XHCI_TRB_CHAIN)) |
+                           XHCI_TRB_TYPE(XHCI_TRB_TYPE_NO_OP);
+        }
+
+        Index = (Index + 1) % Ring->TrbCount;
+    }
+
+    if (IsHead && XhciEndpoint->SlotId)
+    {
+        XHCI_SetDequeuePointer(XhciExtension,
+                               XhciEndpoint,
+                               XhciTransfer->NextTrb,
+                               XhciTransfer->NextCycle);
+    }
+}
+
+ULONG
+NTAPI
+XHCI_GetEndpointState(IN PVOID xhciExtension,
+                      IN PVOID xhciEndpoint)
+{
+    PXHCI_ENDPOINT XhciEndpoint = xhciEndpoint;
+
+    DPRINT("XHCI_GetEndpointState: EndpointState - %x\n", XhciEndpoint->EndpointState);
+    return XhciEndpoint->EndpointState;
+}
+
+VOID
+NTAPI
+XHCI_SetEndpointState(IN PVOID xhciExtension,
+                      IN PVOID xhciEndpoint,
+                      IN ULONG EndpointState)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_ENDPOINT XhciEndpoint = xhciEndpoint;
+
+    DPRINT("XHCI_SetEndpointState: XhciEndpoint - %p, EndpointState - %x\n",
+           XhciEndpoint,
+           EndpointState);
+
+    switch (EndpointState)
+    {
+        case USBPORT_ENDPOINT_PAUSED:
+            if (XhciEndpoint->SlotId &&
+                XhciEndpoint->EndpointState == USBPORT_ENDPOINT_ACTIVE)
+            {
+                XHCI_SendEndpointCommand(XhciExtension,
+                                         XhciEndpoint,
+                                         XHCI_TRB_TYPE_STOP_ENDPOINT,
+                                         0);
+            }
+            break;
+
+        case USBPORT_ENDPOINT_ACTIVE:
+            /* A doorbell restarts a stopped endpoint */
+            if (XhciEndpoint->SlotId &&
+                !IsListEmpty(&XhciEndpoint->TransferList))
+            {
+                XHCI_RingDoorbell(XhciExtension, XhciEndpoint->SlotId, XhciEndpoint->Dci);
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    XhciEndpoint->EndpointState = EndpointState;
+}
+
+static
+USBD_STATUS
+XHCI_GetUsbdStatus(IN ULONG CompletionCode)
+{
+    switch (CompletionCode)
+    {
+        case XHCI_COMPLETION_SUCCESS:
+        case XHCI_COMPLETION_SHORT_PACKET:
+            return USBD_STATUS_SUCCESS;
+
+        case XHCI_COMPLETION_STALL_ERROR:
+            return USBD_STATUS_STALL_PID;
+
+        case XHCI_COMPLETION_BABBLE_DETECTED:
+            return USBD_STATUS_BABBLE_DETECTED;
+
+        case XHCI_COMPLETION_DATA_BUFFER_ERROR:
+            return USBD_STATUS_DATA_BUFFER_ERROR;
+
+        case XHCI_COMPLETION_TRANSACTION_ERROR:
+            return USBD_STATUS_XACT_ERROR;
+
+        case XHCI_COMPLETION_SLOT_NOT_ENABLED:
+            return USBD_STATUS_DEVICE_GONE;
+
+        default:
+            return USBD_STATUS_INTERNAL_HC_ERROR;
+    }
+}
+
+VOID
+NTAPI
+XHCI_PollEndpoint(IN PVOID xhciExtension,
+                  IN PVOID xhciEndpoint)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_ENDPOINT XhciEndpoint = xhciEndpoint;
+    PXHCI_TRANSFER XhciTransfer;
+    LIST_ENTRY DoneList;
+    USBD_STATUS USBDStatus;
+    BOOLEAN IsHalted = FALSE;
+
+    InitializeListHead(&DoneList);
+
+    /* Completions are in ring order, stop at the first pending TD */
+    KeAcquireSpinLockAtDpcLevel(&XhciExtension->EventLock);
+
+    while (!IsListEmpty(&XhciEndpoint->TransferList))
+    {
+        XhciTransfer = CONTAINING_RECORD(XhciEndpoint->TransferList.Flink,
+                                         XHCI_TRANSFER,
+                                         TransferLink);
+
+        if (!XhciTransfer->IsDone)
+            break;
+
+        RemoveHeadList(&XhciEndpoint->TransferList);
+        InsertTailList(&DoneList, &XhciTransfer->TransferLink);
+    }
+
+    KeReleaseSpinLockFromDpcLevel(&XhciExtension->EventLock);
+
+    while (!IsListEmpty(&DoneList))
+    {
+        XhciTransfer = CONTAINING_RECORD(RemoveHeadList(&DoneList),
+                                         XHCI_TRANSFER,
+                                         TransferLink);
+
+        if (XhciTransfer == XhciExtension->AddressTransfer)
+            XHCI_FinishSetAddress(XhciExtension, XhciTransfer);
+
+        USBDStatus = XHCI_GetUsbdStatus(XhciTransfer->CompletionCode);
+
+        if (USBDStatus != USBD_STATUS_SUCCESS &&
+            XhciTransfer->CompletionCode != XHCI_COMPLETION_SLOT_NOT_ENABLED &&
+            XhciTransfer->TrbCount)
+        {
+            IsHalted = TRUE;
+        }
+
+        DPRINT_XHCI("XHCI_PollEndpoint: XhciTransfer - %p, CompletionCode - %x, TransferLen - %x\n",
+                    XhciTransfer,
+                    XhciTransfer->CompletionCode,
+                    XhciTransfer->TransferLen);
+
+        RegPacket.UsbPortCompleteTransfer(XhciExtension,
+                                          XhciEndpoint,
+                                          XhciTransfer->TransferParameters,
+                                          USBDStatus,
+                                          XhciTransfer->TransferLen);
+    }
+
+    if (!IsHalted)
+        return;
+
+    /* A control endpoint recovers by itself on the next SETUP */
+    if (XhciEndpoint->EndpointStatus & USBPORT_ENDPOINT_CONTROL)
+        XHCI_ResetEndpoint(XhciExtension, XhciEndpoint);
+    else
+        XhciEndpoint->EndpointStatus |= USBPORT_ENDPOINT_HALT;
+}
+
+VOID
+NTAPI
+XHCI_CheckController(IN PVOID xhciExtension)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+
+    if (!XhciExtension->IsStarted)
+        return;
+
+    if (READ_REGISTER_ULONG(&XhciExtension->OperationalRegs->UsbStatus.AsULONG) == -1)
+    {
+        DPRINT1("XHCI_CheckController: Controller is gone\n");
+        RegPacket.UsbPortInvalidateController(XhciExtension,
+                                              USBPORT_INVALIDATE_CONTROLLER_SURPRISE_REMOVE);
+        return;
+    }
+
+    /* The controller fails a SET_ADDRESS that gets no answer by itself,
+       this only catches an Address Device that never completes */
+    if (XhciExtension->AddressTransfer &&
+        !XhciExtension->IsCommandDone &&
+        KeQueryInterruptTime() - XhciExtension->AddressTime > XHCI_ADDRESS_TIMEOUT_US * 10)
+    {
+        XHCI_FlushCommand(XhciExtension, 0);
+    }
+}
+
+ULONG
+NTAPI
+XHCI_Get32BitFrameNumber(IN PVOID xhciExtension)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    ULONG FrameIndex;
+
+    FrameIndex = READ_REGISTER_ULONG(&XhciExtension->RuntimeRegs->MicroframeIndex);
+    FrameIndex = (FrameIndex >> 3) & XHCI_MFINDEX_FRAME_MASK;
+
+    if (FrameIndex < XhciExtension->FrameIndex)
+        XhciExtension->FrameHighPart += XHCI_MFINDEX_FRAME_MASK + 1;
+
+    XhciExtension->FrameIndex = FrameIndex;
+
+    return XhciExtension->FrameHighPart + FrameIndex;
+}
+
+VOID
+NTAPI
+XHCI_InterruptNextSOF(IN PVOID xhciExtension)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+
+    DPRINT_XHCI("XHCI_InterruptNextSOF: ... \n");
+
+    RegPacket.UsbPortInvalidateController(XhciExtension,
+                                          USBPORT_INVALIDATE_CONTROLLER_SOFT_INTERRUPT);
+}
+
+VOID
+NTAPI
+XHCI_EnableInterrupts(IN PVOID xhciExtension)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_HW_REGISTERS OperationalRegs = XhciExtension->OperationalRegs;
+    XHCI_USB_COMMAND Command;
+
+    DPRINT("XHCI_EnableInterrupts: ... \n");
+
+    Command.AsULONG = READ_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG);
+    Command.InterrupterEnable = 1;
+    WRITE_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG, Command.AsULONG);
+}
+
+VOID
+NTAPI
+XHCI_DisableInterrupts(IN PVOID xhciExtension)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_HW_REGISTERS OperationalRegs = XhciExtension->OperationalRegs;
+    XHCI_USB_COMMAND Command;
+
+    DPRINT("XHCI_DisableInterrupts: ... \n");
+
+    Command.AsULONG = READ_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG);
+    Command.InterrupterEnable = 0;
+    WRITE_REGISTER_ULONG(&OperationalRegs->UsbCommand.AsULONG, Command.AsULONG);
+}
+
+VOID
+NTAPI
+XHCI_PollController(IN PVOID xhciExtension)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_HW_REGISTERS OperationalRegs = XhciExtension->OperationalRegs;
+    XHCI_PORT_STATUS_CONTROL PortSC;
+    ULONG Port;
+
+    DPRINT_XHCI("XHCI_PollController: ... \n");
+
+    if (!(XhciExtension->Flags & XHCI_FLAGS_CONTROLLER_SUSPEND))
+    {
+        RegPacket.UsbPortInvalidateRootHub(XhciExtension);
+        return;
+    }
+
+    for (Port = 0; Port < XhciExtension->NumberOfPorts; Port++)
+    {
+        PortSC.AsULONG = READ_REGISTER_ULONG(&OperationalRegs->PortRegisters[Port].PortStatusControl.AsULONG);
+
+        if (PortSC.ConnectStatusChange)
+        {
+            RegPacket.UsbPortInvalidateRootHub(XhciExtension);
+            break;
+        }
+    }
+}
+
+VOID
+NTAPI
+XHCI_SetEndpointDataToggle(IN PVOID xhciExtension,
+                           IN PVOID xhciEndpoint,
+                           IN ULONG DataToggle)
+{
+    /* The controller keeps the data toggles itself */
+    DPRINT("XHCI_SetEndpointDataToggle: DataToggle - %x\n", DataToggle);
+}
+
+ULONG
+NTAPI
+XHCI_GetEndpointStatus(IN PVOID xhciExtension,
+                       IN PVOID xhciEndpoint)
+{
+    PXHCI_ENDPOINT XhciEndpoint = xhciEndpoint;
+
+    DPRINT("XHCI_GetEndpointStatus: XhciEndpoint - %p\n", XhciEndpoint);
+
+    if (XhciEndpoint->EndpointStatus & USBPORT_ENDPOINT_HALT)
+        return USBPORT_ENDPOINT_HALT;
+
+    return USBPORT_ENDPOINT_RUN;
+}
+
+VOID
+NTAPI
+XHCI_SetEndpointStatus(IN PVOID xhciExtension,
+                       IN PVOID xhciEndpoint,
+                       IN ULONG EndpointStatus)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_ENDPOINT XhciEndpoint = xhciEndpoint;
+
+    DPRINT("XHCI_SetEndpointStatus: XhciEndpoint - %p, EndpointStatus - %x\n",
+           XhciEndpoint,
+           EndpointStatus);
+
+    if (EndpointStatus == USBPORT_ENDPOINT_HALT)
+    {
+        XhciEndpoint->EndpointStatus |= USBPORT_ENDPOINT_HALT;
+        return;
+    }
+
+    if (!(XhciEndpoint->EndpointStatus & USBPORT_ENDPOINT_HALT))
+        return;
+
+    XhciEndpoint->EndpointStatus &= ~USBPORT_ENDPOINT_HALT;
+    XHCI_ResetEndpoint(XhciExtension, XhciEndpoint);
+}
+
+MPSTATUS
+NTAPI
+XHCI_StartSendOnePacket(IN PVOID xhciExtension,
+                        IN PVOID PacketParameters,
+                        IN PVOID Data,
+                        IN PULONG pDataLength,
+                        IN PVOID BufferVA,
+                        IN PVOID BufferPA,
+                        IN ULONG BufferLength,
+                        IN USBD_STATUS * pUSBDStatus)
+{
+    DPRINT1("XHCI_StartSendOnePacket: UNIMPLEMENTED. FIXME\n");
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_EndSendOnePacket(IN PVOID xhciExtension,
+                      IN PVOID PacketParameters,
+                      IN PVOID Data,
+                      IN PULONG pDataLength,
+                      IN PVOID BufferVA,
+                      IN PVOID BufferPA,
+                      IN ULONG BufferLength,
+                      IN USBD_STATUS * pUSBDStatus)
+{
+    DPRINT1("XHCI_EndSendOnePacket: UNIMPLEMENTED. FIXME\n");
+    return MP_STATUS_SUCCESS;
+}
+
+MPSTATUS
+NTAPI
+XHCI_PassThru(IN PVOID xhciExtension,
+              IN PVOID passThruParameters,
+              IN ULONG ParameterLength,
+              IN PVOID pParameters)
+{
+    DPRINT1("XHCI_PassThru: UNIMPLEMENTED. FIXME\n");
+    return MP_STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+XHCI_RebalanceEndpoint(IN PVOID xhciExtension,
+                       IN PUSBPORT_ENDPOINT_PROPERTIES EndpointProperties,
+                       IN PVOID xhciEndpoint)
+{
+    DPRINT1("XHCI_RebalanceEndpoint: UNIMPLEMENTED. FIXME\n");
+}
+
+VOID
+NTAPI
+XHCI_FlushInterrupts(IN PVOID xhciExtension)
+{
+    PXHCI_EXTENSION XhciExtension = xhciExtension;
+    PXHCI_HW_REGISTERS OperationalRegs = XhciExtension->OperationalRegs;
+    XHCI_USB_STATUS Status;
+
+    DPRINT("XHCI_FlushInterrupts: ... \n");
+
+    Status.AsULONG = READ_REGISTER_ULONG(&OperationalRegs->UsbStatus.AsULONG);
+    WRITE_REGISTER_ULONG(&OperationalRegs->UsbStatus.AsULONG,
+                         Status.AsULONG & XHCI_USB_STATUS_RW1C_MASK);
+}
+
+VOID
+NTAPI
+XHCI_TakePortControl(IN PVOID xhciExtension)
+{
+    DPRINT1("XHCI_TakePortControl: UNIMPLEMENTED. FIXME\n");
+}
+
+VOID
+NTAPI
+XHCI_Unload(IN PDRIVER_OBJECT DriverObject)
+{
+#if DBG
+    DPRINT1("XHCI_Unload: Not supported\n");
+#endif
+    return;
+}
+
+NTSTATUS
+NTAPI
+DriverEntry(IN PDRIVER_OBJECT DriverObject,
+            IN PUNICODE_STRING RegistryPath)
+{
+    DPRINT("DriverEntry: DriverObject - %p, RegistryPath - %wZ\n",
+           DriverObject,
+           RegistryPath);
+
+    if (USBPORT_GetHciMn() != USBPORT_HCI_MN)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    RtlZeroMemory(&RegPacket, sizeof(USBPORT_REGISTRATION_PACKET));
+
+    RegPacket.MiniPortVersion = USB_MINIPORT_VERSION_XHCI;
+
+    /* USBPORT has no USB 3 scheduling, the controller does the
+       bandwidth accounting and there are no companion controllers */
+    RegPacket.MiniPortFlags = USB_MINIPORT_FLAGS_INTERRUPT |
+                              USB_MINIPORT_FLAGS_MEMORY_IO |
+                              USB_MINIPORT_FLAGS_POLLING;
+
+    RegPacket.MiniPortBusBandwidth = TOTAL_USB20_BUS_BANDWIDTH;
+
+    RegPacket.MiniPortExtensionSize = sizeof(XHCI_EXTENSION);
+    RegPacket.MiniPortEndpointSize = sizeof(XHCI_ENDPOINT);
+    RegPacket.MiniPortTransferSize = sizeof(XHCI_TRANSFER);
+    RegPacket.MiniPortResourcesSize = sizeof(XHCI_HC_RESOURCES);
+
+    RegPacket.OpenEndpoint = XHCI_OpenEndpoint;
+    RegPacket.ReopenEndpoint = XHCI_ReopenEndpoint;
+    RegPacket.QueryEndpointRequirements = XHCI_QueryEndpointRequirements;
+    RegPacket.CloseEndpoint = XHCI_CloseEndpoint;
+    RegPacket.StartController = XHCI_StartController;
+    RegPacket.StopController = XHCI_StopController;
+    RegPacket.SuspendController = XHCI_SuspendController;
+    RegPacket.ResumeController = XHCI_ResumeController;
+    RegPacket.InterruptService = XHCI_InterruptService;
+    RegPacket.InterruptDpc = XHCI_InterruptDpc;
+    RegPacket.SubmitTransfer = XHCI_SubmitTransfer;
+    RegPacket.SubmitIsoTransfer = XHCI_SubmitIsoTransfer;
+    RegPacket.AbortTransfer = XHCI_AbortTransfer;
+    RegPacket.GetEndpointState = XHCI_GetEndpointState;
+    RegPacket.SetEndpointState = XHCI_SetEndpointState;
+    RegPacket.PollEndpoint = XHCI_PollEndpoint;
+    RegPacket.CheckController = XHCI_CheckController;
+    RegPacket.Get32BitFrameNumber = XHCI_Get32BitFrameNumber;
+    RegPacket.InterruptNextSOF = XHCI_InterruptNextSOF;
+    RegPacket.EnableInterrupts = XHCI_EnableInterrupts;
+    RegPacket.DisableInterrupts = XHCI_DisableInterrupts;
+    RegPacket.PollController = XHCI_PollController;
+    RegPacket.SetEndpointDataToggle = XHCI_SetEndpointDataToggle;
+    RegPacket.GetEndpointStatus = XHCI_GetEndpointStatus;
+    RegPacket.SetEndpointStatus = XHCI_SetEndpointStatus;
+    RegPacket.RH_GetRootHubData = XHCI_RH_GetRootHubData;
+    RegPacket.RH_GetStatus = XHCI_RH_GetStatus;
+    RegPacket.RH_GetPortStatus = XHCI_RH_GetPortStatus;
+    RegPacket.RH_GetHubStatus = XHCI_RH_GetHubStatus;
+    RegPacket.RH_SetFeaturePortReset = XHCI_RH_SetFeaturePortReset;
+    RegPacket.RH_SetFeaturePortPower = XHCI_RH_SetFeaturePortPower;
+    RegPacket.RH_SetFeaturePortEnable = XHCI_RH_SetFeaturePortEnable;
+    RegPacket.RH_SetFeaturePortSuspend = XHCI_RH_SetFeaturePortSuspend;
+    RegPacket.RH_ClearFeaturePortEnable = XHCI_RH_ClearFeaturePortEnable;
+    RegPacket.RH_ClearFeaturePortPower = XHCI_RH_ClearFeaturePortPower;
+    RegPacket.RH_ClearFeaturePortSuspend = XHCI_RH_ClearFeaturePortSuspend;
+    RegPacket.RH_ClearFeaturePortEnableChange = XHCI_RH_ClearFeaturePortEnableChange;
+    RegPacket.RH_ClearFeaturePortConnectChange = XHCI_RH_ClearFeaturePortConnectChange;
+    RegPacket.RH_ClearFeaturePortResetChange = XHCI_RH_ClearFeaturePortResetChange;
+    RegPacket.RH_ClearFeaturePortSuspendChange = XHCI_RH_ClearFeaturePortSuspendChange;
+    RegPacket.RH_ClearFeaturePortOvercurrentChange = XHCI_RH_ClearFeaturePortOvercurrentChange;
+    RegPacket.RH_DisableIrq = XHCI_RH_DisableIrq;
+    RegPacket.RH_EnableIrq = XHCI_RH_EnableIrq;
+    RegPacket.StartSendOnePacket = XHCI_StartSendOnePacket;
+    RegPacket.EndSendOnePacket = XHCI_EndSendOnePacket;
+    RegPacket.PassThru = XHCI_PassThru;
+    RegPacket.RebalanceEndpoint = XHCI_RebalanceEndpoint;
+    RegPacket.FlushInterrupts = XHCI_FlushInterrupts;
+    RegPacket.RH_ChirpRootPort = XHCI_RH_ChirpRootPort;
+    RegPacket.TakePortControl = XHCI_TakePortControl;
+
+    DriverObject->DriverUnload = XHCI_Unload;
+
+    return USBPORT_RegisterUSBPortDriver(DriverObject,
+                                         USB20_MINIPORT_INTERFACE_VERSION,
+                                         &RegPacket);
+}
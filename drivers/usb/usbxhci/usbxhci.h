@@ -0,0 +1,291 @@
+/*
+ * PROJECT:     ReactOS USB xHCI Miniport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     USBXHCI declarations
+ */
+
+#ifndef USBXHCI_H__
+#define USBXHCI_H__
+
+#include <ntddk.h>
+#include <windef.h>
+#include <stdio.h>
+#include <hubbusif.h>
+#include <usbbusif.h>
+#include <usbdlib.h>
+#include <drivers/usbport/usbmport.h>
+#include "hardware.h"
+
+extern USBPORT_REGISTRATION_PACKET RegPacket;
+
+#define XHCI_MAX_CONTROL_TRANSFER_SIZE    0x10000
+#define XHCI_MAX_INTERRUPT_TRANSFER_SIZE  0x1000
+#define XHCI_MAX_BULK_TRANSFER_SIZE       0x100000
+
+/* Ring sizes in TRBs. Every 4K page of a ring is its own segment and
+   ends with a Link TRB, so a ring never crosses a 64K boundary */
+#define XHCI_SEGMENT_TRBS         (0x1000 / sizeof(XHCI_TRB))
+#define XHCI_COMMAND_RING_TRBS    64
+#define XHCI_EVENT_RING_TRBS      XHCI_SEGMENT_TRBS
+#define XHCI_CONTROL_RING_TRBS    64
+#define XHCI_INTERRUPT_RING_TRBS  64
+#define XHCI_BULK_RING_TRBS       (4 * XHCI_SEGMENT_TRBS)
+
+#define XHCI_MAX_SLOTS            32
+#define XHCI_MAX_ENDPOINTS        32 // Device Context Index 1-31
+#define XHCI_CONTEXT_AREA_SIZE    0x800 // 32 contexts of up to 64 bytes
+#define XHCI_TRB_MAX_BUFFER       0x10000 // A TRB buffer may not cross 64K
+
+#define XHCI_COMMAND_TIMEOUT_US   5000
+#define XHCI_ADDRESS_TIMEOUT_US   60000 // SET_ADDRESS may take 50 ms (USB 2.0 9.2.6.3)
+#define XHCI_ABORT_TIMEOUT_US     5000
+#define XHCI_INTERRUPT_MODERATION 160 // 40 us in 250 ns units
+
+typedef struct _XHCI_RING {
+  PXHCI_TRB FirstTrb;
+  ULONG FirstTrbPA;
+  ULONG TrbCount;
+  ULONG Enqueue;
+  ULONG CycleState;
+} XHCI_RING, *PXHCI_RING;
+
+typedef struct _XHCI_INTERRUPTER {
+  PXHCI_INTERRUPTER_REGISTERS Registers;
+  PXHCI_TRB EventRing;
+  ULONG EventRingPA;
+  ULONG Dequeue;
+  ULONG CycleState;
+} XHCI_INTERRUPTER, *PXHCI_INTERRUPTER;
+
+struct _XHCI_ENDPOINT;
+
+/* Device slot, keyed by the address USBPORT gave the device */
+#define XHCI_SLOT_FLAG_ENABLED    0x01
+#define XHCI_SLOT_FLAG_ADDRESSED  0x02
+
+typedef struct _XHCI_SLOT {
+  ULONG Flags;
+  UCHAR RootPort;
+  UCHAR Speed;
+  UCHAR DeviceAddress;
+  UCHAR ContextEntries;
+  struct _XHCI_ENDPOINT * Endpoints[XHCI_MAX_ENDPOINTS];
+} XHCI_SLOT, *PXHCI_SLOT;
+
+/* xHCI Endpoint follows USBPORT Endpoint */
+typedef struct _XHCI_ENDPOINT {
+  ULONG Reserved;
+  ULONG EndpointStatus;
+  ULONG EndpointState;
+  USBPORT_ENDPOINT_PROPERTIES EndpointProperties;
+  ULONG SlotId;
+  ULONG Dci;
+  XHCI_RING TransferRing;
+  LIST_ENTRY TransferList;
+} XHCI_ENDPOINT, *PXHCI_ENDPOINT;
+
+/* xHCI Transfer follows USBPORT Transfer */
+typedef struct _XHCI_TRANSFER {
+  ULONG Reserved;
+  PUSBPORT_TRANSFER_PARAMETERS TransferParameters;
+  PXHCI_ENDPOINT XhciEndpoint;
+  LIST_ENTRY TransferLink;
+  ULONG FirstTrb;
+  ULONG FirstCycle;
+  ULONG NextTrb;
+  ULONG NextCycle;
+  ULONG TrbCount;
+  ULONG TransferLen;
+  ULONG CompletionCode;
+  BOOLEAN IsShort;
+  BOOLEAN IsDone;
+} XHCI_TRANSFER, *PXHCI_TRANSFER;
+
+typedef struct _XHCI_HC_RESOURCES {
+  ULONG DeviceContextBaseArray[2 * (XHCI_MAX_SLOTS + 1)]; // 64-byte aligned
+  UCHAR Padded1[0x200 - 8 * (XHCI_MAX_SLOTS + 1)];
+  XHCI_EVENT_RING_SEGMENT EventRingSegmentTable[1];
+  UCHAR Padded2[0x200 - sizeof(XHCI_EVENT_RING_SEGMENT)];
+  XHCI_TRB CommandRing[XHCI_COMMAND_RING_TRBS];
+  UCHAR Padded3[0x1000 - 0x400 - XHCI_COMMAND_RING_TRBS * sizeof(XHCI_TRB)];
+  UCHAR InputContext[0x1000]; // Input Control Context + XHCI_CONTEXT_AREA_SIZE
+  XHCI_TRB EventRing[XHCI_EVENT_RING_TRBS];
+  UCHAR DeviceContext[XHCI_MAX_SLOTS][XHCI_CONTEXT_AREA_SIZE];
+} XHCI_HC_RESOURCES, *PXHCI_HC_RESOURCES;
+
+C_ASSERT(FIELD_OFFSET(XHCI_HC_RESOURCES, CommandRing) == 0x400);
+C_ASSERT(FIELD_OFFSET(XHCI_HC_RESOURCES, InputContext) == 0x1000);
+C_ASSERT(FIELD_OFFSET(XHCI_HC_RESOURCES, EventRing) == 0x2000);
+C_ASSERT(FIELD_OFFSET(XHCI_HC_RESOURCES, DeviceContext) == 0x3000);
+
+#define XHCI_FLAGS_CONTROLLER_SUSPEND  0x01
+#define XHCI_FLAGS_ROOT_HUB_IRQ_OFF    0x02
+
+/* xHCI Extension follows USBPORT Extension */
+typedef struct _XHCI_EXTENSION {
+  ULONG Reserved;
+  ULONG Flags;
+  PXHCI_HC_CAPABILITY_REGISTERS CapabilityRegisters;
+  PXHCI_HW_REGISTERS OperationalRegs;
+  PXHCI_RUNTIME_REGISTERS RuntimeRegs;
+  PULONG DoorbellArray;
+  BOOLEAN IsStarted;
+  BOOLEAN PortPowerControl;
+  USHORT NumberOfPorts;
+  ULONG MaxSlots;
+  ULONG ContextSize;
+  ULONG Usb3PortBits;
+  /* Resources */
+  PXHCI_HC_RESOURCES HcResourcesVA;
+  ULONG HcResourcesPA;
+  PULONG ScratchpadArray;
+  ULONG ScratchpadCount;
+  /* Commands */
+  XHCI_RING CommandRing;
+  ULONG CommandTrbPA;
+  ULONG CommandCompletionCode;
+  ULONG CommandSlotId;
+  BOOLEAN IsCommandDone;
+  PXHCI_TRANSFER AddressTransfer; // SET_ADDRESS sent by Address Device
+  ULONGLONG AddressTime;
+  /* Events */
+  KSPIN_LOCK EventLock;
+  XHCI_INTERRUPTER Interrupter;
+  BOOLEAN IsTransferEvent;
+  BOOLEAN IsPortEvent;
+  /* Devices */
+  XHCI_SLOT Slots[XHCI_MAX_SLOTS + 1];
+  /* Root Hub Bits */
+  ULONG ResetPortBits;
+  ULONG SuspendPortBits;
+  /* Frame number */
+  ULONG FrameIndex;
+  ULONG FrameHighPart;
+} XHCI_EXTENSION, *PXHCI_EXTENSION;
+
+/* debug.c */
+VOID
+NTAPI
+XHCI_DumpTrb(
+  IN PXHCI_TRB Trb);
+
+VOID
+NTAPI
+XHCI_DumpRing(
+  IN PXHCI_RING Ring);
+
+/* roothub.c */
+MPSTATUS
+NTAPI
+XHCI_RH_ChirpRootPort(
+  IN PVOID xhciExtension,
+  IN USHORT Port);
+
+VOID
+NTAPI
+XHCI_RH_GetRootHubData(
+  IN PVOID xhciExtension,
+  IN PVOID rootHubData);
+
+MPSTATUS
+NTAPI
+XHCI_RH_GetStatus(
+  IN PVOID xhciExtension,
+  IN PUSHORT Status);
+
+MPSTATUS
+NTAPI
+XHCI_RH_GetPortStatus(
+  IN PVOID xhciExtension,
+  IN USHORT Port,
+  IN PUSB_PORT_STATUS_AND_CHANGE PortStatus);
+
+MPSTATUS
+NTAPI
+XHCI_RH_GetHubStatus(
+  IN PVOID xhciExtension,
+  IN PUSB_HUB_STATUS_AND_CHANGE HubStatus);
+
+MPSTATUS
+NTAPI
+XHCI_RH_SetFeaturePortReset(
+  IN PVOID xhciExtension,
+  IN USHORT Port);
+
+MPSTATUS
+NTAPI
+XHCI_RH_SetFeaturePortPower(
+  IN PVOID xhciExtension,
+  IN USHORT Port);
+
+MPSTATUS
+NTAPI
+XHCI_RH_SetFeaturePortEnable(
+  IN PVOID xhciExtension,
+  IN USHORT Port);
+
+MPSTATUS
+NTAPI
+XHCI_RH_SetFeaturePortSuspend(
+  IN PVOID xhciExtension,
+  IN USHORT Port);
+
+MPSTATUS
+NTAPI
+XHCI_RH_ClearFeaturePortEnable(
+  IN PVOID xhciExtension,
+  IN USHORT Port);
+
+MPSTATUS
+NTAPI
+XHCI_RH_ClearFeaturePortPower(
+  IN PVOID xhciExtension,
+  IN USHORT Port);
+
+MPSTATUS
+NTAPI
+XHCI_RH_ClearFeaturePortSuspend(
+  IN PVOID xhciExtension,
+  IN USHORT Port);
+
+MPSTATUS
+NTAPI
+XHCI_RH_ClearFeaturePortEnableChange(
+  IN PVOID xhciExtension,
+  IN USHORT Port);
+
+MPSTATUS
+NTAPI
+XHCI_RH_ClearFeaturePortConnectChange(
+  IN PVOID xhciExtension,
+  IN USHORT Port);
+
+MPSTATUS
+NTAPI
+XHCI_RH_ClearFeaturePortResetChange(
+  IN PVOID xhciExtension,
+  IN USHORT Port);
+
+MPSTATUS
+NTAPI
+XHCI_RH_ClearFeaturePortSuspendChange(
+  IN PVOID xhciExtension,
+  IN USHORT Port);
+
+MPSTATUS
+NTAPI
+XHCI_RH_ClearFeaturePortOvercurrentChange(
+  IN PVOID xhciExtension,
+  IN USHORT Port);
+
+VOID
+NTAPI
+XHCI_RH_DisableIrq(
+  IN PVOID xhciExtension);
+
+VOID
+NTAPI
+XHCI_RH_EnableIrq(
+  IN PVOID xhciExtension);
+
+#endif /* USBXHCI_H__ */
@@ -5,15 +5,21 @@
 
 #include <windows.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <setupapi.h>
 #include <ndk/umtypes.h>
 #include <ks.h>
 #include <ksmedia.h>
 #include "interface.h"
+#include "pipeline.h"
 
 #define _2pi                6.283185307179586476925286766559
 
+/* Number of 10ms buffers each pipeline benchmark pushes through */
+#define BENCH_BUFFERS       1000
+#define BENCH_MIX_STREAMS   8
+
 GUID CategoryGuid = {STATIC_KSCATEGORY_AUDIO};
 
 const GUID KSPROPSETID_Pin                     = {0x8C134960L, 0x51AD, 0x11CF, {0x87, 0x8A, 0x94, 0xF8, 0x01, 0xC1, 0x00, 0x00}};
@@ -238,6 +244,172 @@ TestKs()
     CloseHandle(FilterHandle);
 }
 
+typedef struct
+{
+    ULONG InChannels;
+    ULONG InBitsPerSample;
+    ULONG InSamplesPerSec;
+    ULONG OutChannels;
+    ULONG OutBitsPerSample;
+    ULONG OutSamplesPerSec;
+}PIPELINE_CONVERSION;
+
+static const PIPELINE_CONVERSION Conversions[] =
+{
+    {2, 16, 44100, 2, 16, 48000},
+    {2, 16, 48000, 2, 32, 48000},
+    {1, 16, 48000, 2, 16, 48000},
+    {2, 32, 48000, 1, 16, 48000},
+    {1,  8, 22050, 2, 16, 48000},
+};
+
+VOID
+InitWaveFormat(
+    PWAVEFORMATEX Format,
+    ULONG Channels,
+    ULONG BitsPerSample,
+    ULONG SamplesPerSec)
+{
+    ZeroMemory(Format, sizeof(WAVEFORMATEX));
+    Format->wFormatTag = WAVE_FORMAT_PCM;
+    Format->nChannels = Channels;
+    Format->wBitsPerSample = BitsPerSample;
+    Format->nSamplesPerSec = SamplesPerSec;
+    Format->nBlockAlign = Channels * BitsPerSample / 8;
+    Format->nAvgBytesPerSec = SamplesPerSec * Format->nBlockAlign;
+}
+
+double
+GetMicroseconds(
+    PLARGE_INTEGER Start,
+    PLARGE_INTEGER Frequency)
+{
+    LARGE_INTEGER End;
+
+    QueryPerformanceCounter(&End);
+    return (double)(End.QuadPart - Start->QuadPart) * 1000000.0 / Frequency->QuadPart;
+}
+
+//
+// Time 10ms buffers through the kmixer conversion pipeline, either with a
+// pipeline kept across buffers or one built per buffer like kmixer used to
+//
+double
+BenchmarkConversion(
+    const PIPELINE_CONVERSION *Conversion,
+    BOOLEAN UseSse2,
+    BOOLEAN Persistent)
+{
+    KMIXER_PIPELINE Pipeline;
+    WAVEFORMATEX InputFormat, OutputFormat;
+    LARGE_INTEGER Frequency, Start;
+    ULONG Index, InputLength, Frames;
+    PUCHAR Input, Output;
+    PFLOAT Samples;
+    double Elapsed;
+
+    InitWaveFormat(&InputFormat, Conversion->InChannels, Conversion->InBitsPerSample, Conversion->InSamplesPerSec);
+    InitWaveFormat(&OutputFormat, Conversion->OutChannels, Conversion->OutBitsPerSample, Conversion->OutSamplesPerSec);
+
+    InputLength = InputFormat.nSamplesPerSec / 100 * InputFormat.nBlockAlign;
+    Input = HeapAlloc(GetProcessHeap(), 0, InputLength);
+    Output = HeapAlloc(GetProcessHeap(), 0, OutputFormat.nSamplesPerSec / 50 * OutputFormat.nBlockAlign);
+
+    for (Index = 0; Index < InputLength; Index++)
+        Input[Index] = (UCHAR)(0x80 + 0x7F * sin(Index * 500 * _2pi / 48000));
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    if (Persistent)
+        KMixInitializePipeline(&Pipeline, &InputFormat, &OutputFormat, InputFormat.nSamplesPerSec / 10, UseSse2);
+
+    for (Index = 0; Index < BENCH_BUFFERS; Index++)
+    {
+        if (!Persistent)
+            KMixInitializePipeline(&Pipeline, &InputFormat, &OutputFormat, InputFormat.nSamplesPerSec / 100, UseSse2);
+
+        Samples = KMixProcessToFloat(&Pipeline, Input, InputLength, &Frames);
+        if (Samples)
+            KMixFloatToPcm(Samples, Output, OutputFormat.wBitsPerSample, Frames * OutputFormat.nChannels, UseSse2);
+
+        if (!Persistent)
+            KMixDestroyPipeline(&Pipeline);
+    }
+
+    if (Persistent)
+        KMixDestroyPipeline(&Pipeline);
+
+    Elapsed = GetMicroseconds(&Start, &Frequency) / BENCH_BUFFERS;
+
+    HeapFree(GetProcessHeap(), 0, Input);
+    HeapFree(GetProcessHeap(), 0, Output);
+    return Elapsed;
+}
+
+double
+BenchmarkMix(
+    BOOLEAN UseSse2)
+{
+    LARGE_INTEGER Frequency, Start;
+    ULONG Index, Stream, Samples;
+    PFLOAT Mix, Input;
+
+    /* 10ms of 48kHz stereo */
+    Samples = 480 * 2;
+    Mix = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, Samples * sizeof(FLOAT));
+    Input = HeapAlloc(GetProcessHeap(), 0, Samples * sizeof(FLOAT));
+
+    for (Index = 0; Index < Samples; Index++)
+        Input[Index] = (FLOAT)(sin(Index * 500 * _2pi / 48000) / BENCH_MIX_STREAMS);
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    for (Index = 0; Index < BENCH_BUFFERS; Index++)
+    {
+        for (Stream = 0; Stream < BENCH_MIX_STREAMS; Stream++)
+            KMixAccumulate(Mix, Input, Samples, UseSse2);
+        ZeroMemory(Mix, Samples * sizeof(FLOAT));
+    }
+
+    HeapFree(GetProcessHeap(), 0, Mix);
+    HeapFree(GetProcessHeap(), 0, Input);
+    return GetMicroseconds(&Start, &Frequency) / BENCH_BUFFERS;
+}
+
+VOID
+TestPipeline()
+{
+    const PIPELINE_CONVERSION *Conversion;
+    BOOLEAN HaveSse2;
+    double Scalar, Sse2, PerBuffer;
+    ULONG Index;
+
+    HaveSse2 = IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+
+    printf("Microseconds per 10ms buffer (%% of real time), %u buffers\n", BENCH_BUFFERS);
+
+    for (Index = 0; Index < sizeof(Conversions) / sizeof(Conversions[0]); Index++)
+    {
+        Conversion = &Conversions[Index];
+
+        PerBuffer = BenchmarkConversion(Conversion, FALSE, FALSE);
+        Scalar = BenchmarkConversion(Conversion, FALSE, TRUE);
+        Sse2 = HaveSse2 ? BenchmarkConversion(Conversion, TRUE, TRUE) : Scalar;
+
+        printf("%lu/%2lu/%5lu -> %lu/%2lu/%5lu: per-buffer setup %8.1f (%5.2f%%) persistent %8.1f (%5.2f%%) sse2 %8.1f (%5.2f%%)\n",
+               Conversion->InChannels, Conversion->InBitsPerSample, Conversion->InSamplesPerSec,
+               Conversion->OutChannels, Conversion->OutBitsPerSample, Conversion->OutSamplesPerSec,
+               PerBuffer, PerBuffer / 100.0, Scalar, Scalar / 100.0, Sse2, Sse2 / 100.0);
+    }
+
+    Scalar = BenchmarkMix(FALSE);
+    Sse2 = HaveSse2 ? BenchmarkMix(TRUE) : Scalar;
+    printf("mix %u streams 2/48000: %8.1f (%5.2f%%) sse2 %8.1f (%5.2f%%)\n",
+           BENCH_MIX_STREAMS, Scalar, Scalar / 100.0, Sse2, Sse2 / 100.0);
+}
+
 int
 __cdecl
 main(int argc, char* argv[])
@@ -251,6 +423,12 @@ main(int argc, char* argv[])
     HANDLE hWdmAud;
     WDMAUD_DEVICE_INFO DeviceInfo;
 
+    if (argc > 1 && !strcmp(argv[1], "bench"))
+    {
+        TestPipeline();
+        return 0;
+    }
+
     TestKs();
     return 0;
 
@@ -34,7 +34,19 @@ Dispatch_fnClose(
     PDEVICE_OBJECT DeviceObject,
     PIRP Irp)
 {
-    UNIMPLEMENTED;
+    PIO_STACK_LOCATION IoStack;
+    PKMIXER_FILTER_CONTEXT FilterContext;
+
+    IoStack = IoGetCurrentIrpStackLocation(Irp);
+    FilterContext = (PKMIXER_FILTER_CONTEXT)IoStack->FileObject->FsContext;
+
+    /* each pin holds a reference on the filter file object, so they are all closed by now */
+    if (FilterContext)
+    {
+        ASSERT(IsListEmpty(&FilterContext->SumNodeList));
+        ExFreePoolWithTag(FilterContext, TAG_KMIXER);
+        IoStack->FileObject->FsContext = NULL;
+    }
 
     Irp->IoStatus.Status = STATUS_SUCCESS;
     Irp->IoStatus.Information = 0;
@@ -106,6 +118,8 @@ DispatchCreateKMix(
     KSOBJECT_HEADER ObjectHeader;
     PKSOBJECT_CREATE_ITEM CreateItem;
     PKMIXER_DEVICE_EXT DeviceExtension;
+    PKMIXER_FILTER_CONTEXT FilterContext;
+    PIO_STACK_LOCATION IoStack;
 
     DPRINT("DispatchCreateKMix entered\n");
 
@@ -156,6 +170,25 @@ DispatchCreateKMix(
     CreateItem[1].Create = DispatchCreateKMixAllocator;
     RtlInitUnicodeString(&CreateItem[1].ObjectClass, KSSTRING_Allocator);
 
+    /* allocate filter context, shared by the pins of the filter */
+    FilterContext = ExAllocatePoolWithTag(NonPagedPool, sizeof(KMIXER_FILTER_CONTEXT), TAG_KMIXER);
+    if (!FilterContext)
+    {
+        /* not enough memory */
+        ExFreePool(CreateItem);
+        Irp->IoStatus.Information = 0;
+        Irp->IoStatus.Status = STATUS_INSUFFICIENT_RESOURCES;
+        IoCompleteRequest(Irp, IO_NO_INCREMENT);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    KeInitializeSpinLock(&FilterContext->Lock);
+    InitializeListHead(&FilterContext->SumNodeList);
+
+    /* the object header takes FsContext2 */
+    IoStack = IoGetCurrentIrpStackLocation(Irp);
+    IoStack->FileObject->FsContext = (PVOID)FilterContext;
+
     /* allocate object header */
     Status = KsAllocateObjectHeader(&ObjectHeader, 2, CreateItem, Irp, &DispatchTable);
 
@@ -163,6 +196,8 @@ DispatchCreateKMix(
     {
         /* failed to allocate object header */
         ExFreePool(CreateItem);
+        ExFreePoolWithTag(FilterContext, TAG_KMIXER);
+        IoStack->FileObject->FsContext = NULL;
         KsDereferenceSoftwareBusObject(DeviceExtension->KsDeviceHeader);
     }
 
@@ -11,6 +11,8 @@
 // #define NDEBUG
 #include <debug.h>
 
+BOOLEAN KMixUseSse2 = FALSE;
+
 NTSTATUS
 NTAPI
 KMix_Pnp(
@@ -105,6 +107,13 @@ DriverEntry(
 {
     DPRINT1("KMixer.sys loaded\n");
 
+    /* The conversion and mixing kernels use SSE2 when the processor has it */
+#if defined(_M_AMD64)
+    KMixUseSse2 = TRUE;
+#elif defined(_M_IX86)
+    KMixUseSse2 = ExIsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+#endif
+
     KsSetMajorFunctionHandler(DriverObject, IRP_MJ_CREATE);
     KsSetMajorFunctionHandler(DriverObject, IRP_MJ_CLOSE);
     KsSetMajorFunctionHandler(DriverObject, IRP_MJ_WRITE);
@@ -4,6 +4,17 @@
 #include <portcls.h>
 #include <float_cast.h>
 
+#include "pipeline.h"
+
+#define TAG_KMIXER 'xiMK'
+
+/* Sink pins take a stream, source pins return the mix of the sinks */
+#define KMIXER_PIN_SINK     0
+#define KMIXER_PIN_SOURCE   1
+
+/* Buffer the mix bus keeps, in milliseconds */
+#define KMIXER_MIX_BUFFER_MS    500
+
 typedef struct
 {
     KSDEVICE_HEADER KsDeviceHeader;
@@ -14,10 +25,48 @@ typedef struct
 typedef struct
 {
     KSPIN_LOCK Lock;
+    /* Mix buses of the filter, one per output format that has a source pin */
+    LIST_ENTRY SumNodeList;
+}KMIXER_FILTER_CONTEXT, *PKMIXER_FILTER_CONTEXT;
 
+typedef struct
+{
+    LIST_ENTRY Entry;
+    WAVEFORMATEX Format;
+    /* Sink pins mixing into this bus */
+    LIST_ENTRY SinkList;
+    BOOLEAN HasSource;
 
+    /* Ring of float frames, ReadPosition is the next frame the source gets */
+    PFLOAT Buffer;
+    ULONG BufferFrames;
+    ULONG ReadPosition;
+    /* Frames written by the furthest sink, not read yet */
+    ULONG FilledFrames;
 }SUM_NODE_CONTEXT, *PSUM_NODE_CONTEXT;
 
+typedef struct
+{
+    /* Input and output format, set through KSPROPERTY_CONNECTION_DATAFORMAT */
+    KSDATAFORMAT_WAVEFORMATEX Formats[2];
+    ULONG PinId;
+    PKMIXER_FILTER_CONTEXT Filter;
+    /* Referenced, so the filter context outlives the pin */
+    PFILE_OBJECT FilterObject;
+
+    /* Built when the formats are set, kept for the lifetime of the pin */
+    KMIXER_PIPELINE Pipeline;
+    BOOLEAN PipelineReady;
+
+    /* Mix bus a sink writes into, or a source reads from */
+    PSUM_NODE_CONTEXT SumNode;
+    LIST_ENTRY SinkEntry;
+    /* Frames this sink has written past the bus read position */
+    ULONG MixFrames;
+}KMIXER_PIN_CONTEXT, *PKMIXER_PIN_CONTEXT;
+
+extern BOOLEAN KMixUseSse2;
+
 
 NTSTATUS
 NTAPI
@@ -8,416 +8,261 @@
 
 #include "kmixer.h"
 
-#include <samplerate.h>
-
 #define NDEBUG
 #include <debug.h>
 
 const GUID KSPROPSETID_Connection              = {0x1D58C920L, 0xAC9B, 0x11CF, {0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00}};
 
-NTSTATUS
-PerformSampleRateConversion(
-    PUCHAR Buffer,
-    ULONG BufferLength,
-    ULONG OldRate,
-    ULONG NewRate,
-    ULONG BytesPerSample,
-    ULONG NumChannels,
-    PVOID * Result,
-    PULONG ResultLength)
+static
+BOOLEAN
+KMixIsSameFormat(
+    IN const WAVEFORMATEX *Format1,
+    IN const WAVEFORMATEX *Format2)
+{
+    return (Format1->nChannels == Format2->nChannels &&
+            Format1->wBitsPerSample == Format2->wBitsPerSample &&
+            Format1->nSamplesPerSec == Format2->nSamplesPerSec);
+}
+
+static
+VOID
+KMixSetupPipeline(
+    IN PKMIXER_PIN_CONTEXT Context)
 {
     KFLOATING_SAVE FloatSave;
+    PWAVEFORMATEX InputFormat, OutputFormat;
     NTSTATUS Status;
-    ULONG Index;
-    SRC_STATE * State;
-    SRC_DATA Data;
-    PUCHAR ResultOut;
-    int error;
-    PFLOAT FloatIn, FloatOut;
-    ULONG NumSamples;
-    ULONG NewSamples;
 
-    DPRINT("PerformSampleRateConversion OldRate %u NewRate %u BytesPerSample %u NumChannels %u Irql %u\n", OldRate, NewRate, BytesPerSample, NumChannels, KeGetCurrentIrql());
+    if (Context->PipelineReady)
+    {
+        KMixDestroyPipeline(&Context->Pipeline);
+        Context->PipelineReady = FALSE;
+    }
+
+    InputFormat = &Context->Formats[0].WaveFormatEx;
+    OutputFormat = &Context->Formats[1].WaveFormatEx;
 
-    ASSERT(BytesPerSample == 1 || BytesPerSample == 2 || BytesPerSample == 4);
+    /* wait until both formats are known */
+    if (!InputFormat->nSamplesPerSec || !OutputFormat->nSamplesPerSec)
+        return;
 
-    /* first acquire float save context */
     Status = KeSaveFloatingPointState(&FloatSave);
-
     if (!NT_SUCCESS(Status))
     {
         DPRINT1("KeSaveFloatingPointState failed with %x\n", Status);
-        return Status;
+        return;
     }
 
-    NumSamples = BufferLength / (BytesPerSample * NumChannels);
+    /* size the work buffers for 100ms of input, they grow if larger buffers come in */
+    Context->PipelineReady = KMixInitializePipeline(&Context->Pipeline,
+                                                    InputFormat,
+                                                    OutputFormat,
+                                                    InputFormat->nSamplesPerSec / 10,
+                                                    KMixUseSse2);
+    KeRestoreFloatingPointState(&FloatSave);
 
-    FloatIn = ExAllocatePool(NonPagedPool, NumSamples * NumChannels * sizeof(FLOAT));
-    if (!FloatIn)
+    if (!Context->PipelineReady)
     {
-        KeRestoreFloatingPointState(&FloatSave);
-        return STATUS_INSUFFICIENT_RESOURCES;
+        DPRINT1("Unsupported conversion Channels %u -> %u Bits %u -> %u Rate %u -> %u\n",
+                InputFormat->nChannels, OutputFormat->nChannels,
+                InputFormat->wBitsPerSample, OutputFormat->wBitsPerSample,
+                InputFormat->nSamplesPerSec, OutputFormat->nSamplesPerSec);
     }
+}
 
-    NewSamples = ((((ULONG64)NumSamples * NewRate) + (OldRate / 2)) / OldRate) + 2;
+static
+NTSTATUS
+KMixAttachSource(
+    IN PKMIXER_PIN_CONTEXT Context)
+{
+    PSUM_NODE_CONTEXT SumNode;
+    PWAVEFORMATEX Format;
+    KIRQL OldIrql;
 
-    FloatOut = ExAllocatePool(NonPagedPool, NewSamples * NumChannels * sizeof(FLOAT));
-    if (!FloatOut)
-    {
-        ExFreePool(FloatIn);
-        KeRestoreFloatingPointState(&FloatSave);
+    Format = &Context->Formats[1].WaveFormatEx;
+
+    /* the mix bus format cannot change once sinks mix into it */
+    if (Context->SumNode || !Format->nSamplesPerSec || !Format->nChannels || !Format->wBitsPerSample)
+        return STATUS_SUCCESS;
+
+    SumNode = ExAllocatePoolWithTag(NonPagedPool, sizeof(SUM_NODE_CONTEXT), TAG_KMIXER);
+    if (!SumNode)
         return STATUS_INSUFFICIENT_RESOURCES;
-    }
 
-    ResultOut = ExAllocatePool(NonPagedPool, NewSamples * NumChannels * BytesPerSample);
-    if (!ResultOut)
+    RtlZeroMemory(SumNode, sizeof(SUM_NODE_CONTEXT));
+    SumNode->BufferFrames = Format->nSamplesPerSec * KMIXER_MIX_BUFFER_MS / 1000;
+    SumNode->Buffer = ExAllocatePoolWithTag(NonPagedPool,
+                                            SumNode->BufferFrames * Format->nChannels * sizeof(FLOAT),
+                                            TAG_KMIXER);
+    if (!SumNode->Buffer)
     {
-        ExFreePool(FloatIn);
-        ExFreePool(FloatOut);
-        KeRestoreFloatingPointState(&FloatSave);
+        ExFreePoolWithTag(SumNode, TAG_KMIXER);
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
-    State = src_new(SRC_SINC_FASTEST, NumChannels, &error);
-    if (!State)
-    {
-        DPRINT1("src_new failed with %x\n", error);
-        KeRestoreFloatingPointState(&FloatSave);
-        ExFreePool(FloatIn);
-        ExFreePool(FloatOut);
-        ExFreePool(ResultOut);
-        return STATUS_UNSUCCESSFUL;
-    }
+    /* all bits zero is silence */
+    RtlZeroMemory(SumNode->Buffer, SumNode->BufferFrames * Format->nChannels * sizeof(FLOAT));
+    RtlCopyMemory(&SumNode->Format, Format, sizeof(WAVEFORMATEX));
+    InitializeListHead(&SumNode->SinkList);
+    SumNode->HasSource = TRUE;
 
-    /* fixme use asm */
-    if (BytesPerSample == 1)
-    {
-        for(Index = 0; Index < NumSamples * NumChannels; Index++)
-            FloatIn[Index] = (float)(Buffer[Index] / (1.0 * 0x80));
-    }
-    else if (BytesPerSample == 2)
-    {
-        src_short_to_float_array((short*)Buffer, FloatIn, NumSamples * NumChannels);
-    }
-    else if (BytesPerSample == 4)
-    {
-        src_int_to_float_array((int*)Buffer, FloatIn, NumSamples * NumChannels);
-    }
+    KeAcquireSpinLock(&Context->Filter->Lock, &OldIrql);
+    InsertTailList(&Context->Filter->SumNodeList, &SumNode->Entry);
+    KeReleaseSpinLock(&Context->Filter->Lock, OldIrql);
 
-    Data.data_in = FloatIn;
-    Data.data_out = FloatOut;
-    Data.input_frames = NumSamples;
-    Data.output_frames = NewSamples;
-    Data.src_ratio = (double)NewRate / (double)OldRate;
+    Context->SumNode = SumNode;
+    return STATUS_SUCCESS;
+}
 
-    error = src_process(State, &Data);
-    if (error)
-    {
-        DPRINT1("src_process failed with %x\n", error);
-        KeRestoreFloatingPointState(&FloatSave);
-        ExFreePool(FloatIn);
-        ExFreePool(FloatOut);
-        ExFreePool(ResultOut);
-        return STATUS_UNSUCCESSFUL;
-    }
+static
+VOID
+KMixDetachSource(
+    IN PKMIXER_PIN_CONTEXT Context)
+{
+    PSUM_NODE_CONTEXT SumNode = Context->SumNode;
+    PKMIXER_PIN_CONTEXT Sink;
+    KIRQL OldIrql;
 
-    if (BytesPerSample == 1)
-    {
-        /* FIXME perform over/under clipping */
+    KeAcquireSpinLock(&Context->Filter->Lock, &OldIrql);
 
-        for(Index = 0; Index < Data.output_frames_gen * NumChannels; Index++)
-            ResultOut[Index] = (lrintf(FloatOut[Index]) >> 24);
-    }
-    else if (BytesPerSample == 2)
+    /* remaining sinks fall back to converting in place */
+    SumNode->HasSource = FALSE;
+    while (!IsListEmpty(&SumNode->SinkList))
     {
-        PUSHORT Res = (PUSHORT)ResultOut;
-
-        src_float_to_short_array(FloatOut, (short*)Res, Data.output_frames_gen * NumChannels);
-    }
-    else if (BytesPerSample == 4)
-    {
-        PULONG Res = (PULONG)ResultOut;
-
-        src_float_to_int_array(FloatOut, (int*)Res, Data.output_frames_gen * NumChannels);
+        Sink = CONTAINING_RECORD(RemoveHeadList(&SumNode->SinkList), KMIXER_PIN_CONTEXT, SinkEntry);
+        Sink->SumNode = NULL;
     }
+    RemoveEntryList(&SumNode->Entry);
 
+    KeReleaseSpinLock(&Context->Filter->Lock, OldIrql);
 
-    *Result = ResultOut;
-    *ResultLength = Data.output_frames_gen * BytesPerSample * NumChannels;
-    ExFreePool(FloatIn);
-    ExFreePool(FloatOut);
-    src_delete(State);
-    KeRestoreFloatingPointState(&FloatSave);
-    return STATUS_SUCCESS;
+    Context->SumNode = NULL;
+    ExFreePoolWithTag(SumNode->Buffer, TAG_KMIXER);
+    ExFreePoolWithTag(SumNode, TAG_KMIXER);
 }
 
-NTSTATUS
-PerformChannelConversion(
-    PUCHAR Buffer,
-    ULONG BufferLength,
-    ULONG OldChannels,
-    ULONG NewChannels,
-    ULONG BitsPerSample,
-    PVOID * Result,
-    PULONG ResultLength)
+static
+VOID
+KMixJoinSumNode(
+    IN PKMIXER_PIN_CONTEXT Context)
 {
-    ULONG Samples;
-    ULONG NewIndex, OldIndex;
+    PLIST_ENTRY Entry;
+    PSUM_NODE_CONTEXT SumNode;
+    KIRQL OldIrql;
 
-    Samples = BufferLength / (BitsPerSample / 8) / OldChannels;
+    KeAcquireSpinLock(&Context->Filter->Lock, &OldIrql);
 
-    if (NewChannels > OldChannels)
+    for (Entry = Context->Filter->SumNodeList.Flink; Entry != &Context->Filter->SumNodeList; Entry = Entry->Flink)
     {
-        if (BitsPerSample == 8)
+        SumNode = CONTAINING_RECORD(Entry, SUM_NODE_CONTEXT, Entry);
+        if (SumNode->HasSource && KMixIsSameFormat(&SumNode->Format, &Context->Formats[1].WaveFormatEx))
         {
-            PUCHAR BufferOut = ExAllocatePool(NonPagedPool, Samples * NewChannels);
-            if (!BufferOut)
-                return STATUS_INSUFFICIENT_RESOURCES;
-
-            for(NewIndex = 0, OldIndex = 0; OldIndex < Samples * OldChannels; NewIndex += NewChannels, OldIndex += OldChannels)
-            {
-                ULONG SubIndex = 0;
-
-                RtlMoveMemory(&BufferOut[NewIndex], &Buffer[OldIndex], OldChannels * sizeof(UCHAR));
-
-                do
-                {
-                    /* 2 channel stretched to 4 looks like LRLR */
-                     BufferOut[NewIndex+OldChannels + SubIndex] = Buffer[OldIndex + (SubIndex % OldChannels)];
-                }while(SubIndex++ < NewChannels - OldChannels);
-            }
-            *Result = BufferOut;
-            *ResultLength = Samples * NewChannels;
+            InsertTailList(&SumNode->SinkList, &Context->SinkEntry);
+            Context->SumNode = SumNode;
+            Context->MixFrames = 0;
+            break;
         }
-        else if (BitsPerSample == 16)
-        {
-            PUSHORT BufferOut = ExAllocatePool(NonPagedPool, Samples * NewChannels);
-            if (!BufferOut)
-                return STATUS_INSUFFICIENT_RESOURCES;
-
-            for(NewIndex = 0, OldIndex = 0; OldIndex < Samples * OldChannels; NewIndex += NewChannels, OldIndex += OldChannels)
-            {
-                ULONG SubIndex = 0;
+    }
 
-                RtlMoveMemory(&BufferOut[NewIndex], &Buffer[OldIndex], OldChannels * sizeof(USHORT));
+    KeReleaseSpinLock(&Context->Filter->Lock, OldIrql);
+}
 
-                do
-                {
-                     BufferOut[NewIndex+OldChannels + SubIndex] = Buffer[OldIndex + (SubIndex % OldChannels)];
-                }while(SubIndex++ < NewChannels - OldChannels);
-            }
-            *Result = BufferOut;
-            *ResultLength = Samples * NewChannels;
-        }
-        else if (BitsPerSample == 24)
-        {
-            PUCHAR BufferOut = ExAllocatePool(NonPagedPool, Samples * NewChannels);
-            if (!BufferOut)
-                return STATUS_INSUFFICIENT_RESOURCES;
+static
+VOID
+KMixLeaveSumNode(
+    IN PKMIXER_PIN_CONTEXT Context)
+{
+    KIRQL OldIrql;
 
-            for(NewIndex = 0, OldIndex = 0; OldIndex < Samples * OldChannels; NewIndex += NewChannels, OldIndex += OldChannels)
-            {
-                ULONG SubIndex = 0;
+    KeAcquireSpinLock(&Context->Filter->Lock, &OldIrql);
+    if (Context->SumNode)
+    {
+        RemoveEntryList(&Context->SinkEntry);
+        Context->SumNode = NULL;
+    }
+    KeReleaseSpinLock(&Context->Filter->Lock, OldIrql);
+}
 
-                RtlMoveMemory(&BufferOut[NewIndex], &Buffer[OldIndex], OldChannels * 3);
+static
+BOOLEAN
+KMixMixFrames(
+    IN PKMIXER_PIN_CONTEXT Context,
+    IN const FLOAT *Samples,
+    IN ULONG Frames)
+{
+    PSUM_NODE_CONTEXT SumNode;
+    ULONG Channels, Position, First;
+    KIRQL OldIrql;
 
-                do
-                {
-                     RtlMoveMemory(&BufferOut[(NewIndex+OldChannels + SubIndex) * 3], &Buffer[(OldIndex + (SubIndex % OldChannels)) * 3], 3);
-                }while(SubIndex++ < NewChannels - OldChannels);
-            }
-            *Result = BufferOut;
-            *ResultLength = Samples * NewChannels;
-        }
-        else if (BitsPerSample == 32)
-        {
-            PULONG BufferOut = ExAllocatePool(NonPagedPool, Samples * NewChannels);
-            if (!BufferOut)
-                return STATUS_INSUFFICIENT_RESOURCES;
+    KeAcquireSpinLock(&Context->Filter->Lock, &OldIrql);
 
-            for(NewIndex = 0, OldIndex = 0; OldIndex < Samples * OldChannels; NewIndex += NewChannels, OldIndex += OldChannels)
-            {
-                ULONG SubIndex = 0;
+    /* the source may have closed in the meantime */
+    SumNode = Context->SumNode;
+    if (!SumNode)
+    {
+        KeReleaseSpinLock(&Context->Filter->Lock, OldIrql);
+        return FALSE;
+    }
 
-                RtlMoveMemory(&BufferOut[NewIndex], &Buffer[OldIndex], OldChannels * sizeof(ULONG));
+    /* frames the source has not caught up with are dropped */
+    Frames = min(Frames, SumNode->BufferFrames - Context->MixFrames);
+    Channels = SumNode->Format.nChannels;
 
-                do
-                {
-                     BufferOut[NewIndex+OldChannels + SubIndex] = Buffer[OldIndex + (SubIndex % OldChannels)];
-                }while(SubIndex++ < NewChannels - OldChannels);
-            }
-            *Result = BufferOut;
-            *ResultLength = Samples * NewChannels;
-        }
+    Position = (SumNode->ReadPosition + Context->MixFrames) % SumNode->BufferFrames;
+    First = min(Frames, SumNode->BufferFrames - Position);
 
-    }
-    else
-    {
-        PUSHORT BufferOut = ExAllocatePool(NonPagedPool, Samples * NewChannels);
-        if (!BufferOut)
-            return STATUS_INSUFFICIENT_RESOURCES;
+    KMixAccumulate(&SumNode->Buffer[Position * Channels], Samples, First * Channels, KMixUseSse2);
+    KMixAccumulate(SumNode->Buffer, &Samples[First * Channels], (Frames - First) * Channels, KMixUseSse2);
 
-        for(NewIndex = 0, OldIndex = 0; OldIndex < Samples * OldChannels; NewIndex += NewChannels, OldIndex += OldChannels)
-        {
-            /* TODO
-             * mix stream instead of just dumping part of it ;)
-             */
-            RtlMoveMemory(&BufferOut[NewIndex], &Buffer[OldIndex], NewChannels * (BitsPerSample/8));
-        }
+    Context->MixFrames += Frames;
+    SumNode->FilledFrames = max(SumNode->FilledFrames, Context->MixFrames);
 
-        *Result = BufferOut;
-        *ResultLength = Samples * NewChannels;
-    }
-    return STATUS_SUCCESS;
+    KeReleaseSpinLock(&Context->Filter->Lock, OldIrql);
+    return TRUE;
 }
 
-
-NTSTATUS
-PerformQualityConversion(
-    PUCHAR Buffer,
-    ULONG BufferLength,
-    ULONG OldWidth,
-    ULONG NewWidth,
-    PVOID * Result,
-    PULONG ResultLength)
+static
+ULONG
+KMixReadFrames(
+    IN PKMIXER_PIN_CONTEXT Context,
+    OUT PUCHAR Data,
+    IN ULONG Frames)
 {
-    ULONG Samples;
-    ULONG Index;
+    PSUM_NODE_CONTEXT SumNode = Context->SumNode;
+    PKMIXER_PIN_CONTEXT Sink;
+    PLIST_ENTRY Entry;
+    ULONG Channels, Bits, Position, First;
+    KIRQL OldIrql;
 
-    ASSERT(OldWidth != NewWidth);
+    Channels = SumNode->Format.nChannels;
+    Bits = SumNode->Format.wBitsPerSample;
 
-    Samples = BufferLength / (OldWidth / 8);
-    //DPRINT("Samples %u BufferLength %u\n", Samples, BufferLength);
+    KeAcquireSpinLock(&Context->Filter->Lock, &OldIrql);
 
-    if (OldWidth == 8 && NewWidth == 16)
-    {
-         USHORT Sample;
-         PUSHORT BufferOut = ExAllocatePool(NonPagedPool, Samples * sizeof(USHORT));
-         if (!BufferOut)
-             return STATUS_INSUFFICIENT_RESOURCES;
-
-          for(Index = 0; Index < Samples; Index++)
-          {
-              Sample = Buffer[Index];
-              Sample *= 2;
-#ifdef _X86_
-              Sample = _byteswap_ushort(Sample);
-#endif
-              BufferOut[Index] = Sample;
-          }
-          *Result = BufferOut;
-          *ResultLength = Samples * sizeof(USHORT);
-    }
-    else if (OldWidth == 8 && NewWidth == 32)
-    {
-         ULONG Sample;
-         PULONG BufferOut = ExAllocatePool(NonPagedPool, Samples * sizeof(ULONG));
-         if (!BufferOut)
-             return STATUS_INSUFFICIENT_RESOURCES;
-
-          for(Index = 0; Index < Samples; Index++)
-          {
-              Sample = Buffer[Index];
-              Sample *= 16777216;
-#ifdef _X86_
-              Sample = _byteswap_ulong(Sample);
-#endif
-              BufferOut[Index] = Sample;
-          }
-          *Result = BufferOut;
-          *ResultLength = Samples * sizeof(ULONG);
-    }
-    else if (OldWidth == 16 && NewWidth == 32)
-    {
-         ULONG Sample;
-         PUSHORT BufferIn = (PUSHORT)Buffer;
-         PULONG BufferOut = ExAllocatePool(NonPagedPool, Samples * sizeof(ULONG));
-         if (!BufferOut)
-             return STATUS_INSUFFICIENT_RESOURCES;
-
-          for(Index = 0; Index < Samples; Index++)
-          {
-              Sample = BufferIn[Index];
-              Sample *= 65536;
-#ifdef _X86_
-              Sample = _byteswap_ulong(Sample);
-#endif
-              BufferOut[Index] = Sample;
-          }
-          *Result = BufferOut;
-          *ResultLength = Samples * sizeof(ULONG);
-    }
+    Frames = min(Frames, SumNode->FilledFrames);
+    Position = SumNode->ReadPosition;
+    First = min(Frames, SumNode->BufferFrames - Position);
 
-    else if (OldWidth == 16 && NewWidth == 8)
-    {
-         USHORT Sample;
-         PUSHORT BufferIn = (PUSHORT)Buffer;
-         PUCHAR BufferOut = ExAllocatePool(NonPagedPool, Samples * sizeof(UCHAR));
-         if (!BufferOut)
-             return STATUS_INSUFFICIENT_RESOURCES;
-
-          for(Index = 0; Index < Samples; Index++)
-          {
-              Sample = BufferIn[Index];
-#ifdef _X86_
-              Sample = _byteswap_ushort(Sample);
-#endif
-              Sample /= 256;
-              BufferOut[Index] = (Sample & 0xFF);
-          }
-          *Result = BufferOut;
-          *ResultLength = Samples * sizeof(UCHAR);
-    }
-    else if (OldWidth == 32 && NewWidth == 8)
-    {
-         ULONG Sample;
-         PULONG BufferIn = (PULONG)Buffer;
-         PUCHAR BufferOut = ExAllocatePool(NonPagedPool, Samples * sizeof(UCHAR));
-         if (!BufferOut)
-             return STATUS_INSUFFICIENT_RESOURCES;
-
-          for(Index = 0; Index < Samples; Index++)
-          {
-              Sample = BufferIn[Index];
-#ifdef _X86_
-              Sample = _byteswap_ulong(Sample);
-#endif
-              Sample /= 16777216;
-              BufferOut[Index] = (Sample & 0xFF);
-          }
-          *Result = BufferOut;
-          *ResultLength = Samples * sizeof(UCHAR);
-    }
-    else if (OldWidth == 32 && NewWidth == 16)
-    {
-         USHORT Sample;
-         PULONG BufferIn = (PULONG)Buffer;
-         PUSHORT BufferOut = ExAllocatePool(NonPagedPool, Samples * sizeof(USHORT));
-         if (!BufferOut)
-             return STATUS_INSUFFICIENT_RESOURCES;
-
-          for(Index = 0; Index < Samples; Index++)
-          {
-              Sample = BufferIn[Index];
-#ifdef _X86_
-              Sample = _byteswap_ulong(Sample);
-#endif
-              Sample /= 65536;
-              BufferOut[Index] = (Sample & 0xFFFF);
-          }
-          *Result = BufferOut;
-          *ResultLength = Samples * sizeof(USHORT);
-    }
-    else
+    KMixFloatToPcm(&SumNode->Buffer[Position * Channels], Data, Bits, First * Channels, KMixUseSse2);
+    KMixFloatToPcm(SumNode->Buffer, Data + First * Channels * (Bits / 8), Bits, (Frames - First) * Channels, KMixUseSse2);
+
+    /* consumed frames become silence for the next round of sinks */
+    RtlZeroMemory(&SumNode->Buffer[Position * Channels], First * Channels * sizeof(FLOAT));
+    RtlZeroMemory(SumNode->Buffer, (Frames - First) * Channels * sizeof(FLOAT));
+
+    SumNode->ReadPosition = (Position + Frames) % SumNode->BufferFrames;
+    SumNode->FilledFrames -= Frames;
+
+    for (Entry = SumNode->SinkList.Flink; Entry != &SumNode->SinkList; Entry = Entry->Flink)
     {
-        DPRINT1("Not implemented conversion OldWidth %u NewWidth %u\n", OldWidth, NewWidth);
-        return STATUS_NOT_IMPLEMENTED;
+        Sink = CONTAINING_RECORD(Entry, KMIXER_PIN_CONTEXT, SinkEntry);
+        Sink->MixFrames = (Sink->MixFrames > Frames ? Sink->MixFrames - Frames : 0);
     }
 
-    return STATUS_SUCCESS;
+    KeReleaseSpinLock(&Context->Filter->Lock, OldIrql);
+    return Frames;
 }
 
-
 NTSTATUS
 NTAPI
 Pin_fnDeviceIoControl(
@@ -438,24 +283,33 @@ Pin_fnDeviceIoControl(
         {
             if (Property->Property.Id == KSPROPERTY_CONNECTION_DATAFORMAT && Property->Property.Flags == KSPROPERTY_TYPE_SET)
             {
+                PKMIXER_PIN_CONTEXT Context;
                 PKSDATAFORMAT_WAVEFORMATEX Formats;
                 PKSDATAFORMAT_WAVEFORMATEX WaveFormat;
+                NTSTATUS Status = STATUS_SUCCESS;
 
-                Formats = (PKSDATAFORMAT_WAVEFORMATEX)IoStack->FileObject->FsContext2;
+                Context = (PKMIXER_PIN_CONTEXT)IoStack->FileObject->FsContext;
                 WaveFormat = (PKSDATAFORMAT_WAVEFORMATEX)Irp->UserBuffer;
 
                 ASSERT(Property->PinId == 0 || Property->PinId == 1);
-                ASSERT(Formats);
+                ASSERT(Context);
                 ASSERT(WaveFormat);
 
+                Formats = Context->Formats;
                 Formats[Property->PinId].WaveFormatEx.nChannels = WaveFormat->WaveFormatEx.nChannels;
                 Formats[Property->PinId].WaveFormatEx.wBitsPerSample = WaveFormat->WaveFormatEx.wBitsPerSample;
                 Formats[Property->PinId].WaveFormatEx.nSamplesPerSec = WaveFormat->WaveFormatEx.nSamplesPerSec;
 
+                /* build the conversion pipeline now instead of on every buffer */
+                if (Context->PinId == KMIXER_PIN_SOURCE)
+                    Status = KMixAttachSource(Context);
+                else
+                    KMixSetupPipeline(Context);
+
                 Irp->IoStatus.Information = 0;
-                Irp->IoStatus.Status = STATUS_SUCCESS;
+                Irp->IoStatus.Status = Status;
                 IoCompleteRequest(Irp, IO_NO_INCREMENT);
-                return STATUS_SUCCESS;
+                return Status;
             }
         }
     }
@@ -514,7 +368,35 @@ Pin_fnClose(
     PDEVICE_OBJECT DeviceObject,
     PIRP Irp)
 {
-    UNIMPLEMENTED;
+    PIO_STACK_LOCATION IoStack;
+    PKMIXER_PIN_CONTEXT Context;
+    PFILE_OBJECT FilterObject;
+
+    IoStack = IoGetCurrentIrpStackLocation(Irp);
+    Context = (PKMIXER_PIN_CONTEXT)IoStack->FileObject->FsContext;
+
+    if (Context)
+    {
+        if (Context->PinId == KMIXER_PIN_SOURCE)
+        {
+            if (Context->SumNode)
+                KMixDetachSource(Context);
+        }
+        else
+        {
+            KMixLeaveSumNode(Context);
+        }
+
+        if (Context->PipelineReady)
+            KMixDestroyPipeline(&Context->Pipeline);
+
+        FilterObject = Context->FilterObject;
+        ExFreePoolWithTag(Context, TAG_KMIXER);
+        IoStack->FileObject->FsContext = NULL;
+
+        /* the filter may be closed now */
+        ObDereferenceObject(FilterObject);
+    }
 
     Irp->IoStatus.Status = STATUS_SUCCESS;
     Irp->IoStatus.Information = 0;
@@ -583,9 +465,38 @@ Pin_fnFastRead(
     PIO_STATUS_BLOCK IoStatus,
     PDEVICE_OBJECT DeviceObject)
 {
-    UNIMPLEMENTED;
-    return FALSE;
+    PKSSTREAM_HEADER StreamHeader;
+    PKMIXER_PIN_CONTEXT Context;
+    KFLOATING_SAVE FloatSave;
+    ULONG FrameSize, Frames;
+    NTSTATUS Status;
 
+    DPRINT("Pin_fnFastRead called DeviceObject %p\n", DeviceObject);
+
+    Context = (PKMIXER_PIN_CONTEXT)FileObject->FsContext;
+    StreamHeader = (PKSSTREAM_HEADER)Buffer;
+
+    /* only source pins return the mix of their sinks */
+    if (Context->PinId != KMIXER_PIN_SOURCE || !Context->SumNode || Length < sizeof(KSSTREAM_HEADER))
+        return FALSE;
+
+    Status = KeSaveFloatingPointState(&FloatSave);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("KeSaveFloatingPointState failed with %x\n", Status);
+        IoStatus->Status = Status;
+        return FALSE;
+    }
+
+    FrameSize = Context->SumNode->Format.nChannels * (Context->SumNode->Format.wBitsPerSample / 8);
+    Frames = KMixReadFrames(Context, StreamHeader->Data, StreamHeader->FrameExtent / FrameSize);
+
+    KeRestoreFloatingPointState(&FloatSave);
+
+    StreamHeader->DataUsed = Frames * FrameSize;
+    IoStatus->Information = sizeof(KSSTREAM_HEADER);
+    IoStatus->Status = STATUS_SUCCESS;
+    return TRUE;
 }
 
 BOOLEAN
@@ -601,78 +512,94 @@ Pin_fnFastWrite(
     PDEVICE_OBJECT DeviceObject)
 {
     PKSSTREAM_HEADER StreamHeader;
+    PKMIXER_PIN_CONTEXT Context;
+    PWAVEFORMATEX OutputFormat;
+    KFLOATING_SAVE FloatSave;
+    PFLOAT Samples;
     PVOID BufferOut;
-    ULONG BufferLength;
-    NTSTATUS Status = STATUS_SUCCESS;
-    PKSDATAFORMAT_WAVEFORMATEX Formats;
-    PKSDATAFORMAT_WAVEFORMATEX InputFormat, OutputFormat;
+    ULONG Offset, Frames, BufferLength;
+    NTSTATUS Status;
 
-    DPRINT("Pin_fnFastWrite called DeviceObject %p Irp %p\n", DeviceObject);
+    DPRINT("Pin_fnFastWrite called DeviceObject %p\n", DeviceObject);
 
-    Formats = (PKSDATAFORMAT_WAVEFORMATEX)FileObject->FsContext2;
+    Context = (PKMIXER_PIN_CONTEXT)FileObject->FsContext;
+    OutputFormat = &Context->Formats[1].WaveFormatEx;
 
-    InputFormat = Formats;
-    OutputFormat = (Formats + 1);
-    StreamHeader = (PKSSTREAM_HEADER)Buffer;
+    /* without both formats there is nothing to convert */
+    if (!Context->PipelineReady)
+    {
+        IoStatus->Status = STATUS_SUCCESS;
+        return TRUE;
+    }
 
+    /* mix into the bus of a source pin with our output format once one exists */
+    if (!Context->SumNode && !IsListEmpty(&Context->Filter->SumNodeList))
+        KMixJoinSumNode(Context);
 
-    DPRINT("Num Channels %u Old Channels %u\n SampleRate %u Old SampleRate %u\n BitsPerSample %u Old BitsPerSample %u\n",
-               InputFormat->WaveFormatEx.nChannels, OutputFormat->WaveFormatEx.nChannels,
-               InputFormat->WaveFormatEx.nSamplesPerSec, OutputFormat->WaveFormatEx.nSamplesPerSec,
-               InputFormat->WaveFormatEx.wBitsPerSample, OutputFormat->WaveFormatEx.wBitsPerSample);
+    if (!Context->SumNode && KMixIsSameFormat(&Context->Formats[0].WaveFormatEx, OutputFormat))
+    {
+        IoStatus->Status = STATUS_SUCCESS;
+        return TRUE;
+    }
 
-    if (InputFormat->WaveFormatEx.wBitsPerSample != OutputFormat->WaveFormatEx.wBitsPerSample)
+    Status = KeSaveFloatingPointState(&FloatSave);
+    if (!NT_SUCCESS(Status))
     {
-        Status = PerformQualityConversion(StreamHeader->Data,
-                                          StreamHeader->DataUsed,
-                                          InputFormat->WaveFormatEx.wBitsPerSample,
-                                          OutputFormat->WaveFormatEx.wBitsPerSample,
-                                          &BufferOut,
-                                          &BufferLength);
-        if (NT_SUCCESS(Status))
-        {
-            ExFreePool(StreamHeader->Data);
-            StreamHeader->Data = BufferOut;
-            StreamHeader->DataUsed = BufferLength;
-        }
+        DPRINT1("KeSaveFloatingPointState failed with %x\n", Status);
+        IoStatus->Status = Status;
+        return FALSE;
     }
 
-    if (InputFormat->WaveFormatEx.nChannels != OutputFormat->WaveFormatEx.nChannels)
+    for (Offset = 0; Offset + sizeof(KSSTREAM_HEADER) <= Length; Offset += StreamHeader->Size)
     {
-        Status = PerformChannelConversion(StreamHeader->Data,
-                                          StreamHeader->DataUsed,
-                                          InputFormat->WaveFormatEx.nChannels,
-                                          OutputFormat->WaveFormatEx.nChannels,
-                                          OutputFormat->WaveFormatEx.wBitsPerSample,
-                                          &BufferOut,
-                                          &BufferLength);
-
-        if (NT_SUCCESS(Status))
+        StreamHeader = (PKSSTREAM_HEADER)((PUCHAR)Buffer + Offset);
+        if (StreamHeader->Size < sizeof(KSSTREAM_HEADER))
+            break;
+
+        Samples = KMixProcessToFloat(&Context->Pipeline, StreamHeader->Data, StreamHeader->DataUsed, &Frames);
+        if (!Samples)
         {
-            ExFreePool(StreamHeader->Data);
-            StreamHeader->Data = BufferOut;
-            StreamHeader->DataUsed = BufferLength;
+            Status = STATUS_UNSUCCESSFUL;
+            break;
         }
-    }
 
-    if (InputFormat->WaveFormatEx.nSamplesPerSec != OutputFormat->WaveFormatEx.nSamplesPerSec)
-    {
-        Status = PerformSampleRateConversion(StreamHeader->Data,
-                                             StreamHeader->DataUsed,
-                                             InputFormat->WaveFormatEx.nSamplesPerSec,
-                                             OutputFormat->WaveFormatEx.nSamplesPerSec,
-                                             OutputFormat->WaveFormatEx.wBitsPerSample / 8,
-                                             OutputFormat->WaveFormatEx.nChannels,
-                                             &BufferOut,
-                                             &BufferLength);
-        if (NT_SUCCESS(Status))
+        /* mixed streams reach the device through the source pin */
+        if (Context->SumNode && KMixMixFrames(Context, Samples, Frames))
+        {
+            StreamHeader->DataUsed = 0;
+            continue;
+        }
+
+        BufferLength = Frames * OutputFormat->nChannels * (OutputFormat->wBitsPerSample / 8);
+
+        /* convert in place unless the result outgrows the buffer */
+        if (BufferLength <= StreamHeader->FrameExtent)
+        {
+            KMixFloatToPcm(Samples, StreamHeader->Data, OutputFormat->wBitsPerSample,
+                           Frames * OutputFormat->nChannels, KMixUseSse2);
+        }
+        else
         {
+            BufferOut = ExAllocatePool(NonPagedPool, BufferLength);
+            if (!BufferOut)
+            {
+                Status = STATUS_INSUFFICIENT_RESOURCES;
+                break;
+            }
+
+            KMixFloatToPcm(Samples, BufferOut, OutputFormat->wBitsPerSample,
+                           Frames * OutputFormat->nChannels, KMixUseSse2);
+
             ExFreePool(StreamHeader->Data);
             StreamHeader->Data = BufferOut;
-            StreamHeader->DataUsed = BufferLength;
+            StreamHeader->FrameExtent = BufferLength;
         }
+
+        StreamHeader->DataUsed = BufferLength;
     }
 
+    KeRestoreFloatingPointState(&FloatSave);
+
     IoStatus->Status = Status;
 
     if (NT_SUCCESS(Status))
@@ -701,21 +628,52 @@ CreatePin(
 {
     NTSTATUS Status;
     KSOBJECT_HEADER ObjectHeader;
-    PKSDATAFORMAT DataFormat;
+    PKMIXER_PIN_CONTEXT Context;
     PIO_STACK_LOCATION IoStack;
+    PFILE_OBJECT FilterObject;
+    KSPIN_CONNECT Connect;
+    ULONG ObjectLength;
 
+    IoStack = IoGetCurrentIrpStackLocation(Irp);
 
-    DataFormat = ExAllocatePool(NonPagedPool, sizeof(KSDATAFORMAT_WAVEFORMATEX) * 2);
-    if (!DataFormat)
+    /* pins are opened relative to a filter */
+    FilterObject = IoStack->FileObject->RelatedFileObject;
+    if (!FilterObject || !FilterObject->FsContext)
+        return STATUS_INVALID_PARAMETER;
+
+    Context = ExAllocatePoolWithTag(NonPagedPool, sizeof(KMIXER_PIN_CONTEXT), TAG_KMIXER);
+    if (!Context)
         return STATUS_INSUFFICIENT_RESOURCES;
 
-    RtlZeroMemory(DataFormat, sizeof(KSDATAFORMAT_WAVEFORMATEX) * 2);
+    RtlZeroMemory(Context, sizeof(KMIXER_PIN_CONTEXT));
+    Context->Filter = (PKMIXER_FILTER_CONTEXT)FilterObject->FsContext;
+    Context->PinId = KMIXER_PIN_SINK;
 
-    IoStack = IoGetCurrentIrpStackLocation(Irp);
-    IoStack->FileObject->FsContext2 = (PVOID)DataFormat;
+    /* the connect request follows the object class */
+    ObjectLength = (wcslen(KSSTRING_Pin) + 1) * sizeof(WCHAR);
+    if (ObjectLength + sizeof(KSPIN_CONNECT) <= IoStack->FileObject->FileName.MaximumLength)
+    {
+        RtlMoveMemory(&Connect, &IoStack->FileObject->FileName.Buffer[ObjectLength / sizeof(WCHAR)], sizeof(KSPIN_CONNECT));
+        if (Connect.PinId == KMIXER_PIN_SOURCE)
+            Context->PinId = KMIXER_PIN_SOURCE;
+    }
+
+    /* the object header takes FsContext2, keep the pin context in FsContext */
+    IoStack->FileObject->FsContext = (PVOID)Context;
 
     /* allocate object header */
     Status = KsAllocateObjectHeader(&ObjectHeader, 0, NULL, Irp, &PinTable);
+    if (!NT_SUCCESS(Status))
+    {
+        IoStack->FileObject->FsContext = NULL;
+        ExFreePoolWithTag(Context, TAG_KMIXER);
+        return Status;
+    }
+
+    /* keep the filter context alive while the pin uses it */
+    ObReferenceObject(FilterObject);
+    Context->FilterObject = FilterObject;
+
     return Status;
 }
 
@@ -0,0 +1,525 @@
+/*
+ * PROJECT:     ReactOS Kernel Streaming Mixer
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Format conversion pipeline, also built into audio_test
+ */
+
+#ifdef KMIXER_USERMODE
+#include <windef.h>
+#include <mmreg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float_cast.h>
+#include "pipeline.h"
+#else
+#include "kmixer.h"
+#endif
+
+#if defined(_M_IX86) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define KMIX_HAVE_SSE2
+#if defined(__GNUC__) && defined(_M_IX86)
+#define KMIX_SSE2_TARGET __attribute__((__target__("sse2")))
+#else
+#define KMIX_SSE2_TARGET
+#endif
+#endif
+
+/* Output frames the resampler may return for a given number of input frames */
+static
+ULONG
+KMixGetResampledFrames(
+    IN PKMIXER_PIPELINE Pipeline,
+    IN ULONG Frames)
+{
+    return (ULONG)(((ULONG64)Frames * Pipeline->OutSamplesPerSec + Pipeline->InSamplesPerSec - 1) /
+                   Pipeline->InSamplesPerSec) + 32;
+}
+
+static
+VOID
+KMixFreeBuffers(
+    IN PKMIXER_PIPELINE Pipeline)
+{
+    if (Pipeline->FloatIn)
+        free(Pipeline->FloatIn);
+    if (Pipeline->FloatMix)
+        free(Pipeline->FloatMix);
+    if (Pipeline->FloatOut)
+        free(Pipeline->FloatOut);
+
+    Pipeline->FloatIn = NULL;
+    Pipeline->FloatMix = NULL;
+    Pipeline->FloatOut = NULL;
+    Pipeline->MaxFrames = 0;
+}
+
+static
+BOOLEAN
+KMixAllocateBuffers(
+    IN PKMIXER_PIPELINE Pipeline,
+    IN ULONG MaxFrames)
+{
+    KMixFreeBuffers(Pipeline);
+
+    Pipeline->FloatIn = calloc(MaxFrames * Pipeline->InChannels, sizeof(FLOAT));
+    if (!Pipeline->FloatIn)
+        return FALSE;
+
+    /* The later stages are only needed when they change the data */
+    if (Pipeline->InChannels != Pipeline->OutChannels)
+    {
+        Pipeline->FloatMix = calloc(MaxFrames * Pipeline->OutChannels, sizeof(FLOAT));
+        if (!Pipeline->FloatMix)
+        {
+            KMixFreeBuffers(Pipeline);
+            return FALSE;
+        }
+    }
+
+    if (Pipeline->Resampler)
+    {
+        Pipeline->FloatOut = calloc(KMixGetResampledFrames(Pipeline, MaxFrames) * Pipeline->OutChannels,
+                                    sizeof(FLOAT));
+        if (!Pipeline->FloatOut)
+        {
+            KMixFreeBuffers(Pipeline);
+            return FALSE;
+        }
+    }
+
+    Pipeline->MaxFrames = MaxFrames;
+    return TRUE;
+}
+
+#ifdef KMIX_HAVE_SSE2
+
+KMIX_SSE2_TARGET
+static
+ULONG
+KMixPcmToFloatSse2(
+    IN PVOID Input,
+    OUT PFLOAT Output,
+    IN ULONG BitsPerSample,
+    IN ULONG Samples)
+{
+    ULONG Index = 0;
+
+    if (BitsPerSample == 16)
+    {
+        const SHORT *In = (const SHORT *)Input;
+        const __m128 Scale = _mm_set1_ps(1.0f / 32768.0f);
+        __m128i Value;
+
+        for (; Index + 8 <= Samples; Index += 8)
+        {
+            Value = _mm_loadu_si128((const __m128i *)&In[Index]);
+
+            /* Sign extend by unpacking into the upper half */
+            _mm_storeu_ps(&Output[Index],
+                          _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(Value, Value), 16)), Scale));
+            _mm_storeu_ps(&Output[Index + 4],
+                          _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(Value, Value), 16)), Scale));
+        }
+    }
+    else if (BitsPerSample == 32)
+    {
+        const LONG *In = (const LONG *)Input;
+        const __m128 Scale = _mm_set1_ps(1.0f / 2147483648.0f);
+
+        for (; Index + 4 <= Samples; Index += 4)
+        {
+            _mm_storeu_ps(&Output[Index],
+                          _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)&In[Index])), Scale));
+        }
+    }
+
+    return Index;
+}
+
+KMIX_SSE2_TARGET
+static
+ULONG
+KMixFloatToPcmSse2(
+    IN const FLOAT *Input,
+    OUT PVOID Output,
+    IN ULONG BitsPerSample,
+    IN ULONG Samples)
+{
+    ULONG Index = 0;
+
+    if (BitsPerSample == 16)
+    {
+        PSHORT Out = (PSHORT)Output;
+        const __m128 Scale = _mm_set1_ps(32768.0f);
+        const __m128 Max = _mm_set1_ps(32767.0f);
+        const __m128 Min = _mm_set1_ps(-32768.0f);
+        __m128i Low, High;
+
+        for (; Index + 8 <= Samples; Index += 8)
+        {
+            Low = _mm_cvtps_epi32(_mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(&Input[Index]), Scale), Max), Min));
+            High = _mm_cvtps_epi32(_mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(&Input[Index + 4]), Scale), Max), Min));
+            _mm_storeu_si128((__m128i *)&Out[Index], _mm_packs_epi32(Low, High));
+        }
+    }
+    else if (BitsPerSample == 32)
+    {
+        PLONG Out = (PLONG)Output;
+        const __m128 Scale = _mm_set1_ps(2147483648.0f);
+        /* The largest float below 2^31, cvtps would overflow on 2^31 */
+        const __m128 Max = _mm_set1_ps(2147483520.0f);
+        const __m128 Min = _mm_set1_ps(-2147483648.0f);
+
+        for (; Index + 4 <= Samples; Index += 4)
+        {
+            _mm_storeu_si128((__m128i *)&Out[Index],
+                             _mm_cvtps_epi32(_mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(&Input[Index]), Scale), Max), Min)));
+        }
+    }
+
+    return Index;
+}
+
+KMIX_SSE2_TARGET
+static
+ULONG
+KMixConvertChannelsSse2(
+    IN const FLOAT *Input,
+    IN ULONG InChannels,
+    OUT PFLOAT Output,
+    IN ULONG OutChannels,
+    IN ULONG Frames)
+{
+    ULONG Index = 0;
+    __m128 First, Second;
+
+    if (InChannels == 2 && OutChannels == 1)
+    {
+        const __m128 Half = _mm_set1_ps(0.5f);
+
+        for (; Index + 4 <= Frames; Index += 4)
+        {
+            First = _mm_loadu_ps(&Input[Index * 2]);
+            Second = _mm_loadu_ps(&Input[Index * 2 + 4]);
+            _mm_storeu_ps(&Output[Index],
+                          _mm_mul_ps(_mm_add_ps(_mm_shuffle_ps(First, Second, _MM_SHUFFLE(2, 0, 2, 0)),
+                                                _mm_shuffle_ps(First, Second, _MM_SHUFFLE(3, 1, 3, 1))),
+                                     Half));
+        }
+    }
+    else if (InChannels == 1 && OutChannels == 2)
+    {
+        for (; Index + 4 <= Frames; Index += 4)
+        {
+            First = _mm_loadu_ps(&Input[Index]);
+            _mm_storeu_ps(&Output[Index * 2], _mm_unpacklo_ps(First, First));
+            _mm_storeu_ps(&Output[Index * 2 + 4], _mm_unpackhi_ps(First, First));
+        }
+    }
+
+    return Index;
+}
+
+KMIX_SSE2_TARGET
+static
+ULONG
+KMixAccumulateSse2(
+    IN OUT PFLOAT Mix,
+    IN const FLOAT *Input,
+    IN ULONG Samples)
+{
+    ULONG Index;
+
+    for (Index = 0; Index + 4 <= Samples; Index += 4)
+    {
+        _mm_storeu_ps(&Mix[Index], _mm_add_ps(_mm_loadu_ps(&Mix[Index]), _mm_loadu_ps(&Input[Index])));
+    }
+
+    return Index;
+}
+
+#endif /* KMIX_HAVE_SSE2 */
+
+static
+VOID
+KMixPcmToFloat(
+    IN PVOID Input,
+    OUT PFLOAT Output,
+    IN ULONG BitsPerSample,
+    IN ULONG Samples,
+    IN BOOLEAN UseSse2)
+{
+    ULONG Index = 0;
+    PUCHAR In = (PUCHAR)Input;
+
+#ifdef KMIX_HAVE_SSE2
+    if (UseSse2)
+        Index = KMixPcmToFloatSse2(Input, Output, BitsPerSample, Samples);
+#endif
+
+    switch (BitsPerSample)
+    {
+        case 8:
+            /* 8 bit samples are unsigned */
+            for (; Index < Samples; Index++)
+                Output[Index] = ((LONG)In[Index] - 0x80) * (1.0f / 128.0f);
+            break;
+
+        case 16:
+            for (; Index < Samples; Index++)
+                Output[Index] = ((PSHORT)In)[Index] * (1.0f / 32768.0f);
+            break;
+
+        case 24:
+            for (; Index < Samples; Index++)
+            {
+                Output[Index] = (LONG)(((ULONG)In[Index * 3] << 8) |
+                                       ((ULONG)In[Index * 3 + 1] << 16) |
+                                       ((ULONG)In[Index * 3 + 2] << 24)) * (1.0f / 2147483648.0f);
+            }
+            break;
+
+        case 32:
+            for (; Index < Samples; Index++)
+                Output[Index] = ((PLONG)In)[Index] * (1.0f / 2147483648.0f);
+            break;
+    }
+}
+
+VOID
+KMixFloatToPcm(
+    IN const FLOAT *Input,
+    OUT PVOID Output,
+    IN ULONG BitsPerSample,
+    IN ULONG Samples,
+    IN BOOLEAN UseSse2)
+{
+    ULONG Index = 0;
+    PUCHAR Out = (PUCHAR)Output;
+    LONG Value;
+
+#ifdef KMIX_HAVE_SSE2
+    if (UseSse2)
+        Index = KMixFloatToPcmSse2(Input, Output, BitsPerSample, Samples);
+#endif
+
+    switch (BitsPerSample)
+    {
+        case 8:
+            for (; Index < Samples; Index++)
+            {
+                Value = lrintf(Input[Index] * 128.0f);
+                Out[Index] = (UCHAR)(max(-128, min(Value, 127)) + 0x80);
+            }
+            break;
+
+        case 16:
+            for (; Index < Samples; Index++)
+            {
+                Value = lrintf(Input[Index] * 32768.0f);
+                ((PSHORT)Out)[Index] = (SHORT)max(-32768, min(Value, 32767));
+            }
+            break;
+
+        case 24:
+            for (; Index < Samples; Index++)
+            {
+                Value = lrintf(Input[Index] * 8388608.0f);
+                Value = max(-8388608, min(Value, 8388607));
+                Out[Index * 3] = (UCHAR)Value;
+                Out[Index * 3 + 1] = (UCHAR)(Value >> 8);
+                Out[Index * 3 + 2] = (UCHAR)(Value >> 16);
+            }
+            break;
+
+        case 32:
+            for (; Index < Samples; Index++)
+            {
+                if (Input[Index] >= 1.0f)
+                    Value = MAXLONG;
+                else if (Input[Index] <= -1.0f)
+                    Value = MINLONG;
+                else
+                    Value = lrintf(Input[Index] * 2147483648.0f);
+                ((PLONG)Out)[Index] = Value;
+            }
+            break;
+    }
+}
+
+static
+VOID
+KMixConvertChannels(
+    IN const FLOAT *Input,
+    IN ULONG InChannels,
+    OUT PFLOAT Output,
+    IN ULONG OutChannels,
+    IN ULONG Frames,
+    IN BOOLEAN UseSse2)
+{
+    ULONG Frame = 0, Channel, InChannel;
+    FLOAT Sum, Scale;
+
+#ifdef KMIX_HAVE_SSE2
+    if (UseSse2)
+        Frame = KMixConvertChannelsSse2(Input, InChannels, Output, OutChannels, Frames);
+#endif
+
+    Input += Frame * InChannels;
+    Output += Frame * OutChannels;
+
+    if (OutChannels > InChannels)
+    {
+        /* Repeat the input channels, 2 channels stretched to 4 look like LRLR */
+        for (; Frame < Frames; Frame++, Input += InChannels, Output += OutChannels)
+        {
+            for (Channel = 0; Channel < OutChannels; Channel++)
+                Output[Channel] = Input[Channel % InChannels];
+        }
+    }
+    else
+    {
+        /* Fold every input channel into an output channel and average them */
+        for (; Frame < Frames; Frame++, Input += InChannels, Output += OutChannels)
+        {
+            for (Channel = 0; Channel < OutChannels; Channel++)
+            {
+                Sum = 0.0f;
+                Scale = 0.0f;
+                for (InChannel = Channel; InChannel < InChannels; InChannel += OutChannels)
+                {
+                    Sum += Input[InChannel];
+                    Scale += 1.0f;
+                }
+                Output[Channel] = Sum / Scale;
+            }
+        }
+    }
+}
+
+VOID
+KMixAccumulate(
+    IN OUT PFLOAT Mix,
+    IN const FLOAT *Input,
+    IN ULONG Samples,
+    IN BOOLEAN UseSse2)
+{
+    ULONG Index = 0;
+
+#ifdef KMIX_HAVE_SSE2
+    if (UseSse2)
+        Index = KMixAccumulateSse2(Mix, Input, Samples);
+#endif
+
+    for (; Index < Samples; Index++)
+        Mix[Index] += Input[Index];
+}
+
+BOOLEAN
+KMixInitializePipeline(
+    OUT PKMIXER_PIPELINE Pipeline,
+    IN const WAVEFORMATEX *InputFormat,
+    IN const WAVEFORMATEX *OutputFormat,
+    IN ULONG MaxFrames,
+    IN BOOLEAN UseSse2)
+{
+    int Error;
+
+    RtlZeroMemory(Pipeline, sizeof(KMIXER_PIPELINE));
+
+    if (!InputFormat->nChannels || !OutputFormat->nChannels ||
+        !InputFormat->nSamplesPerSec || !OutputFormat->nSamplesPerSec)
+        return FALSE;
+
+    if ((InputFormat->wBitsPerSample % 8) || InputFormat->wBitsPerSample < 8 || InputFormat->wBitsPerSample > 32 ||
+        (OutputFormat->wBitsPerSample % 8) || OutputFormat->wBitsPerSample < 8 || OutputFormat->wBitsPerSample > 32)
+        return FALSE;
+
+    Pipeline->InChannels = InputFormat->nChannels;
+    Pipeline->InBitsPerSample = InputFormat->wBitsPerSample;
+    Pipeline->InSamplesPerSec = InputFormat->nSamplesPerSec;
+    Pipeline->OutChannels = OutputFormat->nChannels;
+    Pipeline->OutBitsPerSample = OutputFormat->wBitsPerSample;
+    Pipeline->OutSamplesPerSec = OutputFormat->nSamplesPerSec;
+    Pipeline->UseSse2 = UseSse2;
+
+    if (Pipeline->InSamplesPerSec != Pipeline->OutSamplesPerSec)
+    {
+        Pipeline->Resampler = src_new(SRC_SINC_FASTEST, Pipeline->OutChannels, &Error);
+        if (!Pipeline->Resampler)
+            return FALSE;
+    }
+
+    if (!KMixAllocateBuffers(Pipeline, max(MaxFrames, 1)))
+    {
+        KMixDestroyPipeline(Pipeline);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+VOID
+KMixDestroyPipeline(
+    IN PKMIXER_PIPELINE Pipeline)
+{
+    KMixFreeBuffers(Pipeline);
+
+    if (Pipeline->Resampler)
+        src_delete(Pipeline->Resampler);
+    Pipeline->Resampler = NULL;
+}
+
+/*
+ * Convert a buffer to float samples in the output channel layout and rate.
+ * The result points into the pipeline and is valid until the next call.
+ */
+PFLOAT
+KMixProcessToFloat(
+    IN PKMIXER_PIPELINE Pipeline,
+    IN PVOID Input,
+    IN ULONG InputLength,
+    OUT PULONG OutputFrames)
+{
+    SRC_DATA Data;
+    PFLOAT Samples;
+    ULONG Frames;
+
+    Frames = InputLength / (Pipeline->InChannels * (Pipeline->InBitsPerSample / 8));
+
+    /* Only grow the buffers when a larger buffer than ever before comes in */
+    if (Frames > Pipeline->MaxFrames && !KMixAllocateBuffers(Pipeline, Frames))
+        return NULL;
+
+    KMixPcmToFloat(Input, Pipeline->FloatIn, Pipeline->InBitsPerSample,
+                   Frames * Pipeline->InChannels, Pipeline->UseSse2);
+    Samples = Pipeline->FloatIn;
+
+    if (Pipeline->InChannels != Pipeline->OutChannels)
+    {
+        KMixConvertChannels(Samples, Pipeline->InChannels,
+                            Pipeline->FloatMix, Pipeline->OutChannels,
+                            Frames, Pipeline->UseSse2);
+        Samples = Pipeline->FloatMix;
+    }
+
+    if (Pipeline->Resampler)
+    {
+        Data.data_in = Samples;
+        Data.data_out = Pipeline->FloatOut;
+        Data.input_frames = Frames;
+        Data.output_frames = KMixGetResampledFrames(Pipeline, Pipeline->MaxFrames);
+        Data.end_of_input = 0;
+        Data.src_ratio = (double)Pipeline->OutSamplesPerSec / (double)Pipeline->InSamplesPerSec;
+
+        if (src_process(Pipeline->Resampler, &Data) != 0)
+            return NULL;
+
+        Frames = Data.output_frames_gen;
+        Samples = Pipeline->FloatOut;
+    }
+
+    *OutputFrames = Frames;
+    return Samples;
+}
@@ -0,0 +1,66 @@
+/*
+ * PROJECT:     ReactOS Kernel Streaming Mixer
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Format conversion pipeline, also built into audio_test
+ */
+
+#ifndef _KMIXER_PIPELINE_H_
+#define _KMIXER_PIPELINE_H_
+
+#include <samplerate.h>
+
+typedef struct _KMIXER_PIPELINE
+{
+    ULONG InChannels;
+    ULONG InBitsPerSample;
+    ULONG InSamplesPerSec;
+    ULONG OutChannels;
+    ULONG OutBitsPerSample;
+    ULONG OutSamplesPerSec;
+    BOOLEAN UseSse2;
+
+    /* Resampler, kept across buffers. NULL if the rates match */
+    SRC_STATE *Resampler;
+
+    /* Work buffers, large enough for MaxFrames input frames */
+    ULONG MaxFrames;
+    PFLOAT FloatIn;
+    PFLOAT FloatMix;
+    PFLOAT FloatOut;
+} KMIXER_PIPELINE, *PKMIXER_PIPELINE;
+
+BOOLEAN
+KMixInitializePipeline(
+    OUT PKMIXER_PIPELINE Pipeline,
+    IN const WAVEFORMATEX *InputFormat,
+    IN const WAVEFORMATEX *OutputFormat,
+    IN ULONG MaxFrames,
+    IN BOOLEAN UseSse2);
+
+VOID
+KMixDestroyPipeline(
+    IN PKMIXER_PIPELINE Pipeline);
+
+PFLOAT
+KMixProcessToFloat(
+    IN PKMIXER_PIPELINE Pipeline,
+    IN PVOID Input,
+    IN ULONG InputLength,
+    OUT PULONG OutputFrames);
+
+VOID
+KMixFloatToPcm(
+    IN const FLOAT *Input,
+    OUT PVOID Output,
+    IN ULONG BitsPerSample,
+    IN ULONG Samples,
+    IN BOOLEAN UseSse2);
+
+VOID
+KMixAccumulate(
+    IN OUT PFLOAT Mix,
+    IN const FLOAT *Input,
+    IN ULONG Samples,
+    IN BOOLEAN UseSse2);
+
+#endif /* _KMIXER_PIPELINE_H_ */
@@ -9,6 +9,7 @@
 
 #include <hal.h>
 #include "apicp.h"
+#include "hpet.h"
 #include <smp.h>
 #define NDEBUG
 #include <debug.h>
@@ -28,6 +29,16 @@ HalpInitProcessor(
     if (ProcessorNumber == 0)
     {
         HalpParseApicTables(LoaderBlock);
+
+        /*
+         * Check if the HPET should drive the clock instead of the RTC. This
+         * also lets the clock IPI skip halted processors
+         */
+        if ((LoaderBlock->LoadOptions) && (strstr(LoaderBlock->LoadOptions, "USEHPET")))
+        {
+            HalpUseHpet = TRUE;
+            HalpSkipIdleTicks = TRUE;
+        }
     }
 
     HalpSetupProcessorsTable(ProcessorNumber);
@@ -0,0 +1,180 @@
+/*
+ * PROJECT:     ReactOS Hardware Abstraction Layer
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     HPET clock
+ *
+ * With the /USEHPET boot option the clock interrupt comes from HPET timer 1
+ * instead of the RTC. In legacy route mode timer 1 takes over IRQ 8, so the
+ * RTC clock vector and handler stay the same. The timer runs in one-shot mode
+ * and the handler arms it for the next tick, which lets the clock run at any
+ * increment down to 0.5 ms instead of the powers of two the RTC has.
+ */
+
+/* INCLUDES *******************************************************************/
+
+#include <hal.h>
+#include "hpet.h"
+#define NDEBUG
+#include <debug.h>
+
+/* GLOBALS ********************************************************************/
+
+BOOLEAN HalpUseHpet;
+static PUCHAR HpetBase;
+static ULONG HpetPeriod;
+static ULONG HpetClockTicks;
+static ULONG HpetMinimumTicks;
+static ULONG HpetComparator;
+
+/* PRIVATE FUNCTIONS **********************************************************/
+
+FORCEINLINE
+ULONG
+HpetRead(ULONG Register)
+{
+    return READ_REGISTER_ULONG((PULONG)(HpetBase + Register));
+}
+
+FORCEINLINE
+VOID
+HpetWrite(ULONG Register, ULONG Value)
+{
+    WRITE_REGISTER_ULONG((PULONG)(HpetBase + Register), Value);
+}
+
+/* Converts an increment in 100ns units into HPET counter ticks */
+FORCEINLINE
+ULONG
+HpetIncrementToTicks(ULONG Increment)
+{
+    /* The counter period is in femtoseconds, 100ns are 10^8 fs */
+    return (ULONG)(((ULONGLONG)Increment * 100000000) / HpetPeriod);
+}
+
+/* FUNCTIONS ******************************************************************/
+
+CODE_SEG("INIT")
+BOOLEAN
+HpetInitialize(VOID)
+{
+    PHYSICAL_ADDRESS BaseAddress;
+    ULONG Capabilities;
+
+    /* The HPET is only used when it was asked for */
+    if (!HalpUseHpet || !HalpGetHpetTable(&BaseAddress))
+        return FALSE;
+
+    /* Map the registers */
+    HpetBase = HalpMapPhysicalMemory64(BaseAddress, 1);
+    if (!HpetBase)
+        return FALSE;
+
+    Capabilities = HpetRead(HPET_GENERAL_CAPABILITIES);
+    HpetPeriod = HpetRead(HPET_COUNTER_CLOCK_PERIOD);
+
+    /* Timer 1 can only take over IRQ 8 in legacy route mode */
+    if (!(Capabilities & HPET_LEGACY_ROUTE_CAPABLE) ||
+        (HPET_NUMBER_OF_TIMERS(Capabilities) < 2) ||
+        (HpetPeriod == 0) ||
+        (HpetPeriod > HPET_MAXIMUM_PERIOD))
+    {
+        DPRINT1("HPET at %I64x cannot drive the clock, capabilities 0x%lx, period %lu fs\n",
+                BaseAddress.QuadPart, Capabilities, HpetPeriod);
+        HalpUnmapVirtualAddress(HpetBase, 1);
+        HpetBase = NULL;
+        return FALSE;
+    }
+
+    /* Deadlines closer than 10 us could be passed before they are written */
+    HpetMinimumTicks = (ULONG)(10000000000ULL / HpetPeriod);
+
+    DPRINT1("HPET at %I64x drives the clock, period %lu fs\n",
+            BaseAddress.QuadPart, HpetPeriod);
+    return TRUE;
+}
+
+/*!
+ *  \brief Returns the increment an HPET clock runs at for a requested increment.
+ *
+ *  \param Increment - Specifies the increment in 100ns units.
+ *
+ *  \return The increment in 0.1ns units, which is what the counter ticks
+ *          add up to. The rest of the fraction of 100ns is accounted for
+ *          by the clock interrupt.
+ */
+ULONG
+HpetGetPreciseIncrement(
+    _In_ ULONG Increment)
+{
+    return (ULONG)(((ULONGLONG)HpetIncrementToTicks(Increment) * HpetPeriod) / 100000);
+}
+
+/*!
+ *  \brief Sets the increment of the following clock interrupts.
+ *
+ *  \param Increment - Specifies the increment in 100ns units.
+ *
+ *  \remarks This is called at CLOCK_LEVEL on the clock processor, it is
+ *           picked up by the next HpetRearmClock.
+ */
+VOID
+HpetSetClockIncrement(
+    _In_ ULONG Increment)
+{
+    HpetClockTicks = HpetIncrementToTicks(Increment);
+}
+
+CODE_SEG("INIT")
+VOID
+HpetStartClock(VOID)
+{
+    ULONG Configuration;
+
+    /* Stop the counter while the timers are set up */
+    Configuration = HpetRead(HPET_GENERAL_CONFIGURATION);
+    HpetWrite(HPET_GENERAL_CONFIGURATION,
+              Configuration & ~(HPET_ENABLE | HPET_LEGACY_ROUTE));
+
+    /* Timer 0 would take over IRQ 0, which nobody listens to */
+    HpetWrite(HPET_TIMER_CONFIGURATION(0),
+              HpetRead(HPET_TIMER_CONFIGURATION(0)) & ~HPET_TIMER_INTERRUPT_ENABLE);
+
+    /* Timer 1 is a 32-bit edge triggered one-shot, the IRQ comes from the legacy route */
+    Configuration = HpetRead(HPET_TIMER_CONFIGURATION(1));
+    Configuration &= ~(HPET_TIMER_LEVEL_TRIGGERED | HPET_TIMER_PERIODIC |
+                       HPET_TIMER_INTERRUPT_ROUTE | HPET_TIMER_FSB_ENABLE);
+    Configuration |= HPET_TIMER_32BIT_MODE | HPET_TIMER_INTERRUPT_ENABLE;
+    HpetWrite(HPET_TIMER_CONFIGURATION(1), Configuration);
+
+    /* Arm the first tick */
+    HpetComparator = HpetRead(HPET_MAIN_COUNTER) + HpetClockTicks;
+    HpetWrite(HPET_TIMER_COMPARATOR(1), HpetComparator);
+
+    /* Start counting, this disconnects the RTC from IRQ 8 */
+    Configuration = HpetRead(HPET_GENERAL_CONFIGURATION);
+    HpetWrite(HPET_GENERAL_CONFIGURATION,
+              Configuration | HPET_ENABLE | HPET_LEGACY_ROUTE);
+}
+
+/*!
+ *  \brief Arms the HPET for the next clock interrupt.
+ *
+ *  \remarks The deadline follows from the previous one rather than from the
+ *           current count, so that the time it takes to handle the interrupt
+ *           does not add up. If the handler was held up for longer than a
+ *           tick, the ticks in between are dropped, just like with the RTC.
+ */
+VOID
+HpetRearmClock(VOID)
+{
+    ULONG Counter;
+
+    Counter = HpetRead(HPET_MAIN_COUNTER);
+    HpetComparator += HpetClockTicks;
+
+    /* The comparator only matches on equality, so it must not be passed */
+    if ((LONG)(HpetComparator - Counter) < (LONG)HpetMinimumTicks)
+        HpetComparator = Counter + HpetClockTicks;
+
+    HpetWrite(HPET_TIMER_COMPARATOR(1), HpetComparator);
+}
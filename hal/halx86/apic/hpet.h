@@ -0,0 +1,59 @@
+/*
+ * PROJECT:     ReactOS Hardware Abstraction Layer
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Header file for the HPET clock
+ */
+
+#pragma once
+
+/* Register offsets */
+#define HPET_GENERAL_CAPABILITIES    0x000
+#define HPET_COUNTER_CLOCK_PERIOD    0x004
+#define HPET_GENERAL_CONFIGURATION   0x010
+#define HPET_MAIN_COUNTER            0x0F0
+#define HPET_TIMER_CONFIGURATION(n)  (0x100 + (n) * 0x20)
+#define HPET_TIMER_COMPARATOR(n)     (0x108 + (n) * 0x20)
+
+/* General capabilities */
+#define HPET_NUMBER_OF_TIMERS(Cap)   ((((Cap) >> 8) & 0x1F) + 1)
+#define HPET_LEGACY_ROUTE_CAPABLE    0x8000
+
+/* General configuration */
+#define HPET_ENABLE                  0x01
+#define HPET_LEGACY_ROUTE            0x02
+
+/* Timer configuration */
+#define HPET_TIMER_LEVEL_TRIGGERED   0x0002
+#define HPET_TIMER_INTERRUPT_ENABLE  0x0004
+#define HPET_TIMER_PERIODIC          0x0008
+#define HPET_TIMER_VALUE_SET         0x0040
+#define HPET_TIMER_32BIT_MODE        0x0100
+#define HPET_TIMER_INTERRUPT_ROUTE   0x3E00
+#define HPET_TIMER_FSB_ENABLE        0x4000
+
+/* The counter period is at most 100 ns, in femtoseconds */
+#define HPET_MAXIMUM_PERIOD          100000000
+
+/* 0.5 ms, the smallest increment the HPET clock is run at */
+#define HPET_MINIMUM_INCREMENT       5000
+
+extern BOOLEAN HalpUseHpet;
+
+CODE_SEG("INIT")
+BOOLEAN
+HpetInitialize(VOID);
+
+ULONG
+HpetGetPreciseIncrement(
+    _In_ ULONG Increment);
+
+VOID
+HpetSetClockIncrement(
+    _In_ ULONG Increment);
+
+CODE_SEG("INIT")
+VOID
+HpetStartClock(VOID);
+
+VOID
+HpetRearmClock(VOID);
@@ -8,14 +8,55 @@
 /* INCLUDES ******************************************************************/
 
 #include <hal.h>
+#include <smp.h>
 #define NDEBUG
 #include <debug.h>
 
 KAFFINITY HalpActiveProcessors;
 KAFFINITY HalpDefaultInterruptAffinity;
+BOOLEAN HalpSkipIdleTicks;
+
+/*
+ * Idle state of each processor for skipping clock IPIs. The low bit is set
+ * while the processor is halted in HalProcessorIdle, the rest counts the
+ * ticks that were skipped since. Both change together with one interlocked
+ * operation, so a tick is either skipped while the processor is halted or
+ * delivered by IPI, never both or neither.
+ */
+#define IDLE_STATE_HALTED  1
+#define IDLE_STATE_TICK    2
+static LONG HalpIdleState[MAXIMUM_PROCESSORS];
 
 /* PRIVATE FUNCTIONS *********************************************************/
 
+/*!
+ *  \brief Skips the clock IPI for a processor if it is halted.
+ *
+ *  \param ProcessorIndex - Specifies the processor the clock IPI is meant for.
+ *
+ *  \return TRUE if the processor is halted in HalProcessorIdle. The tick
+ *          is counted for it, and charged to its idle thread when it wakes
+ *          up. FALSE if the clock IPI must be sent.
+ */
+BOOLEAN
+HalpSkipClockTickIfIdle(
+    _In_ ULONG ProcessorIndex)
+{
+    LONG State;
+
+    do
+    {
+        State = *(volatile LONG *)&HalpIdleState[ProcessorIndex];
+        if (!(State & IDLE_STATE_HALTED))
+            return FALSE;
+    }
+    while (InterlockedCompareExchange(&HalpIdleState[ProcessorIndex],
+                                      State + IDLE_STATE_TICK,
+                                      State) != State);
+
+    return TRUE;
+}
+
 VOID
 NTAPI
 HaliHaltSystem(VOID)
@@ -45,9 +86,29 @@ VOID
 NTAPI
 HalProcessorIdle(VOID)
 {
+    PKPRCB Prcb = KeGetCurrentPrcb();
+    LONG SkippedTicks;
+
+    /* Let the clock IPI skip this processor while it is halted */
+    if (HalpSkipIdleTicks)
+        InterlockedExchange(&HalpIdleState[Prcb->Number], IDLE_STATE_HALTED);
+
     /* Enable interrupts and halt the processor */
     _enable();
     __halt();
+
+    if (!HalpSkipIdleTicks)
+        return;
+
+    /* Charge the skipped ticks to the idle thread like KeUpdateRunTime does */
+    _disable();
+    SkippedTicks = InterlockedExchange(&HalpIdleState[Prcb->Number], 0) / IDLE_STATE_TICK;
+    if (SkippedTicks)
+    {
+        Prcb->KernelTime += SkippedTicks;
+        Prcb->IdleThread->KernelTime += SkippedTicks;
+    }
+    _enable();
 }
 
 /* EOF */
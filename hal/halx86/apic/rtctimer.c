@@ -13,13 +13,14 @@
 
 #include <hal.h>
 #include "apicp.h"
+#include "hpet.h"
 #include <smp.h>
 #define NDEBUG
 #include <debug.h>
 
 /* GLOBALS ********************************************************************/
 
-static const UCHAR RtcMinimumClockRate = 6;  /* Minimum rate  6: 1024 Hz / 0.97 ms */
+static const UCHAR RtcMinimumClockRate = 5;  /* Minimum rate  5: 2048 Hz / 0.49 ms */
 static const UCHAR RtcMaximumClockRate = 10; /* Maximum rate 10: 64 Hz / 15.6 ms */
 static UCHAR HalpCurrentClockRate = 10;  /* Initial rate  10: 64 Hz / 15.6 ms */
 static ULONG HalpCurrentTimeIncrement;
@@ -29,6 +30,8 @@ static ULONG HalpCurrentFractionalIncrement;
 static ULONG HalpRunningFraction;
 static BOOLEAN HalpSetClockRate;
 static UCHAR HalpNextClockRate;
+static BOOLEAN HalpHpetClock;
+static ULONG HalpNextIncrement;
 
 /*!
     \brief Converts the CMOS RTC rate into the time increment in 0.1ns intervals.
@@ -40,8 +43,8 @@ static UCHAR HalpNextClockRate;
      2   16384      0.06103            610,351
      3    8192      0.12207          1,220,703
      4    4096      0.24414          2,441,406
-     5    2048      0.48828          4,882,812
-     6    1024      0.97656          9,765,625 <- minimum
+     5    2048      0.48828          4,882,812 <- minimum
+     6    1024      0.97656          9,765,625
      7     512      1.95313         19,531,250
      8     256      3.90625         39,062,500
      9     128      7.8125          78,125,000
@@ -64,17 +67,22 @@ RtcClockRateToPreciseIncrement(UCHAR Rate)
     return 10000000000ULL / Frequency;
 }
 
+static
+VOID
+HalpSetCurrentIncrement(ULONG PreciseIncrement)
+{
+    HalpCurrentTimeIncrement = PreciseIncrement / 1000;
+    HalpCurrentFractionalIncrement = PreciseIncrement % 1000;
+}
+
 VOID
 RtcSetClockRate(UCHAR ClockRate)
 {
     UCHAR RegisterA;
-    ULONG PreciseIncrement;
 
     /* Update the global values */
     HalpCurrentClockRate = ClockRate;
-    PreciseIncrement = RtcClockRateToPreciseIncrement(ClockRate);
-    HalpCurrentTimeIncrement = PreciseIncrement / 1000;
-    HalpCurrentFractionalIncrement = PreciseIncrement % 1000;
+    HalpSetCurrentIncrement(RtcClockRateToPreciseIncrement(ClockRate));
 
     /* Acquire CMOS lock */
     HalpAcquireCmosSpinLock();
@@ -107,28 +115,43 @@ HalpInitializeClock(VOID)
     EFlags = __readeflags();
     _disable();
 
-    // TODO: disable NMI
+    /* The maximum increment is the same for both clocks */
+    HalpMaximumTimeIncrement = RtcClockRateToPreciseIncrement(RtcMaximumClockRate) / 1000;
 
-    /* Acquire CMOS lock */
-    HalpAcquireCmosSpinLock();
+    /* Check if the HPET can take over IRQ 8 */
+    if (HpetInitialize())
+    {
+        /* It can run at any increment, start at the maximum like the RTC */
+        HalpHpetClock = TRUE;
+        HalpMinimumTimeIncrement = HPET_MINIMUM_INCREMENT;
+        HpetSetClockIncrement(HalpMaximumTimeIncrement);
+        HalpSetCurrentIncrement(HpetGetPreciseIncrement(HalpMaximumTimeIncrement));
+        HpetStartClock();
+    }
+    else
+    {
+        // TODO: disable NMI
 
-    /* Enable the periodic interrupt in the CMOS */
-    RegisterB = HalpReadCmos(RTC_REGISTER_B);
-    HalpWriteCmos(RTC_REGISTER_B, RegisterB | RTC_REG_B_PI);
+        /* Acquire CMOS lock */
+        HalpAcquireCmosSpinLock();
 
-    /* Release CMOS lock */
-    HalpReleaseCmosSpinLock();
+        /* Enable the periodic interrupt in the CMOS */
+        RegisterB = HalpReadCmos(RTC_REGISTER_B);
+        HalpWriteCmos(RTC_REGISTER_B, RegisterB | RTC_REG_B_PI);
+
+        /* Release CMOS lock */
+        HalpReleaseCmosSpinLock();
 
-    /* Set initial rate */
-    RtcSetClockRate(HalpCurrentClockRate);
+        /* Set initial rate */
+        RtcSetClockRate(HalpCurrentClockRate);
+
+        /* Calculate the minimum increment */
+        HalpMinimumTimeIncrement = RtcClockRateToPreciseIncrement(RtcMinimumClockRate) / 1000;
+    }
 
     /* Restore interrupt state */
     __writeeflags(EFlags);
 
-    /* Calculate minumum and maximum increment */
-    HalpMinimumTimeIncrement = RtcClockRateToPreciseIncrement(RtcMinimumClockRate) / 1000;
-    HalpMaximumTimeIncrement = RtcClockRateToPreciseIncrement(RtcMaximumClockRate) / 1000;
-
     /* Notify the kernel about the maximum and minimum increment */
     KeSetTimeIncrement(HalpMaximumTimeIncrement, HalpMinimumTimeIncrement);
 
@@ -160,7 +183,7 @@ HalpClockInterruptHandler(IN PKTRAP_FRAME TrapFrame)
     }
 
     /* Read register C, so that the next interrupt can happen */
-    HalpReadCmos(RTC_REGISTER_C);
+    if (!HalpHpetClock) HalpReadCmos(RTC_REGISTER_C);
 
     /* Save increment */
     LastIncrement = HalpCurrentTimeIncrement;
@@ -177,13 +200,24 @@ HalpClockInterruptHandler(IN PKTRAP_FRAME TrapFrame)
     if (HalpSetClockRate)
     {
         /* Set new clock rate */
-        RtcSetClockRate(HalpNextClockRate);
+        if (HalpHpetClock)
+        {
+            HpetSetClockIncrement(HalpNextIncrement);
+            HalpSetCurrentIncrement(HpetGetPreciseIncrement(HalpNextIncrement));
+        }
+        else
+        {
+            RtcSetClockRate(HalpNextClockRate);
+        }
 
         /* We're done */
         HalpSetClockRate = FALSE;
     }
 
-    /* Send the clock IPI to all other CPUs */
+    /* The HPET is one-shot, arm it for the next tick */
+    if (HalpHpetClock) HpetRearmClock();
+
+    /* Send the clock IPI to the other CPUs that are not idle */
     HalpBroadcastClockIpi(CLOCK_IPI_VECTOR);
 
     /* Update the system time -- on x86 the kernel will exit this trap  */
@@ -224,6 +258,19 @@ HalSetTimeIncrement(IN ULONG Increment)
     UCHAR Rate;
     ULONG NextIncrement;
 
+    /* The HPET takes any increment within the limits */
+    if (HalpHpetClock)
+    {
+        NextIncrement = max(min(Increment, HalpMaximumTimeIncrement), HalpMinimumTimeIncrement);
+
+        /* Tell HAL we want to change it */
+        HalpNextIncrement = NextIncrement;
+        HalpSetClockRate = TRUE;
+
+        /* Return the real increment */
+        return HpetGetPreciseIncrement(NextIncrement) / 1000;
+    }
+
     /* Lookup largest value below given Increment */
     for (Rate = RtcMinimumClockRate; Rate < RtcMaximumClockRate; Rate++)
     {
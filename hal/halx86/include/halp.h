@@ -464,6 +464,13 @@ HalpGetDebugPortTable(
     VOID
 );
 
+CODE_SEG("INIT")
+BOOLEAN
+NTAPI
+HalpGetHpetTable(
+    OUT PPHYSICAL_ADDRESS BaseAddress
+);
+
 CODE_SEG("INIT")
 VOID
 NTAPI
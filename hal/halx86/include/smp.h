@@ -47,6 +47,14 @@ FASTCALL
 HalpBroadcastClockIpi(
     _In_ UCHAR Vector);
 
+/* APIC specific functions inside apic/processor.c */
+
+extern BOOLEAN HalpSkipIdleTicks;
+
+BOOLEAN
+HalpSkipClockTickIfIdle(
+    _In_ ULONG ProcessorIndex);
+
 /* APIC specific functions inside apic/apicsmp.c */
 
 VOID
@@ -59,6 +59,15 @@ HalpGetDebugPortTable(VOID)
     return FALSE;
 }
 
+CODE_SEG("INIT")
+BOOLEAN
+NTAPI
+HalpGetHpetTable(OUT PPHYSICAL_ADDRESS BaseAddress)
+{
+    /* No ACPI, so no HPET either */
+    return FALSE;
+}
+
 CODE_SEG("INIT")
 ULONG
 NTAPI
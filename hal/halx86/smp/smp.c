@@ -39,6 +39,43 @@ FASTCALL
 HalpBroadcastClockIpi(
     _In_ UCHAR Vector)
 {
-    /* Send a clock IPI to all processors */
-    HalpBroadcastIpiSpecifyVector(Vector, FALSE);
+    KAFFINITY TargetSet, RemainingSet;
+    ULONG ProcessorIndex;
+    PKPRCB Prcb;
+
+    if (!HalpSkipIdleTicks)
+    {
+        /* Send a clock IPI to all processors */
+        HalpBroadcastIpiSpecifyVector(Vector, FALSE);
+        return;
+    }
+
+    TargetSet = HalpActiveProcessors & ~KeGetCurrentPrcb()->SetMember;
+    RemainingSet = TargetSet;
+    while (RemainingSet != 0)
+    {
+        NT_VERIFY(BitScanForwardAffinity(&ProcessorIndex, RemainingSet) != 0);
+        RemainingSet &= ~AFFINITY_MASK(ProcessorIndex);
+
+        /*
+         * The idle loop only looks for queued work when an interrupt wakes it
+         * up, and DPCs queued to an idle processor don't always come with an
+         * IPI. Keep ticking the processors that have work queued.
+         */
+        Prcb = HalpProcessorIdentity[ProcessorIndex].ProcessorPrcb;
+        if ((Prcb->DpcData[DPC_NORMAL].DpcQueueDepth) ||
+            (Prcb->NextThread) ||
+            (Prcb->DeferredReadyListHead.Next))
+        {
+            continue;
+        }
+
+        /* Halted processors are left alone, they catch up when they wake up */
+        if (HalpSkipClockTickIfIdle(ProcessorIndex))
+            TargetSet &= ~AFFINITY_MASK(ProcessorIndex);
+    }
+
+    /* Send a clock IPI to the other processors */
+    if (TargetSet != 0)
+        HalRequestIpiSpecifyVector(TargetSet, Vector);
 }
@@ -0,0 +1,222 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Test and benchmark for memcpy, memmove, memset, memcmp and memchr
+ */
+
+#include <apitest.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define BUFFER_SIZE 12288
+#define MAX_ALIGN 16
+
+static const size_t TestSizes[] =
+{
+    0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 47, 48, 63, 64, 65,
+    100, 127, 128, 129, 255, 256, 257, 1000, 2047, 2048, 2049, 4096, 4099
+};
+
+static const size_t BenchSizes[] = { 8, 16, 32, 64, 256, 1024, 4096, 8192 };
+
+static unsigned char Pattern[BUFFER_SIZE];
+static unsigned char Buffer[BUFFER_SIZE];
+static unsigned char Expected[BUFFER_SIZE];
+
+/* Byte by byte reference implementations */
+static
+void
+RefMove(unsigned char *Dest, const unsigned char *Src, size_t Count)
+{
+    size_t i;
+
+    if (Dest < Src)
+    {
+        for (i = 0; i < Count; i++)
+            Dest[i] = Src[i];
+    }
+    else
+    {
+        for (i = Count; i > 0; i--)
+            Dest[i - 1] = Src[i - 1];
+    }
+}
+
+static
+void
+RefSet(unsigned char *Dest, int Value, size_t Count)
+{
+    size_t i;
+
+    for (i = 0; i < Count; i++)
+        Dest[i] = (unsigned char)Value;
+}
+
+static
+int
+Sign(int Value)
+{
+    return (Value > 0) - (Value < 0);
+}
+
+static
+int
+Compare(const unsigned char *Buf1, const unsigned char *Buf2, size_t Count)
+{
+    size_t i;
+
+    for (i = 0; i < Count; i++)
+    {
+        if (Buf1[i] != Buf2[i])
+            return Buf1[i] - Buf2[i];
+    }
+
+    return 0;
+}
+
+static
+void
+Reset(void)
+{
+    RefMove(Buffer, Pattern, BUFFER_SIZE);
+    RefMove(Expected, Pattern, BUFFER_SIZE);
+}
+
+static
+void
+Test_Matrix(void)
+{
+    unsigned char *Result;
+    size_t i, Size, DestAlign, SrcAlign, Pos;
+    int Offset;
+
+    for (i = 0; i < sizeof(Pattern); i++)
+        Pattern[i] = (unsigned char)(i * 7 + (i >> 8));
+
+    for (i = 0; i < _countof(TestSizes); i++)
+    {
+        Size = TestSizes[i];
+
+        for (DestAlign = 0; DestAlign < MAX_ALIGN; DestAlign++)
+        {
+            for (SrcAlign = 0; SrcAlign < MAX_ALIGN; SrcAlign++)
+            {
+                /* Disjoint copy */
+                Reset();
+                Result = memcpy(Buffer + 64 + DestAlign, Buffer + 6144 + SrcAlign, Size);
+                RefMove(Expected + 64 + DestAlign, Expected + 6144 + SrcAlign, Size);
+                ok(Result == Buffer + 64 + DestAlign, "memcpy returned %p\n", Result);
+                ok(Compare(Buffer, Expected, BUFFER_SIZE) == 0,
+                   "memcpy size %Iu, alignment %Iu/%Iu failed\n", Size, DestAlign, SrcAlign);
+
+                /* Overlapping moves in both directions */
+                for (Offset = -40; Offset <= 40; Offset += 5)
+                {
+                    Reset();
+                    Result = memmove(Buffer + 512 + Offset + DestAlign, Buffer + 512 + SrcAlign, Size);
+                    RefMove(Expected + 512 + Offset + DestAlign, Expected + 512 + SrcAlign, Size);
+                    ok(Result == Buffer + 512 + Offset + DestAlign, "memmove returned %p\n", Result);
+                    ok(Compare(Buffer, Expected, BUFFER_SIZE) == 0,
+                       "memmove size %Iu, alignment %Iu/%Iu, offset %d failed\n", Size, DestAlign, SrcAlign, Offset);
+                }
+            }
+
+            Reset();
+            Result = memset(Buffer + 64 + DestAlign, 0x1A5, Size);
+            RefSet(Expected + 64 + DestAlign, 0x1A5, Size);
+            ok(Result == Buffer + 64 + DestAlign, "memset returned %p\n", Result);
+            ok(Compare(Buffer, Expected, BUFFER_SIZE) == 0,
+               "memset size %Iu, alignment %Iu failed\n", Size, DestAlign);
+
+            /* Make the buffers differ in the last byte */
+            Reset();
+            ok_int(memcmp(Buffer + DestAlign, Expected + DestAlign, Size), 0);
+            if (Size != 0)
+            {
+                Pos = DestAlign + Size - 1;
+                Buffer[Pos] ^= 0x80;
+                ok_int(Sign(memcmp(Buffer + DestAlign, Expected + DestAlign, Size)),
+                       Sign(Compare(Buffer + DestAlign, Expected + DestAlign, Size)));
+                ok_int(Sign(memcmp(Expected + DestAlign, Buffer + DestAlign, Size)),
+                       Sign(Compare(Expected + DestAlign, Buffer + DestAlign, Size)));
+
+                /* Search for a byte that only exists at the end */
+                RefSet(Buffer + DestAlign, 0x11, Size - 1);
+                Buffer[Pos] = 0xEE;
+                ok(memchr(Buffer + DestAlign, 0xEE, Size) == Buffer + Pos,
+                   "memchr size %Iu, alignment %Iu failed\n", Size, DestAlign);
+                ok(memchr(Buffer + DestAlign, 0x1EE, Size) == Buffer + Pos,
+                   "memchr did not truncate the value to a byte\n");
+                ok(memchr(Buffer + DestAlign, 0xEE, Size - 1) == NULL,
+                   "memchr found a byte past the end\n");
+            }
+        }
+    }
+}
+
+static
+void
+Test_Benchmark(void)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    size_t i, Align, Round, Rounds;
+    unsigned char *Result = NULL;
+    int Difference = 0;
+
+    QueryPerformanceFrequency(&Frequency);
+
+    for (i = 0; i < _countof(BenchSizes); i++)
+    {
+        Rounds = (1024 * 1024) / BenchSizes[i];
+
+        for (Align = 0; Align < MAX_ALIGN; Align += 3)
+        {
+            QueryPerformanceCounter(&Start);
+            for (Round = 0; Round < Rounds; Round++)
+                Result = memcpy(Buffer + Align, Pattern + 1, BenchSizes[i]);
+            QueryPerformanceCounter(&End);
+            trace("memcpy  %5Iu bytes, alignment %2Iu: %6I64u ns/call\n", BenchSizes[i], Align,
+                  (End.QuadPart - Start.QuadPart) * 1000000000 / Frequency.QuadPart / Rounds);
+
+            QueryPerformanceCounter(&Start);
+            for (Round = 0; Round < Rounds; Round++)
+                Result = memmove(Buffer + Align + 1, Buffer + Align, BenchSizes[i]);
+            QueryPerformanceCounter(&End);
+            trace("memmove %5Iu bytes, alignment %2Iu: %6I64u ns/call\n", BenchSizes[i], Align,
+                  (End.QuadPart - Start.QuadPart) * 1000000000 / Frequency.QuadPart / Rounds);
+
+            QueryPerformanceCounter(&Start);
+            for (Round = 0; Round < Rounds; Round++)
+                Result = memset(Buffer + Align, (int)Round, BenchSizes[i]);
+            QueryPerformanceCounter(&End);
+            trace("memset  %5Iu bytes, alignment %2Iu: %6I64u ns/call\n", BenchSizes[i], Align,
+                  (End.QuadPart - Start.QuadPart) * 1000000000 / Frequency.QuadPart / Rounds);
+        }
+
+        RefMove(Buffer, Pattern, BUFFER_SIZE);
+        QueryPerformanceCounter(&Start);
+        for (Round = 0; Round < Rounds; Round++)
+            Difference += memcmp(Buffer, Pattern, BenchSizes[i]);
+        QueryPerformanceCounter(&End);
+        trace("memcmp  %5Iu bytes: %6I64u ns/call\n", BenchSizes[i],
+              (End.QuadPart - Start.QuadPart) * 1000000000 / Frequency.QuadPart / Rounds);
+
+        RefSet(Buffer, 0, BenchSizes[i]);
+        QueryPerformanceCounter(&Start);
+        for (Round = 0; Round < Rounds; Round++)
+            Result = memchr(Buffer, 1, BenchSizes[i]);
+        QueryPerformanceCounter(&End);
+        trace("memchr  %5Iu bytes: %6I64u ns/call\n", BenchSizes[i],
+              (End.QuadPart - Start.QuadPart) * 1000000000 / Frequency.QuadPart / Rounds);
+    }
+
+    ok_int(Difference, 0);
+    (void)Result;
+}
+
+START_TEST(memfuncs)
+{
+    Test_Matrix();
+    Test_Benchmark();
+}
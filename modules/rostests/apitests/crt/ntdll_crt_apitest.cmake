@@ -73,6 +73,7 @@ list(APPEND SOURCE_NTDLL
 #    log.c
     mbstowcs.c
     mbtowc.c
+    memfuncs.c
 #    memchr.c
 #    memcmp.c
     # memcpy == memmove
@@ -0,0 +1,305 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Test and benchmark for the cryptlib AES modes
+ */
+
+#include <apitest.h>
+
+#include <tomcrypt.h>
+#include <cryptcpu.h>
+
+#define BENCH_SIZE (1024 * 1024)
+#define BENCH_ROUNDS 16
+
+/* NIST SP 800-38A, F.2.1 and F.5.1 */
+static const char Sp800Key[] = "2b7e151628aed2a6abf7158809cf4f3c";
+static const char Sp800Plain[] =
+    "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+    "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710";
+static const char Sp800CbcIv[] = "000102030405060708090a0b0c0d0e0f";
+static const char Sp800CbcCipher[] =
+    "7649abac8119b246cee98e9b12e9197d5086cb9b507219ee95db113a917678b2"
+    "73bed6b8e3c1743b7116e69e222295163ff1caa1681fac09120eca307586e1a7";
+static const char Sp800CtrIv[] = "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+static const char Sp800CtrCipher[] =
+    "874d6191b620e3261bef6864990db6ce9806f66b7970fdff8617187bb9fffdff"
+    "5ae4df3edbd5d35e5b4f09020db03eab1e031dda2fbe03d1792170a0f3009cee";
+
+/* The GCM specification, test cases 3, 4 and 6 */
+static const char GcmKey[] = "feffe9928665731c6d6a8f9467308308";
+static const char GcmPlain[] =
+    "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+    "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255";
+static const char GcmIv[] = "cafebabefacedbaddecaf888";
+static const char GcmLongIv[] =
+    "9313225df88406e555909c5aff5269aa6a7a9538534f7da1e4c303d2a318a728"
+    "c3c0c95156809539fcf0e2429a6b525416aedbf5a0de6a57a637b39b";
+static const char GcmAad[] = "feedfacedeadbeeffeedfacedeadbeefabaddad2";
+static const char GcmCipher3[] =
+    "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+    "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091473f5985";
+static const char GcmTag3[] = "4d5c2af327cd64a62cf35abd2ba6fab4";
+static const char GcmTag4[] = "5bc94fbc3221a5db94fae95ae7121a47";
+static const char GcmCipher6[] =
+    "8ce24998625615b603a033aca13fb894be9112a5c3a211a8ba262a3cca7e2ca7"
+    "01e4a9a4fba43c90ccdcb281d48c7c6fd62875d2aca417034c34aee5";
+static const char GcmTag6[] = "619cc5aefffe0bfa462af43c1699d050";
+
+static
+ULONG
+HexToBytes(const char *Hex, PUCHAR Bytes)
+{
+    ULONG Length = 0;
+    UINT Byte;
+
+    while (Hex[0] && Hex[1])
+    {
+        sscanf(Hex, "%2x", &Byte);
+        Bytes[Length++] = (UCHAR)Byte;
+        Hex += 2;
+    }
+    return Length;
+}
+
+static
+BOOLEAN
+EqualHex(const UCHAR *Bytes, const char *Hex)
+{
+    UCHAR Expected[64];
+    ULONG Length;
+
+    Length = HexToBytes(Hex, Expected);
+    return RtlEqualMemory(Bytes, Expected, Length);
+}
+
+static
+VOID
+Test_Sp800(VOID)
+{
+    UCHAR Key[16], Iv[16], Plain[64], Cipher[64], Output[64];
+    aes_key Schedule;
+
+    HexToBytes(Sp800Key, Key);
+    HexToBytes(Sp800Plain, Plain);
+    ok_int(aes_setup(Key, sizeof(Key), 0, &Schedule), CRYPT_OK);
+
+    HexToBytes(Sp800CbcIv, Iv);
+    ok_int(aes_cbc_encrypt(Plain, Cipher, sizeof(Plain), Iv, &Schedule), CRYPT_OK);
+    ok(EqualHex(Cipher, Sp800CbcCipher), "CBC encryption mismatch\n");
+    ok(RtlEqualMemory(Iv, Cipher + 48, 16), "CBC did not chain the IV\n");
+
+    /* Decrypt in two calls, in place */
+    HexToBytes(Sp800CbcIv, Iv);
+    RtlCopyMemory(Output, Cipher, sizeof(Output));
+    ok_int(aes_cbc_decrypt(Output, Output, 16, Iv, &Schedule), CRYPT_OK);
+    ok_int(aes_cbc_decrypt(Output + 16, Output + 16, 48, Iv, &Schedule), CRYPT_OK);
+    ok(RtlEqualMemory(Output, Plain, sizeof(Plain)), "CBC decryption mismatch\n");
+    ok_int(aes_cbc_encrypt(Plain, Cipher, 15, Iv, &Schedule), CRYPT_INVALID_ARG);
+
+    HexToBytes(Sp800CtrIv, Iv);
+    ok_int(aes_ctr_crypt(Plain, Cipher, sizeof(Plain), Iv, &Schedule), CRYPT_OK);
+    ok(EqualHex(Cipher, Sp800CtrCipher), "CTR mismatch\n");
+}
+
+static
+VOID
+Test_Gcm(VOID)
+{
+    UCHAR Key[16], Iv[60], Aad[20], Plain[64], Cipher[64], Output[64], Tag[16];
+    ULONG IvLength;
+    aes_key Schedule;
+    gcm_state Gcm;
+
+    HexToBytes(GcmKey, Key);
+    HexToBytes(GcmPlain, Plain);
+    HexToBytes(GcmAad, Aad);
+    ok_int(aes_setup(Key, sizeof(Key), 0, &Schedule), CRYPT_OK);
+
+    /* Whole blocks, no AAD */
+    IvLength = HexToBytes(GcmIv, Iv);
+    ok_int(gcm_init(&Gcm, &Schedule, Iv, IvLength), CRYPT_OK);
+    ok_int(gcm_process(&Gcm, Plain, Cipher, 64, GCM_ENCRYPT), CRYPT_OK);
+    ok_int(gcm_done(&Gcm, Tag, sizeof(Tag)), CRYPT_OK);
+    ok(EqualHex(Cipher, GcmCipher3), "GCM test case 3 ciphertext mismatch\n");
+    ok(EqualHex(Tag, GcmTag3), "GCM test case 3 tag mismatch\n");
+
+    /* AAD and a partial block, fed in uneven pieces */
+    ok_int(gcm_init(&Gcm, &Schedule, Iv, IvLength), CRYPT_OK);
+    ok_int(gcm_add_aad(&Gcm, Aad, 7), CRYPT_OK);
+    ok_int(gcm_add_aad(&Gcm, Aad + 7, 13), CRYPT_OK);
+    ok_int(gcm_process(&Gcm, Plain, Cipher, 7, GCM_ENCRYPT), CRYPT_OK);
+    ok_int(gcm_process(&Gcm, Plain + 7, Cipher + 7, 53, GCM_ENCRYPT), CRYPT_OK);
+    ok_int(gcm_add_aad(&Gcm, Aad, 1), CRYPT_ERROR);
+    ok_int(gcm_done(&Gcm, Tag, sizeof(Tag)), CRYPT_OK);
+    ok(EqualHex(Cipher, GcmCipher3), "GCM test case 4 ciphertext mismatch\n");
+    ok(EqualHex(Tag, GcmTag4), "GCM test case 4 tag mismatch\n");
+
+    ok_int(gcm_init(&Gcm, &Schedule, Iv, IvLength), CRYPT_OK);
+    ok_int(gcm_add_aad(&Gcm, Aad, sizeof(Aad)), CRYPT_OK);
+    ok_int(gcm_process(&Gcm, Cipher, Output, 60, GCM_DECRYPT), CRYPT_OK);
+    ok_int(gcm_done(&Gcm, Tag, sizeof(Tag)), CRYPT_OK);
+    ok(RtlEqualMemory(Output, Plain, 60), "GCM test case 4 decryption mismatch\n");
+    ok(EqualHex(Tag, GcmTag4), "GCM test case 4 decryption tag mismatch\n");
+
+    /* An IV that is not 96 bits long gets hashed */
+    IvLength = HexToBytes(GcmLongIv, Iv);
+    ok_int(gcm_init(&Gcm, &Schedule, Iv, IvLength), CRYPT_OK);
+    ok_int(gcm_add_aad(&Gcm, Aad, sizeof(Aad)), CRYPT_OK);
+    ok_int(gcm_process(&Gcm, Plain, Cipher, 60, GCM_ENCRYPT), CRYPT_OK);
+    ok_int(gcm_done(&Gcm, Tag, sizeof(Tag)), CRYPT_OK);
+    ok(EqualHex(Cipher, GcmCipher6), "GCM test case 6 ciphertext mismatch\n");
+    ok(EqualHex(Tag, GcmTag6), "GCM test case 6 tag mismatch\n");
+}
+
+/* The SIMD and the portable code must agree, also where counters carry */
+static
+VOID
+Test_Dispatch(ULONG32 Features)
+{
+    UCHAR Key[32], Iv[16], Data[1000], Simd[1000], Portable[1000], SimdTag[16], PortableTag[16];
+    ULONG Round, Length, i;
+    aes_key Schedule;
+    gcm_state Gcm;
+
+    srand(2);
+    for (Round = 0; Round < 30; Round++)
+    {
+        for (i = 0; i < sizeof(Key); i++)
+            Key[i] = (UCHAR)rand();
+        for (i = 0; i < sizeof(Data); i++)
+            Data[i] = (UCHAR)rand();
+        Length = rand() % sizeof(Data);
+        aes_setup(Key, 16 + 8 * (Round % 3), 0, &Schedule);
+
+        RtlFillMemory(Iv, sizeof(Iv), 0xFF);
+        Iv[0] = (UCHAR)Round;
+        CryptCpuFeatures = 0;
+        aes_cbc_encrypt(Data, Portable, Length & ~15, Iv, &Schedule);
+        RtlFillMemory(Iv, sizeof(Iv), 0xFF);
+        Iv[0] = (UCHAR)Round;
+        CryptCpuFeatures = Features;
+        aes_cbc_encrypt(Data, Simd, Length & ~15, Iv, &Schedule);
+        ok(RtlEqualMemory(Simd, Portable, Length & ~15), "CBC differs in round %lu\n", Round);
+
+        RtlFillMemory(Iv, sizeof(Iv), 0xFF);
+        CryptCpuFeatures = 0;
+        aes_cbc_decrypt(Data, Portable, Length & ~15, Iv, &Schedule);
+        RtlFillMemory(Iv, sizeof(Iv), 0xFF);
+        CryptCpuFeatures = Features;
+        aes_cbc_decrypt(Data, Simd, Length & ~15, Iv, &Schedule);
+        ok(RtlEqualMemory(Simd, Portable, Length & ~15), "CBC decryption differs in round %lu\n", Round);
+
+        /* The low 64 bits of the counter wrap after the first block */
+        RtlFillMemory(Iv, sizeof(Iv), 0xFF);
+        Iv[0] = (UCHAR)Round;
+        CryptCpuFeatures = 0;
+        aes_ctr_crypt(Data, Portable, Length, Iv, &Schedule);
+        RtlFillMemory(Iv, sizeof(Iv), 0xFF);
+        Iv[0] = (UCHAR)Round;
+        CryptCpuFeatures = Features;
+        aes_ctr_crypt(Data, Simd, Length, Iv, &Schedule);
+        ok(RtlEqualMemory(Simd, Portable, Length), "CTR differs in round %lu\n", Round);
+
+        CryptCpuFeatures = 0;
+        gcm_init(&Gcm, &Schedule, Key, 12);
+        gcm_add_aad(&Gcm, Data, Round);
+        gcm_process(&Gcm, Data, Portable, Length, GCM_ENCRYPT);
+        gcm_done(&Gcm, PortableTag, sizeof(PortableTag));
+        CryptCpuFeatures = Features;
+        gcm_init(&Gcm, &Schedule, Key, 12);
+        gcm_add_aad(&Gcm, Data, Round);
+        gcm_process(&Gcm, Data, Simd, Length / 3, GCM_ENCRYPT);
+        gcm_process(&Gcm, Data + Length / 3, Simd + Length / 3, Length - Length / 3, GCM_ENCRYPT);
+        gcm_done(&Gcm, SimdTag, sizeof(SimdTag));
+        ok(RtlEqualMemory(Simd, Portable, Length), "GCM differs in round %lu\n", Round);
+        ok(RtlEqualMemory(SimdTag, PortableTag, sizeof(SimdTag)), "GCM tag differs in round %lu\n", Round);
+    }
+    CryptCpuFeatures = Features;
+}
+
+static
+ULONGLONG
+Rate(LARGE_INTEGER Frequency, LARGE_INTEGER Start, LARGE_INTEGER End)
+{
+    if (End.QuadPart <= Start.QuadPart)
+        return 0;
+    return BENCH_ROUNDS * Frequency.QuadPart / (End.QuadPart - Start.QuadPart);
+}
+
+static
+VOID
+Test_Benchmark(ULONG32 Features)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    UCHAR Key[16] = { 0 }, Iv[16] = { 0 }, Tag[16];
+    ULONGLONG Cbc, CbcDecrypt, Ctr, Gcm;
+    PUCHAR Data;
+    aes_key Schedule;
+    gcm_state State;
+    ULONG Round;
+
+    Data = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, BENCH_SIZE);
+    if (!Data)
+    {
+        skip("No memory for the benchmark\n");
+        return;
+    }
+
+    QueryPerformanceFrequency(&Frequency);
+    CryptCpuFeatures = Features;
+    aes_setup(Key, sizeof(Key), 0, &Schedule);
+
+    QueryPerformanceCounter(&Start);
+    for (Round = 0; Round < BENCH_ROUNDS; Round++)
+        aes_cbc_encrypt(Data, Data, BENCH_SIZE, Iv, &Schedule);
+    QueryPerformanceCounter(&End);
+    Cbc = Rate(Frequency, Start, End);
+
+    QueryPerformanceCounter(&Start);
+    for (Round = 0; Round < BENCH_ROUNDS; Round++)
+        aes_cbc_decrypt(Data, Data, BENCH_SIZE, Iv, &Schedule);
+    QueryPerformanceCounter(&End);
+    CbcDecrypt = Rate(Frequency, Start, End);
+
+    QueryPerformanceCounter(&Start);
+    for (Round = 0; Round < BENCH_ROUNDS; Round++)
+        aes_ctr_crypt(Data, Data, BENCH_SIZE, Iv, &Schedule);
+    QueryPerformanceCounter(&End);
+    Ctr = Rate(Frequency, Start, End);
+
+    QueryPerformanceCounter(&Start);
+    for (Round = 0; Round < BENCH_ROUNDS; Round++)
+    {
+        gcm_init(&State, &Schedule, Iv, 12);
+        gcm_process(&State, Data, Data, BENCH_SIZE, GCM_ENCRYPT);
+        gcm_done(&State, Tag, sizeof(Tag));
+    }
+    QueryPerformanceCounter(&End);
+    Gcm = Rate(Frequency, Start, End);
+
+    trace("AES-128 %s: CBC %I64u MB/s, CBC decryption %I64u MB/s, CTR %I64u MB/s, GCM %I64u MB/s\n",
+          Features ? "with CPU features" : "portable", Cbc, CbcDecrypt, Ctr, Gcm);
+
+    HeapFree(GetProcessHeap(), 0, Data);
+}
+
+START_TEST(Aes)
+{
+    ULONG32 Features;
+
+    Features = CryptInitCpuFeatures();
+
+    CryptCpuFeatures = 0;
+    Test_Sp800();
+    Test_Gcm();
+    CryptCpuFeatures = Features;
+    Test_Sp800();
+    Test_Gcm();
+
+    if (!(Features & CRYPT_CPU_AESNI))
+        skip("No AES-NI, the SIMD paths are not tested\n");
+    Test_Dispatch(Features);
+    Test_Benchmark(0);
+    Test_Benchmark(Features);
+}
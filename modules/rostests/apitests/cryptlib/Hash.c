@@ -0,0 +1,213 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Test and benchmark for the cryptlib hashes and HMAC
+ */
+
+#include <apitest.h>
+
+#include <hmac.h>
+#include <cryptcpu.h>
+
+#define BENCH_SIZE (1024 * 1024)
+#define BENCH_ROUNDS 16
+
+typedef struct _HASH_VECTOR
+{
+    int Algorithm;
+    const char *Key;
+    ULONG KeyRepeat;
+    const char *Data;
+    ULONG DataRepeat;
+    const char *Digest;
+} HASH_VECTOR;
+
+/* FIPS 180-4 examples, RFC 2202 and RFC 4231. A repeated key or message
+ * byte is written once with its count. */
+static const HASH_VECTOR HashVectors[] =
+{
+    { HASH_ALG_MD5, NULL, 0, "abc", 1, "900150983cd24fb0d6963f7d28e17f72" },
+    { HASH_ALG_SHA1, NULL, 0, "abc", 1, "a9993e364706816aba3e25717850c26c9cd0d89d" },
+    { HASH_ALG_SHA1, NULL, 0, "a", 1000000, "34aa973cd4c4daa4f61eeb2bdbad27316534016f" },
+    { HASH_ALG_SHA256, NULL, 0, "abc", 1,
+      "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    { HASH_ALG_SHA256, NULL, 0, "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    { HASH_ALG_SHA256, NULL, 0, "a", 1000000,
+      "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+    { HASH_ALG_SHA384, NULL, 0, "abc", 1,
+      "cb00753f45a35e8bb5a03d699ac65007272c32ab0eded1631a8b605a43ff5bed"
+      "8086072ba1e7cc2358baeca134c825a7" },
+    { HASH_ALG_SHA512, NULL, 0, "abc", 1,
+      "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+      "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f" },
+    { HASH_ALG_MD5, "\x0b", 16, "Hi There", 1, "9294727a3638bb1c13f48ef8158bfc9d" },
+    { HASH_ALG_SHA1, "\x0b", 20, "Hi There", 1, "b617318655057264e28bc0b6fb378c8ef146be00" },
+    { HASH_ALG_SHA256, "\x0b", 20, "Hi There", 1,
+      "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7" },
+    { HASH_ALG_SHA512, "\x0b", 20, "Hi There", 1,
+      "87aa7cdea5ef619d4ff0b4241a1d6cb02379f4e2ce4ec2787ad0b30545e17cde"
+      "daa833b7d6b8a702038b274eaea3f4e4be9d914eeb61f1702e696c203a126854" },
+    { HASH_ALG_SHA256, "\xaa", 131, "Test Using Larger Than Block-Size Key - Hash Key First", 1,
+      "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54" },
+    { HASH_ALG_SHA384, "\xaa", 131, "Test Using Larger Than Block-Size Key - Hash Key First", 1,
+      "4ece084485813e9088d2c63a041bc5b44f9ef1012a2b588f3cd11f05033ac4c6"
+      "0c2ef6ab4030fe8296248df163f44952" },
+};
+
+static const char *AlgorithmNames[] = { "MD5", "SHA1", "SHA256", "SHA384", "SHA512" };
+
+static
+VOID
+HexToBytes(const char *Hex, PUCHAR Bytes)
+{
+    UINT Byte;
+
+    while (Hex[0] && Hex[1])
+    {
+        sscanf(Hex, "%2x", &Byte);
+        *Bytes++ = (UCHAR)Byte;
+        Hex += 2;
+    }
+}
+
+static
+VOID
+Test_Vectors(VOID)
+{
+    const HASH_VECTOR *Vector;
+    UCHAR Key[256], Expected[HASH_MAX_DIGEST_LENGTH], Digest[HASH_MAX_DIGEST_LENGTH + 1];
+    HASH_CTX Hash;
+    HMAC_CTX Hmac;
+    SIZE_T Length;
+    ULONG i, j;
+
+    for (i = 0; i < sizeof(HashVectors) / sizeof(HashVectors[0]); i++)
+    {
+        Vector = &HashVectors[i];
+        Length = HASH_DigestLength(Vector->Algorithm);
+        HexToBytes(Vector->Digest, Expected);
+        RtlFillMemory(Digest, sizeof(Digest), 0xCC);
+
+        if (Vector->Key)
+        {
+            RtlFillMemory(Key, Vector->KeyRepeat, (UCHAR)Vector->Key[0]);
+            ok(HMAC_Init(&Hmac, Vector->Algorithm, Key, Vector->KeyRepeat), "HMAC_Init failed\n");
+            for (j = 0; j < Vector->DataRepeat; j++)
+                HMAC_Update(&Hmac, (const unsigned char *)Vector->Data, strlen(Vector->Data));
+            HMAC_Final(Digest, &Hmac);
+        }
+        else
+        {
+            ok(HASH_Init(&Hash, Vector->Algorithm), "HASH_Init failed\n");
+            for (j = 0; j < Vector->DataRepeat; j++)
+                HASH_Update(&Hash, (const unsigned char *)Vector->Data, strlen(Vector->Data));
+            HASH_Final(Digest, &Hash);
+        }
+
+        ok(RtlEqualMemory(Digest, Expected, Length), "Vector %lu (%s%s) mismatch\n",
+           i, Vector->Key ? "HMAC-" : "", AlgorithmNames[Vector->Algorithm]);
+        ok(Digest[Length] == 0xCC, "Vector %lu wrote past the digest\n", i);
+    }
+
+    ok(!HASH_Init(&Hash, 5), "HASH_Init accepted an unknown algorithm\n");
+    ok_int((int)HASH_DigestLength(5), 0);
+}
+
+/* Random data in random pieces must hash the same on every code path */
+static
+VOID
+Test_Dispatch(ULONG32 Features)
+{
+    UCHAR Data[3000], Simd[HASH_MAX_DIGEST_LENGTH], Portable[HASH_MAX_DIGEST_LENGTH];
+    HASH_CTX Hash;
+    ULONG Round, Offset, Piece, i;
+    int Algorithm;
+
+    srand(1);
+    for (Round = 0; Round < 50; Round++)
+    {
+        for (i = 0; i < sizeof(Data); i++)
+            Data[i] = (UCHAR)rand();
+
+        for (Algorithm = HASH_ALG_SHA1; Algorithm <= HASH_ALG_SHA512; Algorithm++)
+        {
+            CryptCpuFeatures = 0;
+            HASH_Init(&Hash, Algorithm);
+            HASH_Update(&Hash, Data, Round * 59);
+            HASH_Final(Portable, &Hash);
+
+            CryptCpuFeatures = Features;
+            HASH_Init(&Hash, Algorithm);
+            for (Offset = 0; Offset < Round * 59; Offset += Piece)
+            {
+                Piece = rand() % 200;
+                Piece = min(Piece, Round * 59 - Offset);
+                HASH_Update(&Hash, Data + Offset, Piece);
+            }
+            HASH_Final(Simd, &Hash);
+
+            ok(RtlEqualMemory(Simd, Portable, HASH_DigestLength(Algorithm)),
+               "%s differs for %lu bytes\n", AlgorithmNames[Algorithm], Round * 59);
+        }
+    }
+    CryptCpuFeatures = Features;
+}
+
+static
+VOID
+Test_Benchmark(ULONG32 Features)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    UCHAR Digest[HASH_MAX_DIGEST_LENGTH];
+    PUCHAR Data;
+    HASH_CTX Hash;
+    ULONG Round;
+    int Algorithm;
+
+    Data = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, BENCH_SIZE);
+    if (!Data)
+    {
+        skip("No memory for the benchmark\n");
+        return;
+    }
+
+    QueryPerformanceFrequency(&Frequency);
+    CryptCpuFeatures = Features;
+
+    for (Algorithm = HASH_ALG_MD5; Algorithm <= HASH_ALG_SHA512; Algorithm++)
+    {
+        QueryPerformanceCounter(&Start);
+        for (Round = 0; Round < BENCH_ROUNDS; Round++)
+        {
+            HASH_Init(&Hash, Algorithm);
+            HASH_Update(&Hash, Data, BENCH_SIZE);
+            HASH_Final(Digest, &Hash);
+        }
+        QueryPerformanceCounter(&End);
+
+        trace("%s %s: %I64u MB/s\n", AlgorithmNames[Algorithm],
+              Features ? "with CPU features" : "portable",
+              End.QuadPart > Start.QuadPart ?
+                  BENCH_ROUNDS * Frequency.QuadPart / (End.QuadPart - Start.QuadPart) : 0);
+    }
+
+    HeapFree(GetProcessHeap(), 0, Data);
+}
+
+START_TEST(Hash)
+{
+    ULONG32 Features;
+
+    Features = CryptInitCpuFeatures();
+    trace("CPU features 0x%lx\n", (ULONG)Features);
+
+    CryptCpuFeatures = 0;
+    Test_Vectors();
+    CryptCpuFeatures = Features;
+    Test_Vectors();
+
+    Test_Dispatch(Features);
+    Test_Benchmark(0);
+    Test_Benchmark(Features);
+}
@@ -0,0 +1,12 @@
+#define STANDALONE
+#include <apitest.h>
+
+extern void func_Aes(void);
+extern void func_Hash(void);
+
+const struct test winetest_testlist[] =
+{
+    { "Aes", func_Aes },
+    { "Hash", func_Hash },
+    { 0, 0 }
+};
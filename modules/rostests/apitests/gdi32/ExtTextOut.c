@@ -0,0 +1,178 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Test and benchmark for ExtTextOut and the glyph cache
+ */
+
+#include "precomp.h"
+
+#define BITMAP_WIDTH 1024
+#define BITMAP_HEIGHT 64
+#define BENCH_ROUNDS 200
+
+static HDC hdc;
+static PULONG Bits;
+static ULONG Snapshot[BITMAP_WIDTH * BITMAP_HEIGHT];
+static WCHAR Text[0x100];
+static INT TextLength;
+
+static
+HFONT
+CreateTestFont(INT Height, BOOL Italic)
+{
+    LOGFONTW lf;
+
+    ZeroMemory(&lf, sizeof(lf));
+    lf.lfHeight = -Height;
+    lf.lfWeight = FW_NORMAL;
+    lf.lfItalic = (BYTE)Italic;
+    lf.lfCharSet = DEFAULT_CHARSET;
+    lf.lfQuality = ANTIALIASED_QUALITY;
+    StringCchCopyW(lf.lfFaceName, _countof(lf.lfFaceName), L"Tahoma");
+
+    return CreateFontIndirectW(&lf);
+}
+
+static
+VOID
+DrawTestText(INT Height, BOOL Italic, LPCWSTR String, INT Length)
+{
+    HFONT hFont, hOldFont;
+    RECT rc = { 0, 0, BITMAP_WIDTH, BITMAP_HEIGHT };
+
+    hFont = CreateTestFont(Height, Italic);
+    ok(hFont != NULL, "CreateFontIndirectW failed\n");
+    hOldFont = SelectObject(hdc, hFont);
+
+    ok(ExtTextOutW(hdc, 0, 0, ETO_OPAQUE, &rc, String, Length, NULL),
+       "ExtTextOutW failed for height %d\n", Height);
+    GdiFlush();
+
+    SelectObject(hdc, hOldFont);
+    DeleteObject(hFont);
+}
+
+static
+BOOL
+IsBlank(VOID)
+{
+    INT i;
+
+    for (i = 0; i < BITMAP_WIDTH * BITMAP_HEIGHT; i++)
+    {
+        if ((Bits[i] & 0x00FFFFFF) != 0x00FFFFFF)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static
+VOID
+Test_GlyphCache(VOID)
+{
+    INT Height;
+
+    /* Draw once to get the reference output */
+    DrawTestText(16, FALSE, Text, TextLength);
+    CopyMemory(Snapshot, Bits, sizeof(Snapshot));
+    ok(!IsBlank(), "Nothing was drawn\n");
+
+    /* The output must not change when the glyphs come from the cache */
+    DrawTestText(16, FALSE, Text, TextLength);
+    ok(memcmp(Bits, Snapshot, sizeof(Snapshot)) == 0, "The cached glyphs differ\n");
+
+    /* Use many more glyphs than the cache used to hold, some get evicted */
+    for (Height = 6; Height < 48; Height++)
+    {
+        DrawTestText(Height, FALSE, Text, TextLength);
+        DrawTestText(Height, TRUE, Text, TextLength);
+    }
+
+    DrawTestText(16, FALSE, Text, TextLength);
+    ok(memcmp(Bits, Snapshot, sizeof(Snapshot)) == 0, "The glyphs differ after the cache was filled\n");
+}
+
+static
+VOID
+Test_Benchmark(VOID)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    HFONT hFonts[4], hOldFont;
+    RECT rc = { 0, 0, BITMAP_WIDTH, BITMAP_HEIGHT };
+    INT Round, i;
+    static const WCHAR Line[] = L"The quick brown fox jumps over the lazy dog. 0123456789";
+
+    QueryPerformanceFrequency(&Frequency);
+
+    for (i = 0; i < _countof(hFonts); i++)
+        hFonts[i] = CreateTestFont(10 + i * 4, FALSE);
+
+    /* The same line over and over, like a terminal */
+    hOldFont = SelectObject(hdc, hFonts[0]);
+    QueryPerformanceCounter(&Start);
+    for (Round = 0; Round < BENCH_ROUNDS; Round++)
+        ExtTextOutW(hdc, 0, 0, ETO_OPAQUE, &rc, Line, _countof(Line) - 1, NULL);
+    GdiFlush();
+    QueryPerformanceCounter(&End);
+    trace("ExtTextOutW, one font: %I64u us per line\n",
+          (End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart / BENCH_ROUNDS);
+
+    /* Several fonts and a large character set, more than 256 glyphs */
+    QueryPerformanceCounter(&Start);
+    for (Round = 0; Round < BENCH_ROUNDS; Round++)
+    {
+        SelectObject(hdc, hFonts[Round % _countof(hFonts)]);
+        ExtTextOutW(hdc, 0, 0, ETO_OPAQUE, &rc, Text, TextLength, NULL);
+    }
+    GdiFlush();
+    QueryPerformanceCounter(&End);
+    trace("ExtTextOutW, %d fonts, %d characters: %I64u us per line\n",
+          (INT)_countof(hFonts), TextLength,
+          (End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart / BENCH_ROUNDS);
+
+    SelectObject(hdc, hOldFont);
+    for (i = 0; i < _countof(hFonts); i++)
+        DeleteObject(hFonts[i]);
+}
+
+START_TEST(ExtTextOut)
+{
+    BITMAPINFO bmi;
+    HBITMAP hbm, hbmOld;
+    WCHAR ch;
+
+    /* Printable ASCII and Latin-1 */
+    for (ch = 0x21; ch < 0x7F; ch++)
+        Text[TextLength++] = ch;
+    for (ch = 0xA1; ch <= 0xFF; ch++)
+        Text[TextLength++] = ch;
+
+    ZeroMemory(&bmi, sizeof(bmi));
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = BITMAP_WIDTH;
+    bmi.bmiHeader.biHeight = -BITMAP_HEIGHT;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    hdc = CreateCompatibleDC(NULL);
+    hbm = CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, (PVOID*)&Bits, NULL, 0);
+    if (!hdc || !hbm)
+    {
+        skip("Failed to create the DIB section\n");
+        if (hdc) DeleteDC(hdc);
+        return;
+    }
+
+    hbmOld = SelectObject(hdc, hbm);
+    SetTextColor(hdc, RGB(0, 0, 0));
+    SetBkColor(hdc, RGB(255, 255, 255));
+
+    Test_GlyphCache();
+    Test_Benchmark();
+
+    SelectObject(hdc, hbmOld);
+    DeleteObject(hbm);
+    DeleteDC(hdc);
+}
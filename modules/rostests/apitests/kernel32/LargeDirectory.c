@@ -0,0 +1,132 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Test for creating and opening files in large directories
+ */
+
+#include "precomp.h"
+
+/* 8.3 names take one directory entry each, FAT allows 65536 per directory */
+#define FILE_COUNT 20000
+#define MISSING_COUNT 2000
+
+static WCHAR DirectoryPath[MAX_PATH];
+
+static
+VOID
+GetFilePath(PWSTR Buffer, SIZE_T Count, PCWSTR Format, ULONG Index)
+{
+    WCHAR FileName[64];
+
+    StringCchPrintfW(FileName, _countof(FileName), Format, Index);
+    StringCchPrintfW(Buffer, Count, L"%s\\%s", DirectoryPath, FileName);
+}
+
+static
+ULONG
+CreateFiles(ULONG First, ULONG Last, ULONG Step)
+{
+    WCHAR Path[MAX_PATH];
+    HANDLE Handle;
+    ULONG Index, Failures = 0;
+
+    for (Index = First; Index < Last; Index += Step)
+    {
+        GetFilePath(Path, _countof(Path), L"F%05lu.TXT", Index);
+        Handle = CreateFileW(Path, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (Handle == INVALID_HANDLE_VALUE)
+            Failures++;
+        else
+            CloseHandle(Handle);
+    }
+
+    return Failures;
+}
+
+static
+ULONG
+OpenFiles(PCWSTR Format, ULONG Count, ULONG Step, BOOL Exist)
+{
+    WCHAR Path[MAX_PATH];
+    HANDLE Handle;
+    ULONG Index, Round, Failures = 0;
+
+    /* Open the files out of order, like a tree walk would */
+    for (Round = 0; Round < Step; Round++)
+    {
+        for (Index = Round; Index < Count; Index += Step)
+        {
+            GetFilePath(Path, _countof(Path), Format, Index);
+            Handle = CreateFileW(Path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+            if (Handle != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(Handle);
+                Failures += !Exist;
+            }
+            else
+            {
+                Failures += (Exist || GetLastError() != ERROR_FILE_NOT_FOUND);
+            }
+        }
+    }
+
+    return Failures;
+}
+
+static
+ULONG
+DeleteFiles(ULONG First, ULONG Last, ULONG Step)
+{
+    WCHAR Path[MAX_PATH];
+    ULONG Index, Failures = 0;
+
+    for (Index = First; Index < Last; Index += Step)
+    {
+        GetFilePath(Path, _countof(Path), L"F%05lu.TXT", Index);
+        Failures += !DeleteFileW(Path);
+    }
+
+    return Failures;
+}
+
+START_TEST(LargeDirectory)
+{
+    WCHAR TempPath[MAX_PATH], ShortPath[MAX_PATH], Path[MAX_PATH];
+    HANDLE Handle;
+
+    GetTempPathW(_countof(TempPath), TempPath);
+    StringCchPrintfW(DirectoryPath, _countof(DirectoryPath), L"%sLargeDirectory", TempPath);
+    if (!CreateDirectoryW(DirectoryPath, NULL))
+    {
+        skip("Cannot create %S (error %lu)\n", DirectoryPath, GetLastError());
+        return;
+    }
+
+    ok_long(CreateFiles(0, FILE_COUNT, 1), 0);
+    ok_long(OpenFiles(L"F%05lu.TXT", FILE_COUNT, 7, TRUE), 0);
+    ok_long(OpenFiles(L"f%05lu.txt", FILE_COUNT, 1, TRUE), 0);
+    ok_long(OpenFiles(L"M%05lu.TXT", MISSING_COUNT, 1, FALSE), 0);
+
+    /* A long name and its generated short name must resolve too */
+    GetFilePath(Path, _countof(Path), L"Long file name %05lu.txt", FILE_COUNT);
+    Handle = CreateFileW(Path, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+    ok(Handle != INVALID_HANDLE_VALUE, "Cannot create %S (error %lu)\n", Path, GetLastError());
+    if (Handle != INVALID_HANDLE_VALUE)
+        CloseHandle(Handle);
+    ok(GetShortPathNameW(Path, ShortPath, _countof(ShortPath)) != 0, "GetShortPathNameW failed\n");
+    Handle = CreateFileW(ShortPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    ok(Handle != INVALID_HANDLE_VALUE, "Cannot open %S (error %lu)\n", ShortPath, GetLastError());
+    if (Handle != INVALID_HANDLE_VALUE)
+        CloseHandle(Handle);
+    ok(DeleteFileW(Path), "DeleteFileW failed (error %lu)\n", GetLastError());
+
+    /* Punch holes in the directory and fill them again */
+    ok_long(DeleteFiles(0, FILE_COUNT, 3), 0);
+    ok_long(CreateFiles(0, FILE_COUNT, 3), 0);
+    ok_long(OpenFiles(L"F%05lu.TXT", FILE_COUNT, 11, TRUE), 0);
+
+    ok_long(DeleteFiles(0, FILE_COUNT, 1), 0);
+    ok_long(OpenFiles(L"F%05lu.TXT", FILE_COUNT, 13, FALSE), 0);
+
+    ok(RemoveDirectoryW(DirectoryPath), "RemoveDirectoryW failed (error %lu)\n", GetLastError());
+}
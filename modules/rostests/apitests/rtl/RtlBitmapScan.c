@@ -0,0 +1,257 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Test and benchmark for the word based RTL bitmap scanners
+ */
+
+#include <rtltests.h>
+
+#define TEST_BITMAP_ULONGS 64
+#define TEST_ITERATIONS 5000
+#define BENCH_BITMAP_BITS (1024 * 1024)
+#define BENCH_ROUNDS 16
+
+static ULONG Seed = 0x12345678;
+
+static
+ULONG
+NextRandom(VOID)
+{
+    return RtlRandomEx(&Seed);
+}
+
+static
+BOOLEAN
+RefTestBit(PULONG Buffer, ULONG Index)
+{
+    return (Buffer[Index / 32] >> (Index & 31)) & 1;
+}
+
+/* Bit by bit reference implementations */
+static
+ULONG
+RefNumberOfSetBits(PULONG Buffer, ULONG Size)
+{
+    ULONG Index, Count = 0;
+
+    for (Index = 0; Index < Size; Index++)
+        Count += RefTestBit(Buffer, Index);
+
+    return Count;
+}
+
+static
+ULONG
+RefFindNextForwardRun(PULONG Buffer, ULONG Size, ULONG From, BOOLEAN Set, PULONG Start)
+{
+    ULONG Length = 0;
+
+    while ((From < Size) && (RefTestBit(Buffer, From) != Set))
+        From++;
+
+    *Start = From;
+
+    while ((From + Length < Size) && (RefTestBit(Buffer, From + Length) == Set))
+        Length++;
+
+    return Length;
+}
+
+static
+ULONG
+RefFindLongestRun(PULONG Buffer, ULONG Size, BOOLEAN Set, PULONG Start)
+{
+    ULONG Index = 0, Run, Length, Longest = 0;
+
+    while (Index < Size)
+    {
+        Length = RefFindNextForwardRun(Buffer, Size, Index, Set, &Run);
+        if (Length == 0)
+            break;
+
+        if (Length > Longest)
+        {
+            Longest = Length;
+            *Start = Run;
+        }
+
+        Index = Run + Length;
+    }
+
+    return Longest;
+}
+
+static
+VOID
+FillRandom(PULONG Buffer, ULONG Count)
+{
+    ULONG Index, Mode = NextRandom() % 4;
+
+    for (Index = 0; Index < Count; Index++)
+    {
+        switch (Mode)
+        {
+            case 0: Buffer[Index] = 0; break;
+            case 1: Buffer[Index] = MAXULONG; break;
+            case 2: Buffer[Index] = NextRandom() ^ (NextRandom() << 16); break;
+            default:
+                /* Long runs with a few random words in between */
+                if (NextRandom() % 8 == 0)
+                    Buffer[Index] = NextRandom() ^ (NextRandom() << 16);
+                else
+                    Buffer[Index] = (NextRandom() & 1) ? MAXULONG : 0;
+                break;
+        }
+    }
+}
+
+static
+VOID
+Test_Compare(VOID)
+{
+    ULONG Buffer[TEST_BITMAP_ULONGS], Copy[TEST_BITMAP_ULONGS];
+    RTL_BITMAP BitMapHeader;
+    ULONG Iteration, Size, From, Start, RefStart, Length, RefLength;
+    ULONG Count, Index;
+    BOOLEAN Set;
+
+    for (Iteration = 0; Iteration < TEST_ITERATIONS; Iteration++)
+    {
+        Size = NextRandom() % (TEST_BITMAP_ULONGS * 32) + 1;
+        FillRandom(Buffer, TEST_BITMAP_ULONGS);
+        RtlInitializeBitMap(&BitMapHeader, Buffer, Size);
+
+        ok_eq_ulong(RtlNumberOfSetBits(&BitMapHeader), RefNumberOfSetBits(Buffer, Size));
+
+        From = NextRandom() % Size;
+        Length = RtlFindNextForwardRunClear(&BitMapHeader, From, &Start);
+        RefLength = RefFindNextForwardRun(Buffer, Size, From, FALSE, &RefStart);
+        ok_eq_ulong(Length, RefLength);
+        if (RefLength != 0) ok_eq_ulong(Start, RefStart);
+
+        Length = RtlFindNextForwardRunSet(&BitMapHeader, From, &Start);
+        RefLength = RefFindNextForwardRun(Buffer, Size, From, TRUE, &RefStart);
+        ok_eq_ulong(Length, RefLength);
+        if (RefLength != 0) ok_eq_ulong(Start, RefStart);
+
+        Length = RtlFindLongestRunClear(&BitMapHeader, &Start);
+        RefLength = RefFindLongestRun(Buffer, Size, FALSE, &RefStart);
+        ok_eq_ulong(Length, RefLength);
+        if (RefLength != 0) ok_eq_ulong(Start, RefStart);
+
+        Length = RtlFindLongestRunSet(&BitMapHeader, &Start);
+        RefLength = RefFindLongestRun(Buffer, Size, TRUE, &RefStart);
+        ok_eq_ulong(Length, RefLength);
+        if (RefLength != 0) ok_eq_ulong(Start, RefStart);
+
+        /* Set or clear a random range and verify every bit */
+        From = NextRandom() % Size;
+        Length = NextRandom() % (Size - From + 1);
+        Set = NextRandom() & 1;
+        RtlCopyMemory(Copy, Buffer, sizeof(Buffer));
+        if (Set)
+            RtlSetBits(&BitMapHeader, From, Length);
+        else
+            RtlClearBits(&BitMapHeader, From, Length);
+
+        for (Index = 0, Count = 0; Index < TEST_BITMAP_ULONGS * 32; Index++)
+        {
+            if ((Index >= From) && (Index < From + Length))
+                Count += (RefTestBit(Buffer, Index) != Set);
+            else
+                Count += (RefTestBit(Buffer, Index) != RefTestBit(Copy, Index));
+        }
+        ok_eq_ulong(Count, 0UL);
+
+        /* Whatever RtlFindClearBits returns must really be clear */
+        Length = NextRandom() % 64 + 1;
+        Start = RtlFindClearBits(&BitMapHeader, Length, NextRandom() % Size);
+        if (Start != MAXULONG)
+        {
+            ok(Start + Length <= Size, "Run %lu+%lu is out of range (%lu)\n", Start, Length, Size);
+            ok(RtlAreBitsClear(&BitMapHeader, Start, Length), "Run %lu+%lu is not clear\n", Start, Length);
+        }
+    }
+}
+
+static
+ULONGLONG
+GetTime(VOID)
+{
+    LARGE_INTEGER Counter;
+
+    NtQueryPerformanceCounter(&Counter, NULL);
+    return Counter.QuadPart;
+}
+
+static
+VOID
+Test_Benchmark(VOID)
+{
+    RTL_BITMAP BitMapHeader;
+    LARGE_INTEGER Counter, Frequency;
+    PULONG Buffer;
+    ULONGLONG Start, RefTime, Time;
+    ULONG Round, Index, Count, RefCount, Run;
+
+    Buffer = RtlAllocateHeap(RtlGetProcessHeap(), 0, BENCH_BITMAP_BITS / 8);
+    if (!Buffer)
+    {
+        skip("Out of memory\n");
+        return;
+    }
+
+    NtQueryPerformanceCounter(&Counter, &Frequency);
+
+    /* A sparsely used bitmap, like a page file slot map */
+    RtlInitializeBitMap(&BitMapHeader, Buffer, BENCH_BITMAP_BITS);
+    RtlClearAllBits(&BitMapHeader);
+    for (Index = 0; Index < BENCH_BITMAP_BITS / 4096; Index++)
+    {
+        RtlSetBits(&BitMapHeader, NextRandom() % (BENCH_BITMAP_BITS - 64), NextRandom() % 64);
+    }
+
+    Start = GetTime();
+    for (Round = 0, RefCount = 0; Round < BENCH_ROUNDS; Round++)
+        RefCount += RefNumberOfSetBits(Buffer, BENCH_BITMAP_BITS);
+    RefTime = GetTime() - Start;
+
+    Start = GetTime();
+    for (Round = 0, Count = 0; Round < BENCH_ROUNDS; Round++)
+        Count += RtlNumberOfSetBits(&BitMapHeader);
+    Time = GetTime() - Start;
+
+    ok_eq_ulong(Count, RefCount);
+    trace("RtlNumberOfSetBits: %I64u us, bitwise reference: %I64u us\n",
+          Time * 1000000 / Frequency.QuadPart, RefTime * 1000000 / Frequency.QuadPart);
+
+    Start = GetTime();
+    for (Round = 0, RefCount = 0; Round < BENCH_ROUNDS; Round++)
+        RefCount += RefFindLongestRun(Buffer, BENCH_BITMAP_BITS, FALSE, &Run);
+    RefTime = GetTime() - Start;
+
+    Start = GetTime();
+    for (Round = 0, Count = 0; Round < BENCH_ROUNDS; Round++)
+        Count += RtlFindLongestRunClear(&BitMapHeader, &Run);
+    Time = GetTime() - Start;
+
+    ok_eq_ulong(Count, RefCount);
+    trace("RtlFindLongestRunClear: %I64u us, bitwise reference: %I64u us\n",
+          Time * 1000000 / Frequency.QuadPart, RefTime * 1000000 / Frequency.QuadPart);
+
+    Start = GetTime();
+    for (Round = 0, Count = 0; Round < BENCH_ROUNDS * 64; Round++)
+        Count += (RtlFindClearBits(&BitMapHeader, 256, NextRandom() % BENCH_BITMAP_BITS) != MAXULONG);
+    Time = GetTime() - Start;
+
+    trace("RtlFindClearBits: %I64u us for %lu lookups\n",
+          Time * 1000000 / Frequency.QuadPart, BENCH_ROUNDS * 64);
+
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Buffer);
+}
+
+START_TEST(RtlBitmapScan)
+{
+    Test_Compare();
+    Test_Benchmark();
+}
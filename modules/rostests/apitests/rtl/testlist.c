@@ -3,12 +3,14 @@
 #define STANDALONE
 #include <apitest.h>
 
+extern void func_RtlBitmapScan(void);
 extern void func_RtlCaptureContext(void);
 extern void func_RtlIntSafe(void);
 extern void func_RtlUnwind(void);
 
 const struct test winetest_testlist[] =
 {
+    { "RtlBitmapScan",            func_RtlBitmapScan },
     { "RtlIntSafe",               func_RtlIntSafe },
 
 #ifdef _M_IX86
@@ -0,0 +1,292 @@
+/*
+ * PROJECT:     ReactOS Tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Search throughput of findstr over a tree of log files
+ *
+ * Writes a synthetic log tree to the temporary directory: directories of
+ * log files whose lines carry a timestamp, a level and a message, with an
+ * error every few hundred lines and now and then a line of several
+ * kilobytes. findstr is then run over the tree for a literal string, a
+ * case insensitive one, a regular expression, a count of the lines that
+ * do not match and a /S search for the file names, with its output going
+ * to NUL. The megabytes searched per second are printed for every mode.
+ * Run
+ *
+ *   findstrbench [megabytes] [files] [runs] [findstr]
+ *
+ * which defaults to 256 MB in 64 files, the best of 3 runs and the
+ * findstr.exe found in the path.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <windef.h>
+#include <winbase.h>
+
+#define FILES_PER_DIR 16
+
+typedef struct _BENCH_MODE
+{
+    const char *Name;
+    const char *Arguments;
+} BENCH_MODE;
+
+static const BENCH_MODE Modes[] =
+{
+    { "literal",          "\"deadbeef\" *.log" },
+    { "ignore case",      "/I \"DeadBeef\" *.log" },
+    { "several strings",  "\"deadbeef timeout refused\" *.log" },
+    { "regex",            "/R \"^[0-9]*:.*ERROR.*code=[0-9]*$\" *.log" },
+    { "count inverted",   "/V /C \"INFO\" *.log" },
+    { "numbered",         "/N \"WARN\" *.log" },
+    { "subdirs names",    "/S /M \"deadbeef\" *.log" },
+};
+
+static const char *Messages[] =
+{
+    "INFO  request served in %lu ms",
+    "INFO  cache hit for key %lu",
+    "INFO  connection %lu accepted from 10.0.0.%lu",
+    "DEBUG queue depth %lu, %lu waiting",
+    "WARN  slow response from backend %lu after %lu ms",
+    "INFO  session %lu closed",
+};
+
+static ULONG Seed = 1;
+
+static
+ULONG
+Random(VOID)
+{
+    Seed = Seed * 1103515245 + 12345;
+    return (Seed >> 16) & 0x7FFF;
+}
+
+static
+BOOL
+WriteLog(const char *Path, ULONG64 Size)
+{
+    char Line[8192];
+    ULONG64 Written = 0, LineNumber = 0;
+    ULONG Length, i;
+    DWORD Done;
+    HANDLE File;
+
+    File = CreateFileA(Path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (File == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    while (Written < Size)
+    {
+        LineNumber++;
+        Length = sprintf(Line, "%I64u: 2024-05-%02lu %02lu:%02lu:%02lu ", LineNumber,
+                         Random() % 28 + 1, Random() % 24, Random() % 60, Random() % 60);
+
+        if (Random() % 400 == 0)
+        {
+            Length += sprintf(Line + Length, "ERROR request %lu failed: %s code=%lu",
+                              Random(), (Random() & 1) ? "timeout" : "connection refused",
+                              Random() % 600);
+        }
+        else if (Random() % 5000 == 0)
+        {
+            Length += sprintf(Line + Length, "ERROR bad magic deadbeef in block %lu", Random());
+        }
+        else
+        {
+            Length += sprintf(Line + Length, Messages[Random() % ARRAYSIZE(Messages)],
+                              Random(), Random() % 256);
+        }
+
+        /* A long line now and then, findstr used to cut them at 1 KB */
+        if (Random() % 2000 == 0)
+        {
+            for (i = 0; i < 4000; i++)
+                Line[Length++] = 'a' + (char)(Random() % 26);
+        }
+
+        Line[Length++] = '\r';
+        Line[Length++] = '\n';
+
+        if (!WriteFile(File, Line, Length, &Done, NULL) || Done != Length)
+        {
+            CloseHandle(File);
+            return FALSE;
+        }
+        Written += Length;
+    }
+
+    CloseHandle(File);
+    return TRUE;
+}
+
+static
+BOOL
+CreateTree(const char *Root, ULONG Files, ULONG64 FileSize)
+{
+    char Path[MAX_PATH];
+    ULONG Index;
+
+    if (!CreateDirectoryA(Root, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+        return FALSE;
+
+    for (Index = 0; Index < Files; Index++)
+    {
+        sprintf(Path, "%s\\dir%02lu", Root, Index / FILES_PER_DIR);
+        if (Index % FILES_PER_DIR == 0 &&
+            !CreateDirectoryA(Path, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+        {
+            return FALSE;
+        }
+
+        sprintf(Path, "%s\\dir%02lu\\app%03lu.log", Root, Index / FILES_PER_DIR, Index);
+        if (!WriteLog(Path, FileSize))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static
+VOID
+DeleteTree(const char *Root, ULONG Files)
+{
+    char Path[MAX_PATH];
+    ULONG Index;
+
+    for (Index = 0; Index < Files; Index++)
+    {
+        sprintf(Path, "%s\\dir%02lu\\app%03lu.log", Root, Index / FILES_PER_DIR, Index);
+        DeleteFileA(Path);
+        if (Index % FILES_PER_DIR == FILES_PER_DIR - 1 || Index == Files - 1)
+        {
+            sprintf(Path, "%s\\dir%02lu", Root, Index / FILES_PER_DIR);
+            RemoveDirectoryA(Path);
+        }
+    }
+    RemoveDirectoryA(Root);
+}
+
+/* Runs findstr in one directory of the tree, or the root for /S, and
+ * returns how long it took in seconds */
+static
+double
+RunFindstr(const char *Findstr, const char *Directory, const char *Arguments, DWORD *ExitCode)
+{
+    char CommandLine[MAX_PATH * 2];
+    SECURITY_ATTRIBUTES Inherit = { sizeof(Inherit), NULL, TRUE };
+    LARGE_INTEGER Frequency, Start, End;
+    PROCESS_INFORMATION ProcessInfo;
+    STARTUPINFOA StartupInfo;
+    HANDLE Null;
+    BOOL Success;
+
+    Null = CreateFileA("NUL", GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, &Inherit,
+                       OPEN_EXISTING, 0, NULL);
+    if (Null == INVALID_HANDLE_VALUE)
+        return -1;
+
+    ZeroMemory(&StartupInfo, sizeof(StartupInfo));
+    StartupInfo.cb = sizeof(StartupInfo);
+    StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+    StartupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    StartupInfo.hStdOutput = Null;
+    StartupInfo.hStdError = Null;
+
+    sprintf(CommandLine, "%s %s", Findstr, Arguments);
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    Success = CreateProcessA(NULL, CommandLine, NULL, NULL, TRUE, 0, NULL, Directory,
+                             &StartupInfo, &ProcessInfo);
+    if (Success)
+    {
+        WaitForSingleObject(ProcessInfo.hProcess, INFINITE);
+        QueryPerformanceCounter(&End);
+        GetExitCodeProcess(ProcessInfo.hProcess, ExitCode);
+        CloseHandle(ProcessInfo.hThread);
+        CloseHandle(ProcessInfo.hProcess);
+    }
+    CloseHandle(Null);
+
+    if (!Success)
+        return -1;
+    return (double)(End.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+}
+
+int
+main(int argc, char *argv[])
+{
+    char Root[MAX_PATH], Directory[MAX_PATH];
+    const char *Findstr = "findstr.exe";
+    ULONG Megabytes = 256, Files = 64, Runs = 3;
+    ULONG Index, Run, Dir, Dirs;
+    ULONG64 FileSize;
+    double Seconds, Best, Total;
+    DWORD ExitCode = 0;
+
+    if (argc > 1)
+        Megabytes = strtoul(argv[1], NULL, 0);
+    if (argc > 2)
+        Files = strtoul(argv[2], NULL, 0);
+    if (argc > 3)
+        Runs = strtoul(argv[3], NULL, 0);
+    if (argc > 4)
+        Findstr = argv[4];
+
+    if (Megabytes == 0 || Files == 0 || Files > 1000 || Runs == 0)
+    {
+        printf("Usage: findstrbench [megabytes] [files] [runs] [findstr]\n");
+        return 1;
+    }
+
+    GetTempPathA(sizeof(Root) - 32, Root);
+    sprintf(Root + strlen(Root), "findstrbench%lu", GetCurrentProcessId());
+    FileSize = (ULONG64)Megabytes * 1024 * 1024 / Files;
+    Dirs = (Files + FILES_PER_DIR - 1) / FILES_PER_DIR;
+
+    printf("Writing %lu MB in %lu files to %s\n", Megabytes, Files, Root);
+    if (!CreateTree(Root, Files, FileSize))
+    {
+        printf("Could not write the log tree\n");
+        DeleteTree(Root, Files);
+        return 2;
+    }
+
+    for (Index = 0; Index < ARRAYSIZE(Modes); Index++)
+    {
+        Best = 0;
+        for (Run = 0; Run < Runs; Run++)
+        {
+            /* /S searches the whole tree at once, the others go by directory */
+            if (strstr(Modes[Index].Arguments, "/S"))
+            {
+                Total = RunFindstr(Findstr, Root, Modes[Index].Arguments, &ExitCode);
+            }
+            else
+            {
+                for (Dir = 0, Total = 0; Dir < Dirs && Total >= 0; Dir++)
+                {
+                    sprintf(Directory, "%s\\dir%02lu", Root, Dir);
+                    Seconds = RunFindstr(Findstr, Directory, Modes[Index].Arguments, &ExitCode);
+                    Total = (Seconds < 0) ? -1 : Total + Seconds;
+                }
+            }
+
+            if (Total < 0)
+            {
+                printf("Could not run %s\n", Findstr);
+                DeleteTree(Root, Files);
+                return 2;
+            }
+            if (Run == 0 || Total < Best)
+                Best = Total;
+        }
+
+        printf("%-16s %8.3f s %10.1f MB/s (exit code %lu)\n", Modes[Index].Name, Best,
+               Best > 0 ? Megabytes / Best : 0.0, ExitCode);
+    }
+
+    DeleteTree(Root, Files);
+    return 0;
+}
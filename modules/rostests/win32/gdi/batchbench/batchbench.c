@@ -0,0 +1,202 @@
+/*
+ * PROJECT:     ReactOS Tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Syscalls and time per frame of the batched GDI drawing calls
+ *
+ * Draws frames of small primitives into a device bitmap the way charting
+ * and CAD programs do, changing the pen, text and background colors in
+ * between, and ends every frame with GdiFlush. Each kind of primitive is
+ * drawn with the default batch limit, which gdi32 raises for batches of
+ * small commands, with a fixed limit of 19 commands and with batching off.
+ * The syscalls per frame are taken from the system wide counter, so run it
+ * on an otherwise idle system. Run
+ *
+ *   batchbench [primitives] [frames]
+ *
+ * which defaults to 2000 primitives a frame and 50 frames.
+ */
+
+#define WIN32_NO_STATUS
+#include <stdio.h>
+#include <stdlib.h>
+#include <windef.h>
+#include <winbase.h>
+#include <wingdi.h>
+#include <winuser.h>
+#include <ndk/ntndk.h>
+
+#define FRAME_WIDTH  640
+#define FRAME_HEIGHT 480
+
+typedef enum _BENCH_OP
+{
+    OpLineTo,
+    OpRectangle,
+    OpPolyline,
+    OpSetPixelV,
+    OpBitBlt,
+    OpMixed
+} BENCH_OP;
+
+static const char *OpNames[] =
+{
+    "LineTo",
+    "Rectangle",
+    "Polyline",
+    "SetPixelV",
+    "BitBlt",
+    "mixed"
+};
+
+static HDC hdcFrame;
+
+static
+ULONG
+GetSystemCalls(VOID)
+{
+    SYSTEM_PERFORMANCE_INFORMATION Info;
+
+    if (!NT_SUCCESS(NtQuerySystemInformation(SystemPerformanceInformation,
+                                             &Info, sizeof(Info), NULL)))
+    {
+        return 0;
+    }
+    return Info.SystemCalls;
+}
+
+/* Draws one frame of the given primitive, with a color change every 16 */
+static
+VOID
+DrawFrame(BENCH_OP Op, ULONG Primitives, ULONG Frame)
+{
+    POINT Points[8];
+    ULONG Index, Point;
+    INT x, y;
+
+    SelectObject(hdcFrame, GetStockObject(DC_PEN));
+    SelectObject(hdcFrame, GetStockObject(DC_BRUSH));
+    MoveToEx(hdcFrame, 0, 0, NULL);
+
+    for (Index = 0; Index < Primitives; Index++)
+    {
+        x = (Index * 37 + Frame * 11) % FRAME_WIDTH;
+        y = (Index * 53 + Frame * 7) % FRAME_HEIGHT;
+
+        if ((Index & 15) == 0)
+        {
+            SetDCPenColor(hdcFrame, RGB(Index, Frame, 128));
+            SetDCBrushColor(hdcFrame, RGB(Frame, 128, Index));
+            SetTextColor(hdcFrame, RGB(128, Index, Frame));
+            SetBkColor(hdcFrame, RGB(Index, 255 - Frame, 0));
+        }
+
+        switch (Op == OpMixed ? (BENCH_OP)(Index % OpMixed) : Op)
+        {
+            case OpLineTo:
+                LineTo(hdcFrame, x, y);
+                break;
+
+            case OpRectangle:
+                Rectangle(hdcFrame, x, y, x + 12, y + 8);
+                break;
+
+            case OpPolyline:
+                for (Point = 0; Point < ARRAYSIZE(Points); Point++)
+                {
+                    Points[Point].x = x + Point * 4;
+                    Points[Point].y = y + ((Point & 1) ? 6 : 0);
+                }
+                Polyline(hdcFrame, Points, ARRAYSIZE(Points));
+                break;
+
+            case OpSetPixelV:
+                SetPixelV(hdcFrame, x, y, RGB(x, y, Index));
+                break;
+
+            case OpBitBlt:
+                /* Only blts within one DC are batched, copy the sprite in the corner */
+                BitBlt(hdcFrame, x, y, 16, 16, hdcFrame, 0, 0, SRCCOPY);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    GdiFlush();
+}
+
+/* Draws the frames and prints the syscalls and milliseconds per frame */
+static
+VOID
+RunOp(BENCH_OP Op, const char *Limit, ULONG Primitives, ULONG Frames)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG Frame, Calls;
+
+    /* Warm up the brushes and pens outside of the measurement */
+    DrawFrame(Op, Primitives, 0);
+
+    QueryPerformanceFrequency(&Frequency);
+    Calls = GetSystemCalls();
+    QueryPerformanceCounter(&Start);
+    for (Frame = 0; Frame < Frames; Frame++)
+        DrawFrame(Op, Primitives, Frame);
+    QueryPerformanceCounter(&End);
+    Calls = GetSystemCalls() - Calls;
+
+    printf("%-10s %-9s %10.1f syscalls %10.3f ms per frame\n", OpNames[Op], Limit,
+           (double)Calls / Frames,
+           (double)(End.QuadPart - Start.QuadPart) * 1000 / Frequency.QuadPart / Frames);
+}
+
+int
+wmain(int argc, WCHAR *argv[])
+{
+    ULONG Primitives = 2000, Frames = 50, Index;
+    HBITMAP hbmFrame;
+    HDC hdcScreen;
+
+    if (argc > 1)
+        Primitives = wcstoul(argv[1], NULL, 0);
+    if (argc > 2)
+        Frames = wcstoul(argv[2], NULL, 0);
+
+    if (Primitives == 0 || Frames == 0)
+    {
+        printf("Usage: batchbench [primitives] [frames]\n");
+        return 1;
+    }
+
+    /* Device bitmaps, DIB sections are never batched */
+    hdcScreen = GetDC(NULL);
+    hdcFrame = CreateCompatibleDC(hdcScreen);
+    hbmFrame = CreateCompatibleBitmap(hdcScreen, FRAME_WIDTH, FRAME_HEIGHT);
+    ReleaseDC(NULL, hdcScreen);
+    if (!hdcFrame || !hbmFrame)
+    {
+        printf("Could not create the bitmaps\n");
+        return 2;
+    }
+    SelectObject(hdcFrame, hbmFrame);
+    PatBlt(hdcFrame, 0, 0, 16, 16, WHITENESS);
+
+    printf("%lu primitives per frame, %lu frames, batch limit %lu\n",
+           Primitives, Frames, GdiGetBatchLimit());
+
+    /* The limit can only be lowered, so go from the default down */
+    for (Index = OpLineTo; Index <= OpMixed; Index++)
+        RunOp(Index, "default", Primitives, Frames);
+
+    GdiSetBatchLimit(19);
+    for (Index = OpLineTo; Index <= OpMixed; Index++)
+        RunOp(Index, "fixed 19", Primitives, Frames);
+
+    GdiSetBatchLimit(1);
+    for (Index = OpLineTo; Index <= OpMixed; Index++)
+        RunOp(Index, "off", Primitives, Frames);
+
+    DeleteDC(hdcFrame);
+    DeleteObject(hbmFrame);
+    return 0;
+}
@@ -0,0 +1,218 @@
+/*
+ * PROJECT:     ReactOS Tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Throughput of the win32k DIB stretch and blend paths
+ *
+ * Times StretchBlt and AlphaBlend between DIB sections of the same format
+ * and prints megapixels per second. Each fast path is measured next to a
+ * call of the same size that the DIB engine has to hand to its generic
+ * per-pixel code: a mirrored StretchBlt, and an AlphaBlend whose source is
+ * one pixel wider than the destination. Run
+ *
+ *   dibbench [seconds]
+ *
+ * to spend the given time, one second by default, on each line.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <windef.h>
+#include <winbase.h>
+#include <wingdi.h>
+
+#define SRC_WIDTH   640
+#define SRC_HEIGHT  480
+#define DST_WIDTH   1024
+#define DST_HEIGHT  768
+
+typedef struct _BENCH_SURFACE
+{
+    HDC hdc;
+    HBITMAP hbm;
+    HGDIOBJ hbmOld;
+    PVOID Bits;
+} BENCH_SURFACE, *PBENCH_SURFACE;
+
+typedef enum _BENCH_OP
+{
+    OpStretch,
+    OpStretchMirrored,
+    OpBlendPerPixel,
+    OpBlendPerPixelStretched,
+    OpBlendConstant,
+    OpBlendConstantStretched
+} BENCH_OP;
+
+static
+BOOL
+CreateSurface(PBENCH_SURFACE Surface, LONG Width, LONG Height, WORD BitCount)
+{
+    BITMAPINFO bmi;
+    ULONG Stride, Index;
+    PUCHAR Bytes;
+
+    ZeroMemory(&bmi, sizeof(bmi));
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = Width;
+    bmi.bmiHeader.biHeight = -Height;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = BitCount;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    Surface->hdc = CreateCompatibleDC(NULL);
+    if (!Surface->hdc)
+        return FALSE;
+
+    Surface->hbm = CreateDIBSection(Surface->hdc, &bmi, DIB_RGB_COLORS, &Surface->Bits, NULL, 0);
+    if (!Surface->hbm)
+    {
+        DeleteDC(Surface->hdc);
+        return FALSE;
+    }
+    Surface->hbmOld = SelectObject(Surface->hdc, Surface->hbm);
+
+    /* A gradient with a spread of alpha values, premultiplied for 32bpp */
+    Stride = ((Width * BitCount + 31) / 32) * 4;
+    Bytes = Surface->Bits;
+    for (Index = 0; Index < Stride * Height; Index++)
+        Bytes[Index] = (UCHAR)(Index * 7 + Index / Stride);
+    if (BitCount == 32)
+    {
+        for (Index = 0; Index < Stride * Height; Index += 4)
+        {
+            Bytes[Index] = Bytes[Index] * Bytes[Index + 3] / 255;
+            Bytes[Index + 1] = Bytes[Index + 1] * Bytes[Index + 3] / 255;
+            Bytes[Index + 2] = Bytes[Index + 2] * Bytes[Index + 3] / 255;
+        }
+    }
+
+    return TRUE;
+}
+
+static
+VOID
+DestroySurface(PBENCH_SURFACE Surface)
+{
+    SelectObject(Surface->hdc, Surface->hbmOld);
+    DeleteObject(Surface->hbm);
+    DeleteDC(Surface->hdc);
+}
+
+static
+BOOL
+RunOp(BENCH_OP Op, PBENCH_SURFACE Dest, PBENCH_SURFACE Source)
+{
+    BLENDFUNCTION Blend = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
+
+    switch (Op)
+    {
+        case OpStretch:
+            return StretchBlt(Dest->hdc, 0, 0, DST_WIDTH, DST_HEIGHT,
+                              Source->hdc, 0, 0, SRC_WIDTH, SRC_HEIGHT, SRCCOPY);
+
+        case OpStretchMirrored:
+            return StretchBlt(Dest->hdc, DST_WIDTH - 1, 0, -DST_WIDTH, DST_HEIGHT,
+                              Source->hdc, 0, 0, SRC_WIDTH, SRC_HEIGHT, SRCCOPY);
+
+        case OpBlendPerPixel:
+            return GdiAlphaBlend(Dest->hdc, 0, 0, SRC_WIDTH - 1, SRC_HEIGHT,
+                                 Source->hdc, 0, 0, SRC_WIDTH - 1, SRC_HEIGHT, Blend);
+
+        case OpBlendPerPixelStretched:
+            return GdiAlphaBlend(Dest->hdc, 0, 0, SRC_WIDTH - 1, SRC_HEIGHT,
+                                 Source->hdc, 0, 0, SRC_WIDTH, SRC_HEIGHT, Blend);
+
+        case OpBlendConstant:
+            Blend.SourceConstantAlpha = 128;
+            Blend.AlphaFormat = 0;
+            return GdiAlphaBlend(Dest->hdc, 0, 0, SRC_WIDTH - 1, SRC_HEIGHT,
+                                 Source->hdc, 0, 0, SRC_WIDTH - 1, SRC_HEIGHT, Blend);
+
+        case OpBlendConstantStretched:
+            Blend.SourceConstantAlpha = 128;
+            Blend.AlphaFormat = 0;
+            return GdiAlphaBlend(Dest->hdc, 0, 0, SRC_WIDTH - 1, SRC_HEIGHT,
+                                 Source->hdc, 0, 0, SRC_WIDTH, SRC_HEIGHT, Blend);
+    }
+
+    return FALSE;
+}
+
+static
+VOID
+Measure(PCSTR Name, BENCH_OP Op, PBENCH_SURFACE Dest, PBENCH_SURFACE Source,
+        ULONG Pixels, ULONG Seconds)
+{
+    LARGE_INTEGER Frequency, Start, Now;
+    ULONGLONG Calls = 0;
+    double Elapsed;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    do
+    {
+        if (!RunOp(Op, Dest, Source))
+        {
+            printf("%-28s failed, error %lu\n", Name, GetLastError());
+            return;
+        }
+        GdiFlush();
+        Calls++;
+        QueryPerformanceCounter(&Now);
+    } while ((ULONGLONG)(Now.QuadPart - Start.QuadPart) < Seconds * (ULONGLONG)Frequency.QuadPart);
+
+    Elapsed = (double)(Now.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+    printf("%-28s %8.1f Mpixel/s  %8.2f ms/call\n",
+           Name, Calls * Pixels / Elapsed / 1e6, Elapsed * 1000.0 / Calls);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const WORD BitCounts[] = { 16, 24, 32 };
+    BENCH_SURFACE Dest, Source;
+    ULONG Seconds = 1;
+    ULONG Index;
+    char Name[64];
+
+    if (argc > 1)
+        Seconds = strtoul(argv[1], NULL, 0);
+    if (Seconds == 0)
+    {
+        printf("Usage: dibbench [seconds]\n");
+        return 1;
+    }
+
+    for (Index = 0; Index < sizeof(BitCounts) / sizeof(BitCounts[0]); Index++)
+    {
+        if (!CreateSurface(&Source, SRC_WIDTH, SRC_HEIGHT, BitCounts[Index]))
+            return 2;
+        if (!CreateSurface(&Dest, DST_WIDTH, DST_HEIGHT, BitCounts[Index]))
+        {
+            DestroySurface(&Source);
+            return 2;
+        }
+
+        sprintf(Name, "stretch %ubpp", BitCounts[Index]);
+        Measure(Name, OpStretch, &Dest, &Source, DST_WIDTH * DST_HEIGHT, Seconds);
+        sprintf(Name, "stretch %ubpp mirrored", BitCounts[Index]);
+        Measure(Name, OpStretchMirrored, &Dest, &Source, DST_WIDTH * DST_HEIGHT, Seconds);
+
+        if (BitCounts[Index] == 32)
+        {
+            Measure("blend per-pixel", OpBlendPerPixel, &Dest, &Source,
+                    (SRC_WIDTH - 1) * SRC_HEIGHT, Seconds);
+            Measure("blend per-pixel stretched", OpBlendPerPixelStretched, &Dest, &Source,
+                    (SRC_WIDTH - 1) * SRC_HEIGHT, Seconds);
+            Measure("blend constant", OpBlendConstant, &Dest, &Source,
+                    (SRC_WIDTH - 1) * SRC_HEIGHT, Seconds);
+            Measure("blend constant stretched", OpBlendConstantStretched, &Dest, &Source,
+                    (SRC_WIDTH - 1) * SRC_HEIGHT, Seconds);
+        }
+
+        DestroySurface(&Dest);
+        DestroySurface(&Source);
+    }
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * PROJECT:     ReactOS Tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Times creating, opening and deleting files in a large directory
+ *
+ * Creates the files in a new directory in the temporary directory, opens
+ * them out of order, looks up missing names, deletes every third one and
+ * creates it again, then deletes them all. The long names take three
+ * directory entries each, so at most 20000 of them fit in a FAT directory.
+ * Run
+ *
+ *   dirbench [files]
+ *
+ * which defaults to 10000 files.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <windef.h>
+#include <winbase.h>
+#include <strsafe.h>
+
+#define MAX_FILES 20000
+
+static WCHAR DirectoryPath[MAX_PATH];
+
+static
+VOID
+GetFilePath(PWSTR Buffer, SIZE_T Count, PCWSTR Format, ULONG Index)
+{
+    WCHAR FileName[64];
+
+    StringCchPrintfW(FileName, _countof(FileName), Format, Index);
+    StringCchPrintfW(Buffer, Count, L"%s\\%s", DirectoryPath, FileName);
+}
+
+static
+ULONG
+CreateFiles(ULONG First, ULONG Last, ULONG Step)
+{
+    WCHAR Path[MAX_PATH];
+    HANDLE Handle;
+    ULONG Index, Failures = 0;
+
+    for (Index = First; Index < Last; Index += Step)
+    {
+        GetFilePath(Path, _countof(Path), L"Long file name %05lu.txt", Index);
+        Handle = CreateFileW(Path, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (Handle == INVALID_HANDLE_VALUE)
+            Failures++;
+        else
+            CloseHandle(Handle);
+    }
+
+    return Failures;
+}
+
+static
+ULONG
+OpenFiles(PCWSTR Format, ULONG Count, ULONG Step)
+{
+    WCHAR Path[MAX_PATH];
+    HANDLE Handle;
+    ULONG Index, Round, Found = 0;
+
+    /* Open the files out of order, like a tree walk would */
+    for (Round = 0; Round < Step; Round++)
+    {
+        for (Index = Round; Index < Count; Index += Step)
+        {
+            GetFilePath(Path, _countof(Path), Format, Index);
+            Handle = CreateFileW(Path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+            if (Handle != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(Handle);
+                Found++;
+            }
+        }
+    }
+
+    return Found;
+}
+
+static
+ULONG
+DeleteFiles(ULONG First, ULONG Last, ULONG Step)
+{
+    WCHAR Path[MAX_PATH];
+    ULONG Index, Failures = 0;
+
+    for (Index = First; Index < Last; Index += Step)
+    {
+        GetFilePath(Path, _countof(Path), L"Long file name %05lu.txt", Index);
+        Failures += !DeleteFileW(Path);
+    }
+
+    return Failures;
+}
+
+int
+wmain(int argc, WCHAR *argv[])
+{
+    WCHAR TempPath[MAX_PATH], Root[4], FileSystem[32];
+    ULONG Files = 10000, Start, Result;
+
+    if (argc > 1)
+        Files = wcstoul(argv[1], NULL, 0);
+
+    if (Files == 0 || Files > MAX_FILES)
+    {
+        printf("Usage: dirbench [files], with at most %u files\n", MAX_FILES);
+        return 1;
+    }
+
+    GetTempPathW(_countof(TempPath), TempPath);
+    StringCchPrintfW(DirectoryPath, _countof(DirectoryPath), L"%sdirbench", TempPath);
+    if (!CreateDirectoryW(DirectoryPath, NULL))
+    {
+        printf("Could not create %S (error %lu)\n", DirectoryPath, GetLastError());
+        return 2;
+    }
+
+    StringCchCopyNW(Root, _countof(Root), TempPath, 3);
+    if (!GetVolumeInformationW(Root, NULL, 0, NULL, NULL, NULL, FileSystem, _countof(FileSystem)))
+        StringCchCopyW(FileSystem, _countof(FileSystem), L"?");
+    printf("%lu files in %S on %S\n", Files, DirectoryPath, FileSystem);
+
+    Start = GetTickCount();
+    Result = CreateFiles(0, Files, 1);
+    printf("  created the files in %lu ms, %lu failed\n", GetTickCount() - Start, Result);
+
+    Start = GetTickCount();
+    Result = OpenFiles(L"Long file name %05lu.txt", Files, 7);
+    printf("  opened the files in %lu ms, %lu found\n", GetTickCount() - Start, Result);
+
+    Start = GetTickCount();
+    Result = OpenFiles(L"Missing file %05lu.txt", Files / 10, 1);
+    printf("  looked up %lu missing files in %lu ms, %lu found\n", Files / 10, GetTickCount() - Start, Result);
+
+    /* Punch holes in the directory and fill them again */
+    Start = GetTickCount();
+    Result = DeleteFiles(0, Files, 3) + CreateFiles(0, Files, 3);
+    printf("  deleted and created %lu files in %lu ms, %lu failed\n", (Files + 2) / 3, GetTickCount() - Start, Result);
+
+    Start = GetTickCount();
+    Result = DeleteFiles(0, Files, 1);
+    printf("  deleted the files in %lu ms, %lu failed\n", GetTickCount() - Start, Result);
+
+    RemoveDirectoryW(DirectoryPath);
+    return 0;
+}
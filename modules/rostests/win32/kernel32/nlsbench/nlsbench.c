@@ -0,0 +1,245 @@
+/*
+ * PROJECT:     ReactOS Tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Throughput of the NLS string conversions on text in several scripts
+ *
+ * Builds corpora of English, Western European, Russian and CJK lines and of
+ * mixed ones (log lines and paths with a few words of another script in
+ * them) and converts each between UTF-16 and UTF-8 and between UTF-16 and
+ * the ANSI code page, with MultiByteToWideChar and WideCharToMultiByte as
+ * well as the ntdll functions they are built on where ntdll exports them.
+ * The megabytes of input converted per second are printed for every corpus
+ * and conversion.
+ * Run
+ *
+ *   nlsbench [megabytes] [runs]
+ *
+ * which defaults to corpora of 8 MB of UTF-16 and the best of 5 runs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <windef.h>
+#include <winbase.h>
+#include <winnls.h>
+
+typedef LONG (WINAPI *PRTL_TO_UNICODE)(PWCH, ULONG, PULONG, PCCH, ULONG);
+typedef LONG (WINAPI *PRTL_FROM_UNICODE)(PCH, ULONG, PULONG, PCWCH, ULONG);
+
+typedef struct _BENCH_CORPUS
+{
+    const char *Name;
+    const WCHAR *Lines[4];
+} BENCH_CORPUS;
+
+static const BENCH_CORPUS Corpora[] =
+{
+    { "ascii",
+      { L"2024-05-17 12:34:56 INFO  request served in 12 ms for /api/v1/items?id=4711\r\n",
+        L"static int compare(const void *a, const void *b) { return *(int *)a - *(int *)b; }\r\n",
+        L"The quick brown fox jumps over the lazy dog, then it naps in the sun.\r\n" } },
+    { "latin",
+      { L"Le caf\u00e9 de la gare \u00e9tait ferm\u00e9, alors nous sommes all\u00e9s \u00e0 l'h\u00f4tel.\r\n",
+        L"Gr\u00fc\u00dfe aus M\u00fcnchen, die Stra\u00dfe vor dem B\u00fcro ist sch\u00f6n.\r\n",
+        L"El ni\u00f1o comi\u00f3 una manzana en la estaci\u00f3n de tren.\r\n" } },
+    { "cyrillic",
+      { L"\u041f\u0440\u0438\u0432\u0435\u0442! \u042d\u0442\u043e \u043f\u0440\u0438\u043c\u0435\u0440 "
+        L"\u043e\u0431\u044b\u0447\u043d\u043e\u0433\u043e \u0442\u0435\u043a\u0441\u0442\u0430 "
+        L"\u043d\u0430 \u0440\u0443\u0441\u0441\u043a\u043e\u043c \u044f\u0437\u044b\u043a\u0435.\r\n",
+        L"\u0424\u0430\u0439\u043b \u043e\u0442\u043a\u0440\u044b\u0442 \u0434\u043b\u044f "
+        L"\u0447\u0442\u0435\u043d\u0438\u044f, \u0440\u0430\u0437\u043c\u0435\u0440 1024 "
+        L"\u0431\u0430\u0439\u0442\u0430.\r\n" } },
+    { "cjk",
+      { L"\u65e5\u672c\u8a9e\u306e\u30c6\u30ad\u30b9\u30c8\u306e\u4f8b\u3067\u3059\u3002"
+        L"\u6771\u4eac\u306f\u4eca\u65e5\u3082\u6674\u308c\u3066\u3044\u307e\u3059\u3002\r\n",
+        L"\u6587\u4ef6\u5df2\u6210\u529f\u4fdd\u5b58\u5230\u684c\u9762\u4e0a\u7684"
+        L"\u6587\u4ef6\u5939\u4e2d\uff0c\u8bf7\u68c0\u67e5\u3002\r\n" } },
+    { "mixed",
+      { L"2024-05-17 12:34:56 WARN  could not open C:\\Users\\\u0418\u0432\u0430\u043d\\"
+        L"\u0414\u043e\u043a\u0443\u043c\u0435\u043d\u0442\u044b\\report.txt\r\n",
+        L"2024-05-17 12:34:57 INFO  \u30d5\u30a1\u30a4\u30eb \"\u30c7\u30fc\u30bf.csv\" "
+        L"saved (0x80070002)\r\n",
+        L"    /* Caf\u00e9 menu parser, see the sample in test\\men\u00fc.xml */\r\n",
+        L"2024-05-17 12:34:58 INFO  request served in 12 ms for /api/v1/items?id=4712\r\n" } },
+};
+
+/* Fills Buffer with the lines of the corpus over and over, returns the characters */
+static
+ULONG
+FillCorpus(const BENCH_CORPUS *Corpus, PWCHAR Buffer, ULONG Size)
+{
+    ULONG Length = 0, Index = 0, LineLength;
+
+    for (;;)
+    {
+        if (Index == ARRAYSIZE(Corpus->Lines) || !Corpus->Lines[Index])
+            Index = 0;
+
+        LineLength = (ULONG)wcslen(Corpus->Lines[Index]);
+        if (Length + LineLength > Size)
+            return Length;
+
+        memcpy(Buffer + Length, Corpus->Lines[Index], LineLength * sizeof(WCHAR));
+        Length += LineLength;
+        Index++;
+    }
+}
+
+static LARGE_INTEGER Frequency, Start;
+
+static
+VOID
+StartTimer(VOID)
+{
+    QueryPerformanceCounter(&Start);
+}
+
+/* Keeps the time since StartTimer if it is the best of the runs so far */
+static
+VOID
+StopTimer(double *Best, ULONG Run)
+{
+    LARGE_INTEGER End;
+    double Seconds;
+
+    QueryPerformanceCounter(&End);
+    Seconds = (double)(End.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+    if (Run == 0 || Seconds < *Best)
+        *Best = Seconds;
+}
+
+static
+VOID
+PrintRate(const char *Corpus, const char *Conversion, ULONG Bytes, double Seconds)
+{
+    printf("%-9s %-28s %10.1f MB/s\n", Corpus, Conversion,
+           Seconds > 0 ? Bytes / Seconds / (1024 * 1024) : 0.0);
+}
+
+int
+wmain(int argc, WCHAR *argv[])
+{
+    ULONG Megabytes = 8, Runs = 5, Run, Index;
+    ULONG Size, Length, Utf8Length, AnsiLength, Done;
+    PWCHAR Wide, WideOut;
+    PCHAR Utf8, Ansi;
+    HMODULE Ntdll;
+    PRTL_TO_UNICODE RtlMultiByteToUnicodeN, RtlUTF8ToUnicodeN;
+    PRTL_FROM_UNICODE RtlUnicodeToMultiByteN, RtlUnicodeToUTF8N;
+    double Best = 0;
+
+    if (argc > 1)
+        Megabytes = wcstoul(argv[1], NULL, 0);
+    if (argc > 2)
+        Runs = wcstoul(argv[2], NULL, 0);
+
+    if (Megabytes == 0 || Megabytes > 256 || Runs == 0)
+    {
+        printf("Usage: nlsbench [megabytes] [runs]\n");
+        return 1;
+    }
+
+    Ntdll = GetModuleHandleW(L"ntdll.dll");
+    RtlMultiByteToUnicodeN = (PRTL_TO_UNICODE)GetProcAddress(Ntdll, "RtlMultiByteToUnicodeN");
+    RtlUnicodeToMultiByteN = (PRTL_FROM_UNICODE)GetProcAddress(Ntdll, "RtlUnicodeToMultiByteN");
+    RtlUTF8ToUnicodeN = (PRTL_TO_UNICODE)GetProcAddress(Ntdll, "RtlUTF8ToUnicodeN");
+    RtlUnicodeToUTF8N = (PRTL_FROM_UNICODE)GetProcAddress(Ntdll, "RtlUnicodeToUTF8N");
+
+    /* UTF-8 and DBCS take at most 3 bytes for a UTF-16 character */
+    Size = Megabytes * 1024 * 1024 / sizeof(WCHAR);
+    Wide = malloc(Size * sizeof(WCHAR));
+    WideOut = malloc(Size * sizeof(WCHAR));
+    Utf8 = malloc(Size * 3);
+    Ansi = malloc(Size * 3);
+    if (!Wide || !WideOut || !Utf8 || !Ansi)
+    {
+        printf("Out of memory\n");
+        return 2;
+    }
+
+    QueryPerformanceFrequency(&Frequency);
+    printf("%lu MB corpora, ANSI code page %u\n", Megabytes, GetACP());
+
+    for (Index = 0; Index < ARRAYSIZE(Corpora); Index++)
+    {
+        Length = FillCorpus(&Corpora[Index], Wide, Size);
+        Utf8Length = WideCharToMultiByte(CP_UTF8, 0, Wide, Length, Utf8, Size * 3, NULL, NULL);
+        AnsiLength = WideCharToMultiByte(CP_ACP, 0, Wide, Length, Ansi, Size * 3, NULL, NULL);
+
+        for (Run = 0; Run < Runs; Run++)
+        {
+            StartTimer();
+            MultiByteToWideChar(CP_UTF8, 0, Utf8, Utf8Length, WideOut, Size);
+            StopTimer(&Best, Run);
+        }
+        PrintRate(Corpora[Index].Name, "MultiByteToWideChar UTF-8", Utf8Length, Best);
+
+        for (Run = 0; Run < Runs; Run++)
+        {
+            StartTimer();
+            WideCharToMultiByte(CP_UTF8, 0, Wide, Length, Utf8, Size * 3, NULL, NULL);
+            StopTimer(&Best, Run);
+        }
+        PrintRate(Corpora[Index].Name, "WideCharToMultiByte UTF-8", Length * sizeof(WCHAR), Best);
+
+        for (Run = 0; Run < Runs; Run++)
+        {
+            StartTimer();
+            MultiByteToWideChar(CP_ACP, 0, Ansi, AnsiLength, WideOut, Size);
+            StopTimer(&Best, Run);
+        }
+        PrintRate(Corpora[Index].Name, "MultiByteToWideChar ANSI", AnsiLength, Best);
+
+        for (Run = 0; Run < Runs; Run++)
+        {
+            StartTimer();
+            WideCharToMultiByte(CP_ACP, 0, Wide, Length, Ansi, Size * 3, NULL, NULL);
+            StopTimer(&Best, Run);
+        }
+        PrintRate(Corpora[Index].Name, "WideCharToMultiByte ANSI", Length * sizeof(WCHAR), Best);
+
+        if (RtlMultiByteToUnicodeN && RtlUnicodeToMultiByteN)
+        {
+            for (Run = 0; Run < Runs; Run++)
+            {
+                StartTimer();
+                RtlMultiByteToUnicodeN(WideOut, Size * sizeof(WCHAR), &Done, Ansi, AnsiLength);
+                StopTimer(&Best, Run);
+            }
+            PrintRate(Corpora[Index].Name, "RtlMultiByteToUnicodeN", AnsiLength, Best);
+
+            for (Run = 0; Run < Runs; Run++)
+            {
+                StartTimer();
+                RtlUnicodeToMultiByteN(Ansi, Size * 3, &Done, Wide, Length * sizeof(WCHAR));
+                StopTimer(&Best, Run);
+            }
+            PrintRate(Corpora[Index].Name, "RtlUnicodeToMultiByteN", Length * sizeof(WCHAR), Best);
+        }
+
+        if (RtlUTF8ToUnicodeN && RtlUnicodeToUTF8N)
+        {
+            for (Run = 0; Run < Runs; Run++)
+            {
+                StartTimer();
+                RtlUTF8ToUnicodeN(WideOut, Size * sizeof(WCHAR), &Done, Utf8, Utf8Length);
+                StopTimer(&Best, Run);
+            }
+            PrintRate(Corpora[Index].Name, "RtlUTF8ToUnicodeN", Utf8Length, Best);
+
+            for (Run = 0; Run < Runs; Run++)
+            {
+                StartTimer();
+                RtlUnicodeToUTF8N(Utf8, Size * 3, &Done, Wide, Length * sizeof(WCHAR));
+                StopTimer(&Best, Run);
+            }
+            PrintRate(Corpora[Index].Name, "RtlUnicodeToUTF8N", Length * sizeof(WCHAR), Best);
+        }
+    }
+
+    free(Wide);
+    free(WideOut);
+    free(Utf8);
+    free(Ansi);
+    return 0;
+}
@@ -0,0 +1,269 @@
+/*
+ * PROJECT:     ReactOS Tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Timer latency and idle wake up time at several timer resolutions
+ *
+ * At the default timer resolution, at 1 ms and at the finest resolution the
+ * HAL offers, measures how long Sleep(1) takes, how late a 1 ms waitable
+ * timer is signaled, and how long a thread waiting on another processor
+ * takes to run after its event is set while that processor was idle. It also
+ * counts the clock interrupts every processor takes while the system is idle,
+ * which drop on the idle processors when the clock IPI skips them. The times
+ * come from QueryPerformanceCounter.
+ * Under QEMU, run it with -smp 2 or more, booted with and without /USEHPET
+ * to compare the HPET clock with the RTC one. Run
+ *
+ *   timerbench [waits]
+ *
+ * which defaults to 200 waits of each kind at each resolution.
+ */
+
+#define WIN32_NO_STATUS
+#include <stdio.h>
+#include <stdlib.h>
+#include <windef.h>
+#include <winbase.h>
+#include <ndk/ntndk.h>
+
+#define MAX_PROCESSORS 64
+
+typedef struct _BENCH_LATENCY
+{
+    double Minimum;
+    double Maximum;
+    double Total;
+    ULONG Count;
+} BENCH_LATENCY;
+
+static LARGE_INTEGER Frequency;
+static HANDLE WakeEvent, WokenEvent;
+static LARGE_INTEGER WokenTime;
+
+static
+double
+Microseconds(LONGLONG Ticks)
+{
+    return (double)Ticks * 1000000 / Frequency.QuadPart;
+}
+
+static
+VOID
+AddSample(BENCH_LATENCY *Latency, double Sample)
+{
+    if (Latency->Count == 0 || Sample < Latency->Minimum)
+        Latency->Minimum = Sample;
+    if (Latency->Count == 0 || Sample > Latency->Maximum)
+        Latency->Maximum = Sample;
+    Latency->Total += Sample;
+    Latency->Count++;
+}
+
+static
+VOID
+PrintLatency(const char *Name, const BENCH_LATENCY *Latency)
+{
+    printf("  %-24s min %9.1f us  avg %9.1f us  max %9.1f us\n", Name,
+           Latency->Minimum, Latency->Total / Latency->Count, Latency->Maximum);
+}
+
+static
+VOID
+MeasureSleep(ULONG Waits)
+{
+    BENCH_LATENCY Latency = { 0 };
+    LARGE_INTEGER Start, End;
+    ULONG Wait;
+
+    for (Wait = 0; Wait < Waits; Wait++)
+    {
+        QueryPerformanceCounter(&Start);
+        Sleep(1);
+        QueryPerformanceCounter(&End);
+        AddSample(&Latency, Microseconds(End.QuadPart - Start.QuadPart));
+    }
+
+    PrintLatency("Sleep(1) takes", &Latency);
+}
+
+static
+VOID
+MeasureWaitableTimer(HANDLE Timer, ULONG Waits)
+{
+    BENCH_LATENCY Latency = { 0 };
+    LARGE_INTEGER DueTime, Start, End;
+    ULONG Wait;
+
+    /* 1 ms from now */
+    DueTime.QuadPart = -10000;
+
+    for (Wait = 0; Wait < Waits; Wait++)
+    {
+        QueryPerformanceCounter(&Start);
+        SetWaitableTimer(Timer, &DueTime, 0, NULL, NULL, FALSE);
+        WaitForSingleObject(Timer, INFINITE);
+        QueryPerformanceCounter(&End);
+        AddSample(&Latency, Microseconds(End.QuadPart - Start.QuadPart) - 1000);
+    }
+
+    PrintLatency("1 ms timer is late by", &Latency);
+}
+
+/* Runs on the second processor and notes when it gets to run */
+static
+DWORD
+WINAPI
+WakeThread(PVOID Parameter)
+{
+    for (;;)
+    {
+        WaitForSingleObject(WakeEvent, INFINITE);
+        QueryPerformanceCounter(&WokenTime);
+        SetEvent(WokenEvent);
+    }
+}
+
+static
+VOID
+MeasureIdleWakeup(ULONG Waits)
+{
+    BENCH_LATENCY Latency = { 0 };
+    LARGE_INTEGER Start;
+    ULONG Wait;
+
+    for (Wait = 0; Wait < Waits; Wait++)
+    {
+        /* Give the second processor the time to go idle */
+        Sleep(20);
+
+        QueryPerformanceCounter(&Start);
+        SetEvent(WakeEvent);
+        WaitForSingleObject(WokenEvent, INFINITE);
+        AddSample(&Latency, Microseconds(WokenTime.QuadPart - Start.QuadPart));
+    }
+
+    PrintLatency("idle processor wakes in", &Latency);
+}
+
+/* Prints the clock interrupts per second of each processor over 2 idle seconds */
+static
+VOID
+MeasureIdleInterrupts(ULONG Processors)
+{
+    static SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION Before[MAX_PROCESSORS], After[MAX_PROCESSORS];
+    LONGLONG Idle, Total;
+    ULONG Processor;
+
+    if (!NT_SUCCESS(NtQuerySystemInformation(SystemProcessorPerformanceInformation, Before,
+                                             Processors * sizeof(Before[0]), NULL)))
+    {
+        return;
+    }
+    Sleep(2000);
+    if (!NT_SUCCESS(NtQuerySystemInformation(SystemProcessorPerformanceInformation, After,
+                                             Processors * sizeof(After[0]), NULL)))
+    {
+        return;
+    }
+
+    for (Processor = 0; Processor < Processors; Processor++)
+    {
+        /* The kernel time includes the idle time */
+        Idle = After[Processor].IdleTime.QuadPart - Before[Processor].IdleTime.QuadPart;
+        Total = After[Processor].KernelTime.QuadPart - Before[Processor].KernelTime.QuadPart +
+                After[Processor].UserTime.QuadPart - Before[Processor].UserTime.QuadPart;
+
+        printf("  processor %-2lu %18.1f interrupts/s %9.1f%% idle\n", Processor,
+               (After[Processor].InterruptCount - Before[Processor].InterruptCount) / 2.0,
+               Total > 0 ? (double)Idle * 100 / Total : 0.0);
+    }
+}
+
+int
+wmain(int argc, WCHAR *argv[])
+{
+    ULONG Waits = 200, Coarsest, Finest, Current, Actual, Index;
+    ULONG Resolutions[3];
+    SYSTEM_INFO SystemInfo;
+    HANDLE Timer, Thread;
+    ULONG Processors;
+
+    if (argc > 1)
+        Waits = wcstoul(argv[1], NULL, 0);
+
+    if (Waits == 0)
+    {
+        printf("Usage: timerbench [waits]\n");
+        return 1;
+    }
+
+    GetSystemInfo(&SystemInfo);
+    Processors = min(SystemInfo.dwNumberOfProcessors, MAX_PROCESSORS);
+
+    if (!NT_SUCCESS(NtQueryTimerResolution(&Coarsest, &Finest, &Current)))
+    {
+        printf("Could not query the timer resolution\n");
+        return 2;
+    }
+
+    Timer = CreateWaitableTimerW(NULL, FALSE, NULL);
+    WakeEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+    WokenEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+    if (!Timer || !WakeEvent || !WokenEvent)
+    {
+        printf("Could not create the timer and events\n");
+        return 2;
+    }
+
+    /* Keep this thread on the first processor and the woken one on the second */
+    SetThreadAffinityMask(GetCurrentThread(), 1);
+    Thread = NULL;
+    if (Processors > 1)
+    {
+        Thread = CreateThread(NULL, 0, WakeThread, NULL, CREATE_SUSPENDED, NULL);
+        if (Thread)
+        {
+            SetThreadAffinityMask(Thread, 2);
+            SetThreadPriority(Thread, THREAD_PRIORITY_HIGHEST);
+            ResumeThread(Thread);
+        }
+    }
+
+    QueryPerformanceFrequency(&Frequency);
+    printf("%lu processors, timer resolution %.3f ms to %.3f ms, now %.3f ms, %lu waits\n",
+           Processors, Finest / 10000.0, Coarsest / 10000.0, Current / 10000.0, Waits);
+
+    /* The default, 1 ms and the finest resolution */
+    Resolutions[0] = 0;
+    Resolutions[1] = max(10000, Finest);
+    Resolutions[2] = Finest;
+
+    for (Index = 0; Index < ARRAYSIZE(Resolutions); Index++)
+    {
+        if (Index == 2 && Resolutions[2] == Resolutions[1])
+            break;
+
+        Actual = Current;
+        if (Resolutions[Index])
+            NtSetTimerResolution(Resolutions[Index], TRUE, &Actual);
+        printf("Timer resolution %.3f ms\n", Actual / 10000.0);
+
+        MeasureSleep(Waits);
+        MeasureWaitableTimer(Timer, Waits);
+        if (Thread)
+            MeasureIdleWakeup(Waits);
+        MeasureIdleInterrupts(Processors);
+
+        if (Resolutions[Index])
+            NtSetTimerResolution(Resolutions[Index], FALSE, &Actual);
+    }
+
+    if (Thread)
+    {
+        TerminateThread(Thread, 0);
+        CloseHandle(Thread);
+    }
+    CloseHandle(WokenEvent);
+    CloseHandle(WakeEvent);
+    CloseHandle(Timer);
+    return 0;
+}
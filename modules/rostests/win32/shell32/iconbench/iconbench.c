@@ -0,0 +1,168 @@
+/*
+ * PROJECT:     ReactOS Tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Icon lookup latency of a folder with a cold and a warm icon cache
+ *
+ * Looks up the small system image list icon of every file of a folder with
+ * SHGetFileInfo, which is what a folder window does for the items it shows,
+ * in a new process each time so that shell32 starts with an empty icon
+ * list. The first run starts without the icon cache file in the local
+ * application data folder and extracts every icon from its file, the ones
+ * after it find them in the file the runs before wrote when they exited.
+ * The milliseconds for the whole folder and per file are printed for the
+ * cold run and the best warm one. Run
+ *
+ *   iconbench [folder] [runs]
+ *
+ * which defaults to the system directory and 3 warm runs. Note that this
+ * deletes the icon cache file of the current user.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <windef.h>
+#include <winbase.h>
+#include <winuser.h>
+#include <shellapi.h>
+#include <shlobj.h>
+
+/* Looks up the icons of the folder's files and prints how long it took */
+static
+int
+RunChild(const WCHAR *Folder)
+{
+    WCHAR Path[MAX_PATH];
+    WIN32_FIND_DATAW FindData;
+    LARGE_INTEGER Frequency, Start, End;
+    SHFILEINFOW FileInfo;
+    HANDLE Find;
+    ULONG Files = 0;
+
+    /* Set up the icon cache outside of the measurement */
+    SHGetFileInfoW(Folder, 0, &FileInfo, sizeof(FileInfo), SHGFI_SYSICONINDEX | SHGFI_SMALLICON);
+
+    swprintf(Path, L"%s\\*", Folder);
+    Find = FindFirstFileW(Path, &FindData);
+    if (Find == INVALID_HANDLE_VALUE)
+        return 2;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    do
+    {
+        if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            continue;
+
+        swprintf(Path, L"%s\\%s", Folder, FindData.cFileName);
+        SHGetFileInfoW(Path, 0, &FileInfo, sizeof(FileInfo), SHGFI_SYSICONINDEX | SHGFI_SMALLICON);
+        Files++;
+    } while (FindNextFileW(Find, &FindData));
+    QueryPerformanceCounter(&End);
+    FindClose(Find);
+
+    printf("%lu %.3f\n", Files,
+           (double)(End.QuadPart - Start.QuadPart) * 1000 / Frequency.QuadPart);
+    return 0;
+}
+
+/* Runs this program on the folder in a new process and reads what it printed */
+static
+BOOL
+RunParent(const WCHAR *Folder, ULONG *Files, double *Milliseconds)
+{
+    WCHAR Module[MAX_PATH], CommandLine[MAX_PATH * 3];
+    SECURITY_ATTRIBUTES Inherit = { sizeof(Inherit), NULL, TRUE };
+    PROCESS_INFORMATION ProcessInfo;
+    STARTUPINFOW StartupInfo;
+    HANDLE Read, Write;
+    char Output[128];
+    DWORD Length = 0, Done;
+    BOOL Success;
+
+    if (!CreatePipe(&Read, &Write, &Inherit, 0))
+        return FALSE;
+    SetHandleInformation(Read, HANDLE_FLAG_INHERIT, 0);
+
+    ZeroMemory(&StartupInfo, sizeof(StartupInfo));
+    StartupInfo.cb = sizeof(StartupInfo);
+    StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+    StartupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    StartupInfo.hStdOutput = Write;
+    StartupInfo.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+    GetModuleFileNameW(NULL, Module, ARRAYSIZE(Module));
+    swprintf(CommandLine, L"\"%s\" /child \"%s\"", Module, Folder);
+
+    Success = CreateProcessW(NULL, CommandLine, NULL, NULL, TRUE, 0, NULL, NULL,
+                             &StartupInfo, &ProcessInfo);
+    CloseHandle(Write);
+    if (Success)
+    {
+        while (Length < sizeof(Output) - 1 &&
+               ReadFile(Read, Output + Length, sizeof(Output) - 1 - Length, &Done, NULL) && Done)
+        {
+            Length += Done;
+        }
+
+        /* The icon cache file is written when the process exits */
+        WaitForSingleObject(ProcessInfo.hProcess, INFINITE);
+        CloseHandle(ProcessInfo.hThread);
+        CloseHandle(ProcessInfo.hProcess);
+    }
+    CloseHandle(Read);
+
+    Output[Length] = 0;
+    return Success && sscanf(Output, "%lu %lf", Files, Milliseconds) == 2;
+}
+
+int
+wmain(int argc, WCHAR *argv[])
+{
+    WCHAR Folder[MAX_PATH], CacheFile[MAX_PATH];
+    ULONG Runs = 3, Run, Files;
+    double Cold, Warm, Best = 0;
+
+    if (argc > 2 && !wcscmp(argv[1], L"/child"))
+        return RunChild(argv[2]);
+
+    if (argc > 1)
+        wcscpy(Folder, argv[1]);
+    else
+        GetSystemDirectoryW(Folder, ARRAYSIZE(Folder));
+    if (argc > 2)
+        Runs = wcstoul(argv[2], NULL, 0);
+
+    if (Runs == 0 || GetFileAttributesW(Folder) == INVALID_FILE_ATTRIBUTES)
+    {
+        printf("Usage: iconbench [folder] [runs]\n");
+        return 1;
+    }
+
+    if (SUCCEEDED(SHGetFolderPathW(NULL, CSIDL_LOCAL_APPDATA, NULL, SHGFP_TYPE_CURRENT, CacheFile)))
+    {
+        wcscat(CacheFile, L"\\IconCache.db");
+        DeleteFileW(CacheFile);
+    }
+
+    if (!RunParent(Folder, &Files, &Cold))
+    {
+        printf("Could not run the lookups\n");
+        return 2;
+    }
+
+    for (Run = 0; Run < Runs; Run++)
+    {
+        if (!RunParent(Folder, &Files, &Warm))
+        {
+            printf("Could not run the lookups\n");
+            return 2;
+        }
+        if (Run == 0 || Warm < Best)
+            Best = Warm;
+    }
+
+    printf("%lu files in %ls\n", Files, Folder);
+    printf("cold %10.1f ms %8.3f ms per file\n", Cold, Files ? Cold / Files : 0.0);
+    printf("warm %10.1f ms %8.3f ms per file\n", Best, Files ? Best / Files : 0.0);
+    return 0;
+}
@@ -0,0 +1,367 @@
+/*
+ * PROJECT:     ReactOS Tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Queued random and sequential I/O throughput of a disk
+ *
+ * A small fio-like load generator: it keeps a fixed number of unbuffered
+ * overlapped requests in flight against a PhysicalDrive and reports IOPS,
+ * throughput and the mean completion latency. It is meant for comparing
+ * storage miniports. For virtio-blk with QEMU:
+ *
+ *   qemu-img create -f raw disk.img 1G
+ *   qemu-system-x86_64 ... -drive if=none,id=d0,format=raw,file=disk.img,cache=none,aio=native
+ *       -device virtio-blk-pci,drive=d0
+ *
+ * Use -device virtio-blk-pci,drive=d0,disable-legacy=on to get the modern
+ * device, -device nvme,drive=d0,serial=bench for NVMe and ide-hd or ahci
+ * for the reference figures. Then run
+ *
+ *   diskbench N randread 4 32 10
+ *
+ * where N is the number of the PhysicalDrive, followed by the pattern
+ * (read, write, randread, randwrite), the request size in KB, the number
+ * of requests kept in flight and the run time in seconds. A depth of
+ * "sweep" repeats the run at every power of two up to 64, which shows
+ * where a driver stops scaling with the queue depth.
+ * The write patterns destroy the contents of the disk.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <windef.h>
+#include <winbase.h>
+#include <winioctl.h>
+
+#define BENCH_MAX_DEPTH MAXIMUM_WAIT_OBJECTS
+
+typedef struct _BENCH_SLOT
+{
+    OVERLAPPED Overlapped;
+    PVOID Buffer;
+    LARGE_INTEGER Start;
+} BENCH_SLOT, *PBENCH_SLOT;
+
+typedef struct _BENCH
+{
+    HANDLE hDisk;
+    BOOL Write;
+    BOOL Random;
+    ULONG RequestSize;
+    ULONGLONG RequestCount;
+    ULONGLONG NextRequest;
+    ULONGLONG Seed;
+    ULONGLONG Completed;
+    ULONGLONG Failed;
+    ULONGLONG TotalLatency;
+} BENCH, *PBENCH;
+
+static
+ULONGLONG
+NextOffset(PBENCH Bench)
+{
+    ULONGLONG Request;
+
+    if (Bench->Random)
+    {
+        /* xorshift64, good enough to defeat read-ahead and host caching */
+        Bench->Seed ^= Bench->Seed << 13;
+        Bench->Seed ^= Bench->Seed >> 7;
+        Bench->Seed ^= Bench->Seed << 17;
+        Request = Bench->Seed % Bench->RequestCount;
+    }
+    else
+    {
+        Request = Bench->NextRequest++;
+        if (Bench->NextRequest == Bench->RequestCount)
+            Bench->NextRequest = 0;
+    }
+
+    return Request * Bench->RequestSize;
+}
+
+static
+BOOL
+IssueRequest(PBENCH Bench, PBENCH_SLOT Slot)
+{
+    ULONGLONG Offset;
+    BOOL Result;
+
+    Offset = NextOffset(Bench);
+    Slot->Overlapped.Offset = (DWORD)Offset;
+    Slot->Overlapped.OffsetHigh = (DWORD)(Offset >> 32);
+
+    QueryPerformanceCounter(&Slot->Start);
+
+    if (Bench->Write)
+    {
+        Result = WriteFile(Bench->hDisk,
+                           Slot->Buffer,
+                           Bench->RequestSize,
+                           NULL,
+                           &Slot->Overlapped);
+    }
+    else
+    {
+        Result = ReadFile(Bench->hDisk,
+                          Slot->Buffer,
+                          Bench->RequestSize,
+                          NULL,
+                          &Slot->Overlapped);
+    }
+
+    /* A synchronous completion still signals the event */
+    return Result || GetLastError() == ERROR_IO_PENDING;
+}
+
+static
+VOID
+ReapRequest(PBENCH Bench, PBENCH_SLOT Slot)
+{
+    LARGE_INTEGER Stop;
+    DWORD Transferred;
+
+    QueryPerformanceCounter(&Stop);
+
+    if (GetOverlappedResult(Bench->hDisk, &Slot->Overlapped, &Transferred, FALSE) &&
+        Transferred == Bench->RequestSize)
+    {
+        Bench->Completed++;
+        Bench->TotalLatency += Stop.QuadPart - Slot->Start.QuadPart;
+    }
+    else
+    {
+        Bench->Failed++;
+    }
+}
+
+static
+VOID
+RunBench(PBENCH Bench, PBENCH_SLOT Slots, HANDLE *Events, ULONG Depth, ULONG Seconds)
+{
+    LARGE_INTEGER Frequency, Start, Now;
+    ULONGLONG Deadline;
+    ULONG Issued = 0, i;
+    DWORD Wait;
+    double Elapsed;
+    BOOL Stopping = FALSE;
+
+    Bench->Completed = 0;
+    Bench->Failed = 0;
+    Bench->TotalLatency = 0;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    Deadline = Start.QuadPart + (ULONGLONG)Frequency.QuadPart * Seconds;
+
+    for (i = 0; i < Depth; i++)
+    {
+        if (!IssueRequest(Bench, &Slots[i]))
+        {
+            wprintf(L"Request failed, error %lu\n", GetLastError());
+            break;
+        }
+        Issued++;
+    }
+
+    /* Refill every slot as it completes until the time is up, then drain */
+    while (Issued != 0)
+    {
+        Wait = WaitForMultipleObjects(i, Events, FALSE, INFINITE);
+        if (Wait >= WAIT_OBJECT_0 + i)
+            break;
+
+        ReapRequest(Bench, &Slots[Wait - WAIT_OBJECT_0]);
+        ResetEvent(Events[Wait - WAIT_OBJECT_0]);
+        Issued--;
+
+        QueryPerformanceCounter(&Now);
+        if ((ULONGLONG)Now.QuadPart >= Deadline)
+            Stopping = TRUE;
+
+        if (!Stopping && IssueRequest(Bench, &Slots[Wait - WAIT_OBJECT_0]))
+            Issued++;
+    }
+
+    QueryPerformanceCounter(&Now);
+    Elapsed = (double)(Now.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+
+    wprintf(L"depth %2lu: ", Depth);
+
+    if (Bench->Completed != 0)
+    {
+        wprintf(L"%10.0f IOPS %10.2f MB/s %10.1f us mean latency",
+                Bench->Completed / Elapsed,
+                ((double)Bench->Completed * Bench->RequestSize / (1024 * 1024)) / Elapsed,
+                ((double)Bench->TotalLatency * 1000000 / Frequency.QuadPart) / Bench->Completed);
+    }
+
+    if (Bench->Failed != 0)
+        wprintf(L" %I64u requests failed", Bench->Failed);
+
+    wprintf(L"\n");
+}
+
+static
+VOID
+Usage(VOID)
+{
+    wprintf(L"Usage: diskbench <PhysicalDrive number> [read|write|randread|randwrite]\n"
+            L"                 [request KB] [depth|sweep] [seconds]\n");
+}
+
+int wmain(int argc, WCHAR *argv[])
+{
+    WCHAR DiskName[MAX_PATH];
+    DISK_GEOMETRY_EX Geometry;
+    BENCH_SLOT Slots[BENCH_MAX_DEPTH];
+    HANDLE Events[BENCH_MAX_DEPTH];
+    BENCH Bench;
+    PCWSTR Pattern = L"randread";
+    PUCHAR Buffers;
+    ULONG Depth = 32, Seconds = 10, i;
+    DWORD Returned;
+    BOOL Sweep = FALSE, Failed = FALSE;
+
+    if (argc < 2)
+    {
+        Usage();
+        return 1;
+    }
+
+    ZeroMemory(&Bench, sizeof(Bench));
+    Bench.RequestSize = 4096;
+    Bench.Seed = 0x9E3779B97F4A7C15ULL;
+
+    if (argc > 2)
+        Pattern = argv[2];
+    if (argc > 3)
+        Bench.RequestSize = wcstoul(argv[3], NULL, 10) * 1024;
+    if (argc > 4)
+    {
+        /* Slots for the deepest run are set up once and reused */
+        Sweep = !_wcsicmp(argv[4], L"sweep");
+        Depth = Sweep ? BENCH_MAX_DEPTH : wcstoul(argv[4], NULL, 10);
+    }
+    if (argc > 5)
+        Seconds = wcstoul(argv[5], NULL, 10);
+
+    if (!_wcsicmp(Pattern, L"read"))
+    {
+    }
+    else if (!_wcsicmp(Pattern, L"write"))
+    {
+        Bench.Write = TRUE;
+    }
+    else if (!_wcsicmp(Pattern, L"randread"))
+    {
+        Bench.Random = TRUE;
+    }
+    else if (!_wcsicmp(Pattern, L"randwrite"))
+    {
+        Bench.Write = TRUE;
+        Bench.Random = TRUE;
+    }
+    else
+    {
+        Usage();
+        return 1;
+    }
+
+    if (Bench.RequestSize == 0 || Depth == 0 || Depth > BENCH_MAX_DEPTH || Seconds == 0)
+    {
+        wprintf(L"The request size, depth (1-%u) and time must be positive\n", BENCH_MAX_DEPTH);
+        return 1;
+    }
+
+    _snwprintf(DiskName, MAX_PATH, L"\\\\.\\PhysicalDrive%ls", argv[1]);
+    DiskName[MAX_PATH - 1] = UNICODE_NULL;
+
+    /* Unbuffered and overlapped, so the queue depth reaches the miniport */
+    Bench.hDisk = CreateFileW(DiskName,
+                              GENERIC_READ | (Bench.Write ? GENERIC_WRITE : 0),
+                              FILE_SHARE_READ | FILE_SHARE_WRITE,
+                              NULL,
+                              OPEN_EXISTING,
+                              FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED,
+                              NULL);
+
+    if (Bench.hDisk == INVALID_HANDLE_VALUE)
+    {
+        wprintf(L"Cannot open %ls, error %lu\n", DiskName, GetLastError());
+        return 1;
+    }
+
+    if (!DeviceIoControl(Bench.hDisk,
+                         IOCTL_DISK_GET_DRIVE_GEOMETRY_EX,
+                         NULL,
+                         0,
+                         &Geometry,
+                         sizeof(Geometry),
+                         &Returned,
+                         NULL))
+    {
+        wprintf(L"Cannot get the disk size, error %lu\n", GetLastError());
+        CloseHandle(Bench.hDisk);
+        return 1;
+    }
+
+    Bench.RequestCount = Geometry.DiskSize.QuadPart / Bench.RequestSize;
+    if (Bench.RequestCount == 0 || Bench.RequestSize % Geometry.Geometry.BytesPerSector)
+    {
+        wprintf(L"Bad request size for a disk of %I64u bytes with %lu byte sectors\n",
+                Geometry.DiskSize.QuadPart,
+                Geometry.Geometry.BytesPerSector);
+        CloseHandle(Bench.hDisk);
+        return 1;
+    }
+
+    Buffers = VirtualAlloc(NULL,
+                           (SIZE_T)Bench.RequestSize * Depth,
+                           MEM_COMMIT | MEM_RESERVE,
+                           PAGE_READWRITE);
+    if (!Buffers)
+    {
+        CloseHandle(Bench.hDisk);
+        return 1;
+    }
+
+    for (i = 0; i < Depth; i++)
+    {
+        ZeroMemory(&Slots[i], sizeof(Slots[i]));
+        Slots[i].Buffer = Buffers + (SIZE_T)Bench.RequestSize * i;
+        Slots[i].Overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+        Events[i] = Slots[i].Overlapped.hEvent;
+    }
+
+    wprintf(L"%ls: %I64u MB, %ls, %lu KB requests, %lu s\n",
+            DiskName,
+            Geometry.DiskSize.QuadPart / (1024 * 1024),
+            Pattern,
+            Bench.RequestSize / 1024,
+            Seconds);
+
+    if (Sweep)
+    {
+        for (i = 1; i <= Depth; i *= 2)
+        {
+            RunBench(&Bench, Slots, Events, i, Seconds);
+            Failed |= (Bench.Failed != 0);
+        }
+    }
+    else
+    {
+        RunBench(&Bench, Slots, Events, Depth, Seconds);
+        Failed = (Bench.Failed != 0);
+    }
+
+    for (i = 0; i < Depth; i++)
+    {
+        if (Events[i])
+            CloseHandle(Events[i]);
+    }
+
+    VirtualFree(Buffers, 0, MEM_RELEASE);
+    CloseHandle(Bench.hDisk);
+
+    return Failed;
+}
@@ -0,0 +1,153 @@
+/*
+ * PROJECT:     ReactOS Tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Sequential read throughput of a USB mass storage disk
+ *
+ * The numbers are meant for comparing host controller drivers. With QEMU:
+ *
+ *   qemu-img create -f raw stick.img 1G
+ *   qemu-system-x86_64 ... -device qemu-xhci,id=xhci
+ *       -drive if=none,id=stick,format=raw,file=stick.img
+ *       -device usb-storage,bus=xhci.0,drive=stick
+ *
+ * Use -device usb-ehci,id=ehci and bus=ehci.0 to get the EHCI figures.
+ * Then run "usbstorbench N" where N is the number of the PhysicalDrive.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <windef.h>
+#include <winbase.h>
+#include <winioctl.h>
+
+#define BENCH_TOTAL_BYTES (64 * 1024 * 1024)
+
+static const ULONG RequestSizes[] = { 4096, 16384, 65536, 262144, 1048576 };
+
+static
+BOOL
+ReadDisk(HANDLE hDisk,
+         PVOID Buffer,
+         ULONG RequestSize,
+         ULONGLONG DiskSize,
+         double *MBytesPerSecond)
+{
+    LARGE_INTEGER Frequency, Start, Stop;
+    LARGE_INTEGER Offset;
+    ULONGLONG Total, Done = 0;
+    DWORD Read;
+
+    Total = min(DiskSize, BENCH_TOTAL_BYTES);
+    Total -= Total % RequestSize;
+
+    if (Total == 0)
+        return FALSE;
+
+    Offset.QuadPart = 0;
+    if (!SetFilePointerEx(hDisk, Offset, NULL, FILE_BEGIN))
+        return FALSE;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    while (Done < Total)
+    {
+        if (!ReadFile(hDisk, Buffer, RequestSize, &Read, NULL) || Read != RequestSize)
+            return FALSE;
+
+        Done += Read;
+    }
+
+    QueryPerformanceCounter(&Stop);
+
+    *MBytesPerSecond = ((double)Done / (1024 * 1024)) /
+                       ((double)(Stop.QuadPart - Start.QuadPart) / Frequency.QuadPart);
+
+    return TRUE;
+}
+
+int wmain(int argc, WCHAR *argv[])
+{
+    WCHAR DiskName[MAX_PATH];
+    DISK_GEOMETRY_EX Geometry;
+    HANDLE hDisk;
+    PVOID Buffer;
+    DWORD Returned;
+    double MBytesPerSecond;
+    ULONG i;
+
+    if (argc < 2)
+    {
+        wprintf(L"Usage: usbstorbench <PhysicalDrive number>\n");
+        return 1;
+    }
+
+    _snwprintf(DiskName, MAX_PATH, L"\\\\.\\PhysicalDrive%ls", argv[1]);
+    DiskName[MAX_PATH - 1] = UNICODE_NULL;
+
+    /* Unbuffered, so every ReadFile goes down to usbstor */
+    hDisk = CreateFileW(DiskName,
+                        GENERIC_READ,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE,
+                        NULL,
+                        OPEN_EXISTING,
+                        FILE_FLAG_NO_BUFFERING | FILE_FLAG_SEQUENTIAL_SCAN,
+                        NULL);
+
+    if (hDisk == INVALID_HANDLE_VALUE)
+    {
+        wprintf(L"Cannot open %ls, error %lu\n", DiskName, GetLastError());
+        return 1;
+    }
+
+    if (!DeviceIoControl(hDisk,
+                         IOCTL_DISK_GET_DRIVE_GEOMETRY_EX,
+                         NULL,
+                         0,
+                         &Geometry,
+                         sizeof(Geometry),
+                         &Returned,
+                         NULL))
+    {
+        wprintf(L"Cannot get the disk size, error %lu\n", GetLastError());
+        CloseHandle(hDisk);
+        return 1;
+    }
+
+    Buffer = VirtualAlloc(NULL,
+                          RequestSizes[ARRAYSIZE(RequestSizes) - 1],
+                          MEM_COMMIT | MEM_RESERVE,
+                          PAGE_READWRITE);
+
+    if (!Buffer)
+    {
+        CloseHandle(hDisk);
+        return 1;
+    }
+
+    wprintf(L"%ls: %I64u MB\n",
+            DiskName,
+            Geometry.DiskSize.QuadPart / (1024 * 1024));
+
+    for (i = 0; i < ARRAYSIZE(RequestSizes); i++)
+    {
+        if (!ReadDisk(hDisk,
+                      Buffer,
+                      RequestSizes[i],
+                      Geometry.DiskSize.QuadPart,
+                      &MBytesPerSecond))
+        {
+            wprintf(L"%7lu bytes: read failed, error %lu\n",
+                    RequestSizes[i],
+                    GetLastError());
+            continue;
+        }
+
+        wprintf(L"%7lu bytes: %8.2f MB/s\n", RequestSizes[i], MBytesPerSecond);
+    }
+
+    VirtualFree(Buffer, 0, MEM_RELEASE);
+    CloseHandle(hDisk);
+
+    return 0;
+}
@@ -0,0 +1,342 @@
+/*
+ * PROJECT:     ReactOS Tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Readiness notification cost with many idle sockets
+ *
+ * Opens a large number of loopback connections, most of which stay idle,
+ * and keeps a few of them busy with a thread that sends one byte at a time
+ * round robin. The receiving ends are watched first by several threads
+ * calling select over their share of the sockets, then through the
+ * persistent SIO_AFD_SET_NOTIFY registration and a completion port. The
+ * bytes delivered per second show how much every packet costs the stack
+ * while the idle sockets are being watched. Run
+ *
+ *   pollbench [idle] [busy] [seconds] [threads]
+ *
+ * which defaults to 10000 idle and 100 busy connections, 5 seconds per
+ * mode and 4 watching threads.
+ */
+
+#define FD_SETSIZE 16384
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <winsock2.h>
+
+/* Mirrors AFD_NOTIFY_INFO and the code msafd handles, see afd/shared.h */
+#define SIO_AFD_SET_NOTIFY  (IOC_IN | IOC_VENDOR | 0x100)
+
+typedef struct _BENCH_NOTIFY_INFO
+{
+    ULONG Events;
+    PVOID Context;
+} BENCH_NOTIFY_INFO;
+
+typedef struct _BENCH
+{
+    SOCKET *Servers;
+    SOCKET *Clients;
+    ULONG Total;
+    ULONG Busy;
+    ULONG BusyStride;
+    ULONG Threads;
+    HANDLE Port;
+    volatile LONG Stop;
+    volatile LONG Bytes;
+    volatile LONG Wakeups;
+} BENCH, *PBENCH;
+
+typedef struct _BENCH_WORKER
+{
+    PBENCH Bench;
+    ULONG First;
+    ULONG Count;
+} BENCH_WORKER, *PBENCH_WORKER;
+
+static OVERLAPPED NotifyMarker;
+
+static
+LONG
+Drain(PBENCH Bench, SOCKET Socket)
+{
+    char Buffer[4096];
+    LONG Total = 0;
+    int Received;
+
+    for (;;)
+    {
+        Received = recv(Socket, Buffer, sizeof(Buffer), 0);
+        if (Received <= 0)
+            break;
+        Total += Received;
+    }
+
+    if (Total)
+    {
+        InterlockedExchangeAdd(&Bench->Bytes, Total);
+        InterlockedIncrement(&Bench->Wakeups);
+    }
+    return Total;
+}
+
+static
+DWORD
+WINAPI
+PumpThread(PVOID Context)
+{
+    PBENCH Bench = Context;
+    ULONG Index;
+
+    while (!Bench->Stop)
+    {
+        for (Index = 0; Index < Bench->Busy && !Bench->Stop; Index++)
+            send(Bench->Clients[Index * Bench->BusyStride], "x", 1, 0);
+    }
+
+    return 0;
+}
+
+static
+DWORD
+WINAPI
+SelectThread(PVOID Context)
+{
+    PBENCH_WORKER Worker = Context;
+    PBENCH Bench = Worker->Bench;
+    struct timeval Timeout = { 0, 100000 };
+    fd_set *Set;
+    u_int Index;
+
+    Set = HeapAlloc(GetProcessHeap(), 0, sizeof(*Set));
+    if (!Set)
+        return 1;
+
+    while (!Bench->Stop)
+    {
+        /* FD_SET looks for duplicates, which would dominate the run */
+        CopyMemory(Set->fd_array, &Bench->Servers[Worker->First], Worker->Count * sizeof(SOCKET));
+        Set->fd_count = Worker->Count;
+
+        if (select(0, Set, NULL, NULL, &Timeout) == SOCKET_ERROR)
+        {
+            printf("select failed, error %d\n", WSAGetLastError());
+            break;
+        }
+
+        for (Index = 0; Index < Set->fd_count; Index++)
+            Drain(Bench, Set->fd_array[Index]);
+    }
+
+    HeapFree(GetProcessHeap(), 0, Set);
+    return 0;
+}
+
+static
+DWORD
+WINAPI
+NotifyThread(PVOID Context)
+{
+    PBENCH_WORKER Worker = Context;
+    PBENCH Bench = Worker->Bench;
+    LPOVERLAPPED Overlapped;
+    ULONG_PTR Key;
+    DWORD Events;
+
+    while (!Bench->Stop)
+    {
+        if (!GetQueuedCompletionStatus(Bench->Port, &Events, &Key, &Overlapped, 100))
+            continue;
+
+        if (Overlapped == &NotifyMarker && (Events & FD_READ))
+            Drain(Bench, Bench->Servers[Key]);
+    }
+
+    return 0;
+}
+
+static
+VOID
+RunMode(PBENCH Bench, PCSTR Name, LPTHREAD_START_ROUTINE Routine, ULONG Seconds)
+{
+    HANDLE Threads[MAXIMUM_WAIT_OBJECTS];
+    BENCH_WORKER Workers[MAXIMUM_WAIT_OBJECTS];
+    LARGE_INTEGER Frequency, Start, End;
+    HANDLE Pump;
+    ULONG Index;
+    double Elapsed;
+
+    Bench->Stop = FALSE;
+    Bench->Bytes = 0;
+    Bench->Wakeups = 0;
+
+    for (Index = 0; Index < Bench->Threads; Index++)
+    {
+        Workers[Index].Bench = Bench;
+        Workers[Index].First = Index * Bench->Total / Bench->Threads;
+        Workers[Index].Count = (Index + 1) * Bench->Total / Bench->Threads - Workers[Index].First;
+        Threads[Index] = CreateThread(NULL, 0, Routine, &Workers[Index], 0, NULL);
+    }
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    Pump = CreateThread(NULL, 0, PumpThread, Bench, 0, NULL);
+    Sleep(Seconds * 1000);
+    Bench->Stop = TRUE;
+    QueryPerformanceCounter(&End);
+
+    WaitForSingleObject(Pump, INFINITE);
+    CloseHandle(Pump);
+    WaitForMultipleObjects(Bench->Threads, Threads, TRUE, INFINITE);
+    for (Index = 0; Index < Bench->Threads; Index++)
+        CloseHandle(Threads[Index]);
+
+    Elapsed = (double)(End.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+    printf("%-8s %10.0f bytes/s  %10.0f wakeups/s\n",
+           Name, Bench->Bytes / Elapsed, Bench->Wakeups / Elapsed);
+}
+
+static
+BOOL
+Connect(PBENCH Bench)
+{
+    struct sockaddr_in Address;
+    int Length = sizeof(Address);
+    u_long NonBlocking = 1;
+    SOCKET Listener;
+    ULONG Index;
+
+    Listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (Listener == INVALID_SOCKET)
+        return FALSE;
+
+    ZeroMemory(&Address, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(Listener, (struct sockaddr *)&Address, sizeof(Address)) ||
+        getsockname(Listener, (struct sockaddr *)&Address, &Length) ||
+        listen(Listener, SOMAXCONN))
+    {
+        closesocket(Listener);
+        return FALSE;
+    }
+
+    for (Index = 0; Index < Bench->Total; Index++)
+    {
+        Bench->Clients[Index] = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (Bench->Clients[Index] == INVALID_SOCKET ||
+            connect(Bench->Clients[Index], (struct sockaddr *)&Address, sizeof(Address)))
+        {
+            printf("Connection %lu failed, error %d\n", Index, WSAGetLastError());
+            break;
+        }
+
+        Bench->Servers[Index] = accept(Listener, NULL, NULL);
+        if (Bench->Servers[Index] == INVALID_SOCKET)
+        {
+            printf("Accept %lu failed, error %d\n", Index, WSAGetLastError());
+            closesocket(Bench->Clients[Index]);
+            break;
+        }
+
+        /* The watchers read until there is nothing left */
+        ioctlsocket(Bench->Servers[Index], FIONBIO, &NonBlocking);
+    }
+
+    closesocket(Listener);
+    Bench->Total = Index;
+    return Index > Bench->Busy;
+}
+
+static
+BOOL
+RegisterNotifications(PBENCH Bench)
+{
+    BENCH_NOTIFY_INFO Info;
+    DWORD Returned;
+    ULONG Index;
+
+    Bench->Port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, Bench->Threads);
+    if (!Bench->Port)
+        return FALSE;
+
+    Info.Events = FD_READ;
+    Info.Context = &NotifyMarker;
+
+    for (Index = 0; Index < Bench->Total; Index++)
+    {
+        if (!CreateIoCompletionPort((HANDLE)Bench->Servers[Index], Bench->Port, Index, 0) ||
+            WSAIoctl(Bench->Servers[Index], SIO_AFD_SET_NOTIFY, &Info, sizeof(Info),
+                     NULL, 0, &Returned, NULL, NULL))
+        {
+            printf("Registering socket %lu failed, error %d\n", Index, WSAGetLastError());
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+int
+main(int argc, char *argv[])
+{
+    BENCH Bench;
+    WSADATA WsaData;
+    ULONG Idle = 10000, Seconds = 5;
+    ULONG Index;
+
+    ZeroMemory(&Bench, sizeof(Bench));
+    Bench.Busy = 100;
+    Bench.Threads = 4;
+
+    if (argc > 1)
+        Idle = strtoul(argv[1], NULL, 0);
+    if (argc > 2)
+        Bench.Busy = strtoul(argv[2], NULL, 0);
+    if (argc > 3)
+        Seconds = strtoul(argv[3], NULL, 0);
+    if (argc > 4)
+        Bench.Threads = strtoul(argv[4], NULL, 0);
+
+    Bench.Total = Idle + Bench.Busy;
+    if (Bench.Busy == 0 || Seconds == 0 || Bench.Threads == 0 ||
+        Bench.Threads > MAXIMUM_WAIT_OBJECTS ||
+        (Bench.Total + Bench.Threads - 1) / Bench.Threads > FD_SETSIZE)
+    {
+        printf("Usage: pollbench [idle] [busy] [seconds] [threads]\n");
+        return 1;
+    }
+
+    if (WSAStartup(MAKEWORD(2, 2), &WsaData))
+        return 2;
+
+    Bench.Servers = HeapAlloc(GetProcessHeap(), 0, Bench.Total * sizeof(SOCKET));
+    Bench.Clients = HeapAlloc(GetProcessHeap(), 0, Bench.Total * sizeof(SOCKET));
+    if (!Bench.Servers || !Bench.Clients)
+        return 2;
+
+    if (!Connect(&Bench))
+    {
+        printf("Could not open enough connections\n");
+        return 2;
+    }
+
+    /* Spread the busy connections over the whole set */
+    Bench.BusyStride = Bench.Total / Bench.Busy;
+    printf("%lu connections, %lu busy, %lu threads\n", Bench.Total, Bench.Busy, Bench.Threads);
+
+    RunMode(&Bench, "select", SelectThread, Seconds);
+
+    if (RegisterNotifications(&Bench))
+        RunMode(&Bench, "notify", NotifyThread, Seconds);
+
+    for (Index = 0; Index < Bench.Total; Index++)
+    {
+        closesocket(Bench.Servers[Index]);
+        closesocket(Bench.Clients[Index]);
+    }
+    if (Bench.Port)
+        CloseHandle(Bench.Port);
+
+    WSACleanup();
+    return 0;
+}
@@ -26,6 +26,12 @@ static ULONG CmpLazyFlushHiveCount = 7;
 ULONG CmpLazyFlushCount = 1;
 LONG CmpFlushStarveWriters;
 
+/* Lazy flush statistics, times are in 100ns units */
+ULONG CmpLazyFlushedHives;
+ULONG CmpLazyFlushedBlocks;
+ULONGLONG CmpLazyFlushTime;
+ULONGLONG CmpLazyFlushMaxTime;
+
 /* FUNCTIONS ******************************************************************/
 
 BOOLEAN
@@ -39,6 +45,8 @@ CmpDoFlushNextHive(_In_  BOOLEAN ForceFlush,
     PCMHIVE CmHive;
     BOOLEAN Result;
     ULONG HiveCount = CmpLazyFlushHiveCount;
+    ULONG HiveDirtyCount;
+    ULONGLONG StartTime, FlushTime;
 
     /* Set Defaults */
     *Error = FALSE;
@@ -79,7 +87,10 @@ CmpDoFlushNextHive(_In_  BOOLEAN ForceFlush,
                 /* Do the sync */
                 DPRINT("Flushing: %wZ\n", &CmHive->FileFullPath);
                 DPRINT("Handle: %p\n", CmHive->FileHandles[HFILE_TYPE_PRIMARY]);
+                HiveDirtyCount = CmHive->Hive.DirtyCount;
+                StartTime = KeQueryInterruptTime();
                 Status = HvSyncHive(&CmHive->Hive);
+                FlushTime = KeQueryInterruptTime() - StartTime;
                 if(!NT_SUCCESS(Status))
                 {
                     /* Let them know we failed */
@@ -90,6 +101,13 @@ CmpDoFlushNextHive(_In_  BOOLEAN ForceFlush,
                     break;
                 }
                 CmHive->FlushCount = CmpLazyFlushCount;
+
+                /* Account for the time spent writing the hive out */
+                CmpLazyFlushedHives++;
+                CmpLazyFlushedBlocks += HiveDirtyCount;
+                CmpLazyFlushTime += FlushTime;
+                if (FlushTime > CmpLazyFlushMaxTime) CmpLazyFlushMaxTime = FlushTime;
+                DPRINT("Flushed %lu dirty blocks in %I64u us\n", HiveDirtyCount, FlushTime / 10);
             }
         }
         else if (CmHive->Hive.DirtyCount &&
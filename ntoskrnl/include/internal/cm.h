@@ -1467,6 +1467,10 @@ extern BOOLEAN CmpProfileLoaded;
 extern PCMHIVE CmiVolatileHive;
 extern LIST_ENTRY CmiKeyObjectListHead;
 extern BOOLEAN CmpHoldLazyFlush;
+extern ULONG CmpLazyFlushedHives;
+extern ULONG CmpLazyFlushedBlocks;
+extern ULONGLONG CmpLazyFlushTime;
+extern ULONGLONG CmpLazyFlushMaxTime;
 extern BOOLEAN HvShutdownComplete;
 
 //
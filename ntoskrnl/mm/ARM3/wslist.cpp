@@ -19,6 +19,17 @@
 PMMWSL MmWorkingSetList;
 KEVENT MmWorkingSetManagerEvent;
 
+/* Up to this many entries are invalidated one at a time, past that the whole TLB is flushed */
+#define MI_TRIM_FLUSH_LIST_SIZE 32
+
+struct TrimStatistics
+{
+    ULONG Trimmed;
+    ULONG Aged;
+    ULONG Claim;
+    ULONG TlbFlushes;
+};
+
 /* LOCAL FUNCTIONS ************************************************************/
 
 static MMPTE GetPteTemplateForWsList(PMMWSL WsList)
@@ -215,14 +226,103 @@ RemoveFromWsList(PMMWSL WsList, PVOID Address)
     FreeWsleIndex(WsList, Pfn1->u1.WsIndex);
 }
 
+/*
+ * Collects the TLB entries which must be invalidated while trimming, so that
+ * they are flushed in one go. The share count of trimmed pages is only
+ * dropped after the flush: until then, the page could still be reached
+ * through a stale TLB entry and must not go to the standby or modified list.
+ * Only a full page list forces a flush, and the TLB is only flushed as a
+ * whole when more addresses came in than the list holds. On SMP, a flush is
+ * a single IPI to all processors for the whole batch.
+ */
+class TrimFlushList
+{
+public:
+    TrimFlushList(TrimStatistics& Stats)
+        : m_Stats(Stats), m_Count(0), m_PageCount(0), m_Overflow(FALSE)
+    {
+    }
+
+    void AddAddress(PVOID Address)
+    {
+        if (m_Count < MI_TRIM_FLUSH_LIST_SIZE)
+            m_Addresses[m_Count++] = Address;
+        else
+            m_Overflow = TRUE;
+    }
+
+    void AddPage(PVOID Address, PFN_NUMBER Page)
+    {
+        if (m_PageCount == MI_TRIM_FLUSH_LIST_SIZE)
+            Flush();
+
+        AddAddress(Address);
+        m_Pages[m_PageCount++] = Page;
+    }
+
+    /* Must not be called with the PFN lock held */
+    void Flush()
+    {
+        if (m_Count == 0)
+            return;
+
+#ifdef CONFIG_SMP
+        if (KeNumberProcessors > 1)
+            KeIpiGenericCall(FlushTarget, reinterpret_cast<ULONG_PTR>(this));
+        else
+#endif
+            FlushTarget(reinterpret_cast<ULONG_PTR>(this));
+        m_Stats.TlbFlushes++;
+
+        if (m_PageCount != 0)
+        {
+            ntoskrnl::MiPfnLockGuard PfnLock;
+
+            /* This will take care of putting the pages in the standby or modified list. */
+            for (ULONG i = 0; i < m_PageCount; i++)
+                MiDecrementShareCount(MiGetPfnEntry(m_Pages[i]), m_Pages[i]);
+        }
+
+        m_Count = 0;
+        m_PageCount = 0;
+        m_Overflow = FALSE;
+    }
+
+private:
+    static ULONG_PTR NTAPI FlushTarget(ULONG_PTR Context)
+    {
+        TrimFlushList* FlushList = reinterpret_cast<TrimFlushList*>(Context);
+
+        if (FlushList->m_Overflow)
+        {
+            /* This also drops global entries, which system cache pages can have */
+            KeFlushCurrentTb();
+        }
+        else
+        {
+            for (ULONG i = 0; i < FlushList->m_Count; i++)
+                KeInvalidateTlbEntry(FlushList->m_Addresses[i]);
+        }
+
+        return 0;
+    }
+
+    TrimStatistics& m_Stats;
+    ULONG m_Count;
+    ULONG m_PageCount;
+    BOOLEAN m_Overflow;
+    PVOID m_Addresses[MI_TRIM_FLUSH_LIST_SIZE];
+    PFN_NUMBER m_Pages[MI_TRIM_FLUSH_LIST_SIZE];
+};
+
 static
-ULONG
-TrimWsList(PMMWSL WsList)
+VOID
+TrimWsList(PMMWSL WsList, TrimStatistics& Stats)
 {
     /* This should be done under WS lock */
     ASSERT(MM_ANY_WS_LOCK_HELD(PsGetCurrentThread()));
 
-    ULONG Ret = 0;
+    TrimFlushList FlushList(Stats);
 
     /* Walk the array */
     for (ULONG i = WsList->FirstDynamic; i < WsList->LastEntry; i++)
@@ -245,7 +345,7 @@ TrimWsList(PMMWSL WsList)
         {
             Entry.u1.e1.Age = 0;
             PointerPte->u.Hard.Accessed = 0;
-            KeInvalidateTlbEntry(Entry.u1.VirtualAddress);
+            FlushList.AddAddress(Entry.u1.VirtualAddress);
             continue;
         }
 
@@ -253,6 +353,7 @@ TrimWsList(PMMWSL WsList)
         if (Entry.u1.e1.Age < 3)
         {
             Entry.u1.e1.Age++;
+            Stats.Aged++;
             continue;
         }
 
@@ -266,8 +367,12 @@ TrimWsList(PMMWSL WsList)
         if (MI_IS_PAGE_TABLE_ADDRESS(Entry.u1.VirtualAddress))
             continue;
 
+        /* Old enough to be trimmed */
+        Stats.Claim++;
+
         /* Please put yourself aside and make place for the younger ones */
         PFN_NUMBER Page = PFN_FROM_PTE(PointerPte);
+        PVOID Address = Entry.u1.VirtualAddress;
         {
             ntoskrnl::MiPfnLockGuard PfnLock;
 
@@ -283,25 +388,26 @@ TrimWsList(PMMWSL WsList)
                 continue;
             }
 
-            /* We can remove it from the list. Save Protection first */
+            /* We can remove it from the list. Save the protection first */
             ULONG Protection = Entry.u1.e1.Protection;
-            RemoveFromWsList(WsList, Entry.u1.VirtualAddress);
+            RemoveFromWsList(WsList, Address);
 
             /* Dirtify the page, if needed */
             if (PointerPte->u.Hard.Dirty)
                 Pfn->u3.e1.Modified = 1;
 
-            /* Make this a transition PTE */
+            /* Make this a transition PTE. The share count is dropped once the TLB is flushed. */
             MI_MAKE_TRANSITION_PTE(PointerPte, Page, Protection);
-            KeInvalidateTlbEntry(MiAddressToPte(PointerPte));
-
-            /* Drop the share count. This will take care of putting it in the standby or modified list. */
-            MiDecrementShareCount(Pfn, Page);
         }
 
-        Ret++;
+        /* This may flush, so it goes outside of the PFN lock */
+        FlushList.AddPage(Address, Page);
+
+        Stats.Trimmed++;
+        Stats.Claim--;
     }
-    return Ret;
+
+    FlushList.Flush();
 }
 
 /* GLOBAL FUNCTIONS ***********************************************************/
@@ -413,6 +519,7 @@ MmWorkingSetManager(VOID)
     PLIST_ENTRY VmListEntry;
     PMMSUPPORT Vm = NULL;
     KIRQL OldIrql;
+    ULONG TotalTrimmed = 0;
 
     OldIrql = MiAcquireExpansionLock();
 
@@ -443,9 +550,9 @@ MmWorkingSetManager(VOID)
             ASSERT(!KeIsAttachedProcess());
             KeAttachProcess(&Process->Pcb);
         }
-        else
+        else if (Vm != &MmSystemCacheWs)
         {
-            /* FIXME: Session & system space unsupported */
+            /* FIXME: Session space unsupported */
             continue;
         }
 
@@ -461,12 +568,20 @@ MmWorkingSetManager(VOID)
             /* We're done */
             Vm->Flags.BeingTrimmed = 1;
 
-            ULONG Trimmed = TrimWsList(Vm->VmWorkingSetList);
+            TrimStatistics Stats = { 0, 0, 0, 0 };
+            TrimWsList(Vm->VmWorkingSetList, Stats);
 
             /* We're done */
-            Vm->WorkingSetSize -= Trimmed * PAGE_SIZE;
+            Vm->WorkingSetSize -= Stats.Trimmed * PAGE_SIZE;
+            Vm->Claim = Stats.Claim;
             Vm->Flags.BeingTrimmed = 0;
             MiUnlockWorkingSet(PsGetCurrentThread(), Vm);
+
+            DPRINT("%s: trimmed %lu pages, aged %lu, %lu left to trim, %lu TLB flushes, working set %lu pages\n",
+                   Process ? Process->ImageFileName : "System cache",
+                   Stats.Trimmed, Stats.Aged, Stats.Claim, Stats.TlbFlushes,
+                   Vm->WorkingSetSize / PAGE_SIZE);
+            TotalTrimmed += Stats.Trimmed;
         }
         else
         {
@@ -484,6 +599,12 @@ MmWorkingSetManager(VOID)
     }
 
     MiReleaseExpansionLock(OldIrql);
+
+    if (TotalTrimmed != 0)
+    {
+        DPRINT("Trimmed %lu pages, %Iu available, %Iu modified, %Iu wanted\n",
+               TotalTrimmed, MmAvailablePages, MmModifiedPageListHead.Total, MmPlentyFreePages);
+    }
 }
 
 } // extern "C"
@@ -1338,8 +1338,14 @@ __INTRIN_INLINE_SSE2 __m128i _mm_xor_si128(__m128i a, __m128i b)
     return (__m128i)((__v2du)a ^ (__v2du)b);
 }
 
+/* GCC takes the shift count of the byte shifts in bits */
+#ifdef __clang__
 #define _mm_slli_si128(a, imm) \
     ((__m128i)__builtin_ia32_pslldqi128_byteshift((__v2di)(__m128i)(a), (int)(imm)))
+#else
+#define _mm_slli_si128(a, imm) \
+    ((__m128i)__builtin_ia32_pslldqi128((__v2di)(__m128i)(a), (int)(imm) * 8))
+#endif
 
 __INTRIN_INLINE_SSE2 __m128i _mm_slli_epi16(__m128i a, int count)
 {
@@ -1391,8 +1397,13 @@ __INTRIN_INLINE_SSE2 __m128i _mm_sra_epi32(__m128i a, __m128i count)
     return (__m128i)__builtin_ia32_psrad128((__v4si)a, (__v4si)count);
 }
 
+#ifdef __clang__
 #define _mm_srli_si128(a, imm) \
     ((__m128i)__builtin_ia32_psrldqi128_byteshift((__v2di)(__m128i)(a), (int)(imm)))
+#else
+#define _mm_srli_si128(a, imm) \
+    ((__m128i)__builtin_ia32_psrldqi128((__v2di)(__m128i)(a), (int)(imm) * 8))
+#endif
 
 __INTRIN_INLINE_SSE2 __m128i _mm_srli_epi16(__m128i a, int count)
 {
@@ -0,0 +1,83 @@
+/*
+ * PROJECT:     ReactOS CRT
+ * LICENSE:     MIT (https://spdx.org/licenses/MIT)
+ * PURPOSE:     SHA extension intrinsics
+ */
+
+#pragma once
+#ifndef _INCLUDED_IMM
+#define _INCLUDED_IMM
+
+#include <wmmintrin.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern __m128i _mm_sha1rnds4_epu32(__m128i a, __m128i b, const int func);
+extern __m128i _mm_sha1nexte_epu32(__m128i a, __m128i b);
+extern __m128i _mm_sha1msg1_epu32(__m128i a, __m128i b);
+extern __m128i _mm_sha1msg2_epu32(__m128i a, __m128i b);
+extern __m128i _mm_sha256rnds2_epu32(__m128i a, __m128i b, __m128i k);
+extern __m128i _mm_sha256msg1_epu32(__m128i a, __m128i b);
+extern __m128i _mm_sha256msg2_epu32(__m128i a, __m128i b);
+
+#if defined(_MSC_VER) && !defined(__clang__)
+
+#pragma intrinsic(_mm_sha1rnds4_epu32)
+#pragma intrinsic(_mm_sha1nexte_epu32)
+#pragma intrinsic(_mm_sha1msg1_epu32)
+#pragma intrinsic(_mm_sha1msg2_epu32)
+#pragma intrinsic(_mm_sha256rnds2_epu32)
+#pragma intrinsic(_mm_sha256msg1_epu32)
+#pragma intrinsic(_mm_sha256msg2_epu32)
+
+#else /* _MSC_VER */
+
+#ifdef __clang__
+#define __ATTRIBUTE_SHA__ __attribute__((__target__("sha"),__min_vector_width__(128)))
+#else
+#define __ATTRIBUTE_SHA__ __attribute__((__target__("sha")))
+#endif
+#define __INTRIN_INLINE_SHA __INTRIN_INLINE __ATTRIBUTE_SHA__
+
+#define _mm_sha1rnds4_epu32(a, b, func) \
+    ((__m128i)__builtin_ia32_sha1rnds4((__v4si)(__m128i)(a), (__v4si)(__m128i)(b), (int)(func)))
+
+__INTRIN_INLINE_SHA __m128i _mm_sha1nexte_epu32(__m128i a, __m128i b)
+{
+    return (__m128i)__builtin_ia32_sha1nexte((__v4si)a, (__v4si)b);
+}
+
+__INTRIN_INLINE_SHA __m128i _mm_sha1msg1_epu32(__m128i a, __m128i b)
+{
+    return (__m128i)__builtin_ia32_sha1msg1((__v4si)a, (__v4si)b);
+}
+
+__INTRIN_INLINE_SHA __m128i _mm_sha1msg2_epu32(__m128i a, __m128i b)
+{
+    return (__m128i)__builtin_ia32_sha1msg2((__v4si)a, (__v4si)b);
+}
+
+__INTRIN_INLINE_SHA __m128i _mm_sha256rnds2_epu32(__m128i a, __m128i b, __m128i k)
+{
+    return (__m128i)__builtin_ia32_sha256rnds2((__v4si)a, (__v4si)b, (__v4si)k);
+}
+
+__INTRIN_INLINE_SHA __m128i _mm_sha256msg1_epu32(__m128i a, __m128i b)
+{
+    return (__m128i)__builtin_ia32_sha256msg1((__v4si)a, (__v4si)b);
+}
+
+__INTRIN_INLINE_SHA __m128i _mm_sha256msg2_epu32(__m128i a, __m128i b)
+{
+    return (__m128i)__builtin_ia32_sha256msg2((__v4si)a, (__v4si)b);
+}
+
+#endif /* _MSC_VER */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _INCLUDED_IMM */
@@ -0,0 +1,34 @@
+/*
+ * PROJECT:     ReactOS CRT
+ * LICENSE:     MIT (https://spdx.org/licenses/MIT)
+ * PURPOSE:     SSE4.1 intrinsics
+ */
+
+#pragma once
+#ifndef _INCLUDED_SMM
+#define _INCLUDED_SMM
+
+#include <tmmintrin.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern __m128i _mm_blend_epi16(__m128i a, __m128i b, int imm);
+
+#if defined(_MSC_VER) && !defined(__clang__)
+
+#pragma intrinsic(_mm_blend_epi16)
+
+#else /* _MSC_VER */
+
+#define _mm_blend_epi16(a, b, imm) \
+    ((__m128i)__builtin_ia32_pblendw128((__v8hi)(__m128i)(a), (__v8hi)(__m128i)(b), (int)(imm)))
+
+#endif /* _MSC_VER */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _INCLUDED_SMM */
@@ -0,0 +1,54 @@
+/*
+ * PROJECT:     ReactOS CRT
+ * LICENSE:     MIT (https://spdx.org/licenses/MIT)
+ * PURPOSE:     SSSE3 intrinsics
+ */
+
+#pragma once
+#ifndef _INCLUDED_TMM
+#define _INCLUDED_TMM
+
+#include <emmintrin.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern __m128i _mm_shuffle_epi8(__m128i a, __m128i b);
+extern __m128i _mm_alignr_epi8(__m128i a, __m128i b, int imm);
+
+#if defined(_MSC_VER) && !defined(__clang__)
+
+#pragma intrinsic(_mm_shuffle_epi8)
+#pragma intrinsic(_mm_alignr_epi8)
+
+#else /* _MSC_VER */
+
+#ifdef __clang__
+#define __ATTRIBUTE_SSSE3__ __attribute__((__target__("ssse3"),__min_vector_width__(128)))
+#else
+#define __ATTRIBUTE_SSSE3__ __attribute__((__target__("ssse3")))
+#endif
+#define __INTRIN_INLINE_SSSE3 __INTRIN_INLINE __ATTRIBUTE_SSSE3__
+
+__INTRIN_INLINE_SSSE3 __m128i _mm_shuffle_epi8(__m128i a, __m128i b)
+{
+    return (__m128i)__builtin_ia32_pshufb128((__v16qi)a, (__v16qi)b);
+}
+
+/* GCC takes the shift count of palignr in bits, clang in bytes */
+#ifdef __clang__
+#define _mm_alignr_epi8(a, b, imm) \
+    ((__m128i)__builtin_ia32_palignr128((__v16qi)(__m128i)(a), (__v16qi)(__m128i)(b), (int)(imm)))
+#else
+#define _mm_alignr_epi8(a, b, imm) \
+    ((__m128i)__builtin_ia32_palignr128((__v2di)(__m128i)(a), (__v2di)(__m128i)(b), (int)(imm) * 8))
+#endif
+
+#endif /* _MSC_VER */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _INCLUDED_TMM */
@@ -0,0 +1,81 @@
+/*
+ * PROJECT:     ReactOS CRT
+ * LICENSE:     MIT (https://spdx.org/licenses/MIT)
+ * PURPOSE:     AES and PCLMULQDQ intrinsics
+ */
+
+#pragma once
+#ifndef _INCLUDED_WMM
+#define _INCLUDED_WMM
+
+#include <smmintrin.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern __m128i _mm_aesenc_si128(__m128i v, __m128i rkey);
+extern __m128i _mm_aesenclast_si128(__m128i v, __m128i rkey);
+extern __m128i _mm_aesdec_si128(__m128i v, __m128i rkey);
+extern __m128i _mm_aesdeclast_si128(__m128i v, __m128i rkey);
+extern __m128i _mm_aesimc_si128(__m128i v);
+extern __m128i _mm_aeskeygenassist_si128(__m128i ckey, const int rcon);
+extern __m128i _mm_clmulepi64_si128(__m128i v1, __m128i v2, const int imm8);
+
+#if defined(_MSC_VER) && !defined(__clang__)
+
+#pragma intrinsic(_mm_aesenc_si128)
+#pragma intrinsic(_mm_aesenclast_si128)
+#pragma intrinsic(_mm_aesdec_si128)
+#pragma intrinsic(_mm_aesdeclast_si128)
+#pragma intrinsic(_mm_aesimc_si128)
+#pragma intrinsic(_mm_aeskeygenassist_si128)
+#pragma intrinsic(_mm_clmulepi64_si128)
+
+#else /* _MSC_VER */
+
+#ifdef __clang__
+#define __ATTRIBUTE_AES__ __attribute__((__target__("aes"),__min_vector_width__(128)))
+#else
+#define __ATTRIBUTE_AES__ __attribute__((__target__("aes")))
+#endif
+#define __INTRIN_INLINE_AES __INTRIN_INLINE __ATTRIBUTE_AES__
+
+__INTRIN_INLINE_AES __m128i _mm_aesenc_si128(__m128i v, __m128i rkey)
+{
+    return (__m128i)__builtin_ia32_aesenc128((__v2di)v, (__v2di)rkey);
+}
+
+__INTRIN_INLINE_AES __m128i _mm_aesenclast_si128(__m128i v, __m128i rkey)
+{
+    return (__m128i)__builtin_ia32_aesenclast128((__v2di)v, (__v2di)rkey);
+}
+
+__INTRIN_INLINE_AES __m128i _mm_aesdec_si128(__m128i v, __m128i rkey)
+{
+    return (__m128i)__builtin_ia32_aesdec128((__v2di)v, (__v2di)rkey);
+}
+
+__INTRIN_INLINE_AES __m128i _mm_aesdeclast_si128(__m128i v, __m128i rkey)
+{
+    return (__m128i)__builtin_ia32_aesdeclast128((__v2di)v, (__v2di)rkey);
+}
+
+__INTRIN_INLINE_AES __m128i _mm_aesimc_si128(__m128i v)
+{
+    return (__m128i)__builtin_ia32_aesimc128((__v2di)v);
+}
+
+#define _mm_aeskeygenassist_si128(ckey, rcon) \
+    ((__m128i)__builtin_ia32_aeskeygenassist128((__v2di)(__m128i)(ckey), (int)(rcon)))
+
+#define _mm_clmulepi64_si128(v1, v2, imm8) \
+    ((__m128i)__builtin_ia32_pclmulqdq128((__v2di)(__m128i)(v1), (__v2di)(__m128i)(v2), (char)(imm8)))
+
+#endif /* _MSC_VER */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _INCLUDED_WMM */
@@ -40,6 +40,7 @@ typedef struct _ACPI_BIOS_MULTI_NODE
 #define BOOT_SIGNATURE 'TOOB'
 #define SRAT_SIGNATURE 'TARS'
 #define WDRT_SIGNATURE 'TRDW'
+#define HPET_SIGNATURE 'TEPH'
 #define BGRT_SIGNATURE  0x54524742      	// "BGRT"
 
 //
@@ -209,6 +210,18 @@ typedef struct _DEBUG_PORT_TABLE
     GEN_ADDR BaseAddress;
 } DEBUG_PORT_TABLE, *PDEBUG_PORT_TABLE;
 
+#include <pshpack1.h>
+typedef struct _HPET_TABLE
+{
+    DESCRIPTION_HEADER Header;
+    ULONG EventTimerBlockId;
+    GEN_ADDR BaseAddress;
+    UCHAR HpetNumber;
+    USHORT MinimumTick;
+    UCHAR PageProtection;
+} HPET_TABLE, *PHPET_TABLE;
+#include <poppack.h>
+
 typedef struct _WATCHDOG_TABLE
 {
     DESCRIPTION_HEADER Header;
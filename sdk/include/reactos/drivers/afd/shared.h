@@ -132,6 +132,18 @@ typedef struct _AFD_ENUM_NETWORK_EVENTS_INFO {
     NTSTATUS EventStatus[AFD_MAX_EVENTS];
 } AFD_ENUM_NETWORK_EVENTS_INFO, *PAFD_ENUM_NETWORK_EVENTS_INFO;
 
+/*
+ * Persistent readiness registration. While Events (AFD_EVENT_* bits) is
+ * non-zero, AFD queues a packet to the completion port the socket is
+ * associated with each time the socket signals one of those events. The
+ * packet carries Context as its overlapped pointer and the signalled
+ * events, translated to FD_* bits, as its byte count.
+ */
+typedef struct _AFD_NOTIFY_INFO {
+    ULONG				Events;
+    PVOID				Context;
+} AFD_NOTIFY_INFO, *PAFD_NOTIFY_INFO;
+
 typedef struct _AFD_DISCONNECT_INFO {
     ULONG				DisconnectType;
     LARGE_INTEGER			Timeout;
@@ -261,6 +273,7 @@ typedef struct _AFD_TDI_HANDLE_DATA
 #define AFD_DEFER_ACCEPT		35
 #define AFD_GET_PENDING_CONNECT_DATA	41
 #define AFD_VALIDATE_GROUP		42
+#define AFD_SET_NOTIFY			43
 
 /* AFD IOCTLs */
 
@@ -336,6 +349,11 @@ typedef struct _AFD_TDI_HANDLE_DATA
   _AFD_CONTROL_CODE(AFD_ENUM_NETWORK_EVENTS, METHOD_NEITHER)
 #define IOCTL_AFD_VALIDATE_GROUP \
   _AFD_CONTROL_CODE(AFD_VALIDATE_GROUP, METHOD_NEITHER)
+#define IOCTL_AFD_SET_NOTIFY \
+  _AFD_CONTROL_CODE(AFD_SET_NOTIFY, METHOD_NEITHER)
+
+/* WSAIoctl code msafd turns into IOCTL_AFD_SET_NOTIFY, with FD_* events */
+#define SIO_AFD_SET_NOTIFY              (IOC_IN | IOC_VENDOR | 0x100)
 
 typedef struct _AFD_SOCKET_INFORMATION {
     BOOL CommandChannel;
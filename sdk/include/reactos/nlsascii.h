@@ -0,0 +1,206 @@
+/*
+ * PROJECT:     ReactOS NLS
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Conversion of runs of 7-bit ASCII between bytes and UTF-16
+ *
+ * Text is mostly ASCII, and ASCII looks the same in UTF-8 and in every code
+ * page that maps 0x00-0x7F to itself. The converters in RTL and kernel32
+ * hand the runs to these helpers, which go 16 characters at a time with
+ * SSE2 on amd64 and a machine word at a time elsewhere (x86 kernel code
+ * must not touch the FPU state), and take over again at the first
+ * character that needs the tables.
+ */
+
+#pragma once
+
+#ifdef _M_AMD64
+#include <emmintrin.h>
+#endif
+
+/* Returns how many of the first Count bytes are below 0x80 */
+FORCEINLINE
+ULONG
+NlsAsciiSpanA(
+    _In_reads_(Count) PCCH String,
+    _In_ ULONG Count)
+{
+    ULONG Done = 0;
+
+#ifdef _M_AMD64
+    for (; Count - Done >= 16; Done += 16)
+    {
+        if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(String + Done))))
+            break;
+    }
+#else
+    for (; Count - Done >= 8; Done += 8)
+    {
+        if ((*(const ULONG UNALIGNED *)(String + Done) |
+             *(const ULONG UNALIGNED *)(String + Done + 4)) & 0x80808080)
+        {
+            break;
+        }
+    }
+#endif
+
+    while (Done < Count && (UCHAR)String[Done] < 0x80)
+        Done++;
+    return Done;
+}
+
+/* Returns how many of the first Count characters are below 0x80 */
+FORCEINLINE
+ULONG
+NlsAsciiSpanW(
+    _In_reads_(Count) PCWCH String,
+    _In_ ULONG Count)
+{
+    ULONG Done = 0;
+
+#ifdef _M_AMD64
+    const __m128i Mask = _mm_set1_epi16((SHORT)0xFF80);
+    __m128i Chars;
+
+    for (; Count - Done >= 16; Done += 16)
+    {
+        Chars = _mm_or_si128(_mm_loadu_si128((const __m128i *)(String + Done)),
+                             _mm_loadu_si128((const __m128i *)(String + Done + 8)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(Chars, Mask),
+                                              _mm_setzero_si128())) != 0xFFFF)
+        {
+            break;
+        }
+    }
+#else
+    for (; Count - Done >= 4; Done += 4)
+    {
+        if ((*(const ULONG UNALIGNED *)(String + Done) |
+             *(const ULONG UNALIGNED *)(String + Done + 2)) & 0xFF80FF80)
+        {
+            break;
+        }
+    }
+#endif
+
+    while (Done < Count && String[Done] < 0x80)
+        Done++;
+    return Done;
+}
+
+/* Widens the leading ASCII of the first Count bytes, returns how many */
+FORCEINLINE
+ULONG
+NlsWidenAscii(
+    _Out_writes_to_(Count, return) PWCH Dest,
+    _In_reads_(Count) PCCH Source,
+    _In_ ULONG Count)
+{
+    ULONG Done = 0;
+
+#ifdef _M_AMD64
+    __m128i Chars;
+
+    for (; Count - Done >= 16; Done += 16)
+    {
+        Chars = _mm_loadu_si128((const __m128i *)(Source + Done));
+        if (_mm_movemask_epi8(Chars))
+            break;
+        _mm_storeu_si128((__m128i *)(Dest + Done), _mm_unpacklo_epi8(Chars, _mm_setzero_si128()));
+        _mm_storeu_si128((__m128i *)(Dest + Done + 8), _mm_unpackhi_epi8(Chars, _mm_setzero_si128()));
+    }
+#else
+    ULONG Chars;
+
+    for (; Count - Done >= 4; Done += 4)
+    {
+        Chars = *(const ULONG UNALIGNED *)(Source + Done);
+        if (Chars & 0x80808080)
+            break;
+        /* Little endian, the first byte is the lowest */
+        *(ULONG UNALIGNED *)(Dest + Done) = (Chars & 0xFF) | ((Chars & 0xFF00) << 8);
+        *(ULONG UNALIGNED *)(Dest + Done + 2) = ((Chars >> 16) & 0xFF) | ((Chars >> 8) & 0xFF0000);
+    }
+#endif
+
+    while (Done < Count && (UCHAR)Source[Done] < 0x80)
+    {
+        Dest[Done] = Source[Done];
+        Done++;
+    }
+    return Done;
+}
+
+/* Narrows the leading ASCII of the first Count characters, returns how many */
+FORCEINLINE
+ULONG
+NlsNarrowAscii(
+    _Out_writes_to_(Count, return) PCH Dest,
+    _In_reads_(Count) PCWCH Source,
+    _In_ ULONG Count)
+{
+    ULONG Done = 0;
+
+#ifdef _M_AMD64
+    const __m128i Mask = _mm_set1_epi16((SHORT)0xFF80);
+    __m128i Low, High;
+
+    for (; Count - Done >= 16; Done += 16)
+    {
+        Low = _mm_loadu_si128((const __m128i *)(Source + Done));
+        High = _mm_loadu_si128((const __m128i *)(Source + Done + 8));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(Low, High), Mask),
+                                              _mm_setzero_si128())) != 0xFFFF)
+        {
+            break;
+        }
+        _mm_storeu_si128((__m128i *)(Dest + Done), _mm_packus_epi16(Low, High));
+    }
+#else
+    ULONG Low, High;
+
+    for (; Count - Done >= 4; Done += 4)
+    {
+        Low = *(const ULONG UNALIGNED *)(Source + Done);
+        High = *(const ULONG UNALIGNED *)(Source + Done + 2);
+        if ((Low | High) & 0xFF80FF80)
+            break;
+        *(ULONG UNALIGNED *)(Dest + Done) = (Low & 0xFF) | ((Low >> 8) & 0xFF00) |
+                                            ((High & 0xFF) << 16) | ((High & 0xFF0000) << 8);
+    }
+#endif
+
+    while (Done < Count && Source[Done] < 0x80)
+    {
+        Dest[Done] = (CHAR)Source[Done];
+        Done++;
+    }
+    return Done;
+}
+
+/* Checks whether a code page maps 0x00-0x7F to the same code points both
+ * ways and has no lead bytes there, so that the helpers above apply */
+FORCEINLINE
+BOOLEAN
+NlsIsAsciiCodePage(
+    _In_ PCPTABLEINFO TableInfo)
+{
+    ULONG i;
+
+    for (i = 0; i < 0x80; i++)
+    {
+        if (TableInfo->MultiByteTable[i] != i)
+            return FALSE;
+
+        if (TableInfo->DBCSCodePage)
+        {
+            if (TableInfo->DBCSOffsets[i] || ((PUSHORT)TableInfo->WideCharTable)[i] != i)
+                return FALSE;
+        }
+        else if ((UCHAR)((PCHAR)TableInfo->WideCharTable)[i] != i)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
@@ -18,6 +18,18 @@ typedef struct _DNS_CACHE_ENTRY
     unsigned short wFlags;          /* DNS Record Flags */
 } DNS_CACHE_ENTRY, *PDNS_CACHE_ENTRY;
 
+typedef struct _DNS_CACHE_STATS
+{
+    DWORD dwEntries;                /* Cached answers, without the hosts file */
+    DWORD dwNegativeEntries;        /* Cached name errors and empty answers */
+    DWORD dwMaxEntries;             /* Size bound of the cache */
+    DWORD dwHits;                   /* Queries answered from the cache */
+    DWORD dwNegativeHits;           /* Queries answered with a cached negative answer */
+    DWORD dwMisses;                 /* Queries that went past the cache */
+    DWORD dwExpired;                /* Answers dropped at the end of their TTL */
+    DWORD dwEvicted;                /* Answers dropped to stay within the bound */
+} DNS_CACHE_STATS, *PDNS_CACHE_STATS;
+
 
 #ifndef __WIDL__
 // Hack
@@ -25,6 +25,11 @@ typedef enum _RESULT
     SelfHeal
 } RESULT;
 
+/* GLOBALS ******************************************************************/
+
+/* Size of the chunks in which the primary file is read when loading a hive */
+#define HV_LOAD_CHUNK_SIZE  (64 * HBLOCK_SIZE)
+
 /* PRIVATE FUNCTIONS ********************************************************/
 
 /**
@@ -286,6 +291,73 @@ HvpCreateHive(
     return STATUS_SUCCESS;
 }
 
+/**
+ * @brief
+ * Finishes the initialization of a hive descriptor
+ * whose stable bins have been loaded. It builds the
+ * free cell lists and the dirty vector of the hive.
+ *
+ * @param[in] Hive
+ * A pointer to a registry hive descriptor with
+ * the base block and stable storage set up.
+ *
+ * @param[in] FileName
+ * A pointer to a Unicode string structure containing
+ * the hive file name to be copied from. If this argument
+ * is NULL, the base block will not have any hive file name.
+ *
+ * @return
+ * Returns STATUS_SUCCESS if the function has initialized the
+ * hive descriptor successfully, STATUS_NO_MEMORY otherwise.
+ * On failure the bins and the base block of the hive are freed.
+ */
+static
+NTSTATUS
+CMAPI
+HvpInitializeHiveStorage(
+    _In_ PHHIVE Hive,
+    _In_opt_ PCUNICODE_STRING FileName)
+{
+    ULONG BitmapSize;
+    PULONG BitmapBuffer;
+
+    if (!NT_SUCCESS(HvpCreateHiveFreeCellList(Hive)))
+    {
+        HvpFreeHiveBins(Hive);
+        Hive->Free(Hive->BaseBlock, Hive->BaseBlockAlloc);
+        return STATUS_NO_MEMORY;
+    }
+
+    BitmapSize = ROUND_UP(Hive->Storage[Stable].Length,
+                          sizeof(ULONG) * 8) / 8;
+    BitmapBuffer = (PULONG)Hive->Allocate(BitmapSize, TRUE, TAG_CM);
+    if (BitmapBuffer == NULL)
+    {
+        HvpFreeHiveBins(Hive);
+        Hive->Free(Hive->BaseBlock, Hive->BaseBlockAlloc);
+        return STATUS_NO_MEMORY;
+    }
+
+    RtlInitializeBitMap(&Hive->DirtyVector, BitmapBuffer, BitmapSize * 8);
+    RtlClearAllBits(&Hive->DirtyVector);
+
+    /*
+     * Mark the entire hive as dirty. Indeed we understand if we charged up
+     * the alternate variant of the primary hive (e.g. SYSTEM.ALT) because
+     * FreeLdr could not load the main SYSTEM hive, due to corruptions, and
+     * repairing it with a LOG did not help at all.
+     */
+    if (Hive->BaseBlock->BootRecover == HBOOT_BOOT_RECOVERED_BY_ALTERNATE_HIVE)
+    {
+        RtlSetAllBits(&Hive->DirtyVector);
+        Hive->DirtyCount = Hive->DirtyVector.SizeOfBitMap;
+    }
+
+    HvpInitFileName(Hive->BaseBlock, FileName);
+
+    return STATUS_SUCCESS;
+}
+
 /**
  * @brief
  * Initializes a hive descriptor from an already loaded
@@ -323,8 +395,6 @@ HvpInitializeMemoryHive(
     SIZE_T BlockIndex;
     PHBIN Bin, NewBin;
     ULONG i;
-    ULONG BitmapSize;
-    PULONG BitmapBuffer;
     SIZE_T ChunkSize;
 
     ChunkSize = ChunkBase->Length;
@@ -421,41 +491,7 @@ HvpInitializeMemoryHive(
         BlockIndex += Bin->Size / HBLOCK_SIZE;
     }
 
-    if (!NT_SUCCESS(HvpCreateHiveFreeCellList(Hive)))
-    {
-        HvpFreeHiveBins(Hive);
-        Hive->Free(Hive->BaseBlock, Hive->BaseBlockAlloc);
-        return STATUS_NO_MEMORY;
-    }
-
-    BitmapSize = ROUND_UP(Hive->Storage[Stable].Length,
-                          sizeof(ULONG) * 8) / 8;
-    BitmapBuffer = (PULONG)Hive->Allocate(BitmapSize, TRUE, TAG_CM);
-    if (BitmapBuffer == NULL)
-    {
-        HvpFreeHiveBins(Hive);
-        Hive->Free(Hive->BaseBlock, Hive->BaseBlockAlloc);
-        return STATUS_NO_MEMORY;
-    }
-
-    RtlInitializeBitMap(&Hive->DirtyVector, BitmapBuffer, BitmapSize * 8);
-    RtlClearAllBits(&Hive->DirtyVector);
-
-    /*
-     * Mark the entire hive as dirty. Indeed we understand if we charged up
-     * the alternate variant of the primary hive (e.g. SYSTEM.ALT) because
-     * FreeLdr could not load the main SYSTEM hive, due to corruptions, and
-     * repairing it with a LOG did not help at all.
-     */
-    if (ChunkBase->BootRecover == HBOOT_BOOT_RECOVERED_BY_ALTERNATE_HIVE)
-    {
-        RtlSetAllBits(&Hive->DirtyVector);
-        Hive->DirtyCount = Hive->DirtyVector.SizeOfBitMap;
-    }
-
-    HvpInitFileName(Hive->BaseBlock, FileName);
-
-    return STATUS_SUCCESS;
+    return HvpInitializeHiveStorage(Hive, FileName);
 }
 
 /**
@@ -997,6 +1033,152 @@ HvpRecoverDataFromLog(
 }
 #endif
 
+/**
+ * @brief
+ * Reads the stable bins of a hive from its primary
+ * file straight into their own bin allocations.
+ *
+ * @param[in] Hive
+ * A pointer to a hive descriptor whose base block
+ * has been read and validated already.
+ *
+ * @return
+ * Returns STATUS_SUCCESS if all the bins have been read.
+ * STATUS_INSUFFICIENT_RESOURCES is returned if there's not
+ * enough memory, STATUS_NOT_REGISTRY_FILE if the file could
+ * not be read and STATUS_REGISTRY_CORRUPT if a bin is corrupt
+ * and self healing is disabled.
+ *
+ * @remarks
+ * The whole hive still ends up in paged pool, bins are not
+ * mapped nor paged in on demand. The file is read in chunks
+ * of HV_LOAD_CHUNK_SIZE bytes and the bins are copied out of
+ * them, so that small bins don't need an I/O each. Bins that
+ * don't fit in the current chunk have their remaining part
+ * read directly into the bin.
+ */
+static
+NTSTATUS
+CMAPI
+HvpLoadHiveBins(
+    _In_ PHHIVE Hive)
+{
+    NTSTATUS Status;
+    PHMAP_ENTRY BlockList;
+    PUCHAR Chunk;
+    PHBIN Bin, NewBin;
+    ULONG StorageSize, ChunkOffset, ChunkLength;
+    ULONG BinOffset, BinSize, CopySize;
+    ULONG FileOffset;
+    ULONG BlockIndex, i;
+
+    StorageSize = Hive->BaseBlock->Length;
+    Hive->Storage[Stable].Length = StorageSize / HBLOCK_SIZE;
+    BlockList = Hive->Allocate(Hive->Storage[Stable].Length * sizeof(HMAP_ENTRY),
+                               FALSE, TAG_CM);
+    if (BlockList == NULL)
+    {
+        DPRINT1("Allocating block list failed\n");
+        Hive->Storage[Stable].Length = 0;
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    /* Zero the block list so that a failure only frees the bins read so far */
+    RtlZeroMemory(BlockList, Hive->Storage[Stable].Length * sizeof(HMAP_ENTRY));
+    Hive->Storage[Stable].BlockList = BlockList;
+
+    Chunk = Hive->Allocate(HV_LOAD_CHUNK_SIZE, TRUE, TAG_CM);
+    if (Chunk == NULL)
+    {
+        DPRINT1("Allocating the hive chunk failed\n");
+        HvpFreeHiveBins(Hive);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    ChunkOffset = 0;
+    ChunkLength = 0;
+    Status = STATUS_SUCCESS;
+    for (BlockIndex = 0; BlockIndex < Hive->Storage[Stable].Length; )
+    {
+        /* Read the next chunk of the file if the bin isn't in the current one */
+        BinOffset = BlockIndex * HBLOCK_SIZE;
+        if (BinOffset >= ChunkOffset + ChunkLength)
+        {
+            ChunkOffset = BinOffset;
+            ChunkLength = min(HV_LOAD_CHUNK_SIZE, StorageSize - BinOffset);
+            FileOffset = HBLOCK_SIZE + ChunkOffset;
+            if (!Hive->FileRead(Hive, HFILE_TYPE_PRIMARY, &FileOffset, Chunk, ChunkLength))
+            {
+                DPRINT1("Failed to read the hive at offset 0x%lx\n", FileOffset);
+                Status = STATUS_NOT_REGISTRY_FILE;
+                break;
+            }
+        }
+
+        Bin = (PHBIN)(Chunk + BinOffset - ChunkOffset);
+        if (Bin->Signature != HV_HBIN_SIGNATURE ||
+            Bin->Size == 0 ||
+            (Bin->Size % HBLOCK_SIZE) != 0 ||
+            Bin->Size > StorageSize - BinOffset ||
+            (Bin->FileOffset / HBLOCK_SIZE) != BlockIndex)
+        {
+            /* Fix the bin like HvpInitializeMemoryHive does, if we can */
+            if (!CmIsSelfHealEnabled(FALSE))
+            {
+                DPRINT1("Invalid bin at BlockIndex %lu, Signature 0x%x, Size 0x%x. Self-heal not possible!\n",
+                    BlockIndex, (unsigned)Bin->Signature, (unsigned)Bin->Size);
+                Status = STATUS_REGISTRY_CORRUPT;
+                break;
+            }
+
+            Bin->Signature = HV_HBIN_SIGNATURE;
+            Bin->Size = HBLOCK_SIZE;
+            Bin->FileOffset = BlockIndex * HBLOCK_SIZE;
+            Hive->BaseBlock->BootType |= HBOOT_TYPE_SELF_HEAL;
+            DPRINT1("Bin at index %lu is corrupt and it has been repaired!\n", BlockIndex);
+        }
+
+        BinSize = Bin->Size;
+        NewBin = Hive->Allocate(BinSize, TRUE, TAG_CM);
+        if (NewBin == NULL)
+        {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            break;
+        }
+
+        /* Copy what the chunk has of the bin and read the rest from the file */
+        CopySize = min(BinSize, ChunkOffset + ChunkLength - BinOffset);
+        RtlCopyMemory(NewBin, Bin, CopySize);
+        if (CopySize < BinSize)
+        {
+            FileOffset = HBLOCK_SIZE + BinOffset + CopySize;
+            if (!Hive->FileRead(Hive, HFILE_TYPE_PRIMARY, &FileOffset,
+                                (PUCHAR)NewBin + CopySize, BinSize - CopySize))
+            {
+                DPRINT1("Failed to read the bin at offset 0x%lx\n", FileOffset);
+                Hive->Free(NewBin, 0);
+                Status = STATUS_NOT_REGISTRY_FILE;
+                break;
+            }
+        }
+
+        for (i = 0; i < BinSize / HBLOCK_SIZE; i++)
+        {
+            BlockList[BlockIndex + i].BinAddress = (ULONG_PTR)NewBin;
+            BlockList[BlockIndex + i].BlockAddress = (ULONG_PTR)NewBin + i * HBLOCK_SIZE;
+        }
+
+        BlockIndex += BinSize / HBLOCK_SIZE;
+    }
+
+    Hive->Free(Chunk, 0);
+
+    if (!NT_SUCCESS(Status))
+        HvpFreeHiveBins(Hive);
+
+    return Status;
+}
+
 /**
  * @brief
  * Loads a registry hive from a physical hive file
@@ -1032,7 +1214,6 @@ HvLoadHive(
     _In_opt_ PCUNICODE_STRING FileName)
 {
     NTSTATUS Status;
-    BOOLEAN Success;
     PHBASE_BLOCK BaseBlock = NULL;
 /* FIXME: See the comment above (near HvpQueryHiveSize) */
 #if defined(_M_AMD64)
@@ -1041,9 +1222,6 @@ HvLoadHive(
     ULONG Result, Result2;
 #endif
     LARGE_INTEGER TimeStamp;
-    ULONG Offset = 0;
-    PVOID HiveData;
-    ULONG FileSize;
     BOOLEAN HiveSelfHeal = FALSE;
 
     /* Get the hive header */
@@ -1145,56 +1323,32 @@ HvLoadHive(
     /* Set the boot type */
     BaseBlock->BootType = HiveSelfHeal ? HBOOT_TYPE_SELF_HEAL : HBOOT_TYPE_REGULAR;
 
-    /* Setup hive data */
-    Hive->BaseBlock = BaseBlock;
-    Hive->Version = BaseBlock->Minor;
-
-    /* Allocate a buffer large enough to hold the hive */
-    FileSize = HBLOCK_SIZE + BaseBlock->Length; // == sizeof(HBASE_BLOCK) + BaseBlock->Length;
-    HiveData = Hive->Allocate(FileSize, TRUE, TAG_CM);
-    if (!HiveData)
+    /* Keep a non paged copy of the header, like memory hives do */
+    Hive->BaseBlock = HvpAllocBaseBlockAligned(Hive, FALSE, TAG_CM);
+    if (!Hive->BaseBlock)
     {
         Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
-        DPRINT1("There's no enough memory to allocate hive data\n");
+        DPRINT1("There's no enough memory to allocate the base block\n");
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
-    /* HACK (see explanation below): Now read the whole hive */
-    Success = Hive->FileRead(Hive,
-                             HFILE_TYPE_PRIMARY,
-                             &Offset,
-                             HiveData,
-                             FileSize);
-    if (!Success)
+    RtlCopyMemory(Hive->BaseBlock, BaseBlock, sizeof(HBASE_BLOCK));
+    Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+    Hive->Version = Hive->BaseBlock->Minor;
+
+    /* Now read the bins of the hive */
+    Status = HvpLoadHiveBins(Hive);
+    if (!NT_SUCCESS(Status))
     {
-        DPRINT1("Failed to read the whole hive\n");
-        Hive->Free(HiveData, FileSize);
-        Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
-        return STATUS_NOT_REGISTRY_FILE;
+        DPRINT1("Failed to read the hive bins (Status 0x%lx)\n", Status);
+        Hive->Free(Hive->BaseBlock, Hive->BaseBlockAlloc);
+        return Status;
     }
 
-    /*
-     * HACK (FIXME): Free our base block... it's useless in
-     * this implementation.
-     *
-     * And it's useless because while the idea of reading the
-     * hive from physical file is correct, the implementation
-     * is hacky and incorrect. Instead of reading the whole hive,
-     * we should be instead reading the hive block by block,
-     * deconstruct the block buffer and enlist the bins and
-     * prepare the storage for the hive. What we currently do
-     * is we try to initialize the hive storage and bins enlistment
-     * by calling HvpInitializeMemoryHive below. This mixes
-     * HINIT_FILE and HINIT_MEMORY together which is disgusting
-     * because HINIT_FILE implementation shouldn't be calling
-     * HvpInitializeMemoryHive.
-     */
-    Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
-    Status = HvpInitializeMemoryHive(Hive, HiveData, FileName);
+    Status = HvpInitializeHiveStorage(Hive, FileName);
     if (!NT_SUCCESS(Status))
     {
-        DPRINT1("Failed to initialize hive from memory\n");
-        Hive->Free(HiveData, FileSize);
+        DPRINT1("Failed to initialize the hive storage\n");
         return Status;
     }
 
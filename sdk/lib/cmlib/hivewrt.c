@@ -23,8 +23,142 @@ IoSetThreadHardErrorMode(
 
 /* GLOBALS ******************************************************************/
 
+/*
+ * Blocks that aren't contiguous in memory are gathered in a buffer
+ * of this size, so that each write covers up to that many bytes.
+ */
+#define HV_WRITE_GATHER_SIZE    (16 * HBLOCK_SIZE)
+
 /* PRIVATE FUNCTIONS ********************************************************/
 
+/**
+ * @brief
+ * Writes a run of consecutive stable blocks of a hive
+ * to a file, with as few write requests as possible.
+ *
+ * @param[in] RegistryHive
+ * A pointer to a hive descriptor that owns the blocks.
+ *
+ * @param[in] FileType
+ * The file type of the file to write into.
+ *
+ * @param[in,out] FileOffset
+ * The file offset where the run is written. On return,
+ * it points past the end of the written run.
+ *
+ * @param[in] BlockIndex
+ * The index of the first block of the run.
+ *
+ * @param[in] BlockCount
+ * The number of blocks in the run.
+ *
+ * @param[in] GatherBuffer
+ * An optional buffer of HV_WRITE_GATHER_SIZE bytes used to
+ * gather the blocks that aren't contiguous in memory. Each
+ * block is written on its own if it is NULL.
+ *
+ * @return
+ * Returns TRUE if the run was written, FALSE otherwise.
+ *
+ * @remarks
+ * Blocks of the same bin are contiguous in memory and are
+ * written straight from the hive storage.
+ */
+static
+BOOLEAN
+CMAPI
+HvpWriteBlockRun(
+    _In_ PHHIVE RegistryHive,
+    _In_ ULONG FileType,
+    _Inout_ PULONG FileOffset,
+    _In_ ULONG BlockIndex,
+    _In_ ULONG BlockCount,
+    _In_opt_ PUCHAR GatherBuffer)
+{
+    PHMAP_ENTRY BlockList = RegistryHive->Storage[Stable].BlockList;
+    ULONG_PTR Block;
+    ULONG Count, i;
+    PVOID Buffer;
+
+    while (BlockCount > 0)
+    {
+        /* Count the blocks that are contiguous in memory */
+        Block = BlockList[BlockIndex].BlockAddress;
+        for (Count = 1; Count < BlockCount; Count++)
+        {
+            if (BlockList[BlockIndex + Count].BlockAddress != Block + Count * HBLOCK_SIZE)
+                break;
+        }
+
+        if ((Count < HV_WRITE_GATHER_SIZE / HBLOCK_SIZE) && (Count < BlockCount) && GatherBuffer)
+        {
+            /* Copy the next blocks together, to write them at once */
+            Count = min(BlockCount, HV_WRITE_GATHER_SIZE / HBLOCK_SIZE);
+            for (i = 0; i < Count; i++)
+            {
+                RtlCopyMemory(GatherBuffer + i * HBLOCK_SIZE,
+                              (PVOID)BlockList[BlockIndex + i].BlockAddress,
+                              HBLOCK_SIZE);
+            }
+            Buffer = GatherBuffer;
+        }
+        else
+        {
+            Buffer = (PVOID)Block;
+        }
+
+        if (!RegistryHive->FileWrite(RegistryHive, FileType,
+                                     FileOffset, Buffer, Count * HBLOCK_SIZE))
+        {
+            DPRINT1("Failed to write %lu blocks at block index 0x%x\n", Count, BlockIndex);
+            return FALSE;
+        }
+
+        BlockIndex += Count;
+        BlockCount -= Count;
+        *FileOffset += Count * HBLOCK_SIZE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * @brief
+ * Finds the next run of dirty stable blocks of a hive.
+ *
+ * @param[in] RegistryHive
+ * A pointer to a hive descriptor to look for dirty blocks.
+ *
+ * @param[in,out] BlockIndex
+ * On input, the index where the search starts. On output,
+ * the index of the first dirty block of the run.
+ *
+ * @return
+ * Returns the number of dirty blocks in the run, or 0
+ * if there are no dirty blocks left.
+ */
+static
+ULONG
+CMAPI
+HvpFindDirtyRun(
+    _In_ PHHIVE RegistryHive,
+    _Inout_ PULONG BlockIndex)
+{
+    ULONG Length = RegistryHive->Storage[Stable].Length;
+    ULONG RunStart;
+    ULONG RunLength;
+
+    if (*BlockIndex >= Length)
+        return 0;
+
+    RunLength = RtlFindNextForwardRunSet(&RegistryHive->DirtyVector, *BlockIndex, &RunStart);
+    if (RunLength == 0 || RunStart < *BlockIndex || RunStart >= Length)
+        return 0;
+
+    *BlockIndex = RunStart;
+    return min(RunLength, Length - RunStart);
+}
+
 /**
  * @brief
  * Validates the base block header of a primary
@@ -88,10 +222,9 @@ HvpWriteLog(
     BOOLEAN Success;
     ULONG FileOffset;
     ULONG BlockIndex;
-    ULONG LastIndex;
-    PVOID Block;
+    ULONG RunLength;
     UINT32 BitmapSize, BufferSize;
-    PUCHAR HeaderBuffer, Ptr;
+    PUCHAR HeaderBuffer, Ptr, GatherBuffer;
 
     /*
      * The hive log we are going to write data into
@@ -172,25 +305,17 @@ HvpWriteLog(
      * here.
      */
     BlockIndex = 0;
-    while (BlockIndex < RegistryHive->Storage[Stable].Length)
+    while ((RunLength = HvpFindDirtyRun(RegistryHive, &BlockIndex)) != 0)
     {
-        /* Check if the block is clean or we're past the last block */
-        LastIndex = BlockIndex;
-        BlockIndex = RtlFindSetBits(&RegistryHive->DirtyVector, 1, BlockIndex);
-        if (BlockIndex == ~HV_CLEAN_BLOCK || BlockIndex < LastIndex)
-        {
-            break;
-        }
-
         /*
-         * Mark this block as dirty and go to the next one.
+         * Mark this run as dirty and go to the next one.
          *
          * FIXME: We should rather use RtlSetBits but that crashes
          * the system with a bugckeck. So for now mark blocks manually
          * by hand.
          */
-        Ptr[BlockIndex] = HV_LOG_DIRTY_BLOCK;
-        BlockIndex++;
+        RtlFillMemory(&Ptr[BlockIndex], RunLength, HV_LOG_DIRTY_BLOCK);
+        BlockIndex += RunLength;
     }
 
     /* Now write the hive header and block bitmap into the log */
@@ -204,36 +329,30 @@ HvpWriteLog(
         return FALSE;
     }
 
-    /* Now write the actual dirty data to log */
+    /*
+     * Now write the actual dirty data to log. The dirty blocks
+     * follow each other in the log, so write them run by run.
+     */
+    GatherBuffer = RegistryHive->Allocate(HV_WRITE_GATHER_SIZE, TRUE, TAG_CM);
     FileOffset = BufferSize;
     BlockIndex = 0;
-    while (BlockIndex < RegistryHive->Storage[Stable].Length)
+    while ((RunLength = HvpFindDirtyRun(RegistryHive, &BlockIndex)) != 0)
     {
-        /* Check if the block is clean or we're past the last block */
-        LastIndex = BlockIndex;
-        BlockIndex = RtlFindSetBits(&RegistryHive->DirtyVector, 1, BlockIndex);
-        if (BlockIndex == ~HV_CLEAN_BLOCK || BlockIndex < LastIndex)
-        {
-            break;
-        }
-
-        /* Get the block */
-        Block = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
-
-        /* Write it to log */
-        Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
-                                          &FileOffset, Block, HBLOCK_SIZE);
+        Success = HvpWriteBlockRun(RegistryHive, HFILE_TYPE_LOG, &FileOffset,
+                                   BlockIndex, RunLength, GatherBuffer);
         if (!Success)
         {
-            DPRINT1("Failed to write dirty block to log (block 0x%p, block index 0x%x)\n", Block, BlockIndex);
+            DPRINT1("Failed to write dirty blocks to log (block index 0x%x, %lu blocks)\n",
+                    BlockIndex, RunLength);
+            if (GatherBuffer) RegistryHive->Free(GatherBuffer, 0);
             return FALSE;
         }
 
-        /* Grow up the file offset as we go to the next block */
-        BlockIndex++;
-        FileOffset += HBLOCK_SIZE;
+        BlockIndex += RunLength;
     }
 
+    if (GatherBuffer) RegistryHive->Free(GatherBuffer, 0);
+
     /*
      * We wrote the header and body of log with dirty,
      * data do a flush immediately.
@@ -316,8 +435,8 @@ HvpWriteHive(
     BOOLEAN Success;
     ULONG FileOffset;
     ULONG BlockIndex;
-    ULONG LastIndex;
-    PVOID Block;
+    ULONG RunLength;
+    PUCHAR GatherBuffer;
 
     ASSERT(!RegistryHive->ReadOnly);
     ASSERT(RegistryHive->BaseBlock->Length ==
@@ -361,7 +480,8 @@ HvpWriteHive(
         return FALSE;
     }
 
-    /* Write the whole primary hive, block by block */
+    /* Write the whole primary hive, run by run */
+    GatherBuffer = RegistryHive->Allocate(HV_WRITE_GATHER_SIZE, TRUE, TAG_CM);
     BlockIndex = 0;
     while (BlockIndex < RegistryHive->Storage[Stable].Length)
     {
@@ -374,33 +494,33 @@ HvpWriteHive(
          */
         if (OnlyDirty)
         {
-            /* Check if the block is clean or we're past the last block */
-            LastIndex = BlockIndex;
-            BlockIndex = RtlFindSetBits(&RegistryHive->DirtyVector, 1, BlockIndex);
-            if (BlockIndex == ~HV_CLEAN_BLOCK || BlockIndex < LastIndex)
-            {
+            RunLength = HvpFindDirtyRun(RegistryHive, &BlockIndex);
+            if (RunLength == 0)
                 break;
-            }
+        }
+        else
+        {
+            RunLength = RegistryHive->Storage[Stable].Length;
         }
 
-        /* Get the block and offset position */
-        Block = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
+        /* Now write this run to primary hive file */
         FileOffset = (BlockIndex + 1) * HBLOCK_SIZE;
-
-        /* Now write this block to primary hive file */
-        Success = RegistryHive->FileWrite(RegistryHive, FileType,
-                                          &FileOffset, Block, HBLOCK_SIZE);
+        Success = HvpWriteBlockRun(RegistryHive, FileType, &FileOffset,
+                                   BlockIndex, RunLength, GatherBuffer);
         if (!Success)
         {
-            DPRINT1("Failed to write hive block to primary hive file (block 0x%p, block index 0x%x)\n",
-                    Block, BlockIndex);
+            DPRINT1("Failed to write hive blocks to primary hive file (block index 0x%x, %lu blocks)\n",
+                    BlockIndex, RunLength);
+            if (GatherBuffer) RegistryHive->Free(GatherBuffer, 0);
             return FALSE;
         }
 
-        /* Go to the next block */
-        BlockIndex++;
+        /* Go to the next run */
+        BlockIndex += RunLength;
     }
 
+    if (GatherBuffer) RegistryHive->Free(GatherBuffer, 0);
+
     /*
      * We wrote all the hive contents to the file, we
      * must flush the changes to disk now.
@@ -0,0 +1,85 @@
+/*
+ * PROJECT:     ReactOS CRT library
+ * LICENSE:     MIT (https://spdx.org/licenses/MIT)
+ * PURPOSE:     x64 asm implementation of memchr
+ */
+
+/* INCLUDES ******************************************************************/
+
+#include <asm.inc>
+
+/* CODE **********************************************************************/
+.code64
+
+/*
+ * void *memchr(const void *buffer <rcx>, int c <edx>, size_t count <r8>)
+ *
+ * Compares 16 bytes at a time. Only aligned blocks are read, they never
+ * cross a page boundary, so reading past either end of the buffer is safe.
+ */
+PUBLIC memchr
+FUNC memchr
+    .endprolog
+
+    test r8, r8
+    jz .Lnotfound
+
+    /* Replicate the byte into all bytes of xmm1 */
+    movd xmm1, edx
+    punpcklbw xmm1, xmm1
+    punpcklwd xmm1, xmm1
+    pshufd xmm1, xmm1, 0
+
+    /* r9 = first aligned block, ecx = offset of the buffer inside it */
+    mov r9, rcx
+    and r9, -16
+    and ecx, 15
+
+    /* Check the first block, ignoring the bytes before the buffer */
+    movdqa xmm0, [r9]
+    pcmpeqb xmm0, xmm1
+    pmovmskb eax, xmm0
+    shr eax, cl
+    test eax, eax
+    jz .Lnext
+
+    bsf eax, eax
+    cmp rax, r8
+    jae .Lnotfound
+    add rax, r9
+    add rax, rcx
+    ret
+
+.Lnext:
+    /* r8 = bytes left after the first block */
+    lea r10, [r8 + rcx]
+    sub r10, 16
+    jbe .Lnotfound
+    mov r8, r10
+    add r9, 16
+
+.Lloop:
+    movdqa xmm0, [r9]
+    pcmpeqb xmm0, xmm1
+    pmovmskb eax, xmm0
+    test eax, eax
+    jnz .Lfound
+    sub r8, 16
+    jbe .Lnotfound
+    add r9, 16
+    jmp .Lloop
+
+.Lfound:
+    bsf eax, eax
+    cmp rax, r8
+    jae .Lnotfound
+    add rax, r9
+    ret
+
+.Lnotfound:
+    xor eax, eax
+    ret
+
+ENDFUNC
+
+END
@@ -0,0 +1,85 @@
+/*
+ * PROJECT:     ReactOS CRT library
+ * LICENSE:     MIT (https://spdx.org/licenses/MIT)
+ * PURPOSE:     x64 asm implementation of memcmp
+ */
+
+/* INCLUDES ******************************************************************/
+
+#include <asm.inc>
+
+/* CODE **********************************************************************/
+.code64
+
+/*
+ * int memcmp(const void *buf1 <rcx>, const void *buf2 <rdx>, size_t count <r8>)
+ *
+ * Returns the difference of the first pair of bytes that differ.
+ */
+PUBLIC memcmp
+FUNC memcmp
+    .endprolog
+
+    /* rdx = offset of buf2 */
+    sub rdx, rcx
+
+    cmp r8, 16
+    jb .Ltail
+
+.Lloop16:
+    movdqu xmm0, [rcx]
+    movdqu xmm1, [rcx + rdx]
+    pcmpeqb xmm0, xmm1
+    pmovmskb eax, xmm0
+    xor eax, HEX(FFFF)
+    jnz .Lfound
+    add rcx, 16
+    sub r8, 16
+    cmp r8, 16
+    jae .Lloop16
+
+.Ltail:
+    cmp r8, 8
+    jb .Lbytes
+    mov rax, [rcx]
+    mov r9, [rcx + rdx]
+    xor rax, r9
+    jnz .Lfound_qword
+    add rcx, 8
+    sub r8, 8
+
+.Lbytes:
+    test r8, r8
+    jz .Lequal
+    movzx eax, byte ptr [rcx]
+    movzx r9d, byte ptr [rcx + rdx]
+    sub eax, r9d
+    jnz .Ldone
+    inc rcx
+    dec r8
+    jmp .Lbytes
+
+.Lequal:
+    xor eax, eax
+.Ldone:
+    ret
+
+.Lfound_qword:
+    /* Convert the lowest differing bit into a byte index */
+    bsf rax, rax
+    shr eax, 3
+    jmp .Lfound_byte
+
+.Lfound:
+    bsf eax, eax
+
+.Lfound_byte:
+    add rcx, rax
+    movzx eax, byte ptr [rcx]
+    movzx r9d, byte ptr [rcx + rdx]
+    sub eax, r9d
+    ret
+
+ENDFUNC
+
+END
@@ -0,0 +1,248 @@
+/*
+ * PROJECT:     ReactOS CRT library
+ * LICENSE:     MIT (https://spdx.org/licenses/MIT)
+ * PURPOSE:     x64 asm implementation of memcpy and memmove
+ */
+
+/* INCLUDES ******************************************************************/
+
+#include <asm.inc>
+
+/* Copies of at least this size are done with rep movs */
+#define MEMMOVE_REP_THRESHOLD 2048
+
+/* DATA **********************************************************************/
+
+/* Enhanced rep movsb/stosb support: 0 = not checked yet, 1 = no, 2 = yes.
+   Shared with memset */
+.data
+PUBLIC MemErmsSupport
+#ifdef _USE_ML
+MemErmsSupport DB 0
+#else
+MemErmsSupport:
+    .byte 0
+#endif
+
+/* CODE **********************************************************************/
+.code
+
+/*
+ * void *memmove(void *dest <rcx>, const void *src <rdx>, size_t count <r8>)
+ *
+ * memcpy is the same function, overlapping buffers are always handled.
+ * Up to 32 bytes are copied by loading head and tail first, larger
+ * copies store 16 byte aligned blocks to the destination.
+ */
+PUBLIC memcpy
+PUBLIC memmove
+
+memcpy:
+FUNC memmove
+    .endprolog
+
+    mov rax, rcx
+    cmp r8, 16
+    ja .L17orMore
+
+    /* 0 - 16 bytes: load both ends, then store them */
+    cmp r8, 8
+    jb .L0to7
+    mov r9, [rdx]
+    mov r10, [rdx + r8 - 8]
+    mov [rcx], r9
+    mov [rcx + r8 - 8], r10
+    ret
+
+.L0to7:
+    cmp r8, 4
+    jb .L0to3
+    mov r9d, [rdx]
+    mov r10d, [rdx + r8 - 4]
+    mov [rcx], r9d
+    mov [rcx + r8 - 4], r10d
+    ret
+
+.L0to3:
+    test r8, r8
+    jz .Ldone
+    movzx r9d, byte ptr [rdx]
+    movzx r10d, byte ptr [rdx + r8 - 1]
+    cmp r8, 2
+    jb .L1
+    movzx r11d, byte ptr [rdx + 1]
+    mov [rcx + 1], r11b
+.L1:
+    mov [rcx], r9b
+    mov [rcx + r8 - 1], r10b
+.Ldone:
+    ret
+
+.L17orMore:
+    /* Load the first and the last 16 bytes */
+    movdqu xmm0, [rdx]
+    movdqu xmm1, [rdx + r8 - 16]
+    cmp r8, 32
+    ja .L33orMore
+
+    /* 17 - 32 bytes: the two blocks cover everything */
+    movdqu [rcx], xmm0
+    movdqu [rcx + r8 - 16], xmm1
+    ret
+
+.L33orMore:
+    /* r9 = end of the destination */
+    lea r9, [rcx + r8]
+
+    /* Copy backwards if the destination starts inside the source */
+    mov r10, rcx
+    sub r10, rdx
+    cmp r10, r8
+    jb .Lbackward
+
+    cmp r8, MEMMOVE_REP_THRESHOLD
+    jae MemMoveRep
+
+    /* rdx = source offset, r10 = first aligned block after the head,
+       r11 = start of the tail */
+    sub rdx, rcx
+    lea r10, [rcx + 16]
+    and r10, -16
+    lea r11, [r9 - 16]
+
+.Lforward32:
+    lea r8, [r10 + 32]
+    cmp r8, r11
+    ja .Lforward16
+    movdqu xmm2, [r10 + rdx]
+    movdqu xmm3, [r10 + rdx + 16]
+    movdqa [r10], xmm2
+    movdqa [r10 + 16], xmm3
+    mov r10, r8
+    jmp .Lforward32
+
+.Lforward16:
+    cmp r10, r11
+    jae .Lstore_ends
+    movdqu xmm2, [r10 + rdx]
+    movdqa [r10], xmm2
+    add r10, 16
+    jmp .Lforward16
+
+.Lbackward:
+    /* rdx = source offset, r10 = end of the last aligned block before
+       the tail, r11 = end of the head */
+    sub rdx, rcx
+    mov r10, r9
+    and r10, -16
+    lea r11, [rcx + 16]
+
+.Lbackward32:
+    lea r8, [r10 - 32]
+    cmp r8, r11
+    jb .Lbackward16
+    movdqu xmm2, [r10 + rdx - 16]
+    movdqu xmm3, [r10 + rdx - 32]
+    movdqa [r10 - 16], xmm2
+    movdqa [r10 - 32], xmm3
+    mov r10, r8
+    jmp .Lbackward32
+
+.Lbackward16:
+    cmp r10, r11
+    jbe .Lstore_ends
+    movdqu xmm2, [r10 + rdx - 16]
+    movdqa [r10 - 16], xmm2
+    sub r10, 16
+    jmp .Lbackward16
+
+.Lstore_ends:
+    /* Store head and tail last, they were loaded before anything was written */
+    movdqu [rcx], xmm0
+    movdqu [r9 - 16], xmm1
+    ret
+
+ENDFUNC
+
+/*
+ * Forward copy of MEMMOVE_REP_THRESHOLD bytes or more with rep movs.
+ * Jumped to from memmove with rcx = dest, rdx = src, r9 = end of the
+ * destination and xmm0, xmm1 = the first and the last 16 source bytes.
+ */
+FUNC MemMoveRep
+    push rsi
+    .pushreg rsi
+    push rdi
+    .pushreg rdi
+    .endprolog
+
+    cmp byte ptr [rip+MemErmsSupport], 0
+    jne .Lrep_checked
+    call MemCheckErms
+
+.Lrep_checked:
+    /* Copy from the first aligned destination block to the end */
+    mov rax, rcx
+    lea rdi, [rcx + 16]
+    and rdi, -16
+    mov rsi, rdi
+    sub rsi, rcx
+    add rsi, rdx
+    mov rcx, r9
+    sub rcx, rdi
+    cmp byte ptr [rip+MemErmsSupport], 2
+    je .Lrep_movsb
+
+    /* Without ERMS move qwords, the tail covers what is left */
+    shr rcx, 3
+    rep movsq
+    jmp .Lrep_done
+
+.Lrep_movsb:
+    rep movsb
+
+.Lrep_done:
+    /* Store head and tail last, they were loaded before anything was written */
+    movdqu [rax], xmm0
+    movdqu [r9 - 16], xmm1
+    pop rdi
+    pop rsi
+    ret
+
+ENDFUNC
+
+/*
+ * Sets MemErmsSupport from CPUID, called on the first rep movs or rep stos.
+ * Only rax and the flags are changed.
+ */
+PUBLIC MemCheckErms
+FUNC MemCheckErms
+    push rbx
+    .pushreg rbx
+    push rcx
+    .pushreg rcx
+    push rdx
+    .pushreg rdx
+    .endprolog
+
+    mov byte ptr [rip+MemErmsSupport], 1
+    xor eax, eax
+    cpuid
+    cmp eax, 7
+    jb .Lerms_checked
+    mov eax, 7
+    xor ecx, ecx
+    cpuid
+    test ebx, HEX(200)
+    jz .Lerms_checked
+    mov byte ptr [rip+MemErmsSupport], 2
+
+.Lerms_checked:
+    pop rdx
+    pop rcx
+    pop rbx
+    ret
+
+ENDFUNC
+
+END
@@ -0,0 +1,141 @@
+/*
+ * PROJECT:     ReactOS CRT library
+ * LICENSE:     MIT (https://spdx.org/licenses/MIT)
+ * PURPOSE:     x64 asm implementation of memset
+ */
+
+/* INCLUDES ******************************************************************/
+
+#include <asm.inc>
+
+/* Fills of at least this size are done with rep stos */
+#define MEMSET_REP_THRESHOLD 2048
+
+/* Enhanced rep stosb support, from memmove_asm.s */
+EXTERN MemErmsSupport:BYTE
+EXTERN MemCheckErms:PROC
+
+/* CODE **********************************************************************/
+.code
+
+/*
+ * void *memset(void *dest <rcx>, int value <edx>, size_t count <r8>)
+ */
+PUBLIC memset
+FUNC memset
+    .endprolog
+
+    mov rax, rcx
+
+    /* Replicate the fill byte into all bytes of rdx */
+    movzx edx, dl
+    mov r9, HEX(0101010101010101)
+    imul rdx, r9
+
+    cmp r8, 16
+    ja .L17orMore
+
+    /* 0 - 16 bytes: store both ends */
+    cmp r8, 8
+    jb .L0to7
+    mov [rcx], rdx
+    mov [rcx + r8 - 8], rdx
+    ret
+
+.L0to7:
+    cmp r8, 4
+    jb .L0to3
+    mov [rcx], edx
+    mov [rcx + r8 - 4], edx
+    ret
+
+.L0to3:
+    test r8, r8
+    jz .Ldone
+    mov [rcx], dl
+    mov [rcx + r8 - 1], dl
+    cmp r8, 2
+    jbe .Ldone
+    mov [rcx + 1], dl
+.Ldone:
+    ret
+
+.L17orMore:
+    /* Store the first and the last 16 bytes */
+    movd xmm0, edx
+    pshufd xmm0, xmm0, 0
+    movdqu [rcx], xmm0
+    movdqu [rcx + r8 - 16], xmm0
+    cmp r8, 32
+    jbe .Ldone
+
+    /* r9 = end of the buffer */
+    lea r9, [rcx + r8]
+
+    cmp r8, MEMSET_REP_THRESHOLD
+    jae MemSetRep
+
+    /* r10 = first aligned block after the head, r11 = start of the tail */
+    lea r10, [rcx + 16]
+    and r10, -16
+    lea r11, [r9 - 16]
+
+.Lfill32:
+    lea r8, [r10 + 32]
+    cmp r8, r11
+    ja .Lfill16
+    movdqa [r10], xmm0
+    movdqa [r10 + 16], xmm0
+    mov r10, r8
+    jmp .Lfill32
+
+.Lfill16:
+    cmp r10, r11
+    jae .Ldone
+    movdqa [r10], xmm0
+    add r10, 16
+    jmp .Lfill16
+
+ENDFUNC
+
+/*
+ * Fill of MEMSET_REP_THRESHOLD bytes or more with rep stos. Jumped to from
+ * memset with rcx = dest, rdx = the fill pattern and r9 = end of the buffer,
+ * the first and the last 16 bytes are already stored.
+ */
+FUNC MemSetRep
+    push rdi
+    .pushreg rdi
+    .endprolog
+
+    cmp byte ptr [rip+MemErmsSupport], 0
+    jne .Lrep_checked
+    call MemCheckErms
+
+.Lrep_checked:
+    /* Fill from the first aligned block to the end */
+    mov r11, rcx
+    lea rdi, [rcx + 16]
+    and rdi, -16
+    mov rcx, r9
+    sub rcx, rdi
+    mov rax, rdx
+    cmp byte ptr [rip+MemErmsSupport], 2
+    je .Lrep_stosb
+
+    /* Without ERMS store qwords, the tail covers what is left */
+    shr rcx, 3
+    rep stosq
+    jmp .Lrep_done
+
+.Lrep_stosb:
+    rep stosb
+
+.Lrep_done:
+    mov rax, r11
+    pop rdi
+    ret
+
+ENDFUNC
+
+END
@@ -1,11 +1,13 @@
 
 list(APPEND LIBCNTPR_MEM_SOURCE
     mem/memccpy.c
-    mem/memcmp.c
     mem/memicmp.c
 )
 
 if(ARCH STREQUAL "i386")
+    list(APPEND LIBCNTPR_MEM_SOURCE
+        mem/memcmp.c
+    )
     list(APPEND LIBCNTPR_MEM_ASM_SOURCE
         mem/i386/memchr_asm.s
         mem/i386/memmove_asm.s
@@ -14,9 +16,20 @@ if(ARCH STREQUAL "i386")
     list(APPEND CRT_MEM_ASM_SOURCE
         ${LIBCNTPR_MEM_ASM_SOURCE}
     )
+elseif(ARCH STREQUAL "amd64")
+    list(APPEND LIBCNTPR_MEM_ASM_SOURCE
+        mem/amd64/memchr_asm.s
+        mem/amd64/memcmp_asm.s
+        mem/amd64/memmove_asm.s
+        mem/amd64/memset_asm.s
+    )
+    list(APPEND CRT_MEM_ASM_SOURCE
+        ${LIBCNTPR_MEM_ASM_SOURCE}
+    )
 else()
     list(APPEND LIBCNTPR_MEM_SOURCE
         mem/memchr.c
+        mem/memcmp.c
         mem/memcpy.c
         mem/memmove.c
         mem/memset.c
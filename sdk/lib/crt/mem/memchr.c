@@ -5,11 +5,49 @@
 #pragma function(memchr)
 #endif /* _MSC_VER */
 
+#define WORD_SIZE sizeof(size_t)
+#define WORD_MASK (WORD_SIZE - 1)
+
+/* Every byte set to 0x01 and 0x80 */
+#define WORD_LOW_BITS (~(size_t)0 / 0xFF)
+#define WORD_HIGH_BITS (WORD_LOW_BITS << 7)
+
+/* Non-zero if any byte of the word is zero */
+#define WORD_HAS_ZERO_BYTE(w) (((w) - WORD_LOW_BITS) & ~(w) & WORD_HIGH_BITS)
+
 void* __cdecl memchr(const void *s, int c, size_t n)
 {
+    const unsigned char *p = s;
+    const size_t *word_p;
+    size_t word_c;
+
+    c = (unsigned char)c;
+
+    if (n >= 2 * WORD_SIZE)
+    {
+        /* Align the pointer */
+        while ((size_t)p & WORD_MASK)
+        {
+            if (*p == c)
+                return (void *)p;
+            p++;
+            n--;
+        }
+
+        /* Skip words that do not contain the byte */
+        word_c = WORD_LOW_BITS * c;
+        word_p = (const size_t *)p;
+        while ((n >= WORD_SIZE) && !WORD_HAS_ZERO_BYTE(*word_p ^ word_c))
+        {
+            word_p++;
+            n -= WORD_SIZE;
+        }
+
+        p = (const unsigned char *)word_p;
+    }
+
     if (n)
     {
-        const char *p = s;
         do {
             if (*p++ == c)
                 return (void *)(p-1);
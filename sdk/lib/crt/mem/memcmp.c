@@ -6,10 +6,35 @@
 #pragma function(memcmp)
 #endif
 
+#define WORD_SIZE sizeof(size_t)
+#define WORD_MASK (WORD_SIZE - 1)
+
 int __cdecl memcmp(const void *s1, const void *s2, size_t n)
 {
+    const unsigned char *p1 = s1, *p2 = s2;
+
+    /* Skip equal words, if both buffers can be aligned */
+    if ((n >= 2 * WORD_SIZE) &&
+        ((((size_t)p1 ^ (size_t)p2) & WORD_MASK) == 0))
+    {
+        while ((size_t)p1 & WORD_MASK) {
+            if (*p1 != *p2)
+                return (*p1 - *p2);
+            p1++;
+            p2++;
+            n--;
+        }
+
+        while ((n >= WORD_SIZE) &&
+               (*(const size_t *)p1 == *(const size_t *)p2)) {
+            p1 += WORD_SIZE;
+            p2 += WORD_SIZE;
+            n -= WORD_SIZE;
+        }
+    }
+
+    /* Find the byte that differs */
     if (n != 0) {
-        const unsigned char *p1 = s1, *p2 = s2;
         do {
             if (*p1++ != *p2++)
                 return (*--p1 - *--p2);
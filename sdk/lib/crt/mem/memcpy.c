@@ -4,15 +4,54 @@
 #pragma function(memcpy)
 #endif /* _MSC_VER */
 
+#define WORD_SIZE sizeof(size_t)
+#define WORD_MASK (WORD_SIZE - 1)
+
 /* NOTE: This code is a duplicate of memmove implementation! */
 void* __cdecl memcpy(void* dest, const void* src, size_t count)
 {
     char *char_dest = (char *)dest;
     char *char_src = (char *)src;
+    size_t *word_dest;
+    size_t *word_src;
 
-    if ((char_dest <= char_src) || (char_dest >= (char_src+count)))
+    if ((size_t)(char_dest - char_src) >= count)
     {
-        /*  non-overlapping buffers */
+        /* non-overlapping buffers, or the destination is below the source */
+        if ((count >= 4 * WORD_SIZE) &&
+            ((((size_t)char_dest ^ (size_t)char_src) & WORD_MASK) == 0))
+        {
+            /* Align the destination, the source is then aligned as well */
+            while ((size_t)char_dest & WORD_MASK)
+            {
+                *char_dest++ = *char_src++;
+                count--;
+            }
+
+            word_dest = (size_t *)char_dest;
+            word_src = (size_t *)char_src;
+
+            while (count >= 4 * WORD_SIZE)
+            {
+                word_dest[0] = word_src[0];
+                word_dest[1] = word_src[1];
+                word_dest[2] = word_src[2];
+                word_dest[3] = word_src[3];
+                word_dest += 4;
+                word_src += 4;
+                count -= 4 * WORD_SIZE;
+            }
+
+            while (count >= WORD_SIZE)
+            {
+                *word_dest++ = *word_src++;
+                count -= WORD_SIZE;
+            }
+
+            char_dest = (char *)word_dest;
+            char_src = (char *)word_src;
+        }
+
         while(count > 0)
 	{
             *char_dest = *char_src;
@@ -24,14 +63,46 @@ void* __cdecl memcpy(void* dest, const void* src, size_t count)
     else
     {
         /* overlaping buffers */
-        char_dest = (char *)dest + count - 1;
-        char_src = (char *)src + count - 1;
+        char_dest = (char *)dest + count;
+        char_src = (char *)src + count;
+
+        if ((count >= 4 * WORD_SIZE) &&
+            ((((size_t)char_dest ^ (size_t)char_src) & WORD_MASK) == 0))
+        {
+            /* Align the end of the destination */
+            while ((size_t)char_dest & WORD_MASK)
+            {
+                *--char_dest = *--char_src;
+                count--;
+            }
+
+            word_dest = (size_t *)char_dest;
+            word_src = (size_t *)char_src;
+
+            while (count >= 4 * WORD_SIZE)
+            {
+                word_dest -= 4;
+                word_src -= 4;
+                word_dest[3] = word_src[3];
+                word_dest[2] = word_src[2];
+                word_dest[1] = word_src[1];
+                word_dest[0] = word_src[0];
+                count -= 4 * WORD_SIZE;
+            }
+
+            while (count >= WORD_SIZE)
+            {
+                *--word_dest = *--word_src;
+                count -= WORD_SIZE;
+            }
+
+            char_dest = (char *)word_dest;
+            char_src = (char *)word_src;
+        }
 
         while(count > 0)
 	{
-           *char_dest = *char_src;
-           char_dest--;
-           char_src--;
+           *--char_dest = *--char_src;
            count--;
 	}
     }
@@ -5,9 +5,47 @@
 #pragma function(memset)
 #endif /* _MSC_VER */
 
+#define WORD_SIZE sizeof(size_t)
+#define WORD_MASK (WORD_SIZE - 1)
+
 void* __cdecl memset(void* src, int val, size_t count)
 {
     char *char_src = (char *)src;
+    size_t *word_src;
+    size_t word_val;
+
+    if (count >= 4 * WORD_SIZE)
+    {
+        /* Align the buffer */
+        while ((size_t)char_src & WORD_MASK)
+        {
+            *char_src++ = val;
+            count--;
+        }
+
+        /* Replicate the byte into all bytes of a word */
+        word_val = (~(size_t)0 / 0xFF) * (unsigned char)val;
+
+        word_src = (size_t *)char_src;
+
+        while (count >= 4 * WORD_SIZE)
+        {
+            word_src[0] = word_val;
+            word_src[1] = word_val;
+            word_src[2] = word_val;
+            word_src[3] = word_val;
+            word_src += 4;
+            count -= 4 * WORD_SIZE;
+        }
+
+        while (count >= WORD_SIZE)
+        {
+            *word_src++ = word_val;
+            count -= WORD_SIZE;
+        }
+
+        char_src = (char *)word_src;
+    }
 
     while(count>0) {
         *char_src = val;
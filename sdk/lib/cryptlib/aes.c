@@ -29,6 +29,7 @@
  */
 
 #include "tomcrypt.h"
+#include "cryptsimd.h"
 
 static const ulong32 TE0[256] = {
     0xc66363a5UL, 0xf87c7c84UL, 0xee777799UL, 0xf67b7b8dUL,
@@ -1066,6 +1067,13 @@ void aes_ecb_encrypt(const unsigned char *pt, unsigned char *ct, aes_key *skey)
     ulong32 s0, s1, s2, s3, t0, t1, t2, t3, *rk;
     int Nr, r;
 
+#ifdef CRYPT_HAVE_SIMD
+    if (CryptCpuFeatures & CRYPT_CPU_AESNI) {
+        aesni_ecb_encrypt(pt, ct, skey);
+        return;
+    }
+#endif
+
     Nr = skey->Nr;
     rk = skey->eK;
 
@@ -1167,6 +1175,13 @@ void aes_ecb_decrypt(const unsigned char *ct, unsigned char *pt, aes_key *skey)
     ulong32 s0, s1, s2, s3, t0, t1, t2, t3, *rk;
     int Nr, r;
 
+#ifdef CRYPT_HAVE_SIMD
+    if (CryptCpuFeatures & CRYPT_CPU_AESNI) {
+        aesni_ecb_decrypt(ct, pt, skey);
+        return;
+    }
+#endif
+
     Nr = skey->Nr;
     rk = skey->dK;
 
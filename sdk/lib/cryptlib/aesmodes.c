@@ -0,0 +1,406 @@
+/*
+ * PROJECT:     ReactOS Crypto Library
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     AES in CBC, CTR and GCM modes (SP 800-38A, SP 800-38D)
+ */
+
+#include "tomcrypt.h"
+#include "cryptsimd.h"
+
+/* Big endian increment of the last Width bytes of a counter block */
+static void ctr_increment(unsigned char *ctr, int width)
+{
+    int i;
+
+    for (i = 15; i >= 16 - width; i--)
+    {
+        if (++ctr[i])
+            break;
+    }
+}
+
+static void ctr_blocks(const unsigned char *in, unsigned char *out, unsigned long blocks,
+                       unsigned char *ctr, int width, aes_key *skey)
+{
+    unsigned char ks[16];
+    int i;
+
+#ifdef CRYPT_HAVE_SIMD
+    if (CryptCpuFeatures & CRYPT_CPU_AESNI)
+    {
+        aesni_ctr_crypt(in, out, blocks, ctr, width == 4, skey);
+        return;
+    }
+#endif
+
+    while (blocks--)
+    {
+        aes_ecb_encrypt(ctr, ks, skey);
+        ctr_increment(ctr, width);
+        for (i = 0; i < 16; i++)
+            out[i] = in[i] ^ ks[i];
+        in += 16;
+        out += 16;
+    }
+}
+
+int aes_cbc_encrypt(const unsigned char *pt, unsigned char *ct, unsigned long len,
+                    unsigned char *iv, aes_key *skey)
+{
+    unsigned char buf[16];
+    int i;
+
+    if (len % 16)
+        return CRYPT_INVALID_ARG;
+
+#ifdef CRYPT_HAVE_SIMD
+    if (CryptCpuFeatures & CRYPT_CPU_AESNI)
+    {
+        aesni_cbc_encrypt(pt, ct, len / 16, iv, skey);
+        return CRYPT_OK;
+    }
+#endif
+
+    for (; len; len -= 16)
+    {
+        for (i = 0; i < 16; i++)
+            buf[i] = pt[i] ^ iv[i];
+        aes_ecb_encrypt(buf, ct, skey);
+        memcpy(iv, ct, 16);
+        pt += 16;
+        ct += 16;
+    }
+    return CRYPT_OK;
+}
+
+int aes_cbc_decrypt(const unsigned char *ct, unsigned char *pt, unsigned long len,
+                    unsigned char *iv, aes_key *skey)
+{
+    unsigned char buf[16], next[16];
+    int i;
+
+    if (len % 16)
+        return CRYPT_INVALID_ARG;
+
+#ifdef CRYPT_HAVE_SIMD
+    if (CryptCpuFeatures & CRYPT_CPU_AESNI)
+    {
+        aesni_cbc_decrypt(ct, pt, len / 16, iv, skey);
+        return CRYPT_OK;
+    }
+#endif
+
+    for (; len; len -= 16)
+    {
+        memcpy(next, ct, 16);
+        aes_ecb_decrypt(ct, buf, skey);
+        for (i = 0; i < 16; i++)
+            pt[i] = buf[i] ^ iv[i];
+        memcpy(iv, next, 16);
+        ct += 16;
+        pt += 16;
+    }
+    return CRYPT_OK;
+}
+
+int aes_ctr_crypt(const unsigned char *in, unsigned char *out, unsigned long len,
+                  unsigned char *ctr, aes_key *skey)
+{
+    unsigned char ks[16];
+    unsigned long i;
+
+    ctr_blocks(in, out, len / 16, ctr, 16, skey);
+    in += len & ~15UL;
+    out += len & ~15UL;
+    len &= 15;
+
+    if (len)
+    {
+        aes_ecb_encrypt(ctr, ks, skey);
+        ctr_increment(ctr, 16);
+        for (i = 0; i < len; i++)
+            out[i] = in[i] ^ ks[i];
+    }
+    return CRYPT_OK;
+}
+
+static void gcm_store64(unsigned char *p, ulong64 v)
+{
+    STORE32H((ulong32)(v >> 32), p);
+    STORE32H((ulong32)v, p + 4);
+}
+
+/* Shoup's 4-bit tables, HL and HH hold the halves of i * H */
+static void gcm_gen_table(gcm_state *gcm)
+{
+    ulong64 vh, vl;
+    ulong32 hi, lo, t;
+    int i, j;
+
+    LOAD32H(hi, gcm->H[0]);
+    LOAD32H(lo, gcm->H[0] + 4);
+    vh = ((ulong64)hi << 32) | lo;
+    LOAD32H(hi, gcm->H[0] + 8);
+    LOAD32H(lo, gcm->H[0] + 12);
+    vl = ((ulong64)hi << 32) | lo;
+
+    gcm->HL[8] = vl;
+    gcm->HH[8] = vh;
+    gcm->HL[0] = 0;
+    gcm->HH[0] = 0;
+
+    for (i = 4; i > 0; i >>= 1)
+    {
+        t = (ulong32)(vl & 1) * 0xe1000000UL;
+        vl = (vh << 63) | (vl >> 1);
+        vh = (vh >> 1) ^ ((ulong64)t << 32);
+        gcm->HL[i] = vl;
+        gcm->HH[i] = vh;
+    }
+
+    for (i = 2; i <= 8; i *= 2)
+    {
+        for (j = 1; j < i; j++)
+        {
+            gcm->HH[i + j] = gcm->HH[i] ^ gcm->HH[j];
+            gcm->HL[i + j] = gcm->HL[i] ^ gcm->HL[j];
+        }
+    }
+}
+
+static const ulong64 gcm_last4[16] =
+{
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+/* out = x * H in GF(2^128) */
+static void gcm_mult(const gcm_state *gcm, const unsigned char *x, unsigned char *out)
+{
+    ulong64 zh, zl;
+    unsigned char lo, hi, rem;
+    int i;
+
+    lo = x[15] & 0xf;
+    zh = gcm->HH[lo];
+    zl = gcm->HL[lo];
+
+    for (i = 15; i >= 0; i--)
+    {
+        lo = x[i] & 0xf;
+        hi = (x[i] >> 4) & 0xf;
+
+        if (i != 15)
+        {
+            rem = (unsigned char)(zl & 0xf);
+            zl = (zh << 60) | (zl >> 4);
+            zh = (zh >> 4) ^ (gcm_last4[rem] << 48);
+            zh ^= gcm->HH[lo];
+            zl ^= gcm->HL[lo];
+        }
+
+        rem = (unsigned char)(zl & 0xf);
+        zl = (zh << 60) | (zl >> 4);
+        zh = (zh >> 4) ^ (gcm_last4[rem] << 48);
+        zh ^= gcm->HH[hi];
+        zl ^= gcm->HL[hi];
+    }
+
+    gcm_store64(out, zh);
+    gcm_store64(out + 8, zl);
+}
+
+static void gcm_ghash_blocks(gcm_state *gcm, const unsigned char *data, unsigned long blocks)
+{
+    int i;
+
+#ifdef CRYPT_HAVE_SIMD
+    if (CryptCpuFeatures & CRYPT_CPU_PCLMUL)
+    {
+        pclmul_ghash(gcm->X, (const unsigned char (*)[16])gcm->H, data, blocks);
+        return;
+    }
+#endif
+
+    while (blocks--)
+    {
+        for (i = 0; i < 16; i++)
+            gcm->X[i] ^= data[i];
+        gcm_mult(gcm, gcm->X, gcm->X);
+        data += 16;
+    }
+}
+
+static void gcm_absorb(gcm_state *gcm, const unsigned char *data, unsigned long len)
+{
+    unsigned long n;
+
+    if (gcm->buflen)
+    {
+        n = MIN(16 - gcm->buflen, len);
+        memcpy(gcm->buf + gcm->buflen, data, n);
+        gcm->buflen += n;
+        data += n;
+        len -= n;
+        if (gcm->buflen < 16)
+            return;
+        gcm_ghash_blocks(gcm, gcm->buf, 1);
+        gcm->buflen = 0;
+    }
+
+    if (len >= 16)
+    {
+        gcm_ghash_blocks(gcm, data, len / 16);
+        data += len & ~15UL;
+        len &= 15;
+    }
+
+    if (len)
+    {
+        memcpy(gcm->buf, data, len);
+        gcm->buflen = len;
+    }
+}
+
+/* Pads the AAD, or the text, to a whole block */
+static void gcm_flush(gcm_state *gcm)
+{
+    if (gcm->buflen)
+    {
+        memset(gcm->buf + gcm->buflen, 0, 16 - gcm->buflen);
+        gcm_ghash_blocks(gcm, gcm->buf, 1);
+        gcm->buflen = 0;
+    }
+}
+
+int gcm_init(gcm_state *gcm, aes_key *skey, const unsigned char *iv, unsigned long ivlen)
+{
+    unsigned char block[16];
+    int i;
+
+    if (!ivlen)
+        return CRYPT_INVALID_ARG;
+
+    memset(gcm, 0, sizeof(*gcm));
+    gcm->key = skey;
+
+    memset(block, 0, sizeof(block));
+    aes_ecb_encrypt(block, gcm->H[0], skey);
+    gcm_gen_table(gcm);
+
+    /* The PCLMULQDQ path folds four blocks at a time */
+    for (i = 1; i < 4; i++)
+        gcm_mult(gcm, gcm->H[i - 1], gcm->H[i]);
+
+    if (ivlen == 12)
+    {
+        memcpy(gcm->J0, iv, 12);
+        gcm->J0[15] = 1;
+    }
+    else
+    {
+        gcm_absorb(gcm, iv, ivlen);
+        gcm_flush(gcm);
+        memset(block, 0, 8);
+        gcm_store64(block + 8, (ulong64)ivlen << 3);
+        gcm_ghash_blocks(gcm, block, 1);
+        memcpy(gcm->J0, gcm->X, 16);
+        memset(gcm->X, 0, 16);
+    }
+
+    memcpy(gcm->ctr, gcm->J0, 16);
+    ctr_increment(gcm->ctr, 4);
+    return CRYPT_OK;
+}
+
+int gcm_add_aad(gcm_state *gcm, const unsigned char *aad, unsigned long len)
+{
+    if (gcm->mode)
+        return CRYPT_ERROR;
+
+    gcm->aadlen += len;
+    gcm_absorb(gcm, aad, len);
+    return CRYPT_OK;
+}
+
+int gcm_process(gcm_state *gcm, const unsigned char *in, unsigned char *out,
+                unsigned long len, int direction)
+{
+    unsigned long n, i, blocks;
+
+    if (direction != GCM_ENCRYPT && direction != GCM_DECRYPT)
+        return CRYPT_INVALID_ARG;
+
+    if (!gcm->mode)
+    {
+        gcm_flush(gcm);
+        gcm->mode = 1;
+    }
+    gcm->ptlen += len;
+
+    /* The hash always covers the ciphertext. The output may overwrite the
+     * input, so decryption hashes before and encryption after */
+    if (gcm->kslen)
+    {
+        n = MIN(gcm->kslen, len);
+        if (direction == GCM_DECRYPT)
+            gcm_absorb(gcm, in, n);
+        for (i = 0; i < n; i++)
+            out[i] = in[i] ^ gcm->ks[16 - gcm->kslen + i];
+        if (direction == GCM_ENCRYPT)
+            gcm_absorb(gcm, out, n);
+        gcm->kslen -= n;
+        in += n;
+        out += n;
+        len -= n;
+    }
+
+    blocks = len / 16;
+    if (blocks)
+    {
+        if (direction == GCM_DECRYPT)
+            gcm_absorb(gcm, in, blocks * 16);
+        ctr_blocks(in, out, blocks, gcm->ctr, 4, gcm->key);
+        if (direction == GCM_ENCRYPT)
+            gcm_absorb(gcm, out, blocks * 16);
+        in += blocks * 16;
+        out += blocks * 16;
+        len &= 15;
+    }
+
+    if (len)
+    {
+        aes_ecb_encrypt(gcm->ctr, gcm->ks, gcm->key);
+        ctr_increment(gcm->ctr, 4);
+        if (direction == GCM_DECRYPT)
+            gcm_absorb(gcm, in, len);
+        for (i = 0; i < len; i++)
+            out[i] = in[i] ^ gcm->ks[i];
+        if (direction == GCM_ENCRYPT)
+            gcm_absorb(gcm, out, len);
+        gcm->kslen = 16 - len;
+    }
+
+    return CRYPT_OK;
+}
+
+int gcm_done(gcm_state *gcm, unsigned char *tag, unsigned long taglen)
+{
+    unsigned char block[16];
+    unsigned long i;
+
+    if (!taglen || taglen > 16)
+        return CRYPT_INVALID_ARG;
+
+    gcm_flush(gcm);
+    gcm_store64(block, gcm->aadlen << 3);
+    gcm_store64(block + 8, gcm->ptlen << 3);
+    gcm_ghash_blocks(gcm, block, 1);
+
+    aes_ecb_encrypt(gcm->J0, block, gcm->key);
+    for (i = 0; i < taglen; i++)
+        tag[i] = block[i] ^ gcm->X[i];
+
+    memset(gcm, 0, sizeof(*gcm));
+    return CRYPT_OK;
+}
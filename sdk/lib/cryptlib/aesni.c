@@ -0,0 +1,311 @@
+/*
+ * PROJECT:     ReactOS Crypto Library
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     AES-NI block modes and PCLMULQDQ GHASH
+ */
+
+#include "cryptsimd.h"
+
+#ifdef CRYPT_HAVE_SIMD
+
+#include <wmmintrin.h>
+
+#define AESNI_TARGET CRYPT_TARGET("sse2,ssse3,aes")
+#define PCLMUL_TARGET CRYPT_TARGET("sse2,ssse3,pclmul")
+
+/*
+ * aes_setup stores the round keys as big endian words, AES-NI wants the
+ * bytes in stream order. The decryption schedule is already the one of the
+ * equivalent inverse cipher that AESDEC expects.
+ */
+static AESNI_TARGET
+void aesni_load_keys(__m128i *rk, const ulong32 *words, int Nr)
+{
+    const __m128i Swap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    int i;
+
+    for (i = 0; i <= Nr; i++)
+        rk[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&words[i * 4]), Swap);
+}
+
+static AESNI_TARGET
+__m128i aesni_encrypt_block(__m128i b, const __m128i *rk, int Nr)
+{
+    int i;
+
+    b = _mm_xor_si128(b, rk[0]);
+    for (i = 1; i < Nr; i++)
+        b = _mm_aesenc_si128(b, rk[i]);
+    return _mm_aesenclast_si128(b, rk[Nr]);
+}
+
+static AESNI_TARGET
+__m128i aesni_decrypt_block(__m128i b, const __m128i *rk, int Nr)
+{
+    int i;
+
+    b = _mm_xor_si128(b, rk[0]);
+    for (i = 1; i < Nr; i++)
+        b = _mm_aesdec_si128(b, rk[i]);
+    return _mm_aesdeclast_si128(b, rk[Nr]);
+}
+
+AESNI_TARGET
+void aesni_ecb_encrypt(const unsigned char *pt, unsigned char *ct, const aes_key *skey)
+{
+    __m128i rk[15];
+
+    aesni_load_keys(rk, skey->eK, skey->Nr);
+    _mm_storeu_si128((__m128i *)ct,
+                     aesni_encrypt_block(_mm_loadu_si128((const __m128i *)pt), rk, skey->Nr));
+}
+
+AESNI_TARGET
+void aesni_ecb_decrypt(const unsigned char *ct, unsigned char *pt, const aes_key *skey)
+{
+    __m128i rk[15];
+
+    aesni_load_keys(rk, skey->dK, skey->Nr);
+    _mm_storeu_si128((__m128i *)pt,
+                     aesni_decrypt_block(_mm_loadu_si128((const __m128i *)ct), rk, skey->Nr));
+}
+
+AESNI_TARGET
+void aesni_cbc_encrypt(const unsigned char *pt, unsigned char *ct, unsigned long blocks,
+                       unsigned char *iv, const aes_key *skey)
+{
+    __m128i rk[15], b;
+    int Nr = skey->Nr;
+
+    aesni_load_keys(rk, skey->eK, Nr);
+
+    /* Every block depends on the previous one, so there is nothing to interleave */
+    b = _mm_loadu_si128((const __m128i *)iv);
+    while (blocks--)
+    {
+        b = _mm_xor_si128(b, _mm_loadu_si128((const __m128i *)pt));
+        b = aesni_encrypt_block(b, rk, Nr);
+        _mm_storeu_si128((__m128i *)ct, b);
+        pt += 16;
+        ct += 16;
+    }
+    _mm_storeu_si128((__m128i *)iv, b);
+}
+
+AESNI_TARGET
+void aesni_cbc_decrypt(const unsigned char *ct, unsigned char *pt, unsigned long blocks,
+                       unsigned char *iv, const aes_key *skey)
+{
+    __m128i rk[15], prev, c0, c1, c2, c3, b0, b1, b2, b3;
+    int Nr = skey->Nr, i;
+
+    aesni_load_keys(rk, skey->dK, Nr);
+    prev = _mm_loadu_si128((const __m128i *)iv);
+
+    /* Decryption has no chain, four blocks keep the AES unit busy */
+    for (; blocks >= 4; blocks -= 4)
+    {
+        c0 = _mm_loadu_si128((const __m128i *)ct);
+        c1 = _mm_loadu_si128((const __m128i *)(ct + 16));
+        c2 = _mm_loadu_si128((const __m128i *)(ct + 32));
+        c3 = _mm_loadu_si128((const __m128i *)(ct + 48));
+
+        b0 = _mm_xor_si128(c0, rk[0]);
+        b1 = _mm_xor_si128(c1, rk[0]);
+        b2 = _mm_xor_si128(c2, rk[0]);
+        b3 = _mm_xor_si128(c3, rk[0]);
+        for (i = 1; i < Nr; i++)
+        {
+            b0 = _mm_aesdec_si128(b0, rk[i]);
+            b1 = _mm_aesdec_si128(b1, rk[i]);
+            b2 = _mm_aesdec_si128(b2, rk[i]);
+            b3 = _mm_aesdec_si128(b3, rk[i]);
+        }
+        b0 = _mm_aesdeclast_si128(b0, rk[Nr]);
+        b1 = _mm_aesdeclast_si128(b1, rk[Nr]);
+        b2 = _mm_aesdeclast_si128(b2, rk[Nr]);
+        b3 = _mm_aesdeclast_si128(b3, rk[Nr]);
+
+        /* The output may overwrite the input, so store after loading */
+        _mm_storeu_si128((__m128i *)pt, _mm_xor_si128(b0, prev));
+        _mm_storeu_si128((__m128i *)(pt + 16), _mm_xor_si128(b1, c0));
+        _mm_storeu_si128((__m128i *)(pt + 32), _mm_xor_si128(b2, c1));
+        _mm_storeu_si128((__m128i *)(pt + 48), _mm_xor_si128(b3, c2));
+        prev = c3;
+        ct += 64;
+        pt += 64;
+    }
+
+    while (blocks--)
+    {
+        c0 = _mm_loadu_si128((const __m128i *)ct);
+        _mm_storeu_si128((__m128i *)pt, _mm_xor_si128(aesni_decrypt_block(c0, rk, Nr), prev));
+        prev = c0;
+        ct += 16;
+        pt += 16;
+    }
+    _mm_storeu_si128((__m128i *)iv, prev);
+}
+
+/* Counters are kept byte reversed, so the low 64 bits are lane 0 */
+static AESNI_TARGET
+__m128i aesni_next_counter(__m128i c, int inc32)
+{
+    const __m128i One = _mm_set_epi32(0, 0, 0, 1);
+    const __m128i Carry = _mm_set_epi32(0, 1, 0, 0);
+
+    if (inc32)
+        return _mm_add_epi32(c, One);
+
+    c = _mm_add_epi64(c, One);
+    if ((_mm_movemask_epi8(_mm_cmpeq_epi32(c, _mm_setzero_si128())) & 0xFF) == 0xFF)
+        c = _mm_add_epi64(c, Carry);
+    return c;
+}
+
+AESNI_TARGET
+void aesni_ctr_crypt(const unsigned char *in, unsigned char *out, unsigned long blocks,
+                     unsigned char *ctr, int inc32, const aes_key *skey)
+{
+    const __m128i Reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i rk[15], c, b0, b1, b2, b3;
+    int Nr = skey->Nr, i;
+
+    aesni_load_keys(rk, skey->eK, Nr);
+    c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)ctr), Reverse);
+
+    for (; blocks >= 4; blocks -= 4)
+    {
+        b0 = _mm_shuffle_epi8(c, Reverse);
+        c = aesni_next_counter(c, inc32);
+        b1 = _mm_shuffle_epi8(c, Reverse);
+        c = aesni_next_counter(c, inc32);
+        b2 = _mm_shuffle_epi8(c, Reverse);
+        c = aesni_next_counter(c, inc32);
+        b3 = _mm_shuffle_epi8(c, Reverse);
+        c = aesni_next_counter(c, inc32);
+
+        b0 = _mm_xor_si128(b0, rk[0]);
+        b1 = _mm_xor_si128(b1, rk[0]);
+        b2 = _mm_xor_si128(b2, rk[0]);
+        b3 = _mm_xor_si128(b3, rk[0]);
+        for (i = 1; i < Nr; i++)
+        {
+            b0 = _mm_aesenc_si128(b0, rk[i]);
+            b1 = _mm_aesenc_si128(b1, rk[i]);
+            b2 = _mm_aesenc_si128(b2, rk[i]);
+            b3 = _mm_aesenc_si128(b3, rk[i]);
+        }
+        b0 = _mm_aesenclast_si128(b0, rk[Nr]);
+        b1 = _mm_aesenclast_si128(b1, rk[Nr]);
+        b2 = _mm_aesenclast_si128(b2, rk[Nr]);
+        b3 = _mm_aesenclast_si128(b3, rk[Nr]);
+
+        b0 = _mm_xor_si128(b0, _mm_loadu_si128((const __m128i *)in));
+        b1 = _mm_xor_si128(b1, _mm_loadu_si128((const __m128i *)(in + 16)));
+        b2 = _mm_xor_si128(b2, _mm_loadu_si128((const __m128i *)(in + 32)));
+        b3 = _mm_xor_si128(b3, _mm_loadu_si128((const __m128i *)(in + 48)));
+        _mm_storeu_si128((__m128i *)out, b0);
+        _mm_storeu_si128((__m128i *)(out + 16), b1);
+        _mm_storeu_si128((__m128i *)(out + 32), b2);
+        _mm_storeu_si128((__m128i *)(out + 48), b3);
+        in += 64;
+        out += 64;
+    }
+
+    while (blocks--)
+    {
+        b0 = aesni_encrypt_block(_mm_shuffle_epi8(c, Reverse), rk, Nr);
+        c = aesni_next_counter(c, inc32);
+        _mm_storeu_si128((__m128i *)out, _mm_xor_si128(b0, _mm_loadu_si128((const __m128i *)in)));
+        in += 16;
+        out += 16;
+    }
+    _mm_storeu_si128((__m128i *)ctr, _mm_shuffle_epi8(c, Reverse));
+}
+
+/*
+ * Carry-less multiplication of two byte reversed field elements, without
+ * the reduction. Several products can be summed before reducing once.
+ */
+static PCLMUL_TARGET
+void pclmul_mul(__m128i a, __m128i b, __m128i *lo, __m128i *hi)
+{
+    __m128i t0, t1, t2, t3;
+
+    t0 = _mm_clmulepi64_si128(a, b, 0x00);
+    t1 = _mm_clmulepi64_si128(a, b, 0x10);
+    t2 = _mm_clmulepi64_si128(a, b, 0x01);
+    t3 = _mm_clmulepi64_si128(a, b, 0x11);
+
+    t1 = _mm_xor_si128(t1, t2);
+    *lo = _mm_xor_si128(*lo, _mm_xor_si128(t0, _mm_slli_si128(t1, 8)));
+    *hi = _mm_xor_si128(*hi, _mm_xor_si128(t3, _mm_srli_si128(t1, 8)));
+}
+
+/* GCM numbers its bits backwards: shift the product left by one and reduce */
+static PCLMUL_TARGET
+__m128i pclmul_reduce(__m128i lo, __m128i hi)
+{
+    __m128i t0, t1, t2;
+
+    t0 = _mm_srli_epi32(lo, 31);
+    t1 = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    t2 = _mm_srli_si128(t0, 12);
+    t1 = _mm_slli_si128(t1, 4);
+    t0 = _mm_slli_si128(t0, 4);
+    lo = _mm_or_si128(lo, t0);
+    hi = _mm_or_si128(_mm_or_si128(hi, t1), t2);
+
+    t0 = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)),
+                       _mm_slli_epi32(lo, 25));
+    t1 = _mm_srli_si128(t0, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(t0, 12));
+
+    t2 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)),
+                       _mm_srli_epi32(lo, 7));
+    lo = _mm_xor_si128(lo, _mm_xor_si128(t2, t1));
+    return _mm_xor_si128(hi, lo);
+}
+
+PCLMUL_TARGET
+void pclmul_ghash(unsigned char *X, const unsigned char (*H)[16],
+                  const unsigned char *data, unsigned long blocks)
+{
+    const __m128i Reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i x, h1, h2, h3, h4, lo, hi;
+
+    x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)X), Reverse);
+    h1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)H[0]), Reverse);
+    h2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)H[1]), Reverse);
+    h3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)H[2]), Reverse);
+    h4 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)H[3]), Reverse);
+
+    /* ((X + C1) H^4) + (C2 H^3) + (C3 H^2) + (C4 H), reduced once */
+    for (; blocks >= 4; blocks -= 4)
+    {
+        lo = hi = _mm_setzero_si128();
+        x = _mm_xor_si128(x, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), Reverse));
+        pclmul_mul(x, h4, &lo, &hi);
+        pclmul_mul(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), Reverse), h3, &lo, &hi);
+        pclmul_mul(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), Reverse), h2, &lo, &hi);
+        pclmul_mul(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), Reverse), h1, &lo, &hi);
+        x = pclmul_reduce(lo, hi);
+        data += 64;
+    }
+
+    while (blocks--)
+    {
+        lo = hi = _mm_setzero_si128();
+        x = _mm_xor_si128(x, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), Reverse));
+        pclmul_mul(x, h1, &lo, &hi);
+        x = pclmul_reduce(lo, hi);
+        data += 16;
+    }
+
+    _mm_storeu_si128((__m128i *)X, _mm_shuffle_epi8(x, Reverse));
+}
+
+#endif /* CRYPT_HAVE_SIMD */
@@ -0,0 +1,51 @@
+/*
+ * PROJECT:     ReactOS Crypto Library
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Runtime selection of the SIMD code paths
+ */
+
+#include "cryptcpu.h"
+
+#ifdef CRYPT_HAVE_SIMD
+#include <intrin.h>
+#endif
+
+ULONG32 CryptCpuFeatures;
+
+ULONG32 CryptInitCpuFeatures(void)
+{
+#ifdef CRYPT_HAVE_SIMD
+    int Regs[4];
+    int MaxLeaf;
+    ULONG32 Features = 0;
+
+    __cpuid(Regs, 0);
+    MaxLeaf = Regs[0];
+
+    __cpuid(Regs, 1);
+    if (Regs[2] & (1 << 9))
+        Features |= CRYPT_CPU_SSSE3;
+    if (Regs[2] & (1 << 19))
+        Features |= CRYPT_CPU_SSE41;
+    if (Regs[2] & (1 << 25))
+        Features |= CRYPT_CPU_AESNI;
+    if (Regs[2] & (1 << 1))
+        Features |= CRYPT_CPU_PCLMUL;
+
+    if (MaxLeaf >= 7)
+    {
+        __cpuidex(Regs, 7, 0);
+        if (Regs[1] & (1 << 29))
+            Features |= CRYPT_CPU_SHA;
+    }
+
+    /* Every kernel also shuffles bytes, and the SHA ones blend words */
+    if (!(Features & CRYPT_CPU_SSSE3))
+        Features = 0;
+    if (!(Features & CRYPT_CPU_SSE41))
+        Features &= ~CRYPT_CPU_SHA;
+
+    CryptCpuFeatures = Features;
+#endif
+    return CryptCpuFeatures;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <basetsd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Instruction set extensions the SIMD code paths use */
+#define CRYPT_CPU_SSSE3     0x00000001
+#define CRYPT_CPU_SSE41     0x00000002
+#define CRYPT_CPU_AESNI     0x00000004
+#define CRYPT_CPU_PCLMUL    0x00000008
+#define CRYPT_CPU_SHA       0x00000010
+
+#if defined(_M_IX86) || defined(_M_AMD64)
+#define CRYPT_HAVE_SIMD
+#endif
+
+/*
+ * The SIMD paths stay off until the module that links cryptlib calls
+ * CryptInitCpuFeatures. Kernel-mode users may only do that where the
+ * vector registers need no saving, i.e. on x64. Tests can clear bits to
+ * force the portable code.
+ */
+extern ULONG32 CryptCpuFeatures;
+
+ULONG32 CryptInitCpuFeatures(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "cryptcpu.h"
+#include "tomcrypt.h"
+
+#ifdef CRYPT_HAVE_SIMD
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CRYPT_TARGET(x) __attribute__((__target__(x)))
+#else
+#define CRYPT_TARGET(x)
+#endif
+
+/* aesni.c, the key schedules are the ones aes_setup builds */
+void aesni_ecb_encrypt(const unsigned char *pt, unsigned char *ct, const aes_key *skey);
+void aesni_ecb_decrypt(const unsigned char *ct, unsigned char *pt, const aes_key *skey);
+void aesni_cbc_encrypt(const unsigned char *pt, unsigned char *ct, unsigned long blocks,
+                       unsigned char *iv, const aes_key *skey);
+void aesni_cbc_decrypt(const unsigned char *ct, unsigned char *pt, unsigned long blocks,
+                       unsigned char *iv, const aes_key *skey);
+void aesni_ctr_crypt(const unsigned char *in, unsigned char *out, unsigned long blocks,
+                     unsigned char *ctr, int inc32, const aes_key *skey);
+
+/* aesni.c, H holds H^1 to H^4 as gcm_state keeps them */
+void pclmul_ghash(unsigned char *X, const unsigned char (*H)[16],
+                  const unsigned char *data, unsigned long blocks);
+
+/* shani.c, with the round constants from sha2.c */
+extern const ULONG32 sha256_k[64];
+
+void shani_sha1_blocks(ULONG32 *state, const unsigned char *data, unsigned long blocks);
+void shani_sha256_blocks(ULONG32 *state, const unsigned char *data, unsigned long blocks);
+
+#endif /* CRYPT_HAVE_SIMD */
@@ -0,0 +1,163 @@
+/*
+ * PROJECT:     ReactOS Crypto Library
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Generic hash interface and HMAC (RFC 2104)
+ */
+
+#include <string.h>
+
+#include "hmac.h"
+
+static const struct
+{
+    SIZE_T DigestLength;
+    SIZE_T BlockLength;
+} HashInfo[] =
+{
+    /* HASH_ALG_MD5 */    { 16, 64 },
+    /* HASH_ALG_SHA1 */   { 20, 64 },
+    /* HASH_ALG_SHA256 */ { SHA256_DIGEST_LENGTH, SHA256_BLOCK_LENGTH },
+    /* HASH_ALG_SHA384 */ { SHA384_DIGEST_LENGTH, SHA384_BLOCK_LENGTH },
+    /* HASH_ALG_SHA512 */ { SHA512_DIGEST_LENGTH, SHA512_BLOCK_LENGTH },
+};
+
+SIZE_T HASH_DigestLength(int Algorithm)
+{
+    if (Algorithm < 0 || Algorithm >= (int)(sizeof(HashInfo) / sizeof(HashInfo[0])))
+        return 0;
+    return HashInfo[Algorithm].DigestLength;
+}
+
+/* Returns FALSE for an algorithm cryptlib does not know */
+int HASH_Init(HASH_CTX *Context, int Algorithm)
+{
+    Context->Algorithm = Algorithm;
+
+    switch (Algorithm)
+    {
+        case HASH_ALG_MD5:
+            MD5Init(&Context->u.Md5);
+            return TRUE;
+        case HASH_ALG_SHA1:
+            A_SHAInit(&Context->u.Sha1);
+            return TRUE;
+        case HASH_ALG_SHA256:
+            SHA256_Init(&Context->u.Sha256);
+            return TRUE;
+        case HASH_ALG_SHA384:
+            SHA384_Init(&Context->u.Sha512);
+            return TRUE;
+        case HASH_ALG_SHA512:
+            SHA512_Init(&Context->u.Sha512);
+            return TRUE;
+    }
+    return FALSE;
+}
+
+void HASH_Update(HASH_CTX *Context, const unsigned char *Data, SIZE_T Length)
+{
+    ULONG Chunk;
+
+    switch (Context->Algorithm)
+    {
+        case HASH_ALG_MD5:
+        case HASH_ALG_SHA1:
+            /* These two count in 32 bits */
+            while (Length)
+            {
+                Chunk = (ULONG)min(Length, 0x80000000);
+                if (Context->Algorithm == HASH_ALG_MD5)
+                    MD5Update(&Context->u.Md5, Data, Chunk);
+                else
+                    A_SHAUpdate(&Context->u.Sha1, Data, Chunk);
+                Data += Chunk;
+                Length -= Chunk;
+            }
+            break;
+        case HASH_ALG_SHA256:
+            SHA256_Update(&Context->u.Sha256, Data, Length);
+            break;
+        case HASH_ALG_SHA384:
+            SHA384_Update(&Context->u.Sha512, Data, Length);
+            break;
+        case HASH_ALG_SHA512:
+            SHA512_Update(&Context->u.Sha512, Data, Length);
+            break;
+    }
+}
+
+void HASH_Final(unsigned char *Digest, HASH_CTX *Context)
+{
+    ULONG Sha1[5];
+
+    switch (Context->Algorithm)
+    {
+        case HASH_ALG_MD5:
+            MD5Final(&Context->u.Md5);
+            memcpy(Digest, Context->u.Md5.digest, 16);
+            break;
+        case HASH_ALG_SHA1:
+            A_SHAFinal(&Context->u.Sha1, Sha1);
+            memcpy(Digest, Sha1, 20);
+            break;
+        case HASH_ALG_SHA256:
+            SHA256_Final(Digest, &Context->u.Sha256);
+            break;
+        case HASH_ALG_SHA384:
+            SHA384_Final(Digest, &Context->u.Sha512);
+            break;
+        case HASH_ALG_SHA512:
+            SHA512_Final(Digest, &Context->u.Sha512);
+            break;
+    }
+}
+
+int HMAC_Init(HMAC_CTX *Context, int Algorithm, const unsigned char *Key, SIZE_T KeyLength)
+{
+    unsigned char Pad[HASH_MAX_BLOCK_LENGTH];
+    SIZE_T BlockLength, i;
+
+    if (!HASH_Init(&Context->Inner, Algorithm))
+        return FALSE;
+    BlockLength = HashInfo[Algorithm].BlockLength;
+
+    /* Keys longer than a block are hashed first */
+    memset(Pad, 0, sizeof(Pad));
+    if (KeyLength > BlockLength)
+    {
+        HASH_Update(&Context->Inner, Key, KeyLength);
+        HASH_Final(Pad, &Context->Inner);
+        HASH_Init(&Context->Inner, Algorithm);
+    }
+    else if (KeyLength)
+    {
+        memcpy(Pad, Key, KeyLength);
+    }
+
+    for (i = 0; i < BlockLength; i++)
+        Pad[i] ^= 0x36;
+    HASH_Update(&Context->Inner, Pad, BlockLength);
+
+    HASH_Init(&Context->Outer, Algorithm);
+    for (i = 0; i < BlockLength; i++)
+        Pad[i] ^= 0x36 ^ 0x5c;
+    HASH_Update(&Context->Outer, Pad, BlockLength);
+
+    memset(Pad, 0, sizeof(Pad));
+    return TRUE;
+}
+
+void HMAC_Update(HMAC_CTX *Context, const unsigned char *Data, SIZE_T Length)
+{
+    HASH_Update(&Context->Inner, Data, Length);
+}
+
+void HMAC_Final(unsigned char *Mac, HMAC_CTX *Context)
+{
+    unsigned char Digest[HASH_MAX_DIGEST_LENGTH];
+
+    HASH_Final(Digest, &Context->Inner);
+    HASH_Update(&Context->Outer, Digest, HASH_DigestLength(Context->Outer.Algorithm));
+    HASH_Final(Mac, &Context->Outer);
+    memset(Digest, 0, sizeof(Digest));
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "md5.h"
+#include "sha1.h"
+#include "sha2.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HASH_ALG_MD5        0
+#define HASH_ALG_SHA1       1
+#define HASH_ALG_SHA256     2
+#define HASH_ALG_SHA384     3
+#define HASH_ALG_SHA512     4
+
+#define HASH_MAX_DIGEST_LENGTH  64
+#define HASH_MAX_BLOCK_LENGTH   128
+
+/* One interface over every hash cryptlib implements */
+typedef struct _HASH_CTX
+{
+    int Algorithm;
+    union
+    {
+        MD5_CTX Md5;
+        SHA_CTX Sha1;
+        SHA256_CTX Sha256;
+        SHA512_CTX Sha512;
+    } u;
+} HASH_CTX;
+
+typedef struct _HMAC_CTX
+{
+    HASH_CTX Inner;
+    HASH_CTX Outer;
+} HMAC_CTX;
+
+SIZE_T HASH_DigestLength(int Algorithm);
+int HASH_Init(HASH_CTX *Context, int Algorithm);
+void HASH_Update(HASH_CTX *Context, const unsigned char *Data, SIZE_T Length);
+void HASH_Final(unsigned char *Digest, HASH_CTX *Context);
+
+int HMAC_Init(HMAC_CTX *Context, int Algorithm, const unsigned char *Key, SIZE_T KeyLength);
+void HMAC_Update(HMAC_CTX *Context, const unsigned char *Data, SIZE_T Length);
+void HMAC_Final(unsigned char *Mac, HMAC_CTX *Context);
+
+#ifdef __cplusplus
+}
+#endif
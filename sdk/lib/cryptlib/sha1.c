@@ -18,6 +18,7 @@
  */
 
 #include "sha1.h"
+#include "cryptsimd.h"
 
 /* SHA1 Helper Macros */
 
@@ -86,6 +87,27 @@ static void SHA1Transform(ULONG State[5], UCHAR Buffer[64])
    a = b = c = d = e = 0;
 }
 
+/* Hash whole blocks without touching the caller's data */
+static void SHA1Blocks(ULONG State[5], const unsigned char *Data, ULONG Blocks)
+{
+   UCHAR Block[64];
+
+#ifdef CRYPT_HAVE_SIMD
+   if (CryptCpuFeatures & CRYPT_CPU_SHA)
+   {
+      shani_sha1_blocks((ULONG32 *)State, Data, Blocks);
+      return;
+   }
+#endif
+
+   while (Blocks--)
+   {
+      memcpy(Block, Data, 64);
+      SHA1Transform(State, Block);
+      Data += 64;
+   }
+}
+
 
 /******************************************************************************
  * A_SHAInit [ADVAPI32.@]
@@ -142,16 +164,18 @@ A_SHAUpdate(PSHA_CTX Context, const unsigned char *Buffer, ULONG BufferSize)
    }
    else
    {
-      while (BufferContentSize + BufferSize >= 64)
+      if (BufferContentSize)
       {
          memcpy(Context->Buffer + BufferContentSize, Buffer,
                        64 - BufferContentSize);
          Buffer += 64 - BufferContentSize;
          BufferSize -= 64 - BufferContentSize;
-         SHA1Transform(Context->State, Context->Buffer);
-         BufferContentSize = 0;
+         SHA1Blocks(Context->State, Context->Buffer, 1);
       }
-      memcpy(Context->Buffer + BufferContentSize, Buffer, BufferSize);
+      SHA1Blocks(Context->State, Buffer, BufferSize / 64);
+      Buffer += BufferSize & ~63;
+      BufferSize &= 63;
+      memcpy(Context->Buffer, Buffer, BufferSize);
    }
 }
 
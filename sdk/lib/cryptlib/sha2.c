@@ -0,0 +1,329 @@
+/*
+ * PROJECT:     ReactOS Crypto Library
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     SHA-256, SHA-384 and SHA-512 (FIPS 180-4)
+ */
+
+#include <string.h>
+
+#include "sha2.h"
+#include "cryptsimd.h"
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+#define CH(x, y, z)  (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+#define SIGMA256_0(x) (ROR32(x, 2) ^ ROR32(x, 13) ^ ROR32(x, 22))
+#define SIGMA256_1(x) (ROR32(x, 6) ^ ROR32(x, 11) ^ ROR32(x, 25))
+#define GAMMA256_0(x) (ROR32(x, 7) ^ ROR32(x, 18) ^ ((x) >> 3))
+#define GAMMA256_1(x) (ROR32(x, 17) ^ ROR32(x, 19) ^ ((x) >> 10))
+
+#define SIGMA512_0(x) (ROR64(x, 28) ^ ROR64(x, 34) ^ ROR64(x, 39))
+#define SIGMA512_1(x) (ROR64(x, 14) ^ ROR64(x, 18) ^ ROR64(x, 41))
+#define GAMMA512_0(x) (ROR64(x, 1) ^ ROR64(x, 8) ^ ((x) >> 7))
+#define GAMMA512_1(x) (ROR64(x, 19) ^ ROR64(x, 61) ^ ((x) >> 6))
+
+/* shani.c reads these four at a time */
+const ULONG32 sha256_k[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const ULONG64 sha512_k[80] =
+{
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+static ULONG32 load32_be(const unsigned char *p)
+{
+    return ((ULONG32)p[0] << 24) | ((ULONG32)p[1] << 16) | ((ULONG32)p[2] << 8) | p[3];
+}
+
+static ULONG64 load64_be(const unsigned char *p)
+{
+    return ((ULONG64)load32_be(p) << 32) | load32_be(p + 4);
+}
+
+static void store32_be(unsigned char *p, ULONG32 v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static void store64_be(unsigned char *p, ULONG64 v)
+{
+    store32_be(p, (ULONG32)(v >> 32));
+    store32_be(p + 4, (ULONG32)v);
+}
+
+static void sha256_blocks(ULONG32 *State, const unsigned char *Data, SIZE_T Blocks)
+{
+    ULONG32 W[64];
+    ULONG32 a, b, c, d, e, f, g, h, t1, t2;
+    int i;
+
+#ifdef CRYPT_HAVE_SIMD
+    if (CryptCpuFeatures & CRYPT_CPU_SHA)
+    {
+        shani_sha256_blocks(State, Data, (unsigned long)Blocks);
+        return;
+    }
+#endif
+
+    while (Blocks--)
+    {
+        for (i = 0; i < 16; i++)
+            W[i] = load32_be(Data + i * 4);
+        for (i = 16; i < 64; i++)
+            W[i] = GAMMA256_1(W[i - 2]) + W[i - 7] + GAMMA256_0(W[i - 15]) + W[i - 16];
+
+        a = State[0]; b = State[1]; c = State[2]; d = State[3];
+        e = State[4]; f = State[5]; g = State[6]; h = State[7];
+
+        for (i = 0; i < 64; i++)
+        {
+            t1 = h + SIGMA256_1(e) + CH(e, f, g) + sha256_k[i] + W[i];
+            t2 = SIGMA256_0(a) + MAJ(a, b, c);
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        State[0] += a; State[1] += b; State[2] += c; State[3] += d;
+        State[4] += e; State[5] += f; State[6] += g; State[7] += h;
+        Data += SHA256_BLOCK_LENGTH;
+    }
+}
+
+static void sha512_blocks(ULONG64 *State, const unsigned char *Data, SIZE_T Blocks)
+{
+    ULONG64 W[80];
+    ULONG64 a, b, c, d, e, f, g, h, t1, t2;
+    int i;
+
+    while (Blocks--)
+    {
+        for (i = 0; i < 16; i++)
+            W[i] = load64_be(Data + i * 8);
+        for (i = 16; i < 80; i++)
+            W[i] = GAMMA512_1(W[i - 2]) + W[i - 7] + GAMMA512_0(W[i - 15]) + W[i - 16];
+
+        a = State[0]; b = State[1]; c = State[2]; d = State[3];
+        e = State[4]; f = State[5]; g = State[6]; h = State[7];
+
+        for (i = 0; i < 80; i++)
+        {
+            t1 = h + SIGMA512_1(e) + CH(e, f, g) + sha512_k[i] + W[i];
+            t2 = SIGMA512_0(a) + MAJ(a, b, c);
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        State[0] += a; State[1] += b; State[2] += c; State[3] += d;
+        State[4] += e; State[5] += f; State[6] += g; State[7] += h;
+        Data += SHA512_BLOCK_LENGTH;
+    }
+}
+
+void SHA256_Init(SHA256_CTX *Context)
+{
+    Context->State[0] = 0x6a09e667;
+    Context->State[1] = 0xbb67ae85;
+    Context->State[2] = 0x3c6ef372;
+    Context->State[3] = 0xa54ff53a;
+    Context->State[4] = 0x510e527f;
+    Context->State[5] = 0x9b05688c;
+    Context->State[6] = 0x1f83d9ab;
+    Context->State[7] = 0x5be0cd19;
+    Context->Count = 0;
+}
+
+void SHA256_Update(SHA256_CTX *Context, const unsigned char *Data, SIZE_T Length)
+{
+    SIZE_T Used = (SIZE_T)(Context->Count & (SHA256_BLOCK_LENGTH - 1));
+    SIZE_T Fill, Blocks;
+
+    Context->Count += Length;
+
+    if (Used)
+    {
+        Fill = SHA256_BLOCK_LENGTH - Used;
+        if (Length < Fill)
+        {
+            memcpy(Context->Buffer + Used, Data, Length);
+            return;
+        }
+        memcpy(Context->Buffer + Used, Data, Fill);
+        sha256_blocks(Context->State, Context->Buffer, 1);
+        Data += Fill;
+        Length -= Fill;
+    }
+
+    /* Whole blocks are hashed straight from the caller's buffer */
+    Blocks = Length / SHA256_BLOCK_LENGTH;
+    if (Blocks)
+    {
+        sha256_blocks(Context->State, Data, Blocks);
+        Data += Blocks * SHA256_BLOCK_LENGTH;
+        Length -= Blocks * SHA256_BLOCK_LENGTH;
+    }
+
+    if (Length)
+        memcpy(Context->Buffer, Data, Length);
+}
+
+void SHA256_Final(unsigned char *Digest, SHA256_CTX *Context)
+{
+    SIZE_T Used = (SIZE_T)(Context->Count & (SHA256_BLOCK_LENGTH - 1));
+    int i;
+
+    Context->Buffer[Used++] = 0x80;
+    if (Used > SHA256_BLOCK_LENGTH - 8)
+    {
+        memset(Context->Buffer + Used, 0, SHA256_BLOCK_LENGTH - Used);
+        sha256_blocks(Context->State, Context->Buffer, 1);
+        Used = 0;
+    }
+    memset(Context->Buffer + Used, 0, SHA256_BLOCK_LENGTH - 8 - Used);
+    store64_be(Context->Buffer + SHA256_BLOCK_LENGTH - 8, Context->Count << 3);
+    sha256_blocks(Context->State, Context->Buffer, 1);
+
+    for (i = 0; i < 8; i++)
+        store32_be(Digest + i * 4, Context->State[i]);
+
+    memset(Context, 0, sizeof(*Context));
+}
+
+static void sha512_update(SHA512_CTX *Context, const unsigned char *Data, SIZE_T Length)
+{
+    SIZE_T Used = (SIZE_T)(Context->Count[0] & (SHA512_BLOCK_LENGTH - 1));
+    SIZE_T Fill, Blocks;
+
+    Context->Count[0] += Length;
+    if (Context->Count[0] < Length)
+        Context->Count[1]++;
+
+    if (Used)
+    {
+        Fill = SHA512_BLOCK_LENGTH - Used;
+        if (Length < Fill)
+        {
+            memcpy(Context->Buffer + Used, Data, Length);
+            return;
+        }
+        memcpy(Context->Buffer + Used, Data, Fill);
+        sha512_blocks(Context->State, Context->Buffer, 1);
+        Data += Fill;
+        Length -= Fill;
+    }
+
+    Blocks = Length / SHA512_BLOCK_LENGTH;
+    if (Blocks)
+    {
+        sha512_blocks(Context->State, Data, Blocks);
+        Data += Blocks * SHA512_BLOCK_LENGTH;
+        Length -= Blocks * SHA512_BLOCK_LENGTH;
+    }
+
+    if (Length)
+        memcpy(Context->Buffer, Data, Length);
+}
+
+static void sha512_final(unsigned char *Digest, SHA512_CTX *Context, int Words)
+{
+    SIZE_T Used = (SIZE_T)(Context->Count[0] & (SHA512_BLOCK_LENGTH - 1));
+    int i;
+
+    Context->Buffer[Used++] = 0x80;
+    if (Used > SHA512_BLOCK_LENGTH - 16)
+    {
+        memset(Context->Buffer + Used, 0, SHA512_BLOCK_LENGTH - Used);
+        sha512_blocks(Context->State, Context->Buffer, 1);
+        Used = 0;
+    }
+    memset(Context->Buffer + Used, 0, SHA512_BLOCK_LENGTH - 16 - Used);
+    store64_be(Context->Buffer + SHA512_BLOCK_LENGTH - 16,
+               (Context->Count[1] << 3) | (Context->Count[0] >> 61));
+    store64_be(Context->Buffer + SHA512_BLOCK_LENGTH - 8, Context->Count[0] << 3);
+    sha512_blocks(Context->State, Context->Buffer, 1);
+
+    for (i = 0; i < Words; i++)
+        store64_be(Digest + i * 8, Context->State[i]);
+
+    memset(Context, 0, sizeof(*Context));
+}
+
+void SHA384_Init(SHA384_CTX *Context)
+{
+    Context->State[0] = 0xcbbb9d5dc1059ed8ULL;
+    Context->State[1] = 0x629a292a367cd507ULL;
+    Context->State[2] = 0x9159015a3070dd17ULL;
+    Context->State[3] = 0x152fecd8f70e5939ULL;
+    Context->State[4] = 0x67332667ffc00b31ULL;
+    Context->State[5] = 0x8eb44a8768581511ULL;
+    Context->State[6] = 0xdb0c2e0d64f98fa7ULL;
+    Context->State[7] = 0x47b5481dbefa4fa4ULL;
+    Context->Count[0] = Context->Count[1] = 0;
+}
+
+void SHA384_Update(SHA384_CTX *Context, const unsigned char *Data, SIZE_T Length)
+{
+    sha512_update(Context, Data, Length);
+}
+
+void SHA384_Final(unsigned char *Digest, SHA384_CTX *Context)
+{
+    sha512_final(Digest, Context, SHA384_DIGEST_LENGTH / 8);
+}
+
+void SHA512_Init(SHA512_CTX *Context)
+{
+    Context->State[0] = 0x6a09e667f3bcc908ULL;
+    Context->State[1] = 0xbb67ae8584caa73bULL;
+    Context->State[2] = 0x3c6ef372fe94f82bULL;
+    Context->State[3] = 0xa54ff53a5f1d36f1ULL;
+    Context->State[4] = 0x510e527fade682d1ULL;
+    Context->State[5] = 0x9b05688c2b3e6c1fULL;
+    Context->State[6] = 0x1f83d9abfb41bd6bULL;
+    Context->State[7] = 0x5be0cd19137e2179ULL;
+    Context->Count[0] = Context->Count[1] = 0;
+}
+
+void SHA512_Update(SHA512_CTX *Context, const unsigned char *Data, SIZE_T Length)
+{
+    sha512_update(Context, Data, Length);
+}
+
+void SHA512_Final(unsigned char *Digest, SHA512_CTX *Context)
+{
+    sha512_final(Digest, Context, SHA512_DIGEST_LENGTH / 8);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <basetsd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHA256_BLOCK_LENGTH     64
+#define SHA256_DIGEST_LENGTH    32
+#define SHA384_BLOCK_LENGTH     128
+#define SHA384_DIGEST_LENGTH    48
+#define SHA512_BLOCK_LENGTH     128
+#define SHA512_DIGEST_LENGTH    64
+
+typedef struct _SHA256_CTX
+{
+    ULONG32 State[8];
+    ULONG64 Count;
+    unsigned char Buffer[SHA256_BLOCK_LENGTH];
+} SHA256_CTX;
+
+typedef struct _SHA512_CTX
+{
+    ULONG64 State[8];
+    ULONG64 Count[2];
+    unsigned char Buffer[SHA512_BLOCK_LENGTH];
+} SHA512_CTX;
+
+typedef SHA512_CTX SHA384_CTX;
+
+void SHA256_Init(SHA256_CTX *Context);
+void SHA256_Update(SHA256_CTX *Context, const unsigned char *Data, SIZE_T Length);
+void SHA256_Final(unsigned char *Digest, SHA256_CTX *Context);
+
+void SHA384_Init(SHA384_CTX *Context);
+void SHA384_Update(SHA384_CTX *Context, const unsigned char *Data, SIZE_T Length);
+void SHA384_Final(unsigned char *Digest, SHA384_CTX *Context);
+
+void SHA512_Init(SHA512_CTX *Context);
+void SHA512_Update(SHA512_CTX *Context, const unsigned char *Data, SIZE_T Length);
+void SHA512_Final(unsigned char *Digest, SHA512_CTX *Context);
+
+#ifdef __cplusplus
+}
+#endif
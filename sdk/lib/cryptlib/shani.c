@@ -0,0 +1,147 @@
+/*
+ * PROJECT:     ReactOS Crypto Library
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     SHA-1 and SHA-256 block functions using the SHA extensions
+ */
+
+#include "cryptsimd.h"
+
+#ifdef CRYPT_HAVE_SIMD
+
+#include <immintrin.h>
+
+#define SHANI_TARGET CRYPT_TARGET("sse2,ssse3,sse4.1,sha")
+
+/*
+ * One group of four rounds. The message registers rotate through the
+ * groups: Cur feeds the rounds, the others are being expanded.
+ */
+#define SHA1_GROUP(g, Ein, Eout, Cur, Next, Prev2, Prev)    \
+    if ((g) == 0)                                           \
+        Ein = _mm_add_epi32(Ein, Cur);                      \
+    else                                                    \
+        Ein = _mm_sha1nexte_epu32(Ein, Cur);                \
+    Eout = Abcd;                                            \
+    if ((g) >= 3 && (g) <= 18)                              \
+        Next = _mm_sha1msg2_epu32(Next, Cur);               \
+    Abcd = _mm_sha1rnds4_epu32(Abcd, Ein, (g) / 5);         \
+    if ((g) >= 1 && (g) <= 16)                              \
+        Prev = _mm_sha1msg1_epu32(Prev, Cur);               \
+    if ((g) >= 2 && (g) <= 17)                              \
+        Prev2 = _mm_xor_si128(Prev2, Cur);
+
+SHANI_TARGET
+void shani_sha1_blocks(ULONG32 *state, const unsigned char *data, unsigned long blocks)
+{
+    const __m128i Reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i Abcd, E0, E1, AbcdSave, E0Save, M0, M1, M2, M3;
+    ULONG32 Out[4];
+
+    Abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1B);
+    E0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+    while (blocks--)
+    {
+        AbcdSave = Abcd;
+        E0Save = E0;
+
+        M0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), Reverse);
+        M1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), Reverse);
+        M2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), Reverse);
+        M3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), Reverse);
+
+        SHA1_GROUP( 0, E0, E1, M0, M1, M2, M3)
+        SHA1_GROUP( 1, E1, E0, M1, M2, M3, M0)
+        SHA1_GROUP( 2, E0, E1, M2, M3, M0, M1)
+        SHA1_GROUP( 3, E1, E0, M3, M0, M1, M2)
+        SHA1_GROUP( 4, E0, E1, M0, M1, M2, M3)
+        SHA1_GROUP( 5, E1, E0, M1, M2, M3, M0)
+        SHA1_GROUP( 6, E0, E1, M2, M3, M0, M1)
+        SHA1_GROUP( 7, E1, E0, M3, M0, M1, M2)
+        SHA1_GROUP( 8, E0, E1, M0, M1, M2, M3)
+        SHA1_GROUP( 9, E1, E0, M1, M2, M3, M0)
+        SHA1_GROUP(10, E0, E1, M2, M3, M0, M1)
+        SHA1_GROUP(11, E1, E0, M3, M0, M1, M2)
+        SHA1_GROUP(12, E0, E1, M0, M1, M2, M3)
+        SHA1_GROUP(13, E1, E0, M1, M2, M3, M0)
+        SHA1_GROUP(14, E0, E1, M2, M3, M0, M1)
+        SHA1_GROUP(15, E1, E0, M3, M0, M1, M2)
+        SHA1_GROUP(16, E0, E1, M0, M1, M2, M3)
+        SHA1_GROUP(17, E1, E0, M1, M2, M3, M0)
+        SHA1_GROUP(18, E0, E1, M2, M3, M0, M1)
+        SHA1_GROUP(19, E1, E0, M3, M0, M1, M2)
+
+        E0 = _mm_sha1nexte_epu32(E0, E0Save);
+        Abcd = _mm_add_epi32(Abcd, AbcdSave);
+        data += 64;
+    }
+
+    _mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(Abcd, 0x1B));
+    _mm_storeu_si128((__m128i *)Out, E0);
+    state[4] = Out[3];
+}
+
+#define SHA256_GROUP(i, Cur, Next, Prev)                                    \
+    Msg = _mm_add_epi32(Cur, _mm_loadu_si128((const __m128i *)&sha256_k[(i) * 4])); \
+    State1 = _mm_sha256rnds2_epu32(State1, State0, Msg);                    \
+    if ((i) >= 3 && (i) <= 14)                                              \
+    {                                                                       \
+        Next = _mm_add_epi32(Next, _mm_alignr_epi8(Cur, Prev, 4));          \
+        Next = _mm_sha256msg2_epu32(Next, Cur);                             \
+    }                                                                       \
+    Msg = _mm_shuffle_epi32(Msg, 0x0E);                                     \
+    State0 = _mm_sha256rnds2_epu32(State0, State1, Msg);                    \
+    if ((i) >= 1 && (i) <= 12)                                              \
+        Prev = _mm_sha256msg1_epu32(Prev, Cur);
+
+SHANI_TARGET
+void shani_sha256_blocks(ULONG32 *state, const unsigned char *data, unsigned long blocks)
+{
+    const __m128i Swap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    __m128i State0, State1, Save0, Save1, Msg, Tmp, M0, M1, M2, M3;
+
+    /* The round instructions want the state as ABEF and CDGH */
+    Tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0xB1);
+    State1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(state + 4)), 0x1B);
+    State0 = _mm_alignr_epi8(Tmp, State1, 8);
+    State1 = _mm_blend_epi16(State1, Tmp, 0xF0);
+
+    while (blocks--)
+    {
+        Save0 = State0;
+        Save1 = State1;
+
+        M0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), Swap);
+        M1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), Swap);
+        M2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), Swap);
+        M3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), Swap);
+
+        SHA256_GROUP( 0, M0, M1, M3)
+        SHA256_GROUP( 1, M1, M2, M0)
+        SHA256_GROUP( 2, M2, M3, M1)
+        SHA256_GROUP( 3, M3, M0, M2)
+        SHA256_GROUP( 4, M0, M1, M3)
+        SHA256_GROUP( 5, M1, M2, M0)
+        SHA256_GROUP( 6, M2, M3, M1)
+        SHA256_GROUP( 7, M3, M0, M2)
+        SHA256_GROUP( 8, M0, M1, M3)
+        SHA256_GROUP( 9, M1, M2, M0)
+        SHA256_GROUP(10, M2, M3, M1)
+        SHA256_GROUP(11, M3, M0, M2)
+        SHA256_GROUP(12, M0, M1, M3)
+        SHA256_GROUP(13, M1, M2, M0)
+        SHA256_GROUP(14, M2, M3, M1)
+        SHA256_GROUP(15, M3, M0, M2)
+
+        State0 = _mm_add_epi32(State0, Save0);
+        State1 = _mm_add_epi32(State1, Save1);
+        data += 64;
+    }
+
+    Tmp = _mm_shuffle_epi32(State0, 0x1B);
+    State1 = _mm_shuffle_epi32(State1, 0xB1);
+    _mm_storeu_si128((__m128i *)state, _mm_blend_epi16(Tmp, State1, 0xF0));
+    _mm_storeu_si128((__m128i *)(state + 4), _mm_alignr_epi8(State1, Tmp, 8));
+}
+
+#endif /* CRYPT_HAVE_SIMD */
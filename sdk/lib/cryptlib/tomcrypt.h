@@ -150,6 +150,36 @@ int aes_setup(const unsigned char *key, int keylen, int rounds, aes_key *skey);
 void aes_ecb_encrypt(const unsigned char *pt, unsigned char *ct, aes_key *skey);
 void aes_ecb_decrypt(const unsigned char *ct, unsigned char *pt, aes_key *skey);
 
+/* CBC wants whole blocks. The IV and the counter are updated in place, so
+ * that another call continues the stream. A partial block ends a CTR stream. */
+int aes_cbc_encrypt(const unsigned char *pt, unsigned char *ct, unsigned long len,
+                    unsigned char *iv, aes_key *skey);
+int aes_cbc_decrypt(const unsigned char *ct, unsigned char *pt, unsigned long len,
+                    unsigned char *iv, aes_key *skey);
+int aes_ctr_crypt(const unsigned char *in, unsigned char *out, unsigned long len,
+                  unsigned char *ctr, aes_key *skey);
+
+#define GCM_ENCRYPT 0
+#define GCM_DECRYPT 1
+
+typedef struct tag_gcm_state {
+    aes_key *key;
+    ulong64 HL[16], HH[16];
+    unsigned char H[4][16];
+    unsigned char J0[16], ctr[16], X[16];
+    unsigned char buf[16], ks[16];
+    unsigned long buflen, kslen;
+    ulong64 aadlen, ptlen;
+    int mode;
+} gcm_state;
+
+/* All AAD goes in before the first gcm_process, the caller compares tags */
+int gcm_init(gcm_state *gcm, aes_key *skey, const unsigned char *iv, unsigned long ivlen);
+int gcm_add_aad(gcm_state *gcm, const unsigned char *aad, unsigned long len);
+int gcm_process(gcm_state *gcm, const unsigned char *in, unsigned char *out,
+                unsigned long len, int direction);
+int gcm_done(gcm_state *gcm, unsigned char *tag, unsigned long taglen);
+
 typedef struct tag_md2_state {
     unsigned char chksum[16], X[48], buf[16];
     unsigned long curlen;
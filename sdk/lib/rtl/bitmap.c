@@ -65,34 +65,30 @@ typedef ULONG BITMAP_INDEX, *PBITMAP_INDEX;
 typedef ULONG BITMAP_BUFFER, *PBITMAP_BUFFER;
 #endif
 
-/* DATA *********************************************************************/
+/* PRIVATE FUNCTIONS ********************************************************/
 
-/* Number of set bits per byte value */
-static const
-UCHAR
-BitCountTable[256] =
-{
-    /* x0 x1 x2 x3 x4 x5 x6 x7 x8 x9 xA xB xC xD xE xF */
-       0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, /* 0x */
-       1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, /* 1x */
-       1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, /* 2x */
-       2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, /* 3x */
-       1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, /* 4x */
-       2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, /* 5x */
-       2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, /* 6c */
-       3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, /* 7x */
-       1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, /* 8x */
-       2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, /* 9x */
-       2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, /* Ax */
-       3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, /* Bx */
-       2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, /* Cx */
-       3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, /* Dx */
-       3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, /* Ex */
-       4, 5, 5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8  /* Fx */
-};
+/*
+ * On 64 bit targets the run scanners of the 32 bit bitmap skip clear or set
+ * areas 64 bits at a time. The buffer is little endian, so two consecutive
+ * ULONGs read as one ULONG64 keep their bit order.
+ */
+#if defined(_WIN64) && !defined(USE_RTL_BITMAP64)
+#define RTLP_BITMAP_SCAN64
+#endif
 
+static __inline
+BITMAP_INDEX
+RtlpPopulationCount(
+    _In_ BITMAP_BUFFER Value)
+{
+    /* Count the bits in parallel, first in pairs, then nibbles, then bytes */
+    Value = Value - ((Value >> 1) & (MAXINDEX / 3));
+    Value = (Value & (MAXINDEX / 5)) + ((Value >> 2) & (MAXINDEX / 5));
+    Value = (Value + (Value >> 4)) & (MAXINDEX / 17);
 
-/* PRIVATE FUNCTIONS ********************************************************/
+    /* Sum up all bytes in the top byte */
+    return (BITMAP_INDEX)((Value * (MAXINDEX / 255)) >> (_BITCOUNT - 8));
+}
 
 static __inline
 BITMAP_INDEX
@@ -120,6 +116,17 @@ RtlpGetLengthOfRunClear(
     /* Clear the bits that don't belong to this run */
     Value = *Buffer++ >> BitPos << BitPos;
 
+#ifdef RTLP_BITMAP_SCAN64
+    /* Skip clear ULONG pairs */
+    if (Value == 0)
+    {
+        while ((Buffer + 2 <= MaxBuffer) && (*(ULONG64 UNALIGNED *)Buffer == 0))
+        {
+            Buffer += 2;
+        }
+    }
+#endif
+
     /* Skip all clear ULONGs */
     while (Value == 0 && Buffer < MaxBuffer)
     {
@@ -174,6 +181,17 @@ RtlpGetLengthOfRunSet(
     /* Get the inversed value, clear bits that don't belong to the run */
     InvValue = ~(*Buffer++) >> BitPos << BitPos;
 
+#ifdef RTLP_BITMAP_SCAN64
+    /* Skip set ULONG pairs */
+    if (InvValue == 0)
+    {
+        while ((Buffer + 2 <= MaxBuffer) && (*(ULONG64 UNALIGNED *)Buffer == MAXULONG64))
+        {
+            Buffer += 2;
+        }
+    }
+#endif
+
     /* Skip all set ULONGs */
     while (InvValue == 0 && Buffer < MaxBuffer)
     {
@@ -191,7 +209,7 @@ RtlpGetLengthOfRunSet(
     BitScanForward(&BitPos, InvValue);
 
     /* Calculate length up to where we read */
-    Length = (ULONG)(Buffer - BitMapHeader->Buffer) * _BITCOUNT - StartingIndex;
+    Length = (BITMAP_INDEX)(Buffer - BitMapHeader->Buffer) * _BITCOUNT - StartingIndex;
     Length += BitPos - _BITCOUNT;
 
     /* Make sure we don't go past the last bit */
@@ -296,7 +314,7 @@ RtlClearBit(
     _In_ BITMAP_INDEX BitNumber)
 {
     ASSERT(BitNumber <= BitMapHeader->SizeOfBitMap);
-    BitMapHeader->Buffer[BitNumber / _BITCOUNT] &= ~(1 << (BitNumber & (_BITCOUNT - 1)));
+    BitMapHeader->Buffer[BitNumber / _BITCOUNT] &= ~((BITMAP_INDEX)1 << (BitNumber & (_BITCOUNT - 1)));
 }
 
 VOID
@@ -474,22 +492,24 @@ NTAPI
 RtlNumberOfSetBits(
     _In_ PRTL_BITMAP BitMapHeader)
 {
-    PUCHAR Byte, MaxByte;
+    PBITMAP_BUFFER Buffer, MaxBuffer;
     BITMAP_INDEX BitCount = 0;
-    ULONG Shift;
+    BITMAP_INDEX Bits;
 
-    Byte = (PUCHAR)BitMapHeader->Buffer;
-    MaxByte = Byte + BitMapHeader->SizeOfBitMap / 8;
+    Buffer = BitMapHeader->Buffer;
+    MaxBuffer = Buffer + BitMapHeader->SizeOfBitMap / _BITCOUNT;
 
-    while (Byte < MaxByte)
+    /* Count all full ULONGs */
+    while (Buffer < MaxBuffer)
     {
-        BitCount += BitCountTable[*Byte++];
+        BitCount += RtlpPopulationCount(*Buffer++);
     }
 
-    if (BitMapHeader->SizeOfBitMap & 7)
+    /* Count the bits that are left, ignoring the ones past the end */
+    Bits = BitMapHeader->SizeOfBitMap & (_BITCOUNT - 1);
+    if (Bits != 0)
     {
-        Shift = 8 - (BitMapHeader->SizeOfBitMap & 7);
-        BitCount += BitCountTable[((*Byte) << Shift) & 0xFF];
+        BitCount += RtlpPopulationCount(*Buffer & ~(MAXINDEX << Bits));
     }
 
     return BitCount;
@@ -873,7 +893,7 @@ RtlFindClearRuns(
             for (Run = 0; Run < SizeOfRunArray; Run++)
             {
                 /*Is this the new smallest run? */
-                if (NumberOfBits < RunArray[SmallestRun].NumberOfBits)
+                if (RunArray[Run].NumberOfBits < RunArray[SmallestRun].NumberOfBits)
                 {
                     /* Set it as new smallest run */
                     SmallestRun = Run;
@@ -882,7 +902,7 @@ RtlFindClearRuns(
         }
 
         /* Advance bits */
-        FromIndex += NumberOfBits;
+        FromIndex = StartingIndex + NumberOfBits;
     }
 
     return Run;
@@ -915,7 +935,10 @@ RtlFindLongestRunClear(
         }
 
         /* Advance bits */
-        FromIndex += NumberOfBits;
+        FromIndex = Index + NumberOfBits;
+
+        /* Stop when the rest of the bitmap cannot hold a longer run */
+        if (BitMapHeader->SizeOfBitMap - FromIndex <= MaxNumberOfBits) break;
     }
 
     return MaxNumberOfBits;
@@ -948,7 +971,10 @@ RtlFindLongestRunSet(
         }
 
         /* Advance bits */
-        FromIndex += NumberOfBits;
+        FromIndex = Index + NumberOfBits;
+
+        /* Stop when the rest of the bitmap cannot hold a longer run */
+        if (BitMapHeader->SizeOfBitMap - FromIndex <= MaxNumberOfBits) break;
     }
 
     return MaxNumberOfBits;
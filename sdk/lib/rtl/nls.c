@@ -9,6 +9,7 @@
 /* INCLUDES *****************************************************************/
 
 #include <rtl.h>
+#include <nlsascii.h>
 
 #define NDEBUG
 #include <debug.h>
@@ -35,6 +36,10 @@ PUSHORT NlsOemLeadByteInfo = NULL; /* exported */
 USHORT NlsOemDefaultChar = '\0';
 USHORT NlsUnicodeDefaultChar = 0;
 
+/* Whether ASCII converts as is, see nlsascii.h */
+static BOOLEAN NlsAnsiAsciiTag = FALSE;
+static BOOLEAN NlsOemAsciiTag = FALSE;
+
 
 /* FUNCTIONS *****************************************************************/
 
@@ -252,6 +257,13 @@ RtlMultiByteToUnicodeN(OUT PWCHAR UnicodeString,
 
         for (i = 0; i < Size; i++)
         {
+            if (NlsAnsiAsciiTag && (UCHAR)MbString[i] < 0x80)
+            {
+                i += NlsWidenAscii(&UnicodeString[i], &MbString[i], Size - i);
+                if (i == Size)
+                    break;
+            }
+
             UnicodeString[i] = NlsAnsiToUnicodeTable[(UCHAR)MbString[i]];
         }
     }
@@ -263,6 +275,7 @@ RtlMultiByteToUnicodeN(OUT PWCHAR UnicodeString,
         UCHAR Char;
         USHORT LeadByteInfo;
         PCSTR MbEnd = MbString + MbSize;
+        ULONG Count;
 
         for (i = 0; i < UnicodeSize / sizeof(WCHAR) && MbString < MbEnd; i++)
         {
@@ -271,6 +284,14 @@ RtlMultiByteToUnicodeN(OUT PWCHAR UnicodeString,
             if (Char < 0x80)
             {
                 *UnicodeString++ = Char;
+
+                /* Take the rest of the ASCII run at once */
+                Count = NlsWidenAscii(UnicodeString, MbString,
+                                      min(UnicodeSize / sizeof(WCHAR) - i - 1,
+                                          (ULONG)(MbEnd - MbString)));
+                UnicodeString += Count;
+                MbString += Count;
+                i += Count;
                 continue;
             }
 
@@ -344,7 +365,17 @@ RtlMultiByteToUnicodeSize(OUT PULONG UnicodeSize,
         {
             UCHAR Char = *(PUCHAR)MbString++;
 
-            if (Char >= 0x80 && NlsLeadByteInfo[Char])
+            if (Char < 0x80)
+            {
+                /* Count the rest of the ASCII run at once */
+                ULONG Count = NlsAsciiSpanA(MbString, MbSize);
+                MbString += Count;
+                MbSize -= Count;
+                Length += Count + 1;
+                continue;
+            }
+
+            if (NlsLeadByteInfo[Char])
             {
                 if (MbSize)
                 {
@@ -394,9 +425,14 @@ RtlOemToUnicodeN(OUT PWCHAR UnicodeString,
 
         for (i = 0; i < Size; i++)
         {
-            *UnicodeString = NlsOemToUnicodeTable[(UCHAR)*OemString];
-            UnicodeString++;
-            OemString++;
+            if (NlsOemAsciiTag && (UCHAR)OemString[i] < 0x80)
+            {
+                i += NlsWidenAscii(&UnicodeString[i], &OemString[i], Size - i);
+                if (i == Size)
+                    break;
+            }
+
+            UnicodeString[i] = NlsOemToUnicodeTable[(UCHAR)OemString[i]];
         }
     }
     else
@@ -407,6 +443,7 @@ RtlOemToUnicodeN(OUT PWCHAR UnicodeString,
         UCHAR Char;
         USHORT OemLeadByteInfo;
         PCCH OemEnd = OemString + OemSize;
+        ULONG Count;
 
         for (i = 0; i < UnicodeSize / sizeof(WCHAR) && OemString < OemEnd; i++)
         {
@@ -415,6 +452,14 @@ RtlOemToUnicodeN(OUT PWCHAR UnicodeString,
             if (Char < 0x80)
             {
                 *UnicodeString++ = Char;
+
+                /* Take the rest of the ASCII run at once */
+                Count = NlsWidenAscii(UnicodeString, OemString,
+                                      min(UnicodeSize / sizeof(WCHAR) - i - 1,
+                                          (ULONG)(OemEnd - OemString)));
+                UnicodeString += Count;
+                OemString += Count;
+                i += Count;
                 continue;
             }
 
@@ -455,6 +500,7 @@ RtlResetRtlTranslations(IN PNLSTABLEINFO NlsTable)
     NlsMbCodePageTag = (NlsTable->AnsiTableInfo.DBCSCodePage != 0);
     NlsLeadByteInfo = NlsTable->AnsiTableInfo.DBCSOffsets;
     NlsAnsiCodePage = NlsTable->AnsiTableInfo.CodePage;
+    NlsAnsiAsciiTag = NlsIsAsciiCodePage(&NlsTable->AnsiTableInfo);
     DPRINT("Ansi codepage %hu\n", NlsAnsiCodePage);
 
     /* Set OEM data */
@@ -464,6 +510,7 @@ RtlResetRtlTranslations(IN PNLSTABLEINFO NlsTable)
     NlsMbOemCodePageTag = (NlsTable->OemTableInfo.DBCSCodePage != 0);
     NlsOemLeadByteInfo = NlsTable->OemTableInfo.DBCSOffsets;
     NlsOemCodePage = NlsTable->OemTableInfo.CodePage;
+    NlsOemAsciiTag = NlsIsAsciiCodePage(&NlsTable->OemTableInfo);
     DPRINT("Oem codepage %hu\n", NlsOemCodePage);
 
     /* Set Unicode case map data */
@@ -545,7 +592,14 @@ RtlUnicodeToMultiByteN(OUT PCHAR MbString,
 
         for (i = 0; i < Size; i++)
         {
-            *MbString++ = NlsUnicodeToAnsiTable[*UnicodeString++];
+            if (NlsAnsiAsciiTag && UnicodeString[i] < 0x80)
+            {
+                i += NlsNarrowAscii(&MbString[i], &UnicodeString[i], Size - i);
+                if (i == Size)
+                    break;
+            }
+
+            MbString[i] = NlsUnicodeToAnsiTable[UnicodeString[i]];
         }
     }
     else
@@ -555,6 +609,7 @@ RtlUnicodeToMultiByteN(OUT PCHAR MbString,
 
         USHORT WideChar;
         USHORT MbChar;
+        ULONG Count;
 
         for (i = MbSize, Size = UnicodeSize / sizeof(WCHAR); i && Size; i--, Size--)
         {
@@ -563,6 +618,13 @@ RtlUnicodeToMultiByteN(OUT PCHAR MbString,
             if (WideChar < 0x80)
             {
                 *MbString++ = LOBYTE(WideChar);
+
+                /* Take the rest of the ASCII run at once */
+                Count = NlsNarrowAscii(MbString, UnicodeString, min(i, Size) - 1);
+                MbString += Count;
+                UnicodeString += Count;
+                i -= Count;
+                Size -= Count;
                 continue;
             }
 
@@ -618,7 +680,17 @@ RtlUnicodeToMultiByteSize(OUT PULONG MbSize,
         {
             USHORT WideChar = *UnicodeString++;
 
-            if (WideChar >= 0x80 && HIBYTE(NlsUnicodeToMbAnsiTable[WideChar]))
+            if (WideChar < 0x80)
+            {
+                /* Count the rest of the ASCII run at once */
+                ULONG Count = NlsAsciiSpanW(UnicodeString, UnicodeLength);
+                UnicodeString += Count;
+                UnicodeLength -= Count;
+                MbLength += Count + 1;
+                continue;
+            }
+
+            if (HIBYTE(NlsUnicodeToMbAnsiTable[WideChar]))
             {
                 MbLength += sizeof(WCHAR);
             }
@@ -657,6 +729,16 @@ RtlUnicodeToOemN(OUT PCHAR OemString,
     {
         while (OemSize && UnicodeSize)
         {
+            if (NlsOemAsciiTag && *UnicodeString < 0x80)
+            {
+                ULONG Count = NlsNarrowAscii(&OemString[Size], UnicodeString, min(OemSize, UnicodeSize));
+                UnicodeString += Count;
+                Size += Count;
+                OemSize -= Count;
+                UnicodeSize -= Count;
+                continue;
+            }
+
             OemString[Size] = NlsUnicodeToOemTable[*UnicodeString++];
             Size++;
             OemSize--;
@@ -667,7 +749,19 @@ RtlUnicodeToOemN(OUT PCHAR OemString,
     {
         while (OemSize && UnicodeSize)
         {
-            USHORT OemChar = NlsUnicodeToMbOemTable[*UnicodeString++];
+            USHORT OemChar;
+
+            if (NlsOemAsciiTag && *UnicodeString < 0x80)
+            {
+                ULONG Count = NlsNarrowAscii(&OemString[Size], UnicodeString, min(OemSize, UnicodeSize));
+                UnicodeString += Count;
+                Size += Count;
+                OemSize -= Count;
+                UnicodeSize -= Count;
+                continue;
+            }
+
+            OemChar = NlsUnicodeToMbOemTable[*UnicodeString++];
 
             if (HIBYTE(OemChar))
             {
@@ -8,6 +8,7 @@
 /* INCLUDES ******************************************************************/
 
 #include <rtl_vista.h>
+#include <nlsascii.h>
 
 #define NDEBUG
 #include <debug.h>
@@ -27,6 +28,7 @@ NTSTATUS NTAPI RtlUnicodeToUTF8N(CHAR *utf8_dest, ULONG utf8_bytes_max,
     ULONG ch;
     BYTE utf8_ch[4];
     ULONG utf8_ch_len;
+    ULONG count;
 
     if (!uni_src)
         return STATUS_INVALID_PARAMETER_4;
@@ -40,6 +42,26 @@ NTSTATUS NTAPI RtlUnicodeToUTF8N(CHAR *utf8_dest, ULONG utf8_bytes_max,
 
     for (i = 0; i < uni_bytes / sizeof(WCHAR); i++)
     {
+        /* take runs of ASCII as they are */
+        if (uni_src[i] < 0x80)
+        {
+            count = uni_bytes / sizeof(WCHAR) - i;
+            if (utf8_dest)
+            {
+                count = NlsNarrowAscii(utf8_dest, &uni_src[i], min(count, utf8_bytes_max));
+                utf8_dest += count;
+                utf8_bytes_max -= count;
+            }
+            else
+            {
+                count = NlsAsciiSpanW(&uni_src[i], count);
+            }
+            written += count;
+            i += count;
+            if (i == uni_bytes / sizeof(WCHAR))
+                break;
+        }
+
         /* decode UTF-16 into ch */
         ch = uni_src[i];
         if (ch >= 0xdc00 && ch <= 0xdfff)
@@ -140,6 +162,7 @@ NTSTATUS NTAPI RtlUTF8ToUnicodeN(WCHAR *uni_dest, ULONG uni_bytes_max,
     ULONG utf8_trail_bytes;
     WCHAR utf16_ch[3];
     ULONG utf16_ch_len;
+    ULONG count;
 
     if (!utf8_src)
         return STATUS_INVALID_PARAMETER_4;
@@ -151,6 +174,26 @@ NTSTATUS NTAPI RtlUTF8ToUnicodeN(WCHAR *uni_dest, ULONG uni_bytes_max,
 
     for (i = 0; i < utf8_bytes; i++)
     {
+        /* take runs of ASCII as they are */
+        if ((BYTE)utf8_src[i] < 0x80)
+        {
+            count = utf8_bytes - i;
+            if (uni_dest)
+            {
+                count = NlsWidenAscii(uni_dest, &utf8_src[i], min(count, uni_bytes_max / sizeof(WCHAR)));
+                uni_dest += count;
+                uni_bytes_max -= count * sizeof(WCHAR);
+            }
+            else
+            {
+                count = NlsAsciiSpanA(&utf8_src[i], count);
+            }
+            written += count;
+            i += count;
+            if (i == utf8_bytes)
+                break;
+        }
+
         /* read UTF-8 lead byte */
         ch = (BYTE)utf8_src[i];
         utf8_trail_bytes = 0;
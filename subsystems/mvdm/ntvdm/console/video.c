@@ -405,6 +405,9 @@ static BOOL AttachToConsoleInternal(PCOORD Resolution)
         Address += ScanlineSize;
     }
 
+    /* The VGA memory was written directly, convert all of it again */
+    VgaFullRefresh = TRUE;
+
 #ifdef USE_REAL_REGISTERCONSOLEVDM
     if (CharBuff) RtlFreeHeap(RtlGetProcessHeap(), 0, CharBuff);
 #endif
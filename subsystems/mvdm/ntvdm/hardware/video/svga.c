@@ -297,6 +297,47 @@ static COORD CurrResolution   = {0};
 
 static SMALL_RECT UpdateRectangle = { 0, 0, 0, 0 };
 
+/*
+ * Dirty tracking -- VgaWriteMemory sets one bit per VGA_DIRTY_PAGE_SIZE bytes
+ * of VGA memory, and only the scanlines reading from dirty pages are converted
+ * again. Everything is converted again when VgaFullRefresh is set or when the
+ * registers controlling how the memory is displayed have changed.
+ */
+#define VGA_DIRTY_PAGE_SHIFT    10
+#define VGA_DIRTY_PAGE_SIZE     (1 << VGA_DIRTY_PAGE_SHIFT)
+#define VGA_NUM_DIRTY_PAGES     (sizeof(VgaMemory) / VGA_DIRTY_PAGE_SIZE)
+
+/* The widest possible scanline, plus room for the 8 pixel conversion */
+#define VGA_MAX_LINE_WIDTH      (256 * 9 + 8)
+
+typedef struct _VGA_DISPLAY_STATE
+{
+    SCREEN_MODE ScreenMode;
+    COORD Resolution;
+    DWORD StartAddress;
+    DWORD ScanlineSize;
+    BYTE SeqExtMode;
+    BYTE CrtcRegisters[VGA_CRTC_MAX_REG];
+    BYTE CrtcExtDisplay;
+    BYTE GcMode;
+    BYTE GcMisc;
+    BYTE AcRegisters[VGA_AC_MAX_REG];
+    BOOLEAN AcPalDisable;
+} VGA_DISPLAY_STATE, *PVGA_DISPLAY_STATE;
+
+static ULONG VgaDirtyPages[VGA_NUM_DIRTY_PAGES / 32];
+static BOOLEAN VgaFullRefresh = TRUE;
+static VGA_DISPLAY_STATE VgaLastDisplayState;
+
+static BYTE VgaLineBuffer[VGA_MAX_LINE_WIDTH];
+static ULONGLONG VgaPlaneExpandTable[256];
+
+/* Refresh statistics */
+static LARGE_INTEGER VgaStatsStartTime;
+static ULONG VgaFrameCount = 0;
+static ULONG VgaRepaintCount = 0;
+static ULONG VgaConvertedLines = 0;
+static ULONGLONG VgaFrameTime = 0;
 
 
 
@@ -705,6 +746,7 @@ Quit:
 
     /* Trigger a full update of the screen */
     NeedsUpdate = TRUE;
+    VgaFullRefresh = TRUE;
     UpdateRectangle.Left = 0;
     UpdateRectangle.Top  = 0;
     UpdateRectangle.Right  = CurrResolution.X;
@@ -733,6 +775,101 @@ static inline VOID VgaMarkForUpdate(SHORT Row, SHORT Column)
     NeedsUpdate = TRUE;
 }
 
+static inline VOID VgaMarkMemoryDirty(DWORD Start, DWORD Size)
+{
+    DWORD Page, LastPage;
+
+    if ((Size == 0) || (Start >= sizeof(VgaMemory))) return;
+
+    LastPage = (min(Start + Size, sizeof(VgaMemory)) - 1) >> VGA_DIRTY_PAGE_SHIFT;
+    for (Page = Start >> VGA_DIRTY_PAGE_SHIFT; Page <= LastPage; Page++)
+    {
+        VgaDirtyPages[Page >> 5] |= 1UL << (Page & 0x1F);
+    }
+}
+
+static inline BOOLEAN VgaIsMemoryDirty(DWORD Start, DWORD End)
+{
+    DWORD Page;
+
+    /* Check every page between Start and End, inclusive */
+    for (Page = Start >> VGA_DIRTY_PAGE_SHIFT; Page <= (End >> VGA_DIRTY_PAGE_SHIFT); Page++)
+    {
+        if (VgaDirtyPages[Page >> 5] & (1UL << (Page & 0x1F))) return TRUE;
+    }
+
+    return FALSE;
+}
+
+static BOOLEAN VgaIsScanlineDirty(DWORD Address, DWORD AddressSize, DWORD Count, BOOLEAN Planar)
+{
+    DWORD Start, End;
+
+    /* The pixel panning can also reach the address before the scanline */
+    if (!Planar)
+    {
+        /* Packed pixel mode, the scanline is one linear range */
+        Start = (Address > 0) ? (Address - 1) : 0;
+        if (Start >= sizeof(VgaMemory)) return TRUE;
+        End = min(Address + Count, sizeof(VgaMemory)) - 1;
+
+        return VgaIsMemoryDirty(Start, End);
+    }
+
+    /* Count addresses, each one covering a byte in every plane */
+    Start = WRAP_OFFSET((Address - 1) * AddressSize) * VGA_NUM_BANKS;
+    End = WRAP_OFFSET((Address + Count - 1) * AddressSize) * VGA_NUM_BANKS + VGA_NUM_BANKS - 1;
+
+    if (Start <= End) return VgaIsMemoryDirty(Start, End);
+
+    /* The scanline wraps around the end of the memory */
+    return VgaIsMemoryDirty(Start, sizeof(VgaMemory) - 1) || VgaIsMemoryDirty(0, End);
+}
+
+static VOID VgaGetDisplayState(PVGA_DISPLAY_STATE State)
+{
+    RtlZeroMemory(State, sizeof(*State));
+
+    State->ScreenMode = ScreenMode;
+    State->Resolution = CurrResolution;
+    State->StartAddress = StartAddressLatch;
+    State->ScanlineSize = ScanlineSizeLatch;
+    State->SeqExtMode = VgaSeqRegisters[SVGA_SEQ_EXT_MODE_REG];
+
+    RtlCopyMemory(State->CrtcRegisters, VgaCrtcRegisters, sizeof(State->CrtcRegisters));
+    State->CrtcExtDisplay = VgaCrtcRegisters[SVGA_CRTC_EXT_DISPLAY_REG];
+
+    /* The console draws the cursor, so moving it doesn't change the framebuffer */
+    State->CrtcRegisters[VGA_CRTC_CURSOR_START_REG]    = 0;
+    State->CrtcRegisters[VGA_CRTC_CURSOR_END_REG]      = 0;
+    State->CrtcRegisters[VGA_CRTC_CURSOR_LOC_HIGH_REG] = 0;
+    State->CrtcRegisters[VGA_CRTC_CURSOR_LOC_LOW_REG]  = 0;
+
+    /* Only the shifting mode matters, not the write mode */
+    State->GcMode = VgaGcRegisters[VGA_GC_MODE_REG]
+                    & (VGA_GC_MODE_OE | VGA_GC_MODE_SHIFTREG | VGA_GC_MODE_SHIFT256);
+    State->GcMisc = VgaGcRegisters[VGA_GC_MISC_REG];
+
+    RtlCopyMemory(State->AcRegisters, VgaAcRegisters, sizeof(State->AcRegisters));
+    State->AcPalDisable = VgaAcPalDisable;
+}
+
+static VOID VgaInitializePlaneExpandTable(VOID)
+{
+    UINT i, j;
+
+    /* Byte j of each entry is bit (7 - j) of the index, i.e. one pixel per byte */
+    for (i = 0; i < ARRAYSIZE(VgaPlaneExpandTable); i++)
+    {
+        VgaPlaneExpandTable[i] = 0ULL;
+
+        for (j = 0; j < 8; j++)
+        {
+            if (i & (1 << (7 - j))) VgaPlaneExpandTable[i] |= 1ULL << (j * 8);
+        }
+    }
+}
+
 static VOID VgaUpdateFramebuffer(VOID)
 {
     SHORT i, j, k;
@@ -743,6 +880,8 @@ static VOID VgaUpdateFramebuffer(VOID)
                        | ((VgaCrtcRegisters[VGA_CRTC_OVERFLOW_REG] & VGA_CRTC_OVERFLOW_LC8) << 4)
                        | ((VgaCrtcRegisters[VGA_CRTC_MAX_SCAN_LINE_REG] & VGA_CRTC_MAXSCANLINE_LC9) << 3);
     BYTE PixelShift = VgaAcRegisters[VGA_AC_HORZ_PANNING_REG] & 0x0F;
+    VGA_DISPLAY_STATE DisplayState;
+    BOOLEAN FullRefresh;
 
     /*
      * If the console framebuffer is NULL, that means something
@@ -750,12 +889,26 @@ static VOID VgaUpdateFramebuffer(VOID)
      */
     if (ActiveFramebuffer == NULL) return;
 
+    /*
+     * Convert everything again if the way the VGA memory is displayed has
+     * changed, otherwise only the scanlines reading from dirty pages.
+     */
+    VgaGetDisplayState(&DisplayState);
+    FullRefresh = VgaFullRefresh
+                  || !RtlEqualMemory(&DisplayState, &VgaLastDisplayState, sizeof(DisplayState));
+    VgaLastDisplayState = DisplayState;
+    VgaFullRefresh = FALSE;
+
     /* Check if we are in text or graphics mode */
     if (ScreenMode == GRAPHICS_MODE)
     {
         /* Graphics mode */
         PBYTE GraphicsBuffer = (PBYTE)ActiveFramebuffer;
         DWORD InterlaceHighBit = VGA_INTERLACE_HIGH_BIT;
+        BOOLEAN Planar = !(VgaSeqRegisters[SVGA_SEQ_EXT_MODE_REG] & SVGA_SEQ_EXT_MODE_HIGH_RES);
+        BOOLEAN EightBit = !!(VgaAcRegisters[VGA_AC_CONTROL_REG] & VGA_AC_CONTROL_8BIT);
+        DWORD Count;
+        BYTE AttributeMap[VGA_AC_PAL_F_REG + 1];
         SHORT X;
 
         /*
@@ -781,6 +934,50 @@ static VOID VgaUpdateFramebuffer(VOID)
             LineCompare /= 1 + (VgaCrtcRegisters[VGA_CRTC_MAX_SCAN_LINE_REG] & 0x1F);
         }
 
+        if (!EightBit)
+        {
+            /*
+             * In 16 color mode, the value is an index to the AC registers
+             * if external palette access is disabled, otherwise (in case
+             * of palette loading) it is a blank pixel.
+             */
+            for (k = 0; k <= VGA_AC_PAL_F_REG; k++)
+            {
+                if (VgaAcPalDisable)
+                {
+                    if (!(VgaAcRegisters[VGA_AC_CONTROL_REG] & VGA_AC_CONTROL_P54S))
+                    {
+                        /* Bits 4 and 5 are taken from the palette register */
+                        AttributeMap[k] = ((VgaAcRegisters[VGA_AC_COLOR_SEL_REG] << 4) & 0xC0)
+                                          | (VgaAcRegisters[k] & 0x3F);
+                    }
+                    else
+                    {
+                        /* Bits 4 and 5 are taken from the color select register */
+                        AttributeMap[k] = (VgaAcRegisters[VGA_AC_COLOR_SEL_REG] << 4)
+                                          | (VgaAcRegisters[k] & 0x0F);
+                    }
+                }
+                else
+                {
+                    AttributeMap[k] = 0;
+                }
+            }
+        }
+
+        /*
+         * The number of addresses (or bytes, in packed pixel mode) read for
+         * each scanline, including the ones reached through the panning.
+         */
+        if (Planar)
+        {
+            Count = (CurrResolution.X + 8) / (EightBit ? 4 : 8) + 2;
+        }
+        else
+        {
+            Count = CurrResolution.X + 8;
+        }
+
         /* Loop through the scanlines */
         for (i = 0; i < CurrResolution.Y; i++)
         {
@@ -806,156 +1003,166 @@ static VOID VgaUpdateFramebuffer(VOID)
                 Address |= InterlaceHighBit;
             }
 
-            /* Loop through the pixels */
-            for (j = 0; j < CurrResolution.X; j++)
+            /* Skip the scanline if the memory it displays hasn't changed */
+            if (!FullRefresh
+                && !VgaIsScanlineDirty(Address, AddressSize, Count, Planar))
             {
-                BYTE PixelData = 0;
+                goto NextScanline;
+            }
 
-                /* Apply horizontal pixel panning */
-                if (VgaAcRegisters[VGA_AC_CONTROL_REG] & VGA_AC_CONTROL_8BIT)
-                {
-                    X = j + ((PixelShift >> 1) & 0x03);
-                }
-                else
-                {
-                    X = j + ((PixelShift < 8) ? PixelShift : -1);
-                }
+            VgaConvertedLines++;
 
-                if (VgaSeqRegisters[SVGA_SEQ_EXT_MODE_REG] & SVGA_SEQ_EXT_MODE_HIGH_RES)
+            if (Planar && !EightBit && (PixelShift == 0)
+                && !(VgaGcRegisters[VGA_GC_MODE_REG] & (VGA_GC_MODE_SHIFT256 | VGA_GC_MODE_SHIFTREG)))
+            {
+                /*
+                 * 4 bits per pixel, 1 on each plane, without panning.
+                 * Expand 8 pixels from each plane at once.
+                 */
+                for (j = 0; j < CurrResolution.X; j += 8)
                 {
-                    // TODO: Check for high color modes
+                    PBYTE PlaneData = &VgaMemory[WRAP_OFFSET((Address + (j >> 3)) * AddressSize) * VGA_NUM_BANKS];
 
-                    /* 256 color mode */
-                    PixelData = VgaMemory[Address + X];
+                    *(PULONGLONG)&VgaLineBuffer[j] = VgaPlaneExpandTable[PlaneData[0]]
+                                                     | (VgaPlaneExpandTable[PlaneData[1]] << 1)
+                                                     | (VgaPlaneExpandTable[PlaneData[2]] << 2)
+                                                     | (VgaPlaneExpandTable[PlaneData[3]] << 3);
                 }
-                else
+            }
+            else
+            {
+                /* Loop through the pixels */
+                for (j = 0; j < CurrResolution.X; j++)
                 {
-                    /* Check the shifting mode */
-                    if (VgaGcRegisters[VGA_GC_MODE_REG] & VGA_GC_MODE_SHIFT256)
+                    BYTE PixelData = 0;
+
+                    /* Apply horizontal pixel panning */
+                    if (VgaAcRegisters[VGA_AC_CONTROL_REG] & VGA_AC_CONTROL_8BIT)
+                    {
+                        X = j + ((PixelShift >> 1) & 0x03);
+                    }
+                    else
                     {
-                        /* 4 bits shifted from each plane */
+                        X = j + ((PixelShift < 8) ? PixelShift : -1);
+                    }
 
-                        /* Check if this is 16 or 256 color mode */
-                        if (VgaAcRegisters[VGA_AC_CONTROL_REG] & VGA_AC_CONTROL_8BIT)
-                        {
-                            /* One byte per pixel */
-                            PixelData = VgaMemory[WRAP_OFFSET((Address + (X / VGA_NUM_BANKS)) * AddressSize)
-                                                  * VGA_NUM_BANKS + (X % VGA_NUM_BANKS)];
-                        }
-                        else
-                        {
-                            /* 4-bits per pixel */
+                    if (VgaSeqRegisters[SVGA_SEQ_EXT_MODE_REG] & SVGA_SEQ_EXT_MODE_HIGH_RES)
+                    {
+                        // TODO: Check for high color modes
 
-                            PixelData = VgaMemory[WRAP_OFFSET((Address + (X / (VGA_NUM_BANKS * 2))) * AddressSize)
-                                                  * VGA_NUM_BANKS + ((X / 2) % VGA_NUM_BANKS)];
+                        /* 256 color mode */
+                        PixelData = VgaMemory[Address + X];
+                    }
+                    else
+                    {
+                        /* Check the shifting mode */
+                        if (VgaGcRegisters[VGA_GC_MODE_REG] & VGA_GC_MODE_SHIFT256)
+                        {
+                            /* 4 bits shifted from each plane */
 
-                            /* Check if we should use the highest 4 bits or lowest 4 */
-                            if ((X % 2) == 0)
+                            /* Check if this is 16 or 256 color mode */
+                            if (VgaAcRegisters[VGA_AC_CONTROL_REG] & VGA_AC_CONTROL_8BIT)
                             {
-                                /* Highest 4 */
-                                PixelData >>= 4;
+                                /* One byte per pixel */
+                                PixelData = VgaMemory[WRAP_OFFSET((Address + (X / VGA_NUM_BANKS)) * AddressSize)
+                                                      * VGA_NUM_BANKS + (X % VGA_NUM_BANKS)];
                             }
                             else
                             {
-                                /* Lowest 4 */
-                                PixelData &= 0x0F;
+                                /* 4-bits per pixel */
+
+                                PixelData = VgaMemory[WRAP_OFFSET((Address + (X / (VGA_NUM_BANKS * 2))) * AddressSize)
+                                                      * VGA_NUM_BANKS + ((X / 2) % VGA_NUM_BANKS)];
+
+                                /* Check if we should use the highest 4 bits or lowest 4 */
+                                if ((X % 2) == 0)
+                                {
+                                    /* Highest 4 */
+                                    PixelData >>= 4;
+                                }
+                                else
+                                {
+                                    /* Lowest 4 */
+                                    PixelData &= 0x0F;
+                                }
                             }
                         }
-                    }
-                    else if (VgaGcRegisters[VGA_GC_MODE_REG] & VGA_GC_MODE_SHIFTREG)
-                    {
-                        /* Check if this is 16 or 256 color mode */
-                        if (VgaAcRegisters[VGA_AC_CONTROL_REG] & VGA_AC_CONTROL_8BIT)
+                        else if (VgaGcRegisters[VGA_GC_MODE_REG] & VGA_GC_MODE_SHIFTREG)
                         {
-                            // TODO: NOT IMPLEMENTED
-                            DPRINT1("8-bit interleaved mode is not implemented!\n");
+                            /* Check if this is 16 or 256 color mode */
+                            if (VgaAcRegisters[VGA_AC_CONTROL_REG] & VGA_AC_CONTROL_8BIT)
+                            {
+                                // TODO: NOT IMPLEMENTED
+                                DPRINT1("8-bit interleaved mode is not implemented!\n");
+                            }
+                            else
+                            {
+                                /*
+                                 * 2 bits shifted from plane 0 and 2 for the first 4 pixels,
+                                 * then 2 bits shifted from plane 1 and 3 for the next 4
+                                 */
+                                DWORD BankNumber = (X / 4) % 2;
+                                DWORD Offset = Address + (X / 8);
+                                BYTE LowPlaneData = VgaMemory[WRAP_OFFSET(Offset * AddressSize) * VGA_NUM_BANKS + BankNumber];
+                                BYTE HighPlaneData = VgaMemory[WRAP_OFFSET(Offset * AddressSize) * VGA_NUM_BANKS + (BankNumber + 2)];
+
+                                /* Extract the two bits from each plane */
+                                LowPlaneData  = (LowPlaneData  >> (6 - ((X % 4) * 2))) & 0x03;
+                                HighPlaneData = (HighPlaneData >> (6 - ((X % 4) * 2))) & 0x03;
+
+                                /* Combine them into the pixel */
+                                PixelData = LowPlaneData | (HighPlaneData << 2);
+                            }
                         }
                         else
                         {
-                            /*
-                             * 2 bits shifted from plane 0 and 2 for the first 4 pixels,
-                             * then 2 bits shifted from plane 1 and 3 for the next 4
-                             */
-                            DWORD BankNumber = (X / 4) % 2;
-                            DWORD Offset = Address + (X / 8);
-                            BYTE LowPlaneData = VgaMemory[WRAP_OFFSET(Offset * AddressSize) * VGA_NUM_BANKS + BankNumber];
-                            BYTE HighPlaneData = VgaMemory[WRAP_OFFSET(Offset * AddressSize) * VGA_NUM_BANKS + (BankNumber + 2)];
-
-                            /* Extract the two bits from each plane */
-                            LowPlaneData  = (LowPlaneData  >> (6 - ((X % 4) * 2))) & 0x03;
-                            HighPlaneData = (HighPlaneData >> (6 - ((X % 4) * 2))) & 0x03;
-
-                            /* Combine them into the pixel */
-                            PixelData = LowPlaneData | (HighPlaneData << 2);
-                        }
-                    }
-                    else
-                    {
-                        /* 1 bit shifted from each plane */
-
-                        /* Check if this is 16 or 256 color mode */
-                        if (VgaAcRegisters[VGA_AC_CONTROL_REG] & VGA_AC_CONTROL_8BIT)
-                        {
-                            /* 8 bits per pixel, 2 on each plane */
+                            /* 1 bit shifted from each plane */
 
-                            for (k = 0; k < VGA_NUM_BANKS; k++)
+                            /* Check if this is 16 or 256 color mode */
+                            if (VgaAcRegisters[VGA_AC_CONTROL_REG] & VGA_AC_CONTROL_8BIT)
                             {
-                                /* The data is on plane k, 4 pixels per byte */
-                                BYTE PlaneData = VgaMemory[WRAP_OFFSET((Address + (X >> 2)) * AddressSize) * VGA_NUM_BANKS + k];
+                                /* 8 bits per pixel, 2 on each plane */
 
-                                /* The mask of the first bit in the pair */
-                                BYTE BitMask = 1 << (((3 - (X % VGA_NUM_BANKS)) * 2) + 1);
+                                for (k = 0; k < VGA_NUM_BANKS; k++)
+                                {
+                                    /* The data is on plane k, 4 pixels per byte */
+                                    BYTE PlaneData = VgaMemory[WRAP_OFFSET((Address + (X >> 2)) * AddressSize) * VGA_NUM_BANKS + k];
 
-                                /* Bits 0, 1, 2 and 3 come from the first bit of the pair */
-                                if (PlaneData & BitMask) PixelData |= 1 << k;
+                                    /* The mask of the first bit in the pair */
+                                    BYTE BitMask = 1 << (((3 - (X % VGA_NUM_BANKS)) * 2) + 1);
 
-                                /* Bits 4, 5, 6 and 7 come from the second bit of the pair */
-                                if (PlaneData & (BitMask >> 1)) PixelData |= 1 << (k + 4);
-                            }
-                        }
-                        else
-                        {
-                            /* 4 bits per pixel, 1 on each plane */
+                                    /* Bits 0, 1, 2 and 3 come from the first bit of the pair */
+                                    if (PlaneData & BitMask) PixelData |= 1 << k;
 
-                            for (k = 0; k < VGA_NUM_BANKS; k++)
+                                    /* Bits 4, 5, 6 and 7 come from the second bit of the pair */
+                                    if (PlaneData & (BitMask >> 1)) PixelData |= 1 << (k + 4);
+                                }
+                            }
+                            else
                             {
-                                BYTE PlaneData = VgaMemory[WRAP_OFFSET((Address + (X >> 3)) * AddressSize) * VGA_NUM_BANKS + k];
+                                /* 4 bits per pixel, 1 on each plane */
+
+                                for (k = 0; k < VGA_NUM_BANKS; k++)
+                                {
+                                    BYTE PlaneData = VgaMemory[WRAP_OFFSET((Address + (X >> 3)) * AddressSize) * VGA_NUM_BANKS + k];
 
-                                /* If the bit on that plane is set, set it */
-                                if (PlaneData & (1 << (7 - (X % 8)))) PixelData |= 1 << k;
+                                    /* If the bit on that plane is set, set it */
+                                    if (PlaneData & (1 << (7 - (X % 8)))) PixelData |= 1 << k;
+                                }
                             }
                         }
                     }
+
+                    VgaLineBuffer[j] = PixelData;
                 }
+            }
 
-                if (!(VgaAcRegisters[VGA_AC_CONTROL_REG] & VGA_AC_CONTROL_8BIT))
-                {
-                    /*
-                     * In 16 color mode, the value is an index to the AC registers
-                     * if external palette access is disabled, otherwise (in case
-                     * of palette loading) it is a blank pixel.
-                     */
+            /* Loop through the converted pixels */
+            for (j = 0; j < CurrResolution.X; j++)
+            {
+                BYTE PixelData = VgaLineBuffer[j];
 
-                    if (VgaAcPalDisable)
-                    {
-                        if (!(VgaAcRegisters[VGA_AC_CONTROL_REG] & VGA_AC_CONTROL_P54S))
-                        {
-                            /* Bits 4 and 5 are taken from the palette register */
-                            PixelData = ((VgaAcRegisters[VGA_AC_COLOR_SEL_REG] << 4) & 0xC0)
-                                        | (VgaAcRegisters[PixelData & 0x0F] & 0x3F);
-                        }
-                        else
-                        {
-                            /* Bits 4 and 5 are taken from the color select register */
-                            PixelData = (VgaAcRegisters[VGA_AC_COLOR_SEL_REG] << 4)
-                                        | (VgaAcRegisters[PixelData & 0x0F] & 0x0F);
-                        }
-                    }
-                    else
-                    {
-                        PixelData = 0;
-                    }
-                }
+                if (!EightBit) PixelData = AttributeMap[PixelData & 0x0F];
 
                 /* Take into account DoubleVision mode when checking for pixel updates */
                 if (DoubleWidth && DoubleHeight)
@@ -1013,6 +1220,7 @@ static VOID VgaUpdateFramebuffer(VOID)
                 }
             }
 
+NextScanline:
             if ((VgaGcRegisters[VGA_GC_MISC_REG] & VGA_GC_MISC_OE) && (i & 1))
             {
                 /* Clear the high bit */
@@ -1048,6 +1256,16 @@ static VOID VgaUpdateFramebuffer(VOID)
         /* Loop through the scanlines */
         for (i = 0; i < CurrResolution.Y; i++)
         {
+            /* Skip the scanline if the memory it displays hasn't changed */
+            if (!FullRefresh
+                && !VgaIsScanlineDirty(Address, AddressSize, CurrResolution.X + 1, TRUE))
+            {
+                Address += ScanlineSizeLatch;
+                continue;
+            }
+
+            VgaConvertedLines++;
+
             /* Loop through the characters */
             for (j = 0; j < CurrResolution.X; j++)
             {
@@ -1075,6 +1293,9 @@ static VOID VgaUpdateFramebuffer(VOID)
             Address += ScanlineSizeLatch;
         }
     }
+
+    /* Everything displayed is up to date now */
+    RtlZeroMemory(VgaDirtyPages, sizeof(VgaDirtyPages));
 }
 
 static VOID VgaUpdateTextCursor(VOID)
@@ -1612,6 +1833,10 @@ static VOID WINAPI VgaWritePort(USHORT Port, BYTE Data)
 
 static inline VOID VgaVerticalRetrace(VOID)
 {
+    LARGE_INTEGER StartTime, EndTime, Frequency;
+
+    NtQueryPerformanceCounter(&StartTime, NULL);
+
     /* If nothing has changed, just return */
     // if (!ModeChanged && !CursorChanged && !PaletteChanged && !NeedsUpdate)
         // return;
@@ -1637,19 +1862,39 @@ static inline VOID VgaVerticalRetrace(VOID)
     /* Update the contents of the framebuffer */
     VgaUpdateFramebuffer();
 
-    /* Ignore if there's nothing to update */
-    if (!NeedsUpdate) return;
+    /* Repaint the changed part of the screen, if any */
+    if (NeedsUpdate)
+    {
+        DPRINT("Updating screen rectangle (%d, %d, %d, %d)\n",
+               UpdateRectangle.Left,
+               UpdateRectangle.Top,
+               UpdateRectangle.Right,
+               UpdateRectangle.Bottom);
+
+        VgaConsoleRepaintScreen(&UpdateRectangle);
 
-    DPRINT("Updating screen rectangle (%d, %d, %d, %d)\n",
-           UpdateRectangle.Left,
-           UpdateRectangle.Top,
-           UpdateRectangle.Right,
-           UpdateRectangle.Bottom);
+        /* Clear the update flag */
+        NeedsUpdate = FALSE;
+        VgaRepaintCount++;
+    }
 
-    VgaConsoleRepaintScreen(&UpdateRectangle);
+    /* Update the refresh statistics */
+    NtQueryPerformanceCounter(&EndTime, &Frequency);
+    VgaFrameCount++;
+    VgaFrameTime += EndTime.QuadPart - StartTime.QuadPart;
 
-    /* Clear the update flag */
-    NeedsUpdate = FALSE;
+    if (EndTime.QuadPart - VgaStatsStartTime.QuadPart >= Frequency.QuadPart)
+    {
+        DPRINT("VGA: %lu frames/s, %lu repainted, %lu scanlines converted, %I64u us per frame\n",
+               VgaFrameCount,
+               VgaRepaintCount,
+               VgaConvertedLines,
+               VgaFrameTime * 1000000ULL / Frequency.QuadPart / VgaFrameCount);
+
+        VgaStatsStartTime = EndTime;
+        VgaFrameCount = VgaRepaintCount = VgaConvertedLines = 0;
+        VgaFrameTime = 0ULL;
+    }
 }
 
 static VOID FASTCALL VgaHorizontalRetrace(ULONGLONG ElapsedTime)
@@ -1796,6 +2041,9 @@ VOID VgaRefreshDisplay(VOID)
                         + (VgaCrtcRegisters[VGA_CRTC_PRESET_ROW_SCAN_REG] & 0x1F) * ScanlineSizeLatch
                         + ((VgaCrtcRegisters[VGA_CRTC_PRESET_ROW_SCAN_REG] >> 5) & 3);
 
+    /* Convert the whole VGA memory again */
+    VgaFullRefresh = TRUE;
+
     VgaVerticalRetrace();
 }
 
@@ -2028,6 +2276,8 @@ BOOLEAN FASTCALL VgaWriteMemory(ULONG Address, PVOID Buffer, ULONG Size)
                 /* Copy the value to the VGA memory */
                 VgaMemory[VideoAddress * VGA_NUM_BANKS + j] = VgaTranslateByteForWriting(BufPtr[i], j);
             }
+
+            VgaMarkMemoryDirty(VideoAddress * VGA_NUM_BANKS, VGA_NUM_BANKS);
         }
     }
     else
@@ -2040,6 +2290,7 @@ BOOLEAN FASTCALL VgaWriteMemory(ULONG Address, PVOID Buffer, ULONG Size)
         /* Just copy to the video memory */
         VideoAddress = VgaTranslateAddress(Address);
         VideoMemory = &VgaMemory[VideoAddress + (Address & 3)];
+        VgaMarkMemoryDirty(VideoAddress + (Address & 3), Size);
 
         switch (Size)
         {
@@ -2074,6 +2325,7 @@ BOOLEAN FASTCALL VgaWriteMemory(ULONG Address, PVOID Buffer, ULONG Size)
 VOID VgaClearMemory(VOID)
 {
     RtlZeroMemory(VgaMemory, sizeof(VgaMemory));
+    VgaFullRefresh = TRUE;
 }
 
 VOID VgaWriteTextModeFont(UINT FontNumber, CONST UCHAR* FontData, UINT Height)
@@ -2095,6 +2347,8 @@ VOID VgaWriteTextModeFont(UINT FontNumber, CONST UCHAR* FontData, UINT Height)
             VgaMemory[(i * VGA_MAX_FONT_HEIGHT + j) * VGA_NUM_BANKS + VGA_FONT_BANK] = 0;
         }
     }
+
+    VgaFullRefresh = TRUE;
 }
 
 BOOLEAN VgaInitialize(HANDLE TextHandle)
@@ -2117,6 +2371,10 @@ BOOLEAN VgaInitialize(HANDLE TextHandle)
     /* Clear the VGA memory */
     VgaClearMemory();
 
+    /* Prepare the planar to packed pixel conversion */
+    VgaInitializePlaneExpandTable();
+    NtQueryPerformanceCounter(&VgaStatsStartTime, NULL);
+
     /* Register the I/O Ports */
     RegisterIoPort(0x3CC, VgaReadPort,         NULL);   // VGA_MISC_READ
     RegisterIoPort(0x3C2, VgaReadPort, VgaWritePort);   // VGA_MISC_WRITE, VGA_INSTAT0_READ
@@ -11,6 +11,10 @@
 
 #include <win32k.h>
 
+#ifdef _M_AMD64
+#include <emmintrin.h>
+#endif
+
 #define NDEBUG
 #include <debug.h>
 
@@ -759,6 +763,112 @@ Clamp8(ULONG val)
   return (val > 255) ? 255 : (UCHAR)val;
 }
 
+/*
+ * Blends one row of 32bpp source pixels that need no translation, with the
+ * same integer arithmetic as the per-pixel loop in DIB_32BPP_AlphaBlend.
+ * x / 255 is computed as (x + 1 + (x >> 8)) >> 8, which is exact for every
+ * product of two bytes, and the final pack saturates like Clamp8 does.
+ * Only x64 kernel code may use the XMM registers without saving them first,
+ * so the SSE2 kernel is limited to that architecture.
+ */
+static VOID
+DIB_32BPP_AlphaBlendRow(PULONG Dst, PULONG Src, LONG Count,
+                        BLENDFUNCTION BlendFunc)
+{
+  NICEPIXEL32 DstPixel, SrcPixel;
+  ULONG ConstAlpha = BlendFunc.SourceConstantAlpha;
+  BOOLEAN PerPixelAlpha = (BlendFunc.AlphaFormat & AC_SRC_ALPHA) != 0;
+  ULONG Alpha;
+  LONG i = 0;
+
+#ifdef _M_AMD64
+  __m128i Zero = _mm_setzero_si128();
+  __m128i One = _mm_set1_epi16(1);
+  __m128i Max = _mm_set1_epi16(255);
+  __m128i Constant = _mm_set1_epi16((SHORT)ConstAlpha);
+  __m128i Source, Dest, SrcLo, SrcHi, DstLo, DstHi, InvLo, InvHi;
+
+#define DIV255(x) \
+  _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16((x), One), _mm_srli_epi16((x), 8)), 8)
+#define BROADCAST_ALPHA(x) \
+  _mm_shufflehi_epi16(_mm_shufflelo_epi16((x), 0xFF), 0xFF)
+
+  for (; i + 4 <= Count; i += 4)
+  {
+    Source = _mm_loadu_si128((__m128i *)&Src[i]);
+    if (PerPixelAlpha && ConstAlpha == 255)
+    {
+      /* Runs of opaque or fully transparent premultiplied pixels are common */
+      if ((_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_srli_epi32(Source, 24),
+                                             _mm_set1_epi32(255))) & 0xFFFF) == 0xFFFF)
+      {
+        _mm_storeu_si128((__m128i *)&Dst[i], Source);
+        continue;
+      }
+      if (_mm_movemask_epi8(_mm_cmpeq_epi32(Source, Zero)) == 0xFFFF)
+        continue;
+    }
+
+    SrcLo = _mm_unpacklo_epi8(Source, Zero);
+    SrcHi = _mm_unpackhi_epi8(Source, Zero);
+    if (ConstAlpha != 255)
+    {
+      SrcLo = _mm_mullo_epi16(SrcLo, Constant);
+      SrcLo = DIV255(SrcLo);
+      SrcHi = _mm_mullo_epi16(SrcHi, Constant);
+      SrcHi = DIV255(SrcHi);
+    }
+    if (PerPixelAlpha)
+    {
+      InvLo = _mm_sub_epi16(Max, BROADCAST_ALPHA(SrcLo));
+      InvHi = _mm_sub_epi16(Max, BROADCAST_ALPHA(SrcHi));
+    }
+    else
+    {
+      InvLo = InvHi = _mm_sub_epi16(Max, Constant);
+    }
+
+    Dest = _mm_loadu_si128((__m128i *)&Dst[i]);
+    DstLo = _mm_mullo_epi16(_mm_unpacklo_epi8(Dest, Zero), InvLo);
+    DstLo = _mm_add_epi16(DIV255(DstLo), SrcLo);
+    DstHi = _mm_mullo_epi16(_mm_unpackhi_epi8(Dest, Zero), InvHi);
+    DstHi = _mm_add_epi16(DIV255(DstHi), SrcHi);
+    _mm_storeu_si128((__m128i *)&Dst[i], _mm_packus_epi16(DstLo, DstHi));
+  }
+
+#undef BROADCAST_ALPHA
+#undef DIV255
+#endif
+
+  for (; i < Count; i++)
+  {
+    SrcPixel.ul = Src[i];
+    if (ConstAlpha != 255)
+    {
+      SrcPixel.col.red = (SrcPixel.col.red * ConstAlpha) / 255;
+      SrcPixel.col.green = (SrcPixel.col.green * ConstAlpha) / 255;
+      SrcPixel.col.blue = (SrcPixel.col.blue * ConstAlpha) / 255;
+      SrcPixel.col.alpha = (SrcPixel.col.alpha * ConstAlpha) / 255;
+    }
+    Alpha = PerPixelAlpha ? SrcPixel.col.alpha : ConstAlpha;
+
+    if (Alpha == 255)
+    {
+      Dst[i] = SrcPixel.ul;
+      continue;
+    }
+    if (PerPixelAlpha && SrcPixel.ul == 0)
+      continue;
+
+    DstPixel.ul = Dst[i];
+    DstPixel.col.red = Clamp8((DstPixel.col.red * (255 - Alpha)) / 255 + SrcPixel.col.red);
+    DstPixel.col.green = Clamp8((DstPixel.col.green * (255 - Alpha)) / 255 + SrcPixel.col.green);
+    DstPixel.col.blue = Clamp8((DstPixel.col.blue * (255 - Alpha)) / 255 + SrcPixel.col.blue);
+    DstPixel.col.alpha = Clamp8((DstPixel.col.alpha * (255 - Alpha)) / 255 + SrcPixel.col.alpha);
+    Dst[i] = DstPixel.ul;
+  }
+}
+
 BOOLEAN
 DIB_32BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
                      RECTL* SourceRect, CLIPOBJ* ClipRegion,
@@ -801,6 +911,24 @@ DIB_32BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
     (DestRect->left << 2));
   SrcBpp = BitsPerFormat(Source->iBitmapFormat);
 
+  /* Unstretched 32bpp sources with nothing to translate blend row by row */
+  if (SrcBpp == 32 &&
+      (ColorTranslation == NULL || (ColorTranslation->flXlate & XO_TRIVIAL) != 0) &&
+      SourceRect->right - SourceRect->left == DestRect->right - DestRect->left &&
+      SourceRect->bottom - SourceRect->top == DestRect->bottom - DestRect->top)
+  {
+    for (SrcY = SourceRect->top; SrcY < SourceRect->bottom; SrcY++)
+    {
+      DIB_32BPP_AlphaBlendRow(Dst,
+                              (PULONG)((ULONG_PTR)Source->pvScan0 + SrcY * Source->lDelta +
+                                       (SourceRect->left << 2)),
+                              DestRect->right - DestRect->left,
+                              BlendFunc);
+      Dst = (PULONG)((ULONG_PTR)Dst + Dest->lDelta);
+    }
+    return TRUE;
+  }
+
   Rows = 0;
    SrcY = SourceRect->top;
    while (++Rows <= DestRect->bottom - DestRect->top)
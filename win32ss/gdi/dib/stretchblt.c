@@ -14,6 +14,109 @@
 #define NDEBUG
 #include <debug.h>
 
+/*
+ * SRCCOPY between two surfaces of the same 16, 24 or 32bpp format with an
+ * identity translation. Source coordinates are stepped with the quotient
+ * and remainder of SrcWidth / DstWidth, which yields exactly the pixels the
+ * generic loop below picks, and a destination row whose source row did not
+ * change is copied from the row above instead of being sampled again.
+ */
+static BOOLEAN
+DIB_StretchBltSrcCopy(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
+                      RECTL *DestRect, RECTL *SourceRect)
+{
+  LONG DstWidth = DestRect->right - DestRect->left;
+  LONG DstHeight = DestRect->bottom - DestRect->top;
+  LONG SrcWidth = SourceRect->right - SourceRect->left;
+  LONG SrcHeight = SourceRect->bottom - SourceRect->top;
+  ULONG BytesPerPixel = BitsPerFormat(DestSurf->iBitmapFormat) >> 3;
+  LONG XStep = SrcWidth / DstWidth, XRemStep = SrcWidth % DstWidth;
+  LONG YStep = SrcHeight / DstHeight, YRemStep = SrcHeight % DstHeight;
+  LONG DesX, DesY, sx, sy, LastSy, XRem, YRem;
+  PBYTE DestLine, PrevDestLine = NULL, SourceLine, SourceBits;
+
+  DestLine = (PBYTE)DestSurf->pvScan0 + DestRect->top * DestSurf->lDelta +
+             DestRect->left * BytesPerPixel;
+  sy = SourceRect->top;
+  YRem = 0;
+  LastSy = -1;
+
+  for (DesY = 0; DesY < DstHeight; DesY++)
+  {
+    if (sy == LastSy)
+    {
+      RtlCopyMemory(DestLine, PrevDestLine, DstWidth * BytesPerPixel);
+    }
+    else
+    {
+      SourceLine = (PBYTE)SourceSurf->pvScan0 + sy * SourceSurf->lDelta;
+      sx = SourceRect->left;
+      XRem = 0;
+
+      switch (BytesPerPixel)
+      {
+      case 2:
+        for (DesX = 0; DesX < DstWidth; DesX++)
+        {
+          ((PUSHORT)DestLine)[DesX] = ((PUSHORT)SourceLine)[sx];
+          sx += XStep;
+          XRem += XRemStep;
+          if (XRem >= DstWidth)
+          {
+            XRem -= DstWidth;
+            sx++;
+          }
+        }
+        break;
+
+      case 3:
+        for (DesX = 0; DesX < DstWidth; DesX++)
+        {
+          SourceBits = SourceLine + sx * 3;
+          DestLine[DesX * 3] = SourceBits[0];
+          DestLine[DesX * 3 + 1] = SourceBits[1];
+          DestLine[DesX * 3 + 2] = SourceBits[2];
+          sx += XStep;
+          XRem += XRemStep;
+          if (XRem >= DstWidth)
+          {
+            XRem -= DstWidth;
+            sx++;
+          }
+        }
+        break;
+
+      default:
+        for (DesX = 0; DesX < DstWidth; DesX++)
+        {
+          ((PULONG)DestLine)[DesX] = ((PULONG)SourceLine)[sx];
+          sx += XStep;
+          XRem += XRemStep;
+          if (XRem >= DstWidth)
+          {
+            XRem -= DstWidth;
+            sx++;
+          }
+        }
+        break;
+      }
+      LastSy = sy;
+    }
+
+    PrevDestLine = DestLine;
+    DestLine += DestSurf->lDelta;
+    sy += YStep;
+    YRem += YRemStep;
+    if (YRem >= DstHeight)
+    {
+      YRem -= DstHeight;
+      sy++;
+    }
+  }
+
+  return TRUE;
+}
+
 BOOLEAN DIB_XXBPP_StretchBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf, SURFOBJ *MaskSurf,
                             SURFOBJ *PatternSurface,
                             RECTL *DestRect, RECTL *SourceRect,
@@ -63,6 +166,21 @@ BOOLEAN DIB_XXBPP_StretchBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf, SURFOBJ *Ma
   SrcHeight = SourceRect->bottom - SourceRect->top;
   SrcWidth = SourceRect->right - SourceRect->left;
 
+  /* Plain unmirrored copies between identical formats take the fast path */
+  if (ROP == ROP4_SRCCOPY && MaskSurf == NULL && SourceSurf != DestSurf &&
+      SourceSurf->iBitmapFormat == DestSurf->iBitmapFormat &&
+      (DestSurf->iBitmapFormat == BMF_16BPP ||
+       DestSurf->iBitmapFormat == BMF_24BPP ||
+       DestSurf->iBitmapFormat == BMF_32BPP) &&
+      (ColorTranslation == NULL || (ColorTranslation->flXlate & XO_TRIVIAL) != 0) &&
+      DstWidth > 0 && DstHeight > 0 && SrcWidth > 0 && SrcHeight > 0 &&
+      SourceRect->left >= 0 && SourceRect->top >= 0 &&
+      SourceRect->right <= SourceSurf->sizlBitmap.cx &&
+      SourceRect->bottom <= SourceSurf->sizlBitmap.cy)
+  {
+    return DIB_StretchBltSrcCopy(DestSurf, SourceSurf, DestRect, SourceRect);
+  }
+
   /* Here we do the tests and set our conditions */
   if (((SrcWidth < 0) && (DstWidth < 0)) || ((SrcWidth >= 0) && (DstWidth >= 0)))
     bLeftToRight = FALSE;
@@ -15,6 +15,7 @@ extern PGDI_SHARED_HANDLE_TABLE GdiSharedHandleTable;
 extern HANDLE hProcessHeap;
 extern HANDLE CurrentProcessId;
 extern DWORD GDI_BatchLimit;
+extern DWORD GDI_BatchFlushLimit;
 extern PDEVCAPS GdiDevCaps;
 extern BOOL gbLpk;          // Global bool LanguagePack
 extern HANDLE ghSpooler;
@@ -376,6 +377,9 @@ int FASTCALL DocumentEventEx(PVOID,HANDLE,HDC,int,ULONG,PVOID,ULONG,PVOID);
 BOOL FASTCALL EndPagePrinterEx(PVOID,HANDLE);
 BOOL FASTCALL LoadTheSpoolerDrv(VOID);
 
+/* The most entries of the smallest command that fit in the batch buffer */
+#define GDI_BATCH_MAX_LIMIT ((DWORD)(GDIBATCHBUFSIZE / sizeof(GDIBSOBJECT)))
+
 FORCEINLINE
 PVOID
 GdiAllocBatchCommand(
@@ -402,6 +406,11 @@ GdiAllocBatchCommand(
     else if (Cmd == GdiBCSelObj) cjSize = sizeof(GDIBSOBJECT);
     else if (Cmd == GdiBCDelRgn) cjSize = sizeof(GDIBSOBJECT);
     else if (Cmd == GdiBCDelObj) cjSize = sizeof(GDIBSOBJECT);
+    else if (Cmd == GdiBCLineTo) cjSize = sizeof(GDIBSLINETO);
+    else if (Cmd == GdiBCPolyline) cjSize = sizeof(GDIBSPOLYLINE);
+    else if (Cmd == GdiBCRectangle) cjSize = sizeof(GDIBSRECTANGLE);
+    else if (Cmd == GdiBCSetPixel) cjSize = sizeof(GDIBSSETPIXEL);
+    else if (Cmd == GdiBCBitBlt) cjSize = sizeof(GDIBSBITBLT);
     else cjSize = 0;
 
     /* Unsupported operation */
@@ -418,9 +427,19 @@ GdiAllocBatchCommand(
     }
 
     /* Check if the buffer is full */
-    if ((pTeb->GdiBatchCount >= GDI_BatchLimit) ||
+    if ((pTeb->GdiBatchCount >= GDI_BatchFlushLimit) ||
         ((pTeb->GdiTebBatch.Offset + cjSize) > GDIBATCHBUFSIZE))
     {
+        /* The buffer in the TEB has a fixed size. If a batch of small commands
+           ran out of entries with most of it still free, let the following
+           ones hold more, unless the application set a limit of its own */
+        if ((pTeb->GdiBatchCount >= GDI_BatchFlushLimit) &&
+            (pTeb->GdiTebBatch.Offset < GDIBATCHBUFSIZE / 2) &&
+            (GDI_BatchLimit == GDI_BATCH_LIMIT))
+        {
+            GDI_BatchFlushLimit = min(GDI_BatchFlushLimit * 2, GDI_BATCH_MAX_LIMIT);
+        }
+
         /* Call win32k, the kernel will call NtGdiFlushUserBatch to flush
            the current batch */
         NtGdiFlush();
@@ -55,6 +55,7 @@ GdiProcessSetup(VOID)
         GdiDevCaps = &GdiSharedHandleTable->DevCaps;
         CurrentProcessId = NtCurrentTeb()->ClientId.UniqueProcess;
         GDI_BatchLimit = (DWORD) NtCurrentTeb()->ProcessEnvironmentBlock->GdiDCAttributeList;
+        GDI_BatchFlushLimit = GDI_BatchLimit;
         GdiHandleCache = (PGDIHANDLECACHE)NtCurrentTeb()->ProcessEnvironmentBlock->GdiHandleBuffer;
         RtlInitializeCriticalSection(&semLocal);
         InitializeCriticalSection(&gcsClientObjLinks);
@@ -34,6 +34,7 @@ PGDI_TABLE_ENTRY GdiHandleTable = NULL;
 PGDI_SHARED_HANDLE_TABLE GdiSharedHandleTable = NULL;
 HANDLE CurrentProcessId = NULL;
 DWORD GDI_BatchLimit = 1;
+DWORD GDI_BatchFlushLimit = 1;
 extern PGDIHANDLECACHE GdiHandleCache;
 
 /*
@@ -850,6 +851,7 @@ GdiSetBatchLimit(DWORD	Limit)
 
     GdiFlush();
     GDI_BatchLimit = Limit;
+    GDI_BatchFlushLimit = Limit;
     return OldLimit;
 }
 
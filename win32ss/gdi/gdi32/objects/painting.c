@@ -1,5 +1,25 @@
 #include <precomp.h>
 
+/* Records the DC attributes a batched line or shape command draws with */
+static
+VOID
+GdiBatchDcAttr(
+    _Out_ PGDIBSDCATTR pAttr,
+    _In_ PDC_ATTR pdcattr)
+{
+    pAttr->hbrush          = pdcattr->hbrush;
+    pAttr->hpen            = pdcattr->hpen;
+    pAttr->crForegroundClr = pdcattr->crForegroundClr;
+    pAttr->crBackgroundClr = pdcattr->crBackgroundClr;
+    pAttr->crBrushClr      = pdcattr->crBrushClr;
+    pAttr->crPenClr        = pdcattr->crPenClr;
+    pAttr->ulForegroundClr = pdcattr->ulForegroundClr;
+    pAttr->ulBackgroundClr = pdcattr->ulBackgroundClr;
+    pAttr->ulBrushClr      = pdcattr->ulBrushClr;
+    pAttr->ulPenClr        = pdcattr->ulPenClr;
+    pAttr->lBkMode         = pdcattr->lBkMode;
+    pAttr->jBkMode         = pdcattr->jBkMode;
+}
 
 /*
  * @implemented
@@ -11,10 +31,37 @@ LineTo(
     _In_ INT x,
     _In_ INT y )
 {
+    PDC_ATTR pdcattr;
+
     HANDLE_METADC(BOOL, LineTo, FALSE, hdc, x, y);
 
     if ( GdiConvertAndCheckDC(hdc) == NULL ) return FALSE;
 
+    /* Get the DC attribute, the start point is only known here while the
+       logical current position is valid */
+    pdcattr = GdiGetDcAttr(hdc);
+    if (pdcattr &&
+        !(pdcattr->ulDirty_ & (DC_DIBSECTION|DIRTY_PTLCURRENT)))
+    {
+        PGDIBSLINETO pgO;
+
+        pgO = GdiAllocBatchCommand(hdc, GdiBCLineTo);
+        if (pgO)
+        {
+            pdcattr->ulDirty_ |= DC_MODE_DIRTY;
+            pgO->ptlStart = pdcattr->ptlCurrent;
+            pgO->ptlEnd.x = x;
+            pgO->ptlEnd.y = y;
+            GdiBatchDcAttr(&pgO->Attr, pdcattr);
+
+            /* Move the current position like MoveToEx does */
+            pdcattr->ptlCurrent.x = x;
+            pdcattr->ptlCurrent.y = y;
+            pdcattr->ulDirty_ |= (DIRTY_PTFXCURRENT|DIRTY_STYLESTATE);
+            return TRUE;
+        }
+    }
+
     return NtGdiLineTo(hdc, x, y);
 }
 
@@ -95,10 +142,31 @@ Rectangle(
     _In_ INT right,
     _In_ INT bottom)
 {
+    PDC_ATTR pdcattr;
+
     HANDLE_METADC(BOOL, Rectangle, FALSE, hdc, left, top, right, bottom);
 
     if ( GdiConvertAndCheckDC(hdc) == NULL ) return FALSE;
 
+    /* Get the DC attribute */
+    pdcattr = GdiGetDcAttr(hdc);
+    if (pdcattr && !(pdcattr->ulDirty_ & DC_DIBSECTION))
+    {
+        PGDIBSRECTANGLE pgO;
+
+        pgO = GdiAllocBatchCommand(hdc, GdiBCRectangle);
+        if (pgO)
+        {
+            pdcattr->ulDirty_ |= DC_MODE_DIRTY;
+            pgO->rcl.left   = left;
+            pgO->rcl.top    = top;
+            pgO->rcl.right  = right;
+            pgO->rcl.bottom = bottom;
+            GdiBatchDcAttr(&pgO->Attr, pdcattr);
+            return TRUE;
+        }
+    }
+
     return NtGdiRectangle(hdc, left, top, right, bottom);
 }
 
@@ -171,7 +239,34 @@ SetPixelV(
     _In_ INT y,
     _In_ COLORREF crColor)
 {
-    return SetPixel(hdc, x, y, crColor) != CLR_INVALID;
+    PDC_ATTR pdcattr;
+
+    /* Meta DCs go the way of SetPixel */
+    if (GDI_HANDLE_GET_TYPE(hdc) != GDILoObjType_LO_DC_TYPE)
+    {
+        return SetPixel(hdc, x, y, crColor) != CLR_INVALID;
+    }
+
+    if ( GdiConvertAndCheckDC(hdc) == NULL ) return FALSE;
+
+    /* Unlike SetPixel there is no color to return, so this can wait */
+    pdcattr = GdiGetDcAttr(hdc);
+    if (pdcattr && !(pdcattr->ulDirty_ & DC_DIBSECTION))
+    {
+        PGDIBSSETPIXEL pgO;
+
+        pgO = GdiAllocBatchCommand(hdc, GdiBCSetPixel);
+        if (pgO)
+        {
+            pdcattr->ulDirty_ |= DC_MODE_DIRTY;
+            pgO->x = x;
+            pgO->y = y;
+            pgO->crColor = crColor;
+            return TRUE;
+        }
+    }
+
+    return NtGdiSetPixel(hdc, x, y, crColor) != CLR_INVALID;
 }
 
 
@@ -338,10 +433,42 @@ Polyline(
     _In_reads_(cpt) const POINT *apt,
     _In_ INT cpt)
 {
+    PDC_ATTR pdcattr;
+
     HANDLE_METADC(BOOL, Polyline, FALSE, hdc, apt, cpt);
 
     if ( GdiConvertAndCheckDC(hdc) == NULL ) return FALSE;
 
+    /* Get the DC attribute */
+    pdcattr = GdiGetDcAttr(hdc);
+    if (apt && cpt >= 2 && (ULONG)cpt < GDIBATCHBUFSIZE / sizeof(POINT) &&
+        pdcattr && !(pdcattr->ulDirty_ & DC_DIBSECTION))
+    {
+        PGDIBSPOLYLINE pgO;
+        PTEB pTeb = NtCurrentTeb();
+
+        pgO = GdiAllocBatchCommand(hdc, GdiBCPolyline);
+        if (pgO)
+        {
+            USHORT cjSize = (cpt - 1) * sizeof(POINT);
+
+            if ((pTeb->GdiTebBatch.Offset + cjSize) <= GDIBATCHBUFSIZE)
+            {
+                pdcattr->ulDirty_ |= DC_MODE_DIRTY;
+                pgO->Count = cpt;
+                GdiBatchDcAttr(&pgO->Attr, pdcattr);
+                RtlCopyMemory(pgO->apt, apt, cpt * sizeof(POINT));
+                // Recompute offset and return size, remember one is already accounted for in the structure.
+                pTeb->GdiTebBatch.Offset += cjSize;
+                ((PGDIBATCHHDR)pgO)->Size += cjSize;
+                return TRUE;
+            }
+            // Reset offset and count then fall through
+            pTeb->GdiTebBatch.Offset -= sizeof(GDIBSPOLYLINE);
+            pTeb->GdiBatchCount--;
+        }
+    }
+
     return NtGdiPolyPolyDraw(hdc, (PPOINT)apt, (PULONG)&cpt, 1, GdiPolyPolyLine);
 }
 
@@ -455,6 +582,8 @@ BitBlt(
     _In_ INT ySrc,
     _In_ DWORD dwRop)
 {
+    PDC_ATTR pdcattr;
+
     /* Use PatBlt for no source blt, like windows does */
     if (!ROP_USES_SOURCE(dwRop))
     {
@@ -477,6 +606,38 @@ BitBlt(
 
     if ( GdiConvertAndCheckDC(hdcDest) == NULL ) return FALSE;
 
+    /* Get the DC attribute. Only blts within one DC are batched, win32k
+       would have to lock a second DC out of order otherwise. Nothing may
+       read or write the bits of a DIB section behind a batched blt, and the
+       mapping must be one the command can carry */
+    pdcattr = GdiGetDcAttr(hdcDest);
+    if (hdcSrc == hdcDest &&
+        pdcattr && !(pdcattr->ulDirty_ & DC_DIBSECTION) &&
+        (pdcattr->iMapMode == MM_TEXT) &&
+        (pdcattr->iGraphicsMode == GM_COMPATIBLE))
+    {
+        PGDIBSBITBLT pgO;
+
+        pgO = GdiAllocBatchCommand(hdcDest, GdiBCBitBlt);
+        if (pgO)
+        {
+            pdcattr->ulDirty_ |= DC_MODE_DIRTY;
+            pgO->xDest  = xDest;
+            pgO->yDest  = yDest;
+            pgO->cx     = cx;
+            pgO->cy     = cy;
+            pgO->hdcSrc = hdcSrc;
+            pgO->xSrc   = xSrc;
+            pgO->ySrc   = ySrc;
+            pgO->dwRop  = dwRop;
+            /* Snapshot attributes */
+            pgO->ptlWindowOrg   = pdcattr->ptlWindowOrg;
+            pgO->ptlViewportOrg = pdcattr->ptlViewportOrg;
+            GdiBatchDcAttr(&pgO->Attr, pdcattr);
+            return TRUE;
+        }
+    }
+
     return NtGdiBitBlt(hdcDest, xDest, yDest, cx, cy, hdcSrc, xSrc, ySrc, dwRop, 0, 0);
 }
 
@@ -54,8 +54,10 @@ typedef struct _FONT_CACHE_HASHED
 
 typedef struct _FONT_CACHE_ENTRY
 {
-    LIST_ENTRY ListEntry;
+    LIST_ENTRY ListEntry;   /* In the LRU list */
+    LIST_ENTRY HashEntry;   /* In the hash bucket */
     FT_BitmapGlyph BitmapGlyph;
+    SIZE_T CacheSize;
     DWORD dwHash;
     FONT_CACHE_HASHED Hashed;
 } FONT_CACHE_ENTRY, *PFONT_CACHE_ENTRY;
@@ -103,10 +103,18 @@ static BOOL             g_RenderingEnabled = TRUE;
 #define ASSERT_FREETYPE_LOCK_NOT_HELD() \
     ASSERT(g_FreeTypeLock->Owner != KeGetCurrentThread())
 
-#define MAX_FONT_CACHE 256
+/* The glyph cache is limited by the memory used, not by the number of glyphs */
+#define MAX_FONT_CACHE_SIZE (4 * 1024 * 1024)
+#define FONT_CACHE_HASH_BITS 10
+#define FONT_CACHE_HASH_SIZE (1 << FONT_CACHE_HASH_BITS)
+#define FONT_CACHE_BUCKET(dwHash) \
+    (((dwHash) ^ ((dwHash) >> FONT_CACHE_HASH_BITS) ^ ((dwHash) >> (2 * FONT_CACHE_HASH_BITS))) \
+     & (FONT_CACHE_HASH_SIZE - 1))
 
 static RTL_STATIC_LIST_HEAD(g_FontCacheListHead);
+static LIST_ENTRY g_FontCacheHashTable[FONT_CACHE_HASH_SIZE];
 static UINT g_FontCacheNumEntries;
+static SIZE_T g_FontCacheSize;
 
 static PWCHAR g_ElfScripts[32] =   /* These are in the order of the fsCsb[0] bits */
 {
@@ -273,11 +281,16 @@ RemoveCachedEntry(PFONT_CACHE_ENTRY Entry)
 {
     ASSERT_FREETYPE_LOCK_HELD();
 
+    ASSERT(g_FontCacheNumEntries > 0);
+    ASSERT(g_FontCacheSize >= Entry->CacheSize);
+
+    g_FontCacheNumEntries--;
+    g_FontCacheSize -= Entry->CacheSize;
+
     FT_Done_Glyph((FT_Glyph)Entry->BitmapGlyph);
     RemoveEntryList(&Entry->ListEntry);
+    RemoveEntryList(&Entry->HashEntry);
     ExFreePoolWithTag(Entry, TAG_FONT);
-    g_FontCacheNumEntries--;
-    ASSERT(g_FontCacheNumEntries <= MAX_FONT_CACHE);
 }
 
 static void
@@ -670,8 +683,15 @@ BOOL FASTCALL
 InitFontSupport(VOID)
 {
     ULONG ulError;
+    UINT i;
 
     g_FontCacheNumEntries = 0;
+    g_FontCacheSize = 0;
+    for (i = 0; i < FONT_CACHE_HASH_SIZE; i++)
+    {
+        InitializeListHead(&g_FontCacheHashTable[i]);
+    }
+
     /* Fast Mutexes must be allocated from non paged pool */
     g_FontListLock = ExAllocatePoolWithTag(NonPagedPool, sizeof(FAST_MUTEX), TAG_INTERNAL_SYNC);
     if (g_FontListLock == NULL)
@@ -725,7 +745,7 @@ FreeFontSupport(VOID)
     pHead = &g_FontCacheListHead;
     while (!IsListEmpty(pHead))
     {
-        pEntry = RemoveHeadList(pHead);
+        pEntry = pHead->Flink;
         pFontCache = CONTAINING_RECORD(pEntry, FONT_CACHE_ENTRY, ListEntry);
         RemoveCachedEntry(pFontCache);
     }
@@ -3164,17 +3184,19 @@ IntGetHash(IN LPCVOID pv, IN DWORD cdw)
 static FT_BitmapGlyph
 IntFindGlyphCache(IN const FONT_CACHE_ENTRY *pCache)
 {
-    PLIST_ENTRY CurrentEntry;
+    PLIST_ENTRY CurrentEntry, BucketHead;
     PFONT_CACHE_ENTRY FontEntry;
     DWORD dwHash = pCache->dwHash;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
-    for (CurrentEntry = g_FontCacheListHead.Flink;
-         CurrentEntry != &g_FontCacheListHead;
+    /* Only the entries with the same bucket can match */
+    BucketHead = &g_FontCacheHashTable[FONT_CACHE_BUCKET(dwHash)];
+    for (CurrentEntry = BucketHead->Flink;
+         CurrentEntry != BucketHead;
          CurrentEntry = CurrentEntry->Flink)
     {
-        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
+        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, HashEntry);
         if (FontEntry->dwHash == dwHash &&
             FontEntry->Hashed.GlyphIndex == pCache->Hashed.GlyphIndex &&
             FontEntry->Hashed.Face == pCache->Hashed.Face &&
@@ -3188,13 +3210,16 @@ IntFindGlyphCache(IN const FONT_CACHE_ENTRY *pCache)
         }
     }
 
-    if (CurrentEntry == &g_FontCacheListHead)
+    if (CurrentEntry == BucketHead)
     {
         return NULL;
     }
 
-    RemoveEntryList(CurrentEntry);
-    InsertHeadList(&g_FontCacheListHead, CurrentEntry);
+    /* Move the entry to the front of the LRU list and of its bucket */
+    RemoveEntryList(&FontEntry->ListEntry);
+    InsertHeadList(&g_FontCacheListHead, &FontEntry->ListEntry);
+    RemoveEntryList(&FontEntry->HashEntry);
+    InsertHeadList(BucketHead, &FontEntry->HashEntry);
     return FontEntry->BitmapGlyph;
 }
 
@@ -3251,14 +3276,21 @@ IntGetBitmapGlyphWithCache(
     NewEntry->BitmapGlyph = BitmapGlyph;
     NewEntry->dwHash = Cache->dwHash;
     NewEntry->Hashed = Cache->Hashed;
+    NewEntry->CacheSize = sizeof(FONT_CACHE_ENTRY) + sizeof(*BitmapGlyph) +
+                          (SIZE_T)abs(AlignedBitmap.pitch) * AlignedBitmap.rows;
 
-    InsertHeadList(&g_FontCacheListHead, &NewEntry->ListEntry);
-    if (++g_FontCacheNumEntries > MAX_FONT_CACHE)
+    /* Make room for the new glyph by dropping the least recently used ones */
+    while (g_FontCacheNumEntries > 0 &&
+           g_FontCacheSize + NewEntry->CacheSize > MAX_FONT_CACHE_SIZE)
     {
-        NewEntry = CONTAINING_RECORD(g_FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry);
-        RemoveCachedEntry(NewEntry);
+        RemoveCachedEntry(CONTAINING_RECORD(g_FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry));
     }
 
+    InsertHeadList(&g_FontCacheListHead, &NewEntry->ListEntry);
+    InsertHeadList(&g_FontCacheHashTable[FONT_CACHE_BUCKET(Cache->dwHash)], &NewEntry->HashEntry);
+    g_FontCacheNumEntries++;
+    g_FontCacheSize += NewEntry->CacheSize;
+
     return BitmapGlyph;
 }
 
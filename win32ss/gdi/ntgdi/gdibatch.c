@@ -6,6 +6,8 @@
 
 BOOL FASTCALL IntPatBlt( PDC,INT,INT,INT,INT,DWORD,PEBRUSHOBJ);
 BOOL APIENTRY IntExtTextOutW(IN PDC,IN INT,IN INT,IN UINT,IN OPTIONAL PRECTL,IN LPCWSTR,IN INT,IN OPTIONAL LPINT,IN DWORD);
+BOOL FASTCALL IntRectangle(PDC,INT,INT,INT,INT);
+BOOL FASTCALL IntGdiPolyPolygon(PDC,LPPOINT,PULONG,INT);
 
 
 //
@@ -62,6 +64,64 @@ SynchronizeDriver(FLONG Flags)
   return;
 }
 
+//
+// Swap the attribute snapshot of a line or shape command with the DC
+// attributes and return the dirty flags for what differed. Calling it a
+// second time puts the DC attributes back.
+//
+static
+ULONG
+FASTCALL
+IntSwapBatchDcAttr(PDC_ATTR pdcattr, PGDIBSDCATTR pAttr)
+{
+  GDIBSDCATTR Save;
+  ULONG flags = 0;
+
+  if (pdcattr->hbrush != pAttr->hbrush)
+     flags |= DC_BRUSH_DIRTY;
+  if (pdcattr->hpen != pAttr->hpen)
+     flags |= DC_PEN_DIRTY;
+  if (pdcattr->crForegroundClr != pAttr->crForegroundClr)
+     flags |= (DIRTY_FILL|DIRTY_LINE|DIRTY_TEXT);
+  if (pdcattr->crBackgroundClr != pAttr->crBackgroundClr)
+     flags |= (DIRTY_FILL|DIRTY_LINE|DIRTY_TEXT|DIRTY_BACKGROUND);
+  if (pdcattr->crBrushClr != pAttr->crBrushClr)
+     flags |= DIRTY_FILL;
+  if (pdcattr->crPenClr != pAttr->crPenClr)
+     flags |= DIRTY_LINE;
+
+  Save.hbrush          = pdcattr->hbrush;
+  Save.hpen            = pdcattr->hpen;
+  Save.crForegroundClr = pdcattr->crForegroundClr;
+  Save.crBackgroundClr = pdcattr->crBackgroundClr;
+  Save.crBrushClr      = pdcattr->crBrushClr;
+  Save.crPenClr        = pdcattr->crPenClr;
+  Save.ulForegroundClr = pdcattr->ulForegroundClr;
+  Save.ulBackgroundClr = pdcattr->ulBackgroundClr;
+  Save.ulBrushClr      = pdcattr->ulBrushClr;
+  Save.ulPenClr        = pdcattr->ulPenClr;
+  Save.lBkMode         = pdcattr->lBkMode;
+  Save.jBkMode         = pdcattr->jBkMode;
+
+  pdcattr->hbrush          = pAttr->hbrush;
+  pdcattr->hpen            = pAttr->hpen;
+  pdcattr->crForegroundClr = pAttr->crForegroundClr;
+  pdcattr->crBackgroundClr = pAttr->crBackgroundClr;
+  pdcattr->crBrushClr      = pAttr->crBrushClr;
+  pdcattr->crPenClr        = pAttr->crPenClr;
+  pdcattr->ulForegroundClr = pAttr->ulForegroundClr;
+  pdcattr->ulBackgroundClr = pAttr->ulBackgroundClr;
+  pdcattr->ulBrushClr      = pAttr->ulBrushClr;
+  pdcattr->ulPenClr        = pAttr->ulPenClr;
+  pdcattr->lBkMode         = pAttr->lBkMode;
+  pdcattr->jBkMode         = pAttr->jBkMode;
+
+  *pAttr = Save;
+  return flags;
+}
+
+#define BATCH_ATTR_DIRTY (DIRTY_BACKGROUND|DIRTY_LINE|DIRTY_TEXT|DIRTY_FILL|DC_BRUSH_DIRTY|DC_PEN_DIRTY)
+
 //
 // Process the batch.
 //
@@ -443,6 +503,171 @@ GdiFlushUserBatch(PDC dc, PGDIBATCHHDR pHdr)
         break;
      }
 
+     case GdiBCLineTo:
+     {
+        PGDIBSLINETO pgO;
+        POINTL ptlCurrent, ptfxCurrent;
+        RECTL rcLockRect;
+        DWORD flags, saveflags, saveptl;
+        if (!dc) break;
+        pgO = (PGDIBSLINETO) pHdr;
+
+        // The client moved on to the end point already, start from where the
+        // line did and put its current position back afterwards.
+        ptlCurrent  = pdcattr->ptlCurrent;
+        ptfxCurrent = pdcattr->ptfxCurrent;
+        saveptl = pdcattr->ulDirty_ & (DIRTY_PTLCURRENT|DIRTY_PTFXCURRENT|DIRTY_STYLESTATE);
+        pdcattr->ptlCurrent = pgO->ptlStart;
+
+        saveflags = pdcattr->ulDirty_ & BATCH_ATTR_DIRTY;
+        flags = IntSwapBatchDcAttr(pdcattr, &pgO->Attr);
+        pdcattr->ulDirty_ |= flags;
+
+        rcLockRect.left   = pgO->ptlStart.x;
+        rcLockRect.top    = pgO->ptlStart.y;
+        rcLockRect.right  = pgO->ptlEnd.x;
+        rcLockRect.bottom = pgO->ptlEnd.y;
+        IntLPtoDP(dc, (PPOINT)&rcLockRect, 2);
+        RECTL_vOffsetRect(&rcLockRect, dc->ptlDCOrig.x, dc->ptlDCOrig.y);
+
+        DC_vPrepareDCsForBlit(dc, &rcLockRect, NULL, NULL);
+        IntGdiLineTo(dc, pgO->ptlEnd.x, pgO->ptlEnd.y);
+        DC_vFinishBlit(dc, NULL);
+
+        IntSwapBatchDcAttr(pdcattr, &pgO->Attr);
+        pdcattr->ulDirty_ |= saveflags | flags;
+
+        pdcattr->ptlCurrent  = ptlCurrent;
+        pdcattr->ptfxCurrent = ptfxCurrent;
+        pdcattr->ulDirty_ &= ~(DIRTY_PTLCURRENT|DIRTY_PTFXCURRENT|DIRTY_STYLESTATE);
+        pdcattr->ulDirty_ |= saveptl;
+        break;
+     }
+
+     case GdiBCPolyline:
+     {
+        PGDIBSPOLYLINE pgO;
+        DWORD flags, saveflags;
+        ULONG Count;
+        if (!dc) break;
+        pgO = (PGDIBSPOLYLINE) pHdr;
+
+        /* The points must lie within the entry, and the count can change under us */
+        Count = pgO->Count;
+        if (Size < sizeof(GDIBSPOLYLINE) ||
+            Count > (Size - FIELD_OFFSET(GDIBSPOLYLINE, apt)) / sizeof(POINT))
+        {
+            DPRINT1("GdiBCPolyline with %lu points does not fit in %lu bytes\n", Count, Size);
+            break;
+        }
+
+        saveflags = pdcattr->ulDirty_ & BATCH_ATTR_DIRTY;
+        flags = IntSwapBatchDcAttr(pdcattr, &pgO->Attr);
+        pdcattr->ulDirty_ |= flags;
+
+        DC_vPrepareDCsForBlit(dc, NULL, NULL, NULL);
+        IntGdiPolyPolyline(dc, pgO->apt, &Count, 1);
+        DC_vFinishBlit(dc, NULL);
+
+        IntSwapBatchDcAttr(pdcattr, &pgO->Attr);
+        pdcattr->ulDirty_ |= saveflags | flags;
+        break;
+     }
+
+     case GdiBCRectangle:
+     {
+        PGDIBSRECTANGLE pgO;
+        DWORD flags, saveflags;
+        if (!dc) break;
+        pgO = (PGDIBSRECTANGLE) pHdr;
+
+        saveflags = pdcattr->ulDirty_ & BATCH_ATTR_DIRTY;
+        flags = IntSwapBatchDcAttr(pdcattr, &pgO->Attr);
+        pdcattr->ulDirty_ |= flags;
+
+        /* Do we rotate or shear? */
+        if (!(pdcattr->mxWorldToDevice.flAccel & XFORM_SCALE))
+        {
+            POINTL DestCoords[4];
+            ULONG PolyCounts = 4;
+
+            DestCoords[0].x = DestCoords[3].x = pgO->rcl.left;
+            DestCoords[0].y = DestCoords[1].y = pgO->rcl.top;
+            DestCoords[1].x = DestCoords[2].x = pgO->rcl.right;
+            DestCoords[2].y = DestCoords[3].y = pgO->rcl.bottom;
+            IntGdiPolyPolygon(dc, DestCoords, &PolyCounts, 1);
+        }
+        else
+        {
+            IntRectangle(dc, pgO->rcl.left, pgO->rcl.top, pgO->rcl.right, pgO->rcl.bottom);
+        }
+
+        IntSwapBatchDcAttr(pdcattr, &pgO->Attr);
+        pdcattr->ulDirty_ |= saveflags | flags;
+        break;
+     }
+
+     case GdiBCSetPixel:
+     {
+        PGDIBSSETPIXEL pgO;
+        if (!dc) break;
+        pgO = (PGDIBSSETPIXEL) pHdr;
+        NtGdiSetPixel(dc->BaseObject.hHmgr, pgO->x, pgO->y, pgO->crColor);
+        break;
+     }
+
+     case GdiBCBitBlt:
+     {
+        PGDIBSBITBLT pgO;
+        POINTL ptlWindowOrg, ptlViewportOrg;
+        DWORD flags, saveflags;
+        if (!dc) break;
+        pgO = (PGDIBSBITBLT) pHdr;
+
+        // Only blts within the flushed DC are batched. Locking another DC
+        // while this one is held would not follow the order of
+        // GDIOBJ_bLockMultipleObjects, and two threads blitting between
+        // the same DCs in opposite directions could deadlock.
+        if (pgO->hdcSrc != dc->BaseObject.hHmgr)
+        {
+            DPRINT1("GdiBCBitBlt from another DC %p\n", pgO->hdcSrc);
+            break;
+        }
+
+        // The mapping can have changed on the client side, apply the one
+        // the blt was issued with.
+        ptlWindowOrg   = pdcattr->ptlWindowOrg;
+        ptlViewportOrg = pdcattr->ptlViewportOrg;
+        pdcattr->ptlWindowOrg   = pgO->ptlWindowOrg;
+        pdcattr->ptlViewportOrg = pgO->ptlViewportOrg;
+        pdcattr->flXform |= (PAGE_XLATE_CHANGED|WORLD_XFORM_CHANGED|DEVICE_TO_WORLD_INVALID);
+
+        saveflags = pdcattr->ulDirty_ & BATCH_ATTR_DIRTY;
+        flags = IntSwapBatchDcAttr(pdcattr, &pgO->Attr);
+        pdcattr->ulDirty_ |= flags;
+
+        // The DC is locked once more by the blt, which is fine for the same thread
+        NtGdiBitBlt(dc->BaseObject.hHmgr,
+                    pgO->xDest,
+                    pgO->yDest,
+                    pgO->cx,
+                    pgO->cy,
+                    pgO->hdcSrc,
+                    pgO->xSrc,
+                    pgO->ySrc,
+                    pgO->dwRop,
+                    0,
+                    0);
+
+        IntSwapBatchDcAttr(pdcattr, &pgO->Attr);
+        pdcattr->ulDirty_ |= saveflags | flags;
+
+        pdcattr->ptlWindowOrg   = ptlWindowOrg;
+        pdcattr->ptlViewportOrg = ptlViewportOrg;
+        pdcattr->flXform |= (PAGE_XLATE_CHANGED|WORLD_XFORM_CHANGED|DEVICE_TO_WORLD_INVALID);
+        break;
+     }
+
      case GdiBCDelRgn:
         DPRINT("Delete Region Object!\n");
         /* Fall through */
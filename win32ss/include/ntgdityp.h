@@ -92,6 +92,11 @@ typedef enum _GDIBATCHCMD
     GdiBCSelObj,
     GdiBCDelObj,
     GdiBCDelRgn,
+    GdiBCLineTo,
+    GdiBCPolyline,
+    GdiBCRectangle,
+    GdiBCSetPixel,
+    GdiBCBitBlt,
 } GDIBATCHCMD, *PGDIBATCHCMD;
 
 typedef enum _TRANSFORMTYPE
@@ -560,6 +565,80 @@ typedef struct _GDIBSOBJECT
   HGDIOBJ hgdiobj;
 } GDIBSOBJECT, *PGDIBSOBJECT;
 
+//
+// The DC attributes a line or shape command draws with. The client can
+// change them in DC_ATTR without a syscall while the command waits in the
+// batch, so the command carries the values it was issued with.
+//
+typedef struct _GDIBSDCATTR
+{
+  HANDLE hbrush;
+  HANDLE hpen;
+  COLORREF crForegroundClr;
+  COLORREF crBackgroundClr;
+  COLORREF crBrushClr;
+  COLORREF crPenClr;
+  ULONG ulForegroundClr;
+  ULONG ulBackgroundClr;
+  ULONG ulBrushClr;
+  ULONG ulPenClr;
+  LONG lBkMode;
+  BYTE jBkMode;
+} GDIBSDCATTR, *PGDIBSDCATTR;
+
+typedef struct _GDIBSLINETO
+{
+  GDIBATCHHDR gbHdr;
+  POINTL ptlStart;
+  POINTL ptlEnd;
+  GDIBSDCATTR Attr;
+} GDIBSLINETO, *PGDIBSLINETO;
+
+typedef struct _GDIBSPOLYLINE
+{
+  GDIBATCHHDR gbHdr;
+  ULONG Count;
+  GDIBSDCATTR Attr;
+  POINT apt[1];
+} GDIBSPOLYLINE, *PGDIBSPOLYLINE;
+
+typedef struct _GDIBSRECTANGLE
+{
+  GDIBATCHHDR gbHdr;
+  RECTL rcl;
+  GDIBSDCATTR Attr;
+} GDIBSRECTANGLE, *PGDIBSRECTANGLE;
+
+typedef struct _GDIBSSETPIXEL
+{
+  GDIBATCHHDR gbHdr;
+  INT x;
+  INT y;
+  COLORREF crColor;
+} GDIBSSETPIXEL, *PGDIBSSETPIXEL;
+
+//
+// BitBlt is batched within one MM_TEXT DC in GM_COMPATIBLE mode only. Its
+// mapping then depends on nothing but the window and viewport origins, which
+// are carried along. The background color used for color to mono conversion
+// comes with the attributes.
+//
+typedef struct _GDIBSBITBLT
+{
+  GDIBATCHHDR gbHdr;
+  INT xDest;
+  INT yDest;
+  INT cx;
+  INT cy;
+  HDC hdcSrc;
+  INT xSrc;
+  INT ySrc;
+  DWORD dwRop;
+  POINTL ptlWindowOrg;
+  POINTL ptlViewportOrg;
+  GDIBSDCATTR Attr;
+} GDIBSBITBLT, *PGDIBSBITBLT;
+
 /* Declaration missing in ddk/winddi.h */
 typedef VOID (APIENTRY *PFN_DrvMovePanning)(LONG, LONG, FLONG);
 
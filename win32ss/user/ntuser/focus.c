@@ -1652,7 +1652,7 @@ NtUserGetForegroundWindow(VOID)
    HWND Ret;
 
    TRACE("Enter NtUserGetForegroundWindow\n");
-   UserEnterExclusive();
+   UserEnterShared();
 
    Ret = UserGetForegroundWindow();
 
@@ -198,6 +198,12 @@ UserProcessDestroy(PEPROCESS Process)
             ppiCurrent->peProcess->ImageFileName, ppiCurrent);
         DbgUserDumpHandleTable();
     }
+    if (DBG_IS_CHANNEL_ENABLED(ppiCurrent, DbgChUserMisc, WARN_LEVEL))
+    {
+        TRACE_CH(UserMisc, "Dumping user lock statistics at the end of the process %s (Info %p).\n",
+            ppiCurrent->peProcess->ImageFileName, ppiCurrent);
+        UserDbgDumpLockStats();
+    }
 #endif
 
     /* Remove it from the list of GUI apps */
@@ -5751,7 +5751,7 @@ NtUserGetTitleBarInfo(
     BOOLEAN retValue = TRUE;
 
     TRACE("Enter NtUserGetTitleBarInfo\n");
-    UserEnterExclusive();
+    UserEnterShared();
 
     /* Vaildate the windows handle */
     if (!(WindowObject = UserGetWindowObject(hwnd)))
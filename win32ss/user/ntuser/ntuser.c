@@ -231,11 +231,155 @@ VOID FASTCALL CleanupUserImpl(VOID)
     ExDeleteResourceLite(&UserLock);
 }
 
+#if DBG
+
+/*
+ * Wait and hold times of the user lock per caller of UserEnterShared and
+ * UserEnterExclusive. They are only kept for the threads of processes that
+ * have warn+UserMisc in DEBUGCHANNEL and get dumped when such a process
+ * ends, which shows the calls that keep the others waiting.
+ */
+#define USER_LOCK_STATS 256
+
+typedef struct _USER_LOCK_STAT
+{
+    PVOID Caller;
+    BOOLEAN Shared;
+    LONG Enters;
+    LONG Waits;
+    LONGLONG WaitTime;
+    LONGLONG HoldTime;
+} USER_LOCK_STAT, *PUSER_LOCK_STAT;
+
+static USER_LOCK_STAT gaUserLockStats[USER_LOCK_STATS];
+
+static PUSER_LOCK_STAT
+UserDbgGetLockStat(PVOID Caller, BOOLEAN Shared)
+{
+    ULONG i, Index = (ULONG)(((ULONG_PTR)Caller >> 2) % USER_LOCK_STATS);
+    PVOID Old;
+
+    for (i = 0; i < USER_LOCK_STATS; i++)
+    {
+        Old = InterlockedCompareExchangePointer(&gaUserLockStats[Index].Caller, Caller, NULL);
+        if (Old == NULL)
+        {
+            gaUserLockStats[Index].Shared = Shared;
+            return &gaUserLockStats[Index];
+        }
+        if (Old == Caller)
+            return &gaUserLockStats[Index];
+
+        Index = (Index + 1) % USER_LOCK_STATS;
+    }
+
+    /* The table is full, this caller goes uncounted */
+    return NULL;
+}
+
+static VOID
+UserDbgAcquireLock(BOOLEAN Shared, PVOID Caller)
+{
+    PPROCESSINFO ppi = PsGetCurrentProcessWin32Process();
+    PTHREADINFO pti;
+    PUSER_LOCK_STAT Stat = NULL;
+    LARGE_INTEGER Start, End;
+    BOOLEAN Outermost, Acquired;
+
+    if (ppi && DBG_IS_CHANNEL_ENABLED(ppi, DbgChUserMisc, WARN_LEVEL))
+        Stat = UserDbgGetLockStat(Caller, Shared);
+
+    if (!Stat)
+    {
+        if (Shared)
+            ExAcquireResourceSharedLite(&UserLock, TRUE);
+        else
+            ExAcquireResourceExclusiveLite(&UserLock, TRUE);
+        return;
+    }
+
+    Outermost = !UserIsEntered();
+    InterlockedIncrement(&Stat->Enters);
+
+    /* Only time the acquisitions that have to wait */
+    if (Shared)
+        Acquired = ExAcquireResourceSharedLite(&UserLock, FALSE);
+    else
+        Acquired = ExAcquireResourceExclusiveLite(&UserLock, FALSE);
+
+    if (!Acquired)
+    {
+        InterlockedIncrement(&Stat->Waits);
+        Start = KeQueryPerformanceCounter(NULL);
+        if (Shared)
+            ExAcquireResourceSharedLite(&UserLock, TRUE);
+        else
+            ExAcquireResourceExclusiveLite(&UserLock, TRUE);
+        End = KeQueryPerformanceCounter(NULL);
+        InterlockedExchangeAdd64(&Stat->WaitTime, End.QuadPart - Start.QuadPart);
+    }
+
+    /* The hold time goes to the caller that took the lock first */
+    pti = PsGetCurrentThreadWin32Thread();
+    if (Outermost && pti)
+    {
+        pti->pvUserLockStat = Stat;
+        pti->llUserLockAcquired = KeQueryPerformanceCounter(NULL).QuadPart;
+    }
+}
+
+static VOID
+UserDbgReleaseLock(VOID)
+{
+    PTHREADINFO pti = PsGetCurrentThreadWin32Thread();
+    PUSER_LOCK_STAT Stat;
+
+    if (!pti || !pti->pvUserLockStat || UserIsEntered())
+        return;
+
+    Stat = pti->pvUserLockStat;
+    pti->pvUserLockStat = NULL;
+    InterlockedExchangeAdd64(&Stat->HoldTime,
+                             KeQueryPerformanceCounter(NULL).QuadPart - pti->llUserLockAcquired);
+}
+
+VOID FASTCALL UserDbgDumpLockStats(VOID)
+{
+    LARGE_INTEGER Frequency;
+    PUSER_LOCK_STAT Stat;
+    ULONG i;
+
+    KeQueryPerformanceCounter(&Frequency);
+
+    ERR("User lock statistics (times in microseconds):\n");
+    DbgPrint("\tCaller            Mode       Enters      Waits    WaitTime    HoldTime\n");
+    for (i = 0; i < USER_LOCK_STATS; i++)
+    {
+        Stat = &gaUserLockStats[i];
+        if (!Stat->Caller)
+            continue;
+
+        DbgPrint("\t%p  %-9s %8ld   %8ld  %10I64d  %10I64d\n",
+                 Stat->Caller,
+                 Stat->Shared ? "shared" : "exclusive",
+                 Stat->Enters,
+                 Stat->Waits,
+                 Stat->WaitTime * 1000000 / Frequency.QuadPart,
+                 Stat->HoldTime * 1000000 / Frequency.QuadPart);
+    }
+}
+
+#endif /* DBG */
+
 // Win: EnterSharedCrit
 VOID FASTCALL UserEnterShared(VOID)
 {
     KeEnterCriticalRegion();
+#if DBG
+    UserDbgAcquireLock(TRUE, _ReturnAddress());
+#else
     ExAcquireResourceSharedLite(&UserLock, TRUE);
+#endif
 }
 
 // Win: EnterCrit
@@ -243,7 +387,11 @@ VOID FASTCALL UserEnterExclusive(VOID)
 {
     ASSERT_NOGDILOCKS();
     KeEnterCriticalRegion();
+#if DBG
+    UserDbgAcquireLock(FALSE, _ReturnAddress());
+#else
     ExAcquireResourceExclusiveLite(&UserLock, TRUE);
+#endif
     gptiCurrent = PsGetCurrentThreadWin32Thread();
 }
 
@@ -253,6 +401,9 @@ VOID FASTCALL UserLeave(VOID)
     ASSERT_NOGDILOCKS();
     ASSERT(UserIsEntered());
     ExReleaseResourceLite(&UserLock);
+#if DBG
+    UserDbgReleaseLock();
+#endif
     KeLeaveCriticalRegion();
 }
 
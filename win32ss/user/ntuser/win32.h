@@ -158,6 +158,8 @@ typedef struct _THREADINFO
     ULONG cExclusiveLocks;
 #if DBG
     USHORT acExclusiveLockCount[GDIObjTypeTotal + 1];
+    PVOID pvUserLockStat;
+    LONGLONG llUserLockAcquired;
 #endif
 #endif // __cplusplus
 } THREADINFO;
@@ -1530,7 +1530,7 @@ NtUserBuildHwndList(
    if (pcHwndNeeded == NULL)
        return STATUS_INVALID_PARAMETER;
 
-   UserEnterExclusive();
+   UserEnterShared();
 
    if (hwndParent || !dwThreadId)
    {
@@ -3413,7 +3413,7 @@ NtUserGetAncestor(HWND hWnd, UINT Type)
    HWND Ret = NULL;
 
    TRACE("Enter NtUserGetAncestor\n");
-   UserEnterExclusive();
+   UserEnterShared();
 
    Window = UserGetWindowObject(hWnd);
    if (Window)
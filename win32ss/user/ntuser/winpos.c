@@ -3227,15 +3227,18 @@ NtUserChildWindowFromPointEx(HWND hwndParent,
                              UINT uiFlags)
 {
    PWND pwndParent;
+   HWND Ret = NULL;
    TRACE("Enter NtUserChildWindowFromPointEx\n");
-   UserEnterExclusive();
+   UserEnterShared();
    if ((pwndParent = UserGetWindowObject(hwndParent)))
    {
       pwndParent = IntChildWindowFromPointEx(pwndParent, x, y, uiFlags);
+      if (pwndParent)
+         Ret = UserHMGetHandle(pwndParent);
    }
    UserLeave();
    TRACE("Leave NtUserChildWindowFromPointEx\n");
-   return pwndParent ? UserHMGetHandle(pwndParent) : NULL;
+   return Ret;
 }
 
 /*